@@ -0,0 +1,40 @@
+/*
+ * Copyright (c) 2021, the SerenityOS developers.
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#pragma once
+
+#include <AK/EnumBits.h>
+#include <AK/Types.h>
+
+enum class EventQueueFlags : u32 {
+    None = 0,
+    CloseOnExec = 1 << 0,
+};
+
+AK_ENUM_BITWISE_OPERATORS(EventQueueFlags);
+
+enum class EventQueueOperation : u32 {
+    Add = 1,
+    Modify = 2,
+    Remove = 3,
+};
+
+enum class EventQueueEvents : u32 {
+    None = 0,
+    Read = 1 << 0,
+    Write = 1 << 1,
+
+    // Only report the file once per readiness change instead of on every
+    // wait for as long as it stays ready.
+    EdgeTriggered = 1u << 31,
+};
+
+AK_ENUM_BITWISE_OPERATORS(EventQueueEvents);
+
+struct EventQueueEvent {
+    u32 events;
+    u64 user_data;
+};
@@ -0,0 +1,62 @@
+/*
+ * Copyright (c) 2021, the SerenityOS developers.
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#pragma once
+
+#include <AK/EnumBits.h>
+#include <AK/Types.h>
+
+// An I/O ring lives in memory owned by the kernel, which the process maps
+// with a shared mmap() of the ring's fd. It starts with an IORingHeader,
+// followed by the submission entries and then the completion entries.
+// Userspace produces submissions and consumes completions, the kernel does
+// the opposite. Both entry counts must be powers of two.
+
+enum class IORingFlags : u32 {
+    None = 0,
+    CloseOnExec = 1 << 0,
+};
+
+AK_ENUM_BITWISE_OPERATORS(IORingFlags);
+
+enum class IORingOpcode : u32 {
+    Nop = 0,
+    Read = 1,
+    Write = 2,
+    Fsync = 3,
+    Accept = 4,
+};
+
+struct IORingSubmission {
+    u32 opcode;
+    i32 fd;
+    u64 user_data;
+    FlatPtr buffer;
+    u32 length;
+    // For Accept, these are SOCK_NONBLOCK and SOCK_CLOEXEC.
+    u32 flags;
+};
+
+struct IORingCompletion {
+    u64 user_data;
+    // The number of bytes transferred, the accepted fd, or a negated errno.
+    i32 result;
+    u32 flags;
+};
+
+struct IORingHeader {
+    u32 submission_head; // Advanced by the kernel.
+    u32 submission_tail; // Advanced by userspace.
+    u32 completion_head; // Advanced by userspace.
+    u32 completion_tail; // Advanced by the kernel.
+    u32 submission_entries;
+    u32 completion_entries;
+};
+
+constexpr size_t io_ring_size(u32 submission_entries, u32 completion_entries)
+{
+    return sizeof(IORingHeader) + submission_entries * sizeof(IORingSubmission) + completion_entries * sizeof(IORingCompletion);
+}
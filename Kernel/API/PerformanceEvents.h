@@ -0,0 +1,161 @@
+/*
+ * Copyright (c) 2021, the SerenityOS developers.
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#pragma once
+
+#include <AK/Types.h>
+
+// Performance events are stored as a sequence of variable-sized records.
+// A perfcore file, /proc/profile and /proc/<pid>/perf_events start with a
+// PerformanceEventStreamHeader, which is followed by the records.
+//
+// While all processes are being profiled, each processor also appends its
+// records to a ring that userspace can mmap() and drain while profiling is
+// running (see profiling_open_ring()). The ring starts with a
+// PerformanceEventRingHeader, and its records begin on the next page.
+
+// Static probe sites in the kernel, each of which can be switched on and off
+// with /proc/sys/trace_<name>. While a tracepoint is on, it records a
+// PERF_EVENT_TRACEPOINT event into the perf events buffer of the current
+// process (or the global one) whenever it is hit.
+#define ENUMERATE_TRACEPOINTS(T) \
+    T(syscall_enter)             \
+    T(syscall_exit)              \
+    T(device_request_start)      \
+    T(device_request_complete)   \
+    T(lock_wait)                 \
+    T(lock_wake)                 \
+    T(net_receive)               \
+    T(sched_wakeup)
+
+enum class Tracepoint : u16 {
+#define __ENUMERATE_TRACEPOINT(x) x,
+    ENUMERATE_TRACEPOINTS(__ENUMERATE_TRACEPOINT)
+#undef __ENUMERATE_TRACEPOINT
+        __Count
+};
+
+constexpr const char* to_string(Tracepoint tracepoint)
+{
+    switch (tracepoint) {
+#define __ENUMERATE_TRACEPOINT(x) \
+    case Tracepoint::x:           \
+        return #x;
+        ENUMERATE_TRACEPOINTS(__ENUMERATE_TRACEPOINT)
+#undef __ENUMERATE_TRACEPOINT
+    default:
+        break;
+    }
+    return "unknown";
+}
+
+constexpr u32 performance_event_stream_magic = 0x46524550; // "PERF"
+constexpr u16 performance_event_stream_version = 1;
+
+// Records start at a multiple of this, so they can be read in place.
+constexpr size_t performance_event_record_alignment = 8;
+
+// Records don't wrap around the end of a ring. Whatever space is left at the
+// end is filled with a padding record instead, which only has a valid type and size.
+constexpr u16 performance_event_padding = 0;
+
+struct [[gnu::packed]] PerformanceEventStreamHeader {
+    u32 magic;
+    u16 version;
+    u16 header_size;
+    // The number of events that had to be dropped because there was no room for them.
+    u32 lost_events;
+    u32 reserved;
+};
+
+// Not packed, since both sides access head and tail atomically.
+struct PerformanceEventRingHeader {
+    u32 magic;
+    u16 version;
+    u16 header_size;
+    u32 processor;
+    u32 data_offset;
+    // This is a power of two.
+    u32 data_size;
+    // Byte counts that keep growing and wrap around at 2^32, so the records
+    // that are ready to read are at [tail, head) modulo data_size.
+    u32 head; // Advanced by the kernel.
+    u32 tail; // Advanced by userspace.
+    u32 lost_events;
+};
+
+struct [[gnu::packed]] PerformanceEventRecord {
+    // One of the PERF_EVENT_* types, or performance_event_padding.
+    u16 type;
+    // The size of the whole record, a multiple of performance_event_record_alignment.
+    u16 size;
+    u16 stack_size;
+    u16 string_length;
+    u32 pid;
+    u32 tid;
+    u32 lost_samples;
+    u32 reserved;
+    u64 timestamp;
+    // Followed by the payload for the type (if it has one), then stack_size
+    // return addresses and finally string_length bytes of the event's string,
+    // which is not null-terminated. mmap events have the name of the region as
+    // their string, process_create and process_exec events the executable.
+};
+
+static_assert(sizeof(PerformanceEventRecord) % performance_event_record_alignment == 0);
+
+struct [[gnu::packed]] MallocPerformanceEvent {
+    FlatPtr size;
+    FlatPtr ptr;
+};
+
+struct [[gnu::packed]] FreePerformanceEvent {
+    FlatPtr size;
+    FlatPtr ptr;
+};
+
+struct [[gnu::packed]] MmapPerformanceEvent {
+    FlatPtr size;
+    FlatPtr ptr;
+};
+
+struct [[gnu::packed]] MunmapPerformanceEvent {
+    FlatPtr size;
+    FlatPtr ptr;
+};
+
+struct [[gnu::packed]] ProcessCreatePerformanceEvent {
+    i32 parent_pid;
+};
+
+struct [[gnu::packed]] ThreadCreatePerformanceEvent {
+    i32 parent_tid;
+};
+
+struct [[gnu::packed]] ContextSwitchPerformanceEvent {
+    i32 next_pid;
+    u32 next_tid;
+};
+
+struct [[gnu::packed]] KMallocPerformanceEvent {
+    FlatPtr size;
+    FlatPtr ptr;
+};
+
+struct [[gnu::packed]] KFreePerformanceEvent {
+    FlatPtr size;
+    FlatPtr ptr;
+};
+
+struct [[gnu::packed]] TracepointPerformanceEvent {
+    u16 tracepoint;
+    u16 reserved1;
+    u32 reserved2;
+    // The record's timestamp is too coarse to measure latencies with.
+    u64 timestamp_ns;
+    FlatPtr arg1;
+    FlatPtr arg2;
+};
@@ -0,0 +1,147 @@
+/*
+ * Copyright (c) 2021, the SerenityOS developers.
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#pragma once
+
+#include <AK/Types.h>
+
+// /proc/snapshot and /proc/<pid>/snapshot describe processes in a binary
+// format that can be read in place, unlike the JSON in /proc/all and friends.
+// A snapshot starts with a ProcessSnapshotHeader, which is followed by
+// variable-sized records. Each record starts with a ProcessSnapshotRecord,
+// followed by the struct for its type and then the strings that struct
+// declares lengths for, in order and without null terminators.
+//
+// Thread, region and file description records belong to the process record
+// that came before them. /proc/snapshot only has process and thread records.
+
+constexpr u32 process_snapshot_magic = 0x504e5350; // "PSNP"
+constexpr u16 process_snapshot_version = 1;
+
+// Records start at a multiple of this, so they can be read in place.
+constexpr size_t process_snapshot_record_alignment = 8;
+
+enum class ProcessSnapshotRecordType : u16 {
+    Process = 1,
+    Thread,
+    Region,
+    FileDescription,
+};
+
+struct [[gnu::packed]] ProcessSnapshotHeader {
+    u32 magic;
+    u16 version;
+    u16 header_size;
+    u32 process_count;
+    u32 reserved;
+};
+
+struct [[gnu::packed]] ProcessSnapshotRecord {
+    u16 type;
+    // The size of the whole record, a multiple of process_snapshot_record_alignment.
+    // Readers skip records they don't know by this.
+    u16 size;
+    u32 reserved;
+};
+
+enum class ProcessSnapshotVeilState : u8 {
+    None,
+    Dropped,
+    Locked,
+};
+
+struct [[gnu::packed]] ProcessSnapshotProcess {
+    i32 pid;
+    i32 pgid;
+    i32 pgp;
+    i32 sid;
+    u32 uid;
+    u32 gid;
+    i32 ppid;
+    u32 nfds;
+    u32 thread_count;
+    u8 kernel;
+    u8 dumpable;
+    u8 veil_state;
+    u8 reserved;
+    u64 amount_virtual;
+    u64 amount_resident;
+    u64 amount_shared;
+    u64 amount_dirty_private;
+    u64 amount_clean_inode;
+    u64 amount_purgeable_volatile;
+    u64 amount_purgeable_nonvolatile;
+    u16 name_length;
+    u16 executable_length;
+    u16 tty_length;
+    // The promises the process has pledged, separated by spaces.
+    u16 pledge_length;
+};
+
+struct [[gnu::packed]] ProcessSnapshotThread {
+    i32 tid;
+    u32 cpu;
+    u32 priority;
+    u32 times_scheduled;
+    u32 ticks_user;
+    u32 ticks_kernel;
+    u32 syscall_count;
+    u32 inode_faults;
+    u32 zero_faults;
+    u32 cow_faults;
+    u64 file_read_bytes;
+    u64 file_write_bytes;
+    u64 unix_socket_read_bytes;
+    u64 unix_socket_write_bytes;
+    u64 ipv4_socket_read_bytes;
+    u64 ipv4_socket_write_bytes;
+    u16 name_length;
+    u16 state_length;
+    u32 reserved;
+};
+
+enum ProcessSnapshotRegionFlags : u32 {
+    ProcessSnapshotRegionReadable = 1 << 0,
+    ProcessSnapshotRegionWritable = 1 << 1,
+    ProcessSnapshotRegionExecutable = 1 << 2,
+    ProcessSnapshotRegionStack = 1 << 3,
+    ProcessSnapshotRegionShared = 1 << 4,
+    ProcessSnapshotRegionSyscall = 1 << 5,
+    ProcessSnapshotRegionPurgeable = 1 << 6,
+    ProcessSnapshotRegionVolatile = 1 << 7,
+    ProcessSnapshotRegionCacheable = 1 << 8,
+};
+
+struct [[gnu::packed]] ProcessSnapshotRegion {
+    u64 address;
+    u64 size;
+    u64 amount_resident;
+    u64 amount_dirty;
+    u32 cow_pages;
+    u32 flags;
+    u16 name_length;
+    // The class name of the region's VMObject.
+    u16 vmobject_length;
+    u32 reserved;
+};
+
+enum ProcessSnapshotFileDescriptionFlags : u32 {
+    ProcessSnapshotFileDescriptionSeekable = 1 << 0,
+    ProcessSnapshotFileDescriptionCloseOnExec = 1 << 1,
+    ProcessSnapshotFileDescriptionBlocking = 1 << 2,
+    ProcessSnapshotFileDescriptionCanRead = 1 << 3,
+    ProcessSnapshotFileDescriptionCanWrite = 1 << 4,
+};
+
+struct [[gnu::packed]] ProcessSnapshotFileDescription {
+    i32 fd;
+    u32 flags;
+    u64 offset;
+    u16 absolute_path_length;
+    // The class name of the file.
+    u16 class_name_length;
+    u32 reserved;
+};
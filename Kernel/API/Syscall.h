@@ -16,6 +16,9 @@
 constexpr int syscall_vector = 0x82;
 
 extern "C" {
+struct EventQueueEvent;
+struct IORingHeader;
+struct iovec;
 struct pollfd;
 struct timeval;
 struct timespec;
@@ -125,6 +128,8 @@ namespace Kernel {
     S(socketpair)                 \
     S(sched_setparam)             \
     S(sched_getparam)             \
+    S(sched_setaffinity)          \
+    S(sched_getaffinity)          \
     S(fchown)                     \
     S(halt)                       \
     S(reboot)                     \
@@ -180,7 +185,18 @@ namespace Kernel {
     S(readv)                      \
     S(emuctl)                     \
     S(statvfs)                    \
-    S(fstatvfs)
+    S(fstatvfs)                   \
+    S(create_event_queue)         \
+    S(event_queue_ctl)            \
+    S(event_queue_wait)           \
+    S(create_io_ring)             \
+    S(io_ring_enter)              \
+    S(sendfile)                   \
+    S(splice)                     \
+    S(map_time_page)              \
+    S(vmsplice)                   \
+    S(profiling_open_ring)        \
+    S(fallocate)
 
 namespace Syscall {
 
@@ -466,6 +482,57 @@ struct SC_statvfs_params {
     struct statvfs* buf;
 };
 
+struct SC_event_queue_ctl_params {
+    int queue_fd;
+    u32 operation;
+    int fd;
+    u32 events;
+    u64 user_data;
+};
+
+struct SC_event_queue_wait_params {
+    int queue_fd;
+    struct EventQueueEvent* events;
+    size_t max_events;
+    const struct timespec* timeout;
+};
+
+struct SC_create_io_ring_params {
+    u32 submission_entries;
+    u32 completion_entries;
+    u32 flags;
+};
+
+struct SC_sendfile_params {
+    int out_fd;
+    int in_fd;
+    i64* offset;
+    size_t count;
+};
+
+struct SC_splice_params {
+    int in_fd;
+    i64* in_offset;
+    int out_fd;
+    i64* out_offset;
+    size_t count;
+    u32 flags;
+};
+
+struct SC_vmsplice_params {
+    int fd;
+    const struct iovec* iov;
+    size_t iov_count;
+    u32 flags;
+};
+
+struct SC_fallocate_params {
+    int fd;
+    int mode;
+    i64 offset;
+    i64 length;
+};
+
 void initialize();
 int sync();
 
@@ -0,0 +1,38 @@
+/*
+ * Copyright (c) 2021, the SerenityOS developers.
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#pragma once
+
+#include <AK/Types.h>
+
+#ifdef KERNEL
+#    include <Kernel/UnixTypes.h>
+#else
+#    include <time.h>
+#endif
+
+// The kernel updates the time page on every timer tick, and processes can map
+// it read-only with sys$map_time_page. Clocks that only advance with the timer
+// tick can then be read without entering the kernel.
+//
+// The kernel increments update1, writes the clocks and then sets update2 to
+// the same value. Readers load update2, copy what they need, and retry if
+// update1 differs from it afterwards.
+
+constexpr size_t time_page_clock_count = CLOCK_MONOTONIC_COARSE + 1;
+
+struct TimePage {
+    volatile u32 update1;
+    // Bit (1 << clock_id) is set for every clock that can be read from here.
+    u32 supported_clocks;
+    struct timespec clocks[time_page_clock_count];
+    volatile u32 update2;
+};
+
+inline bool time_page_supports(const TimePage& page, clockid_t clock_id)
+{
+    return clock_id >= 0 && (size_t)clock_id < time_page_clock_count && (page.supported_clocks & (1u << clock_id));
+}
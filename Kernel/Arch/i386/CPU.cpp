@@ -55,6 +55,7 @@ extern "C" void exit_kernel_thread(void);
 extern "C" void pre_init_finished(void) __attribute__((used));
 extern "C" void post_init_finished(void) __attribute__((used));
 extern "C" void handle_interrupt(TrapFrame*) __attribute__((used));
+extern "C" void sysenter_asm_entry();
 
 // clang-format off
 
@@ -344,6 +345,16 @@ void debug_handler(TrapFrame* trap)
     auto current_thread = Thread::current();
     auto& process = current_thread->process();
     if ((regs.cs & 3) == 0) {
+        // SYSENTER doesn't clear TF, so single-stepping over it traps on the
+        // first instruction of the entry code. Let the syscall proceed, and
+        // remember that userspace is being single-stepped so sysenter_handler
+        // can set TF again in the registers it returns to.
+        if (regs.eip == FlatPtr(&sysenter_asm_entry)) {
+            regs.eflags &= ~(1u << 8);
+            current_thread->set_single_stepping_through_sysenter(true);
+            write_dr6(read_dr6() & ~(1u << 14));
+            return;
+        }
         PANIC("Debug exception in ring 0");
     }
     constexpr u8 REASON_SINGLESTEP = 14;
@@ -1091,6 +1102,15 @@ UNMAP_AFTER_INIT void Processor::cpu_setup()
         write_cr4(read_cr4() | 0x4);
     }
 
+#if ARCH(I386)
+    if (has_feature(CPUFeature::SEP)) {
+        // Userspace may enter the kernel with SYSENTER instead of "int $0x82".
+        // The stack pointer is set up on every context switch.
+        MSR(SYSENTER_CS_MSR).set(GDT_SELECTOR_CODE0, 0);
+        MSR(SYSENTER_EIP_MSR).set(FlatPtr(&sysenter_asm_entry), 0);
+    }
+#endif
+
     if (has_feature(CPUFeature::XSAVE)) {
         // Turn on CR4.OSXSAVE
         write_cr4(read_cr4() | 0x40000);
@@ -1197,10 +1217,17 @@ UNMAP_AFTER_INIT void Processor::early_initialize(u32 cpu)
     m_scheduler_initialized = false;
 
     m_message_queue = nullptr;
+    m_active_cr3 = 0;
+    m_ipis_sent = 0;
+    m_ipis_received = 0;
+    m_tlb_shootdowns_sent = 0;
+    m_tlb_shootdowns_received = 0;
     m_idle_thread = nullptr;
     m_current_thread = nullptr;
     m_scheduler_data = nullptr;
+    m_timer_wheel = nullptr;
     m_mm_data = nullptr;
+    m_slab_data = nullptr;
     m_info = nullptr;
 
     m_halt_requested = false;
@@ -1454,7 +1481,12 @@ extern "C" void enter_thread_context(Thread* from_thread, Thread* to_thread)
     tls_descriptor.set_limit(to_thread->thread_specific_region_size());
 
     if (from_tss.cr3 != to_tss.cr3)
-        write_cr3(to_tss.cr3);
+        processor.load_cr3(to_tss.cr3);
+
+#if ARCH(I386)
+    if (processor.has_feature(CPUFeature::SEP))
+        MSR(SYSENTER_ESP_MSR).set(to_tss.esp0, 0);
+#endif
 
     to_thread->set_cpu(processor.get_id());
     processor.restore_in_critical(to_thread->saved_critical());
@@ -1864,8 +1896,25 @@ void Processor::check_invoke_scheduler()
     }
 }
 
+// Past this many pages, reloading CR3 and refilling the TLB on demand is cheaper than invalidating page by page.
+static constexpr size_t max_individually_flushed_pages = 32;
+
+void Processor::load_cr3(FlatPtr cr3)
+{
+    VERIFY(&Processor::current() == this);
+    // Publish the page directory before loading it. Whoever changes its page tables and
+    // then misses this store has made the change early enough for the load to pick it up.
+    m_active_cr3.store(cr3, AK::MemoryOrder::memory_order_seq_cst);
+    write_cr3(cr3);
+}
+
 void Processor::flush_tlb_local(VirtualAddress vaddr, size_t page_count)
 {
+    if (page_count > max_individually_flushed_pages && is_user_address(vaddr)) {
+        // User pages aren't global, so they're all gone after reloading CR3.
+        flush_entire_tlb_local();
+        return;
+    }
     auto ptr = vaddr.as_ptr();
     while (page_count > 0) {
         // clang-format off
@@ -1881,7 +1930,7 @@ void Processor::flush_tlb_local(VirtualAddress vaddr, size_t page_count)
 
 void Processor::flush_tlb(const PageDirectory* page_directory, VirtualAddress vaddr, size_t page_count)
 {
-    if (s_smp_enabled && (!is_user_address(vaddr) || Process::current()->thread_count() > 1))
+    if (s_smp_enabled)
         smp_broadcast_flush_tlb(page_directory, vaddr, page_count);
     else
         flush_tlb_local(vaddr, page_count);
@@ -2044,6 +2093,7 @@ bool Processor::smp_process_pending_messages()
                 msg->invoke_callback();
                 break;
             case ProcessorMessage::FlushTlb:
+                ++m_tlb_shootdowns_received;
                 if (is_user_address(VirtualAddress(msg->flush_tlb.ptr))) {
                     // We assume that we don't cross into kernel land!
                     VERIFY(is_user_range(VirtualAddress(msg->flush_tlb.ptr), msg->flush_tlb.page_count * PAGE_SIZE));
@@ -2113,8 +2163,31 @@ void Processor::smp_broadcast_message(ProcessorMessage& msg)
         });
 
     // Now trigger an IPI on all other APs (unless all targets already had messages queued)
-    if (need_broadcast)
+    if (need_broadcast) {
         APIC::the().broadcast_ipi();
+        cur_proc.m_ipis_sent += count() - 1;
+    }
+}
+
+void Processor::smp_multicast_message(u32 cpu_mask, ProcessorMessage& msg)
+{
+    auto& cur_proc = Processor::current();
+    VERIFY(!(cpu_mask & (1u << cur_proc.get_id())));
+
+    dbgln_if(SMP_DEBUG, "SMP[{}]: Multicast message {} to cpu mask: {:#x}", cur_proc.get_id(), VirtualAddress(&msg), cpu_mask);
+
+    atomic_store(&msg.refs, (u32)__builtin_popcount(cpu_mask), AK::MemoryOrder::memory_order_release);
+    VERIFY(msg.refs > 0);
+    for_each(
+        [&](Processor& proc) {
+            if (!(cpu_mask & (1u << proc.get_id())))
+                return;
+            // Only interrupt processors that don't have messages queued already
+            if (proc.smp_queue_message(msg)) {
+                APIC::the().send_ipi(proc.get_id());
+                ++cur_proc.m_ipis_sent;
+            }
+        });
 }
 
 void Processor::smp_broadcast_wait_sync(ProcessorMessage& msg)
@@ -2159,6 +2232,7 @@ void Processor::smp_unicast_message(u32 cpu, ProcessorMessage& msg, bool async)
     atomic_store(&msg.refs, 1u, AK::MemoryOrder::memory_order_release);
     if (target_proc->smp_queue_message(msg)) {
         APIC::the().send_ipi(cpu);
+        ++cur_proc.m_ipis_sent;
     }
 
     if (!async) {
@@ -2188,17 +2262,49 @@ void Processor::smp_unicast(u32 cpu, Function<void()> callback, bool async)
 
 void Processor::smp_broadcast_flush_tlb(const PageDirectory* page_directory, VirtualAddress vaddr, size_t page_count)
 {
-    auto& msg = smp_get_from_pool();
-    msg.async = false;
-    msg.type = ProcessorMessage::FlushTlb;
-    msg.flush_tlb.page_directory = page_directory;
-    msg.flush_tlb.ptr = vaddr.as_ptr();
-    msg.flush_tlb.page_count = page_count;
-    smp_broadcast_message(msg);
-    // While the other processors handle this request, we'll flush ours
-    flush_tlb_local(vaddr, page_count);
-    // Now wait until everybody is done as well
-    smp_broadcast_wait_sync(msg);
+    u32 prev_flags;
+    auto& cur_proc = Processor::current();
+    cur_proc.enter_critical(prev_flags);
+
+    // Kernel mappings may be cached anywhere, but user mappings only on processors
+    // that have this page directory loaded. Make sure our page table changes are
+    // visible before looking, see Processor::load_cr3().
+    AK::atomic_thread_fence(AK::MemoryOrder::memory_order_seq_cst);
+    u32 cpu_mask = 0;
+    u32 other_cpus_mask = 0;
+    bool is_user = is_user_address(vaddr);
+    for_each(
+        [&](Processor& proc) {
+            if (&proc == &cur_proc)
+                return;
+            other_cpus_mask |= 1u << proc.get_id();
+            auto active_cr3 = proc.active_cr3();
+            // Processors that haven't switched page directories yet could be using any of them.
+            if (!is_user || !active_cr3 || active_cr3 == page_directory->cr3())
+                cpu_mask |= 1u << proc.get_id();
+        });
+
+    if (cpu_mask) {
+        auto& msg = smp_get_from_pool();
+        msg.async = false;
+        msg.type = ProcessorMessage::FlushTlb;
+        msg.flush_tlb.page_directory = page_directory;
+        msg.flush_tlb.ptr = vaddr.as_ptr();
+        msg.flush_tlb.page_count = page_count;
+        ++cur_proc.m_tlb_shootdowns_sent;
+        if (cpu_mask == other_cpus_mask)
+            smp_broadcast_message(msg);
+        else
+            smp_multicast_message(cpu_mask, msg);
+        // While the other processors handle this request, we'll flush ours
+        flush_tlb_local(vaddr, page_count);
+        // Now wait until everybody is done as well
+        smp_broadcast_wait_sync(msg);
+    } else {
+        flush_tlb_local(vaddr, page_count);
+    }
+
+    cur_proc.leave_critical(prev_flags);
 }
 
 void Processor::smp_broadcast_halt()
@@ -51,6 +51,9 @@ public:
         m_raw |= value & 0xfffff000;
     }
 
+    // Only meaningful for huge entries, which map a 2 MiB page instead of pointing to a page table.
+    u32 large_page_base() const { return m_raw & 0xffe00000u; }
+
     bool is_null() const { return m_raw == 0; }
     void clear() { m_raw = 0; }
 
@@ -569,9 +572,15 @@ static_assert(GDT_SELECTOR_CODE0 + 8 == GDT_SELECTOR_DATA0); // SS0 = CS0 + 8
 static_assert(GDT_SELECTOR_CODE0 + 16 == GDT_SELECTOR_CODE3); // CS3 = CS0 + 16
 static_assert(GDT_SELECTOR_CODE0 + 24 == GDT_SELECTOR_DATA3); // SS3 = CS0 + 32
 
+#define SYSENTER_CS_MSR 0x174
+#define SYSENTER_ESP_MSR 0x175
+#define SYSENTER_EIP_MSR 0x176
+
 class ProcessorInfo;
 class SchedulerPerProcessorData;
+class TimerWheel;
 struct MemoryManagerData;
+struct SlabAllocatorPerProcessorData;
 struct ProcessorMessageEntry;
 
 struct ProcessorMessage {
@@ -662,12 +671,23 @@ class Processor {
 
     ProcessorInfo* m_info;
     MemoryManagerData* m_mm_data;
+    SlabAllocatorPerProcessorData* m_slab_data;
     SchedulerPerProcessorData* m_scheduler_data;
+    TimerWheel* m_timer_wheel;
     Thread* m_current_thread;
     Thread* m_idle_thread;
 
     volatile ProcessorMessageEntry* m_message_queue; // atomic, LIFO
 
+    // The page directory this processor has loaded. TLB shootdowns for user
+    // addresses skip processors that are running with another one.
+    Atomic<FlatPtr> m_active_cr3;
+
+    Atomic<u32, AK::MemoryOrder::memory_order_relaxed> m_ipis_sent;
+    Atomic<u32, AK::MemoryOrder::memory_order_relaxed> m_ipis_received;
+    Atomic<u32, AK::MemoryOrder::memory_order_relaxed> m_tlb_shootdowns_sent;
+    Atomic<u32, AK::MemoryOrder::memory_order_relaxed> m_tlb_shootdowns_received;
+
     bool m_invoke_scheduler_async;
     bool m_scheduler_initialized;
     Atomic<bool> m_halt_requested;
@@ -687,6 +707,7 @@ class Processor {
     bool smp_queue_message(ProcessorMessage& msg);
     static void smp_unicast_message(u32 cpu, ProcessorMessage& msg, bool async);
     static void smp_broadcast_message(ProcessorMessage& msg);
+    static void smp_multicast_message(u32 cpu_mask, ProcessorMessage& msg);
     static void smp_broadcast_wait_sync(ProcessorMessage& msg);
     static void smp_broadcast_halt();
 
@@ -727,7 +748,7 @@ public:
     ALWAYS_INLINE static void wait_check()
     {
         Processor::current().smp_process_pending_messages();
-        // TODO: pause
+        asm volatile("pause");
     }
 
     [[noreturn]] static void halt();
@@ -737,6 +758,15 @@ public:
         write_cr3(read_cr3());
     }
 
+    void load_cr3(FlatPtr cr3);
+    FlatPtr active_cr3() const { return m_active_cr3.load(AK::MemoryOrder::memory_order_relaxed); }
+
+    u32 ipis_sent() const { return m_ipis_sent; }
+    u32 ipis_received() const { return m_ipis_received; }
+    void did_receive_ipi() { ++m_ipis_received; }
+    u32 tlb_shootdowns_sent() const { return m_tlb_shootdowns_sent; }
+    u32 tlb_shootdowns_received() const { return m_tlb_shootdowns_received; }
+
     static void flush_tlb_local(VirtualAddress vaddr, size_t page_count);
     static void flush_tlb(const PageDirectory*, VirtualAddress, size_t);
 
@@ -806,6 +836,26 @@ public:
         return *m_mm_data;
     }
 
+    ALWAYS_INLINE void set_timer_wheel(TimerWheel& timer_wheel)
+    {
+        m_timer_wheel = &timer_wheel;
+    }
+
+    ALWAYS_INLINE TimerWheel* timer_wheel() const
+    {
+        return m_timer_wheel;
+    }
+
+    ALWAYS_INLINE void set_slab_data(SlabAllocatorPerProcessorData& slab_data)
+    {
+        m_slab_data = &slab_data;
+    }
+
+    ALWAYS_INLINE SlabAllocatorPerProcessorData* slab_data() const
+    {
+        return m_slab_data;
+    }
+
     ALWAYS_INLINE void set_idle_thread(Thread& idle_thread)
     {
         m_idle_thread = &idle_thread;
@@ -828,6 +878,13 @@ public:
         write_fs_u32(__builtin_offsetof(Processor, m_current_thread), FlatPtr(&current_thread));
     }
 
+    // Whether this processor is currently running the given thread. This
+    // doesn't dereference the thread, so it may already be gone.
+    ALWAYS_INLINE bool is_running(const Thread& thread) const
+    {
+        return AK::atomic_load(const_cast<Thread**>(&m_current_thread), AK::MemoryOrder::memory_order_relaxed) == &thread;
+    }
+
     ALWAYS_INLINE static Thread* idle_thread()
     {
         // See comment in Processor::current_thread
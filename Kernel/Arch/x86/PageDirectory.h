@@ -24,6 +24,9 @@ public:
         m_raw |= value & 0xfffff000;
     }
 
+    // Only meaningful for huge entries, which map a 2 MiB page instead of pointing to a page table.
+    u32 large_page_base() const { return m_raw & 0xffe00000u; }
+
     bool is_null() const { return m_raw == 0; }
     void clear() { m_raw = 0; }
 
@@ -135,6 +135,7 @@ void AsyncDeviceRequest::complete(RequestResult result)
         VERIFY(m_result == Started);
         m_result = result;
     }
+    TRACEPOINT(device_request_complete, reinterpret_cast<FlatPtr>(this), result);
     if (Processor::current().in_irq()) {
         ref(); // Make sure we don't get freed
         Processor::deferred_call_queue([this]() {
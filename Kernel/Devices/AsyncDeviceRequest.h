@@ -10,6 +10,7 @@
 #include <AK/NonnullRefPtr.h>
 #include <Kernel/Process.h>
 #include <Kernel/Thread.h>
+#include <Kernel/Tracepoint.h>
 #include <Kernel/UserOrKernelBuffer.h>
 #include <Kernel/VM/ProcessPagingScope.h>
 #include <Kernel/WaitQueue.h>
@@ -68,6 +69,7 @@ public:
         m_result = Started;
         requests_lock.unlock();
 
+        TRACEPOINT(device_request_start, reinterpret_cast<FlatPtr>(this), 0, name());
         start();
     }
 
@@ -60,14 +60,15 @@ String Device::absolute_path(const FileDescription&) const
     return absolute_path();
 }
 
-void Device::process_next_queued_request(Badge<AsyncDeviceRequest>, const AsyncDeviceRequest& completed_request)
+void Device::process_next_queued_request(Badge<AsyncDeviceRequest>, const AsyncDeviceRequest&)
 {
     ScopedSpinLock lock(m_requests_lock);
-    VERIFY(!m_requests.is_empty());
-    VERIFY(m_requests.first().ptr() == &completed_request);
-    m_requests.remove(m_requests.begin());
+    VERIFY(m_requests_in_flight > 0);
+    m_requests_in_flight--;
     if (!m_requests.is_empty()) {
-        auto* next_request = m_requests.first().ptr();
+        auto next_request = m_requests.first();
+        m_requests.remove(m_requests.begin());
+        m_requests_in_flight++;
         next_request->do_start(move(lock));
     }
 
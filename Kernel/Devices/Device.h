@@ -46,6 +46,10 @@ public:
     static void for_each(Function<void(Device&)>);
     static Device* get_device(unsigned major, unsigned minor);
 
+    // How many requests the device can work on at the same time. Any further
+    // requests are queued up and started as the earlier ones complete.
+    virtual size_t max_concurrent_requests() const { return 1; }
+
     void process_next_queued_request(Badge<AsyncDeviceRequest>, const AsyncDeviceRequest&);
 
     template<typename AsyncRequestType, typename... Args>
@@ -53,10 +57,12 @@ public:
     {
         auto request = adopt_ref(*new AsyncRequestType(*this, forward<Args>(args)...));
         ScopedSpinLock lock(m_requests_lock);
-        bool was_empty = m_requests.is_empty();
-        m_requests.append(request);
-        if (was_empty)
-            request->do_start(move(lock));
+        if (m_requests_in_flight >= max_concurrent_requests()) {
+            m_requests.append(request);
+            return request;
+        }
+        m_requests_in_flight++;
+        request->do_start(move(lock));
         return request;
     }
 
@@ -74,7 +80,9 @@ private:
     gid_t m_gid { 0 };
 
     SpinLock<u8> m_requests_lock;
+    // The requests that are waiting for one of the in-flight ones to complete.
     DoublyLinkedList<RefPtr<AsyncDeviceRequest>> m_requests;
+    size_t m_requests_in_flight { 0 };
 };
 
 }
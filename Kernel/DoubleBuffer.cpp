@@ -56,6 +56,26 @@ KResultOr<size_t> DoubleBuffer::write(const UserOrKernelBuffer& data, size_t siz
     return bytes_to_write;
 }
 
+KResultOr<size_t> DoubleBuffer::write_from(UserOrKernelBufferFiller& filler, size_t size)
+{
+    if (!size || m_storage.is_null())
+        return 0;
+    Locker locker(m_lock);
+    size_t bytes_to_write = min(size, m_space_for_writing);
+    if (!bytes_to_write)
+        return 0;
+    auto buffer = UserOrKernelBuffer::for_kernel_buffer(m_write_buffer->data + m_write_buffer->size);
+    auto nwritten_or_error = filler(buffer, bytes_to_write);
+    if (nwritten_or_error.is_error() || nwritten_or_error.value() == 0)
+        return nwritten_or_error;
+    VERIFY(nwritten_or_error.value() <= bytes_to_write);
+    m_write_buffer->size += nwritten_or_error.value();
+    compute_lockfree_metadata();
+    if (m_unblock_callback && !m_empty)
+        m_unblock_callback();
+    return nwritten_or_error;
+}
+
 KResultOr<size_t> DoubleBuffer::read(UserOrKernelBuffer& data, size_t size)
 {
     if (!size || m_storage.is_null())
@@ -23,6 +23,8 @@ public:
     {
         return write(UserOrKernelBuffer::for_kernel_buffer(const_cast<u8*>(data)), size);
     }
+    // Lets the filler write straight into the free space of the buffer.
+    [[nodiscard]] KResultOr<size_t> write_from(UserOrKernelBufferFiller&, size_t);
     [[nodiscard]] KResultOr<size_t> read(UserOrKernelBuffer&, size_t);
     [[nodiscard]] KResultOr<size_t> read(u8* data, size_t size)
     {
@@ -5,9 +5,13 @@
  */
 
 #include <AK/IntrusiveList.h>
+#include <AK/QuickSort.h>
+#include <AK/Singleton.h>
 #include <Kernel/Debug.h>
 #include <Kernel/FileSystem/BlockBasedFileSystem.h>
 #include <Kernel/Process.h>
+#include <Kernel/Tasks/WriteBackTask.h>
+#include <Kernel/VM/MemoryManager.h>
 
 namespace Kernel {
 
@@ -16,44 +20,81 @@ struct CacheEntry {
     BlockBasedFS::BlockIndex block_index { 0 };
     u8* data { nullptr };
     bool has_data { false };
+    bool is_dirty { false };
 };
 
+// The cache grows and shrinks in chunks of this many entries, and never shrinks below min_chunk_count of them.
+static constexpr size_t entries_per_chunk = 256;
+static constexpr size_t min_chunk_count = 4;
+
+// Once this percentage of the cache is dirty, the write-back task starts writing it out in the background.
+// Past dirty_ratio, writers have to help out before they can dirty any more blocks.
+static constexpr size_t dirty_background_ratio = 10;
+static constexpr size_t dirty_ratio = 40;
+
+// Dirty blocks are written back this many at a time, so other users of the file system get a turn in between.
+static constexpr size_t write_back_batch_size = 256;
+
+// Dirty blocks that are next to each other on disk are gathered in a buffer of this size and written with a single request.
+static constexpr size_t coalesce_buffer_size = 64 * KiB;
+
 class DiskCache {
 public:
     explicit DiskCache(BlockBasedFS& fs)
         : m_fs(fs)
-        , m_cached_block_data(KBuffer::create_with_size(m_entry_count * m_fs.block_size()))
-        , m_entries(KBuffer::create_with_size(m_entry_count * sizeof(CacheEntry)))
+        , m_coalesce_buffer(KBuffer::try_create_with_size(coalesce_buffer_size, Region::Access::Read | Region::Access::Write, "DiskCache coalesce buffer"))
     {
-        for (size_t i = 0; i < m_entry_count; ++i) {
-            entries()[i].data = m_cached_block_data.data() + i * m_fs.block_size();
-            m_clean_list.append(entries()[i]);
-        }
+        for (size_t i = 0; i < min_chunk_count; ++i)
+            VERIFY(grow());
     }
 
-    ~DiskCache() = default;
-
-    bool is_dirty() const { return m_dirty; }
-    void set_dirty(bool b) { m_dirty = b; }
-
-    void mark_all_clean()
+    ~DiskCache()
     {
-        while (auto* entry = m_dirty_list.first())
-            m_clean_list.prepend(*entry);
-        m_dirty = false;
+        m_clean_list.clear();
+        m_dirty_list.clear();
     }
 
+    bool is_dirty() const { return m_dirty_count > 0; }
+    size_t entry_count() const { return m_chunks.size() * entries_per_chunk; }
+    size_t dirty_count() const { return m_dirty_count; }
+    size_t dirty_percentage() const { return m_dirty_count * 100 / entry_count(); }
+
+    BlockBasedFS::CacheStatistics& statistics() const { return m_statistics; }
+    KBuffer* coalesce_buffer() { return m_coalesce_buffer.ptr(); }
+
     void mark_dirty(CacheEntry& entry)
     {
+        if (!entry.is_dirty) {
+            entry.is_dirty = true;
+            ++m_dirty_count;
+        }
         m_dirty_list.prepend(entry);
-        m_dirty = true;
     }
 
     void mark_clean(CacheEntry& entry)
     {
+        if (entry.is_dirty) {
+            entry.is_dirty = false;
+            --m_dirty_count;
+        }
         m_clean_list.prepend(entry);
     }
 
+    // Forgets the contents of the entry, including changes that haven't been written back yet.
+    void invalidate(CacheEntry& entry)
+    {
+        mark_clean(entry);
+        entry.has_data = false;
+    }
+
+    CacheEntry* find(BlockBasedFS::BlockIndex block_index) const
+    {
+        auto it = m_hash.find(block_index);
+        if (it == m_hash.end() || !it->value->has_data)
+            return nullptr;
+        return it->value;
+    }
+
     CacheEntry& get(BlockBasedFS::BlockIndex block_index) const
     {
         if (auto it = m_hash.find(block_index); it != m_hash.end()) {
@@ -62,11 +103,20 @@ public:
             return entry;
         }
 
+        // Rather than throw away a block we already have, see if there's enough memory to grow instead.
+        auto* least_recently_used = m_clean_list.last();
+        if ((!least_recently_used || least_recently_used->has_data) && should_grow())
+            const_cast<DiskCache&>(*this).grow();
+
         if (m_clean_list.is_empty()) {
-            // Not a single clean entry! Flush writes and try again.
-            // NOTE: We want to make sure we only call FileBackedFS flush here,
-            //       not some FileBackedFS subclass flush!
-            m_fs.flush_writes_impl();
+            // Not a single clean entry, and no memory to grow into! Write some back and try again.
+            // NOTE: We want to make sure we only write back the BlockBasedFS cache here,
+            //       not do some BlockBasedFS subclass flush!
+            ++m_statistics.throttled_writes;
+            if (!m_fs.write_back_dirty_blocks(write_back_batch_size)) {
+                // None of them could be written back, so growing is the only way left to make room.
+                VERIFY(const_cast<DiskCache&>(*this).grow());
+            }
             return get(block_index);
         }
 
@@ -74,7 +124,7 @@ public:
         auto& new_entry = *m_clean_list.last();
         m_clean_list.prepend(new_entry);
 
-        m_hash.remove(new_entry.block_index);
+        remove_from_hash(new_entry);
         m_hash.set(block_index, &new_entry);
 
         new_entry.block_index = block_index;
@@ -83,35 +133,131 @@ public:
         return new_entry;
     }
 
-    const CacheEntry* entries() const { return (const CacheEntry*)m_entries.data(); }
-    CacheEntry* entries() { return (CacheEntry*)m_entries.data(); }
-
     template<typename Callback>
-    void for_each_dirty_entry(Callback callback)
+    void for_each_dirty_entry_oldest_first(Callback callback)
+    {
+        for (auto it = m_dirty_list.rbegin(); it != m_dirty_list.rend(); ++it) {
+            if (callback(*it) == IterationDecision::Break)
+                break;
+        }
+    }
+
+    bool should_grow() const
     {
-        for (auto& entry : m_dirty_list)
-            callback(entry);
+        // Only grow while more than a quarter of memory is free, and never take more than an eighth of it.
+        size_t total_pages = MM.user_physical_pages();
+        size_t cache_pages = entry_count() * m_fs.block_size() / PAGE_SIZE;
+        size_t chunk_pages = entries_per_chunk * m_fs.block_size() / PAGE_SIZE;
+        return free_user_physical_pages() > total_pages / 4 && cache_pages + chunk_pages <= total_pages / 8;
+    }
+
+    bool should_shrink() const
+    {
+        return m_chunks.size() > min_chunk_count && free_user_physical_pages() < MM.user_physical_pages() / 8;
+    }
+
+    bool grow()
+    {
+        auto block_data = KBuffer::try_create_with_size(entries_per_chunk * m_fs.block_size(), Region::Access::Read | Region::Access::Write, "DiskCache");
+        if (!block_data)
+            return false;
+        auto chunk = adopt_own_if_nonnull(new Chunk(block_data.release_nonnull()));
+        if (!chunk)
+            return false;
+        for (size_t i = 0; i < entries_per_chunk; ++i)
+            chunk->entries[i].data = chunk->block_data->data() + i * m_fs.block_size();
+        if (!m_chunks.try_append(chunk.release_nonnull()))
+            return false;
+        // New entries go to the least recently used end of the clean list, so they get used first.
+        for (auto& entry : m_chunks.last()->entries)
+            m_clean_list.append(entry);
+        ++m_statistics.grow_count;
+        return true;
+    }
+
+    // Gives back the chunk that was added last. Its dirty entries have to be written back first.
+    bool shrink(Vector<CacheEntry*>& dirty_entries)
+    {
+        if (m_chunks.size() <= min_chunk_count)
+            return false;
+        auto& chunk = *m_chunks.last();
+        for (auto& entry : chunk.entries) {
+            if (entry.is_dirty)
+                dirty_entries.append(&entry);
+        }
+        if (!dirty_entries.is_empty())
+            return false;
+        for (auto& entry : chunk.entries) {
+            remove_from_hash(entry);
+            m_clean_list.remove(entry);
+        }
+        m_chunks.take_last();
+        ++m_statistics.shrink_count;
+        return true;
     }
 
 private:
+    struct Chunk {
+        explicit Chunk(NonnullOwnPtr<KBuffer> data)
+            : block_data(move(data))
+        {
+        }
+
+        NonnullOwnPtr<KBuffer> block_data;
+        CacheEntry entries[entries_per_chunk];
+    };
+
+    static size_t free_user_physical_pages()
+    {
+        size_t unavailable_pages = MM.user_physical_pages_used() + MM.user_physical_pages_committed();
+        return MM.user_physical_pages() - min(unavailable_pages, static_cast<size_t>(MM.user_physical_pages()));
+    }
+
+    void remove_from_hash(CacheEntry& entry) const
+    {
+        auto it = m_hash.find(entry.block_index);
+        if (it != m_hash.end() && it->value == &entry)
+            m_hash.remove(it);
+    }
+
     BlockBasedFS& m_fs;
-    size_t m_entry_count { 10000 };
     mutable HashMap<BlockBasedFS::BlockIndex, CacheEntry*> m_hash;
     mutable IntrusiveList<CacheEntry, RawPtr<CacheEntry>, &CacheEntry::list_node> m_clean_list;
     mutable IntrusiveList<CacheEntry, RawPtr<CacheEntry>, &CacheEntry::list_node> m_dirty_list;
-    KBuffer m_cached_block_data;
-    KBuffer m_entries;
-    bool m_dirty { false };
+    Vector<NonnullOwnPtr<Chunk>> m_chunks;
+    OwnPtr<KBuffer> m_coalesce_buffer;
+    size_t m_dirty_count { 0 };
+    mutable BlockBasedFS::CacheStatistics m_statistics;
 };
 
+static SpinLock s_all_instances_lock;
+static AK::Singleton<BlockBasedFS::List> s_all_instances;
+
+NonnullRefPtrVector<BlockBasedFS> BlockBasedFS::all_instances()
+{
+    NonnullRefPtrVector<BlockBasedFS> instances;
+    ScopedSpinLock lock(s_all_instances_lock);
+    for (auto& fs : *s_all_instances) {
+        // A file system stays on the list until its destructor has run, which is
+        // after its last reference was dropped. Those can't be handed out anymore.
+        if (fs.try_ref())
+            instances.append(adopt_ref(fs));
+    }
+    return instances;
+}
+
 BlockBasedFS::BlockBasedFS(FileDescription& file_description)
     : FileBackedFS(file_description)
 {
     VERIFY(file_description.file().is_seekable());
+    ScopedSpinLock lock(s_all_instances_lock);
+    s_all_instances->append(*this);
 }
 
 BlockBasedFS::~BlockBasedFS()
 {
+    ScopedSpinLock lock(s_all_instances_lock);
+    s_all_instances->remove(*this);
 }
 
 KResult BlockBasedFS::write_block(BlockIndex index, const UserOrKernelBuffer& data, size_t count, size_t offset, bool allow_cache)
@@ -122,7 +268,9 @@ KResult BlockBasedFS::write_block(BlockIndex index, const UserOrKernelBuffer& da
     dbgln_if(BBFS_DEBUG, "BlockBasedFileSystem::write_block {}, size={}", index, count);
 
     if (!allow_cache) {
-        flush_specific_block_if_needed(index);
+        // The write may only cover part of the block, so the rest of any changes to it must be on disk first.
+        if (auto result = flush_specific_block_if_needed(index); result.is_error())
+            return result;
         u32 base_offset = index.value() * block_size() + offset;
         auto seek_result = file_description().seek(base_offset, SEEK_SET);
         if (seek_result.is_error())
@@ -131,6 +279,9 @@ KResult BlockBasedFS::write_block(BlockIndex index, const UserOrKernelBuffer& da
         if (nwritten.is_error())
             return nwritten.error();
         VERIFY(nwritten.value() == count);
+        // Whatever we had cached for this block is stale now.
+        if (auto* entry = cache().find(index))
+            cache().invalidate(*entry);
         return KSuccess;
     }
 
@@ -146,6 +297,14 @@ KResult BlockBasedFS::write_block(BlockIndex index, const UserOrKernelBuffer& da
 
     cache().mark_dirty(entry);
     entry.has_data = true;
+
+    if (cache().dirty_percentage() >= dirty_ratio) {
+        // There's too much dirty data already, help write some of it back before making more.
+        ++cache().statistics().throttled_writes;
+        write_back_dirty_blocks(write_back_batch_size);
+    } else if (cache().dirty_percentage() >= dirty_background_ratio) {
+        WriteBackTask::wake();
+    }
     return KSuccess;
 }
 
@@ -218,7 +377,8 @@ KResult BlockBasedFS::read_block(BlockIndex index, UserOrKernelBuffer* buffer, s
     dbgln_if(BBFS_DEBUG, "BlockBasedFileSystem::read_block {}", index);
 
     if (!allow_cache) {
-        const_cast<BlockBasedFS*>(this)->flush_specific_block_if_needed(index);
+        if (auto result = const_cast<BlockBasedFS*>(this)->flush_specific_block_if_needed(index); result.is_error())
+            return result;
         auto base_offset = index.value() * block_size() + offset;
         auto seek_result = file_description().seek(base_offset, SEEK_SET);
         if (seek_result.is_error())
@@ -231,7 +391,10 @@ KResult BlockBasedFS::read_block(BlockIndex index, UserOrKernelBuffer* buffer, s
     }
 
     auto& entry = cache().get(index);
-    if (!entry.has_data) {
+    if (entry.has_data) {
+        ++cache().statistics().hits;
+    } else {
+        ++cache().statistics().misses;
         auto base_offset = index.value() * block_size();
         auto seek_result = file_description().seek(base_offset, SEEK_SET);
         if (seek_result.is_error())
@@ -267,27 +430,135 @@ KResult BlockBasedFS::read_blocks(BlockIndex index, unsigned count, UserOrKernel
     return KSuccess;
 }
 
-void BlockBasedFS::flush_specific_block_if_needed(BlockIndex index)
+KResult BlockBasedFS::read_blocks_directly(BlockIndex index, unsigned count, UserOrKernelBuffer& buffer) const
 {
     Locker locker(m_lock);
-    if (!cache().is_dirty())
-        return;
-    Vector<CacheEntry*, 32> cleaned_entries;
-    cache().for_each_dirty_entry([&](CacheEntry& entry) {
-        if (entry.block_index != index) {
-            size_t base_offset = entry.block_index.value() * block_size();
-            auto seek_result = file_description().seek(base_offset, SEEK_SET);
-            VERIFY(!seek_result.is_error());
-            // FIXME: Should this error path be surfaced somehow?
-            auto entry_data_buffer = UserOrKernelBuffer::for_kernel_buffer(entry.data);
-            [[maybe_unused]] auto rc = file_description().write(entry_data_buffer, block_size());
-            cleaned_entries.append(&entry);
+    VERIFY(m_logical_block_size);
+    dbgln_if(BBFS_DEBUG, "BlockBasedFileSystem::read_blocks_directly {}, count={}", index, count);
+
+    // Read the whole run from the device without going through the cache,
+    // so it becomes as few requests as the device allows.
+    auto seek_result = file_description().seek(index.value() * block_size(), SEEK_SET);
+    if (seek_result.is_error())
+        return seek_result.error();
+    size_t total_size = count * block_size();
+    size_t nread = 0;
+    while (nread < total_size) {
+        auto out = buffer.offset(nread);
+        auto nread_or_error = file_description().read(out, total_size - nread);
+        if (nread_or_error.is_error())
+            return nread_or_error.error();
+        if (nread_or_error.value() == 0)
+            return EIO;
+        nread += nread_or_error.value();
+    }
+
+    // Blocks that are in the cache may have been written to since they were
+    // last flushed, so their cached contents are the ones that count.
+    for (unsigned i = 0; i < count; ++i) {
+        auto* entry = cache().find(BlockIndex { index.value() + i });
+        if (entry && !buffer.write(entry->data, i * block_size(), block_size()))
+            return EFAULT;
+    }
+    return KSuccess;
+}
+
+KResult BlockBasedFS::flush_specific_block_if_needed(BlockIndex index)
+{
+    Locker locker(m_lock);
+    auto* entry = cache().find(index);
+    if (!entry || !entry->is_dirty)
+        return KSuccess;
+    CacheEntry* entries[] = { entry };
+    return write_back_entries(entries);
+}
+
+KResult BlockBasedFS::write_to_device(BlockIndex index, const UserOrKernelBuffer& data, size_t size)
+{
+    auto seek_result = file_description().seek(index.value() * block_size(), SEEK_SET);
+    if (seek_result.is_error())
+        return seek_result.error();
+    size_t nwritten = 0;
+    while (nwritten < size) {
+        auto nwritten_or_error = file_description().write(data.offset(nwritten), size - nwritten);
+        if (nwritten_or_error.is_error())
+            return nwritten_or_error.error();
+        if (nwritten_or_error.value() == 0)
+            return EIO;
+        nwritten += nwritten_or_error.value();
+    }
+    return KSuccess;
+}
+
+KResult BlockBasedFS::write_back_entries(Span<CacheEntry*> entries)
+{
+    VERIFY(m_lock.is_locked());
+    auto& cache = this->cache();
+    auto* coalesce_buffer = cache.coalesce_buffer();
+    size_t max_run_length = coalesce_buffer ? coalesce_buffer->size() / block_size() : 1;
+    KResult error = KSuccess;
+
+    for (size_t i = 0; i < entries.size();) {
+        auto first_block_index = entries[i]->block_index;
+        size_t run_length = 1;
+        while (i + run_length < entries.size()
+            && run_length < max_run_length
+            && entries[i + run_length]->block_index.value() == first_block_index.value() + run_length)
+            ++run_length;
+
+        u8* data = entries[i]->data;
+        if (run_length > 1) {
+            for (size_t j = 0; j < run_length; ++j)
+                memcpy(coalesce_buffer->data() + j * block_size(), entries[i + j]->data, block_size());
+            data = coalesce_buffer->data();
         }
+        auto result = write_to_device(first_block_index, UserOrKernelBuffer::for_kernel_buffer(data), run_length * block_size());
+        if (result.is_error()) {
+            dbgln("{}: Failed to write back {} blocks at {}: {}", class_name(), run_length, first_block_index, result.error());
+            if (error.is_success())
+                error = result;
+            // Keep the data around, but let the next batch try other blocks first.
+            for (size_t j = 0; j < run_length; ++j)
+                cache.mark_dirty(*entries[i + j]);
+        } else {
+            for (size_t j = 0; j < run_length; ++j)
+                cache.mark_clean(*entries[i + j]);
+            cache.statistics().written_blocks += run_length;
+        }
+
+        ++cache.statistics().write_requests;
+        i += run_length;
+    }
+
+    // Whoever syncs next has to hear about this, even if it happened in the background.
+    if (error.is_error() && m_write_back_error.is_success())
+        m_write_back_error = error;
+    return error;
+}
+
+size_t BlockBasedFS::write_back_dirty_blocks(size_t max_count)
+{
+    Locker locker(m_lock);
+    if (!cache().is_dirty())
+        return 0;
+
+    Vector<CacheEntry*> entries;
+    cache().for_each_dirty_entry_oldest_first([&](CacheEntry& entry) {
+        if (!entries.try_append(&entry))
+            return entries.is_empty() ? IterationDecision::Continue : IterationDecision::Break;
+        return entries.size() < max_count ? IterationDecision::Continue : IterationDecision::Break;
     });
-    // NOTE: We make a separate pass to mark entries clean since marking them clean
-    //       moves them out of the dirty list which would disturb the iteration above.
-    for (auto* entry : cleaned_entries)
-        cache().mark_clean(*entry);
+    if (entries.is_empty())
+        return 0;
+
+    quick_sort(entries, [](auto* a, auto* b) { return a->block_index < b->block_index; });
+    (void)write_back_entries(entries.span());
+    size_t written_count = 0;
+    for (auto* entry : entries) {
+        if (!entry->is_dirty)
+            ++written_count;
+    }
+    return written_count;
 }
 
 void BlockBasedFS::flush_writes_impl()
@@ -295,17 +566,9 @@ void BlockBasedFS::flush_writes_impl()
     Locker locker(m_lock);
     if (!cache().is_dirty())
         return;
-    u32 count = 0;
-    cache().for_each_dirty_entry([&](CacheEntry& entry) {
-        u32 base_offset = entry.block_index.value() * block_size();
-        auto seek_result = file_description().seek(base_offset, SEEK_SET);
-        VERIFY(!seek_result.is_error());
-        // FIXME: Should this error path be surfaced somehow?
-        auto entry_data_buffer = UserOrKernelBuffer::for_kernel_buffer(entry.data);
-        [[maybe_unused]] auto rc = file_description().write(entry_data_buffer, block_size());
-        ++count;
-    });
-    cache().mark_all_clean();
+    size_t count = 0;
+    while (size_t written = write_back_dirty_blocks(write_back_batch_size))
+        count += written;
     dbgln("{}: Flushed {} blocks to disk", class_name(), count);
 }
 
@@ -314,6 +577,61 @@ void BlockBasedFS::flush_writes()
     flush_writes_impl();
 }
 
+void BlockBasedFS::write_back_if_needed()
+{
+    allocate_delayed_blocks();
+
+    // Once woken up, get well below the threshold so we aren't woken up again right away.
+    // Every batch takes the lock again, so writers don't have to wait for all of it.
+    for (;;) {
+        Locker locker(m_lock);
+        if (!m_cache || cache().dirty_percentage() < dirty_background_ratio / 2)
+            break;
+        if (!write_back_dirty_blocks(write_back_batch_size))
+            break;
+    }
+
+    // Give memory back if the system is running low on it.
+    for (;;) {
+        Locker locker(m_lock);
+        if (!m_cache || !cache().should_shrink())
+            break;
+        Vector<CacheEntry*> dirty_entries;
+        if (cache().shrink(dirty_entries))
+            continue;
+        if (dirty_entries.is_empty())
+            break;
+        quick_sort(dirty_entries, [](auto* a, auto* b) { return a->block_index < b->block_index; });
+        if (write_back_entries(dirty_entries.span()).is_error())
+            break;
+    }
+}
+
+void BlockBasedFS::write_back_all()
+{
+    for (auto& fs : all_instances())
+        fs.write_back_if_needed();
+}
+
+KResult BlockBasedFS::take_write_error()
+{
+    Locker locker(m_lock);
+    auto error = m_write_back_error;
+    m_write_back_error = KSuccess;
+    return error;
+}
+
+BlockBasedFS::CacheStatistics BlockBasedFS::cache_statistics() const
+{
+    Locker locker(m_lock);
+    if (!m_cache)
+        return {};
+    auto statistics = cache().statistics();
+    statistics.entry_count = cache().entry_count();
+    statistics.dirty_count = cache().dirty_count();
+    return statistics;
+}
+
 DiskCache& BlockBasedFS::cache() const
 {
     if (!m_cache)
@@ -6,11 +6,17 @@
 
 #pragma once
 
+#include <AK/IntrusiveList.h>
+#include <AK/NonnullRefPtrVector.h>
 #include <Kernel/FileSystem/FileBackedFileSystem.h>
 
 namespace Kernel {
 
+struct CacheEntry;
+
 class BlockBasedFS : public FileBackedFS {
+    friend class DiskCache;
+
 public:
     TYPEDEF_DISTINCT_ORDERED_ID(u64, BlockIndex);
 
@@ -20,12 +26,33 @@ public:
 
     virtual void flush_writes() override;
     void flush_writes_impl();
+    virtual KResult take_write_error() override;
+
+    struct CacheStatistics {
+        size_t entry_count { 0 };
+        size_t dirty_count { 0 };
+        u64 hits { 0 };
+        u64 misses { 0 };
+        u64 written_blocks { 0 };
+        u64 write_requests { 0 };
+        u64 throttled_writes { 0 };
+        u64 grow_count { 0 };
+        u64 shrink_count { 0 };
+    };
+    CacheStatistics cache_statistics() const;
+
+    static NonnullRefPtrVector<BlockBasedFS> all_instances();
+
+    // Called by the WriteBackTask to keep the amount of dirty data in check,
+    // and to shrink the caches when memory is getting tight.
+    static void write_back_all();
 
 protected:
     explicit BlockBasedFS(FileDescription&);
 
     KResult read_block(BlockIndex, UserOrKernelBuffer*, size_t count, size_t offset = 0, bool allow_cache = true) const;
     KResult read_blocks(BlockIndex, unsigned count, UserOrKernelBuffer&, bool allow_cache = true) const;
+    KResult read_blocks_directly(BlockIndex, unsigned count, UserOrKernelBuffer&) const;
 
     bool raw_read(BlockIndex, UserOrKernelBuffer&);
     bool raw_write(BlockIndex, const UserOrKernelBuffer&);
@@ -36,13 +63,29 @@ protected:
     KResult write_block(BlockIndex, const UserOrKernelBuffer&, size_t count, size_t offset = 0, bool allow_cache = true);
     KResult write_blocks(BlockIndex, unsigned count, const UserOrKernelBuffer&, bool allow_cache = true);
 
+    // Called by the WriteBackTask before it writes back dirty blocks. File systems that put
+    // off allocating blocks for written data give it a place on disk here.
+    virtual void allocate_delayed_blocks() { }
+
     size_t m_logical_block_size { 512 };
 
 private:
     DiskCache& cache() const;
-    void flush_specific_block_if_needed(BlockIndex index);
+    KResult flush_specific_block_if_needed(BlockIndex index);
+
+    void write_back_if_needed();
+    // Returns how many of the blocks were written back successfully.
+    size_t write_back_dirty_blocks(size_t max_count);
+    // Blocks that couldn't be written back stay dirty.
+    KResult write_back_entries(Span<CacheEntry*>);
+    KResult write_to_device(BlockIndex, const UserOrKernelBuffer&, size_t);
 
     mutable OwnPtr<DiskCache> m_cache;
+    KResult m_write_back_error { KSuccess };
+    IntrusiveListNode<BlockBasedFS> m_list_node;
+
+public:
+    using List = IntrusiveList<BlockBasedFS, RawPtr<BlockBasedFS>, &BlockBasedFS::m_list_node>;
 };
 
 }
@@ -0,0 +1,139 @@
+/*
+ * Copyright (c) 2021, the SerenityOS developers.
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#include <AK/Singleton.h>
+#include <Kernel/FileSystem/Custody.h>
+#include <Kernel/FileSystem/DentryCache.h>
+#include <Kernel/FileSystem/FileSystem.h>
+#include <Kernel/FileSystem/Inode.h>
+
+namespace Kernel {
+
+static AK::Singleton<DentryCache> s_the;
+
+DentryCache& DentryCache::the()
+{
+    return *s_the;
+}
+
+DentryCache::DentryCache()
+{
+}
+
+NonnullOwnPtr<DentryCache::Entry> DentryCache::take_locked(Entry& entry)
+{
+    VERIFY(m_lock.is_locked());
+    m_lru.remove(entry);
+    auto it = m_entries.find(entry.key());
+    VERIFY(it != m_entries.end());
+    auto owned_entry = move(it->value);
+    m_entries.remove(it);
+    return owned_entry;
+}
+
+RefPtr<Inode> DentryCache::lookup(Inode& parent, StringView name)
+{
+    if (!parent.fs().supports_watchers())
+        return parent.lookup(name);
+
+    Key key { parent.identifier(), name };
+    auto hash = KeyTraits::hash(key);
+    u32 generation;
+    {
+        Locker locker(m_lock);
+        if (auto it = m_entries.find(key); it != m_entries.end()) {
+            auto& entry = *it->value;
+            m_lru.remove(entry);
+            m_lru.prepend(entry);
+            ++m_hits;
+            return entry.inode;
+        }
+        generation = generation_locked(hash);
+    }
+    ++m_misses;
+
+    auto child = parent.lookup(name);
+
+    auto name_kstring = KString::try_create(name);
+    if (!name_kstring)
+        return child;
+    auto new_entry = adopt_own_if_nonnull(new Entry(name_kstring.release_nonnull(), parent.identifier(), child));
+    if (!new_entry)
+        return child;
+
+    EntryVector evicted_entries;
+    Locker locker(m_lock);
+    if (generation_locked(hash) != generation || m_entries.contains(key))
+        return child;
+
+    auto& entry = *new_entry;
+    m_entries.set(entry.key(), new_entry.release_nonnull());
+    m_lru.prepend(entry);
+    while (m_entries.size() > max_entries)
+        evicted_entries.append(take_locked(*m_lru.last()));
+    return child;
+}
+
+KResultOr<NonnullRefPtr<Custody>> DentryCache::custody_for(Custody& parent, StringView name, Inode& child, int mount_flags)
+{
+    Key key { parent.inode().identifier(), name };
+    {
+        Locker locker(m_lock);
+        auto it = m_entries.find(key);
+        if (it == m_entries.end())
+            return Custody::try_create(&parent, name, child, mount_flags);
+        // The parent custody is compared by identity, so a directory that was
+        // reached through a different path (or mount) never gets a stale name.
+        auto& custody = it->value->custody;
+        if (custody && custody->parent() == &parent && &custody->inode() == &child && custody->mount_flags() == mount_flags)
+            return NonnullRefPtr<Custody>(*custody);
+    }
+
+    auto custody_or_error = Custody::try_create(&parent, name, child, mount_flags);
+    if (custody_or_error.is_error())
+        return custody_or_error;
+
+    RefPtr<Custody> replaced_custody;
+    Locker locker(m_lock);
+    if (auto it = m_entries.find(key); it != m_entries.end())
+        replaced_custody = exchange(it->value->custody, custody_or_error.value());
+    return custody_or_error;
+}
+
+void DentryCache::invalidate(InodeIdentifier parent, StringView name)
+{
+    Key key { parent, name };
+    OwnPtr<Entry> removed_entry;
+    Locker locker(m_lock);
+    ++m_generations[KeyTraits::hash(key) % generation_count];
+    if (auto it = m_entries.find(key); it != m_entries.end())
+        removed_entry = take_locked(*it->value);
+}
+
+void DentryCache::invalidate_children_of(InodeIdentifier parent)
+{
+    EntryVector removed_entries;
+    Locker locker(m_lock);
+    ++m_generation;
+    Vector<Entry*> children;
+    for (auto& entry : m_lru) {
+        if (entry.parent == parent)
+            children.append(&entry);
+    }
+    for (auto* entry : children)
+        removed_entries.append(take_locked(*entry));
+}
+
+void DentryCache::invalidate_all()
+{
+    EntryVector removed_entries;
+    Locker locker(m_lock);
+    ++m_generation;
+    while (!m_lru.is_empty())
+        removed_entries.append(take_locked(*m_lru.first()));
+}
+
+}
@@ -0,0 +1,108 @@
+/*
+ * Copyright (c) 2021, the SerenityOS developers.
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#pragma once
+
+#include <AK/Array.h>
+#include <AK/Atomic.h>
+#include <AK/HashFunctions.h>
+#include <AK/HashMap.h>
+#include <AK/IntrusiveList.h>
+#include <AK/NonnullOwnPtr.h>
+#include <AK/RefPtr.h>
+#include <AK/StringView.h>
+#include <AK/Vector.h>
+#include <Kernel/FileSystem/InodeIdentifier.h>
+#include <Kernel/Forward.h>
+#include <Kernel/KResult.h>
+#include <Kernel/KString.h>
+#include <Kernel/Lock.h>
+
+namespace Kernel {
+
+// The dentry cache remembers what a name in a directory resolved to, including
+// names that don't exist, so that path resolution doesn't have to search the
+// directory again. Only file systems that report changes to their directories
+// through Inode::did_add_child() and Inode::did_remove_child() are cached
+// (see FS::supports_watchers()), as those notifications keep the cache coherent.
+//
+// Each entry can also hold on to the Custody that was last created for it,
+// which is handed out again as long as it still describes the same path.
+class DentryCache {
+    AK_MAKE_NONCOPYABLE(DentryCache);
+    AK_MAKE_NONMOVABLE(DentryCache);
+
+public:
+    static DentryCache& the();
+
+    DentryCache();
+
+    // Returns the child of the directory with the given name, or null if there is none.
+    RefPtr<Inode> lookup(Inode& parent, StringView name);
+    KResultOr<NonnullRefPtr<Custody>> custody_for(Custody& parent, StringView name, Inode& child, int mount_flags);
+
+    void invalidate(InodeIdentifier parent, StringView name);
+    void invalidate_children_of(InodeIdentifier parent);
+    // Used when something is mounted or unmounted, which changes what cached custodies refer to.
+    void invalidate_all();
+
+    size_t hits() const { return m_hits; }
+    size_t misses() const { return m_misses; }
+
+private:
+    struct Key {
+        InodeIdentifier parent;
+        StringView name;
+
+        bool operator==(const Key& other) const { return parent == other.parent && name == other.name; }
+    };
+
+    struct KeyTraits : public GenericTraits<Key> {
+        static unsigned hash(const Key& key) { return pair_int_hash(pair_int_hash(key.parent.fsid(), key.parent.index().value()), key.name.hash()); }
+    };
+
+    struct Entry {
+        Entry(NonnullOwnPtr<KString> name, InodeIdentifier parent, RefPtr<Inode> inode)
+            : name(move(name))
+            , parent(parent)
+            , inode(move(inode))
+        {
+        }
+
+        Key key() const { return { parent, name->view() }; }
+
+        NonnullOwnPtr<KString> name;
+        InodeIdentifier parent;
+        // Null for names that don't exist.
+        RefPtr<Inode> inode;
+        RefPtr<Custody> custody;
+        IntrusiveListNode<Entry> lru_list_node;
+    };
+
+    // Entries are destroyed only after the cache is unlocked, since dropping
+    // the last reference to an inode or custody can call into the file system.
+    using EntryVector = Vector<NonnullOwnPtr<Entry>>;
+
+    static constexpr size_t max_entries = 4096;
+    static constexpr size_t generation_count = 64;
+
+    u32 generation_locked(unsigned hash) const { return m_generation + m_generations[hash % generation_count]; }
+    NonnullOwnPtr<Entry> take_locked(Entry&);
+
+    HashMap<Key, NonnullOwnPtr<Entry>, KeyTraits> m_entries;
+    IntrusiveList<Entry, RawPtr<Entry>, &Entry::lru_list_node> m_lru;
+
+    // A lookup that misses only adds its result if nothing that could have
+    // changed it was invalidated while the file system was being searched.
+    u32 m_generation { 0 };
+    Array<u32, generation_count> m_generations {};
+
+    Lock m_lock { "DentryCache" };
+    Atomic<size_t, AK::MemoryOrder::memory_order_relaxed> m_hits { 0 };
+    Atomic<size_t, AK::MemoryOrder::memory_order_relaxed> m_misses { 0 };
+};
+
+}
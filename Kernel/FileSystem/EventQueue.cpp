@@ -0,0 +1,210 @@
+/*
+ * Copyright (c) 2021, the SerenityOS developers.
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#include <Kernel/FileSystem/EventQueue.h>
+#include <Kernel/FileSystem/FileDescription.h>
+
+namespace Kernel {
+
+using BlockFlags = Thread::FileBlocker::BlockFlags;
+
+KResultOr<NonnullRefPtr<EventQueue>> EventQueue::create()
+{
+    auto queue = adopt_ref_if_nonnull(new EventQueue);
+    if (queue)
+        return queue.release_nonnull();
+    return ENOMEM;
+}
+
+EventQueue::~EventQueue()
+{
+    // NOTE: This isn't done in close(), since that is called whenever any
+    //       description of the queue is closed, e.g. by a forked child.
+    Locker locker(m_lock);
+    m_interests.clear();
+}
+
+bool EventQueue::can_read(const FileDescription&, size_t) const
+{
+    ScopedSpinLock lock(m_ready_lock);
+    return !m_ready_list.is_empty();
+}
+
+KResult EventQueue::add_interest(int fd, FileDescription& description, EventQueueEvents events, u64 user_data)
+{
+    Locker locker(m_lock);
+    if (auto it = m_interests.find(fd); it != m_interests.end()) {
+        // A description that is no longer the one behind this fd was closed
+        // without being removed first, so we can safely replace it.
+        if (it->value->description() == &description)
+            return EEXIST;
+        m_interests.remove(it);
+    }
+
+    auto interest = adopt_own_if_nonnull(new Interest(*this, fd, description, events, user_data));
+    if (!interest)
+        return ENOMEM;
+    m_interests.set(fd, interest.release_nonnull());
+    return KSuccess;
+}
+
+KResult EventQueue::modify_interest(int fd, FileDescription& description, EventQueueEvents events, u64 user_data)
+{
+    Locker locker(m_lock);
+    auto it = m_interests.find(fd);
+    if (it == m_interests.end())
+        return ENOENT;
+
+    // Re-registering picks up the new event mask and reports the file right
+    // away if it is already ready for any of the new events.
+    auto interest = adopt_own_if_nonnull(new Interest(*this, fd, description, events, user_data));
+    if (!interest)
+        return ENOMEM;
+    m_interests.set(fd, interest.release_nonnull());
+    return KSuccess;
+}
+
+KResult EventQueue::remove_interest(int fd)
+{
+    Locker locker(m_lock);
+    if (!m_interests.remove(fd))
+        return ENOENT;
+    return KSuccess;
+}
+
+size_t EventQueue::collect_events(Span<EventQueueEvent> events)
+{
+    Locker locker(m_lock);
+
+    // Take everything that is currently queued. Interests that become ready
+    // while we look at them will be queued again on the ready list, so no
+    // notification is lost.
+    ReadyList pending;
+    {
+        ScopedSpinLock lock(m_ready_lock);
+        while (auto* interest = m_ready_list.take_first())
+            pending.append(*interest);
+    }
+
+    size_t count = 0;
+    while (count < events.size()) {
+        Interest* interest;
+        {
+            ScopedSpinLock lock(m_ready_lock);
+            interest = pending.take_first();
+        }
+        if (!interest)
+            break;
+
+        // The description was closed without removing the interest first.
+        if (!interest->description()) {
+            m_interests.remove(interest->fd());
+            continue;
+        }
+
+        // Query the file without holding any spinlocks, can_read() and
+        // can_write() are allowed to take locks of their own, and the
+        // description may go away when we drop our reference to it.
+        auto ready_events = interest->ready_events();
+        if (ready_events == EventQueueEvents::None)
+            continue;
+
+        events[count++] = { static_cast<u32>(ready_events), interest->user_data() };
+
+        if (!has_flag(interest->events(), EventQueueEvents::EdgeTriggered)) {
+            // Level-triggered interests stay queued for as long as the file
+            // remains ready, the next collection will check again.
+            ScopedSpinLock lock(m_ready_lock);
+            if (!interest->m_ready_list_node.is_in_list())
+                m_ready_list.append(*interest);
+        }
+    }
+
+    ScopedSpinLock lock(m_ready_lock);
+    // Put back whatever didn't fit, keeping the original order.
+    while (auto* interest = pending.take_last())
+        m_ready_list.prepend(*interest);
+    return count;
+}
+
+void EventQueue::interest_became_ready(Interest& interest)
+{
+    {
+        ScopedSpinLock lock(m_ready_lock);
+        if (interest.m_ready_list_node.is_in_list())
+            return;
+        m_ready_list.append(interest);
+    }
+    evaluate_block_conditions();
+}
+
+void EventQueue::remove_from_ready_list(Interest& interest)
+{
+    ScopedSpinLock lock(m_ready_lock);
+    if (interest.m_ready_list_node.is_in_list())
+        interest.m_ready_list_node.remove();
+}
+
+EventQueue::Interest::Interest(EventQueue& queue, int fd, FileDescription& description, EventQueueEvents events, u64 user_data)
+    : m_queue(queue)
+    , m_fd(fd)
+    , m_description(description.make_weak_ptr())
+    , m_file(description.file())
+    , m_events(events)
+    , m_user_data(user_data)
+{
+    // We never ask the block condition to drop us, so this always succeeds.
+    // unblock() queues us right away, so the next collection reports the
+    // file if it is ready already.
+    [[maybe_unused]] auto did_add = set_block_condition(m_file->block_condition());
+    VERIFY(did_add);
+}
+
+EventQueue::Interest::~Interest()
+{
+    // Make sure the file can't queue us again before we leave the ready list.
+    m_file->block_condition().remove_blocker(*this, nullptr);
+    m_queue.remove_from_ready_list(*this);
+}
+
+static BlockFlags block_flags_for(EventQueueEvents events)
+{
+    auto flags = BlockFlags::None;
+    if (has_flag(events, EventQueueEvents::Read))
+        flags |= BlockFlags::Read;
+    if (has_flag(events, EventQueueEvents::Write))
+        flags |= BlockFlags::Write;
+    return flags;
+}
+
+EventQueueEvents EventQueue::Interest::ready_events() const
+{
+    auto description = m_description.strong_ref();
+    if (!description)
+        return EventQueueEvents::None;
+    auto unblock_flags = description->should_unblock(block_flags_for(m_events));
+    auto ready = EventQueueEvents::None;
+    if (has_flag(unblock_flags, BlockFlags::Read))
+        ready |= EventQueueEvents::Read;
+    if (has_flag(unblock_flags, BlockFlags::Write))
+        ready |= EventQueueEvents::Write;
+    return ready;
+}
+
+bool EventQueue::Interest::unblock(bool, void*)
+{
+    // This is called with the block condition's spinlock held, so we can't
+    // take a reference to the description here: if it turned out to be the
+    // last one, closing the description would evaluate the same block
+    // condition again. Get on the ready list instead, the next collection
+    // checks what the file is ready for, or removes us if it's gone.
+    m_queue.interest_became_ready(*this);
+    // Stay registered with the block condition, we want to hear about every
+    // future change too.
+    return false;
+}
+
+}
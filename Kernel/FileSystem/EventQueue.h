@@ -0,0 +1,99 @@
+/*
+ * Copyright (c) 2021, the SerenityOS developers.
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#pragma once
+
+#include <AK/HashMap.h>
+#include <AK/IntrusiveList.h>
+#include <AK/NonnullOwnPtr.h>
+#include <AK/WeakPtr.h>
+#include <Kernel/API/EventQueue.h>
+#include <Kernel/FileSystem/File.h>
+#include <Kernel/Lock.h>
+
+namespace Kernel {
+
+// An EventQueue keeps a persistent list of file descriptions a process is
+// interested in. Each interest sits on the block condition of its file, so it
+// is told about readiness changes as they happen and queues itself on the
+// ready list. Waiting on the queue only ever looks at the ready list, which
+// makes the cost of a wait independent of the number of idle interests.
+class EventQueue final : public File {
+public:
+    static KResultOr<NonnullRefPtr<EventQueue>> create();
+    virtual ~EventQueue() override;
+
+    // The queue is readable while it has interests waiting to be reported.
+    virtual bool can_read(const FileDescription&, size_t) const override;
+    virtual KResultOr<size_t> read(FileDescription&, u64, UserOrKernelBuffer&, size_t) override { return EINVAL; }
+    virtual bool can_write(const FileDescription&, size_t) const override { return true; }
+    virtual KResultOr<size_t> write(FileDescription&, u64, const UserOrKernelBuffer&, size_t) override { return EIO; }
+
+    virtual String absolute_path(const FileDescription&) const override { return "event-queue"; }
+    virtual const char* class_name() const override { return "EventQueue"; }
+    virtual bool is_event_queue() const override { return true; }
+
+    KResult add_interest(int fd, FileDescription&, EventQueueEvents, u64 user_data);
+    KResult modify_interest(int fd, FileDescription&, EventQueueEvents, u64 user_data);
+    KResult remove_interest(int fd);
+
+    // Fills the given span with events for ready interests and returns how
+    // many were written.
+    size_t collect_events(Span<EventQueueEvent> events);
+
+private:
+    class Interest final : public Thread::FileBlocker {
+    public:
+        Interest(EventQueue&, int fd, FileDescription&, EventQueueEvents, u64 user_data);
+        virtual ~Interest() override;
+
+        virtual const char* state_string() const override { return "EventQueue"; }
+        virtual void not_blocking(bool) override { }
+        virtual bool unblock(bool, void*) override;
+
+        int fd() const { return m_fd; }
+        // Returns null once the description has been closed everywhere.
+        RefPtr<FileDescription> description() const { return m_description.strong_ref(); }
+        EventQueueEvents events() const { return m_events; }
+        u64 user_data() const { return m_user_data; }
+
+        // Returns which of the requested events the file is currently ready for.
+        EventQueueEvents ready_events() const;
+
+        IntrusiveListNode<Interest> m_ready_list_node;
+
+    private:
+        EventQueue& m_queue;
+        int m_fd { -1 };
+        WeakPtr<FileDescription> m_description;
+        // We sit on the block condition of the file, so it has to outlive us.
+        NonnullRefPtr<File> m_file;
+        EventQueueEvents m_events { EventQueueEvents::None };
+        u64 m_user_data { 0 };
+    };
+
+    using ReadyList = IntrusiveList<Interest, RawPtr<Interest>, &Interest::m_ready_list_node>;
+
+    EventQueue() { }
+
+    void interest_became_ready(Interest&);
+    void remove_from_ready_list(Interest&);
+
+    // Protects the interest map and serializes collectors.
+    Lock m_lock { "EventQueue" };
+    // NOTE: Interests don't keep their file description alive, otherwise
+    //       closing its last fd wouldn't let the peer see EOF. Once the
+    //       description is gone, the interest queues itself one last time
+    //       and the next collection drops it.
+    HashMap<int, NonnullOwnPtr<Interest>> m_interests;
+
+    // Interests are queued from the block condition of their file, which may
+    // be evaluated with spinlocks held, so the ready list has its own spinlock.
+    mutable SpinLock<u8> m_ready_lock;
+    ReadyList m_ready_list;
+};
+
+}
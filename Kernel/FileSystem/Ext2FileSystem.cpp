@@ -7,6 +7,7 @@
 
 #include <AK/HashMap.h>
 #include <AK/MemoryStream.h>
+#include <AK/QuickSort.h>
 #include <AK/StdLibExtras.h>
 #include <AK/StringView.h>
 #include <Kernel/Debug.h>
@@ -15,7 +16,10 @@
 #include <Kernel/FileSystem/FileDescription.h>
 #include <Kernel/FileSystem/ext2_fs.h>
 #include <Kernel/Process.h>
+#include <Kernel/Tasks/WriteBackTask.h>
 #include <Kernel/UnixTypes.h>
+#include <Kernel/VM/MemoryManager.h>
+#include <Kernel/VM/PageCache.h>
 #include <LibC/errno_numbers.h>
 
 namespace Kernel {
@@ -23,6 +27,17 @@ namespace Kernel {
 static constexpr size_t max_block_size = 4096;
 static constexpr size_t max_inline_symlink_length = 60;
 
+// Cached writes to regular files only get blocks on disk once they are written back, so
+// everything that was appended in the meantime can be allocated together. This is how much
+// data a single inode and the whole file system can have waiting for that.
+static constexpr size_t max_delayed_bytes_per_inode = 1 * MiB;
+static constexpr size_t max_delayed_bytes = 8 * MiB;
+
+// The first reservation window of an inode has room for this many blocks past the ones it
+// was opened for. Every window after that has twice as much, up to the maximum.
+static constexpr size_t min_reservation_window_size = 8;
+static constexpr size_t max_reservation_window_size = 1024;
+
 struct Ext2FSDirectoryEntry {
     String name;
     InodeIndex inode_index { 0 };
@@ -30,6 +45,36 @@ struct Ext2FSDirectoryEntry {
     u16 record_length { 0 };
 };
 
+// Hash-indexed directories (EXT2_INDEX_FL) keep "." and ".." at the start of their first block,
+// with ".." spanning the rest of it. The root of the index is hidden in that space, after an
+// ext2_dx_root_info. Other index nodes are blocks with a single unused entry spanning all of
+// them, so that the directory can still be read like a linear one.
+static constexpr size_t dx_root_info_offset = 24;
+static constexpr size_t dx_root_entries_offset = dx_root_info_offset + sizeof(ext2_dx_root_info);
+static constexpr size_t dx_node_entries_offset = 8;
+static constexpr u8 max_dx_indirect_levels = 1;
+
+struct Ext2FSDirectoryIndexFrame {
+    size_t block_index { 0 };
+    size_t entries_offset { 0 };
+    // The entry that was followed to the level below.
+    size_t position { 0 };
+    ByteBuffer data;
+
+    // The first entry has no hash. Its place is taken by the count and limit of the entries.
+    ext2_dx_entry* entries() { return reinterpret_cast<ext2_dx_entry*>(data.data() + entries_offset); }
+    ext2_dx_countlimit& countlimit() { return *reinterpret_cast<ext2_dx_countlimit*>(entries()); }
+    ext2_dx_entry& current_entry() { return entries()[position]; }
+};
+
+// The index nodes that lead from the root to the leaf block that a name belongs in.
+struct Ext2FSDirectoryIndexPath {
+    u8 hash_version { 0 };
+    u32 hash { 0 };
+    size_t leaf_block_index { 0 };
+    Vector<Ext2FSDirectoryIndexFrame, 2> frames;
+};
+
 static u8 to_ext2_file_type(mode_t mode)
 {
     if (is_regular_file(mode))
@@ -406,13 +451,15 @@ KResult Ext2FSInode::flush_block_list()
 
     Vector<Ext2FS::BlockIndex> new_meta_blocks;
     if (new_shape.meta_blocks > old_shape.meta_blocks) {
-        auto blocks_or_error = fs().allocate_blocks(fs().group_index_from_inode(index()), new_shape.meta_blocks - old_shape.meta_blocks);
+        auto blocks_or_error = fs().allocate_blocks_for_inode(index(), new_shape.meta_blocks - old_shape.meta_blocks);
         if (blocks_or_error.is_error())
             return blocks_or_error.error();
         new_meta_blocks = blocks_or_error.release_value();
     }
 
-    m_raw_inode.i_blocks = (m_block_list.size() + new_shape.meta_blocks) * (fs().block_size() / 512);
+    // The data blocks are counted as they are allocated and freed, since some of them may be holes.
+    const auto sectors_per_block = fs().block_size() / 512;
+    m_raw_inode.i_blocks = m_raw_inode.i_blocks - old_shape.meta_blocks * sectors_per_block + new_shape.meta_blocks * sectors_per_block;
     dbgln_if(EXT2_BLOCKLIST_DEBUG, "Ext2FSInode[{}]::flush_block_list(): Old shape=({};{};{};{}:{}), new shape=({};{};{};{}:{})", identifier(), old_shape.direct_blocks, old_shape.indirect_blocks, old_shape.doubly_indirect_blocks, old_shape.triply_indirect_blocks, old_shape.meta_blocks, new_shape.direct_blocks, new_shape.indirect_blocks, new_shape.doubly_indirect_blocks, new_shape.triply_indirect_blocks, new_shape.meta_blocks);
 
     unsigned output_block_index = 0;
@@ -528,6 +575,210 @@ KResult Ext2FSInode::flush_block_list()
     VERIFY_NOT_REACHED();
 }
 
+KResult Ext2FSInode::write_block_pointer(size_t logical_block_index, BlockBasedFS::BlockIndex block)
+{
+    VERIFY(m_lock.is_locked());
+    if (logical_block_index < EXT2_NDIR_BLOCKS) {
+        m_raw_inode.i_block[logical_block_index] = block.value();
+        set_metadata_dirty(true);
+        return KSuccess;
+    }
+
+    // Find the indirect block that has the pointer, going through the doubly and triply indirect blocks above it.
+    const size_t entries_per_block = EXT2_ADDR_PER_BLOCK(&fs().super_block());
+    size_t index = logical_block_index - EXT2_NDIR_BLOCKS;
+    BlockBasedFS::BlockIndex pointer_block;
+    unsigned levels_above = 0;
+    if (index < entries_per_block) {
+        pointer_block = m_raw_inode.i_block[EXT2_IND_BLOCK];
+    } else if (index -= entries_per_block; index < entries_per_block * entries_per_block) {
+        pointer_block = m_raw_inode.i_block[EXT2_DIND_BLOCK];
+        levels_above = 1;
+    } else {
+        index -= entries_per_block * entries_per_block;
+        pointer_block = m_raw_inode.i_block[EXT2_TIND_BLOCK];
+        levels_above = 2;
+    }
+
+    for (; levels_above > 0; --levels_above) {
+        if (!pointer_block.value())
+            break;
+        size_t entries_per_pointer = levels_above == 2 ? entries_per_block * entries_per_block : entries_per_block;
+        u32 next_block = 0;
+        auto buffer = UserOrKernelBuffer::for_kernel_buffer(reinterpret_cast<u8*>(&next_block));
+        if (auto result = fs().read_block(pointer_block, &buffer, sizeof(next_block), (index / entries_per_pointer) * sizeof(next_block)); result.is_error())
+            return result;
+        pointer_block = next_block;
+        index %= entries_per_pointer;
+    }
+
+    if (!pointer_block.value()) {
+        // We always allocate the indirect blocks along with the block list, but others leave them out for holes.
+        dbgln("Ext2FSInode[{}]::write_block_pointer(): No indirect block for block {}", identifier(), logical_block_index);
+        return EIO;
+    }
+
+    u32 value = block.value();
+    auto buffer = UserOrKernelBuffer::for_kernel_buffer(reinterpret_cast<u8*>(&value));
+    return fs().write_block(pointer_block, buffer, sizeof(value), index * sizeof(value));
+}
+
+KResult Ext2FSInode::allocate_blocks_in_range(size_t first_block, size_t last_block, bool fill_holes)
+{
+    VERIFY(m_lock.is_locked());
+
+    Vector<size_t> holes;
+    size_t delayed_count = 0;
+    if (fill_holes) {
+        for (size_t i = first_block; i <= last_block && i < m_block_list.size(); ++i) {
+            if (m_block_list[i].value())
+                continue;
+            holes.append(i);
+            if (m_delayed_blocks.contains(i))
+                ++delayed_count;
+        }
+    } else {
+        for (auto& it : m_delayed_blocks) {
+            if (it.key >= first_block && it.key <= last_block)
+                holes.append(it.key);
+        }
+        quick_sort(holes);
+        delayed_count = holes.size();
+    }
+    if (holes.is_empty())
+        return KSuccess;
+
+    // Continue after the block before the first hole, so files that are written sequentially stay contiguous.
+    Ext2FS::BlockIndex goal = 0;
+    for (size_t i = holes.first(); i > 0; --i) {
+        if (auto previous_block = m_block_list[i - 1]; previous_block.value()) {
+            goal = previous_block.value() + 1;
+            break;
+        }
+    }
+
+    auto blocks_or_error = fs().allocate_blocks_for_inode(index(), holes.size(), goal, delayed_count);
+    if (blocks_or_error.is_error())
+        return blocks_or_error.error();
+    auto blocks = blocks_or_error.release_value();
+
+    size_t assigned_delayed_count = 0;
+    auto give_up = [&](size_t first_unassigned, KResult error) -> KResult {
+        // Blocks that didn't make it into the block list would be lost forever otherwise.
+        for (size_t i = first_unassigned; i < blocks.size(); ++i) {
+            if (auto result = fs().set_block_allocation_state(blocks[i], false); result.is_error())
+                dbgln("Ext2FSInode[{}]::allocate_blocks_in_range(): Failed to free block {}: {}", identifier(), blocks[i], result.error());
+        }
+        fs().release_delayed_blocks(*this, assigned_delayed_count);
+        return error;
+    };
+
+    u8 zero_buffer[max_block_size] {};
+    for (size_t i = 0; i < holes.size(); ++i) {
+        auto logical_block_index = holes[i];
+        auto block = blocks[i];
+        auto it = m_delayed_blocks.find(logical_block_index);
+        bool is_delayed = it != m_delayed_blocks.end();
+        auto buffer = UserOrKernelBuffer::for_kernel_buffer(is_delayed ? delayed_block_data(it->value) : zero_buffer);
+        if (auto result = fs().write_block(block, buffer, fs().block_size()); result.is_error())
+            return give_up(i, result);
+        m_block_list[logical_block_index] = block;
+        m_raw_inode.i_blocks += fs().block_size() / 512;
+        set_metadata_dirty(true);
+        if (is_delayed) {
+            remove_delayed_block(logical_block_index);
+            ++assigned_delayed_count;
+        }
+        if (auto result = write_block_pointer(logical_block_index, block); result.is_error())
+            return give_up(i + 1, result);
+    }
+    fs().release_delayed_blocks(*this, assigned_delayed_count);
+
+    dbgln_if(EXT2_DEBUG, "Ext2FSInode[{}]::allocate_blocks_in_range(): Allocated {} block(s) ({} delayed) starting at {}", identifier(), blocks.size(), delayed_count, blocks.first());
+    return KSuccess;
+}
+
+KResult Ext2FSInode::allocate_delayed_blocks()
+{
+    Locker locker(m_lock);
+    if (m_delayed_blocks.is_empty())
+        return KSuccess;
+    return allocate_blocks_in_range(0, m_block_list.size() - 1, false);
+}
+
+KResultOr<u8*> Ext2FSInode::add_delayed_block(size_t logical_block_index)
+{
+    VERIFY(m_lock.is_locked());
+    VERIFY(!m_delayed_blocks.contains(logical_block_index));
+    size_t block_size = fs().block_size();
+    if (!m_delayed_region) {
+        // Every page starts out as the shared zero page, and gets replaced once a slot in it is used.
+        auto vmobject = AnonymousVMObject::create_with_size(max_delayed_bytes_per_inode, AllocationStrategy::None);
+        if (!vmobject)
+            return ENOMEM;
+        auto region = MM.allocate_kernel_region_with_vmobject(*vmobject, max_delayed_bytes_per_inode, "Ext2FS delayed blocks", Region::Access::Read | Region::Access::Write);
+        if (!region)
+            return ENOMEM;
+        size_t slot_count = max_delayed_bytes_per_inode / block_size;
+        if (!m_free_delayed_slots.try_ensure_capacity(slot_count))
+            return ENOMEM;
+        // Hand out the slots from the start, so the data is packed into as few pages as possible.
+        for (size_t i = slot_count; i > 0; --i)
+            m_free_delayed_slots.unchecked_append(i - 1);
+        m_delayed_vmobject = move(vmobject);
+        m_delayed_region = move(region);
+    }
+    if (m_free_delayed_slots.is_empty())
+        return ENOSPC;
+
+    auto slot = m_free_delayed_slots.last();
+    size_t page_index = slot * block_size / PAGE_SIZE;
+    auto& page = m_delayed_vmobject->physical_pages()[page_index];
+    if (page->is_shared_zero_page()) {
+        auto new_page = MM.allocate_user_physical_page(MemoryManager::ShouldZeroFill::No);
+        if (!new_page)
+            return ENOMEM;
+        page = move(new_page);
+        if (!m_delayed_region->remap_vmobject_page_range(page_index, 1)) {
+            page = MM.shared_zero_page();
+            return ENOMEM;
+        }
+    }
+    m_free_delayed_slots.take_last();
+    m_delayed_blocks.set(logical_block_index, slot);
+
+    // The block is a hole, so whatever isn't written to has to read as zeroes.
+    auto* data = delayed_block_data(slot);
+    memset(data, 0, block_size);
+    return data;
+}
+
+bool Ext2FSInode::remove_delayed_block(size_t logical_block_index)
+{
+    VERIFY(m_lock.is_locked());
+    auto it = m_delayed_blocks.find(logical_block_index);
+    if (it == m_delayed_blocks.end())
+        return false;
+    m_free_delayed_slots.unchecked_append(it->value);
+    m_delayed_blocks.remove(it);
+    if (m_delayed_blocks.is_empty())
+        drop_delayed_blocks();
+    return true;
+}
+
+void Ext2FSInode::drop_delayed_blocks()
+{
+    m_delayed_blocks.clear();
+    m_free_delayed_slots.clear();
+    m_delayed_region = nullptr;
+    m_delayed_vmobject = nullptr;
+}
+
+u8* Ext2FSInode::delayed_block_data(size_t slot) const
+{
+    return m_delayed_region->vaddr().offset(slot * fs().block_size()).as_ptr();
+}
+
 Vector<Ext2FS::BlockIndex> Ext2FSInode::compute_block_list() const
 {
     return compute_block_list_impl(false);
@@ -542,8 +793,11 @@ Vector<Ext2FS::BlockIndex> Ext2FSInode::compute_block_list_impl(bool include_blo
 {
     // FIXME: This is really awkwardly factored.. foo_impl_internal :|
     auto block_list = compute_block_list_impl_internal(m_raw_inode, include_block_list_blocks);
-    while (!block_list.is_empty() && block_list.last() == 0)
-        block_list.take_last();
+    // Holes at the end of a file are part of its block list, but they aren't blocks that it owns.
+    if (include_block_list_blocks) {
+        while (!block_list.is_empty() && block_list.last() == 0)
+            block_list.take_last();
+    }
     return block_list;
 }
 
@@ -603,6 +857,12 @@ Vector<Ext2FS::BlockIndex> Ext2FSInode::compute_block_list_impl_internal(const e
         auto count = min(blocks_remaining, entries_per_block);
         if (!count)
             return;
+        // Files with holes don't need indirect blocks for the parts that are all holes.
+        if (!array_block_index) {
+            for (unsigned i = 0; i < count; ++i)
+                callback(Ext2FS::BlockIndex(0));
+            return;
+        }
         size_t read_size = count * sizeof(u32);
         auto array_storage = ByteBuffer::create_uninitialized(read_size);
         auto* array = (u32*)array_storage.data();
@@ -648,6 +908,13 @@ void Ext2FS::free_inode(Ext2FSInode& inode)
     VERIFY(inode.m_raw_inode.i_links_count == 0);
     dbgln_if(EXT2_DEBUG, "Ext2FS[{}]::free_inode(): Inode {} has no more links, time to delete!", fsid(), inode.index());
 
+    // Data that never made it to disk can simply be dropped.
+    VERIFY(m_delayed_block_count >= inode.m_delayed_blocks.size());
+    m_delayed_block_count -= inode.m_delayed_blocks.size();
+    inode.drop_delayed_blocks();
+    m_inodes_with_delayed_blocks.remove(inode.index());
+    release_reservation_window(inode.index());
+
     // Mark all blocks used by this inode as free.
     for (auto block_index : inode.compute_block_list_with_meta_blocks()) {
         VERIFY(block_index <= super_block().s_blocks_count);
@@ -688,6 +955,8 @@ void Ext2FS::flush_block_group_descriptor_table()
 
 void Ext2FS::flush_writes()
 {
+    allocate_delayed_blocks();
+
     Locker locker(m_lock);
     if (m_super_block_dirty) {
         flush_super_block();
@@ -722,12 +991,41 @@ void Ext2FS::flush_writes()
             continue;
         if (it.value->has_watchers())
             continue;
+        if (m_inodes_with_delayed_blocks.contains(it.key))
+            continue;
         unused_inodes.append(it.key);
     }
     for (auto index : unused_inodes)
         uncache_inode(index);
 }
 
+void Ext2FS::allocate_delayed_blocks()
+{
+    // Inodes are locked before the file system, so find them first.
+    NonnullRefPtrVector<Ext2FSInode> inodes;
+    {
+        Locker locker(m_lock);
+        for (auto index : m_inodes_with_delayed_blocks) {
+            auto it = m_inode_cache.find(index);
+            if (it != m_inode_cache.end() && it->value)
+                inodes.append(*it->value);
+        }
+    }
+
+    for (auto& inode : inodes) {
+        Locker inode_locker(inode.m_lock);
+        if (auto result = inode.allocate_delayed_blocks(); result.is_error())
+            dbgln("Ext2FS[{}]::allocate_delayed_blocks(): Failed to allocate blocks for inode {}: {}", fsid(), inode.index(), result.error());
+        // The inode has new block pointers, make sure they are written back along with the data.
+        if (inode.is_metadata_dirty())
+            inode.flush_metadata();
+
+        Locker locker(m_lock);
+        if (inode.m_delayed_blocks.is_empty())
+            m_inodes_with_delayed_blocks.remove(inode.index());
+    }
+}
+
 Ext2FSInode::Ext2FSInode(Ext2FS& fs, InodeIndex index)
     : Inode(fs, index)
 {
@@ -843,6 +1141,33 @@ KResultOr<size_t> Ext2FSInode::read_bytes(off_t offset, size_t count, UserOrKern
         return nread;
     }
 
+    bool allow_cache = !description || !description->is_direct();
+
+    // Regular files are read through the page cache, unless they have already been
+    // deleted. Those only stick around until the last description is closed.
+    if (allow_cache && Kernel::is_regular_file(m_raw_inode.i_mode) && m_raw_inode.i_links_count != 0) {
+        size_t count_within_file = min(static_cast<u64>(count), size() - offset);
+        return PageCache::the().read_bytes(const_cast<Ext2FSInode&>(*this), offset, count_within_file, buffer);
+    }
+
+    return read_bytes_from_blocks(offset, count, buffer, allow_cache);
+}
+
+KResultOr<size_t> Ext2FSInode::read_bytes_uncached(off_t offset, size_t count, UserOrKernelBuffer& buffer) const
+{
+    Locker inode_locker(m_lock);
+    VERIFY(offset >= 0);
+    if (static_cast<u64>(offset) >= size())
+        return 0;
+    if (is_symlink() && size() < max_inline_symlink_length)
+        return read_bytes(offset, count, buffer, nullptr);
+    return read_bytes_from_blocks(offset, count, buffer, true);
+}
+
+KResultOr<size_t> Ext2FSInode::read_bytes_from_blocks(off_t offset, size_t count, UserOrKernelBuffer& buffer, bool allow_cache) const
+{
+    VERIFY(m_lock.is_locked());
+
     if (m_block_list.is_empty())
         m_block_list = compute_block_list();
 
@@ -851,8 +1176,6 @@ KResultOr<size_t> Ext2FSInode::read_bytes(off_t offset, size_t count, UserOrKern
         return EIO;
     }
 
-    bool allow_cache = !description || !description->is_direct();
-
     const int block_size = fs().block_size();
 
     BlockBasedFS::BlockIndex first_block_logical_index = offset / block_size;
@@ -873,9 +1196,26 @@ KResultOr<size_t> Ext2FSInode::read_bytes(off_t offset, size_t count, UserOrKern
         size_t num_bytes_to_copy = min((size_t)block_size - offset_into_block, (size_t)remaining_count);
         auto buffer_offset = buffer.offset(nread);
         if (block_index.value() == 0) {
-            // This is a hole, act as if it's filled with zeroes.
-            if (!buffer_offset.memset(0, num_bytes_to_copy))
+            // This is a hole, act as if it's filled with zeroes, unless it has been written to and is waiting for a block.
+            if (auto it = m_delayed_blocks.find(bi.value()); it != m_delayed_blocks.end()) {
+                if (!buffer_offset.write(delayed_block_data(it->value) + offset_into_block, num_bytes_to_copy))
+                    return EFAULT;
+            } else if (!buffer_offset.memset(0, num_bytes_to_copy)) {
                 return EFAULT;
+            }
+        } else if (Kernel::is_regular_file(m_raw_inode.i_mode) && offset_into_block == 0 && num_bytes_to_copy == (size_t)block_size) {
+            // Whole blocks that are next to each other on disk are read with a single request.
+            unsigned run_length = 1;
+            while (bi.value() + run_length <= last_block_logical_index.value()
+                && (size_t)remaining_count >= (run_length + 1) * block_size
+                && m_block_list[bi.value() + run_length].value() == block_index.value() + run_length)
+                ++run_length;
+            if (auto result = fs().read_blocks_directly(block_index, run_length, buffer_offset); result.is_error()) {
+                dmesgln("Ext2FSInode[{}]::read_bytes(): Failed to read {} blocks at {} (index {})", identifier(), run_length, block_index.value(), bi);
+                return result.error();
+            }
+            num_bytes_to_copy = run_length * block_size;
+            bi = bi.value() + run_length - 1;
         } else {
             if (auto result = fs().read_block(block_index, &buffer_offset, num_bytes_to_copy, offset_into_block, allow_cache); result.is_error()) {
                 dmesgln("Ext2FSInode[{}]::read_bytes(): Failed to read block {} (index {})", identifier(), block_index.value(), bi);
@@ -907,20 +1247,12 @@ KResult Ext2FSInode::resize(u64 new_size)
         dbgln("Ext2FSInode[{}]::resize(): Blocks needed after  (size is  {}): {}", identifier(), new_size, blocks_needed_after);
     }
 
-    if (blocks_needed_after > blocks_needed_before) {
-        auto additional_blocks_needed = blocks_needed_after - blocks_needed_before;
-        if (additional_blocks_needed > fs().super_block().s_free_blocks_count)
-            return ENOSPC;
-    }
-
     if (m_block_list.is_empty())
         m_block_list = this->compute_block_list();
 
     if (blocks_needed_after > blocks_needed_before) {
-        auto blocks_or_error = fs().allocate_blocks(fs().group_index_from_inode(index()), blocks_needed_after - blocks_needed_before);
-        if (blocks_or_error.is_error())
-            return blocks_or_error.error();
-        if (!m_block_list.try_extend(blocks_or_error.release_value()))
+        // The new blocks start out as holes, they only get allocated once they are written to.
+        if (!m_block_list.try_resize(blocks_needed_after))
             return ENOMEM;
     } else if (blocks_needed_after < blocks_needed_before) {
         if constexpr (EXT2_VERY_DEBUG) {
@@ -929,15 +1261,22 @@ KResult Ext2FSInode::resize(u64 new_size)
                 dbgln("    # {}", block_index);
             }
         }
-        while (m_block_list.size() != blocks_needed_after) {
+        size_t delayed_blocks_dropped = 0;
+        while (m_block_list.size() > blocks_needed_after) {
             auto block_index = m_block_list.take_last();
             if (block_index.value()) {
                 if (auto result = fs().set_block_allocation_state(block_index, false); result.is_error()) {
                     dbgln("Ext2FSInode[{}]::resize(): Failed to free block {}: {}", identifier(), block_index, result.error());
                     return result;
                 }
+                m_raw_inode.i_blocks -= fs().block_size() / 512;
+            } else if (remove_delayed_block(m_block_list.size())) {
+                ++delayed_blocks_dropped;
             }
         }
+        fs().release_delayed_blocks(*this, delayed_blocks_dropped);
+        // Whatever was set aside for the old end of the file is in the wrong place now.
+        fs().release_reservation_window(index());
     }
 
     if (auto result = flush_block_list(); result.is_error())
@@ -949,20 +1288,20 @@ KResult Ext2FSInode::resize(u64 new_size)
 
     set_metadata_dirty(true);
 
-    if (new_size > old_size) {
-        // If we're growing the inode, make sure we zero out all the new space.
-        // FIXME: There are definitely more efficient ways to achieve this.
-        auto bytes_to_clear = new_size - old_size;
-        auto clear_from = old_size;
-        u8 zero_buffer[PAGE_SIZE] {};
-        while (bytes_to_clear) {
-            auto result = write_bytes(clear_from, min(static_cast<u64>(sizeof(zero_buffer)), bytes_to_clear), UserOrKernelBuffer::for_kernel_buffer(zero_buffer), nullptr);
-            if (result.is_error())
-                return result.error();
-            VERIFY(result.value() != 0);
-            bytes_to_clear -= result.value();
-            clear_from += result.value();
-        }
+    if (new_size < old_size) {
+        if (auto vmobject = shared_vmobject())
+            vmobject->did_truncate(new_size);
+    }
+
+    if (new_size > old_size && old_size % block_size) {
+        // The new blocks are holes, which read as zeroes. The block the file used to end in
+        // may still have old data past that end though, so clear it out.
+        auto bytes_to_clear = min(new_size, blocks_needed_before * block_size) - old_size;
+        u8 zero_buffer[max_block_size] {};
+        auto result = write_bytes(old_size, bytes_to_clear, UserOrKernelBuffer::for_kernel_buffer(zero_buffer), nullptr);
+        if (result.is_error())
+            return result.error();
+        VERIFY(result.value() == bytes_to_clear);
     }
 
     return KSuccess;
@@ -1016,23 +1355,79 @@ KResultOr<size_t> Ext2FSInode::write_bytes(off_t offset, size_t count, const Use
 
     size_t offset_into_first_block = offset % block_size;
 
+    // Cached writes to regular files don't allocate blocks for holes right away, see allocate_delayed_blocks().
+    bool delay_allocation = allow_cache && Kernel::is_regular_file(m_raw_inode.i_mode);
+    if (!delay_allocation) {
+        if (auto result = allocate_blocks_in_range(first_block_logical_index.value(), (offset + count - 1) / block_size, true); result.is_error())
+            return result;
+    }
+
     size_t nwritten = 0;
     auto remaining_count = min((off_t)count, (off_t)new_size - offset);
 
     dbgln_if(EXT2_VERY_DEBUG, "Ext2FSInode[{}]::write_bytes(): Writing {} bytes, {} bytes into inode from {}", identifier(), count, offset, data.user_or_kernel_ptr());
 
+    // The data is only read from the caller's buffer once. Whatever ends up on disk also goes into the
+    // page cache, so the two can't disagree if the buffer changes underneath us.
+    auto vmobject = shared_vmobject();
+    u8 block_buffer[max_block_size];
+
     for (auto bi = first_block_logical_index; remaining_count && bi <= last_block_logical_index; bi = bi.value() + 1) {
         size_t offset_into_block = (bi == first_block_logical_index) ? offset_into_first_block : 0;
         size_t num_bytes_to_copy = min((size_t)block_size - offset_into_block, (size_t)remaining_count);
-        dbgln_if(EXT2_DEBUG, "Ext2FSInode[{}]::write_bytes(): Writing block {} (offset_into_block: {})", identifier(), m_block_list[bi.value()], offset_into_block);
-        if (auto result = fs().write_block(m_block_list[bi.value()], data.offset(nwritten), num_bytes_to_copy, offset_into_block, allow_cache); result.is_error()) {
-            dbgln("Ext2FSInode[{}]::write_bytes(): Failed to write block {} (index {})", identifier(), m_block_list[bi.value()], bi);
-            return result;
+        auto block_index = m_block_list[bi.value()];
+        u8* written_data;
+        if (block_index.value() == 0) {
+            VERIFY(delay_allocation);
+            u8* block_data;
+            if (auto it = m_delayed_blocks.find(bi.value()); it != m_delayed_blocks.end()) {
+                block_data = delayed_block_data(it->value);
+            } else {
+                if (m_delayed_blocks.size() * block_size >= max_delayed_bytes_per_inode) {
+                    // There's no room for another one, give the blocks we're holding on to a place on disk first.
+                    if (auto result = allocate_delayed_blocks(); result.is_error())
+                        return result;
+                }
+                if (auto result = fs().reserve_delayed_block(*this); result.is_error())
+                    return result;
+                auto block_data_or_error = add_delayed_block(bi.value());
+                if (block_data_or_error.is_error()) {
+                    fs().release_delayed_blocks(*this, 1);
+                    return block_data_or_error.error();
+                }
+                block_data = block_data_or_error.value();
+            }
+            dbgln_if(EXT2_DEBUG, "Ext2FSInode[{}]::write_bytes(): Writing delayed block (index {}, offset_into_block: {})", identifier(), bi, offset_into_block);
+            written_data = block_data + offset_into_block;
+            if (!data.read(written_data, nwritten, num_bytes_to_copy))
+                return EFAULT;
+        } else {
+            dbgln_if(EXT2_DEBUG, "Ext2FSInode[{}]::write_bytes(): Writing block {} (offset_into_block: {})", identifier(), block_index, offset_into_block);
+            written_data = block_buffer;
+            if (!data.read(written_data, nwritten, num_bytes_to_copy))
+                return EFAULT;
+            if (auto result = fs().write_block(block_index, UserOrKernelBuffer::for_kernel_buffer(written_data), num_bytes_to_copy, offset_into_block, allow_cache); result.is_error()) {
+                dbgln("Ext2FSInode[{}]::write_bytes(): Failed to write block {} (index {})", identifier(), block_index, bi);
+                return result;
+            }
         }
+        if (vmobject)
+            vmobject->did_write(offset + nwritten, num_bytes_to_copy, UserOrKernelBuffer::for_kernel_buffer(written_data));
         remaining_count -= num_bytes_to_copy;
         nwritten += num_bytes_to_copy;
     }
 
+    if (!m_delayed_blocks.is_empty()) {
+        auto delayed_bytes = fs().delayed_block_count() * block_size;
+        if (m_delayed_blocks.size() * block_size >= max_delayed_bytes_per_inode || delayed_bytes >= max_delayed_bytes) {
+            // Don't let any more data pile up in memory, give it a place on disk now.
+            if (auto result = allocate_delayed_blocks(); result.is_error())
+                return result;
+        } else if (delayed_bytes >= max_delayed_bytes / 2) {
+            WriteBackTask::wake();
+        }
+    }
+
     did_modify_contents();
 
     dbgln_if(EXT2_VERY_DEBUG, "Ext2FSInode[{}]::write_bytes(): After write, i_size={}, i_blocks={} ({} blocks in list)", identifier(), size(), m_raw_inode.i_blocks, m_block_list.size());
@@ -1154,6 +1549,9 @@ KResult Ext2FSInode::write_directory(Vector<Ext2FSDirectoryEntry>& entries)
     if (auto result = resize(stream.size()); result.is_error())
         return result;
 
+    // The entries are laid out one after another, so any index the directory had is gone.
+    m_raw_inode.i_flags &= ~EXT2_INDEX_FL;
+
     auto buffer = UserOrKernelBuffer::for_kernel_buffer(stream.data());
     auto result = write_bytes(0, stream.size(), buffer, nullptr);
     if (result.is_error())
@@ -1181,38 +1579,38 @@ KResult Ext2FSInode::add_child(Inode& child, const StringView& name, mode_t mode
 
     dbgln_if(EXT2_DEBUG, "Ext2FSInode[{}]::add_child(): Adding inode {} with name '{}' and mode {:o} to directory {}", identifier(), child.index(), name, mode, index());
 
-    Vector<Ext2FSDirectoryEntry> entries;
-    bool name_already_exists = false;
-    KResult result = traverse_as_directory([&](auto& entry) {
-        if (name == entry.name) {
-            name_already_exists = true;
-            return false;
-        }
-        entries.append({ entry.name, entry.inode.index(), entry.file_type });
-        return true;
-    });
+    // "." and ".." are kept outside of the index, so they are added like in a linear directory.
+    bool use_index = is_indexed_directory() && name != "." && name != "..";
 
-    if (result.is_error())
-        return result;
+    bool name_already_exists = false;
+    if (use_index) {
+        auto existing_inode_index = find_in_directory_index(name);
+        if (existing_inode_index.is_error())
+            return existing_inode_index.error();
+        name_already_exists = existing_inode_index.value() != 0;
+    } else {
+        if (auto populate_result = populate_lookup_cache(); populate_result.is_error())
+            return populate_result;
+        name_already_exists = m_lookup_cache.find(name.hash(), [&](auto& entry) { return entry.key == name; }) != m_lookup_cache.end();
+    }
 
     if (name_already_exists) {
         dbgln("Ext2FSInode[{}]::add_child(): Name '{}' already exists", identifier(), name);
         return EEXIST;
     }
 
-    result = child.increment_link_count();
+    auto result = child.increment_link_count();
     if (result.is_error())
         return result;
 
-    entries.empend(name, child.index(), to_ext2_file_type(mode));
-    result = write_directory(entries);
+    auto file_type = to_ext2_file_type(mode);
+    result = use_index ? add_to_directory_index(name, child.index(), file_type) : add_to_linear_directory(name, child.index(), file_type);
     if (result.is_error())
         return result;
 
-    if (auto populate_result = populate_lookup_cache(); populate_result.is_error())
-        return populate_result;
-
-    m_lookup_cache.set(name, child.index());
+    // Adding the name may have given the directory an index, which drops the lookup cache.
+    if (!is_indexed_directory())
+        m_lookup_cache.set(name, child.index());
     did_add_child(child.identifier(), name);
     return KSuccess;
 }
@@ -1223,38 +1621,798 @@ KResult Ext2FSInode::remove_child(const StringView& name)
     dbgln_if(EXT2_DEBUG, "Ext2FSInode[{}]::remove_child(): Removing '{}'", identifier(), name);
     VERIFY(is_directory());
 
-    if (auto populate_result = populate_lookup_cache(); populate_result.is_error())
-        return populate_result;
+    bool use_index = is_indexed_directory() && name != "." && name != "..";
+    auto child_inode_index = use_index ? remove_from_directory_index(name) : remove_from_linear_directory(name);
+    if (child_inode_index.is_error())
+        return child_inode_index.error();
 
-    auto it = m_lookup_cache.find(name);
-    if (it == m_lookup_cache.end())
-        return ENOENT;
-    auto child_inode_index = (*it).value;
+    m_lookup_cache.remove(name);
 
-    InodeIdentifier child_id { fsid(), child_inode_index };
+    InodeIdentifier child_id { fsid(), child_inode_index.value() };
+    auto child_inode = fs().get_inode(child_id);
+    auto result = child_inode->decrement_link_count();
+    if (result.is_error())
+        return result;
 
-    Vector<Ext2FSDirectoryEntry> entries;
-    KResult result = traverse_as_directory([&](auto& entry) {
-        if (name != entry.name)
-            entries.append({ entry.name, entry.inode.index(), entry.file_type });
+    did_remove_child(child_id, name);
+    return KSuccess;
+}
+
+static ext2_dir_entry_2* find_directory_entry(u8* block, size_t block_size, StringView name)
+{
+    for (size_t offset = 0; offset + 8 <= block_size;) {
+        auto* entry = reinterpret_cast<ext2_dir_entry_2*>(block + offset);
+        if (entry->rec_len < 8 || offset + entry->rec_len > block_size)
+            break;
+        if (entry->inode != 0 && StringView(entry->name, entry->name_len) == name)
+            return entry;
+        offset += entry->rec_len;
+    }
+    return nullptr;
+}
+
+// Puts a new entry into the first gap in the block that is big enough for it.
+static bool insert_directory_entry(u8* block, size_t block_size, StringView name, InodeIndex inode_index, u8 file_type)
+{
+    size_t needed_length = EXT2_DIR_REC_LEN(name.length());
+    for (size_t offset = 0; offset + 8 <= block_size;) {
+        auto* entry = reinterpret_cast<ext2_dir_entry_2*>(block + offset);
+        if (entry->rec_len < 8 || offset + entry->rec_len > block_size)
+            break;
+        size_t used_length = entry->inode != 0 ? EXT2_DIR_REC_LEN(entry->name_len) : 0;
+        if (entry->rec_len >= used_length + needed_length) {
+            auto* new_entry = entry;
+            if (used_length != 0) {
+                new_entry = reinterpret_cast<ext2_dir_entry_2*>(block + offset + used_length);
+                new_entry->rec_len = entry->rec_len - used_length;
+                entry->rec_len = used_length;
+            }
+            new_entry->inode = inode_index.value();
+            new_entry->name_len = name.length();
+            new_entry->file_type = file_type;
+            memcpy(new_entry->name, name.characters_without_null_termination(), name.length());
+            return true;
+        }
+        offset += entry->rec_len;
+    }
+    return false;
+}
+
+// Gives the space of a removed entry to the one before it, or marks it unused if it's the first one in the block.
+static bool remove_directory_entry(u8* block, size_t block_size, StringView name, InodeIndex& removed_inode_index)
+{
+    ext2_dir_entry_2* previous_entry = nullptr;
+    for (size_t offset = 0; offset + 8 <= block_size;) {
+        auto* entry = reinterpret_cast<ext2_dir_entry_2*>(block + offset);
+        if (entry->rec_len < 8 || offset + entry->rec_len > block_size)
+            break;
+        if (entry->inode != 0 && StringView(entry->name, entry->name_len) == name) {
+            removed_inode_index = entry->inode;
+            if (previous_entry)
+                previous_entry->rec_len += entry->rec_len;
+            else
+                entry->inode = 0;
+            return true;
+        }
+        previous_entry = entry;
+        offset += entry->rec_len;
+    }
+    return false;
+}
+
+// Fills a directory block with entries from its start, without any space between them.
+class DirectoryBlockWriter {
+public:
+    DirectoryBlockWriter(u8* block, size_t block_size)
+        : m_block(block)
+        , m_block_size(block_size)
+    {
+        memset(m_block, 0, m_block_size);
+    }
+
+    bool has_room_for(StringView name) const { return m_offset + EXT2_DIR_REC_LEN(name.length()) <= m_block_size; }
+    bool is_empty() const { return !m_last_entry; }
+    size_t used_size() const { return m_offset; }
+
+    void append(InodeIndex inode_index, StringView name, u8 file_type)
+    {
+        VERIFY(has_room_for(name));
+        auto* entry = reinterpret_cast<ext2_dir_entry_2*>(m_block + m_offset);
+        entry->inode = inode_index.value();
+        entry->rec_len = EXT2_DIR_REC_LEN(name.length());
+        entry->name_len = name.length();
+        entry->file_type = file_type;
+        memcpy(entry->name, name.characters_without_null_termination(), name.length());
+        m_offset += entry->rec_len;
+        m_last_entry = entry;
+    }
+
+    // The last entry takes up the rest of the block, or an unused one all of it.
+    void finish()
+    {
+        if (!m_last_entry) {
+            auto* entry = reinterpret_cast<ext2_dir_entry_2*>(m_block);
+            entry->rec_len = m_block_size;
+            return;
+        }
+        m_last_entry->rec_len += m_block_size - m_offset;
+    }
+
+private:
+    u8* m_block { nullptr };
+    size_t m_block_size { 0 };
+    size_t m_offset { 0 };
+    ext2_dir_entry_2* m_last_entry { nullptr };
+};
+
+static size_t dx_entry_limit(size_t block_size, size_t entries_offset)
+{
+    return (block_size - entries_offset) / sizeof(ext2_dx_entry);
+}
+
+static ext2_dx_entry* initialize_directory_index_node(u8* block, size_t block_size)
+{
+    DirectoryBlockWriter(block, block_size).finish();
+    auto* entries = reinterpret_cast<ext2_dx_entry*>(block + dx_node_entries_offset);
+    auto& countlimit = *reinterpret_cast<ext2_dx_countlimit*>(entries);
+    countlimit.limit = dx_entry_limit(block_size, dx_node_entries_offset);
+    countlimit.count = 0;
+    return entries;
+}
+
+// The directory hashes have to match what Linux and e2fsprogs compute, bit for bit.
+static u32 legacy_directory_hash(StringView name, bool is_unsigned)
+{
+    u32 hash0 = 0x12a3fe2d;
+    u32 hash1 = 0x37abe8f9;
+    for (char ch : name) {
+        i32 value = is_unsigned ? static_cast<u8>(ch) : static_cast<i8>(ch);
+        u32 hash = hash1 + (hash0 ^ (static_cast<u32>(value) * 7152373));
+        if (hash & 0x80000000)
+            hash -= 0x7fffffff;
+        hash1 = hash0;
+        hash0 = hash;
+    }
+    return hash0 << 1;
+}
+
+static void string_to_hash_buffer(StringView string, u32* buffer, size_t word_count, bool is_unsigned)
+{
+    u32 length = string.length();
+    u32 padding = length | (length << 8);
+    padding |= padding << 16;
+
+    u32 value = padding;
+    size_t words_written = 0;
+    size_t used_length = min(static_cast<size_t>(length), word_count * 4);
+    for (size_t i = 0; i < used_length; ++i) {
+        i32 ch = is_unsigned ? static_cast<u8>(string[i]) : static_cast<i8>(string[i]);
+        value = static_cast<u32>(ch) + (value << 8);
+        if (i % 4 == 3) {
+            buffer[words_written++] = value;
+            value = padding;
+        }
+    }
+    if (words_written < word_count)
+        buffer[words_written++] = value;
+    while (words_written < word_count)
+        buffer[words_written++] = padding;
+}
+
+static void half_md4_transform(u32* buffer, const u32* input)
+{
+    auto f = [](u32 x, u32 y, u32 z) { return z ^ (x & (y ^ z)); };
+    auto g = [](u32 x, u32 y, u32 z) { return (x & y) + ((x ^ y) & z); };
+    auto h = [](u32 x, u32 y, u32 z) { return x ^ y ^ z; };
+    auto round = [](auto function, u32& a, u32 b, u32 c, u32 d, u32 x, u32 shift) {
+        a += function(b, c, d) + x;
+        a = (a << shift) | (a >> (32 - shift));
+    };
+    constexpr u32 k2 = 0x5a827999;
+    constexpr u32 k3 = 0x6ed9eba1;
+
+    u32 a = buffer[0];
+    u32 b = buffer[1];
+    u32 c = buffer[2];
+    u32 d = buffer[3];
+
+    round(f, a, b, c, d, input[0], 3);
+    round(f, d, a, b, c, input[1], 7);
+    round(f, c, d, a, b, input[2], 11);
+    round(f, b, c, d, a, input[3], 19);
+    round(f, a, b, c, d, input[4], 3);
+    round(f, d, a, b, c, input[5], 7);
+    round(f, c, d, a, b, input[6], 11);
+    round(f, b, c, d, a, input[7], 19);
+
+    round(g, a, b, c, d, input[1] + k2, 3);
+    round(g, d, a, b, c, input[3] + k2, 5);
+    round(g, c, d, a, b, input[5] + k2, 9);
+    round(g, b, c, d, a, input[7] + k2, 13);
+    round(g, a, b, c, d, input[0] + k2, 3);
+    round(g, d, a, b, c, input[2] + k2, 5);
+    round(g, c, d, a, b, input[4] + k2, 9);
+    round(g, b, c, d, a, input[6] + k2, 13);
+
+    round(h, a, b, c, d, input[3] + k3, 3);
+    round(h, d, a, b, c, input[7] + k3, 9);
+    round(h, c, d, a, b, input[2] + k3, 11);
+    round(h, b, c, d, a, input[6] + k3, 15);
+    round(h, a, b, c, d, input[1] + k3, 3);
+    round(h, d, a, b, c, input[5] + k3, 9);
+    round(h, c, d, a, b, input[0] + k3, 11);
+    round(h, b, c, d, a, input[4] + k3, 15);
+
+    buffer[0] += a;
+    buffer[1] += b;
+    buffer[2] += c;
+    buffer[3] += d;
+}
+
+static void tea_transform(u32* buffer, const u32* input)
+{
+    constexpr u32 delta = 0x9e3779b9;
+    u32 sum = 0;
+    u32 b0 = buffer[0];
+    u32 b1 = buffer[1];
+    u32 a = input[0];
+    u32 b = input[1];
+    u32 c = input[2];
+    u32 d = input[3];
+    for (int i = 0; i < 16; ++i) {
+        sum += delta;
+        b0 += ((b1 << 4) + a) ^ (b1 + sum) ^ ((b1 >> 5) + b);
+        b1 += ((b0 << 4) + c) ^ (b0 + sum) ^ ((b0 >> 5) + d);
+    }
+    buffer[0] += b0;
+    buffer[1] += b1;
+}
+
+u32 Ext2FS::directory_hash(StringView name, u8 hash_version) const
+{
+    // The signedness of char decides how the original hashes treat names with non-ASCII characters.
+    // Which one a file system uses is in its superblock, and only signed chars are used without the flag.
+    bool is_unsigned = m_super_block.s_flags & EXT2_FLAGS_UNSIGNED_HASH;
+
+    u32 buffer[4] = { 0x67452301, 0xefcdab89, 0x98badcfe, 0x10325476 };
+    for (auto word : m_super_block.s_hash_seed) {
+        if (word != 0) {
+            memcpy(buffer, m_super_block.s_hash_seed, sizeof(buffer));
+            break;
+        }
+    }
+
+    u32 hash = 0;
+    switch (hash_version) {
+    case EXT2_HASH_LEGACY:
+        hash = legacy_directory_hash(name, is_unsigned);
+        break;
+    case EXT2_HASH_HALF_MD4:
+        for (size_t offset = 0; offset < name.length(); offset += 32) {
+            u32 input[8];
+            string_to_hash_buffer(name.substring_view(offset), input, 8, is_unsigned);
+            half_md4_transform(buffer, input);
+        }
+        hash = buffer[1];
+        break;
+    case EXT2_HASH_TEA:
+        for (size_t offset = 0; offset < name.length(); offset += 16) {
+            u32 input[4];
+            string_to_hash_buffer(name.substring_view(offset), input, 4, is_unsigned);
+            tea_transform(buffer, input);
+        }
+        hash = buffer[0];
+        break;
+    default:
+        VERIFY_NOT_REACHED();
+    }
+
+    // The lowest bit is used to mark collisions in the index, and the largest hash means "end of directory".
+    hash &= ~1u;
+    if (hash == 0x7fffffffu << 1)
+        hash = (0x7fffffffu - 1) << 1;
+    return hash;
+}
+
+bool Ext2FS::has_directory_index() const
+{
+    return m_super_block.s_rev_level > 0 && (m_super_block.s_feature_compat & EXT2_FEATURE_COMPAT_DIR_INDEX);
+}
+
+bool Ext2FSInode::is_indexed_directory() const
+{
+    return is_directory() && (m_raw_inode.i_flags & EXT2_INDEX_FL) && fs().has_directory_index();
+}
+
+void Ext2FSInode::drop_directory_index()
+{
+    // The index blocks look like unused directory entries, so the directory is still valid without it.
+    m_raw_inode.i_flags &= ~EXT2_INDEX_FL;
+    set_metadata_dirty(true);
+}
+
+KResult Ext2FSInode::read_directory_block(size_t logical_block_index, u8* buffer) const
+{
+    if (m_block_list.is_empty())
+        m_block_list = compute_block_list();
+    if (logical_block_index >= m_block_list.size() || m_block_list[logical_block_index].value() == 0) {
+        dbgln("Ext2FSInode[{}]::read_directory_block(): Block {} is not part of the directory", identifier(), logical_block_index);
+        return EIO;
+    }
+    auto buf = UserOrKernelBuffer::for_kernel_buffer(buffer);
+    return fs().read_block(m_block_list[logical_block_index], &buf, fs().block_size(), 0, true);
+}
+
+KResult Ext2FSInode::write_directory_block(size_t logical_block_index, const u8* data)
+{
+    auto block_size = fs().block_size();
+    auto buffer = UserOrKernelBuffer::for_kernel_buffer(const_cast<u8*>(data));
+    auto result = write_bytes(logical_block_index * block_size, block_size, buffer, nullptr);
+    if (result.is_error())
+        return result.error();
+    if (result.value() != block_size)
+        return EIO;
+    return KSuccess;
+}
+
+KResult Ext2FSInode::add_to_linear_directory(StringView name, InodeIndex inode_index, u8 file_type)
+{
+    // An index we don't keep up to date would send lookups to the wrong blocks.
+    if (m_raw_inode.i_flags & EXT2_INDEX_FL)
+        drop_directory_index();
+
+    auto block_size = fs().block_size();
+    auto block = ByteBuffer::create_uninitialized(block_size);
+    size_t block_count = size() / block_size;
+    for (size_t i = 0; i < block_count; ++i) {
+        if (auto result = read_directory_block(i, block.data()); result.is_error())
+            return result;
+        if (insert_directory_entry(block.data(), block_size, name, inode_index, file_type))
+            return write_directory_block(i, block.data());
+    }
+
+    // Directories that have outgrown their blocks get an index, if the file system supports them.
+    if (fs().has_directory_index() && name != "." && name != "..") {
+        auto indexed = build_directory_index(name, inode_index, file_type);
+        if (indexed.is_error())
+            return indexed.error();
+        if (indexed.value())
+            return KSuccess;
+    }
+
+    DirectoryBlockWriter writer(block.data(), block_size);
+    writer.append(inode_index, name, file_type);
+    writer.finish();
+    return write_directory_block(block_count, block.data());
+}
+
+KResultOr<InodeIndex> Ext2FSInode::remove_from_linear_directory(StringView name)
+{
+    if (m_raw_inode.i_flags & EXT2_INDEX_FL)
+        drop_directory_index();
+
+    auto block_size = fs().block_size();
+    auto block = ByteBuffer::create_uninitialized(block_size);
+    size_t block_count = size() / block_size;
+    for (size_t i = 0; i < block_count; ++i) {
+        if (auto result = read_directory_block(i, block.data()); result.is_error())
+            return result;
+        InodeIndex removed_inode_index;
+        if (remove_directory_entry(block.data(), block_size, name, removed_inode_index)) {
+            if (auto result = write_directory_block(i, block.data()); result.is_error())
+                return result;
+            return removed_inode_index;
+        }
+    }
+    return ENOENT;
+}
+
+KResultOr<bool> Ext2FSInode::build_directory_index(StringView new_name, InodeIndex new_inode_index, u8 new_file_type)
+{
+    auto block_size = fs().block_size();
+    u8 hash_version = fs().super_block().s_def_hash_version;
+    if (hash_version > EXT2_HASH_TEA)
+        hash_version = EXT2_HASH_HALF_MD4;
+
+    struct HashedEntry {
+        u32 hash { 0 };
+        Ext2FSDirectoryEntry entry;
+    };
+    Vector<HashedEntry> entries;
+    InodeIndex parent_inode_index;
+    auto result = traverse_as_directory([&](auto& entry) {
+        if (entry.name == "..")
+            parent_inode_index = entry.inode.index();
+        else if (entry.name != ".")
+            entries.append({ fs().directory_hash(entry.name, hash_version), { entry.name, entry.inode.index(), entry.file_type } });
         return true;
     });
     if (result.is_error())
         return result;
+    if (parent_inode_index == 0)
+        return false;
+    entries.append({ fs().directory_hash(new_name, hash_version), { new_name, new_inode_index, new_file_type } });
+    quick_sort(entries, [](auto& a, auto& b) { return a.hash < b.hash; });
+
+    // Leave some room in every leaf, so that the next few names don't split it right away.
+    Vector<size_t> leaf_starts;
+    Vector<u32> leaf_hashes;
+    size_t leaf_fill_size = block_size * 3 / 4;
+    size_t used_size = leaf_fill_size;
+    for (size_t i = 0; i < entries.size(); ++i) {
+        size_t record_length = EXT2_DIR_REC_LEN(entries[i].entry.name.length());
+        if (used_size + record_length > leaf_fill_size) {
+            leaf_starts.append(i);
+            // Names with the same hash that end up in two leaves are marked as a collision.
+            bool continued = i > 0 && entries[i - 1].hash == entries[i].hash;
+            leaf_hashes.append(entries[i].hash | continued);
+            used_size = 0;
+        }
+        used_size += record_length;
+    }
 
-    result = write_directory(entries);
-    if (result.is_error())
+    size_t leaf_count = leaf_starts.size();
+    size_t root_limit = dx_entry_limit(block_size, dx_root_entries_offset);
+    size_t node_limit = dx_entry_limit(block_size, dx_node_entries_offset);
+    u8 indirect_levels = leaf_count > root_limit ? 1 : 0;
+    size_t node_count = indirect_levels ? divide_rounded_up(leaf_count, node_limit) : 0;
+    if (node_count > root_limit)
+        return false;
+
+    dbgln_if(EXT2_DEBUG, "Ext2FSInode[{}]::build_directory_index(): Indexing {} entries in {} leaves and {} index nodes", identifier(), entries.size(), leaf_count, node_count);
+
+    // The root comes first, then the leaves and finally the index nodes below the root, if there are any.
+    auto block = ByteBuffer::create_uninitialized(block_size);
+    {
+        DirectoryBlockWriter writer(block.data(), block_size);
+        writer.append(index(), ".", EXT2_FT_DIR);
+        writer.append(parent_inode_index, "..", EXT2_FT_DIR);
+        writer.finish();
+        VERIFY(writer.used_size() == dx_root_info_offset);
+        auto& info = *reinterpret_cast<ext2_dx_root_info*>(block.data() + dx_root_info_offset);
+        info.hash_version = hash_version;
+        info.info_length = sizeof(ext2_dx_root_info);
+        info.indirect_levels = indirect_levels;
+        auto* root_entries = reinterpret_cast<ext2_dx_entry*>(block.data() + dx_root_entries_offset);
+        size_t root_count = indirect_levels ? node_count : leaf_count;
+        for (size_t i = 0; i < root_count; ++i) {
+            root_entries[i].hash = indirect_levels ? leaf_hashes[i * node_limit] : leaf_hashes[i];
+            root_entries[i].block = indirect_levels ? 1 + leaf_count + i : 1 + i;
+        }
+        auto& countlimit = *reinterpret_cast<ext2_dx_countlimit*>(root_entries);
+        countlimit.limit = root_limit;
+        countlimit.count = root_count;
+        if (auto result = write_directory_block(0, block.data()); result.is_error())
+            return result;
+    }
+
+    for (size_t leaf = 0; leaf < leaf_count; ++leaf) {
+        DirectoryBlockWriter writer(block.data(), block_size);
+        size_t end = leaf + 1 < leaf_count ? leaf_starts[leaf + 1] : entries.size();
+        for (size_t i = leaf_starts[leaf]; i < end; ++i) {
+            auto& entry = entries[i].entry;
+            writer.append(entry.inode_index, entry.name, entry.file_type);
+        }
+        writer.finish();
+        if (auto result = write_directory_block(1 + leaf, block.data()); result.is_error())
+            return result;
+    }
+
+    for (size_t node = 0; node < node_count; ++node) {
+        auto* node_entries = initialize_directory_index_node(block.data(), block_size);
+        size_t first_leaf = node * node_limit;
+        size_t count = min(node_limit, leaf_count - first_leaf);
+        for (size_t i = 0; i < count; ++i) {
+            if (i != 0)
+                node_entries[i].hash = leaf_hashes[first_leaf + i];
+            node_entries[i].block = 1 + first_leaf + i;
+        }
+        reinterpret_cast<ext2_dx_countlimit*>(node_entries)->count = count;
+        if (auto result = write_directory_block(1 + leaf_count + node, block.data()); result.is_error())
+            return result;
+    }
+
+    size_t new_size = (1 + leaf_count + node_count) * block_size;
+    if (new_size < size()) {
+        if (auto result = resize(new_size); result.is_error())
+            return result;
+    }
+
+    m_raw_inode.i_flags |= EXT2_INDEX_FL;
+    set_metadata_dirty(true);
+    m_lookup_cache.clear();
+    return true;
+}
+
+// Every index node has at least the entry that covers the lowest hashes, and its limit has
+// to match what fits into its block, or following the entries could run past the end of it.
+static bool is_valid_directory_index_frame(Ext2FSDirectoryIndexFrame& frame, size_t block_size)
+{
+    auto& countlimit = frame.countlimit();
+    return countlimit.count > 0 && countlimit.count <= countlimit.limit && countlimit.limit == dx_entry_limit(block_size, frame.entries_offset);
+}
+
+KResult Ext2FSInode::probe_directory_index(StringView name, Ext2FSDirectoryIndexPath& path) const
+{
+    auto block_size = fs().block_size();
+    path.frames.clear();
+
+    size_t block_index = 0;
+    u8 indirect_levels = 0;
+    for (size_t depth = 0; depth <= indirect_levels; ++depth) {
+        Ext2FSDirectoryIndexFrame frame;
+        frame.block_index = block_index;
+        frame.data = ByteBuffer::create_uninitialized(block_size);
+        if (auto result = read_directory_block(block_index, frame.data.data()); result.is_error())
+            return result;
+
+        if (depth == 0) {
+            auto& info = *reinterpret_cast<const ext2_dx_root_info*>(frame.data.data() + dx_root_info_offset);
+            if (info.hash_version > EXT2_HASH_TEA || info.info_length != sizeof(ext2_dx_root_info) || info.indirect_levels > max_dx_indirect_levels) {
+                dbgln("Ext2FSInode[{}]::probe_directory_index(): Unsupported index (hash version {}, info length {}, {} indirect levels)", identifier(), info.hash_version, info.info_length, info.indirect_levels);
+                return EIO;
+            }
+            indirect_levels = info.indirect_levels;
+            path.hash_version = info.hash_version;
+            path.hash = fs().directory_hash(name, info.hash_version);
+            frame.entries_offset = dx_root_entries_offset;
+        } else {
+            frame.entries_offset = dx_node_entries_offset;
+        }
+
+        auto& countlimit = frame.countlimit();
+        if (!is_valid_directory_index_frame(frame, block_size)) {
+            dbgln("Ext2FSInode[{}]::probe_directory_index(): Corrupted index node in block {} (count {}, limit {})", identifier(), block_index, countlimit.count, countlimit.limit);
+            return EIO;
+        }
+
+        // Find the last entry with a hash that isn't above ours. The first one covers everything below the second one.
+        auto* entries = frame.entries();
+        size_t low = 1;
+        size_t high = countlimit.count;
+        while (low < high) {
+            size_t middle = low + (high - low) / 2;
+            if (entries[middle].hash > path.hash)
+                high = middle;
+            else
+                low = middle + 1;
+        }
+        frame.position = low - 1;
+        block_index = frame.current_entry().block;
+        path.frames.append(move(frame));
+    }
+
+    path.leaf_block_index = block_index;
+    return KSuccess;
+}
+
+KResultOr<bool> Ext2FSInode::advance_directory_index_path(Ext2FSDirectoryIndexPath& path) const
+{
+    // Go up until there is a level that has an entry after the one we followed.
+    size_t depth = path.frames.size();
+    while (depth > 0 && path.frames[depth - 1].position + 1 >= path.frames[depth - 1].countlimit().count)
+        --depth;
+    if (depth == 0)
+        return false;
+
+    // Names with our hash only continue in the next block if its hash is the same as ours, with the collision bit set.
+    auto& frame = path.frames[depth - 1];
+    if ((frame.entries()[frame.position + 1].hash & ~1u) != path.hash)
+        return false;
+    ++frame.position;
+
+    for (size_t i = depth; i < path.frames.size(); ++i) {
+        auto& child = path.frames[i];
+        child.block_index = path.frames[i - 1].current_entry().block;
+        child.position = 0;
+        if (auto result = read_directory_block(child.block_index, child.data.data()); result.is_error())
+            return result;
+        if (!is_valid_directory_index_frame(child, fs().block_size())) {
+            dbgln("Ext2FSInode[{}]::advance_directory_index_path(): Corrupted index node in block {} (count {}, limit {})", identifier(), child.block_index, child.countlimit().count, child.countlimit().limit);
+            return EIO;
+        }
+    }
+    path.leaf_block_index = path.frames.last().current_entry().block;
+    return true;
+}
+
+KResult Ext2FSInode::insert_directory_index_entry(Ext2FSDirectoryIndexFrame& frame, u32 hash, size_t block_index)
+{
+    auto* entries = frame.entries();
+    auto& countlimit = frame.countlimit();
+    VERIFY(countlimit.count < countlimit.limit);
+    size_t position = frame.position + 1;
+    memmove(&entries[position + 1], &entries[position], (countlimit.count - position) * sizeof(ext2_dx_entry));
+    entries[position].hash = hash;
+    entries[position].block = block_index;
+    ++countlimit.count;
+    return write_directory_block(frame.block_index, frame.data.data());
+}
+
+KResult Ext2FSInode::split_directory_leaf(Ext2FSDirectoryIndexPath& path, const u8* leaf)
+{
+    auto block_size = fs().block_size();
+
+    struct HashedEntry {
+        u32 hash { 0 };
+        const ext2_dir_entry_2* entry { nullptr };
+    };
+    Vector<HashedEntry> entries;
+    size_t total_size = 0;
+    for (size_t offset = 0; offset + 8 <= block_size;) {
+        auto* entry = reinterpret_cast<const ext2_dir_entry_2*>(leaf + offset);
+        if (entry->rec_len < 8 || offset + entry->rec_len > block_size)
+            break;
+        if (entry->inode != 0) {
+            entries.append({ fs().directory_hash({ entry->name, entry->name_len }, path.hash_version), entry });
+            total_size += EXT2_DIR_REC_LEN(entry->name_len);
+        }
+        offset += entry->rec_len;
+    }
+    if (entries.size() < 2) {
+        dbgln("Ext2FSInode[{}]::split_directory_leaf(): Can't split block {} with {} entries", identifier(), path.leaf_block_index, entries.size());
+        return EIO;
+    }
+    quick_sort(entries, [](auto& a, auto& b) { return a.hash < b.hash; });
+
+    // The entries with the higher hashes move to a new leaf, until both have about the same amount of space left.
+    size_t split = 1;
+    size_t lower_size = EXT2_DIR_REC_LEN(entries[0].entry->name_len);
+    while (split < entries.size() - 1 && lower_size < total_size / 2) {
+        lower_size += EXT2_DIR_REC_LEN(entries[split].entry->name_len);
+        ++split;
+    }
+    bool continued = entries[split - 1].hash == entries[split].hash;
+    u32 split_hash = entries[split].hash | continued;
+
+    auto lower = ByteBuffer::create_uninitialized(block_size);
+    auto upper = ByteBuffer::create_uninitialized(block_size);
+    DirectoryBlockWriter lower_writer(lower.data(), block_size);
+    DirectoryBlockWriter upper_writer(upper.data(), block_size);
+    for (size_t i = 0; i < entries.size(); ++i) {
+        auto* entry = entries[i].entry;
+        (i < split ? lower_writer : upper_writer).append(entry->inode, { entry->name, entry->name_len }, entry->file_type);
+    }
+    lower_writer.finish();
+    upper_writer.finish();
+
+    size_t new_block_index = size() / block_size;
+    dbgln_if(EXT2_DEBUG, "Ext2FSInode[{}]::split_directory_leaf(): Moving {} of {} entries from block {} to block {}", identifier(), entries.size() - split, entries.size(), path.leaf_block_index, new_block_index);
+    if (auto result = write_directory_block(new_block_index, upper.data()); result.is_error())
+        return result;
+    if (auto result = write_directory_block(path.leaf_block_index, lower.data()); result.is_error())
         return result;
+    return insert_directory_index_entry(path.frames.last(), split_hash, new_block_index);
+}
 
-    m_lookup_cache.remove(name);
+KResult Ext2FSInode::grow_directory_index(Ext2FSDirectoryIndexPath& path)
+{
+    auto block_size = fs().block_size();
+    auto& root = path.frames.first();
+    auto block = ByteBuffer::create_uninitialized(block_size);
+
+    if (path.frames.size() == 1) {
+        // The root is full, so its entries move into an index node one level further down.
+        auto* node_entries = initialize_directory_index_node(block.data(), block_size);
+        auto& node_countlimit = *reinterpret_cast<ext2_dx_countlimit*>(node_entries);
+        u16 count = root.countlimit().count;
+        u16 node_limit = node_countlimit.limit;
+        memcpy(node_entries, root.entries(), count * sizeof(ext2_dx_entry));
+        node_countlimit.limit = node_limit;
+        node_countlimit.count = count;
+
+        size_t node_block_index = size() / block_size;
+        dbgln_if(EXT2_DEBUG, "Ext2FSInode[{}]::grow_directory_index(): Moving the root entries to block {}", identifier(), node_block_index);
+        if (auto result = write_directory_block(node_block_index, block.data()); result.is_error())
+            return result;
 
-    auto child_inode = fs().get_inode(child_id);
-    result = child_inode->decrement_link_count();
-    if (result.is_error())
+        root.countlimit().count = 1;
+        root.entries()[0].block = node_block_index;
+        reinterpret_cast<ext2_dx_root_info*>(root.data.data() + dx_root_info_offset)->indirect_levels = 1;
+        return write_directory_block(0, root.data.data());
+    }
+
+    if (root.countlimit().count == root.countlimit().limit) {
+        dbgln("Ext2FSInode[{}]::grow_directory_index(): The directory index is full", identifier());
+        return ENOSPC;
+    }
+
+    // Split the full index node in two, and add the second half to the root.
+    auto& node = path.frames[1];
+    u16 count = node.countlimit().count;
+    u16 split = count / 2;
+    u32 split_hash = node.entries()[split].hash;
+
+    auto* new_entries = initialize_directory_index_node(block.data(), block_size);
+    auto& new_countlimit = *reinterpret_cast<ext2_dx_countlimit*>(new_entries);
+    u16 node_limit = new_countlimit.limit;
+    memcpy(new_entries, &node.entries()[split], (count - split) * sizeof(ext2_dx_entry));
+    new_countlimit.limit = node_limit;
+    new_countlimit.count = count - split;
+
+    size_t new_block_index = size() / block_size;
+    dbgln_if(EXT2_DEBUG, "Ext2FSInode[{}]::grow_directory_index(): Moving {} of {} entries from index block {} to block {}", identifier(), count - split, count, node.block_index, new_block_index);
+    if (auto result = write_directory_block(new_block_index, block.data()); result.is_error())
+        return result;
+    node.countlimit().count = split;
+    if (auto result = write_directory_block(node.block_index, node.data.data()); result.is_error())
         return result;
+    return insert_directory_index_entry(root, split_hash, new_block_index);
+}
 
-    did_remove_child(child_id, name);
-    return KSuccess;
+KResultOr<InodeIndex> Ext2FSInode::find_in_directory_index(StringView name) const
+{
+    auto block_size = fs().block_size();
+    auto block = ByteBuffer::create_uninitialized(block_size);
+
+    if (name == "." || name == "..") {
+        if (auto result = read_directory_block(0, block.data()); result.is_error())
+            return result;
+        auto* entry = find_directory_entry(block.data(), block_size, name);
+        return InodeIndex(entry ? entry->inode : 0);
+    }
+
+    Ext2FSDirectoryIndexPath path;
+    if (auto result = probe_directory_index(name, path); result.is_error())
+        return result;
+    for (;;) {
+        if (auto result = read_directory_block(path.leaf_block_index, block.data()); result.is_error())
+            return result;
+        if (auto* entry = find_directory_entry(block.data(), block_size, name))
+            return InodeIndex(entry->inode);
+        auto advanced = advance_directory_index_path(path);
+        if (advanced.is_error())
+            return advanced.error();
+        if (!advanced.value())
+            return InodeIndex(0);
+    }
+}
+
+KResult Ext2FSInode::add_to_directory_index(StringView name, InodeIndex inode_index, u8 file_type)
+{
+    auto block_size = fs().block_size();
+    auto leaf = ByteBuffer::create_uninitialized(block_size);
+    for (;;) {
+        Ext2FSDirectoryIndexPath path;
+        if (auto result = probe_directory_index(name, path); result.is_error())
+            return result;
+        if (auto result = read_directory_block(path.leaf_block_index, leaf.data()); result.is_error())
+            return result;
+        if (insert_directory_entry(leaf.data(), block_size, name, inode_index, file_type))
+            return write_directory_block(path.leaf_block_index, leaf.data());
+
+        // The leaf is full, so half of it has to move to a new one. That needs room in the index node above it,
+        // and once there is some, we look for the leaf again.
+        auto& node = path.frames.last();
+        auto result = node.countlimit().count < node.countlimit().limit ? split_directory_leaf(path, leaf.data()) : grow_directory_index(path);
+        if (result.is_error())
+            return result;
+    }
+}
+
+KResultOr<InodeIndex> Ext2FSInode::remove_from_directory_index(StringView name)
+{
+    auto block_size = fs().block_size();
+    auto leaf = ByteBuffer::create_uninitialized(block_size);
+
+    Ext2FSDirectoryIndexPath path;
+    if (auto result = probe_directory_index(name, path); result.is_error())
+        return result;
+    for (;;) {
+        if (auto result = read_directory_block(path.leaf_block_index, leaf.data()); result.is_error())
+            return result;
+        InodeIndex removed_inode_index;
+        if (remove_directory_entry(leaf.data(), block_size, name, removed_inode_index)) {
+            if (auto result = write_directory_block(path.leaf_block_index, leaf.data()); result.is_error())
+                return result;
+            return removed_inode_index;
+        }
+        auto advanced = advance_directory_index_path(path);
+        if (advanced.is_error())
+            return advanced.error();
+        if (!advanced.value())
+            return ENOENT;
+    }
 }
 
 unsigned Ext2FS::inodes_per_block() const
@@ -1286,16 +2444,24 @@ bool Ext2FS::write_ext2_inode(InodeIndex inode, const ext2_inode& e2inode)
     return write_block(block_index, buffer, inode_size(), offset) >= 0;
 }
 
-auto Ext2FS::allocate_blocks(GroupIndex preferred_group_index, size_t count) -> KResultOr<Vector<BlockIndex>>
+auto Ext2FS::allocate_blocks(GroupIndex preferred_group_index, size_t count, size_t delayed_count) -> KResultOr<Vector<BlockIndex>>
 {
     Locker locker(m_lock);
-    dbgln_if(EXT2_DEBUG, "Ext2FS: allocate_blocks(preferred group: {}, count {})", preferred_group_index, count);
+    dbgln_if(EXT2_DEBUG, "Ext2FS: allocate_blocks(preferred group: {}, count {}, delayed: {})", preferred_group_index, count, delayed_count);
+    VERIFY(delayed_count <= m_delayed_block_count);
     if (count == 0)
         return Vector<BlockIndex> {};
+    if (count + m_delayed_block_count - delayed_count > m_super_block.s_free_blocks_count)
+        return ENOSPC;
 
     Vector<BlockIndex> blocks;
     dbgln_if(EXT2_DEBUG, "Ext2FS: allocate_blocks:");
     blocks.ensure_capacity(count);
+    auto give_up = [&](KResult error) -> KResult {
+        for (auto block_index : blocks)
+            (void)set_block_allocation_state(block_index, false);
+        return error;
+    };
 
     auto group_index = preferred_group_index;
 
@@ -1324,7 +2490,7 @@ auto Ext2FS::allocate_blocks(GroupIndex preferred_group_index, size_t count) ->
 
         auto cached_bitmap_or_error = get_bitmap_block(bgd.bg_block_bitmap);
         if (cached_bitmap_or_error.is_error())
-            return cached_bitmap_or_error.error();
+            return give_up(cached_bitmap_or_error.error());
         auto& cached_bitmap = *cached_bitmap_or_error.value();
 
         int blocks_in_group = min(blocks_per_group(), super_block().s_blocks_count);
@@ -1339,7 +2505,7 @@ auto Ext2FS::allocate_blocks(GroupIndex preferred_group_index, size_t count) ->
             BlockIndex block_index = (first_unset_bit_index.value() + i) + first_block_in_group.value();
             if (auto result = set_block_allocation_state(block_index, true); result.is_error()) {
                 dbgln("Ext2FS: Failed to allocate block {} in allocate_blocks()", block_index);
-                return result;
+                return give_up(result);
             }
             blocks.unchecked_append(block_index);
             dbgln_if(EXT2_DEBUG, "  allocated > {}", block_index);
@@ -1350,6 +2516,152 @@ auto Ext2FS::allocate_blocks(GroupIndex preferred_group_index, size_t count) ->
     return blocks;
 }
 
+auto Ext2FS::allocate_blocks_for_inode(InodeIndex inode, size_t count, BlockIndex goal, size_t delayed_count) -> KResultOr<Vector<BlockIndex>>
+{
+    Locker locker(m_lock);
+    dbgln_if(EXT2_DEBUG, "Ext2FS: allocate_blocks_for_inode(inode: {}, count: {}, goal: {}, delayed: {})", inode, count, goal, delayed_count);
+    VERIFY(delayed_count <= count);
+    VERIFY(delayed_count <= m_delayed_block_count);
+    if (count == 0)
+        return Vector<BlockIndex> {};
+    if (count - delayed_count + m_delayed_block_count > m_super_block.s_free_blocks_count)
+        return ENOSPC;
+
+    Vector<BlockIndex> blocks;
+    if (!blocks.try_ensure_capacity(count))
+        return ENOMEM;
+
+    // The delayed blocks stay counted against the free blocks until the caller has put them in place, see release_delayed_blocks().
+    auto give_up = [&](KResult error) -> KResult {
+        for (auto block_index : blocks) {
+            if (auto result = set_block_allocation_state(block_index, false); result.is_error())
+                dbgln("Ext2FS: Failed to free block {} in allocate_blocks_for_inode(): {}", block_index, result.error());
+        }
+        return error;
+    };
+
+    auto& window = m_reservation_windows.ensure(inode);
+    while (blocks.size() < count) {
+        if (window.used == window.size && !open_reservation_window(window, inode, goal, count - blocks.size()))
+            break;
+        BlockIndex block_index = window.start.value() + window.used++;
+        auto state_or_error = get_block_allocation_state(block_index);
+        if (state_or_error.is_error())
+            return give_up(state_or_error.error());
+        if (state_or_error.value()) {
+            // Someone who doesn't use a window took this block, so the rest of the window is likely gone as well.
+            window.size = window.used;
+            continue;
+        }
+        if (auto result = set_block_allocation_state(block_index, true); result.is_error())
+            return give_up(result);
+        blocks.unchecked_append(block_index);
+        goal = block_index.value() + 1;
+    }
+
+    if (blocks.size() < count) {
+        // There's no room for a window anywhere, so take whatever is free.
+        auto blocks_or_error = allocate_blocks(group_index_from_inode(inode), count - blocks.size(), delayed_count);
+        if (blocks_or_error.is_error())
+            return give_up(blocks_or_error.error());
+        blocks.extend(blocks_or_error.release_value());
+    }
+
+    VERIFY(blocks.size() == count);
+    return blocks;
+}
+
+bool Ext2FS::open_reservation_window(ReservationWindow& window, InodeIndex inode, BlockIndex goal, size_t count)
+{
+    VERIFY(m_lock.is_locked());
+    size_t size = min(count + max(window.next_size, min_reservation_window_size), static_cast<size_t>(blocks_per_group()));
+    window.next_size = min(max(window.next_size * 2, min_reservation_window_size * 2), max_reservation_window_size);
+
+    // Start looking at the goal, so the new window continues where the last one ended.
+    GroupIndex first_group_index = goal.value() ? group_index_from_block_index(goal) : group_index_from_inode(inode);
+    for (unsigned i = 0; i < m_block_group_count; ++i) {
+        GroupIndex group_index = (first_group_index.value() - 1 + i) % m_block_group_count + 1;
+        auto& bgd = group_descriptor(group_index);
+        if (bgd.bg_free_blocks_count < size)
+            continue;
+
+        auto cached_bitmap_or_error = get_bitmap_block(bgd.bg_block_bitmap);
+        if (cached_bitmap_or_error.is_error())
+            return false;
+        size_t blocks_in_group = min(blocks_per_group(), super_block().s_blocks_count);
+        auto block_bitmap = cached_bitmap_or_error.value()->bitmap(blocks_in_group);
+        BlockIndex first_block_in_group = (group_index.value() - 1) * blocks_per_group() + first_block_index().value();
+
+        size_t search_from = 0;
+        if (i == 0 && goal >= first_block_in_group && goal.value() - first_block_in_group.value() < blocks_in_group)
+            search_from = goal.value() - first_block_in_group.value();
+
+        while (search_from < blocks_in_group) {
+            auto range_length = block_bitmap.find_next_range_of_unset_bits(search_from, size, size);
+            if (!range_length.has_value())
+                break;
+            BlockIndex start = first_block_in_group.value() + search_from;
+            BlockIndex end_of_overlap;
+            if (!overlaps_reservation_window(inode, start, size, end_of_overlap)) {
+                dbgln_if(EXT2_DEBUG, "Ext2FS: Opened reservation window of {} blocks at {} for inode {}", size, start, inode);
+                window.start = start;
+                window.size = size;
+                window.used = 0;
+                return true;
+            }
+            search_from = end_of_overlap.value() - first_block_in_group.value();
+        }
+    }
+    return false;
+}
+
+bool Ext2FS::overlaps_reservation_window(InodeIndex inode, BlockIndex first_block, size_t count, BlockIndex& end_of_overlap) const
+{
+    for (auto& it : m_reservation_windows) {
+        if (it.key == inode)
+            continue;
+        auto& window = it.value;
+        auto window_start = window.start.value() + window.used;
+        auto window_end = window.start.value() + window.size;
+        if (window_start < window_end && first_block.value() < window_end && window_start < first_block.value() + count) {
+            end_of_overlap = window_end;
+            return true;
+        }
+    }
+    return false;
+}
+
+void Ext2FS::release_reservation_window(InodeIndex inode)
+{
+    Locker locker(m_lock);
+    m_reservation_windows.remove(inode);
+}
+
+KResult Ext2FS::reserve_delayed_block(Ext2FSInode& inode)
+{
+    Locker locker(m_lock);
+    if (m_delayed_block_count >= m_super_block.s_free_blocks_count)
+        return ENOSPC;
+    ++m_delayed_block_count;
+    m_inodes_with_delayed_blocks.set(inode.index());
+    return KSuccess;
+}
+
+void Ext2FS::release_delayed_blocks(Ext2FSInode& inode, size_t count)
+{
+    Locker locker(m_lock);
+    VERIFY(m_delayed_block_count >= count);
+    m_delayed_block_count -= count;
+    if (inode.m_delayed_blocks.is_empty())
+        m_inodes_with_delayed_blocks.remove(inode.index());
+}
+
+size_t Ext2FS::delayed_block_count() const
+{
+    Locker locker(m_lock);
+    return m_delayed_block_count;
+}
+
 KResultOr<InodeIndex> Ext2FS::allocate_inode(GroupIndex preferred_group)
 {
     dbgln_if(EXT2_DEBUG, "Ext2FS: allocate_inode(preferred_group: {})", preferred_group);
@@ -1470,6 +2782,22 @@ KResult Ext2FS::update_bitmap_block(BlockIndex bitmap_block, size_t bit_index, b
     return KSuccess;
 }
 
+KResultOr<bool> Ext2FS::get_block_allocation_state(BlockIndex block_index) const
+{
+    Locker locker(m_lock);
+    if (block_index == 0)
+        return EINVAL;
+    auto group_index = group_index_from_block_index(block_index);
+    unsigned index_in_group = (block_index.value() - first_block_index().value()) - ((group_index.value() - 1) * blocks_per_group());
+    unsigned bit_index = index_in_group % blocks_per_group();
+    auto& bgd = group_descriptor(group_index);
+
+    auto cached_bitmap_or_error = const_cast<Ext2FS&>(*this).get_bitmap_block(bgd.bg_block_bitmap);
+    if (cached_bitmap_or_error.is_error())
+        return cached_bitmap_or_error.error();
+    return cached_bitmap_or_error.value()->bitmap(blocks_per_group()).get(bit_index);
+}
+
 KResult Ext2FS::set_inode_allocation_state(InodeIndex inode_index, bool new_state)
 {
     Locker locker(m_lock);
@@ -1621,6 +2949,15 @@ RefPtr<Inode> Ext2FSInode::lookup(StringView name)
 {
     VERIFY(is_directory());
     dbgln_if(EXT2_DEBUG, "Ext2FSInode[{}]:lookup(): Looking up '{}'", identifier(), name);
+    if (is_indexed_directory()) {
+        Locker locker(m_lock);
+        auto inode_index = find_in_directory_index(name);
+        if (inode_index.is_error() || inode_index.value() == 0) {
+            dbgln_if(EXT2_DEBUG, "Ext2FSInode[{}]:lookup(): '{}' not found", identifier(), name);
+            return {};
+        }
+        return fs().get_inode({ fsid(), inode_index.value() });
+    }
     if (populate_lookup_cache().is_error())
         return {};
     Locker locker(m_lock);
@@ -1688,8 +3025,11 @@ KResult Ext2FSInode::decrement_link_count()
 
     --m_raw_inode.i_links_count;
     set_metadata_dirty(true);
-    if (m_raw_inode.i_links_count == 0)
+    if (m_raw_inode.i_links_count == 0) {
         did_delete_self();
+        // Nobody can open this file anymore, so don't keep it alive for the page cache.
+        PageCache::the().forget(*this);
+    }
 
     if (ref_count() == 1 && m_raw_inode.i_links_count == 0)
         fs().uncache_inode(index());
@@ -1701,12 +3041,19 @@ void Ext2FS::uncache_inode(InodeIndex index)
 {
     Locker locker(m_lock);
     m_inode_cache.remove(index);
+    release_reservation_window(index);
 }
 
 KResultOr<size_t> Ext2FSInode::directory_entry_count() const
 {
     VERIFY(is_directory());
     Locker locker(m_lock);
+    if (is_indexed_directory()) {
+        size_t count = 0;
+        if (auto result = traverse_as_directory([&](auto&) { ++count; return true; }); result.is_error())
+            return KResultOr<size_t>(result);
+        return count;
+    }
     if (auto result = populate_lookup_cache(); result.is_error())
         return KResultOr<size_t>(result);
     return m_lookup_cache.size();
@@ -1744,10 +3091,37 @@ KResult Ext2FSInode::truncate(u64 size)
     return KSuccess;
 }
 
+KResult Ext2FSInode::preallocate(u64 offset, u64 length)
+{
+    Locker locker(m_lock);
+    if (!Kernel::is_regular_file(m_raw_inode.i_mode))
+        return ENODEV;
+    if (length == 0)
+        return EINVAL;
+    if (auto result = prepare_to_write_data(); result.is_error())
+        return result;
+
+    auto end = offset + length;
+    if (end > size()) {
+        if (auto result = resize(end); result.is_error())
+            return result;
+    }
+
+    if (m_block_list.is_empty())
+        m_block_list = compute_block_list();
+
+    auto block_size = fs().block_size();
+    return allocate_blocks_in_range(offset / block_size, (end - 1) / block_size, true);
+}
+
 KResultOr<int> Ext2FSInode::get_block_address(int index)
 {
     Locker locker(m_lock);
 
+    // Blocks that are waiting to be allocated don't have an address yet.
+    if (auto result = allocate_delayed_blocks(); result.is_error())
+        return result;
+
     if (m_block_list.is_empty())
         m_block_list = compute_block_list();
 
@@ -1766,7 +3140,7 @@ unsigned Ext2FS::total_block_count() const
 unsigned Ext2FS::free_block_count() const
 {
     Locker locker(m_lock);
-    return super_block().s_free_blocks_count;
+    return super_block().s_free_blocks_count - m_delayed_block_count;
 }
 
 unsigned Ext2FS::total_inode_count() const
@@ -1783,8 +3157,13 @@ unsigned Ext2FS::free_inode_count() const
 
 KResult Ext2FS::prepare_to_unmount() const
 {
+    // The inode cache is about to be thrown away, along with any data that hasn't been allocated yet.
+    const_cast<Ext2FS&>(*this).allocate_delayed_blocks();
+
     Locker locker(m_lock);
 
+    PageCache::the().forget_all(*this);
+
     for (auto& it : m_inode_cache) {
         if (it.value->ref_count() > 1)
             return EBUSY;
@@ -7,12 +7,17 @@
 #pragma once
 
 #include <AK/BitmapView.h>
+#include <AK/ByteBuffer.h>
 #include <AK/HashMap.h>
+#include <AK/HashTable.h>
+#include <AK/OwnPtr.h>
 #include <Kernel/FileSystem/BlockBasedFileSystem.h>
 #include <Kernel/FileSystem/Inode.h>
 #include <Kernel/FileSystem/ext2_fs.h>
 #include <Kernel/KBuffer.h>
 #include <Kernel/UnixTypes.h>
+#include <Kernel/VM/AnonymousVMObject.h>
+#include <Kernel/VM/Region.h>
 
 struct ext2_group_desc;
 struct ext2_inode;
@@ -22,6 +27,8 @@ namespace Kernel {
 
 class Ext2FS;
 struct Ext2FSDirectoryEntry;
+struct Ext2FSDirectoryIndexFrame;
+struct Ext2FSDirectoryIndexPath;
 
 class Ext2FSInode final : public Inode {
     friend class Ext2FS;
@@ -39,6 +46,7 @@ public:
 private:
     // ^Inode
     virtual KResultOr<size_t> read_bytes(off_t, size_t, UserOrKernelBuffer& buffer, FileDescription*) const override;
+    virtual KResultOr<size_t> read_bytes_uncached(off_t, size_t, UserOrKernelBuffer& buffer) const override;
     virtual InodeMetadata metadata() const override;
     virtual KResult traverse_as_directory(Function<bool(const FS::DirectoryEntryView&)>) const override;
     virtual RefPtr<Inode> lookup(StringView name) override;
@@ -56,10 +64,27 @@ private:
     virtual KResult chmod(mode_t) override;
     virtual KResult chown(uid_t, gid_t) override;
     virtual KResult truncate(u64) override;
+    virtual KResult preallocate(u64 offset, u64 length) override;
     virtual KResultOr<int> get_block_address(int) override;
 
+    KResultOr<size_t> read_bytes_from_blocks(off_t, size_t, UserOrKernelBuffer& buffer, bool allow_cache) const;
     KResult write_directory(Vector<Ext2FSDirectoryEntry>&);
     KResult populate_lookup_cache() const;
+    KResult read_directory_block(size_t logical_block_index, u8* buffer) const;
+    KResult write_directory_block(size_t logical_block_index, const u8* data);
+    KResult add_to_linear_directory(StringView name, InodeIndex, u8 file_type);
+    KResultOr<InodeIndex> remove_from_linear_directory(StringView name);
+    bool is_indexed_directory() const;
+    void drop_directory_index();
+    KResultOr<bool> build_directory_index(StringView new_name, InodeIndex new_inode_index, u8 new_file_type);
+    KResult probe_directory_index(StringView name, Ext2FSDirectoryIndexPath&) const;
+    KResultOr<bool> advance_directory_index_path(Ext2FSDirectoryIndexPath&) const;
+    KResult insert_directory_index_entry(Ext2FSDirectoryIndexFrame&, u32 hash, size_t block_index);
+    KResult split_directory_leaf(Ext2FSDirectoryIndexPath&, const u8* leaf);
+    KResult grow_directory_index(Ext2FSDirectoryIndexPath&);
+    KResultOr<InodeIndex> find_in_directory_index(StringView name) const;
+    KResult add_to_directory_index(StringView name, InodeIndex, u8 file_type);
+    KResultOr<InodeIndex> remove_from_directory_index(StringView name);
     KResult resize(u64);
     KResult write_indirect_block(BlockBasedFS::BlockIndex, Span<BlockBasedFS::BlockIndex>);
     KResult grow_doubly_indirect_block(BlockBasedFS::BlockIndex, size_t, Span<BlockBasedFS::BlockIndex>, Vector<BlockBasedFS::BlockIndex>&, unsigned&);
@@ -67,6 +92,13 @@ private:
     KResult grow_triply_indirect_block(BlockBasedFS::BlockIndex, size_t, Span<BlockBasedFS::BlockIndex>, Vector<BlockBasedFS::BlockIndex>&, unsigned&);
     KResult shrink_triply_indirect_block(BlockBasedFS::BlockIndex, size_t, size_t, unsigned&);
     KResult flush_block_list();
+    KResult write_block_pointer(size_t logical_block_index, BlockBasedFS::BlockIndex);
+    KResult allocate_blocks_in_range(size_t first_block, size_t last_block, bool fill_holes);
+    KResult allocate_delayed_blocks();
+    KResultOr<u8*> add_delayed_block(size_t logical_block_index);
+    bool remove_delayed_block(size_t logical_block_index);
+    void drop_delayed_blocks();
+    u8* delayed_block_data(size_t slot) const;
     Vector<BlockBasedFS::BlockIndex> compute_block_list() const;
     Vector<BlockBasedFS::BlockIndex> compute_block_list_with_meta_blocks() const;
     Vector<BlockBasedFS::BlockIndex> compute_block_list_impl(bool include_block_list_blocks) const;
@@ -77,7 +109,16 @@ private:
     Ext2FSInode(Ext2FS&, InodeIndex);
 
     mutable Vector<BlockBasedFS::BlockIndex> m_block_list;
+    // Only used for linear directories. Indexed ones look names up through the index instead.
     mutable HashMap<String, InodeIndex> m_lookup_cache;
+    // The contents of blocks that have been written to, but haven't been given a place on disk yet.
+    // They are holes in m_block_list until allocate_delayed_blocks() is called.
+    // Each logical block index maps to a block-sized slot in m_delayed_region, whose pages
+    // are only allocated once one of their slots is used.
+    HashMap<size_t, size_t> m_delayed_blocks;
+    Vector<size_t> m_free_delayed_slots;
+    RefPtr<AnonymousVMObject> m_delayed_vmobject;
+    OwnPtr<Region> m_delayed_region;
     ext2_inode m_raw_inode;
 };
 
@@ -107,6 +148,7 @@ public:
     virtual u8 internal_file_type_to_directory_entry_type(const DirectoryEntryView& entry) const override;
 
     FeaturesReadOnly get_features_readonly() const;
+    bool has_directory_index() const;
 
 private:
     TYPEDEF_DISTINCT_ORDERED_ID(unsigned, GroupIndex);
@@ -128,23 +170,32 @@ private:
 
     bool flush_super_block();
 
+    u32 directory_hash(StringView name, u8 hash_version) const;
+
     virtual const char* class_name() const override;
     virtual NonnullRefPtr<Inode> root_inode() const override;
     RefPtr<Inode> get_inode(InodeIdentifier) const;
     KResultOr<NonnullRefPtr<Inode>> create_inode(Ext2FSInode& parent_inode, const String& name, mode_t, dev_t, uid_t, gid_t);
     KResult create_directory(Ext2FSInode& parent_inode, const String& name, mode_t, uid_t, gid_t);
     virtual void flush_writes() override;
+    virtual void allocate_delayed_blocks() override;
 
     BlockIndex first_block_index() const;
     KResultOr<InodeIndex> allocate_inode(GroupIndex preferred_group = 0);
-    KResultOr<Vector<BlockIndex>> allocate_blocks(GroupIndex preferred_group_index, size_t count);
+    KResultOr<Vector<BlockIndex>> allocate_blocks(GroupIndex preferred_group_index, size_t count, size_t delayed_count = 0);
+    KResultOr<Vector<BlockIndex>> allocate_blocks_for_inode(InodeIndex, size_t count, BlockIndex goal = 0, size_t delayed_count = 0);
     GroupIndex group_index_from_inode(InodeIndex) const;
     GroupIndex group_index_from_block_index(BlockIndex) const;
 
     KResultOr<bool> get_inode_allocation_state(InodeIndex) const;
     KResult set_inode_allocation_state(InodeIndex, bool);
+    KResultOr<bool> get_block_allocation_state(BlockIndex) const;
     KResult set_block_allocation_state(BlockIndex, bool);
 
+    KResult reserve_delayed_block(Ext2FSInode&);
+    void release_delayed_blocks(Ext2FSInode&, size_t count);
+    size_t delayed_block_count() const;
+
     void uncache_inode(InodeIndex);
     void free_inode(Ext2FSInode&);
 
@@ -184,6 +235,28 @@ private:
     KResult update_bitmap_block(BlockIndex bitmap_block, size_t bit_index, bool new_state, u32& super_block_counter, u16& group_descriptor_counter);
 
     Vector<OwnPtr<CachedBitmap>> m_cached_bitmaps;
+
+    // Free blocks that are set aside in memory for the next allocations of an inode, so files
+    // that are written at the same time don't end up interleaved on disk. They are only a hint:
+    // allocations without a window don't avoid them, and nothing about them is written to disk.
+    struct ReservationWindow {
+        BlockIndex start { 0 };
+        size_t size { 0 };
+        size_t used { 0 };
+        // Each time an inode fills up its window, the next one it gets is bigger.
+        size_t next_size { 0 };
+    };
+
+    bool open_reservation_window(ReservationWindow&, InodeIndex, BlockIndex goal, size_t count);
+    bool overlaps_reservation_window(InodeIndex, BlockIndex first_block, size_t count, BlockIndex& end_of_overlap) const;
+    void release_reservation_window(InodeIndex);
+
+    HashMap<InodeIndex, ReservationWindow> m_reservation_windows;
+
+    // Blocks that inodes have written data for, but that haven't been allocated yet.
+    // They are counted against the free blocks, so write-back can't run out of space.
+    size_t m_delayed_block_count { 0 };
+    HashTable<InodeIndex> m_inodes_with_delayed_blocks;
 };
 
 inline Ext2FS& Ext2FSInode::fs()
@@ -141,6 +141,26 @@ KResultOr<size_t> FIFO::write(FileDescription&, u64, const UserOrKernelBuffer& b
     return m_buffer.write(buffer, size);
 }
 
+KResultOr<size_t> FIFO::write_from(FileDescription&, u64, UserOrKernelBufferFiller& filler, size_t size)
+{
+    if (!m_readers) {
+        Thread::current()->send_signal(SIGPIPE, Process::current());
+        return EPIPE;
+    }
+
+    return m_buffer.write_from(filler, size);
+}
+
+KResult FIFO::gift_page(PhysicalPage& page)
+{
+    if (!m_readers) {
+        Thread::current()->send_signal(SIGPIPE, Process::current());
+        return EPIPE;
+    }
+
+    return m_buffer.gift_page(page);
+}
+
 String FIFO::absolute_path(const FileDescription&) const
 {
     return String::formatted("fifo:{}", m_fifo_id);
@@ -6,8 +6,8 @@
 
 #pragma once
 
-#include <Kernel/DoubleBuffer.h>
 #include <Kernel/FileSystem/File.h>
+#include <Kernel/FileSystem/PipeBuffer.h>
 #include <Kernel/Lock.h>
 #include <Kernel/UnixTypes.h>
 #include <Kernel/WaitQueue.h>
@@ -35,9 +35,17 @@ public:
     void attach(Direction);
     void detach(Direction);
 
+    size_t capacity() const { return m_buffer.capacity(); }
+    // Any growth is charged to whoever created the pipe.
+    KResult set_capacity(size_t capacity, bool is_superuser) { return m_buffer.set_capacity(capacity, m_uid, is_superuser); }
+
+    // Puts a page into the pipe without copying it, see PipeBuffer::gift_page().
+    KResult gift_page(PhysicalPage&);
+
 private:
     // ^File
     virtual KResultOr<size_t> write(FileDescription&, u64, const UserOrKernelBuffer&, size_t) override;
+    virtual KResultOr<size_t> write_from(FileDescription&, u64, UserOrKernelBufferFiller&, size_t) override;
     virtual KResultOr<size_t> read(FileDescription&, u64, UserOrKernelBuffer&, size_t) override;
     virtual KResult stat(::stat&) const override;
     virtual bool can_read(const FileDescription&, size_t) const override;
@@ -50,7 +58,7 @@ private:
 
     unsigned m_writers { 0 };
     unsigned m_readers { 0 };
-    DoubleBuffer m_buffer;
+    PipeBuffer m_buffer;
 
     uid_t m_uid { 0 };
 
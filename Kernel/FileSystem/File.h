@@ -87,6 +87,9 @@ public:
     virtual void did_seek(FileDescription&, off_t) { }
     virtual KResultOr<size_t> read(FileDescription&, u64, UserOrKernelBuffer&, size_t) = 0;
     virtual KResultOr<size_t> write(FileDescription&, u64, const UserOrKernelBuffer&, size_t) = 0;
+    // Files that buffer written data themselves can let the filler produce
+    // it right into that buffer. Others have to be written to with write().
+    virtual KResultOr<size_t> write_from(FileDescription&, u64, UserOrKernelBufferFiller&, size_t) { return ENOTSUP; }
     virtual int ioctl(FileDescription&, unsigned request, FlatPtr arg);
     virtual KResultOr<Region*> mmap(Process&, FileDescription&, const Range&, u64 offset, int prot, bool shared);
     virtual KResult stat(::stat&) const { return EBADF; }
@@ -94,6 +97,7 @@ public:
     virtual String absolute_path(const FileDescription&) const = 0;
 
     virtual KResult truncate(u64) { return EINVAL; }
+    virtual KResult preallocate(u64, u64) { return ENODEV; }
     virtual KResult chown(FileDescription&, uid_t, gid_t) { return EBADF; }
     virtual KResult chmod(FileDescription&, mode_t) { return EBADF; }
 
@@ -110,6 +114,8 @@ public:
     virtual bool is_character_device() const { return false; }
     virtual bool is_socket() const { return false; }
     virtual bool is_inode_watcher() const { return false; }
+    virtual bool is_event_queue() const { return false; }
+    virtual bool is_io_ring() const { return false; }
 
     virtual FileBlockCondition& block_condition() { return m_block_condition; }
 
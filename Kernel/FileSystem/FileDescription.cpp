@@ -9,9 +9,11 @@
 #include <Kernel/Debug.h>
 #include <Kernel/Devices/BlockDevice.h>
 #include <Kernel/FileSystem/Custody.h>
+#include <Kernel/FileSystem/EventQueue.h>
 #include <Kernel/FileSystem/FIFO.h>
 #include <Kernel/FileSystem/FileDescription.h>
 #include <Kernel/FileSystem/FileSystem.h>
+#include <Kernel/FileSystem/IORing.h>
 #include <Kernel/FileSystem/InodeFile.h>
 #include <Kernel/FileSystem/InodeWatcher.h>
 #include <Kernel/Net/Socket.h>
@@ -74,6 +76,10 @@ FileDescription::~FileDescription()
     (void)m_file->close();
     if (m_inode)
         m_inode->detach(*this);
+    // Event queue interests only hold weak pointers to us. Let them notice
+    // that we're gone while the file is still around to tell them.
+    revoke_weak_ptrs();
+    evaluate_block_conditions();
 }
 
 KResult FileDescription::attach()
@@ -185,6 +191,40 @@ KResultOr<size_t> FileDescription::write(const UserOrKernelBuffer& data, size_t
     return nwritten_or_error;
 }
 
+KResultOr<size_t> FileDescription::read(UserOrKernelBuffer& buffer, u64 offset, size_t count)
+{
+    if (Checked<u64>::addition_would_overflow(offset, count))
+        return EOVERFLOW;
+    auto nread_or_error = m_file->read(*this, offset, buffer, count);
+    if (!nread_or_error.is_error())
+        evaluate_block_conditions();
+    return nread_or_error;
+}
+
+KResultOr<size_t> FileDescription::write(u64 offset, const UserOrKernelBuffer& data, size_t size)
+{
+    if (Checked<u64>::addition_would_overflow(offset, size))
+        return EOVERFLOW;
+    auto nwritten_or_error = m_file->write(*this, offset, data, size);
+    if (!nwritten_or_error.is_error())
+        evaluate_block_conditions();
+    return nwritten_or_error;
+}
+
+KResultOr<size_t> FileDescription::write_from(UserOrKernelBufferFiller& filler, size_t size)
+{
+    Locker locker(m_lock);
+    if (Checked<off_t>::addition_would_overflow(m_current_offset, size))
+        return EOVERFLOW;
+    auto nwritten_or_error = m_file->write_from(*this, offset(), filler, size);
+    if (!nwritten_or_error.is_error()) {
+        if (m_file->is_seekable())
+            m_current_offset += nwritten_or_error.value();
+        evaluate_block_conditions();
+    }
+    return nwritten_or_error;
+}
+
 bool FileDescription::can_write() const
 {
     return m_file->can_write(*this, offset());
@@ -323,6 +363,37 @@ InodeWatcher* FileDescription::inode_watcher()
     return static_cast<InodeWatcher*>(m_file.ptr());
 }
 
+bool FileDescription::is_event_queue() const
+{
+    return m_file->is_event_queue();
+}
+
+const EventQueue* FileDescription::event_queue() const
+{
+    if (!is_event_queue())
+        return nullptr;
+    return static_cast<const EventQueue*>(m_file.ptr());
+}
+
+EventQueue* FileDescription::event_queue()
+{
+    if (!is_event_queue())
+        return nullptr;
+    return static_cast<EventQueue*>(m_file.ptr());
+}
+
+bool FileDescription::is_io_ring() const
+{
+    return m_file->is_io_ring();
+}
+
+IORing* FileDescription::io_ring()
+{
+    if (!is_io_ring())
+        return nullptr;
+    return static_cast<IORing*>(m_file.ptr());
+}
+
 bool FileDescription::is_master_pty() const
 {
     return m_file->is_master_pty();
@@ -375,6 +446,12 @@ KResult FileDescription::truncate(u64 length)
     return m_file->truncate(length);
 }
 
+KResult FileDescription::preallocate(u64 offset, u64 length)
+{
+    Locker locker(m_lock);
+    return m_file->preallocate(offset, length);
+}
+
 bool FileDescription::is_fifo() const
 {
     return m_file->is_fifo();
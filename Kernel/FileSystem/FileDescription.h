@@ -9,6 +9,7 @@
 #include <AK/Badge.h>
 #include <AK/ByteBuffer.h>
 #include <AK/RefCounted.h>
+#include <AK/Weakable.h>
 #include <Kernel/FileSystem/FIFO.h>
 #include <Kernel/FileSystem/Inode.h>
 #include <Kernel/FileSystem/InodeMetadata.h>
@@ -23,7 +24,9 @@ public:
     virtual ~FileDescriptionData() = default;
 };
 
-class FileDescription : public RefCounted<FileDescription> {
+class FileDescription
+    : public RefCounted<FileDescription>
+    , public Weakable<FileDescription> {
     MAKE_SLAB_ALLOCATED(FileDescription)
 public:
     static KResultOr<NonnullRefPtr<FileDescription>> create(Custody&);
@@ -48,7 +51,10 @@ public:
 
     KResultOr<off_t> seek(off_t, int whence);
     KResultOr<size_t> read(UserOrKernelBuffer&, size_t);
+    KResultOr<size_t> read(UserOrKernelBuffer&, u64 offset, size_t);
     KResultOr<size_t> write(const UserOrKernelBuffer& data, size_t);
+    KResultOr<size_t> write(u64 offset, const UserOrKernelBuffer& data, size_t);
+    KResultOr<size_t> write_from(UserOrKernelBufferFiller&, size_t);
     KResult stat(::stat&);
 
     KResult chmod(mode_t);
@@ -81,6 +87,13 @@ public:
     const InodeWatcher* inode_watcher() const;
     InodeWatcher* inode_watcher();
 
+    bool is_event_queue() const;
+    const EventQueue* event_queue() const;
+    EventQueue* event_queue();
+
+    bool is_io_ring() const;
+    IORing* io_ring();
+
     bool is_master_pty() const;
     const MasterPTY* master_pty() const;
     MasterPTY* master_pty();
@@ -116,6 +129,7 @@ public:
     void set_original_inode(Badge<VFS>, NonnullRefPtr<Inode>&& inode) { m_inode = move(inode); }
 
     KResult truncate(u64);
+    KResult preallocate(u64 offset, u64 length);
 
     off_t offset() const { return m_current_offset; }
 
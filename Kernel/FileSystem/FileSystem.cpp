@@ -66,6 +66,23 @@ void FS::sync()
         fs.flush_writes();
 }
 
+KResult FS::take_write_errors()
+{
+    NonnullRefPtrVector<FS, 32> fses;
+    {
+        InterruptDisabler disabler;
+        for (auto& it : all_fses())
+            fses.append(*it.value);
+    }
+
+    KResult error = KSuccess;
+    for (auto& fs : fses) {
+        if (auto result = fs.take_write_error(); result.is_error() && error.is_success())
+            error = result;
+    }
+    return error;
+}
+
 void FS::lock_all()
 {
     for (auto& it : all_fses()) {
@@ -34,6 +34,7 @@ public:
     unsigned fsid() const { return m_fsid; }
     static FS* from_fsid(u32);
     static void sync();
+    static KResult take_write_errors();
     static void lock_all();
 
     virtual bool initialize() = 0;
@@ -59,6 +60,8 @@ public:
     };
 
     virtual void flush_writes() { }
+    // Returns the first error that came up while writing data back since the last call.
+    virtual KResult take_write_error() { return KSuccess; }
 
     size_t block_size() const { return m_block_size; }
     size_t fragment_size() const { return m_fragment_size; }
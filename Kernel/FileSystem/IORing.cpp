@@ -0,0 +1,373 @@
+/*
+ * Copyright (c) 2021, the SerenityOS developers.
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#include <AK/Atomic.h>
+#include <Kernel/FileSystem/FileDescription.h>
+#include <Kernel/FileSystem/IORing.h>
+#include <Kernel/Net/Socket.h>
+#include <Kernel/Process.h>
+#include <Kernel/VM/MemoryManager.h>
+#include <Kernel/VM/ProcessPagingScope.h>
+#include <Kernel/WorkQueue.h>
+
+namespace Kernel {
+
+using BlockFlags = Thread::FileBlocker::BlockFlags;
+
+KResultOr<NonnullRefPtr<IORing>> IORing::create(Process& process, u32 submission_entries, u32 completion_entries)
+{
+    size_t size = page_round_up(io_ring_size(submission_entries, completion_entries));
+    auto vmobject = AnonymousVMObject::create_with_size(size, AllocationStrategy::AllocateNow);
+    if (!vmobject)
+        return ENOMEM;
+    auto region = MM.allocate_kernel_region_with_vmobject(*vmobject, size, "IORing", Region::Access::Read | Region::Access::Write);
+    if (!region)
+        return ENOMEM;
+    auto io_ring = adopt_ref_if_nonnull(new IORing(process, submission_entries, completion_entries, vmobject.release_nonnull(), region.release_nonnull()));
+    if (io_ring)
+        return io_ring.release_nonnull();
+    return ENOMEM;
+}
+
+IORing::IORing(Process& process, u32 submission_entries, u32 completion_entries, NonnullRefPtr<AnonymousVMObject> vmobject, NonnullOwnPtr<Region> region)
+    : m_process(process)
+    , m_vmobject(move(vmobject))
+    , m_region(move(region))
+    , m_header(reinterpret_cast<IORingHeader*>(m_region->vaddr().as_ptr()))
+    , m_submissions(reinterpret_cast<IORingSubmission*>(m_header + 1))
+    , m_completions(reinterpret_cast<IORingCompletion*>(m_submissions + submission_entries))
+    , m_submission_entries(submission_entries)
+    , m_completion_entries(completion_entries)
+{
+    m_header->submission_entries = submission_entries;
+    m_header->completion_entries = completion_entries;
+}
+
+IORing::~IORing()
+{
+    // NOTE: This isn't done in close(), since that is called whenever any
+    //       description of the ring is closed, e.g. by a forked child.
+    Locker locker(m_lock);
+    while (auto pending = m_pending.take_first())
+        pending->cancel();
+}
+
+KResultOr<u32> IORing::submit(u32 to_submit)
+{
+    auto& process = *Process::current();
+    VERIFY(is_owned_by(process));
+
+    Vector<IORingSubmission, 32> submissions;
+    {
+        Locker locker(m_lock);
+
+        u32 submission_tail = AK::atomic_load(&m_header->submission_tail, AK::memory_order_acquire);
+        u32 completion_head = AK::atomic_load(&m_header->completion_head, AK::memory_order_acquire);
+
+        u32 queued = submission_tail - m_submission_head;
+        if (queued > m_submission_entries)
+            return EINVAL;
+
+        // Only take as much work as we have room for in the completion ring.
+        u32 outstanding = m_completion_tail - completion_head + m_in_flight;
+        u32 room = outstanding < m_completion_entries ? m_completion_entries - outstanding : 0;
+        to_submit = min(to_submit, min(queued, room));
+        if (to_submit == 0)
+            return queued > 0 ? KResultOr<u32>(EBUSY) : 0u;
+
+        if (!submissions.try_resize(to_submit))
+            return ENOMEM;
+        // Take a copy, userspace may rewrite the entries as soon as they are consumed.
+        for (u32 i = 0; i < to_submit; i++)
+            submissions[i] = *submission_at(m_submission_head + i);
+
+        m_submission_head += to_submit;
+        m_in_flight += to_submit;
+        AK::atomic_store(&m_header->submission_head, m_submission_head, AK::memory_order_release);
+    }
+
+    for (auto& submission : submissions)
+        submit_one(process, submission);
+    return to_submit;
+}
+
+KResult IORing::wait_for_completions(u32 min_complete)
+{
+    if (min_complete > m_completion_entries)
+        return EINVAL;
+
+    for (;;) {
+        {
+            Locker locker(m_lock);
+            u32 completion_head = AK::atomic_load(&m_header->completion_head, AK::memory_order_acquire);
+            if (m_completion_tail - completion_head >= min_complete)
+                return KSuccess;
+            // Nothing that could still complete would get us there.
+            if (m_completion_tail - completion_head + m_in_flight < min_complete)
+                return EAGAIN;
+        }
+        if (m_completion_wait_queue.wait_on({}, "IORing").was_interrupted())
+            return EINTR;
+    }
+}
+
+void IORing::submit_one(Process& process, const IORingSubmission& submission)
+{
+    auto opcode = static_cast<IORingOpcode>(submission.opcode);
+    if (opcode == IORingOpcode::Nop) {
+        post_completion(submission.user_data, 0);
+        return;
+    }
+
+    auto description = process.file_description(submission.fd);
+    if (!description) {
+        post_completion(submission.user_data, -EBADF);
+        return;
+    }
+
+    // Don't let a slow file hold up the rest of the batch, park the
+    // submission until the file is ready instead.
+    auto result = execute(process, submission, *description);
+    if (result.is_error() && result.error().error() == -EAGAIN) {
+        park(submission, *description);
+        return;
+    }
+    post_completion(submission.user_data, result.is_error() ? result.error().error() : result.value());
+}
+
+void IORing::park(const IORingSubmission& submission, FileDescription& description)
+{
+    auto flags = BlockFlags::None;
+    switch (static_cast<IORingOpcode>(submission.opcode)) {
+    case IORingOpcode::Read:
+        flags = BlockFlags::Read;
+        break;
+    case IORingOpcode::Write:
+        flags = BlockFlags::Write;
+        break;
+    case IORingOpcode::Accept:
+        flags = BlockFlags::Accept;
+        break;
+    default:
+        VERIFY_NOT_REACHED();
+    }
+
+    auto pending = adopt_ref_if_nonnull(new PendingSubmission(*this, submission, description, flags));
+    if (!pending) {
+        post_completion(submission.user_data, -ENOMEM);
+        return;
+    }
+    {
+        Locker locker(m_lock);
+        m_pending.append(*pending);
+    }
+    pending->arm();
+}
+
+void IORing::run_pending_submission(PendingSubmission& pending)
+{
+    {
+        Locker locker(m_lock);
+        // We may have been destroyed and cancelled everything in the meantime.
+        if (!pending.m_list_node.is_in_list())
+            return;
+        m_pending.remove(pending);
+    }
+
+    auto process = m_process.strong_ref();
+    if (!process || process->is_dead())
+        return;
+
+    ProcessPagingScope paging_scope(*process);
+    auto& submission = pending.submission();
+    auto result = execute(*process, submission, pending.description());
+    if (result.is_error() && result.error().error() == -EAGAIN) {
+        // Someone else got to the data first, wait for the next change.
+        park(submission, pending.description());
+        return;
+    }
+    post_completion(submission.user_data, result.is_error() ? result.error().error() : result.value());
+}
+
+// Submissions that were parked run on a work queue shared by all rings, so
+// nothing here may wait for a file to become ready. If it isn't, EAGAIN is
+// returned and the submission is parked until it is.
+KResultOr<int> IORing::execute(Process& process, const IORingSubmission& submission, FileDescription& description)
+{
+    switch (static_cast<IORingOpcode>(submission.opcode)) {
+    case IORingOpcode::Read: {
+        if (!description.is_readable())
+            return EBADF;
+        if (description.is_directory())
+            return EISDIR;
+        if (submission.length > NumericLimits<i32>::max())
+            return EINVAL;
+        auto buffer = UserOrKernelBuffer::for_user_buffer(reinterpret_cast<u8*>(submission.buffer), submission.length);
+        if (!buffer.has_value())
+            return EFAULT;
+        if (!description.can_read())
+            return EAGAIN;
+        KResultOr<size_t> nread_or_error { 0 };
+        if (description.is_socket()) {
+            // A socket waits for data itself if the description is blocking,
+            // and someone else may have taken what made it readable.
+            auto& socket = *description.socket();
+            if (socket.is_shut_down_for_reading())
+                return 0;
+            Time timestamp {};
+            nread_or_error = socket.recvfrom(description, buffer.value(), submission.length, MSG_DONTWAIT, {}, {}, timestamp);
+        } else {
+            nread_or_error = description.read(buffer.value(), submission.length);
+        }
+        if (nread_or_error.is_error())
+            return nread_or_error.error();
+        return static_cast<int>(nread_or_error.value());
+    }
+    case IORingOpcode::Write: {
+        if (!description.is_writable())
+            return EBADF;
+        if (submission.length > NumericLimits<i32>::max())
+            return EINVAL;
+        auto buffer = UserOrKernelBuffer::for_user_buffer(reinterpret_cast<u8*>(submission.buffer), submission.length);
+        if (!buffer.has_value())
+            return EFAULT;
+        if (!description.can_write())
+            return EAGAIN;
+        // Someone else may have filled the file up again in the meantime, so
+        // don't let a socket wait for room even if the description is blocking.
+        KResultOr<size_t> nwritten_or_error { 0 };
+        if (description.is_socket())
+            nwritten_or_error = description.socket()->sendto(description, buffer.value(), submission.length, MSG_DONTWAIT, {}, 0);
+        else
+            nwritten_or_error = description.write(buffer.value(), submission.length);
+        if (nwritten_or_error.is_error())
+            return nwritten_or_error.error();
+        return static_cast<int>(nwritten_or_error.value());
+    }
+    case IORingOpcode::Fsync: {
+        auto* inode = description.inode();
+        if (!inode)
+            return EINVAL;
+        inode->flush_metadata();
+        inode->fs().flush_writes();
+        if (auto result = inode->fs().take_write_error(); result.is_error())
+            return result;
+        return 0;
+    }
+    case IORingOpcode::Accept:
+        return execute_accept(process, submission, description);
+    default:
+        return EINVAL;
+    }
+}
+
+KResultOr<int> IORing::execute_accept(Process& process, const IORingSubmission& submission, FileDescription& description)
+{
+    if (process.has_promises() && !process.has_promised(Pledge::accept))
+        return EPERM;
+    if (!description.is_socket())
+        return ENOTSOCK;
+    auto& socket = *description.socket();
+
+    // We may be running on the I/O ring work queue, so take the lock that
+    // normally protects the file descriptor table during a syscall.
+    Locker locker(process.big_lock());
+
+    int accepted_socket_fd = process.alloc_fd();
+    if (accepted_socket_fd < 0)
+        return accepted_socket_fd;
+
+    auto accepted_socket = socket.accept(process);
+    if (!accepted_socket)
+        return EAGAIN;
+
+    auto accepted_socket_description_result = FileDescription::create(*accepted_socket);
+    if (accepted_socket_description_result.is_error())
+        return accepted_socket_description_result.error();
+
+    accepted_socket_description_result.value()->set_readable(true);
+    accepted_socket_description_result.value()->set_writable(true);
+    if (submission.flags & SOCK_NONBLOCK)
+        accepted_socket_description_result.value()->set_blocking(false);
+    int fd_flags = 0;
+    if (submission.flags & SOCK_CLOEXEC)
+        fd_flags |= FD_CLOEXEC;
+    process.m_fds[accepted_socket_fd].set(accepted_socket_description_result.release_value(), fd_flags);
+
+    // NOTE: Moving this state to Completed is what causes connect() to unblock on the client side.
+    accepted_socket->set_setup_state(Socket::SetupState::Completed);
+    return accepted_socket_fd;
+}
+
+void IORing::post_completion(u64 user_data, i32 result)
+{
+    {
+        Locker locker(m_lock);
+        // NOTE: This goes through our own mapping of the ring, so it's fine
+        //       if userspace has unmapped it in the meantime.
+        *completion_at(m_completion_tail) = { user_data, result, 0 };
+        m_completion_tail++;
+        AK::atomic_store(&m_header->completion_tail, m_completion_tail, AK::memory_order_release);
+        VERIFY(m_in_flight > 0);
+        m_in_flight--;
+    }
+    m_completion_wait_queue.wake_all();
+}
+
+KResultOr<Region*> IORing::mmap(Process& process, FileDescription&, const Range& range, u64 offset, int prot, bool shared)
+{
+    if (offset != 0 || range.size() > m_vmobject->size())
+        return EINVAL;
+    // Both sides write to the ring, so a private copy would be useless.
+    if (!shared)
+        return EINVAL;
+    return process.space().allocate_region_with_vmobject(range, m_vmobject, offset, "IORing", prot, shared);
+}
+
+IORing::PendingSubmission::PendingSubmission(IORing& ring, const IORingSubmission& submission, FileDescription& description, BlockFlags flags)
+    : m_ring(ring.make_weak_ptr<IORing>())
+    , m_submission(submission)
+    , m_description(description)
+    , m_flags(flags)
+{
+}
+
+void IORing::PendingSubmission::arm()
+{
+    // If the file is ready already, unblock() has queued us and we were
+    // never added to the block condition.
+    (void)set_block_condition(m_description->block_condition());
+}
+
+void IORing::PendingSubmission::cancel()
+{
+    m_description->block_condition().remove_blocker(*this, nullptr);
+}
+
+bool IORing::PendingSubmission::unblock(bool, void*)
+{
+    if (m_description->should_unblock(m_flags) == BlockFlags::None)
+        return false;
+
+    {
+        ScopedSpinLock lock(m_lock);
+        if (m_did_fire)
+            return false;
+        m_did_fire = true;
+    }
+
+    // We are called with the block condition locked, so do the actual
+    // work on the I/O ring work queue.
+    g_io_ring_work->queue([ring = m_ring, pending = NonnullRefPtr<PendingSubmission>(*this)]() mutable {
+        if (auto strong_ring = ring.strong_ref())
+            strong_ring->run_pending_submission(*pending);
+    });
+
+    // Returning true removes us from the block condition.
+    return true;
+}
+
+}
@@ -0,0 +1,121 @@
+/*
+ * Copyright (c) 2021, the SerenityOS developers.
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#pragma once
+
+#include <AK/IntrusiveList.h>
+#include <AK/WeakPtr.h>
+#include <Kernel/API/IORing.h>
+#include <Kernel/FileSystem/File.h>
+#include <Kernel/Lock.h>
+#include <Kernel/VM/AnonymousVMObject.h>
+#include <Kernel/VM/Region.h>
+#include <Kernel/WaitQueue.h>
+
+namespace Kernel {
+
+// An IORing lets a process queue many I/O operations with a single
+// syscall and reap their completions from shared memory without entering
+// the kernel at all. The ring is allocated by the kernel and mapped into the
+// process with mmap(), so completions can be posted through our own mapping
+// even if the process has unmapped it in the meantime.
+//
+// Submissions are picked up by io_ring_enter() and run right away if the
+// file is ready. Otherwise they are parked on the file's block condition,
+// and once it becomes ready they are run on a work queue inside the address
+// space of the submitting process, the same way AsyncDeviceRequest reaches
+// user buffers from a device's completion path. That queue is shared by all
+// rings, so operations never wait for a file there. If it isn't ready anymore
+// by the time they run, they are parked again.
+class IORing final : public File {
+public:
+    static constexpr u32 max_entries = 4096;
+
+    static KResultOr<NonnullRefPtr<IORing>> create(Process&, u32 submission_entries, u32 completion_entries);
+    virtual ~IORing() override;
+
+    // Completions are consumed from shared memory, there is nothing to read.
+    virtual bool can_read(const FileDescription&, size_t) const override { return false; }
+    virtual KResultOr<size_t> read(FileDescription&, u64, UserOrKernelBuffer&, size_t) override { return EINVAL; }
+    virtual bool can_write(const FileDescription&, size_t) const override { return false; }
+    virtual KResultOr<size_t> write(FileDescription&, u64, const UserOrKernelBuffer&, size_t) override { return EINVAL; }
+
+    virtual String absolute_path(const FileDescription&) const override { return "io-ring"; }
+    virtual const char* class_name() const override { return "IORing"; }
+    virtual bool is_io_ring() const override { return true; }
+    virtual KResultOr<Region*> mmap(Process&, FileDescription&, const Range&, u64 offset, int prot, bool shared) override;
+
+    // Submissions refer to the file descriptors and buffers of the process
+    // that created the ring, so these must be called from that process.
+    bool is_owned_by(const Process& process) const { return m_process.unsafe_ptr() == &process; }
+    KResultOr<u32> submit(u32 to_submit);
+    KResult wait_for_completions(u32 min_complete);
+
+private:
+    class PendingSubmission final
+        : public Thread::FileBlocker
+        , public RefCounted<PendingSubmission> {
+    public:
+        PendingSubmission(IORing&, const IORingSubmission&, FileDescription&, BlockFlags);
+
+        virtual const char* state_string() const override { return "IORing"; }
+        virtual void not_blocking(bool) override { }
+        virtual bool unblock(bool, void*) override;
+
+        void arm();
+        void cancel();
+
+        const IORingSubmission& submission() const { return m_submission; }
+        FileDescription& description() { return m_description; }
+
+        IntrusiveListNode<PendingSubmission, RefPtr<PendingSubmission>> m_list_node;
+
+    private:
+        WeakPtr<IORing> m_ring;
+        IORingSubmission m_submission;
+        NonnullRefPtr<FileDescription> m_description;
+        BlockFlags m_flags { BlockFlags::None };
+        bool m_did_fire { false };
+    };
+
+    using PendingList = IntrusiveList<PendingSubmission, RefPtr<PendingSubmission>, &PendingSubmission::m_list_node>;
+
+    IORing(Process&, u32 submission_entries, u32 completion_entries, NonnullRefPtr<AnonymousVMObject>, NonnullOwnPtr<Region>);
+
+    void submit_one(Process&, const IORingSubmission&);
+    void park(const IORingSubmission&, FileDescription&);
+    void run_pending_submission(PendingSubmission&);
+    KResultOr<int> execute(Process&, const IORingSubmission&, FileDescription&);
+    KResultOr<int> execute_accept(Process&, const IORingSubmission&, FileDescription&);
+
+    void post_completion(u64 user_data, i32 result);
+
+    IORingSubmission* submission_at(u32 index) const { return &m_submissions[index & (m_submission_entries - 1)]; }
+    IORingCompletion* completion_at(u32 index) const { return &m_completions[index & (m_completion_entries - 1)]; }
+
+    WeakPtr<Process> m_process;
+    NonnullRefPtr<AnonymousVMObject> m_vmobject;
+    NonnullOwnPtr<Region> m_region;
+    IORingHeader* m_header { nullptr };
+    IORingSubmission* m_submissions { nullptr };
+    IORingCompletion* m_completions { nullptr };
+    u32 m_submission_entries { 0 };
+    u32 m_completion_entries { 0 };
+
+    // Protects everything below.
+    Lock m_lock { "IORing" };
+    u32 m_submission_head { 0 };
+    u32 m_completion_tail { 0 };
+    // Submissions that have been taken off the ring but haven't completed
+    // yet. We never accept more work than the completion ring has room for,
+    // so a completion can always be posted right away.
+    u32 m_in_flight { 0 };
+    PendingList m_pending;
+
+    WaitQueue m_completion_wait_queue;
+};
+
+}
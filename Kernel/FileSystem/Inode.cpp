@@ -11,6 +11,7 @@
 #include <AK/StringView.h>
 #include <Kernel/API/InodeWatcherEvent.h>
 #include <Kernel/FileSystem/Custody.h>
+#include <Kernel/FileSystem/DentryCache.h>
 #include <Kernel/FileSystem/Inode.h>
 #include <Kernel/FileSystem/InodeWatcher.h>
 #include <Kernel/FileSystem/VirtualFileSystem.h>
@@ -215,6 +216,7 @@ void Inode::set_metadata_dirty(bool metadata_dirty)
 void Inode::did_add_child(InodeIdentifier const&, String const& name)
 {
     Locker locker(m_lock);
+    DentryCache::the().invalidate(identifier(), name);
 
     for (auto& watcher : m_watchers) {
         watcher->notify_inode_event({}, identifier(), InodeWatcherEvent::Type::ChildCreated, name);
@@ -230,6 +232,8 @@ void Inode::did_remove_child(InodeIdentifier const&, String const& name)
         return;
     }
 
+    DentryCache::the().invalidate(identifier(), name);
+
     for (auto& watcher : m_watchers) {
         watcher->notify_inode_event({}, identifier(), InodeWatcherEvent::Type::ChildDeleted, name);
     }
@@ -246,6 +250,10 @@ void Inode::did_modify_contents()
 void Inode::did_delete_self()
 {
     Locker locker(m_lock);
+    // Forget the names that were looked up in a removed directory, since its
+    // inode number can be reused for a new one.
+    if (is_directory())
+        DentryCache::the().invalidate_children_of(identifier());
     for (auto& watcher : m_watchers) {
         watcher->notify_inode_event({}, identifier(), InodeWatcherEvent::Type::Deleted);
     }
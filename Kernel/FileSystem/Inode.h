@@ -27,6 +27,7 @@ class Inode : public RefCounted<Inode>
     , public Weakable<Inode> {
     friend class VFS;
     friend class FS;
+    friend class SharedInodeVMObject;
 
 public:
     virtual ~Inode();
@@ -53,6 +54,8 @@ public:
     virtual void detach(FileDescription&) { }
     virtual void did_seek(FileDescription&, off_t) { }
     virtual KResultOr<size_t> read_bytes(off_t, size_t, UserOrKernelBuffer& buffer, FileDescription*) const = 0;
+    // Reads from the backing store, bypassing the page cache. This is what the page cache uses to fill itself.
+    virtual KResultOr<size_t> read_bytes_uncached(off_t offset, size_t count, UserOrKernelBuffer& buffer) const { return read_bytes(offset, count, buffer, nullptr); }
     virtual KResult traverse_as_directory(Function<bool(const FS::DirectoryEntryView&)>) const = 0;
     virtual RefPtr<Inode> lookup(StringView name) = 0;
     virtual KResultOr<size_t> write_bytes(off_t, size_t, const UserOrKernelBuffer& data, FileDescription*) = 0;
@@ -63,6 +66,7 @@ public:
     virtual KResult chmod(mode_t) = 0;
     virtual KResult chown(uid_t, gid_t) = 0;
     virtual KResult truncate(u64) { return KSuccess; }
+    virtual KResult preallocate(u64, u64) { return EOPNOTSUPP; }
     virtual KResultOr<NonnullRefPtr<Custody>> resolve_as_link(Custody& base, RefPtr<Custody>* out_parent, int options, int symlink_recursion_level) const;
 
     virtual KResultOr<int> get_block_address(int) { return ENOTSUP; }
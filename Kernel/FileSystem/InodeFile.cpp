@@ -121,6 +121,11 @@ KResult InodeFile::truncate(u64 size)
     return KSuccess;
 }
 
+KResult InodeFile::preallocate(u64 offset, u64 length)
+{
+    return m_inode->preallocate(offset, length);
+}
+
 KResult InodeFile::chown(FileDescription& description, uid_t uid, gid_t gid)
 {
     VERIFY(description.inode() == m_inode);
@@ -0,0 +1,283 @@
+/*
+ * Copyright (c) 2021, the SerenityOS developers.
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#include <AK/HashMap.h>
+#include <AK/Singleton.h>
+#include <Kernel/FileSystem/PipeBuffer.h>
+#include <Kernel/SpinLock.h>
+#include <Kernel/VM/MemoryManager.h>
+
+namespace Kernel {
+
+struct PipeCapacityCharges {
+    SpinLock<u8> lock;
+    // How much capacity beyond the default each user's pipes have in total.
+    HashMap<uid_t, size_t> extra_capacity;
+};
+
+static AK::Singleton<PipeCapacityCharges> s_capacity_charges;
+
+// Moves a pipe's charge from one user and amount to another. Fails without
+// changing anything if the new charge doesn't fit into the user's limit.
+static bool recharge_extra_capacity(uid_t old_uid, size_t old_charge, uid_t new_uid, size_t new_charge)
+{
+    auto& charges = *s_capacity_charges;
+    ScopedSpinLock lock(charges.lock);
+    if (new_charge > 0) {
+        size_t charged = charges.extra_capacity.get(new_uid).value_or(0);
+        if (old_uid == new_uid)
+            charged -= old_charge;
+        if (charged + new_charge > PipeBuffer::max_unprivileged_extra_capacity_per_user)
+            return false;
+    }
+    if (old_charge > 0) {
+        auto it = charges.extra_capacity.find(old_uid);
+        VERIFY(it != charges.extra_capacity.end() && it->value >= old_charge);
+        it->value -= old_charge;
+        if (it->value == 0)
+            charges.extra_capacity.remove(it);
+    }
+    if (new_charge > 0)
+        charges.extra_capacity.ensure(new_uid) += new_charge;
+    return true;
+}
+
+PipeBuffer::PipeBuffer()
+{
+    m_slots.resize(default_capacity / PAGE_SIZE);
+    compute_lockfree_metadata();
+}
+
+PipeBuffer::~PipeBuffer()
+{
+    if (m_charged_capacity > 0)
+        recharge_extra_capacity(m_charged_uid, m_charged_capacity, 0, 0);
+}
+
+void PipeBuffer::compute_lockfree_metadata()
+{
+    size_t space_for_writing = (m_slots.size() - m_used_slots) * PAGE_SIZE;
+    if (auto* slot = last_used_slot(); slot && slot->page == SlotPage::Owned)
+        space_for_writing += PAGE_SIZE - slot->offset - slot->size;
+    InterruptDisabler disabler;
+    m_space_for_writing = space_for_writing;
+}
+
+KResult PipeBuffer::ensure_region()
+{
+    VERIFY(m_lock.is_locked());
+    if (m_region)
+        return KSuccess;
+    // Every slot starts out mapping the shared zero page.
+    auto vmobject = AnonymousVMObject::create_with_size(capacity(), AllocationStrategy::None);
+    if (!vmobject)
+        return ENOMEM;
+    auto region = MM.allocate_kernel_region_with_vmobject(*vmobject, capacity(), "Pipe", Region::Access::Read | Region::Access::Write);
+    if (!region)
+        return ENOMEM;
+    m_vmobject = move(vmobject);
+    m_region = move(region);
+    return KSuccess;
+}
+
+bool PipeBuffer::set_slot_page(size_t slot_index, PhysicalPage& page, SlotPage kind)
+{
+    m_vmobject->physical_pages()[slot_index] = page;
+    m_slots[slot_index].page = kind;
+    return m_region->remap_vmobject_page_range(slot_index, 1);
+}
+
+template<typename CopyIn>
+KResultOr<size_t> PipeBuffer::write_impl(size_t size, CopyIn copy_in)
+{
+    if (!size)
+        return 0;
+    Locker locker(m_lock);
+    if (auto result = ensure_region(); result.is_error())
+        return result;
+
+    size_t nwritten = 0;
+    KResult error = KSuccess;
+    while (nwritten < size) {
+        // Append to the last slot if it has room, otherwise start a new one.
+        auto* slot = last_used_slot();
+        size_t index;
+        bool is_new_slot = false;
+        if (slot && slot->page == SlotPage::Owned && slot->offset + slot->size < PAGE_SIZE) {
+            index = slot_index(m_used_slots - 1);
+        } else if (has_free_slot()) {
+            index = slot_index(m_used_slots);
+            slot = &m_slots[index];
+            if (slot->page != SlotPage::Owned) {
+                auto page = MM.allocate_user_physical_page(MemoryManager::ShouldZeroFill::No);
+                if (!page || !set_slot_page(index, *page, SlotPage::Owned)) {
+                    error = ENOMEM;
+                    break;
+                }
+            }
+            slot->offset = 0;
+            slot->size = 0;
+            ++m_used_slots;
+            is_new_slot = true;
+        } else {
+            break;
+        }
+
+        size_t chunk_size = min(size - nwritten, PAGE_SIZE - slot->offset - slot->size);
+        auto ncopied_or_error = copy_in(slot_data(index) + slot->offset + slot->size, nwritten, chunk_size);
+        if (ncopied_or_error.is_error() || ncopied_or_error.value() == 0) {
+            if (is_new_slot)
+                --m_used_slots;
+            if (ncopied_or_error.is_error())
+                error = ncopied_or_error.error();
+            break;
+        }
+        size_t ncopied = ncopied_or_error.value();
+        VERIFY(ncopied <= chunk_size);
+        slot->size += ncopied;
+        m_size += ncopied;
+        nwritten += ncopied;
+        if (ncopied < chunk_size)
+            break;
+    }
+
+    compute_lockfree_metadata();
+    if (nwritten == 0 && error.is_error())
+        return error;
+    if (m_unblock_callback && nwritten > 0)
+        m_unblock_callback();
+    return nwritten;
+}
+
+KResultOr<size_t> PipeBuffer::write(const UserOrKernelBuffer& data, size_t size)
+{
+    return write_impl(size, [&](u8* destination, size_t offset, size_t count) -> KResultOr<size_t> {
+        if (!data.read(destination, offset, count))
+            return EFAULT;
+        return count;
+    });
+}
+
+KResultOr<size_t> PipeBuffer::write_from(UserOrKernelBufferFiller& filler, size_t size)
+{
+    return write_impl(size, [&](u8* destination, size_t, size_t count) {
+        auto buffer = UserOrKernelBuffer::for_kernel_buffer(destination);
+        return filler(buffer, count);
+    });
+}
+
+KResultOr<size_t> PipeBuffer::read(UserOrKernelBuffer& data, size_t size)
+{
+    if (!size)
+        return 0;
+    Locker locker(m_lock);
+    size_t nread = 0;
+    while (nread < size && m_used_slots) {
+        auto index = slot_index(0);
+        auto& slot = m_slots[index];
+        size_t chunk_size = min(size - nread, slot.size);
+        if (!data.write(slot_data(index) + slot.offset, nread, chunk_size)) {
+            if (nread > 0)
+                break;
+            return EFAULT;
+        }
+        slot.offset += chunk_size;
+        slot.size -= chunk_size;
+        m_size -= chunk_size;
+        nread += chunk_size;
+        if (slot.size > 0)
+            continue;
+
+        // Pages we own are kept for the next write, gifted ones are let go
+        // right away so their owner doesn't have to copy them on its next write.
+        if (slot.page == SlotPage::Gifted)
+            set_slot_page(index, MM.shared_zero_page(), SlotPage::None);
+        m_first_slot = slot_index(1);
+        --m_used_slots;
+    }
+
+    compute_lockfree_metadata();
+    if (m_unblock_callback && nread > 0)
+        m_unblock_callback();
+    return nread;
+}
+
+KResult PipeBuffer::gift_page(PhysicalPage& page)
+{
+    Locker locker(m_lock);
+    if (auto result = ensure_region(); result.is_error())
+        return result;
+    if (!has_free_slot())
+        return ENOSPC;
+
+    auto index = slot_index(m_used_slots);
+    if (!set_slot_page(index, page, SlotPage::Gifted))
+        return ENOMEM;
+    auto& slot = m_slots[index];
+    slot.offset = 0;
+    slot.size = PAGE_SIZE;
+    ++m_used_slots;
+    m_size += PAGE_SIZE;
+
+    compute_lockfree_metadata();
+    if (m_unblock_callback)
+        m_unblock_callback();
+    return KSuccess;
+}
+
+KResult PipeBuffer::set_capacity(size_t capacity, uid_t uid, bool is_superuser)
+{
+    size_t slot_count = 1;
+    while (slot_count * PAGE_SIZE < capacity)
+        slot_count *= 2;
+
+    Locker locker(m_lock);
+    if (slot_count == m_slots.size())
+        return KSuccess;
+    if (m_used_slots > slot_count)
+        return EBUSY;
+
+    Vector<Slot> slots;
+    if (!slots.try_resize(slot_count))
+        return ENOMEM;
+
+    // Move the buffered pages to the front of a new ring. The pages that
+    // are cached in unused slots are dropped.
+    RefPtr<AnonymousVMObject> vmobject;
+    OwnPtr<Region> region;
+    if (m_region) {
+        vmobject = AnonymousVMObject::create_with_size(slot_count * PAGE_SIZE, AllocationStrategy::None);
+        if (!vmobject)
+            return ENOMEM;
+        for (size_t i = 0; i < m_used_slots; ++i) {
+            auto index = slot_index(i);
+            slots[i] = m_slots[index];
+            vmobject->physical_pages()[i] = m_vmobject->physical_pages()[index];
+        }
+        region = MM.allocate_kernel_region_with_vmobject(*vmobject, slot_count * PAGE_SIZE, "Pipe", Region::Access::Read | Region::Access::Write);
+        if (!region)
+            return ENOMEM;
+    }
+
+    size_t new_capacity = slot_count * PAGE_SIZE;
+    size_t charge = !is_superuser && new_capacity > default_capacity ? new_capacity - default_capacity : 0;
+    if (!recharge_extra_capacity(m_charged_uid, m_charged_capacity, uid, charge))
+        return EPERM;
+    m_charged_uid = uid;
+    m_charged_capacity = charge;
+
+    m_slots = move(slots);
+    m_vmobject = move(vmobject);
+    m_region = move(region);
+    m_first_slot = 0;
+
+    compute_lockfree_metadata();
+    if (m_unblock_callback)
+        m_unblock_callback();
+    return KSuccess;
+}
+
+}
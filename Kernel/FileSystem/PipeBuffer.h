@@ -0,0 +1,111 @@
+/*
+ * Copyright (c) 2021, the SerenityOS developers.
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#pragma once
+
+#include <AK/Function.h>
+#include <AK/OwnPtr.h>
+#include <AK/RefPtr.h>
+#include <AK/Types.h>
+#include <AK/Vector.h>
+#include <Kernel/KResult.h>
+#include <Kernel/Lock.h>
+#include <Kernel/UnixTypes.h>
+#include <Kernel/UserOrKernelBuffer.h>
+#include <Kernel/VM/AnonymousVMObject.h>
+#include <Kernel/VM/Region.h>
+
+namespace Kernel {
+
+// The buffer behind a pipe. It is a ring of page-sized slots, each holding a
+// physical page that is mapped into a kernel region at the slot's index.
+// Pages are only allocated once something is written into their slot, so a
+// pipe with a large capacity costs little until it actually fills up.
+//
+// Instead of being copied into, a free slot can also be given a page that
+// someone else owns (see gift_page()). Such pages are never written to and
+// the slot lets go of them as soon as they have been read.
+class PipeBuffer {
+    AK_MAKE_NONCOPYABLE(PipeBuffer);
+    AK_MAKE_NONMOVABLE(PipeBuffer);
+
+public:
+    static constexpr size_t default_capacity = 64 * KiB;
+    static constexpr size_t max_unprivileged_capacity = 1 * MiB;
+    static constexpr size_t max_capacity = 16 * MiB;
+    // Every pipe reserves a kernel region as large as its capacity, so
+    // unprivileged users may only grow their pipes beyond the default
+    // capacity by this much in total.
+    static constexpr size_t max_unprivileged_extra_capacity_per_user = 16 * MiB;
+
+    PipeBuffer();
+    ~PipeBuffer();
+
+    [[nodiscard]] KResultOr<size_t> write(const UserOrKernelBuffer&, size_t);
+    // Lets the filler write straight into the free space of the buffer.
+    [[nodiscard]] KResultOr<size_t> write_from(UserOrKernelBufferFiller&, size_t);
+    [[nodiscard]] KResultOr<size_t> read(UserOrKernelBuffer&, size_t);
+
+    // Puts a full page of data into the next free slot without copying it.
+    // The caller must make sure nobody writes to the page while it's in here.
+    // Fails with ENOSPC if there is no free slot right now.
+    [[nodiscard]] KResult gift_page(PhysicalPage&);
+    bool has_free_slot() const { return m_used_slots < m_slots.size(); }
+
+    bool is_empty() const { return m_size == 0; }
+    size_t space_for_writing() const { return m_space_for_writing; }
+
+    size_t capacity() const { return m_slots.size() * PAGE_SIZE; }
+    // Rounds the capacity up to a power of two pages. Fails with EBUSY if
+    // more than that is buffered right now. Anything beyond the default
+    // capacity is charged to the given user unless they're privileged, and
+    // fails with EPERM if that puts them over their limit.
+    [[nodiscard]] KResult set_capacity(size_t, uid_t, bool is_superuser);
+
+    void set_unblock_callback(Function<void()> callback)
+    {
+        VERIFY(!m_unblock_callback);
+        m_unblock_callback = move(callback);
+    }
+
+private:
+    enum class SlotPage : u8 {
+        // The slot maps the shared zero page.
+        None,
+        Owned,
+        Gifted,
+    };
+
+    struct Slot {
+        size_t offset { 0 };
+        size_t size { 0 };
+        SlotPage page { SlotPage::None };
+    };
+
+    template<typename CopyIn>
+    KResultOr<size_t> write_impl(size_t, CopyIn);
+
+    KResult ensure_region();
+    bool set_slot_page(size_t slot_index, PhysicalPage&, SlotPage);
+    u8* slot_data(size_t slot_index) { return m_region->vaddr().offset(slot_index * PAGE_SIZE).as_ptr(); }
+    size_t slot_index(size_t nth_used_slot) const { return (m_first_slot + nth_used_slot) % m_slots.size(); }
+    Slot* last_used_slot() { return m_used_slots ? &m_slots[slot_index(m_used_slots - 1)] : nullptr; }
+    void compute_lockfree_metadata();
+
+    Vector<Slot> m_slots;
+    RefPtr<AnonymousVMObject> m_vmobject;
+    OwnPtr<Region> m_region;
+    Function<void()> m_unblock_callback;
+    size_t m_first_slot { 0 };
+    size_t m_used_slots { 0 };
+    size_t m_size { 0 };
+    size_t m_space_for_writing { 0 };
+    uid_t m_charged_uid { 0 };
+    size_t m_charged_capacity { 0 };
+    mutable Lock m_lock { "PipeBuffer" };
+};
+
+}
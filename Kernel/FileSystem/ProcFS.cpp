@@ -10,6 +10,7 @@
 #include <AK/JsonValue.h>
 #include <AK/ScopeGuard.h>
 #include <AK/UBSanitizer.h>
+#include <Kernel/API/ProcessSnapshot.h>
 #include <Kernel/Arch/x86/CPU.h>
 #include <Kernel/Arch/x86/ProcessorInfo.h>
 #include <Kernel/CommandLine.h>
@@ -20,11 +21,14 @@
 #include <Kernel/Devices/HID/HIDManagement.h>
 #include <Kernel/Devices/USB/UHCIController.h>
 #include <Kernel/Devices/USB/USBDevice.h>
+#include <Kernel/FileSystem/BlockBasedFileSystem.h>
 #include <Kernel/FileSystem/Custody.h>
+#include <Kernel/FileSystem/DentryCache.h>
 #include <Kernel/FileSystem/FileBackedFileSystem.h>
 #include <Kernel/FileSystem/FileDescription.h>
 #include <Kernel/FileSystem/ProcFS.h>
 #include <Kernel/FileSystem/VirtualFileSystem.h>
+#include <Kernel/Heap/SlabAllocator.h>
 #include <Kernel/Heap/kmalloc.h>
 #include <Kernel/Interrupts/GenericInterruptHandler.h>
 #include <Kernel/Interrupts/InterruptManagement.h>
@@ -42,8 +46,10 @@
 #include <Kernel/Scheduler.h>
 #include <Kernel/StdLib.h>
 #include <Kernel/TTY/TTY.h>
+#include <Kernel/Tracepoint.h>
 #include <Kernel/VM/AnonymousVMObject.h>
 #include <Kernel/VM/MemoryManager.h>
+#include <Kernel/VM/PageCache.h>
 #include <LibC/errno_numbers.h>
 
 namespace Kernel {
@@ -68,9 +74,13 @@ enum ProcFileType {
 
     __FI_Root_Start,
     FI_Root_df,
+    FI_Root_diskcache,
     FI_Root_all,
+    FI_Root_snapshot,
     FI_Root_memstat,
+    FI_Root_kmalloc,
     FI_Root_cpuinfo,
+    FI_Root_lock_stats,
     FI_Root_dmesg,
     FI_Root_interrupts,
     FI_Root_dmi,
@@ -106,6 +116,7 @@ enum ProcFileType {
     FI_PID_vm,
     FI_PID_stacks, // directory
     FI_PID_fds,
+    FI_PID_snapshot,
     FI_PID_unveil,
     FI_PID_exe,  // symlink
     FI_PID_cwd,  // symlink
@@ -488,7 +499,7 @@ static bool procfs$profile(InodeIdentifier, KBufferBuilder& builder)
     if (!g_global_perf_events)
         return false;
 
-    return g_global_perf_events->to_json(builder);
+    return g_global_perf_events->serialize(builder);
 }
 
 static bool procfs$pid_perf_events(InodeIdentifier identifier, KBufferBuilder& builder)
@@ -499,7 +510,7 @@ static bool procfs$pid_perf_events(InodeIdentifier identifier, KBufferBuilder& b
     InterruptDisabler disabler;
     if (!process->perf_events())
         return false;
-    return process->perf_events()->to_json(builder);
+    return process->perf_events()->serialize(builder);
 }
 
 static bool procfs$net_adapters(InodeIdentifier, KBufferBuilder& builder)
@@ -556,6 +567,9 @@ static bool procfs$net_tcp(InodeIdentifier, KBufferBuilder& builder)
         obj.add("bytes_in", socket.bytes_in());
         obj.add("packets_out", socket.packets_out());
         obj.add("bytes_out", socket.bytes_out());
+        obj.add("congestion_control", socket.congestion_control_name());
+        obj.add("congestion_window", socket.congestion_window());
+        obj.add("smoothed_rtt_us", socket.smoothed_rtt().to_microseconds());
     });
     array.finish();
     return true;
@@ -739,6 +753,29 @@ static bool procfs$df(InodeIdentifier, KBufferBuilder& builder)
     return true;
 }
 
+static bool procfs$diskcache(InodeIdentifier, KBufferBuilder& builder)
+{
+    JsonArraySerializer array { builder };
+    for (auto& fs : BlockBasedFS::all_instances()) {
+        auto statistics = fs.cache_statistics();
+        auto fs_object = array.add_object();
+        fs_object.add("fsid", fs.fsid());
+        fs_object.add("class_name", fs.class_name());
+        fs_object.add("block_size", static_cast<u64>(fs.block_size()));
+        fs_object.add("entry_count", statistics.entry_count);
+        fs_object.add("dirty_count", statistics.dirty_count);
+        fs_object.add("hits", statistics.hits);
+        fs_object.add("misses", statistics.misses);
+        fs_object.add("written_blocks", statistics.written_blocks);
+        fs_object.add("write_requests", statistics.write_requests);
+        fs_object.add("throttled_writes", statistics.throttled_writes);
+        fs_object.add("grow_count", statistics.grow_count);
+        fs_object.add("shrink_count", statistics.shrink_count);
+    }
+    array.finish();
+    return true;
+}
+
 static bool procfs$cpuinfo(InodeIdentifier, KBufferBuilder& builder)
 {
     JsonArraySerializer array { builder };
@@ -757,11 +794,32 @@ static bool procfs$cpuinfo(InodeIdentifier, KBufferBuilder& builder)
             obj.add("stepping", info.stepping());
             obj.add("type", info.type());
             obj.add("brandstr", info.brandstr());
+            obj.add("ipis_sent", proc.ipis_sent());
+            obj.add("ipis_received", proc.ipis_received());
+            obj.add("tlb_shootdowns_sent", proc.tlb_shootdowns_sent());
+            obj.add("tlb_shootdowns_received", proc.tlb_shootdowns_received());
         });
     array.finish();
     return true;
 }
 
+static bool procfs$lock_stats(InodeIdentifier, KBufferBuilder& builder)
+{
+    JsonArraySerializer array { builder };
+    Lock::for_each_statistics([&](auto& statistics) {
+        auto obj = array.add_object();
+        obj.add("name", statistics.name);
+        obj.add("acquisitions", statistics.acquisitions);
+        obj.add("contended_acquisitions", statistics.contended_acquisitions);
+        obj.add("spun_acquisitions", statistics.spun_acquisitions);
+        obj.add("total_wait_ns", statistics.total_wait_ns);
+        obj.add("max_wait_ns", statistics.max_wait_ns);
+        obj.add("max_hold_ns", statistics.max_hold_ns);
+    });
+    array.finish();
+    return true;
+}
+
 static bool procfs$memstat(InodeIdentifier, KBufferBuilder& builder)
 {
     InterruptDisabler disabler;
@@ -789,36 +847,85 @@ static bool procfs$memstat(InodeIdentifier, KBufferBuilder& builder)
     json.add("user_physical_uncommitted", user_physical_pages_uncommitted);
     json.add("super_physical_allocated", super_physical_used);
     json.add("super_physical_available", super_physical_total - super_physical_used);
+    json.add("zeroed_page_pool_pages", MM.zeroed_page_pool_pages());
+    json.add("zeroed_page_pool_hits", MM.zeroed_page_pool_hits());
+    json.add("zeroed_page_pool_misses", MM.zeroed_page_pool_misses());
+    json.add("large_page_mappings", MM.large_page_mappings());
+    json.add("page_cache_pages", PageCache::the().resident_pages());
+    json.add("page_cache_readahead_pages", PageCache::the().readahead_pages());
+    json.add("dentry_cache_hits", DentryCache::the().hits());
+    json.add("dentry_cache_misses", DentryCache::the().misses());
     json.add("kmalloc_call_count", stats.kmalloc_call_count);
     json.add("kfree_call_count", stats.kfree_call_count);
-    slab_alloc_stats([&json](size_t slab_size, size_t num_allocated, size_t num_free) {
-        auto prefix = String::formatted("slab_{}", slab_size);
-        json.add(String::formatted("{}_num_allocated", prefix), num_allocated);
-        json.add(String::formatted("{}_num_free", prefix), num_free);
+    slab_alloc_stats([&json](auto& slab_stats) {
+        auto prefix = String::formatted("slab_{}", slab_stats.slab_size);
+        json.add(String::formatted("{}_num_allocated", prefix), slab_stats.allocated);
+        json.add(String::formatted("{}_num_free", prefix), slab_stats.free);
     });
     json.finish();
     return true;
 }
 
-static bool procfs$all(InodeIdentifier, KBufferBuilder& builder)
+static bool procfs$kmalloc(InodeIdentifier, KBufferBuilder& builder)
 {
-    JsonArraySerializer array { builder };
+    kmalloc_stats stats;
+    get_kmalloc_stats(stats);
+    Vector<SlabAllocatorStats, 4> all_slab_stats;
+    slab_alloc_stats([&](auto& slab_stats) {
+        all_slab_stats.append(slab_stats);
+    });
 
-    // Keep this in sync with CProcessStatistics.
-    auto build_process = [&](const Process& process) {
-        auto process_object = array.add_object();
+    JsonObjectSerializer<KBufferBuilder> json { builder };
+    json.add("bytes_allocated", stats.bytes_allocated);
+    json.add("bytes_free", stats.bytes_free);
+    json.add("bytes_eternal", stats.bytes_eternal);
+    json.add("kmalloc_call_count", stats.kmalloc_call_count);
+    json.add("kfree_call_count", stats.kfree_call_count);
+    json.add("kmalloc_slab_call_count", stats.kmalloc_slab_call_count);
+    json.add("kfree_slab_call_count", stats.kfree_slab_call_count);
+    json.add("lock_contention_count", stats.lock_contention_count);
+    {
+        auto slabs_array = json.add_array("slabs");
+        for (auto& slab_stats : all_slab_stats) {
+            auto slab_object = slabs_array.add_object();
+            slab_object.add("slab_size", slab_stats.slab_size);
+            slab_object.add("allocated", slab_stats.allocated);
+            slab_object.add("free", slab_stats.free);
+            slab_object.add("cached", slab_stats.cached);
+            slab_object.add("magazine_hits", slab_stats.magazine_hits);
+            slab_object.add("magazine_misses", slab_stats.magazine_misses);
+            slab_object.add("magazine_drains", slab_stats.magazine_drains);
+            slab_object.add("depot_contentions", slab_stats.depot_contentions);
+        }
+    }
+    json.finish();
+    return true;
+}
 
-        if (process.is_user_process()) {
-            StringBuilder pledge_builder;
+static String pledge_string(const Process& process)
+{
+    StringBuilder pledge_builder;
 
 #define __ENUMERATE_PLEDGE_PROMISE(promise)      \
     if (process.has_promised(Pledge::promise)) { \
         pledge_builder.append(#promise " ");     \
     }
-            ENUMERATE_PLEDGE_PROMISES
+    ENUMERATE_PLEDGE_PROMISES
 #undef __ENUMERATE_PLEDGE_PROMISE
 
-            process_object.add("pledge", pledge_builder.to_string());
+    return pledge_builder.to_string();
+}
+
+static bool procfs$all(InodeIdentifier, KBufferBuilder& builder)
+{
+    JsonArraySerializer array { builder };
+
+    // Keep this in sync with CProcessStatistics.
+    auto build_process = [&](const Process& process) {
+        auto process_object = array.add_object();
+
+        if (process.is_user_process()) {
+            process_object.add("pledge", pledge_string(process));
 
             switch (process.veil_state()) {
             case VeilState::None:
@@ -892,6 +999,205 @@ static bool procfs$all(InodeIdentifier, KBufferBuilder& builder)
     return true;
 }
 
+// See Kernel/API/ProcessSnapshot.h for the format of these.
+template<typename T, typename... Strings>
+static void append_snapshot_record(KBufferBuilder& builder, ProcessSnapshotRecordType type, const T& fixed, const Strings&... strings)
+{
+    size_t unpadded_size = sizeof(ProcessSnapshotRecord) + sizeof(T) + (strings.length() + ... + 0);
+    size_t size = round_up_to_power_of_two(unpadded_size, process_snapshot_record_alignment);
+    VERIFY(size <= NumericLimits<u16>::max());
+
+    ProcessSnapshotRecord record {};
+    record.type = to_underlying(type);
+    record.size = size;
+    builder.append_bytes({ reinterpret_cast<const u8*>(&record), sizeof(record) });
+    builder.append_bytes({ reinterpret_cast<const u8*>(&fixed), sizeof(fixed) });
+    (builder.append_bytes(strings.bytes()), ...);
+
+    static constexpr u8 padding[process_snapshot_record_alignment] {};
+    builder.append_bytes({ padding, size - unpadded_size });
+}
+
+// Records have a 16-bit size, so their strings are cut short if they are unreasonably long.
+static constexpr size_t max_snapshot_string_length = 4096;
+
+static StringView snapshot_string(const StringView& string)
+{
+    return string.substring_view(0, min(string.length(), max_snapshot_string_length));
+}
+
+static void append_process_snapshot(KBufferBuilder& builder, const Process& process)
+{
+    auto name = snapshot_string(process.name());
+    auto executable_path = process.executable() ? process.executable()->absolute_path() : String::empty();
+    auto executable = snapshot_string(executable_path);
+    auto tty = snapshot_string(process.tty() ? process.tty()->tty_name().view() : "notty"sv);
+    auto pledge = process.is_user_process() ? pledge_string(process) : String::empty();
+
+    ProcessSnapshotProcess process_record {};
+    process_record.pid = process.pid().value();
+    process_record.pgid = process.tty() ? process.tty()->pgid().value() : 0;
+    process_record.pgp = process.pgid().value();
+    process_record.sid = process.sid().value();
+    process_record.uid = process.uid();
+    process_record.gid = process.gid();
+    process_record.ppid = process.ppid().value();
+    process_record.nfds = process.number_of_open_file_descriptors();
+    process_record.thread_count = process.thread_count();
+    process_record.kernel = process.is_kernel_process();
+    process_record.dumpable = process.is_dumpable();
+    switch (process.veil_state()) {
+    case VeilState::None:
+        process_record.veil_state = to_underlying(ProcessSnapshotVeilState::None);
+        break;
+    case VeilState::Dropped:
+        process_record.veil_state = to_underlying(ProcessSnapshotVeilState::Dropped);
+        break;
+    case VeilState::Locked:
+        process_record.veil_state = to_underlying(ProcessSnapshotVeilState::Locked);
+        break;
+    }
+    process_record.amount_virtual = process.space().amount_virtual();
+    process_record.amount_resident = process.space().amount_resident();
+    process_record.amount_shared = process.space().amount_shared();
+    process_record.amount_dirty_private = process.space().amount_dirty_private();
+    process_record.amount_clean_inode = process.space().amount_clean_inode();
+    process_record.amount_purgeable_volatile = process.space().amount_purgeable_volatile();
+    process_record.amount_purgeable_nonvolatile = process.space().amount_purgeable_nonvolatile();
+    process_record.name_length = name.length();
+    process_record.executable_length = executable.length();
+    process_record.tty_length = tty.length();
+    process_record.pledge_length = pledge.length();
+    append_snapshot_record(builder, ProcessSnapshotRecordType::Process, process_record, name, executable, tty, pledge.view());
+
+    process.for_each_thread([&](const Thread& thread) {
+        auto thread_name = thread.name();
+        auto name = snapshot_string(thread_name);
+        StringView state = thread.state_string();
+
+        ProcessSnapshotThread thread_record {};
+        thread_record.tid = thread.tid().value();
+        thread_record.cpu = thread.cpu();
+        thread_record.priority = thread.priority();
+        thread_record.times_scheduled = thread.times_scheduled();
+        thread_record.ticks_user = thread.ticks_in_user();
+        thread_record.ticks_kernel = thread.ticks_in_kernel();
+        thread_record.syscall_count = thread.syscall_count();
+        thread_record.inode_faults = thread.inode_faults();
+        thread_record.zero_faults = thread.zero_faults();
+        thread_record.cow_faults = thread.cow_faults();
+        thread_record.file_read_bytes = thread.file_read_bytes();
+        thread_record.file_write_bytes = thread.file_write_bytes();
+        thread_record.unix_socket_read_bytes = thread.unix_socket_read_bytes();
+        thread_record.unix_socket_write_bytes = thread.unix_socket_write_bytes();
+        thread_record.ipv4_socket_read_bytes = thread.ipv4_socket_read_bytes();
+        thread_record.ipv4_socket_write_bytes = thread.ipv4_socket_write_bytes();
+        thread_record.name_length = name.length();
+        thread_record.state_length = state.length();
+        append_snapshot_record(builder, ProcessSnapshotRecordType::Thread, thread_record, name, state);
+    });
+}
+
+static void append_snapshot_header(KBufferBuilder& builder, size_t process_count)
+{
+    ProcessSnapshotHeader header {};
+    header.magic = process_snapshot_magic;
+    header.version = process_snapshot_version;
+    header.header_size = sizeof(header);
+    header.process_count = process_count;
+    builder.append_bytes({ reinterpret_cast<const u8*>(&header), sizeof(header) });
+}
+
+static bool procfs$snapshot(InodeIdentifier, KBufferBuilder& builder)
+{
+    ScopedSpinLock lock(g_scheduler_lock);
+    auto processes = Process::all_processes();
+    append_snapshot_header(builder, processes.size() + 1);
+    append_process_snapshot(builder, *Scheduler::colonel());
+    for (auto& process : processes)
+        append_process_snapshot(builder, process);
+    return true;
+}
+
+static bool procfs$pid_snapshot(InodeIdentifier identifier, KBufferBuilder& builder)
+{
+    auto process = Process::from_pid(to_pid(identifier));
+    if (!process)
+        return false;
+
+    {
+        ScopedSpinLock lock(g_scheduler_lock);
+        append_snapshot_header(builder, 1);
+        append_process_snapshot(builder, *process);
+    }
+
+    {
+        ScopedSpinLock lock(process->space().get_lock());
+        for (auto& region : process->space().regions()) {
+            if (!region->is_user() && !Process::current()->is_superuser())
+                continue;
+            auto name = snapshot_string(region->name());
+            StringView vmobject = region->vmobject().class_name();
+
+            ProcessSnapshotRegion region_record {};
+            region_record.address = region->vaddr().get();
+            region_record.size = region->size();
+            region_record.amount_resident = region->amount_resident();
+            region_record.amount_dirty = region->amount_dirty();
+            region_record.cow_pages = region->cow_pages();
+            if (region->is_readable())
+                region_record.flags |= ProcessSnapshotRegionReadable;
+            if (region->is_writable())
+                region_record.flags |= ProcessSnapshotRegionWritable;
+            if (region->is_executable())
+                region_record.flags |= ProcessSnapshotRegionExecutable;
+            if (region->is_stack())
+                region_record.flags |= ProcessSnapshotRegionStack;
+            if (region->is_shared())
+                region_record.flags |= ProcessSnapshotRegionShared;
+            if (region->is_syscall_region())
+                region_record.flags |= ProcessSnapshotRegionSyscall;
+            if (region->vmobject().is_anonymous()) {
+                region_record.flags |= ProcessSnapshotRegionPurgeable;
+                if (static_cast<const AnonymousVMObject&>(region->vmobject()).is_any_volatile())
+                    region_record.flags |= ProcessSnapshotRegionVolatile;
+            }
+            if (region->is_cacheable())
+                region_record.flags |= ProcessSnapshotRegionCacheable;
+            region_record.name_length = name.length();
+            region_record.vmobject_length = vmobject.length();
+            append_snapshot_record(builder, ProcessSnapshotRecordType::Region, region_record, name, vmobject);
+        }
+    }
+
+    for (int i = 0; i < process->max_open_file_descriptors(); ++i) {
+        auto description = process->file_description(i);
+        if (!description)
+            continue;
+        auto absolute_path_string = description->absolute_path();
+        auto absolute_path = snapshot_string(absolute_path_string);
+        StringView class_name = description->file().class_name();
+
+        ProcessSnapshotFileDescription description_record {};
+        description_record.fd = i;
+        description_record.offset = description->offset();
+        if (description->file().is_seekable())
+            description_record.flags |= ProcessSnapshotFileDescriptionSeekable;
+        if (process->fd_flags(i) & FD_CLOEXEC)
+            description_record.flags |= ProcessSnapshotFileDescriptionCloseOnExec;
+        if (description->is_blocking())
+            description_record.flags |= ProcessSnapshotFileDescriptionBlocking;
+        if (description->can_read())
+            description_record.flags |= ProcessSnapshotFileDescriptionCanRead;
+        if (description->can_write())
+            description_record.flags |= ProcessSnapshotFileDescriptionCanWrite;
+        description_record.absolute_path_length = absolute_path.length();
+        description_record.class_name_length = class_name.length();
+        append_snapshot_record(builder, ProcessSnapshotRecordType::FileDescription, description_record, absolute_path, class_name);
+    }
+    return true;
+}
+
 struct SysVariable {
     String name;
     enum class Type : u8 {
@@ -1025,6 +1331,8 @@ bool ProcFS::initialize()
     static Lockable<bool>* kmalloc_stack_helper;
     static Lockable<bool>* ubsan_deadly_helper;
     static Lockable<bool>* caps_lock_to_ctrl_helper;
+    static Lockable<bool>* lock_statistics_helper;
+    static Lockable<bool>* tracepoint_helpers[to_underlying(Tracepoint::__Count)];
 
     if (kmalloc_stack_helper == nullptr) {
         kmalloc_stack_helper = new Lockable<bool>();
@@ -1041,6 +1349,17 @@ bool ProcFS::initialize()
         ProcFS::add_sys_bool("caps_lock_to_ctrl", *caps_lock_to_ctrl_helper, [] {
             Kernel::g_caps_lock_remapped_to_ctrl.exchange(caps_lock_to_ctrl_helper->resource());
         });
+        lock_statistics_helper = new Lockable<bool>();
+        ProcFS::add_sys_bool("lock_statistics", *lock_statistics_helper, [] {
+            g_lock_statistics_enabled.store(lock_statistics_helper->resource());
+        });
+        for (u16 i = 0; i < to_underlying(Tracepoint::__Count); i++) {
+            auto tracepoint = static_cast<Tracepoint>(i);
+            tracepoint_helpers[i] = new Lockable<bool>();
+            ProcFS::add_sys_bool(String::formatted("trace_{}", to_string(tracepoint)), *tracepoint_helpers[i], [tracepoint] {
+                set_tracepoint_enabled(tracepoint, tracepoint_helpers[to_underlying(tracepoint)]->resource());
+            });
+        }
     }
     return true;
 }
@@ -1781,9 +2100,13 @@ ProcFS::ProcFS()
     m_root_inode = adopt_ref(*new ProcFSInode(*this, 1));
     m_entries.resize(FI_MaxStaticFileIndex);
     m_entries[FI_Root_df] = { "df", FI_Root_df, false, procfs$df };
+    m_entries[FI_Root_diskcache] = { "diskcache", FI_Root_diskcache, false, procfs$diskcache };
     m_entries[FI_Root_all] = { "all", FI_Root_all, false, procfs$all };
+    m_entries[FI_Root_snapshot] = { "snapshot", FI_Root_snapshot, false, procfs$snapshot };
     m_entries[FI_Root_memstat] = { "memstat", FI_Root_memstat, false, procfs$memstat };
+    m_entries[FI_Root_kmalloc] = { "kmalloc", FI_Root_kmalloc, false, procfs$kmalloc };
     m_entries[FI_Root_cpuinfo] = { "cpuinfo", FI_Root_cpuinfo, false, procfs$cpuinfo };
+    m_entries[FI_Root_lock_stats] = { "lock_stats", FI_Root_lock_stats, true, procfs$lock_stats };
     m_entries[FI_Root_dmesg] = { "dmesg", FI_Root_dmesg, true, procfs$dmesg };
     m_entries[FI_Root_self] = { "self", FI_Root_self, false, procfs$self };
     m_entries[FI_Root_pci] = { "pci", FI_Root_pci, false, procfs$pci };
@@ -1809,6 +2132,7 @@ ProcFS::ProcFS()
     m_entries[FI_PID_vm] = { "vm", FI_PID_vm, false, procfs$pid_vm };
     m_entries[FI_PID_stacks] = { "stacks", FI_PID_stacks, false };
     m_entries[FI_PID_fds] = { "fds", FI_PID_fds, false, procfs$pid_fds };
+    m_entries[FI_PID_snapshot] = { "snapshot", FI_PID_snapshot, false, procfs$pid_snapshot };
     m_entries[FI_PID_exe] = { "exe", FI_PID_exe, false, procfs$pid_exe };
     m_entries[FI_PID_cwd] = { "cwd", FI_PID_cwd, false, procfs$pid_cwd };
     m_entries[FI_PID_unveil] = { "unveil", FI_PID_unveil, false, procfs$pid_unveil };
@@ -10,6 +10,7 @@
 #include <Kernel/Debug.h>
 #include <Kernel/Devices/BlockDevice.h>
 #include <Kernel/FileSystem/Custody.h>
+#include <Kernel/FileSystem/DentryCache.h>
 #include <Kernel/FileSystem/FileBackedFileSystem.h>
 #include <Kernel/FileSystem/FileDescription.h>
 #include <Kernel/FileSystem/FileSystem.h>
@@ -61,6 +62,7 @@ KResult VFS::mount(FS& file_system, Custody& mount_point, int flags)
     // FIXME: check that this is not already a mount point
     Mount mount { file_system, &mount_point, flags };
     m_mounts.append(move(mount));
+    DentryCache::the().invalidate_all();
     return KSuccess;
 }
 
@@ -72,6 +74,7 @@ KResult VFS::bind_mount(Custody& source, Custody& mount_point, int flags)
     // FIXME: check that this is not already a mount point
     Mount mount { source.inode(), mount_point, flags };
     m_mounts.append(move(mount));
+    DentryCache::the().invalidate_all();
     return KSuccess;
 }
 
@@ -97,6 +100,8 @@ KResult VFS::unmount(Inode& guest_inode)
     for (size_t i = 0; i < m_mounts.size(); ++i) {
         auto& mount = m_mounts.at(i);
         if (&mount.guest() == &guest_inode) {
+            // The cache keeps inodes of the file system alive, which would make it look busy.
+            DentryCache::the().invalidate_all();
             if (auto result = mount.guest_fs().prepare_to_unmount(); result.is_error()) {
                 dbgln("VFS: Failed to unmount!");
                 return result;
@@ -486,6 +491,19 @@ KResult VFS::chmod(StringView path, mode_t mode, Custody& base)
     return chmod(custody, mode);
 }
 
+// The dentry cache holds references to the child, which would keep the file
+// system from letting go of it once its last link is gone. So forget the
+// name before removing it. Forget it again if removing fails, as the
+// directory may have changed by then.
+static KResult remove_child_and_forget(Inode& parent_inode, StringView name)
+{
+    DentryCache::the().invalidate(parent_inode.identifier(), name);
+    auto result = parent_inode.remove_child(name);
+    if (result.is_error())
+        DentryCache::the().invalidate(parent_inode.identifier(), name);
+    return result;
+}
+
 KResult VFS::rename(StringView old_path, StringView new_path, Custody& base)
 {
     RefPtr<Custody> old_parent_custody;
@@ -546,14 +564,14 @@ KResult VFS::rename(StringView old_path, StringView new_path, Custody& base)
         }
         if (new_inode.is_directory() && !old_inode.is_directory())
             return EISDIR;
-        if (auto result = new_parent_inode.remove_child(new_basename); result.is_error())
+        if (auto result = remove_child_and_forget(new_parent_inode, new_basename); result.is_error())
             return result;
     }
 
     if (auto result = new_parent_inode.add_child(old_inode, new_basename, old_inode.mode()); result.is_error())
         return result;
 
-    if (auto result = old_parent_inode.remove_child(LexicalPath(old_path).basename()); result.is_error())
+    if (auto result = remove_child_and_forget(old_parent_inode, LexicalPath(old_path).basename()); result.is_error())
         return result;
 
     return KSuccess;
@@ -688,7 +706,7 @@ KResult VFS::unlink(StringView path, Custody& base)
     if (parent_custody->is_readonly())
         return EROFS;
 
-    if (auto result = parent_inode.remove_child(LexicalPath(path).basename()); result.is_error())
+    if (auto result = remove_child_and_forget(parent_inode, LexicalPath(path).basename()); result.is_error())
         return result;
 
     return KSuccess;
@@ -770,7 +788,7 @@ KResult VFS::rmdir(StringView path, Custody& base)
     if (auto result = inode.remove_child(".."); result.is_error())
         return result;
 
-    return parent_inode.remove_child(LexicalPath(path).basename());
+    return remove_child_and_forget(parent_inode, LexicalPath(path).basename());
 }
 
 VFS::Mount::Mount(FS& guest_fs, Custody* host_custody, int flags)
@@ -817,9 +835,10 @@ void VFS::for_each_mount(Function<void(const Mount&)> callback) const
     }
 }
 
-void VFS::sync()
+KResult VFS::sync()
 {
     FS::sync();
+    return FS::take_write_errors();
 }
 
 Custody& VFS::root_custody()
@@ -971,7 +990,7 @@ KResultOr<NonnullRefPtr<Custody>> VFS::resolve_path_without_veil(StringView path
         }
 
         // Okay, let's look up this part.
-        auto child_inode = parent.inode().lookup(part);
+        auto child_inode = DentryCache::the().lookup(parent.inode(), part);
         if (!child_inode) {
             if (out_parent) {
                 // ENOENT with a non-null parent custody signals to caller that
@@ -991,7 +1010,7 @@ KResultOr<NonnullRefPtr<Custody>> VFS::resolve_path_without_veil(StringView path
             mount_flags_for_child = mount->flags();
         }
 
-        auto new_custody_or_error = Custody::try_create(&parent, part, *child_inode, mount_flags_for_child);
+        auto new_custody_or_error = DentryCache::the().custody_for(parent, part, *child_inode, mount_flags_for_child);
         if (new_custody_or_error.is_error())
             return new_custody_or_error.error();
 
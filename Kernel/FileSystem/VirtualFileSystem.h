@@ -93,7 +93,7 @@ public:
 
     InodeIdentifier root_inode_id() const;
 
-    void sync();
+    KResult sync();
 
     Custody& root_custody();
     KResultOr<NonnullRefPtr<Custody>> resolve_path(StringView path, Custody& base, RefPtr<Custody>* out_parent = nullptr, int options = 0, int symlink_recursion_level = 0);
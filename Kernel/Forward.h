@@ -15,9 +15,11 @@ class Custody;
 class Device;
 class DiskCache;
 class DoubleBuffer;
+class EventQueue;
 class File;
 class FileDescription;
 class FutexQueue;
+class IORing;
 class IPv4Socket;
 class Inode;
 class InodeIdentifier;
@@ -49,6 +51,7 @@ class RecursiveSpinLock;
 template<typename LockType>
 class ScopedSpinLock;
 class TCPSocket;
+class TLBShootdownBatch;
 class TTY;
 class Thread;
 class UDPSocket;
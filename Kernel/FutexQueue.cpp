@@ -15,18 +15,49 @@ bool FutexQueue::should_add_blocker(Thread::Blocker& b, void* data)
     VERIFY(data != nullptr); // Thread that is requesting to be blocked
     VERIFY(m_lock.is_locked());
     VERIFY(b.blocker_type() == Thread::Blocker::Type::Futex);
+    auto& blocker = static_cast<Thread::FutexBlocker&>(b);
 
-    dbgln_if(FUTEXQUEUE_DEBUG, "FutexQueue @ {}: should block thread {}", this, *static_cast<Thread*>(data));
+    // The wait is no longer imminent, it's now accounted for as a blocker.
+    VERIFY(m_imminent_waits > 0);
+    m_imminent_waits--;
 
+    // Someone was woken after the futex value was checked, so it may have
+    // changed since. Let the caller check again rather than miss the wake.
+    if (blocker.wake_sequence() != m_wake_sequence) {
+        dbgln_if(FUTEXQUEUE_DEBUG, "FutexQueue @ {}: not blocking thread {}, woken in the meantime", this, *static_cast<Thread*>(data));
+        return false;
+    }
+
+    dbgln_if(FUTEXQUEUE_DEBUG, "FutexQueue @ {}: should block thread {}", this, *static_cast<Thread*>(data));
     return true;
 }
 
-u32 FutexQueue::wake_n_requeue(u32 wake_count, const Function<FutexQueue*()>& get_target_queue, u32 requeue_count, bool& is_empty, bool& is_empty_target)
+u32 FutexQueue::queue_imminent_wait()
+{
+    ScopedSpinLock lock(m_lock);
+    m_imminent_waits++;
+    return m_wake_sequence;
+}
+
+void FutexQueue::did_wake_locked()
+{
+    VERIFY(m_lock.is_locked());
+    if (m_imminent_waits > 0)
+        m_wake_sequence++;
+}
+
+bool FutexQueue::is_empty_and_no_imminent_waits()
+{
+    ScopedSpinLock lock(m_lock);
+    return m_imminent_waits == 0 && is_empty_locked();
+}
+
+u32 FutexQueue::wake_n_requeue(u32 wake_count, const Function<FutexQueue*()>& get_target_queue, u32 requeue_count)
 {
-    is_empty_target = false;
     ScopedSpinLock lock(m_lock);
 
     dbgln_if(FUTEXQUEUE_DEBUG, "FutexQueue @ {}: wake_n_requeue({}, {})", this, wake_count, requeue_count);
+    did_wake_locked();
 
     u32 did_wake = 0, did_requeue = 0;
     do_unblock([&](Thread::Blocker& b, void* data, bool& stop_iterating) {
@@ -35,7 +66,10 @@ u32 FutexQueue::wake_n_requeue(u32 wake_count, const Function<FutexQueue*()>& ge
         auto& blocker = static_cast<Thread::FutexBlocker&>(b);
 
         dbgln_if(FUTEXQUEUE_DEBUG, "FutexQueue @ {}: wake_n_requeue unblocking {}", this, *static_cast<Thread*>(data));
-        VERIFY(did_wake < wake_count);
+        if (did_wake >= wake_count) {
+            stop_iterating = true;
+            return false;
+        }
         if (blocker.unblock()) {
             if (++did_wake >= wake_count)
                 stop_iterating = true;
@@ -43,7 +77,6 @@ u32 FutexQueue::wake_n_requeue(u32 wake_count, const Function<FutexQueue*()>& ge
         }
         return false;
     });
-    is_empty = is_empty_locked();
     if (requeue_count > 0) {
         auto blockers_to_requeue = do_take_blockers(requeue_count);
         if (!blockers_to_requeue.is_empty()) {
@@ -69,7 +102,6 @@ u32 FutexQueue::wake_n_requeue(u32 wake_count, const Function<FutexQueue*()>& ge
                     blocker.finish_requeue(*target_futex_queue);
                 }
                 target_futex_queue->do_append_blockers(move(blockers_to_requeue));
-                is_empty_target = target_futex_queue->is_empty_locked();
             } else {
                 dbgln_if(FUTEXQUEUE_DEBUG, "FutexQueue @ {}: wake_n_requeue could not get target queue to requeue {} blockers", this, blockers_to_requeue.size());
                 do_append_blockers(move(blockers_to_requeue));
@@ -79,12 +111,13 @@ u32 FutexQueue::wake_n_requeue(u32 wake_count, const Function<FutexQueue*()>& ge
     return did_wake + did_requeue;
 }
 
-u32 FutexQueue::wake_n(u32 wake_count, const Optional<u32>& bitset, bool& is_empty)
+u32 FutexQueue::wake_n(u32 wake_count, const Optional<u32>& bitset)
 {
     if (wake_count == 0)
         return 0; // should we assert instead?
     ScopedSpinLock lock(m_lock);
     dbgln_if(FUTEXQUEUE_DEBUG, "FutexQueue @ {}: wake_n({})", this, wake_count);
+    did_wake_locked();
     u32 did_wake = 0;
     do_unblock([&](Thread::Blocker& b, void* data, bool& stop_iterating) {
         VERIFY(data);
@@ -100,14 +133,14 @@ u32 FutexQueue::wake_n(u32 wake_count, const Optional<u32>& bitset, bool& is_emp
         }
         return false;
     });
-    is_empty = is_empty_locked();
     return did_wake;
 }
 
-u32 FutexQueue::wake_all(bool& is_empty)
+u32 FutexQueue::wake_all()
 {
     ScopedSpinLock lock(m_lock);
     dbgln_if(FUTEXQUEUE_DEBUG, "FutexQueue @ {}: wake_all", this);
+    did_wake_locked();
     u32 did_wake = 0;
     do_unblock([&](Thread::Blocker& b, void* data, bool&) {
         VERIFY(data);
@@ -120,7 +153,6 @@ u32 FutexQueue::wake_all(bool& is_empty)
         }
         return false;
     });
-    is_empty = is_empty_locked();
     return did_wake;
 }
 
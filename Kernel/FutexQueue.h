@@ -7,6 +7,8 @@
 #pragma once
 
 #include <AK/Atomic.h>
+#include <AK/HashFunctions.h>
+#include <AK/IntrusiveList.h>
 #include <AK/RefCounted.h>
 #include <Kernel/SpinLock.h>
 #include <Kernel/Thread.h>
@@ -14,16 +16,36 @@
 
 namespace Kernel {
 
+struct FutexKey {
+    // Private futexes are identified by the owning Process and the user space
+    // address, shared ones by the VMObject and the offset into it.
+    const void* object { nullptr };
+    FlatPtr address_or_offset { 0 };
+
+    bool operator==(const FutexKey& other) const { return object == other.object && address_or_offset == other.address_or_offset; }
+    unsigned hash() const { return pair_int_hash(ptr_hash(object), ptr_hash(address_or_offset)); }
+};
+
 class FutexQueue : public Thread::BlockCondition
     , public RefCounted<FutexQueue>
     , public VMObjectDeletedHandler {
 public:
-    FutexQueue(FlatPtr user_address_or_offset, VMObject* vmobject = nullptr);
+    FutexQueue(const FutexKey&, VMObject* vmobject = nullptr);
     virtual ~FutexQueue();
 
-    u32 wake_n_requeue(u32, const Function<FutexQueue*()>&, u32, bool&, bool&);
-    u32 wake_n(u32, const Optional<u32>&, bool&);
-    u32 wake_all(bool&);
+    const FutexKey& key() const { return m_key; }
+    bool is_in_bucket() const { return m_bucket_list_node.is_in_list(); }
+
+    u32 wake_n_requeue(u32, const Function<FutexQueue*()>&, u32);
+    u32 wake_n(u32, const Optional<u32>&);
+    u32 wake_all();
+
+    // Called with the bucket lock held by a thread that is about to block on
+    // this queue, so that the queue isn't thrown away before it gets there.
+    // Returns the wake sequence to pass to wait_on(). If anyone is woken in
+    // the meantime, the wait returns right away instead of missing the wake.
+    u32 queue_imminent_wait();
+    bool is_empty_and_no_imminent_waits();
 
     template<class... Args>
     Thread::BlockResult wait_on(const Thread::BlockTimeout& timeout, Args&&... args)
@@ -37,11 +59,17 @@ protected:
     virtual bool should_add_blocker(Thread::Blocker& b, void* data) override;
 
 private:
-    // For private futexes we just use the user space address.
-    // But for global futexes we use the offset into the VMObject
-    const FlatPtr m_user_address_or_offset;
+    void did_wake_locked();
+
+    const FutexKey m_key;
     WeakPtr<VMObject> m_vmobject;
     const bool m_is_global;
+    size_t m_imminent_waits { 0 };
+    u32 m_wake_sequence { 0 };
+    IntrusiveListNode<FutexQueue, RefPtr<FutexQueue>> m_bucket_list_node;
+
+public:
+    using List = IntrusiveList<FutexQueue, RefPtr<FutexQueue>, &FutexQueue::m_bucket_list_node>;
 };
 
 }
@@ -6,6 +6,7 @@
 
 #include <AK/Assertions.h>
 #include <AK/Memory.h>
+#include <Kernel/Arch/x86/CPU.h>
 #include <Kernel/Heap/SlabAllocator.h>
 #include <Kernel/Heap/kmalloc.h>
 #include <Kernel/SpinLock.h>
@@ -15,13 +16,39 @@
 
 namespace Kernel {
 
+static constexpr size_t slab_allocator_count = 4;
+
+// Each processor keeps a small stack of free slabs per slab size, so most
+// allocations and frees never touch memory shared with other processors.
+// Magazines are refilled from and drained to the allocator's depot in
+// batches of half their capacity.
+struct SlabMagazine {
+    static constexpr size_t capacity = 32;
+    static constexpr size_t batch_size = capacity / 2;
+
+    size_t count { 0 };
+    void* slabs[capacity];
+
+    size_t hits { 0 };
+    size_t misses { 0 };
+    size_t drains { 0 };
+};
+
+struct SlabAllocatorPerProcessorData {
+    SlabMagazine magazines[slab_allocator_count];
+    size_t kmalloc_call_count { 0 };
+    size_t kfree_call_count { 0 };
+};
+
 template<size_t templated_slab_size>
 class SlabAllocator {
 public:
     SlabAllocator() = default;
 
-    void init(size_t size)
+    void init(size_t size, size_t index)
     {
+        VERIFY(index < slab_allocator_count);
+        m_index = index;
         m_base = kmalloc_eternal(size);
         m_end = (u8*)m_base + size;
         FreeSlab* slabs = (FreeSlab*)m_base;
@@ -31,64 +58,96 @@ public:
         }
         slabs[0].next = nullptr;
         m_freelist = &slabs[m_slab_count - 1];
-        m_num_allocated = 0;
+        m_depot_free = m_slab_count;
     }
 
     constexpr size_t slab_size() const { return templated_slab_size; }
     size_t slab_count() const { return m_slab_count; }
 
-    void* alloc()
+    bool contains(const void* ptr) const { return ptr >= m_base && ptr < m_end; }
+
+    void* try_alloc()
     {
-        FreeSlab* free_slab;
+        void* slab = nullptr;
         {
-            // We want to avoid being swapped out in the middle of this
-            ScopedCritical critical;
-            FreeSlab* next_free;
-            free_slab = m_freelist.load(AK::memory_order_consume);
-            do {
-                if (!free_slab)
-                    return kmalloc(slab_size());
-                // It's possible another processor is doing the same thing at
-                // the same time, so next_free *can* be a bogus pointer. However,
-                // in that case compare_exchange_strong would fail and we would
-                // try again.
-                next_free = free_slab->next;
-            } while (!m_freelist.compare_exchange_strong(free_slab, next_free, AK::memory_order_acq_rel));
-
-            m_num_allocated++;
+            // Interrupt handlers allocate too, so keep them off this processor's magazine while we're using it.
+            InterruptDisabler disabler;
+            auto* magazine = current_magazine();
+            if (!magazine) {
+                take_from_depot(&slab, 1);
+            } else {
+                if (magazine->count == 0) {
+                    ++magazine->misses;
+                    magazine->count = take_from_depot(magazine->slabs, SlabMagazine::batch_size);
+                } else {
+                    ++magazine->hits;
+                }
+                if (magazine->count > 0)
+                    slab = magazine->slabs[--magazine->count];
+            }
         }
+        if (!slab)
+            return nullptr;
 
 #ifdef SANITIZE_SLABS
-        memset(free_slab, SLAB_ALLOC_SCRUB_BYTE, slab_size());
+        memset(slab, SLAB_ALLOC_SCRUB_BYTE, slab_size());
 #endif
-        return free_slab;
+        return slab;
+    }
+
+    void* alloc()
+    {
+        if (auto* slab = try_alloc())
+            return slab;
+        return kmalloc(slab_size());
     }
 
     void dealloc(void* ptr)
     {
         VERIFY(ptr);
-        if (ptr < m_base || ptr >= m_end) {
+        if (!contains(ptr)) {
             kfree(ptr);
             return;
         }
-        FreeSlab* free_slab = (FreeSlab*)ptr;
 #ifdef SANITIZE_SLABS
         if (slab_size() > sizeof(FreeSlab*))
-            memset(free_slab->padding, SLAB_DEALLOC_SCRUB_BYTE, sizeof(FreeSlab::padding));
+            memset(((FreeSlab*)ptr)->padding, SLAB_DEALLOC_SCRUB_BYTE, sizeof(FreeSlab::padding));
 #endif
 
-        // We want to avoid being swapped out in the middle of this
-        ScopedCritical critical;
-        FreeSlab* next_free = m_freelist.load(AK::memory_order_consume);
-        do {
-            free_slab->next = next_free;
-        } while (!m_freelist.compare_exchange_strong(next_free, free_slab, AK::memory_order_acq_rel));
-
-        m_num_allocated--;
+        InterruptDisabler disabler;
+        auto* magazine = current_magazine();
+        if (!magazine) {
+            return_to_depot(&ptr, 1);
+            return;
+        }
+        if (magazine->count == SlabMagazine::capacity) {
+            // Hand back the slabs that have been sitting in the magazine the longest,
+            // the most recently freed ones are the most likely to still be in the cache.
+            ++magazine->drains;
+            return_to_depot(magazine->slabs, SlabMagazine::batch_size);
+            magazine->count -= SlabMagazine::batch_size;
+            memmove(magazine->slabs, magazine->slabs + SlabMagazine::batch_size, magazine->count * sizeof(void*));
+        }
+        magazine->slabs[magazine->count++] = ptr;
     }
 
-    size_t num_allocated() const { return m_num_allocated; }
-    size_t num_free() const { return m_slab_count - m_num_allocated; }
+    void stats(SlabAllocatorStats& stats) const
+    {
+        stats.slab_size = slab_size();
+        Processor::for_each([&](Processor& processor) {
+            auto* data = processor.slab_data();
+            if (!data)
+                return;
+            auto& magazine = data->magazines[m_index];
+            stats.cached += magazine.count;
+            stats.magazine_hits += magazine.hits;
+            stats.magazine_misses += magazine.misses;
+            stats.magazine_drains += magazine.drains;
+        });
+        stats.free = min(m_depot_free + stats.cached, m_slab_count);
+        stats.allocated = m_slab_count - stats.free;
+        stats.depot_contentions = m_depot_contentions;
+    }
 
 private:
     struct FreeSlab {
@@ -96,9 +155,47 @@ private:
         char padding[templated_slab_size - sizeof(FreeSlab*)];
     };
 
-    Atomic<FreeSlab*> m_freelist { nullptr };
-    Atomic<size_t, AK::MemoryOrder::memory_order_relaxed> m_num_allocated;
-    size_t m_slab_count;
+    SlabMagazine* current_magazine()
+    {
+        auto* data = Processor::current().slab_data();
+        return data ? &data->magazines[m_index] : nullptr;
+    }
+
+    size_t take_from_depot(void** slabs, size_t count)
+    {
+        if (m_depot_lock.is_locked())
+            ++m_depot_contentions;
+        ScopedSpinLock lock(m_depot_lock);
+        size_t taken = 0;
+        while (taken < count && m_freelist) {
+            slabs[taken++] = m_freelist;
+            m_freelist = m_freelist->next;
+        }
+        m_depot_free -= taken;
+        return taken;
+    }
+
+    void return_to_depot(void* const* slabs, size_t count)
+    {
+        // Chain the slabs together first, so the depot is only locked for the splice.
+        for (size_t i = 0; i + 1 < count; ++i)
+            ((FreeSlab*)slabs[i])->next = (FreeSlab*)slabs[i + 1];
+        auto* last = (FreeSlab*)slabs[count - 1];
+
+        if (m_depot_lock.is_locked())
+            ++m_depot_contentions;
+        ScopedSpinLock lock(m_depot_lock);
+        last->next = m_freelist;
+        m_freelist = (FreeSlab*)slabs[0];
+        m_depot_free += count;
+    }
+
+    SpinLock<u8> m_depot_lock;
+    FreeSlab* m_freelist { nullptr };
+    size_t m_depot_free { 0 };
+    Atomic<size_t, AK::MemoryOrder::memory_order_relaxed> m_depot_contentions { 0 };
+    size_t m_slab_count { 0 };
+    size_t m_index { 0 };
     void* m_base { nullptr };
     void* m_end { nullptr };
 
@@ -125,10 +222,17 @@ void for_each_allocator(Callback callback)
 
 UNMAP_AFTER_INIT void slab_alloc_init()
 {
-    s_slab_allocator_16.init(128 * KiB);
-    s_slab_allocator_32.init(128 * KiB);
-    s_slab_allocator_64.init(512 * KiB);
-    s_slab_allocator_128.init(512 * KiB);
+    s_slab_allocator_16.init(128 * KiB, 0);
+    s_slab_allocator_32.init(128 * KiB, 1);
+    s_slab_allocator_64.init(512 * KiB, 2);
+    s_slab_allocator_128.init(512 * KiB, 3);
+}
+
+UNMAP_AFTER_INIT void slab_alloc_init_processor()
+{
+    // Until this has run, allocations on this processor go straight to the depots.
+    auto* data = new (kmalloc_eternal(sizeof(SlabAllocatorPerProcessorData))) SlabAllocatorPerProcessorData;
+    Processor::current().set_slab_data(*data);
 }
 
 void* slab_alloc(size_t slab_size)
@@ -157,12 +261,74 @@ void slab_dealloc(void* ptr, size_t slab_size)
     VERIFY_NOT_REACHED();
 }
 
-void slab_alloc_stats(Function<void(size_t slab_size, size_t allocated, size_t free)> callback)
+static void count_slab_kmalloc_call(bool is_kfree)
+{
+    InterruptDisabler disabler;
+    auto* data = Processor::current().slab_data();
+    if (!data)
+        return;
+    if (is_kfree)
+        ++data->kfree_call_count;
+    else
+        ++data->kmalloc_call_count;
+}
+
+void* slab_try_kmalloc(size_t size)
+{
+    void* ptr;
+    if (size <= 16)
+        ptr = s_slab_allocator_16.try_alloc();
+    else if (size <= 32)
+        ptr = s_slab_allocator_32.try_alloc();
+    else if (size <= 64)
+        ptr = s_slab_allocator_64.try_alloc();
+    else if (size <= 128)
+        ptr = s_slab_allocator_128.try_alloc();
+    else
+        return nullptr;
+    if (ptr)
+        count_slab_kmalloc_call(false);
+    return ptr;
+}
+
+size_t slab_size_of(const void* ptr)
 {
+    size_t slab_size = 0;
     for_each_allocator([&](auto& allocator) {
-        auto num_allocated = allocator.num_allocated();
-        auto num_free = allocator.slab_count() - num_allocated;
-        callback(allocator.slab_size(), num_allocated, num_free);
+        if (allocator.contains(ptr))
+            slab_size = allocator.slab_size();
+    });
+    return slab_size;
+}
+
+bool slab_try_kfree(void* ptr)
+{
+    auto slab_size = slab_size_of(ptr);
+    if (!slab_size)
+        return false;
+    slab_dealloc(ptr, slab_size);
+    count_slab_kmalloc_call(true);
+    return true;
+}
+
+void slab_alloc_stats(Function<void(const SlabAllocatorStats&)> callback)
+{
+    for_each_allocator([&](auto& allocator) {
+        SlabAllocatorStats stats;
+        allocator.stats(stats);
+        callback(stats);
+    });
+}
+
+void slab_kmalloc_stats(size_t& kmalloc_call_count, size_t& kfree_call_count)
+{
+    kmalloc_call_count = 0;
+    kfree_call_count = 0;
+    Processor::for_each([&](Processor& processor) {
+        if (auto* data = processor.slab_data()) {
+            kmalloc_call_count += data->kmalloc_call_count;
+            kfree_call_count += data->kfree_call_count;
+        }
     });
 }
 
@@ -17,7 +17,26 @@ namespace Kernel {
 void* slab_alloc(size_t slab_size);
 void slab_dealloc(void*, size_t slab_size);
 void slab_alloc_init();
-void slab_alloc_stats(Function<void(size_t slab_size, size_t allocated, size_t free)>);
+void slab_alloc_init_processor();
+
+// Used by kmalloc() and kfree() to serve small allocations from the slabs.
+// These fail (rather than falling back to kmalloc) if the slabs can't help.
+void* slab_try_kmalloc(size_t size);
+bool slab_try_kfree(void*);
+size_t slab_size_of(const void*);
+
+struct SlabAllocatorStats {
+    size_t slab_size { 0 };
+    size_t allocated { 0 };
+    size_t free { 0 };
+    size_t cached { 0 };
+    size_t magazine_hits { 0 };
+    size_t magazine_misses { 0 };
+    size_t magazine_drains { 0 };
+    size_t depot_contentions { 0 };
+};
+void slab_alloc_stats(Function<void(const SlabAllocatorStats&)>);
+void slab_kmalloc_stats(size_t& kmalloc_call_count, size_t& kfree_call_count);
 
 #define MAKE_SLAB_ALLOCATED(type)                                                          \
 public:                                                                                    \
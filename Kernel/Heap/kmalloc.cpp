@@ -15,6 +15,7 @@
 #include <Kernel/Arch/x86/CPU.h>
 #include <Kernel/Debug.h>
 #include <Kernel/Heap/Heap.h>
+#include <Kernel/Heap/SlabAllocator.h>
 #include <Kernel/Heap/kmalloc.h>
 #include <Kernel/KSyms.h>
 #include <Kernel/Panic.h>
@@ -191,6 +192,7 @@ static size_t g_kmalloc_bytes_eternal = 0;
 static size_t g_kmalloc_call_count;
 static size_t g_kfree_call_count;
 static size_t g_nested_kfree_calls;
+static size_t g_kmalloc_lock_contention_count;
 bool g_dump_kmalloc_stacks;
 
 static u8* s_next_eternal_ptr;
@@ -241,11 +243,20 @@ void* kmalloc_eternal(size_t size)
     return ptr;
 }
 
-void* kmalloc(size_t size)
+// Returns whether the heap lock is (probably) held by another processor,
+// which is only used for statistics, so it doesn't have to be exact.
+static inline bool kmalloc_lock_is_contended()
 {
-    kmalloc_verify_nospinlock_held();
+    return s_lock.is_locked() && !s_lock.own_lock();
+}
+
+static void* kmalloc_from_heap(size_t size)
+{
+    bool is_contended = kmalloc_lock_is_contended();
     ScopedSpinLock lock(s_lock);
     ++g_kmalloc_call_count;
+    if (is_contended)
+        ++g_kmalloc_lock_contention_count;
 
     if (g_dump_kmalloc_stacks && Kernel::g_kernel_symbols_available) {
         dbgln("kmalloc({})", size);
@@ -256,6 +267,20 @@ void* kmalloc(size_t size)
     if (!ptr) {
         PANIC("kmalloc: Out of memory (requested size: {})", size);
     }
+    return ptr;
+}
+
+void* kmalloc(size_t size)
+{
+    kmalloc_verify_nospinlock_held();
+
+    // Small allocations are served from the per-processor slab magazines
+    // whenever possible, so they don't have to take the heap lock.
+    void* ptr = nullptr;
+    if (!g_dump_kmalloc_stacks)
+        ptr = slab_try_kmalloc(size);
+    if (!ptr)
+        ptr = kmalloc_from_heap(size);
 
     Thread* current_thread = Thread::current();
     if (!current_thread)
@@ -272,9 +297,21 @@ void kfree(void* ptr)
         return;
 
     kmalloc_verify_nospinlock_held();
+    if (slab_try_kfree(ptr)) {
+        Thread* current_thread = Thread::current();
+        if (!current_thread)
+            current_thread = Processor::idle_thread();
+        if (current_thread)
+            PerformanceManager::add_kfree_perf_event(*current_thread, 0, (FlatPtr)ptr);
+        return;
+    }
+
+    bool is_contended = kmalloc_lock_is_contended();
     ScopedSpinLock lock(s_lock);
     ++g_kfree_call_count;
     ++g_nested_kfree_calls;
+    if (is_contended)
+        ++g_kmalloc_lock_contention_count;
 
     if (g_nested_kfree_calls == 1) {
         Thread* current_thread = Thread::current();
@@ -291,6 +328,15 @@ void kfree(void* ptr)
 void* krealloc(void* ptr, size_t new_size)
 {
     kmalloc_verify_nospinlock_held();
+    if (auto slab_size = slab_size_of(ptr)) {
+        if (new_size <= slab_size)
+            return ptr;
+        void* new_ptr = kmalloc(new_size);
+        memcpy(new_ptr, ptr, slab_size);
+        kfree(ptr);
+        return new_ptr;
+    }
+
     ScopedSpinLock lock(s_lock);
     return g_kmalloc_global->m_heap.reallocate(ptr, new_size);
 }
@@ -336,6 +382,8 @@ void get_kmalloc_stats(kmalloc_stats& stats)
     stats.bytes_allocated = g_kmalloc_global->m_heap.allocated_bytes();
     stats.bytes_free = g_kmalloc_global->m_heap.free_bytes() + g_kmalloc_global->backup_memory_bytes();
     stats.bytes_eternal = g_kmalloc_bytes_eternal;
-    stats.kmalloc_call_count = g_kmalloc_call_count;
-    stats.kfree_call_count = g_kfree_call_count;
+    slab_kmalloc_stats(stats.kmalloc_slab_call_count, stats.kfree_slab_call_count);
+    stats.kmalloc_call_count = g_kmalloc_call_count + stats.kmalloc_slab_call_count;
+    stats.kfree_call_count = g_kfree_call_count + stats.kfree_slab_call_count;
+    stats.lock_contention_count = g_kmalloc_lock_contention_count;
 }
@@ -32,6 +32,9 @@ struct kmalloc_stats {
     size_t bytes_eternal;
     size_t kmalloc_call_count;
     size_t kfree_call_count;
+    size_t kmalloc_slab_call_count;
+    size_t kfree_slab_call_count;
+    size_t lock_contention_count;
 };
 void get_kmalloc_stats(kmalloc_stats&);
 
@@ -558,6 +558,7 @@ u32 APIC::get_timer_divisor()
 bool APICIPIInterruptHandler::handle_interrupt(const RegisterState&)
 {
     dbgln_if(APIC_SMP_DEBUG, "APIC IPI on CPU #{}", Processor::id());
+    Processor::current().did_receive_ipi();
     return true;
 }
 
@@ -4,15 +4,108 @@
  * SPDX-License-Identifier: BSD-2-Clause
  */
 
+#include <AK/HashFunctions.h>
 #include <AK/SourceLocation.h>
 #include <AK/TemporaryChange.h>
 #include <Kernel/Debug.h>
 #include <Kernel/KSyms.h>
 #include <Kernel/Lock.h>
+#include <Kernel/SpinLock.h>
 #include <Kernel/Thread.h>
+#include <Kernel/Time/TimeManagement.h>
+#include <Kernel/Tracepoint.h>
 
 namespace Kernel {
 
+// How often to check whether a lock held by a thread running on another
+// processor was released, before giving up and blocking.
+static constexpr u32 max_spin_iterations = 1000;
+
+Atomic<bool> g_lock_statistics_enabled;
+
+struct LockStatisticsEntry {
+    Atomic<const char*> name { nullptr };
+    SpinLock<u8> lock;
+    LockStatistics statistics;
+};
+
+static constexpr size_t lock_statistics_table_size = 256;
+static LockStatisticsEntry s_lock_statistics[lock_statistics_table_size];
+
+static LockStatisticsEntry* lock_statistics_entry(const char* name)
+{
+    if (!name)
+        name = "(unnamed)";
+    auto start = ptr_hash(name) % lock_statistics_table_size;
+    for (size_t i = 0; i < lock_statistics_table_size; i++) {
+        auto& entry = s_lock_statistics[(start + i) % lock_statistics_table_size];
+        const char* expected = nullptr;
+        if (entry.name.compare_exchange_strong(expected, name, AK::memory_order_acq_rel) || expected == name)
+            return &entry;
+    }
+    // The table is full, don't bother with locks we haven't seen yet.
+    return nullptr;
+}
+
+static u64 lock_statistics_timestamp()
+{
+    if (!TimeManagement::initialized())
+        return 0;
+    return TimeManagement::the().monotonic_time(TimePrecision::Precise).to_nanoseconds();
+}
+
+void Lock::did_acquire(u64 wait_started_at, bool did_block)
+{
+    if (!g_lock_statistics_enabled)
+        return;
+    auto* entry = lock_statistics_entry(m_name);
+    if (!entry)
+        return;
+    u64 wait_ns = 0;
+    if (wait_started_at)
+        wait_ns = lock_statistics_timestamp() - wait_started_at;
+
+    ScopedSpinLock lock(entry->lock);
+    auto& statistics = entry->statistics;
+    statistics.acquisitions++;
+    if (!wait_started_at)
+        return;
+    statistics.contended_acquisitions++;
+    if (!did_block)
+        statistics.spun_acquisitions++;
+    statistics.total_wait_ns += wait_ns;
+    statistics.max_wait_ns = max(statistics.max_wait_ns, wait_ns);
+}
+
+void Lock::did_release_exclusively(u64 exclusive_since_ns)
+{
+    if (!exclusive_since_ns || !g_lock_statistics_enabled)
+        return;
+    auto* entry = lock_statistics_entry(m_name);
+    if (!entry)
+        return;
+    u64 hold_ns = lock_statistics_timestamp() - exclusive_since_ns;
+
+    ScopedSpinLock lock(entry->lock);
+    entry->statistics.max_hold_ns = max(entry->statistics.max_hold_ns, hold_ns);
+}
+
+void Lock::for_each_statistics(Function<void(const LockStatistics&)> callback)
+{
+    for (auto& entry : s_lock_statistics) {
+        auto* name = entry.name.load(AK::memory_order_acquire);
+        if (!name)
+            continue;
+        LockStatistics statistics;
+        {
+            ScopedSpinLock lock(entry.lock);
+            statistics = entry.statistics;
+        }
+        statistics.name = name;
+        callback(statistics);
+    }
+}
+
 #if LOCK_DEBUG
 void Lock::lock(Mode mode, const SourceLocation& location)
 #else
@@ -25,6 +118,9 @@ void Lock::lock(Mode mode)
     VERIFY(mode != Mode::Unlocked);
     auto current_thread = Thread::current();
     ScopedCritical critical; // in case we're not in a critical section already
+    u64 wait_started_at = 0;
+    bool did_block = false;
+    u32 spin_iterations = 0;
     for (;;) {
         if (m_lock.exchange(true, AK::memory_order_acq_rel) != false) {
             // I don't know *who* is using "m_lock", so just yield.
@@ -33,6 +129,8 @@ void Lock::lock(Mode mode)
         }
 
         // FIXME: Do not add new readers if writers are queued.
+        Thread* other_holder = nullptr;
+        u32 other_holder_cpu = 0;
         Mode current_mode = m_mode;
         switch (current_mode) {
         case Mode::Unlocked: {
@@ -42,6 +140,8 @@ void Lock::lock(Mode mode)
             VERIFY(m_shared_holders.is_empty());
             if (mode == Mode::Exclusive) {
                 m_holder = current_thread;
+                if (g_lock_statistics_enabled)
+                    m_exclusive_since_ns = lock_statistics_timestamp();
             } else {
                 VERIFY(mode == Mode::Shared);
                 m_shared_holders.set(current_thread, 1);
@@ -56,12 +156,16 @@ void Lock::lock(Mode mode)
 #endif
             m_queue.should_block(true);
             m_lock.store(false, AK::memory_order_release);
+            did_acquire(wait_started_at, did_block);
             return;
         }
         case Mode::Exclusive: {
             VERIFY(m_holder);
-            if (m_holder != current_thread)
+            if (m_holder != current_thread) {
+                other_holder = m_holder.ptr();
+                other_holder_cpu = m_holder->cpu();
                 break;
+            }
             VERIFY(m_shared_holders.is_empty());
 
             if constexpr (LOCK_TRACE_DEBUG) {
@@ -101,18 +205,75 @@ void Lock::lock(Mode mode)
             current_thread->holding_lock(*this, 1, location);
 #endif
             m_lock.store(false, AK::memory_order_release);
+            did_acquire(wait_started_at, did_block);
             return;
         }
         default:
             VERIFY_NOT_REACHED();
         }
         m_lock.store(false, AK::memory_order_release);
+        if (!wait_started_at && g_lock_statistics_enabled)
+            wait_started_at = lock_statistics_timestamp();
+
+        // Blocking costs us two context switches. If the holder is running on
+        // another processor, chances are it lets go of the lock sooner than that.
+        // We only compare the holder pointer from here on, it may be gone already.
+        if (other_holder && other_holder_cpu != Processor::id() && spin_iterations < max_spin_iterations) {
+            auto& holder_processor = Processor::by_id(other_holder_cpu);
+            while (m_mode != Mode::Unlocked && holder_processor.is_running(*other_holder) && spin_iterations < max_spin_iterations) {
+                Processor::wait_check();
+                spin_iterations++;
+            }
+            if (m_mode == Mode::Unlocked)
+                continue;
+        }
+
         dbgln_if(LOCK_TRACE_DEBUG, "Lock::lock @ {} ({}) waiting...", this, m_name);
+        did_block = true;
+        TRACEPOINT(lock_wait, reinterpret_cast<FlatPtr>(this), 0, m_name);
         m_queue.wait_forever(m_name);
+        TRACEPOINT(lock_wake, reinterpret_cast<FlatPtr>(this), 0, m_name);
         dbgln_if(LOCK_TRACE_DEBUG, "Lock::lock @ {} ({}) waited", this, m_name);
     }
 }
 
+#if LOCK_DEBUG
+bool Lock::try_lock(const SourceLocation& location)
+#else
+bool Lock::try_lock()
+#endif
+{
+    VERIFY(!Processor::current().in_irq());
+    auto current_thread = Thread::current();
+    ScopedCritical critical; // in case we're not in a critical section already
+    if (m_lock.exchange(true, AK::memory_order_acq_rel) != false)
+        return false;
+    if (m_mode != Mode::Unlocked) {
+        m_lock.store(false, AK::memory_order_release);
+        return false;
+    }
+
+    dbgln_if(LOCK_TRACE_DEBUG, "Lock::try_lock @ ({}) {}: acquire exclusive, currently unlocked", this, m_name);
+    m_mode = Mode::Exclusive;
+    VERIFY(!m_holder);
+    VERIFY(m_shared_holders.is_empty());
+    m_holder = current_thread;
+    if (g_lock_statistics_enabled)
+        m_exclusive_since_ns = lock_statistics_timestamp();
+    VERIFY(m_times_locked == 0);
+    m_times_locked++;
+
+#if LOCK_DEBUG
+    if (current_thread) {
+        current_thread->holding_lock(*this, 1, location);
+    }
+#endif
+    m_queue.should_block(true);
+    m_lock.store(false, AK::memory_order_release);
+    did_acquire(0, false);
+    return true;
+}
+
 void Lock::unlock()
 {
     // NOTE: This may be called from an interrupt handler (not an IRQ handler)
@@ -122,6 +283,7 @@ void Lock::unlock()
     ScopedCritical critical; // in case we're not in a critical section already
     for (;;) {
         if (m_lock.exchange(true, AK::memory_order_acq_rel) == false) {
+            u64 exclusive_since_ns = 0;
             Mode current_mode = m_mode;
             if constexpr (LOCK_TRACE_DEBUG) {
                 if (current_mode == Mode::Shared)
@@ -139,8 +301,10 @@ void Lock::unlock()
             case Mode::Exclusive:
                 VERIFY(m_holder == current_thread);
                 VERIFY(m_shared_holders.is_empty());
-                if (m_times_locked == 0)
+                if (m_times_locked == 0) {
                     m_holder = nullptr;
+                    exclusive_since_ns = exchange(m_exclusive_since_ns, 0);
+                }
                 break;
             case Mode::Shared: {
                 VERIFY(!m_holder);
@@ -171,6 +335,7 @@ void Lock::unlock()
             }
 #endif
             m_lock.store(false, AK::memory_order_release);
+            did_release_exclusively(exclusive_since_ns);
             if (unlocked_last) {
                 u32 did_wake = m_queue.wake_one();
                 dbgln_if(LOCK_TRACE_DEBUG, "Lock::unlock @ {} ({})  wake one ({})", this, m_name, did_wake);
@@ -211,7 +376,9 @@ auto Lock::force_unlock_if_locked(u32& lock_count_to_restore) -> Mode
                 m_times_locked = 0;
                 m_mode = Mode::Unlocked;
                 m_queue.should_block(false);
+                auto exclusive_since_ns = exchange(m_exclusive_since_ns, 0);
                 m_lock.store(false, AK::memory_order_release);
+                did_release_exclusively(exclusive_since_ns);
                 previous_mode = Mode::Exclusive;
                 break;
             }
@@ -287,6 +454,8 @@ void Lock::restore_lock(Mode mode, u32 lock_count)
                 VERIFY(!m_holder);
                 VERIFY(m_shared_holders.is_empty());
                 m_holder = current_thread;
+                if (g_lock_statistics_enabled)
+                    m_exclusive_since_ns = lock_statistics_timestamp();
                 m_queue.should_block(true);
                 m_lock.store(false, AK::memory_order_release);
 
@@ -8,6 +8,7 @@
 
 #include <AK/Assertions.h>
 #include <AK/Atomic.h>
+#include <AK/Function.h>
 #include <AK/HashMap.h>
 #include <AK/Types.h>
 #include <Kernel/Arch/x86/CPU.h>
@@ -17,6 +18,21 @@
 
 namespace Kernel {
 
+// Contention statistics are only collected while this is set, see /proc/sys/lock_statistics.
+extern Atomic<bool> g_lock_statistics_enabled;
+
+// Statistics are aggregated over all locks sharing the same name (i.e. the same
+// string literal), which is usually all instances of one kind of lock.
+struct LockStatistics {
+    const char* name { nullptr };
+    u64 acquisitions { 0 };
+    u64 contended_acquisitions { 0 };
+    u64 spun_acquisitions { 0 };
+    u64 total_wait_ns { 0 };
+    u64 max_wait_ns { 0 };
+    u64 max_hold_ns { 0 };
+};
+
 class Lock {
     AK_MAKE_NONCOPYABLE(Lock);
     AK_MAKE_NONMOVABLE(Lock);
@@ -38,6 +54,13 @@ public:
     void restore_lock(Mode, u32);
 #endif
 
+    // Locks exclusively if nobody holds the lock, not even the current thread. Never blocks.
+#if LOCK_DEBUG
+    [[nodiscard]] bool try_lock(const SourceLocation& location = SourceLocation::current());
+#else
+    [[nodiscard]] bool try_lock();
+#endif
+
     void unlock();
     [[nodiscard]] Mode force_unlock_if_locked(u32&);
     [[nodiscard]] bool is_locked() const { return m_mode != Mode::Unlocked; }
@@ -45,6 +68,8 @@ public:
 
     [[nodiscard]] const char* name() const { return m_name; }
 
+    static void for_each_statistics(Function<void(const LockStatistics&)>);
+
     static const char* mode_to_string(Mode mode)
     {
         switch (mode) {
@@ -60,6 +85,9 @@ public:
     }
 
 private:
+    void did_acquire(u64 wait_started_at, bool did_block);
+    void did_release_exclusively(u64 exclusive_since_ns);
+
     Atomic<bool> m_lock { false };
     const char* m_name { nullptr };
     WaitQueue m_queue;
@@ -76,6 +104,10 @@ private:
     // lock.
     RefPtr<Thread> m_holder;
     HashMap<Thread*, u32> m_shared_holders;
+
+    // When the lock was acquired exclusively, or 0 if statistics weren't
+    // being collected at that point.
+    u64 m_exclusive_since_ns { 0 };
 };
 
 class Locker {
@@ -92,6 +92,8 @@ namespace Kernel {
 #define TSTA_LC (1 << 2) // Late Collision
 #define LSTA_TU (1 << 3) // Transmit Underrun
 
+#define RSTA_DD (1 << 0) // Descriptor Done
+
 // STATUS Register
 
 #define STATUS_FD 0x01
@@ -180,9 +182,12 @@ UNMAP_AFTER_INIT void E1000NetworkAdapter::setup_link()
 
 UNMAP_AFTER_INIT void E1000NetworkAdapter::setup_interrupts()
 {
-    out32(REG_INTERRUPT_RATE, 6000); // Interrupt rate of 1.536 milliseconds
+    // At most one interrupt every 166 microseconds (the unit is 256 nanoseconds). While
+    // packets keep coming in, we don't take receive interrupts at all, see poll_receive().
+    out32(REG_INTERRUPT_RATE, 651);
     out32(REG_INTERRUPT_MASK_SET, INTERRUPT_LSC | INTERRUPT_RXT0 | INTERRUPT_RXO);
     in32(REG_INTERRUPT_CAUSE_READ);
+    m_link_up = in32(REG_STATUS) & STATUS_LU;
     enable_irq();
 }
 
@@ -242,6 +247,7 @@ bool E1000NetworkAdapter::handle_irq(const RegisterState&)
     if (status & INTERRUPT_LSC) {
         u32 flags = in32(REG_CTRL);
         out32(REG_CTRL, flags | ECTRL_SLU);
+        m_link_up = in32(REG_STATUS) & STATUS_LU;
     }
     if (status & INTERRUPT_RXDMT0) {
         // Threshold OK?
@@ -249,13 +255,19 @@ bool E1000NetworkAdapter::handle_irq(const RegisterState&)
     if (status & INTERRUPT_RXO) {
         dbgln_if(E1000_DEBUG, "E1000: RX buffer overrun");
     }
-    if (status & INTERRUPT_RXT0) {
-        receive();
+    if (status & (INTERRUPT_RXT0 | INTERRUPT_RXO)) {
+        // Leave the receive interrupt off until the NetworkTask has drained the ring.
+        out32(REG_INTERRUPT_MASK_CLEAR, INTERRUPT_RXT0 | INTERRUPT_RXO);
+        schedule_poll();
+    }
+    if (status & INTERRUPT_TXDW) {
+        // This is only turned on by send_raw() while it waits for a free descriptor.
+        out32(REG_INTERRUPT_MASK_CLEAR, INTERRUPT_TXDW);
     }
 
     m_wait_queue.wake_all();
 
-    out32(REG_INTERRUPT_CAUSE_READ, 0xffffffff);
+    out32(REG_INTERRUPT_CAUSE_READ, status);
     return true;
 }
 
@@ -308,20 +320,14 @@ UNMAP_AFTER_INIT void E1000NetworkAdapter::read_mac_address()
     }
 }
 
-bool E1000NetworkAdapter::link_up()
-{
-    return (in32(REG_STATUS) & STATUS_LU);
-}
-
 UNMAP_AFTER_INIT void E1000NetworkAdapter::initialize_rx_descriptors()
 {
-    auto* rx_descriptors = (e1000_tx_desc*)m_rx_descriptors_region->vaddr().as_ptr();
+    auto* rx_descriptors = (e1000_rx_desc*)m_rx_descriptors_region->vaddr().as_ptr();
+    m_rx_buffers_region = MM.allocate_contiguous_kernel_region(page_round_up(number_of_rx_descriptors * packet_buffer_size), "E1000 RX buffers", Region::Access::Read | Region::Access::Write);
+    VERIFY(m_rx_buffers_region);
     for (size_t i = 0; i < number_of_rx_descriptors; ++i) {
         auto& descriptor = rx_descriptors[i];
-        auto region = MM.allocate_contiguous_kernel_region(8192, "E1000 RX buffer", Region::Access::Read | Region::Access::Write);
-        VERIFY(region);
-        m_rx_buffers_regions.append(region.release_nonnull());
-        descriptor.addr = m_rx_buffers_regions[i].physical_page(0)->paddr().get();
+        descriptor.addr = m_rx_buffers_region->physical_page(0)->paddr().offset(i * packet_buffer_size).get();
         descriptor.status = 0;
     }
 
@@ -329,20 +335,19 @@ UNMAP_AFTER_INIT void E1000NetworkAdapter::initialize_rx_descriptors()
     out32(REG_RXDESCHI, 0);
     out32(REG_RXDESCLEN, number_of_rx_descriptors * sizeof(e1000_rx_desc));
     out32(REG_RXDESCHEAD, 0);
-    out32(REG_RXDESCTAIL, number_of_rx_descriptors - 1);
+    out32(REG_RXDESCTAIL, m_rx_tail);
 
-    out32(REG_RCTRL, RCTL_EN | RCTL_SBP | RCTL_UPE | RCTL_MPE | RCTL_LBM_NONE | RTCL_RDMTS_HALF | RCTL_BAM | RCTL_SECRC | RCTL_BSIZE_8192);
+    out32(REG_RCTRL, RCTL_EN | RCTL_SBP | RCTL_UPE | RCTL_MPE | RCTL_LBM_NONE | RTCL_RDMTS_HALF | RCTL_BAM | RCTL_SECRC | RCTL_BSIZE_2048);
 }
 
 UNMAP_AFTER_INIT void E1000NetworkAdapter::initialize_tx_descriptors()
 {
     auto* tx_descriptors = (e1000_tx_desc*)m_tx_descriptors_region->vaddr().as_ptr();
+    m_tx_buffers_region = MM.allocate_contiguous_kernel_region(page_round_up(number_of_tx_descriptors * packet_buffer_size), "E1000 TX buffers", Region::Access::Read | Region::Access::Write);
+    VERIFY(m_tx_buffers_region);
     for (size_t i = 0; i < number_of_tx_descriptors; ++i) {
         auto& descriptor = tx_descriptors[i];
-        auto region = MM.allocate_contiguous_kernel_region(8192, "E1000 TX buffer", Region::Access::Read | Region::Access::Write);
-        VERIFY(region);
-        m_tx_buffers_regions.append(region.release_nonnull());
-        descriptor.addr = m_tx_buffers_regions[i].physical_page(0)->paddr().get();
+        descriptor.addr = m_tx_buffers_region->physical_page(0)->paddr().offset(i * packet_buffer_size).get();
         descriptor.cmd = 0;
     }
 
@@ -415,49 +420,77 @@ u32 E1000NetworkAdapter::in32(u16 address)
 
 void E1000NetworkAdapter::send_raw(ReadonlyBytes payload)
 {
-    disable_irq();
-    size_t tx_current = in32(REG_TXDESCTAIL) % number_of_tx_descriptors;
-    dbgln_if(E1000_DEBUG, "E1000: Sending packet ({} bytes)", payload.size());
+    VERIFY(payload.size() <= packet_buffer_size);
+    Locker locker(m_tx_lock);
     auto* tx_descriptors = (e1000_tx_desc*)m_tx_descriptors_region->vaddr().as_ptr();
-    auto& descriptor = tx_descriptors[tx_current];
-    VERIFY(payload.size() <= 8192);
-    auto* vptr = (void*)m_tx_buffers_regions[tx_current].vaddr().as_ptr();
-    memcpy(vptr, payload.data(), payload.size());
-    descriptor.length = payload.size();
-    descriptor.status = 0;
-    descriptor.cmd = CMD_EOP | CMD_IFCS | CMD_RS;
-    dbgln_if(E1000_DEBUG, "E1000: Using tx descriptor {} (head is at {})", tx_current, in32(REG_TXDESCHEAD));
-    tx_current = (tx_current + 1) % number_of_tx_descriptors;
-    cli();
-    enable_irq();
-    out32(REG_TXDESCTAIL, tx_current);
-    for (;;) {
-        if (descriptor.status) {
-            sti();
+
+    // The device owns the descriptors from its head up to the tail we gave it. The ring
+    // counts as empty when the two are equal, so one descriptor always has to stay unused.
+    auto& next_descriptor = tx_descriptors[(m_tx_tail + 1) % number_of_tx_descriptors];
+    while (next_descriptor.cmd && !(next_descriptor.status & TSTA_DD)) {
+        // Make sure the device knows about everything we've queued up before waiting for it.
+        update_tx_tail();
+        out32(REG_INTERRUPT_MASK_SET, INTERRUPT_TXDW);
+        if (next_descriptor.status & TSTA_DD)
             break;
-        }
         m_wait_queue.wait_forever("E1000NetworkAdapter");
     }
-    dbgln_if(E1000_DEBUG, "E1000: Sent packet, status is now {:#02x}!", (u8)descriptor.status);
+
+    dbgln_if(E1000_DEBUG, "E1000: Sending packet ({} bytes) using tx descriptor {}", payload.size(), m_tx_tail);
+    auto& descriptor = tx_descriptors[m_tx_tail];
+    memcpy(m_tx_buffers_region->vaddr().offset(m_tx_tail * packet_buffer_size).as_ptr(), payload.data(), payload.size());
+    descriptor.length = payload.size();
+    descriptor.status = 0;
+    descriptor.cmd = CMD_EOP | CMD_IFCS | CMD_RS;
+    m_tx_tail = (m_tx_tail + 1) % number_of_tx_descriptors;
+
+    if (!is_in_transmit_batch())
+        update_tx_tail();
 }
 
-void E1000NetworkAdapter::receive()
+void E1000NetworkAdapter::flush_transmit()
 {
-    auto* rx_descriptors = (e1000_tx_desc*)m_rx_descriptors_region->vaddr().as_ptr();
-    u32 rx_current;
-    for (;;) {
-        rx_current = in32(REG_RXDESCTAIL) % number_of_rx_descriptors;
-        rx_current = (rx_current + 1) % number_of_rx_descriptors;
-        if (!(rx_descriptors[rx_current].status & 1))
+    Locker locker(m_tx_lock);
+    update_tx_tail();
+}
+
+void E1000NetworkAdapter::update_tx_tail()
+{
+    VERIFY(m_tx_lock.is_locked());
+    if (m_device_tx_tail == m_tx_tail)
+        return;
+    out32(REG_TXDESCTAIL, m_tx_tail);
+    m_device_tx_tail = m_tx_tail;
+}
+
+size_t E1000NetworkAdapter::poll_receive(size_t budget)
+{
+    auto* rx_descriptors = (e1000_rx_desc*)m_rx_descriptors_region->vaddr().as_ptr();
+    size_t packet_count = 0;
+    while (packet_count < budget) {
+        size_t rx_current = (m_rx_tail + 1) % number_of_rx_descriptors;
+        auto& descriptor = rx_descriptors[rx_current];
+        if (!(descriptor.status & RSTA_DD))
             break;
-        auto* buffer = m_rx_buffers_regions[rx_current].vaddr().as_ptr();
-        u16 length = rx_descriptors[rx_current].length;
-        VERIFY(length <= 8192);
+        auto* buffer = m_rx_buffers_region->vaddr().offset(rx_current * packet_buffer_size).as_ptr();
+        u16 length = descriptor.length;
+        VERIFY(length <= packet_buffer_size);
         dbgln_if(E1000_DEBUG, "E1000: Received 1 packet @ {:p} ({} bytes)", buffer, length);
         did_receive({ buffer, length });
-        rx_descriptors[rx_current].status = 0;
-        out32(REG_RXDESCTAIL, rx_current);
+        descriptor.status = 0;
+        m_rx_tail = rx_current;
+        ++packet_count;
     }
+
+    // Give all the descriptors we're done with back to the device at once.
+    if (packet_count > 0)
+        out32(REG_RXDESCTAIL, m_rx_tail);
+
+    // If a packet comes in after we looked, its interrupt cause is still pending
+    // and will fire as soon as the interrupt is unmasked.
+    if (packet_count < budget)
+        out32(REG_INTERRUPT_MASK_SET, INTERRUPT_RXT0 | INTERRUPT_RXO);
+    return packet_count;
 }
 
 }
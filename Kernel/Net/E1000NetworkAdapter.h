@@ -6,10 +6,10 @@
 
 #pragma once
 
-#include <AK/NonnullOwnPtrVector.h>
 #include <AK/OwnPtr.h>
 #include <Kernel/IO.h>
 #include <Kernel/Interrupts/IRQHandler.h>
+#include <Kernel/Lock.h>
 #include <Kernel/Net/NetworkAdapter.h>
 #include <Kernel/PCI/Access.h>
 #include <Kernel/PCI/Device.h>
@@ -27,7 +27,7 @@ public:
     virtual ~E1000NetworkAdapter() override;
 
     virtual void send_raw(ReadonlyBytes) override;
-    virtual bool link_up() override;
+    virtual bool link_up() override { return m_link_up; }
 
     virtual const char* purpose() const override { return class_name(); }
 
@@ -75,22 +75,35 @@ protected:
     u16 in16(u16 address);
     u32 in32(u16 address);
 
-    void receive();
+    virtual size_t poll_receive(size_t budget) override;
+    virtual void flush_transmit() override;
+    void update_tx_tail();
 
     IOAddress m_io_base;
     VirtualAddress m_mmio_base;
     OwnPtr<Region> m_rx_descriptors_region;
     OwnPtr<Region> m_tx_descriptors_region;
-    NonnullOwnPtrVector<Region> m_rx_buffers_regions;
-    NonnullOwnPtrVector<Region> m_tx_buffers_regions;
+    OwnPtr<Region> m_rx_buffers_region;
+    OwnPtr<Region> m_tx_buffers_region;
     OwnPtr<Region> m_mmio_region;
     u8 m_interrupt_line { 0 };
     bool m_has_eeprom { false };
     bool m_use_mmio { false };
+    bool m_link_up { false };
     EntropySource m_entropy_source;
 
-    static constexpr size_t number_of_rx_descriptors = 32;
-    static constexpr size_t number_of_tx_descriptors = 8;
+    static constexpr size_t number_of_rx_descriptors = 256;
+    static constexpr size_t number_of_tx_descriptors = 64;
+    // Big enough for a full-sized Ethernet frame, since we don't enable long packets.
+    static constexpr size_t packet_buffer_size = 2048;
+
+    // The last descriptor we gave back to the device.
+    size_t m_rx_tail { number_of_rx_descriptors - 1 };
+
+    Lock m_tx_lock { "E1000NetworkAdapter TX" };
+    // The next descriptor we'll fill in, and where the device thinks the tail is.
+    size_t m_tx_tail { 0 };
+    size_t m_device_tx_tail { 0 };
 
     WaitQueue m_wait_queue;
 };
@@ -13,6 +13,7 @@
 #include <Kernel/Net/IPv4.h>
 #include <Kernel/Net/IPv4Socket.h>
 #include <Kernel/Net/NetworkAdapter.h>
+#include <Kernel/Net/NetworkTask.h>
 #include <Kernel/Net/NetworkingManagement.h>
 #include <Kernel/Net/Routing.h>
 #include <Kernel/Net/TCP.h>
@@ -251,7 +252,7 @@ KResultOr<size_t> IPv4Socket::receive_byte_buffered(FileDescription& description
     if (m_receive_buffer.is_empty()) {
         if (protocol_is_disconnected())
             return 0;
-        if (!description.is_blocking())
+        if (!description.is_blocking() || (flags & MSG_DONTWAIT))
             return EAGAIN;
 
         locker.unlock();
@@ -276,8 +277,10 @@ KResultOr<size_t> IPv4Socket::receive_byte_buffered(FileDescription& description
     else
         nreceived_or_error = m_receive_buffer.read(buffer, buffer_length);
 
-    if (!nreceived_or_error.is_error() && nreceived_or_error.value() > 0 && !(flags & MSG_PEEK))
+    if (!nreceived_or_error.is_error() && nreceived_or_error.value() > 0 && !(flags & MSG_PEEK)) {
         Thread::current()->did_ipv4_socket_read(nreceived_or_error.value());
+        protocol_did_read();
+    }
 
     set_can_read(!m_receive_buffer.is_empty());
     return nreceived_or_error;
@@ -293,7 +296,7 @@ KResultOr<size_t> IPv4Socket::receive_packet_buffered(FileDescription& descripti
             //        But if so, we still need to deliver at least one EOF read to userspace.. right?
             if (protocol_is_disconnected())
                 return 0;
-            if (!description.is_blocking())
+            if (!description.is_blocking() || (flags & MSG_DONTWAIT))
                 return EAGAIN;
         }
 
@@ -427,7 +430,8 @@ bool IPv4Socket::did_receive(const IPv4Address& source_address, u16 source_port,
             dbgln("IPv4Socket({}): did_receive refusing packet since queue is full.", this);
             return false;
         }
-        m_receive_queue.append({ source_address, source_port, packet_timestamp, KBuffer::copy(packet.data(), packet.size()) });
+        // Datagrams are usually small, so don't give each of them its own kernel region.
+        m_receive_queue.append({ source_address, source_port, packet_timestamp, ByteBuffer::copy(packet) });
         set_can_read(true);
     }
     m_bytes_received += packet_size;
@@ -752,7 +756,11 @@ void IPv4Socket::shut_down_for_reading()
 void IPv4Socket::set_can_read(bool value)
 {
     m_can_read = value;
-    if (value)
+    if (!value)
+        return;
+    if (NetworkTask::is_current())
+        NetworkTask::defer_waking_readers(*this);
+    else
         evaluate_block_conditions();
 }
 
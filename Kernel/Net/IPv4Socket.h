@@ -6,6 +6,7 @@
 
 #pragma once
 
+#include <AK/ByteBuffer.h>
 #include <AK/HashMap.h>
 #include <AK/SinglyLinkedListWithCount.h>
 #include <Kernel/DoubleBuffer.h>
@@ -49,6 +50,8 @@ public:
     virtual int ioctl(FileDescription&, unsigned request, FlatPtr arg) override;
 
     bool did_receive(const IPv4Address& peer_address, u16 peer_port, ReadonlyBytes, const Time&);
+    // Called by the NetworkTask once it's done with a batch of packets, see set_can_read().
+    void did_receive_batch() { evaluate_block_conditions(); }
 
     const IPv4Address& local_address() const { return m_local_address; }
     u16 local_port() const { return m_local_port; }
@@ -86,12 +89,17 @@ protected:
     virtual KResult protocol_connect(FileDescription&, ShouldBlock) { return KSuccess; }
     virtual KResultOr<u16> protocol_allocate_local_port() { return ENOPROTOOPT; }
     virtual bool protocol_is_disconnected() const { return false; }
+    // Called after data was taken out of the receive buffer of a byte-buffered socket.
+    virtual void protocol_did_read() { }
 
     virtual void shut_down_for_reading() override;
 
     void set_local_address(IPv4Address address) { m_local_address = address; }
     void set_peer_address(IPv4Address address) { m_peer_address = address; }
 
+    static constexpr size_t receive_buffer_size = 256 * KiB;
+    size_t receive_buffer_space() const { return m_receive_buffer.space_for_writing(); }
+
 private:
     virtual bool is_ipv4() const override { return true; }
 
@@ -110,12 +118,12 @@ private:
         IPv4Address peer_address;
         u16 peer_port;
         Time timestamp;
-        Optional<KBuffer> data;
+        Optional<ByteBuffer> data;
     };
 
     SinglyLinkedListWithCount<ReceivedPacket> m_receive_queue;
 
-    DoubleBuffer m_receive_buffer { 256 * KiB };
+    DoubleBuffer m_receive_buffer { receive_buffer_size };
 
     u16 m_local_port { 0 };
     u16 m_peer_port { 0 };
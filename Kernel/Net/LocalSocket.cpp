@@ -299,6 +299,19 @@ KResultOr<size_t> LocalSocket::sendto(FileDescription& description, const UserOr
     return nwritten_or_error;
 }
 
+KResultOr<size_t> LocalSocket::write_from(FileDescription& description, u64, UserOrKernelBufferFiller& filler, size_t size)
+{
+    if (is_shut_down_for_writing() || !has_attached_peer(description))
+        return EPIPE;
+    auto* socket_buffer = send_buffer_for(description);
+    if (!socket_buffer)
+        return EINVAL;
+    auto nwritten_or_error = socket_buffer->write_from(filler, size);
+    if (!nwritten_or_error.is_error() && nwritten_or_error.value() > 0)
+        Thread::current()->did_unix_socket_write(nwritten_or_error.value());
+    return nwritten_or_error;
+}
+
 DoubleBuffer* LocalSocket::receive_buffer_for(FileDescription& description)
 {
     auto role = this->role(description);
@@ -319,12 +332,12 @@ DoubleBuffer* LocalSocket::send_buffer_for(FileDescription& description)
     return nullptr;
 }
 
-KResultOr<size_t> LocalSocket::recvfrom(FileDescription& description, UserOrKernelBuffer& buffer, size_t buffer_size, int, Userspace<sockaddr*>, Userspace<socklen_t*>, Time&)
+KResultOr<size_t> LocalSocket::recvfrom(FileDescription& description, UserOrKernelBuffer& buffer, size_t buffer_size, int flags, Userspace<sockaddr*>, Userspace<socklen_t*>, Time&)
 {
     auto* socket_buffer = receive_buffer_for(description);
     if (!socket_buffer)
         return EINVAL;
-    if (!description.is_blocking()) {
+    if (!description.is_blocking() || (flags & MSG_DONTWAIT)) {
         if (socket_buffer->is_empty()) {
             if (!has_attached_peer(description))
                 return 0;
@@ -5,6 +5,7 @@
  */
 
 #include <AK/Singleton.h>
+#include <Kernel/Debug.h>
 #include <Kernel/Net/LoopbackAdapter.h>
 
 namespace Kernel {
@@ -31,7 +32,7 @@ LoopbackAdapter::~LoopbackAdapter()
 
 void LoopbackAdapter::send_raw(ReadonlyBytes payload)
 {
-    dbgln("LoopbackAdapter: Sending {} byte(s) to myself.", payload.size());
+    dbgln_if(LOOPBACK_DEBUG, "LoopbackAdapter: Sending {} byte(s) to myself.", payload.size());
     did_receive(payload);
 }
 
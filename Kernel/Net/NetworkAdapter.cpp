@@ -92,24 +92,68 @@ void NetworkAdapter::did_receive(ReadonlyBytes payload)
     m_packet_queue.append(*packet);
     m_packet_queue_size++;
 
-    if (on_receive)
+    // There's no need to wake up the NetworkTask while it's polling us.
+    if (on_receive && !m_is_polling)
         on_receive();
 }
 
-size_t NetworkAdapter::dequeue_packet(u8* buffer, size_t buffer_size, Time& packet_timestamp)
+size_t NetworkAdapter::dequeue_packets(PacketList& packets, size_t max_count)
 {
     InterruptDisabler disabler;
-    if (m_packet_queue.is_empty())
-        return 0;
-    auto packet_with_timestamp = m_packet_queue.take_first();
-    m_packet_queue_size--;
-    packet_timestamp = packet_with_timestamp->timestamp;
-    auto& packet_buffer = packet_with_timestamp->buffer;
-    size_t packet_size = packet_buffer.size();
-    VERIFY(packet_size <= buffer_size);
-    memcpy(buffer, packet_buffer.data(), packet_size);
-    release_packet_buffer(*packet_with_timestamp);
-    return packet_size;
+    size_t count = 0;
+    while (count < max_count && !m_packet_queue.is_empty()) {
+        packets.append(*m_packet_queue.take_first());
+        m_packet_queue_size--;
+        count++;
+    }
+    return count;
+}
+
+void NetworkAdapter::schedule_poll()
+{
+    if (m_poll_scheduled.exchange(true))
+        return;
+    if (on_receive)
+        on_receive();
+}
+
+size_t NetworkAdapter::poll(size_t budget)
+{
+    m_poll_scheduled = false;
+    m_is_polling = true;
+    size_t packet_count = poll_receive(budget);
+    m_is_polling = false;
+    // If the budget ran out, the device most likely has more for us and its
+    // receive interrupt is still off, so keep polling it.
+    if (packet_count >= budget)
+        m_poll_scheduled = true;
+    return packet_count;
+}
+
+void NetworkAdapter::begin_transmit_batch()
+{
+    auto* current_thread = Thread::current();
+    VERIFY(current_thread);
+    if (m_transmit_batch_depth++ == 0) {
+        VERIFY(!m_transmit_batch_thread);
+        m_transmit_batch_thread = current_thread;
+    }
+    VERIFY(m_transmit_batch_thread == current_thread);
+}
+
+bool NetworkAdapter::is_in_transmit_batch() const
+{
+    return m_transmit_batch_thread && m_transmit_batch_thread == Thread::current();
+}
+
+void NetworkAdapter::end_transmit_batch()
+{
+    VERIFY(m_transmit_batch_depth > 0);
+    VERIFY(is_in_transmit_batch());
+    if (--m_transmit_batch_depth > 0)
+        return;
+    m_transmit_batch_thread = nullptr;
+    flush_transmit();
 }
 
 RefPtr<PacketWithTimestamp> NetworkAdapter::acquire_packet_buffer(size_t size)
@@ -145,6 +189,13 @@ void NetworkAdapter::release_packet_buffer(PacketWithTimestamp& packet)
     m_unused_packets.append(packet);
 }
 
+void NetworkAdapter::release_packet_buffers(PacketList& packets)
+{
+    InterruptDisabler disabler;
+    while (!packets.is_empty())
+        m_unused_packets.append(*packets.take_first());
+}
+
 void NetworkAdapter::set_ipv4_address(const IPv4Address& address)
 {
     m_ipv4_address = address;
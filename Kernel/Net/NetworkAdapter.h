@@ -6,6 +6,7 @@
 
 #pragma once
 
+#include <AK/Atomic.h>
 #include <AK/ByteBuffer.h>
 #include <AK/Function.h>
 #include <AK/IntrusiveList.h>
@@ -42,6 +43,8 @@ struct PacketWithTimestamp : public RefCounted<PacketWithTimestamp> {
 class NetworkAdapter : public RefCounted<NetworkAdapter>
     , public Weakable<NetworkAdapter> {
 public:
+    using PacketList = IntrusiveList<PacketWithTimestamp, RefPtr<PacketWithTimestamp>, &PacketWithTimestamp::packet_node>;
+
     virtual ~NetworkAdapter();
 
     virtual const char* class_name() const = 0;
@@ -61,10 +64,25 @@ public:
     void send(const MACAddress&, const ARPPacket&);
     void fill_in_ipv4_header(PacketWithTimestamp&, IPv4Address const&, MACAddress const&, IPv4Address const&, IPv4Protocol, size_t, u8);
 
-    size_t dequeue_packet(u8* buffer, size_t buffer_size, Time& packet_timestamp);
+    // Moves up to max_count received packets to the end of the given list. They
+    // have to be handed back with release_packet_buffers() once they're handled.
+    size_t dequeue_packets(PacketList&, size_t max_count);
 
     bool has_queued_packets() const { return !m_packet_queue.is_empty(); }
 
+    // Adapters that can switch off their receive interrupt ask to be polled from
+    // their IRQ handler, instead of copying every packet out right there. poll()
+    // then moves up to budget packets from the device to the packet queue.
+    bool is_poll_scheduled() const { return m_poll_scheduled; }
+    size_t poll(size_t budget);
+
+    // Packets the current thread sends within a transmit batch may be held
+    // back until the end of it, so the device can be told about all of them
+    // at once. Packets sent by other threads in the meantime go out right away.
+    // Only one thread can batch at a time.
+    void begin_transmit_batch();
+    void end_transmit_batch();
+
     u32 mtu() const { return m_mtu; }
     void set_mtu(u32 mtu) { m_mtu = mtu; }
 
@@ -75,6 +93,7 @@ public:
 
     RefPtr<PacketWithTimestamp> acquire_packet_buffer(size_t);
     void release_packet_buffer(PacketWithTimestamp&);
+    void release_packet_buffers(PacketList&);
 
     constexpr size_t layer3_payload_offset() const { return sizeof(EthernetFrameHeader); }
     constexpr size_t ipv4_payload_offset() const { return layer3_payload_offset() + sizeof(IPv4Packet); }
@@ -90,6 +109,14 @@ protected:
     void did_receive(ReadonlyBytes);
     virtual void send_raw(ReadonlyBytes) = 0;
 
+    void schedule_poll();
+    // Returns how many packets were received. Once that's less than the budget,
+    // the device is drained and the receive interrupt should be turned back on.
+    virtual size_t poll_receive(size_t) { return 0; }
+
+    bool is_in_transmit_batch() const;
+    virtual void flush_transmit() { }
+
     void set_loopback_name();
 
 private:
@@ -101,8 +128,6 @@ private:
     // FIXME: Make this configurable
     static constexpr size_t max_packet_buffers = 1024;
 
-    using PacketList = IntrusiveList<PacketWithTimestamp, RefPtr<PacketWithTimestamp>, &PacketWithTimestamp::packet_node>;
-
     PacketList m_packet_queue;
     size_t m_packet_queue_size { 0 };
     PacketList m_unused_packets;
@@ -112,6 +137,10 @@ private:
     u32 m_packets_out { 0 };
     u32 m_bytes_out { 0 };
     u32 m_mtu { 1500 };
+    Atomic<bool> m_poll_scheduled { false };
+    bool m_is_polling { false };
+    Atomic<Thread*> m_transmit_batch_thread { nullptr };
+    u32 m_transmit_batch_depth { 0 };
 };
 
 }
@@ -21,6 +21,8 @@
 #include <Kernel/Net/UDP.h>
 #include <Kernel/Net/UDPSocket.h>
 #include <Kernel/Process.h>
+#include <Kernel/Time/TimeManagement.h>
+#include <Kernel/Tracepoint.h>
 
 namespace Kernel {
 
@@ -31,31 +33,24 @@ static void handle_udp(const IPv4Packet&, const Time& packet_timestamp);
 static void handle_tcp(const IPv4Packet&, const Time& packet_timestamp);
 static void send_delayed_tcp_ack(RefPtr<TCPSocket> socket);
 static void flush_delayed_tcp_acks();
-static void retransmit_tcp_packets();
+static Time retransmit_tcp_packets();
+static size_t handle_received_packets(NetworkAdapter&);
+static void wake_deferred_readers();
+
+// How many packets we take from an adapter before giving the others a turn.
+static constexpr size_t receive_batch_size = 64;
 
 static Thread* network_task = nullptr;
 static HashTable<RefPtr<TCPSocket>>* delayed_ack_sockets;
+static HashTable<RefPtr<IPv4Socket>>* deferred_reader_sockets;
 
-[[noreturn]] static void NetworkTask_main(void*);
-
-void NetworkTask::spawn()
-{
-    RefPtr<Thread> thread;
-    Process::create_kernel_process(thread, "NetworkTask", NetworkTask_main, nullptr);
-    network_task = thread;
-}
-
-bool NetworkTask::is_current()
-{
-    return Thread::current() == network_task;
-}
-
-void NetworkTask_main(void*)
+[[noreturn]] static void NetworkTask_main(void*)
 {
     delayed_ack_sockets = new HashTable<RefPtr<TCPSocket>>;
+    deferred_reader_sockets = new HashTable<RefPtr<IPv4Socket>>;
 
     WaitQueue packet_wait_queue;
-    int pending_packets = 0;
+    NonnullRefPtrVector<NetworkAdapter> adapters;
     NetworkingManagement::the().for_each([&](auto& adapter) {
         dmesgln("NetworkTask: {} network adapter found: hw={}", adapter.class_name(), adapter.mac_address().to_string());
 
@@ -66,45 +61,57 @@ void NetworkTask_main(void*)
         }
 
         adapter.on_receive = [&]() {
-            pending_packets++;
             packet_wait_queue.wake_all();
         };
+        adapters.append(adapter);
     });
 
-    auto dequeue_packet = [&pending_packets](u8* buffer, size_t buffer_size, Time& packet_timestamp) -> size_t {
-        if (pending_packets == 0)
-            return 0;
-        size_t packet_size = 0;
-        NetworkingManagement::the().for_each([&](auto& adapter) {
-            if (packet_size || !adapter.has_queued_packets())
-                return;
-            packet_size = adapter.dequeue_packet(buffer, buffer_size, packet_timestamp);
-            pending_packets--;
-            dbgln_if(NETWORK_TASK_DEBUG, "NetworkTask: Dequeued packet from {} ({} bytes)", adapter.name(), packet_size);
-        });
-        return packet_size;
-    };
-
-    size_t buffer_size = 64 * KiB;
-    auto buffer_region = MM.allocate_kernel_region(buffer_size, "Kernel Packet Buffer", Region::Access::Read | Region::Access::Write);
-    auto buffer = (u8*)buffer_region->vaddr().get();
-    Time packet_timestamp;
-
     for (;;) {
+        // Everything we send in response to a batch of packets is handed to the devices in one go.
+        for (auto& adapter : adapters)
+            adapter.begin_transmit_batch();
+
         flush_delayed_tcp_acks();
-        retransmit_tcp_packets();
-        size_t packet_size = dequeue_packet(buffer, buffer_size, packet_timestamp);
-        if (!packet_size) {
+        auto next_retransmit_deadline = retransmit_tcp_packets();
+        size_t packet_count = 0;
+        for (auto& adapter : adapters)
+            packet_count += handle_received_packets(adapter);
+
+        for (auto& adapter : adapters)
+            adapter.end_transmit_batch();
+        wake_deferred_readers();
+
+        if (!packet_count) {
+            // Retransmit timeouts can be a lot shorter than the 500ms we wait for delayed ACKs.
             auto timeout_time = Time::from_milliseconds(500);
+            auto now = TimeManagement::the().monotonic_time();
+            if (next_retransmit_deadline < now + timeout_time)
+                timeout_time = next_retransmit_deadline > now ? next_retransmit_deadline - now : Time::from_milliseconds(1);
             auto timeout = Thread::BlockTimeout { false, &timeout_time };
             [[maybe_unused]] auto result = packet_wait_queue.wait_on(timeout, "NetworkTask");
-            continue;
         }
+    }
+}
+
+size_t handle_received_packets(NetworkAdapter& adapter)
+{
+    size_t polled_count = adapter.is_poll_scheduled() ? adapter.poll(receive_batch_size) : 0;
+
+    NetworkAdapter::PacketList packets;
+    size_t packet_count = adapter.dequeue_packets(packets, receive_batch_size);
+    // If the adapter dropped what we polled from it, it still needs to be polled again.
+    if (!packet_count)
+        return polled_count;
+    dbgln_if(NETWORK_TASK_DEBUG, "NetworkTask: Dequeued {} packets from {}", packet_count, adapter.name());
+
+    for (auto& packet : packets) {
+        size_t packet_size = packet.buffer.size();
         if (packet_size < sizeof(EthernetFrameHeader)) {
             dbgln("NetworkTask: Packet is too small to be an Ethernet packet! ({})", packet_size);
             continue;
         }
-        auto& eth = *(const EthernetFrameHeader*)buffer;
+        auto& eth = *(const EthernetFrameHeader*)packet.buffer.data();
+        TRACEPOINT(net_receive, packet_size, eth.ether_type());
         dbgln_if(ETHERNET_DEBUG, "NetworkTask: From {} to {}, ether_type={:#04x}, packet_size={}", eth.source().to_string(), eth.destination().to_string(), eth.ether_type(), packet_size);
 
         switch (eth.ether_type()) {
@@ -112,7 +119,7 @@ void NetworkTask_main(void*)
             handle_arp(eth, packet_size);
             break;
         case EtherType::IPv4:
-            handle_ipv4(eth, packet_size, packet_timestamp);
+            handle_ipv4(eth, packet_size, packet.timestamp);
             break;
         case EtherType::IPv6:
             // ignore
@@ -121,6 +128,16 @@ void NetworkTask_main(void*)
             dbgln_if(ETHERNET_DEBUG, "NetworkTask: Unknown ethernet type {:#04x}", eth.ether_type());
         }
     }
+
+    adapter.release_packet_buffers(packets);
+    return packet_count;
+}
+
+void wake_deferred_readers()
+{
+    for (auto& socket : *deferred_reader_sockets)
+        socket->did_receive_batch();
+    deferred_reader_sockets->clear();
 }
 
 void handle_arp(const EthernetFrameHeader& eth, size_t frame_size)
@@ -342,6 +359,7 @@ void handle_tcp(const IPv4Packet& ipv4_packet, const Time& packet_timestamp)
     size_t maximum_tcp_header_size = 15 * sizeof(u32);
     if (tcp_packet.header_size() < minimum_tcp_header_size || tcp_packet.header_size() > maximum_tcp_header_size) {
         dbgln("handle_tcp: TCP packet header has invalid size {}", tcp_packet.header_size());
+        return;
     }
 
     if (ipv4_packet.payload_size() < tcp_packet.header_size()) {
@@ -428,6 +446,7 @@ void handle_tcp(const IPv4Packet& ipv4_packet, const Time& packet_timestamp)
             }
             Locker locker(client->lock());
             dbgln_if(TCP_DEBUG, "handle_tcp: created new client socket with tuple {}", client->tuple().to_string());
+            client->negotiate_options(tcp_packet);
             client->set_sequence_number(1000);
             client->set_ack_number(tcp_packet.sequence_number() + payload_size + 1);
             [[maybe_unused]] auto rc2 = client->send_tcp_packet(TCPFlags::SYN | TCPFlags::ACK);
@@ -585,17 +604,14 @@ void handle_tcp(const IPv4Packet& ipv4_packet, const Time& packet_timestamp)
         }
 
         if (tcp_packet.sequence_number() != socket->ack_number()) {
-            dbgln_if(TCP_DEBUG, "Discarding out of order packet: seq {} vs. ack {}", tcp_packet.sequence_number(), socket->ack_number());
-            if (socket->duplicate_acks() < TCPSocket::maximum_duplicate_acks) {
-                dbgln_if(TCP_DEBUG, "Sending ACK with same ack number to trigger fast retransmission");
-                socket->set_duplicate_acks(socket->duplicate_acks() + 1);
-                [[maybe_unused]] auto result = socket->send_ack(true);
-            }
+            dbgln_if(TCP_DEBUG, "Queueing out of order packet: seq {} vs. ack {}", tcp_packet.sequence_number(), socket->ack_number());
+            if (payload_size && !tcp_packet.has_fin())
+                socket->queue_out_of_order_packet(ipv4_packet, tcp_packet, payload_size, packet_timestamp);
+            // Out of order packets are acknowledged right away, so the peer can tell what's missing (RFC 5681 section 4.2).
+            [[maybe_unused]] auto result = socket->send_ack(true);
             return;
         }
 
-        socket->set_duplicate_acks(0);
-
         if (tcp_packet.has_fin()) {
             if (payload_size != 0)
                 socket->did_receive(ipv4_packet.source(), tcp_packet.source_port(), { &ipv4_packet, sizeof(IPv4Packet) + ipv4_packet.payload_size() }, packet_timestamp);
@@ -612,13 +628,21 @@ void handle_tcp(const IPv4Packet& ipv4_packet, const Time& packet_timestamp)
                 socket->set_ack_number(tcp_packet.sequence_number() + payload_size);
                 dbgln_if(TCP_DEBUG, "Got packet with ack_no={}, seq_no={}, payload_size={}, acking it with new ack_no={}, seq_no={}",
                     tcp_packet.ack_number(), tcp_packet.sequence_number(), payload_size, socket->ack_number(), socket->sequence_number());
-                send_delayed_tcp_ack(socket);
+                // Filling a gap is acknowledged right away as well.
+                if (socket->deliver_out_of_order_packets())
+                    [[maybe_unused]] auto result = socket->send_ack();
+                else
+                    send_delayed_tcp_ack(socket);
+            } else {
+                // We had no room for it, probably because it was probing our closed
+                // window. Tell the peer where we are (RFC 9293 section 3.8.6.1).
+                [[maybe_unused]] auto result = socket->send_ack(true);
             }
         }
     }
 }
 
-void retransmit_tcp_packets()
+Time retransmit_tcp_packets()
 {
     // We must keep the sockets alive until after we've unlocked the hash table
     // in case retransmit_packets() realizes that it wants to close the socket.
@@ -629,10 +653,14 @@ void retransmit_tcp_packets()
             sockets.append(*socket);
     }
 
+    auto next_deadline = Time::max();
     for (auto& socket : sockets) {
         Locker socket_locker(socket.lock());
         socket.retransmit_packets();
+        if (auto& deadline = socket.retransmit_deadline(); !deadline.is_zero())
+            next_deadline = min(next_deadline, deadline);
     }
+    return next_deadline;
 }
 
 }
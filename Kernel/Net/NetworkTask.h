@@ -7,9 +7,16 @@
 #pragma once
 
 namespace Kernel {
+
+class IPv4Socket;
+
 class NetworkTask {
 public:
     static void spawn();
     static bool is_current();
+
+    // Readers of sockets that get data while we're handling a batch of packets
+    // are woken up once at the end of it, instead of for every packet.
+    static void defer_waking_readers(IPv4Socket&);
 };
 }
@@ -50,7 +50,7 @@ void Socket::set_setup_state(SetupState new_setup_state)
     evaluate_block_conditions();
 }
 
-RefPtr<Socket> Socket::accept()
+RefPtr<Socket> Socket::accept(const Process& acceptor)
 {
     Locker locker(m_lock);
     if (m_pending.is_empty())
@@ -58,8 +58,7 @@ RefPtr<Socket> Socket::accept()
     dbgln_if(SOCKET_DEBUG, "Socket({}) de-queueing connection", this);
     auto client = m_pending.take_first();
     VERIFY(!client->is_connected());
-    auto& process = *Process::current();
-    client->m_acceptor = { process.pid().value(), process.uid(), process.gid() };
+    client->m_acceptor = { acceptor.pid().value(), acceptor.uid(), acceptor.gid() };
     client->m_connected = true;
     client->m_role = Role::Accepted;
     if (!m_pending.is_empty())
@@ -75,7 +75,7 @@ public:
     void set_connected(bool);
 
     bool can_accept() const { return !m_pending.is_empty(); }
-    RefPtr<Socket> accept();
+    RefPtr<Socket> accept(const Process& acceptor);
 
     KResult shutdown(int how);
 
@@ -6,6 +6,8 @@
 
 #pragma once
 
+#include <AK/Optional.h>
+#include <AK/Vector.h>
 #include <Kernel/Net/IPv4.h>
 
 namespace Kernel {
@@ -21,6 +23,16 @@ struct TCPFlags {
     };
 };
 
+enum class TCPOptionKind : u8 {
+    End = 0,
+    NOP = 1,
+    MSS = 2,
+    WindowScale = 3,
+    SACKPermitted = 4,
+    SACK = 5,
+    Timestamp = 8,
+};
+
 class [[gnu::packed]] TCPOptionMSS {
 public:
     TCPOptionMSS(u16 value)
@@ -31,13 +43,85 @@ public:
     u16 value() const { return m_value; }
 
 private:
-    u8 m_option_kind { 0x02 };
+    u8 m_option_kind { (u8)TCPOptionKind::MSS };
     u8 m_option_length { sizeof(TCPOptionMSS) };
     NetworkOrdered<u16> m_value;
 };
 
 static_assert(sizeof(TCPOptionMSS) == 4);
 
+// RFC 7323 section 2
+class [[gnu::packed]] TCPOptionWindowScale {
+public:
+    TCPOptionWindowScale(u8 shift_count)
+        : m_shift_count(shift_count)
+    {
+    }
+
+    u8 shift_count() const { return m_shift_count; }
+
+private:
+    u8 m_option_kind { (u8)TCPOptionKind::WindowScale };
+    u8 m_option_length { sizeof(TCPOptionWindowScale) };
+    u8 m_shift_count { 0 };
+};
+
+static_assert(sizeof(TCPOptionWindowScale) == 3);
+
+// RFC 2018 section 2
+class [[gnu::packed]] TCPOptionSACKPermitted {
+private:
+    u8 m_option_kind { (u8)TCPOptionKind::SACKPermitted };
+    u8 m_option_length { sizeof(TCPOptionSACKPermitted) };
+};
+
+static_assert(sizeof(TCPOptionSACKPermitted) == 2);
+
+// RFC 7323 section 3
+class [[gnu::packed]] TCPOptionTimestamp {
+public:
+    TCPOptionTimestamp(u32 value, u32 echo_reply)
+        : m_value(value)
+        , m_echo_reply(echo_reply)
+    {
+    }
+
+    u32 value() const { return m_value; }
+    u32 echo_reply() const { return m_echo_reply; }
+
+private:
+    u8 m_option_kind { (u8)TCPOptionKind::Timestamp };
+    u8 m_option_length { sizeof(TCPOptionTimestamp) };
+    NetworkOrdered<u32> m_value;
+    NetworkOrdered<u32> m_echo_reply;
+};
+
+static_assert(sizeof(TCPOptionTimestamp) == 10);
+
+// A range of sequence numbers, the right edge is exclusive.
+struct TCPSACKBlock {
+    u32 left_edge { 0 };
+    u32 right_edge { 0 };
+};
+
+// Sequence numbers wrap around, so they can only be compared to nearby ones (RFC 793 section 3.3).
+constexpr bool tcp_sequence_less_than(u32 a, u32 b) { return static_cast<i32>(a - b) < 0; }
+constexpr bool tcp_sequence_less_than_or_equal(u32 a, u32 b) { return static_cast<i32>(a - b) <= 0; }
+
+// The options we understand, as found in the header of a received packet.
+struct TCPOptions {
+    // What fits into the data offset field after the fixed part of the header.
+    static constexpr size_t max_size = 40;
+    static constexpr size_t max_sack_blocks = 4;
+
+    Optional<u16> mss;
+    Optional<u8> window_scale;
+    bool sack_permitted { false };
+    Optional<u32> timestamp_value;
+    u32 timestamp_echo_reply { 0 };
+    Vector<TCPSACKBlock, max_sack_blocks> sack_blocks;
+};
+
 class [[gnu::packed]] TCPPacket {
 public:
     TCPPacket() = default;
@@ -77,6 +161,14 @@ public:
     u16 urgent() const { return m_urgent; }
     void set_urgent(u16 urgent) { m_urgent = urgent; }
 
+    ReadonlyBytes options() const
+    {
+        if (header_size() <= sizeof(TCPPacket))
+            return {};
+        return { reinterpret_cast<const u8*>(this) + sizeof(TCPPacket), header_size() - sizeof(TCPPacket) };
+    }
+    TCPOptions parse_options() const;
+
     const void* payload() const { return ((const u8*)this) + header_size(); }
     void* payload() { return ((u8*)this) + header_size(); }
 
@@ -94,4 +186,57 @@ private:
 
 static_assert(sizeof(TCPPacket) == 20);
 
+inline TCPOptions TCPPacket::parse_options() const
+{
+    TCPOptions parsed_options;
+    auto bytes = options();
+    size_t offset = 0;
+    while (offset < bytes.size()) {
+        auto kind = static_cast<TCPOptionKind>(bytes[offset]);
+        if (kind == TCPOptionKind::End)
+            break;
+        if (kind == TCPOptionKind::NOP) {
+            ++offset;
+            continue;
+        }
+        if (offset + 1 >= bytes.size())
+            break;
+        size_t length = bytes[offset + 1];
+        if (length < 2 || offset + length > bytes.size())
+            break;
+        auto* data = bytes.offset(offset + 2);
+        auto read_u16 = [&](size_t index) { return static_cast<u16>(data[index] << 8 | data[index + 1]); };
+        auto read_u32 = [&](size_t index) { return static_cast<u32>(read_u16(index)) << 16 | read_u16(index + 2); };
+
+        switch (kind) {
+        case TCPOptionKind::MSS:
+            if (length == sizeof(TCPOptionMSS))
+                parsed_options.mss = read_u16(0);
+            break;
+        case TCPOptionKind::WindowScale:
+            if (length == sizeof(TCPOptionWindowScale))
+                parsed_options.window_scale = data[0];
+            break;
+        case TCPOptionKind::SACKPermitted:
+            if (length == sizeof(TCPOptionSACKPermitted))
+                parsed_options.sack_permitted = true;
+            break;
+        case TCPOptionKind::SACK:
+            for (size_t index = 0; index + 8 <= length - 2 && parsed_options.sack_blocks.size() < TCPOptions::max_sack_blocks; index += 8)
+                parsed_options.sack_blocks.append({ read_u32(index), read_u32(index + 4) });
+            break;
+        case TCPOptionKind::Timestamp:
+            if (length == sizeof(TCPOptionTimestamp)) {
+                parsed_options.timestamp_value = read_u32(0);
+                parsed_options.timestamp_echo_reply = read_u32(4);
+            }
+            break;
+        default:
+            break;
+        }
+        offset += length;
+    }
+    return parsed_options;
+}
+
 }
@@ -0,0 +1,178 @@
+/*
+ * Copyright (c) 2021, the SerenityOS developers.
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#include <Kernel/Net/TCPCongestionControl.h>
+
+namespace Kernel {
+
+KResultOr<NonnullOwnPtr<TCPCongestionControl>> TCPCongestionControl::create(StringView name, size_t mss)
+{
+    OwnPtr<TCPCongestionControl> congestion_control;
+    if (name == "reno")
+        congestion_control = adopt_own_if_nonnull(new NewRenoCongestionControl(mss));
+    else if (name == "cubic")
+        congestion_control = adopt_own_if_nonnull(new CubicCongestionControl(mss));
+    else
+        return ENOENT;
+    if (!congestion_control)
+        return ENOMEM;
+    return congestion_control.release_nonnull();
+}
+
+static size_t initial_window(size_t mss)
+{
+    // RFC 6928 section 2
+    return min(10 * mss, max(2 * mss, static_cast<size_t>(14600)));
+}
+
+TCPCongestionControl::TCPCongestionControl(size_t mss)
+    : m_mss(mss)
+    , m_congestion_window(initial_window(mss))
+{
+}
+
+void TCPCongestionControl::set_mss(size_t mss)
+{
+    // The initial window is based on the MSS, which is only known once the handshake is done.
+    if (m_congestion_window == initial_window(m_mss))
+        m_congestion_window = initial_window(mss);
+    m_mss = mss;
+}
+
+void NewRenoCongestionControl::on_ack(size_t acked_bytes, const Time&, const Time&)
+{
+    if (is_in_slow_start()) {
+        slow_start(acked_bytes);
+        return;
+    }
+
+    // Grow by one segment per window of acknowledged data (RFC 5681 section 3.1).
+    m_bytes_acked += acked_bytes;
+    if (m_bytes_acked >= m_congestion_window) {
+        m_bytes_acked -= m_congestion_window;
+        m_congestion_window += m_mss;
+    }
+}
+
+void NewRenoCongestionControl::on_enter_recovery(size_t bytes_in_flight)
+{
+    m_slow_start_threshold = max(bytes_in_flight / 2, 2 * m_mss);
+    m_congestion_window = m_slow_start_threshold;
+    m_bytes_acked = 0;
+}
+
+void NewRenoCongestionControl::on_retransmit_timeout(size_t bytes_in_flight)
+{
+    m_slow_start_threshold = max(bytes_in_flight / 2, 2 * m_mss);
+    m_congestion_window = m_mss;
+    m_bytes_acked = 0;
+}
+
+// The constants from RFC 8312 section 5, as fractions since the kernel can't use floating point.
+static constexpr u64 cubic_beta_numerator = 7;
+static constexpr u64 cubic_beta_denominator = 10;
+// C = 0.4 segments per second cubed, or 0.4 / 10^9 segments per millisecond cubed.
+static constexpr u64 cubic_c_numerator = 2;
+static constexpr u64 cubic_c_denominator = 5'000'000'000;
+// Keeps the cube of the time in milliseconds within 64 bits.
+static constexpr i64 cubic_max_milliseconds = 1'000'000;
+
+static u64 integer_cube_root(u64 value)
+{
+    u64 low = 0;
+    u64 high = 2'642'246; // The cube root of 2^64, rounded up.
+    while (low + 1 < high) {
+        u64 middle = (low + high) / 2;
+        if (middle * middle * middle <= value)
+            low = middle;
+        else
+            high = middle;
+    }
+    return low;
+}
+
+size_t CubicCongestionControl::cubic_window(i64 milliseconds_since_epoch) const
+{
+    // W_cubic(t) = C * (t - K)^3 + W_max (RFC 8312 section 4.1)
+    i64 offset = clamp(milliseconds_since_epoch - m_k_milliseconds, -cubic_max_milliseconds, cubic_max_milliseconds);
+    u64 cube = static_cast<u64>(offset < 0 ? -offset : offset);
+    cube = cube * cube * cube;
+    // Multiply by the MSS last, so the intermediate result stays within 64 bits.
+    u64 delta = cube / (cubic_c_denominator / 1000) * cubic_c_numerator * m_mss / 1000;
+    if (offset >= 0)
+        return min(m_epoch_origin_window + delta, static_cast<u64>(NumericLimits<size_t>::max()));
+    return m_epoch_origin_window > delta ? m_epoch_origin_window - delta : m_mss;
+}
+
+void CubicCongestionControl::on_ack(size_t acked_bytes, const Time& now, const Time& smoothed_rtt)
+{
+    if (is_in_slow_start()) {
+        slow_start(acked_bytes);
+        return;
+    }
+
+    if (m_epoch_start.is_zero()) {
+        m_epoch_start = now;
+        m_epoch_start_window = m_congestion_window;
+        m_increase_accumulator = 0;
+        if (m_congestion_window < m_window_maximum) {
+            // K = cubic_root((W_max - cwnd) / C), in milliseconds.
+            u64 missing_segments_scaled = static_cast<u64>(m_window_maximum - m_congestion_window) * cubic_c_denominator / m_mss;
+            m_k_milliseconds = integer_cube_root(missing_segments_scaled / cubic_c_numerator);
+            m_epoch_origin_window = m_window_maximum;
+        } else {
+            m_k_milliseconds = 0;
+            m_epoch_origin_window = m_congestion_window;
+        }
+    }
+
+    i64 rtt_milliseconds = max(smoothed_rtt.to_milliseconds(), static_cast<i64>(1));
+    i64 milliseconds_since_epoch = (now - m_epoch_start).to_milliseconds();
+    size_t target = cubic_window(milliseconds_since_epoch + rtt_milliseconds);
+
+    // Don't grow slower than Reno would (RFC 8312 section 4.2):
+    // W_est(t) = W_max * beta + 3 * (1 - beta) / (1 + beta) * t / RTT
+    u64 reno_friendly_window = m_epoch_start_window + static_cast<u64>(m_mss) * 9 * milliseconds_since_epoch / (17 * rtt_milliseconds);
+    target = max(target, static_cast<size_t>(min(reno_friendly_window, static_cast<u64>(NumericLimits<size_t>::max()))));
+    // Don't grow by more than half the window within one round trip.
+    target = min(target, m_congestion_window + m_congestion_window / 2);
+
+    // Grow by (target - cwnd) / cwnd segments for each segment acknowledged. If we're
+    // above the target already, creep upwards very slowly like Linux does.
+    u64 increase = target > m_congestion_window ? target - m_congestion_window : m_mss / 100;
+    m_increase_accumulator += acked_bytes * increase;
+    m_congestion_window += m_increase_accumulator / m_congestion_window;
+    m_increase_accumulator %= m_congestion_window;
+}
+
+void CubicCongestionControl::reduce_window_maximum()
+{
+    // Fast convergence (RFC 8312 section 4.6): if the window didn't get back
+    // to where it was at the last loss, someone else needs the bandwidth.
+    if (m_congestion_window < m_last_window_maximum) {
+        m_last_window_maximum = m_congestion_window;
+        m_window_maximum = m_congestion_window * (cubic_beta_denominator + cubic_beta_numerator) / (2 * cubic_beta_denominator);
+    } else {
+        m_last_window_maximum = m_congestion_window;
+        m_window_maximum = m_congestion_window;
+    }
+    m_epoch_start = {};
+    m_slow_start_threshold = max(static_cast<size_t>(m_congestion_window * cubic_beta_numerator / cubic_beta_denominator), 2 * m_mss);
+}
+
+void CubicCongestionControl::on_enter_recovery(size_t)
+{
+    reduce_window_maximum();
+    m_congestion_window = m_slow_start_threshold;
+}
+
+void CubicCongestionControl::on_retransmit_timeout(size_t)
+{
+    reduce_window_maximum();
+    m_congestion_window = m_mss;
+}
+
+}
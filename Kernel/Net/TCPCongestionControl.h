@@ -0,0 +1,109 @@
+/*
+ * Copyright (c) 2021, the SerenityOS developers.
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#pragma once
+
+#include <AK/OwnPtr.h>
+#include <AK/StringView.h>
+#include <AK/Time.h>
+#include <AK/Types.h>
+#include <Kernel/KResult.h>
+
+namespace Kernel {
+
+// Decides how much unacknowledged data a TCP connection may have in flight.
+// The socket takes care of detecting loss and retransmitting, and tells the
+// controller about it through the on_*() callbacks.
+class TCPCongestionControl {
+    AK_MAKE_NONCOPYABLE(TCPCongestionControl);
+    AK_MAKE_NONMOVABLE(TCPCongestionControl);
+
+public:
+    static constexpr StringView default_algorithm = "cubic";
+
+    // Fails with ENOENT for unknown algorithms, like Linux does.
+    static KResultOr<NonnullOwnPtr<TCPCongestionControl>> create(StringView name, size_t mss);
+
+    virtual ~TCPCongestionControl() = default;
+
+    virtual StringView name() const = 0;
+
+    size_t congestion_window() const { return m_congestion_window; }
+    size_t slow_start_threshold() const { return m_slow_start_threshold; }
+    bool is_in_slow_start() const { return m_congestion_window < m_slow_start_threshold; }
+
+    size_t mss() const { return m_mss; }
+    void set_mss(size_t mss);
+
+    // Called for ACKs that acknowledge new data while not recovering from a loss.
+    virtual void on_ack(size_t acked_bytes, const Time& now, const Time& smoothed_rtt) = 0;
+    // Called when a loss was detected through duplicate ACKs (RFC 5681 section 3.2).
+    virtual void on_enter_recovery(size_t bytes_in_flight) = 0;
+    virtual void on_exit_recovery() { m_congestion_window = m_slow_start_threshold; }
+    virtual void on_retransmit_timeout(size_t bytes_in_flight) = 0;
+
+protected:
+    explicit TCPCongestionControl(size_t mss);
+
+    // RFC 5681 section 3.1, with the increase limited as described in RFC 3465.
+    void slow_start(size_t acked_bytes) { m_congestion_window += min(acked_bytes, 2 * m_mss); }
+
+    size_t m_mss { 0 };
+    size_t m_congestion_window { 0 };
+    size_t m_slow_start_threshold { NumericLimits<size_t>::max() };
+};
+
+// RFC 5681 and RFC 6582
+class NewRenoCongestionControl final : public TCPCongestionControl {
+public:
+    explicit NewRenoCongestionControl(size_t mss)
+        : TCPCongestionControl(mss)
+    {
+    }
+
+    virtual StringView name() const override { return "reno"; }
+
+    virtual void on_ack(size_t acked_bytes, const Time& now, const Time& smoothed_rtt) override;
+    virtual void on_enter_recovery(size_t bytes_in_flight) override;
+    virtual void on_retransmit_timeout(size_t bytes_in_flight) override;
+
+private:
+    size_t m_bytes_acked { 0 };
+};
+
+// RFC 8312. The window is grown along a cubic function of the time since the
+// last loss, which makes it recover quickly on links with a large
+// bandwidth-delay product while staying fair to Reno flows on short ones.
+class CubicCongestionControl final : public TCPCongestionControl {
+public:
+    explicit CubicCongestionControl(size_t mss)
+        : TCPCongestionControl(mss)
+    {
+    }
+
+    virtual StringView name() const override { return "cubic"; }
+
+    virtual void on_ack(size_t acked_bytes, const Time& now, const Time& smoothed_rtt) override;
+    virtual void on_enter_recovery(size_t bytes_in_flight) override;
+    virtual void on_retransmit_timeout(size_t bytes_in_flight) override;
+
+private:
+    void reduce_window_maximum();
+    size_t cubic_window(i64 milliseconds_since_epoch) const;
+
+    // The window right before the last reduction (W_max in the RFC).
+    size_t m_window_maximum { 0 };
+    size_t m_last_window_maximum { 0 };
+
+    // The start of the current congestion avoidance epoch, or zero if there is none.
+    Time m_epoch_start;
+    size_t m_epoch_origin_window { 0 };
+    size_t m_epoch_start_window { 0 };
+    i64 m_k_milliseconds { 0 };
+    u64 m_increase_accumulator { 0 };
+};
+
+}
@@ -4,6 +4,7 @@
  * SPDX-License-Identifier: BSD-2-Clause
  */
 
+#include <AK/Array.h>
 #include <AK/Singleton.h>
 #include <AK/Time.h>
 #include <Kernel/Debug.h>
@@ -18,6 +19,7 @@
 #include <Kernel/Net/TCPSocket.h>
 #include <Kernel/Process.h>
 #include <Kernel/Random.h>
+#include <Kernel/Time/TimeManagement.h>
 
 namespace Kernel {
 
@@ -108,6 +110,10 @@ RefPtr<TCPSocket> TCPSocket::create_client(const IPv4Address& new_local_address,
     client->set_peer_port(new_peer_port);
     client->set_direction(Direction::Incoming);
     client->set_originator(*this);
+    if (client->congestion_control_name() != congestion_control_name()) {
+        if (client->set_congestion_control(congestion_control_name()).is_error())
+            return {};
+    }
 
     Locker locker(sockets_by_tuple().lock());
     m_pending_release_for_accept.set(tuple, client);
@@ -131,10 +137,10 @@ void TCPSocket::release_for_accept(RefPtr<TCPSocket> socket)
     [[maybe_unused]] auto rc = queue_connection_from(*socket);
 }
 
-TCPSocket::TCPSocket(int protocol)
+TCPSocket::TCPSocket(int protocol, NonnullOwnPtr<TCPCongestionControl> congestion_control)
     : IPv4Socket(SOCK_STREAM, protocol)
+    , m_congestion_control(move(congestion_control))
 {
-    m_last_retransmit_time = kgettimeofday();
 }
 
 TCPSocket::~TCPSocket()
@@ -149,12 +155,25 @@ TCPSocket::~TCPSocket()
 
 KResultOr<NonnullRefPtr<TCPSocket>> TCPSocket::create(int protocol)
 {
-    auto socket = adopt_ref_if_nonnull(new TCPSocket(protocol));
+    auto congestion_control_or_error = TCPCongestionControl::create(TCPCongestionControl::default_algorithm, default_peer_mss);
+    if (congestion_control_or_error.is_error())
+        return congestion_control_or_error.error();
+    auto socket = adopt_ref_if_nonnull(new TCPSocket(protocol, congestion_control_or_error.release_value()));
     if (socket)
         return socket.release_nonnull();
     return ENOMEM;
 }
 
+KResult TCPSocket::set_congestion_control(StringView name)
+{
+    auto congestion_control_or_error = TCPCongestionControl::create(name, m_congestion_control->mss());
+    if (congestion_control_or_error.is_error())
+        return congestion_control_or_error.error();
+    Locker locker(m_not_acked_lock);
+    m_congestion_control = congestion_control_or_error.release_value();
+    return KSuccess;
+}
+
 KResultOr<size_t> TCPSocket::protocol_receive(ReadonlyBytes raw_ipv4_packet, UserOrKernelBuffer& buffer, size_t buffer_size, [[maybe_unused]] int flags)
 {
     auto& ipv4_packet = *reinterpret_cast<const IPv4Packet*>(raw_ipv4_packet.data());
@@ -167,13 +186,138 @@ KResultOr<size_t> TCPSocket::protocol_receive(ReadonlyBytes raw_ipv4_packet, Use
     return payload_size;
 }
 
+static u32 timestamp_now()
+{
+    // RFC 7323 section 5.4 asks for a clock that ticks between once a millisecond and once a second.
+    return static_cast<u32>(TimeManagement::the().monotonic_time().to_milliseconds());
+}
+
+size_t TCPSocket::maximum_segment_size(const NetworkAdapter& adapter) const
+{
+    size_t mss = min(static_cast<size_t>(adapter.mtu() - sizeof(IPv4Packet) - sizeof(TCPPacket)), static_cast<size_t>(m_peer_mss));
+    // The MSS doesn't account for options, so leave room for the ones that go into every segment (RFC 6691).
+    if (m_timestamps_enabled)
+        mss -= sizeof(TCPOptionTimestamp) + 2;
+    return mss;
+}
+
+u8 TCPSocket::receive_window_shift_to_offer() const
+{
+    u8 shift = 0;
+    while (shift < 14 && (static_cast<size_t>(NumericLimits<u16>::max()) << shift) < receive_buffer_size)
+        ++shift;
+    return shift;
+}
+
+size_t TCPSocket::receive_window() const
+{
+    // Leave room for the headers, since did_receive() counts those against the receive buffer too.
+    constexpr size_t header_room = sizeof(IPv4Packet) + 15 * sizeof(u32);
+    auto space = receive_buffer_space();
+    return space > header_room ? space - header_room : 0;
+}
+
+u16 TCPSocket::window_to_advertise(bool is_syn)
+{
+    // The window in a SYN is never scaled (RFC 7323 section 2.2).
+    u8 shift = is_syn ? 0 : m_receive_window_shift;
+    size_t window = min(receive_window() >> shift, static_cast<size_t>(NumericLimits<u16>::max()));
+    m_last_advertised_window = window << shift;
+    return window;
+}
+
+size_t TCPSocket::build_options(u16 flags, const NetworkAdapter& adapter, size_t payload_size, Bytes options)
+{
+    size_t offset = 0;
+    auto append = [&](const auto& option) {
+        memcpy(options.offset(offset), &option, sizeof(option));
+        offset += sizeof(option);
+    };
+    auto append_nops = [&](size_t count) {
+        memset(options.offset(offset), (u8)TCPOptionKind::NOP, count);
+        offset += count;
+    };
+
+    if (flags & TCPFlags::SYN) {
+        // A SYN offers everything we support, the answer to one only what the peer offered.
+        bool is_offer = !(flags & TCPFlags::ACK);
+        append(TCPOptionMSS { static_cast<u16>(adapter.mtu() - sizeof(IPv4Packet) - sizeof(TCPPacket)) });
+        if (is_offer || m_sack_permitted)
+            append(TCPOptionSACKPermitted {});
+        if (is_offer || m_timestamps_enabled)
+            append(TCPOptionTimestamp { timestamp_now(), m_timestamp_recent });
+        if (is_offer || m_window_scaling_enabled) {
+            append_nops(1);
+            append(TCPOptionWindowScale { is_offer ? receive_window_shift_to_offer() : m_receive_window_shift });
+        }
+    } else {
+        if (m_timestamps_enabled) {
+            append_nops(2);
+            append(TCPOptionTimestamp { timestamp_now(), m_timestamp_recent });
+        }
+        if (m_sack_permitted && (flags & TCPFlags::ACK) && !m_out_of_order_packets.is_empty()) {
+            // Only use the space the payload leaves us, so the packet still fits into the MTU.
+            size_t space = min(options.size(), static_cast<size_t>(adapter.mtu() - sizeof(IPv4Packet) - sizeof(TCPPacket) - payload_size));
+            auto blocks = sack_blocks();
+            size_t block_count = 0;
+            while (block_count < blocks.size() && offset + 4 + (block_count + 1) * 2 * sizeof(u32) <= space)
+                ++block_count;
+            if (block_count > 0) {
+                append_nops(2);
+                options[offset++] = (u8)TCPOptionKind::SACK;
+                options[offset++] = 2 + block_count * 2 * sizeof(u32);
+                for (size_t i = 0; i < block_count; ++i) {
+                    append(NetworkOrdered<u32>(blocks[i].left_edge));
+                    append(NetworkOrdered<u32>(blocks[i].right_edge));
+                }
+            }
+        }
+    }
+
+    while (offset % sizeof(u32))
+        append_nops(1);
+    return offset;
+}
+
+void TCPSocket::negotiate_options(const TCPPacket& syn_packet)
+{
+    auto options = syn_packet.parse_options();
+    m_peer_mss = options.mss.value_or(default_peer_mss);
+
+    // Each of these is only used if both sides asked for it.
+    m_window_scaling_enabled = options.window_scale.has_value();
+    if (m_window_scaling_enabled) {
+        m_send_window_shift = min(options.window_scale.value(), static_cast<u8>(14));
+        m_receive_window_shift = receive_window_shift_to_offer();
+    } else {
+        m_send_window_shift = 0;
+        m_receive_window_shift = 0;
+    }
+    m_sack_permitted = options.sack_permitted;
+    m_timestamps_enabled = options.timestamp_value.has_value();
+    if (m_timestamps_enabled)
+        m_timestamp_recent = options.timestamp_value.value();
+
+    auto routing_decision = route_to(peer_address(), local_address(), bound_interface());
+    if (!routing_decision.is_zero())
+        m_congestion_control->set_mss(maximum_segment_size(*routing_decision.adapter));
+}
+
 KResultOr<size_t> TCPSocket::protocol_send(const UserOrKernelBuffer& data, size_t data_length)
 {
     RoutingDecision routing_decision = route_to(peer_address(), local_address(), bound_interface());
     if (routing_decision.is_zero())
         return EHOSTUNREACH;
-    size_t mss = routing_decision.adapter->mtu() - sizeof(IPv4Packet) - sizeof(TCPPacket);
-    data_length = min(data_length, mss);
+    data_length = min(data_length, maximum_segment_size(*routing_decision.adapter));
+    {
+        Locker locker(m_not_acked_lock);
+        data_length = min(data_length, send_window_available());
+        // If a window probe was due, this is it.
+        if (data_length > 0)
+            m_window_probe_due = false;
+    }
+    if (data_length == 0)
+        return EAGAIN;
     int err = send_tcp_packet(TCPFlags::PUSH | TCPFlags::ACK, &data, data_length, &routing_decision);
     if (err < 0)
         return KResult((ErrnoCode)-err);
@@ -195,8 +339,8 @@ KResult TCPSocket::send_tcp_packet(u16 flags, const UserOrKernelBuffer* payload,
 
     auto ipv4_payload_offset = routing_decision.adapter->ipv4_payload_offset();
 
-    const bool has_mss_option = flags == TCPFlags::SYN;
-    const size_t options_size = has_mss_option ? sizeof(TCPOptionMSS) : 0;
+    Array<u8, TCPOptions::max_size> options;
+    const size_t options_size = build_options(flags, *routing_decision.adapter, payload_size, options.span());
     const size_t tcp_header_size = sizeof(TCPPacket) + options_size;
     const size_t buffer_size = ipv4_payload_offset + tcp_header_size + payload_size;
     auto packet = routing_decision.adapter->acquire_packet_buffer(buffer_size);
@@ -210,7 +354,7 @@ KResult TCPSocket::send_tcp_packet(u16 flags, const UserOrKernelBuffer* payload,
     VERIFY(local_port());
     tcp_packet.set_source_port(local_port());
     tcp_packet.set_destination_port(peer_port());
-    tcp_packet.set_window_size(NumericLimits<u16>::max());
+    tcp_packet.set_window_size(window_to_advertise(flags & TCPFlags::SYN));
     tcp_packet.set_sequence_number(m_sequence_number);
     tcp_packet.set_data_offset(tcp_header_size / sizeof(u32));
     tcp_packet.set_flags(flags);
@@ -226,18 +370,15 @@ KResult TCPSocket::send_tcp_packet(u16 flags, const UserOrKernelBuffer* payload,
         return EFAULT;
     }
 
+    u32 sequence_number = m_sequence_number;
     if (flags & TCPFlags::SYN) {
         ++m_sequence_number;
     } else {
         m_sequence_number += payload_size;
     }
 
-    if (has_mss_option) {
-        u16 mss = routing_decision.adapter->mtu() - sizeof(IPv4Packet) - sizeof(TCPPacket);
-        TCPOptionMSS mss_option { mss };
-        VERIFY(packet->buffer.size() >= ipv4_payload_offset + sizeof(TCPPacket) + sizeof(mss_option));
-        memcpy(packet->buffer.data() + ipv4_payload_offset + sizeof(TCPPacket), &mss_option, sizeof(mss_option));
-    }
+    VERIFY(packet->buffer.size() >= ipv4_payload_offset + tcp_header_size);
+    memcpy(packet->buffer.data() + ipv4_payload_offset + sizeof(TCPPacket), options.data(), options_size);
 
     tcp_packet.set_checksum(compute_tcp_checksum(local_address(), peer_address(), tcp_packet, payload_size));
 
@@ -246,9 +387,13 @@ KResult TCPSocket::send_tcp_packet(u16 flags, const UserOrKernelBuffer* payload,
     m_packets_out++;
     m_bytes_out += buffer_size;
     if (tcp_packet.has_syn() || payload_size > 0) {
+        auto now = TimeManagement::the().monotonic_time();
         Locker locker(m_not_acked_lock);
-        m_not_acked.append({ m_sequence_number, move(packet), ipv4_payload_offset, *routing_decision.adapter });
+        m_not_acked.append({ m_sequence_number, move(packet), ipv4_payload_offset, *routing_decision.adapter, 0, sequence_number, payload_size, now });
         m_not_acked_size += payload_size;
+        // RFC 6298 section 5.1
+        if (m_retransmit_deadline.is_zero())
+            m_retransmit_deadline = now + m_retransmit_timeout;
         enqueue_for_retransmit();
     } else {
         routing_decision.adapter->release_packet_buffer(*packet);
@@ -259,43 +404,340 @@ KResult TCPSocket::send_tcp_packet(u16 flags, const UserOrKernelBuffer* payload,
 
 void TCPSocket::receive_tcp_packet(const TCPPacket& packet, u16 size)
 {
-    if (packet.has_ack()) {
-        u32 ack_number = packet.ack_number();
+    auto options = packet.parse_options();
+    if (packet.has_syn() && m_state == State::SynSent)
+        negotiate_options(packet);
 
-        dbgln_if(TCP_SOCKET_DEBUG, "TCPSocket: receive_tcp_packet: {}", ack_number);
+    // RFC 7323 section 4.3
+    if (m_timestamps_enabled && options.timestamp_value.has_value()
+        && tcp_sequence_less_than_or_equal(packet.sequence_number(), m_last_ack_number_sent)
+        && tcp_sequence_less_than_or_equal(m_timestamp_recent, options.timestamp_value.value()))
+        m_timestamp_recent = options.timestamp_value.value();
+
+    if (packet.has_ack()) {
+        u32 window_size = packet.window_size();
+        if (!packet.has_syn())
+            window_size <<= m_send_window_shift;
 
-        int removed = 0;
         Locker locker(m_not_acked_lock);
-        while (!m_not_acked.is_empty()) {
-            auto& packet = m_not_acked.first();
-
-            dbgln_if(TCP_SOCKET_DEBUG, "TCPSocket: iterate: {}", packet.ack_number);
-
-            if (packet.ack_number <= ack_number) {
-                auto old_adapter = packet.adapter.strong_ref();
-                if (old_adapter)
-                    old_adapter->release_packet_buffer(*packet.buffer);
-                TCPPacket& tcp_packet = *(TCPPacket*)(packet.buffer->buffer.data() + packet.ipv4_payload_offset);
-                auto payload_size = packet.buffer->buffer.data() + packet.buffer->buffer.size() - (u8*)tcp_packet.payload();
-                m_not_acked_size -= payload_size;
-                evaluate_block_conditions();
-                m_not_acked.take_first();
-                removed++;
-            } else {
-                break;
-            }
+        bool window_changed = window_size != m_send_window_size;
+        m_send_window_size = window_size;
+        process_ack(packet, options, size - packet.header_size(), window_changed);
+    }
+
+    m_packets_in++;
+    m_bytes_in += packet.header_size() + size;
+}
+
+void TCPSocket::process_ack(const TCPPacket& packet, const TCPOptions& options, size_t payload_size, bool window_changed)
+{
+    VERIFY(m_not_acked_lock.is_locked());
+    u32 ack_number = packet.ack_number();
+    auto now = TimeManagement::the().monotonic_time();
+
+    dbgln_if(TCP_SOCKET_DEBUG, "TCPSocket: receive_tcp_packet: {}", ack_number);
+
+    // RFC 5681 section 2
+    bool is_duplicate = !m_not_acked.is_empty() && ack_number == m_not_acked.first().sequence_number
+        && payload_size == 0 && !packet.has_syn() && !packet.has_fin() && !window_changed && m_send_window_size != 0;
+
+    int removed = 0;
+    size_t acked_bytes = 0;
+    Optional<Time> rtt_sample;
+    while (!m_not_acked.is_empty()) {
+        auto& packet = m_not_acked.first();
+
+        dbgln_if(TCP_SOCKET_DEBUG, "TCPSocket: iterate: {}", packet.ack_number);
+
+        if (!tcp_sequence_less_than_or_equal(packet.ack_number, ack_number))
+            break;
+
+        // Karn's algorithm: we can't tell which transmission of a retransmitted packet this is for.
+        if (packet.tx_counter == 0)
+            rtt_sample = now - packet.sent_time;
+        auto old_adapter = packet.adapter.strong_ref();
+        if (old_adapter)
+            old_adapter->release_packet_buffer(*packet.buffer);
+        m_not_acked_size -= packet.payload_size;
+        if (packet.sacked)
+            m_sacked_size -= packet.payload_size;
+        acked_bytes += packet.payload_size;
+        m_not_acked.take_first();
+        removed++;
+    }
+
+    // Timestamps let us time retransmitted packets too (RFC 7323 section 4.1).
+    if (!rtt_sample.has_value() && removed > 0 && m_timestamps_enabled && options.timestamp_echo_reply != 0)
+        rtt_sample = Time::from_milliseconds(static_cast<u32>(timestamp_now() - options.timestamp_echo_reply));
+
+    if (m_sack_permitted)
+        process_sack_blocks(options);
+
+    if (removed > 0) {
+        m_duplicate_acks = 0;
+        m_retransmit_attempts = 0;
+        if (rtt_sample.has_value())
+            update_rtt(rtt_sample.value());
+
+        if (!m_in_recovery) {
+            m_congestion_control->on_ack(acked_bytes, now, m_smoothed_rtt);
+        } else if (tcp_sequence_less_than_or_equal(m_recovery_point, ack_number)) {
+            m_in_recovery = false;
+            if (!m_recovering_from_timeout)
+                m_congestion_control->on_exit_recovery();
+        } else {
+            // A partial ACK means the packet after the one we retransmitted got lost too (RFC 6582 section 3.2).
+            if (m_recovering_from_timeout)
+                m_congestion_control->on_ack(acked_bytes, now, m_smoothed_rtt);
+            retransmit_lost_packets();
         }
 
+        // RFC 6298 section 5.2 and 5.3
         if (m_not_acked.is_empty()) {
-            m_retransmit_attempts = 0;
+            m_retransmit_deadline = {};
+            dequeue_for_retransmit();
+        } else {
+            m_retransmit_deadline = now + m_retransmit_timeout;
+        }
+        evaluate_block_conditions();
+    } else if (is_duplicate) {
+        ++m_duplicate_acks;
+        // With SACK, the peer tells us directly how much arrived after the hole (RFC 6675 section 5).
+        bool is_lost = m_duplicate_acks >= duplicate_ack_threshold || m_sacked_size >= duplicate_ack_threshold * m_congestion_control->mss();
+        if (!m_in_recovery && is_lost)
+            enter_recovery(false);
+        else if (m_in_recovery && m_sack_permitted)
+            retransmit_lost_packets();
+    } else if (window_changed) {
+        evaluate_block_conditions();
+    }
+
+    if (is_send_window_closed()) {
+        // The peer is still answering, so keep probing for as long as its window stays closed.
+        m_retransmit_attempts = 0;
+        if (m_retransmit_deadline.is_zero() && !m_window_probe_due) {
+            m_retransmit_deadline = now + m_retransmit_timeout;
+            enqueue_for_retransmit();
+        }
+    } else if (m_not_acked.is_empty()) {
+        m_window_probe_due = false;
+        if (!m_retransmit_deadline.is_zero()) {
+            m_retransmit_deadline = {};
             dequeue_for_retransmit();
         }
+    }
+
+    dbgln_if(TCP_SOCKET_DEBUG, "TCPSocket: receive_tcp_packet acknowledged {} packets", removed);
+}
 
-        dbgln_if(TCP_SOCKET_DEBUG, "TCPSocket: receive_tcp_packet acknowledged {} packets", removed);
+void TCPSocket::process_sack_blocks(const TCPOptions& options)
+{
+    VERIFY(m_not_acked_lock.is_locked());
+    for (auto& block : options.sack_blocks) {
+        if (!tcp_sequence_less_than(block.left_edge, block.right_edge))
+            continue;
+        for (auto& packet : m_not_acked) {
+            if (packet.sacked || packet.payload_size == 0)
+                continue;
+            if (!tcp_sequence_less_than_or_equal(block.left_edge, packet.sequence_number) || !tcp_sequence_less_than_or_equal(packet.ack_number, block.right_edge))
+                continue;
+            if (m_sacked_size == 0 || tcp_sequence_less_than(m_highest_sacked_sequence, packet.ack_number))
+                m_highest_sacked_sequence = packet.ack_number;
+            packet.sacked = true;
+            m_sacked_size += packet.payload_size;
+        }
     }
+}
 
-    m_packets_in++;
-    m_bytes_in += packet.header_size() + size;
+void TCPSocket::update_rtt(const Time& sample)
+{
+    // RFC 6298 section 2
+    if (!m_has_rtt_sample) {
+        m_smoothed_rtt = sample;
+        m_rtt_variance = Time::from_microseconds(sample.to_microseconds() / 2);
+        m_has_rtt_sample = true;
+    } else {
+        i64 smoothed_rtt = m_smoothed_rtt.to_microseconds();
+        i64 rtt = sample.to_microseconds();
+        i64 deviation = smoothed_rtt > rtt ? smoothed_rtt - rtt : rtt - smoothed_rtt;
+        m_rtt_variance = Time::from_microseconds((3 * m_rtt_variance.to_microseconds() + deviation) / 4);
+        m_smoothed_rtt = Time::from_microseconds((7 * smoothed_rtt + rtt) / 8);
+    }
+
+    // The clock granularity is that of our timestamps.
+    auto variance_term = max(Time::from_milliseconds(1), Time::from_microseconds(4 * m_rtt_variance.to_microseconds()));
+    m_retransmit_timeout = clamp(m_smoothed_rtt + variance_term, minimum_retransmit_timeout, maximum_retransmit_timeout);
+}
+
+void TCPSocket::enter_recovery(bool after_timeout)
+{
+    VERIFY(m_not_acked_lock.is_locked());
+    dbgln_if(TCP_SOCKET_DEBUG, "TCPSocket({}) entering loss recovery, after_timeout={}", this, after_timeout);
+
+    m_in_recovery = true;
+    m_recovering_from_timeout = after_timeout;
+    m_recovery_point = m_sequence_number;
+    for (auto& packet : m_not_acked)
+        packet.retransmitted_during_recovery = false;
+
+    if (after_timeout) {
+        m_congestion_control->on_retransmit_timeout(m_not_acked_size);
+        // The peer is allowed to drop data it told us about, so after a timeout
+        // we can't rely on what it said anymore (RFC 2018 section 8).
+        for (auto& packet : m_not_acked)
+            packet.sacked = false;
+        m_sacked_size = 0;
+    } else {
+        m_congestion_control->on_enter_recovery(m_not_acked_size);
+    }
+
+    retransmit_lost_packets();
+}
+
+void TCPSocket::retransmit_lost_packets()
+{
+    VERIFY(m_not_acked_lock.is_locked());
+    auto routing_decision = route_to(peer_address(), local_address(), bound_interface());
+    if (routing_decision.is_zero())
+        return;
+
+    // The first unacknowledged packet is lost by the time we get here. With SACK, so is every
+    // packet below one the peer did get (RFC 6675 section 4), as far as the congestion window allows.
+    size_t in_flight = m_not_acked_size - m_sacked_size;
+    bool is_first = true;
+    for (auto& packet : m_not_acked) {
+        if (!is_first) {
+            if (m_sacked_size == 0 || !tcp_sequence_less_than(packet.sequence_number, m_highest_sacked_sequence))
+                break;
+            if (in_flight >= m_congestion_control->congestion_window())
+                break;
+        }
+        is_first = false;
+        if (packet.sacked || packet.retransmitted_during_recovery)
+            continue;
+        packet.retransmitted_during_recovery = true;
+        retransmit_packet(packet, routing_decision);
+        in_flight += packet.payload_size;
+    }
+}
+
+void TCPSocket::retransmit_packet(OutgoingPacket& packet, RoutingDecision& routing_decision)
+{
+    packet.tx_counter++;
+
+    if constexpr (TCP_SOCKET_DEBUG) {
+        auto& tcp_packet = *(const TCPPacket*)(packet.buffer->buffer.data() + packet.ipv4_payload_offset);
+        dbgln("Sending TCP packet from {}:{} to {}:{} with ({}{}{}{}) seq_no={}, ack_no={}, tx_counter={}",
+            local_address(), local_port(),
+            peer_address(), peer_port(),
+            (tcp_packet.has_syn() ? "SYN " : ""),
+            (tcp_packet.has_ack() ? "ACK " : ""),
+            (tcp_packet.has_fin() ? "FIN " : ""),
+            (tcp_packet.has_rst() ? "RST " : ""),
+            tcp_packet.sequence_number(),
+            tcp_packet.ack_number(),
+            packet.tx_counter);
+    }
+
+    size_t ipv4_payload_offset = routing_decision.adapter->ipv4_payload_offset();
+    if (ipv4_payload_offset != packet.ipv4_payload_offset) {
+        // FIXME: Add support for this. This can happen if after a route change
+        // we ended up on another adapter which doesn't have the same layer 2 type
+        // like the previous adapter.
+        VERIFY_NOT_REACHED();
+    }
+    routing_decision.adapter->fill_in_ipv4_header(*packet.buffer,
+        local_address(), routing_decision.next_hop, peer_address(),
+        IPv4Protocol::TCP, packet.buffer->buffer.size() - ipv4_payload_offset, ttl());
+    routing_decision.adapter->send_packet({ packet.buffer->buffer.data(), packet.buffer->buffer.size() });
+    m_packets_out++;
+    m_bytes_out += packet.buffer->buffer.size();
+}
+
+void TCPSocket::queue_out_of_order_packet(const IPv4Packet& ipv4_packet, const TCPPacket& tcp_packet, size_t payload_size, const Time& packet_timestamp)
+{
+    // Only keep what fits into the window we offered, anything else is the
+    // peer misbehaving (RFC 9293 section 3.10.7.4).
+    u32 sequence_number = tcp_packet.sequence_number();
+    u32 end_sequence_number = sequence_number + static_cast<u32>(payload_size);
+    if (!tcp_sequence_less_than(m_ack_number, sequence_number))
+        return;
+    if (tcp_sequence_less_than(m_ack_number + static_cast<u32>(m_last_advertised_window), end_sequence_number))
+        return;
+
+    // The queue is limited by what it actually takes up, headers included,
+    // so that lots of tiny segments can't pin more memory than a few big ones.
+    size_t packet_size = sizeof(IPv4Packet) + ipv4_packet.payload_size();
+    if (m_out_of_order_packets.size() >= max_out_of_order_packets || m_out_of_order_size + packet_size > receive_buffer_size)
+        return;
+
+    size_t lower = 0;
+    size_t upper = m_out_of_order_packets.size();
+    while (lower < upper) {
+        size_t middle = lower + (upper - lower) / 2;
+        if (tcp_sequence_less_than(m_out_of_order_packets[middle].sequence_number, sequence_number))
+            lower = middle + 1;
+        else
+            upper = middle;
+    }
+    size_t index = lower;
+    m_latest_out_of_order_sequence = sequence_number;
+    if (index < m_out_of_order_packets.size() && m_out_of_order_packets[index].sequence_number == sequence_number)
+        return;
+
+    m_out_of_order_packets.insert(index, { sequence_number, end_sequence_number, ByteBuffer::copy(&ipv4_packet, packet_size), packet_timestamp });
+    m_out_of_order_size += packet_size;
+}
+
+bool TCPSocket::deliver_out_of_order_packets()
+{
+    bool did_deliver = false;
+    while (!m_out_of_order_packets.is_empty()) {
+        auto& packet = m_out_of_order_packets.first();
+        if (tcp_sequence_less_than(m_ack_number, packet.sequence_number))
+            break;
+        // Packets that overlap what we have already can't be split, so they are dropped.
+        if (packet.sequence_number == m_ack_number) {
+            if (!did_receive(peer_address(), peer_port(), packet.ipv4_packet.bytes(), packet.timestamp))
+                break;
+            m_ack_number = packet.end_sequence_number;
+            did_deliver = true;
+        }
+        m_out_of_order_size -= packet.ipv4_packet.size();
+        m_out_of_order_packets.take_first();
+    }
+    return did_deliver;
+}
+
+Vector<TCPSACKBlock, TCPOptions::max_sack_blocks> TCPSocket::sack_blocks() const
+{
+    Vector<TCPSACKBlock, 16> ranges;
+    for (auto& packet : m_out_of_order_packets) {
+        if (!ranges.is_empty() && !tcp_sequence_less_than(ranges.last().right_edge, packet.sequence_number)) {
+            if (tcp_sequence_less_than(ranges.last().right_edge, packet.end_sequence_number))
+                ranges.last().right_edge = packet.end_sequence_number;
+            continue;
+        }
+        ranges.append({ packet.sequence_number, packet.end_sequence_number });
+    }
+
+    // The block with the latest packet goes first, so the peer learns about it even if it
+    // misses some of our ACKs (RFC 2018 section 4).
+    Vector<TCPSACKBlock, TCPOptions::max_sack_blocks> blocks;
+    for (size_t i = 0; i < ranges.size(); ++i) {
+        auto& range = ranges[i];
+        if (tcp_sequence_less_than_or_equal(range.left_edge, m_latest_out_of_order_sequence) && tcp_sequence_less_than(m_latest_out_of_order_sequence, range.right_edge)) {
+            blocks.append(range);
+            ranges.remove(i);
+            break;
+        }
+    }
+    for (auto& range : ranges) {
+        if (blocks.size() == TCPOptions::max_sack_blocks)
+            break;
+        blocks.append(range);
+    }
+    return blocks;
 }
 
 bool TCPSocket::should_delay_next_ack() const
@@ -518,65 +960,86 @@ void TCPSocket::dequeue_for_retransmit()
 
 void TCPSocket::retransmit_packets()
 {
-    auto now = kgettimeofday();
-
-    // RFC6298 says we should have at least one second between retransmits. According to
-    // RFC1122 we must do exponential backoff - even for SYN packets.
-    i64 retransmit_interval = 1;
-    for (decltype(m_retransmit_attempts) i = 0; i < m_retransmit_attempts; i++)
-        retransmit_interval *= 2;
-
-    if (m_last_retransmit_time > now - Time::from_seconds(retransmit_interval))
+    auto now = TimeManagement::the().monotonic_time();
+    if (m_retransmit_deadline.is_zero() || now < m_retransmit_deadline)
         return;
 
     dbgln_if(TCP_SOCKET_DEBUG, "TCPSocket({}) handling retransmit", this);
 
-    m_last_retransmit_time = now;
     ++m_retransmit_attempts;
-
-    if (m_retransmit_attempts > maximum_retransmits) {
+    bool is_connecting = m_state == State::SynSent || m_state == State::SynReceived;
+    if (m_retransmit_attempts > (is_connecting ? maximum_syn_retransmits : maximum_retransmits)) {
+        m_retransmit_deadline = {};
+        dequeue_for_retransmit();
         set_state(TCPSocket::State::Closed);
         set_error(TCPSocket::Error::RetransmitTimeout);
         set_setup_state(Socket::SetupState::Completed);
         return;
     }
 
-    auto routing_decision = route_to(peer_address(), local_address(), bound_interface());
-    if (routing_decision.is_zero())
+    // RFC 6298 section 5.5 and 5.6. According to RFC 1122 we must back off even for SYN packets.
+    m_retransmit_timeout = min(m_retransmit_timeout + m_retransmit_timeout, maximum_retransmit_timeout);
+    m_retransmit_deadline = now + m_retransmit_timeout;
+
+    Locker locker(m_not_acked_lock);
+    if (is_send_window_closed()) {
+        // The peer can't take anything right now, so this is no sign of congestion.
+        probe_send_window();
         return;
+    }
+    if (m_not_acked.is_empty()) {
+        m_retransmit_deadline = {};
+        return;
+    }
+    m_duplicate_acks = 0;
+    enter_recovery(true);
+}
 
-    Locker locker(m_not_acked_lock, Lock::Mode::Shared);
-    for (auto& packet : m_not_acked) {
-        packet.tx_counter++;
-
-        if constexpr (TCP_SOCKET_DEBUG) {
-            auto& tcp_packet = *(const TCPPacket*)(packet.buffer->buffer.data() + packet.ipv4_payload_offset);
-            dbgln("Sending TCP packet from {}:{} to {}:{} with ({}{}{}{}) seq_no={}, ack_no={}, tx_counter={}",
-                local_address(), local_port(),
-                peer_address(), peer_port(),
-                (tcp_packet.has_syn() ? "SYN " : ""),
-                (tcp_packet.has_ack() ? "ACK " : ""),
-                (tcp_packet.has_fin() ? "FIN " : ""),
-                (tcp_packet.has_rst() ? "RST " : ""),
-                tcp_packet.sequence_number(),
-                tcp_packet.ack_number(),
-                packet.tx_counter);
-        }
+bool TCPSocket::is_send_window_closed() const
+{
+    VERIFY(m_not_acked_lock.is_locked());
+    return m_send_window_size == 0 && (m_state == State::Established || m_state == State::CloseWait);
+}
 
-        size_t ipv4_payload_offset = routing_decision.adapter->ipv4_payload_offset();
-        if (ipv4_payload_offset != packet.ipv4_payload_offset) {
-            // FIXME: Add support for this. This can happen if after a route change
-            // we ended up on another adapter which doesn't have the same layer 2 type
-            // like the previous adapter.
-            VERIFY_NOT_REACHED();
-        }
-        routing_decision.adapter->fill_in_ipv4_header(*packet.buffer,
-            local_address(), routing_decision.next_hop, peer_address(),
-            IPv4Protocol::TCP, packet.buffer->buffer.size() - ipv4_payload_offset, ttl());
-        routing_decision.adapter->send_packet({ packet.buffer->buffer.data(), packet.buffer->buffer.size() });
-        m_packets_out++;
-        m_bytes_out += packet.buffer->buffer.size();
+void TCPSocket::probe_send_window()
+{
+    VERIFY(m_not_acked_lock.is_locked());
+    dbgln_if(TCP_SOCKET_DEBUG, "TCPSocket({}) probing zero window", this);
+
+    if (m_not_acked.is_empty()) {
+        // The byte the next write sends arms the timer again.
+        m_retransmit_deadline = {};
+        dequeue_for_retransmit();
+        m_window_probe_due = true;
+        evaluate_block_conditions();
+        return;
     }
+
+    // Whatever the peer hasn't acknowledged yet makes for a probe too.
+    auto routing_decision = route_to(peer_address(), local_address(), bound_interface());
+    if (routing_decision.is_zero())
+        return;
+    retransmit_packet(m_not_acked.first(), routing_decision);
+}
+
+size_t TCPSocket::send_window_available() const
+{
+    VERIFY(m_not_acked_lock.is_locked());
+    // What the peer SACKed has left the network, but it still takes up room in the peer's receive buffer.
+    size_t in_flight = m_not_acked_size - m_sacked_size;
+    size_t congestion_window = m_congestion_control->congestion_window();
+    size_t congestion_space = congestion_window > in_flight ? congestion_window - in_flight : 0;
+    size_t receive_space = m_send_window_size > m_not_acked_size ? m_send_window_size - m_not_acked_size : 0;
+    size_t available = min(congestion_space, receive_space);
+
+    // A window probe carries a single byte (RFC 9293 section 3.8.6.1).
+    if (m_window_probe_due && m_not_acked_size == 0)
+        return max(available, static_cast<size_t>(1));
+
+    // Don't send tiny segments when waiting for the next ACK would make room for a full one (RFC 1122 section 4.2.3.4).
+    if (available < m_congestion_control->mss() && m_not_acked_size > 0)
+        return 0;
+    return available;
 }
 
 bool TCPSocket::can_write(const FileDescription& file_description, size_t size) const
@@ -587,11 +1050,73 @@ bool TCPSocket::can_write(const FileDescription& file_description, size_t size)
     if (m_state == State::SynSent || m_state == State::SynReceived)
         return false;
 
-    if (!file_description.is_blocking())
+    // Let writes on a connection that is going away fail right away.
+    if (m_state != State::Established && m_state != State::CloseWait)
         return true;
 
     Locker lock(m_not_acked_lock);
-    return m_not_acked_size + size <= m_send_window_size;
+    return send_window_available() > 0;
+}
+
+void TCPSocket::protocol_did_read()
+{
+    if (m_state != State::Established && m_state != State::FinWait1 && m_state != State::FinWait2)
+        return;
+
+    // If the window we advertised last got small, the peer may be waiting for it to open up
+    // again. Don't bother it with every little bit of space though (RFC 1122 section 4.2.3.3).
+    auto window = receive_window();
+    auto threshold = min(receive_buffer_size / 2, static_cast<size_t>(m_peer_mss));
+    if (window >= 2 * m_last_advertised_window && window - m_last_advertised_window >= threshold)
+        [[maybe_unused]] auto result = send_ack(true);
+}
+
+KResult TCPSocket::setsockopt(int level, int option, Userspace<const void*> user_value, socklen_t user_value_size)
+{
+    if (level != IPPROTO_TCP)
+        return IPv4Socket::setsockopt(level, option, user_value, user_value_size);
+
+    switch (option) {
+    case TCP_CONGESTION: {
+        auto name = copy_string_from_user(static_ptr_cast<const char*>(user_value), user_value_size);
+        if (name.is_null())
+            return EFAULT;
+        Locker locker(lock());
+        return set_congestion_control(name);
+    }
+    default:
+        return ENOPROTOOPT;
+    }
+}
+
+KResult TCPSocket::getsockopt(FileDescription& description, int level, int option, Userspace<void*> value, Userspace<socklen_t*> value_size)
+{
+    if (level != IPPROTO_TCP)
+        return IPv4Socket::getsockopt(description, level, option, value, value_size);
+
+    socklen_t size;
+    if (!copy_from_user(&size, value_size.unsafe_userspace_ptr()))
+        return EFAULT;
+
+    switch (option) {
+    case TCP_CONGESTION: {
+        Locker locker(lock());
+        auto name = congestion_control_name();
+        if (size < name.length() + 1)
+            return EINVAL;
+        char terminator = '\0';
+        if (!copy_to_user(static_ptr_cast<char*>(value), name.characters_without_null_termination(), name.length()))
+            return EFAULT;
+        if (!copy_to_user(static_ptr_cast<char*>(value).unsafe_userspace_ptr() + name.length(), &terminator, 1))
+            return EFAULT;
+        size = name.length() + 1;
+        if (!copy_to_user(value_size, &size))
+            return EFAULT;
+        return KSuccess;
+    }
+    default:
+        return ENOPROTOOPT;
+    }
 }
 
 }
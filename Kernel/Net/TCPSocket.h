@@ -6,12 +6,16 @@
 
 #pragma once
 
+#include <AK/ByteBuffer.h>
 #include <AK/Function.h>
 #include <AK/HashMap.h>
+#include <AK/NonnullOwnPtr.h>
 #include <AK/SinglyLinkedList.h>
 #include <AK/WeakPtr.h>
 #include <Kernel/KResult.h>
 #include <Kernel/Net/IPv4Socket.h>
+#include <Kernel/Net/TCP.h>
+#include <Kernel/Net/TCPCongestionControl.h>
 
 namespace Kernel {
 
@@ -130,14 +134,22 @@ public:
     u32 packets_out() const { return m_packets_out; }
     u32 bytes_out() const { return m_bytes_out; }
 
-    // FIXME: Make this configurable?
-    static constexpr u32 maximum_duplicate_acks = 5;
-    void set_duplicate_acks(u32 acks) { m_duplicate_acks = acks; }
-    u32 duplicate_acks() const { return m_duplicate_acks; }
+    StringView congestion_control_name() const { return m_congestion_control->name(); }
+    size_t congestion_window() const { return m_congestion_control->congestion_window(); }
+    const Time& smoothed_rtt() const { return m_smoothed_rtt; }
+    KResult set_congestion_control(StringView name);
 
     KResult send_ack(bool allow_duplicate = false);
     KResult send_tcp_packet(u16 flags, const UserOrKernelBuffer* = nullptr, size_t = 0, RoutingDecision* = nullptr);
     void receive_tcp_packet(const TCPPacket&, u16 size);
+    // Takes over the options the peer offered in its SYN.
+    void negotiate_options(const TCPPacket& syn_packet);
+
+    // Segments that arrive ahead of a gap are kept until the gap has been filled.
+    void queue_out_of_order_packet(const IPv4Packet&, const TCPPacket&, size_t payload_size, const Time& packet_timestamp);
+    // Passes on the queued segments that follow the data received so far. Returns
+    // whether there were any, in which case the peer should be told right away.
+    bool deliver_out_of_order_packets();
 
     bool should_delay_next_ack() const;
 
@@ -154,16 +166,20 @@ public:
 
     static Lockable<HashTable<TCPSocket*>>& sockets_for_retransmit();
     void retransmit_packets();
+    // When retransmit_packets() has something to do next, or zero if nothing is waiting to be acknowledged.
+    const Time& retransmit_deadline() const { return m_retransmit_deadline; }
 
     virtual KResult close() override;
 
     virtual bool can_write(const FileDescription&, size_t) const override;
+    virtual KResult setsockopt(int level, int option, Userspace<const void*>, socklen_t) override;
+    virtual KResult getsockopt(FileDescription&, int level, int option, Userspace<void*>, Userspace<socklen_t*>) override;
 
 protected:
     void set_direction(Direction direction) { m_direction = direction; }
 
 private:
-    explicit TCPSocket(int protocol);
+    TCPSocket(int protocol, NonnullOwnPtr<TCPCongestionControl>);
     virtual const char* class_name() const override { return "TCPSocket"; }
 
     static NetworkOrdered<u16> compute_tcp_checksum(const IPv4Address& source, const IPv4Address& destination, const TCPPacket&, u16 payload_size);
@@ -177,10 +193,30 @@ private:
     virtual bool protocol_is_disconnected() const override;
     virtual KResult protocol_bind() override;
     virtual KResult protocol_listen(bool did_allocate_port) override;
+    virtual void protocol_did_read() override;
 
     void enqueue_for_retransmit();
     void dequeue_for_retransmit();
 
+    struct OutgoingPacket;
+
+    size_t maximum_segment_size(const NetworkAdapter&) const;
+    u8 receive_window_shift_to_offer() const;
+    size_t receive_window() const;
+    u16 window_to_advertise(bool is_syn);
+    size_t build_options(u16 flags, const NetworkAdapter&, size_t payload_size, Bytes options);
+    Vector<TCPSACKBlock, TCPOptions::max_sack_blocks> sack_blocks() const;
+
+    size_t send_window_available() const;
+    void update_rtt(const Time& sample);
+    void process_ack(const TCPPacket&, const TCPOptions&, size_t payload_size, bool window_changed);
+    void process_sack_blocks(const TCPOptions&);
+    void enter_recovery(bool after_timeout);
+    void retransmit_lost_packets();
+    bool is_send_window_closed() const;
+    void probe_send_window();
+    void retransmit_packet(OutgoingPacket&, RoutingDecision&);
+
     WeakPtr<TCPSocket> m_originator;
     HashMap<IPv4SocketTuple, NonnullRefPtr<TCPSocket>> m_pending_release_for_accept;
     Direction m_direction { Direction::Unspecified };
@@ -200,24 +236,79 @@ private:
         size_t ipv4_payload_offset;
         WeakPtr<NetworkAdapter> adapter;
         int tx_counter { 0 };
+        u32 sequence_number { 0 };
+        size_t payload_size { 0 };
+        Time sent_time;
+        // The peer told us it has this one through a SACK block.
+        bool sacked { false };
+        bool retransmitted_during_recovery { false };
     };
 
     mutable Lock m_not_acked_lock { "TCPSocket unacked packets" };
     SinglyLinkedList<OutgoingPacket> m_not_acked;
     size_t m_not_acked_size { 0 };
+    size_t m_sacked_size { 0 };
+    u32 m_highest_sacked_sequence { 0 };
 
+    // RFC 5681 section 3.2
+    static constexpr u32 duplicate_ack_threshold = 3;
     u32 m_duplicate_acks { 0 };
 
+    NonnullOwnPtr<TCPCongestionControl> m_congestion_control;
+    bool m_in_recovery { false };
+    bool m_recovering_from_timeout { false };
+    u32 m_recovery_point { 0 };
+
     u32 m_last_ack_number_sent { 0 };
     Time m_last_ack_sent_time;
 
-    // FIXME: Make this configurable (sysctl)
-    static constexpr u32 maximum_retransmits = 5;
-    Time m_last_retransmit_time;
+    // FIXME: Make these configurable (sysctl)
+    static constexpr u32 maximum_syn_retransmits = 5;
+    static constexpr u32 maximum_retransmits = 15;
     u32 m_retransmit_attempts { 0 };
 
-    // FIXME: Parse window size TCP option from the peer
+    // RFC 6298
+    static constexpr Time initial_retransmit_timeout = Time::from_seconds(1);
+    // RFC 6298 asks for at least a second, but that is far too long for a LAN. This is what Linux uses.
+    static constexpr Time minimum_retransmit_timeout = Time::from_milliseconds(200);
+    static constexpr Time maximum_retransmit_timeout = Time::from_seconds(60);
+    bool m_has_rtt_sample { false };
+    Time m_smoothed_rtt;
+    Time m_rtt_variance;
+    Time m_retransmit_timeout { initial_retransmit_timeout };
+    Time m_retransmit_deadline;
+
+    // The options agreed on during the handshake (RFC 7323 and RFC 2018).
+    static constexpr u16 default_peer_mss = 536;
+    u16 m_peer_mss { default_peer_mss };
+    bool m_window_scaling_enabled { false };
+    u8 m_send_window_shift { 0 };
+    u8 m_receive_window_shift { 0 };
+    bool m_sack_permitted { false };
+    bool m_timestamps_enabled { false };
+    u32 m_timestamp_recent { 0 };
+
+    // What the peer is willing to receive, in bytes.
     u32 m_send_window_size { 64 * KiB };
+    // While the peer's window is closed, the retransmit timer acts as the persist timer
+    // (RFC 9293 section 3.8.6.1). With nothing in flight to probe the window with, it
+    // lets the next write send a single byte.
+    bool m_window_probe_due { false };
+    size_t m_last_advertised_window { 0 };
+
+    struct OutOfOrderPacket {
+        u32 sequence_number { 0 };
+        u32 end_sequence_number { 0 };
+        ByteBuffer ipv4_packet;
+        Time timestamp;
+    };
+
+    static constexpr size_t max_out_of_order_packets = 256;
+
+    // Sorted by sequence number.
+    Vector<OutOfOrderPacket> m_out_of_order_packets;
+    size_t m_out_of_order_size { 0 };
+    u32 m_latest_out_of_order_sequence { 0 };
 };
 
 }
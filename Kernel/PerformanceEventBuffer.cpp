@@ -4,15 +4,14 @@
  * SPDX-License-Identifier: BSD-2-Clause
  */
 
-#include <AK/JsonArraySerializer.h>
-#include <AK/JsonObject.h>
-#include <AK/JsonObjectSerializer.h>
 #include <AK/ScopeGuard.h>
 #include <Kernel/Arch/x86/SmapDisabler.h>
 #include <Kernel/FileSystem/Custody.h>
 #include <Kernel/KBufferBuilder.h>
 #include <Kernel/PerformanceEventBuffer.h>
+#include <Kernel/PerformanceEventRing.h>
 #include <Kernel/Process.h>
+#include <Kernel/Time/TimeManagement.h>
 
 namespace Kernel {
 
@@ -21,6 +20,15 @@ PerformanceEventBuffer::PerformanceEventBuffer(NonnullOwnPtr<KBuffer> buffer)
 {
 }
 
+PerformanceEventBuffer::PerformanceEventBuffer(NonnullRefPtrVector<PerformanceEventRing> rings)
+    : m_rings(move(rings))
+{
+}
+
+PerformanceEventBuffer::~PerformanceEventBuffer()
+{
+}
+
 NEVER_INLINE KResult PerformanceEventBuffer::append(int type, FlatPtr arg1, FlatPtr arg2, const StringView& arg3, Thread* current_thread)
 {
     FlatPtr ebp;
@@ -29,9 +37,9 @@ NEVER_INLINE KResult PerformanceEventBuffer::append(int type, FlatPtr arg1, Flat
     return append_with_eip_and_ebp(current_thread->pid(), current_thread->tid(), 0, ebp, type, 0, arg1, arg2, arg3);
 }
 
-static Vector<FlatPtr, PerformanceEvent::max_stack_frame_count> raw_backtrace(FlatPtr ebp, FlatPtr eip)
+static Vector<FlatPtr, PerformanceEventBuffer::max_stack_frame_count> raw_backtrace(FlatPtr ebp, FlatPtr eip)
 {
-    Vector<FlatPtr, PerformanceEvent::max_stack_frame_count> backtrace;
+    Vector<FlatPtr, PerformanceEventBuffer::max_stack_frame_count> backtrace;
     if (eip != 0)
         backtrace.append(eip);
     FlatPtr stack_ptr_copy;
@@ -48,7 +56,7 @@ static Vector<FlatPtr, PerformanceEvent::max_stack_frame_count> raw_backtrace(Fl
         if (retaddr == 0)
             break;
         backtrace.append(retaddr);
-        if (backtrace.size() == PerformanceEvent::max_stack_frame_count)
+        if (backtrace.size() == PerformanceEventBuffer::max_stack_frame_count)
             break;
         stack_ptr = stack_ptr_copy;
     }
@@ -58,198 +66,207 @@ static Vector<FlatPtr, PerformanceEvent::max_stack_frame_count> raw_backtrace(Fl
 KResult PerformanceEventBuffer::append_with_eip_and_ebp(ProcessID pid, ThreadID tid,
     u32 eip, u32 ebp, int type, u32 lost_samples, FlatPtr arg1, FlatPtr arg2, const StringView& arg3)
 {
-    if (count() >= capacity())
-        return ENOBUFS;
-
     if ((g_profiling_event_mask & type) == 0)
         return EINVAL;
 
-    auto current_thread = Thread::current();
-    u32 enter_count = 0;
-    if (current_thread)
-        enter_count = current_thread->enter_profiler();
-    ScopeGuard leave_profiler([&] {
-        if (current_thread)
-            current_thread->leave_profiler();
-    });
-    if (enter_count > 0)
-        return EINVAL;
-
-    PerformanceEvent event;
-    event.type = type;
-    event.lost_samples = lost_samples;
+    union {
+        MallocPerformanceEvent malloc;
+        FreePerformanceEvent free;
+        MmapPerformanceEvent mmap;
+        MunmapPerformanceEvent munmap;
+        ProcessCreatePerformanceEvent process_create;
+        ThreadCreatePerformanceEvent thread_create;
+        ContextSwitchPerformanceEvent context_switch;
+        KMallocPerformanceEvent kmalloc;
+        KFreePerformanceEvent kfree;
+    } payload;
+    size_t payload_size = 0;
+    StringView string;
 
     switch (type) {
     case PERF_EVENT_SAMPLE:
         break;
     case PERF_EVENT_MALLOC:
-        event.data.malloc.size = arg1;
-        event.data.malloc.ptr = arg2;
+        payload.malloc.size = arg1;
+        payload.malloc.ptr = arg2;
+        payload_size = sizeof(payload.malloc);
         break;
     case PERF_EVENT_FREE:
-        event.data.free.ptr = arg1;
+        payload.free.size = 0;
+        payload.free.ptr = arg1;
+        payload_size = sizeof(payload.free);
         break;
     case PERF_EVENT_MMAP:
-        event.data.mmap.ptr = arg1;
-        event.data.mmap.size = arg2;
-        memset(event.data.mmap.name, 0, sizeof(event.data.mmap.name));
-        if (!arg3.is_empty())
-            memcpy(event.data.mmap.name, arg3.characters_without_null_termination(), min(arg3.length(), sizeof(event.data.mmap.name) - 1));
+        payload.mmap.ptr = arg1;
+        payload.mmap.size = arg2;
+        payload_size = sizeof(payload.mmap);
+        string = arg3;
         break;
     case PERF_EVENT_MUNMAP:
-        event.data.munmap.ptr = arg1;
-        event.data.munmap.size = arg2;
+        payload.munmap.ptr = arg1;
+        payload.munmap.size = arg2;
+        payload_size = sizeof(payload.munmap);
         break;
     case PERF_EVENT_PROCESS_CREATE:
-        event.data.process_create.parent_pid = arg1;
-        memset(event.data.process_create.executable, 0, sizeof(event.data.process_create.executable));
-        if (!arg3.is_empty()) {
-            memcpy(event.data.process_create.executable, arg3.characters_without_null_termination(),
-                min(arg3.length(), sizeof(event.data.process_create.executable) - 1));
-        }
+        payload.process_create.parent_pid = arg1;
+        payload_size = sizeof(payload.process_create);
+        string = arg3;
         break;
     case PERF_EVENT_PROCESS_EXEC:
-        memset(event.data.process_exec.executable, 0, sizeof(event.data.process_exec.executable));
-        if (!arg3.is_empty()) {
-            memcpy(event.data.process_exec.executable, arg3.characters_without_null_termination(),
-                min(arg3.length(), sizeof(event.data.process_exec.executable) - 1));
-        }
+        string = arg3;
         break;
     case PERF_EVENT_PROCESS_EXIT:
         break;
     case PERF_EVENT_THREAD_CREATE:
-        event.data.thread_create.parent_tid = arg1;
+        payload.thread_create.parent_tid = arg1;
+        payload_size = sizeof(payload.thread_create);
         break;
     case PERF_EVENT_THREAD_EXIT:
         break;
     case PERF_EVENT_CONTEXT_SWITCH:
-        event.data.context_switch.next_pid = arg1;
-        event.data.context_switch.next_tid = arg2;
+        payload.context_switch.next_pid = arg1;
+        payload.context_switch.next_tid = arg2;
+        payload_size = sizeof(payload.context_switch);
         break;
     case PERF_EVENT_KMALLOC:
-        event.data.kmalloc.size = arg1;
-        event.data.kmalloc.ptr = arg2;
+        payload.kmalloc.size = arg1;
+        payload.kmalloc.ptr = arg2;
+        payload_size = sizeof(payload.kmalloc);
         break;
     case PERF_EVENT_KFREE:
-        event.data.kfree.size = arg1;
-        event.data.kfree.ptr = arg2;
+        payload.kfree.size = arg1;
+        payload.kfree.ptr = arg2;
+        payload_size = sizeof(payload.kfree);
         break;
     case PERF_EVENT_PAGE_FAULT:
         break;
+    case PERF_EVENT_TRACEPOINT:
+        // These are only recorded through append_tracepoint().
     default:
         return EINVAL;
     }
 
+    return append_record(pid, tid, eip, ebp, type, lost_samples, { reinterpret_cast<const u8*>(&payload), payload_size }, string);
+}
+
+NEVER_INLINE KResult PerformanceEventBuffer::append_tracepoint(Tracepoint tracepoint, FlatPtr arg1, FlatPtr arg2, const StringView& string, Thread& current_thread)
+{
+    if ((g_profiling_event_mask & PERF_EVENT_TRACEPOINT) == 0)
+        return EINVAL;
+
+    FlatPtr ebp;
+    asm volatile("movl %%ebp, %%eax"
+                 : "=a"(ebp));
+
+    TracepointPerformanceEvent payload {};
+    payload.tracepoint = to_underlying(tracepoint);
+    payload.timestamp_ns = TimeManagement::the().monotonic_time(TimePrecision::Precise).to_nanoseconds();
+    payload.arg1 = arg1;
+    payload.arg2 = arg2;
+    return append_record(current_thread.pid(), current_thread.tid(), 0, ebp, PERF_EVENT_TRACEPOINT, 0, { reinterpret_cast<const u8*>(&payload), sizeof(payload) }, string);
+}
+
+KResult PerformanceEventBuffer::append_record(ProcessID pid, ThreadID tid, u32 eip, u32 ebp, int type, u32 lost_samples, ReadonlyBytes payload, StringView string)
+{
+    auto current_thread = Thread::current();
+    u32 enter_count = 0;
+    if (current_thread)
+        enter_count = current_thread->enter_profiler();
+    ScopeGuard leave_profiler([&] {
+        if (current_thread)
+            current_thread->leave_profiler();
+    });
+    if (enter_count > 0)
+        return EINVAL;
+
     auto backtrace = raw_backtrace(ebp, eip);
-    event.stack_size = min(sizeof(event.stack) / sizeof(FlatPtr), static_cast<size_t>(backtrace.size()));
-    memcpy(event.stack, backtrace.data(), event.stack_size * sizeof(FlatPtr));
+    string = string.substring_view(0, min(string.length(), max_string_length));
+
+    PerformanceEventRecord record {};
+    record.type = type;
+    record.stack_size = backtrace.size();
+    record.string_length = string.length();
+    record.pid = pid.value();
+    record.tid = tid.value();
+    record.lost_samples = lost_samples;
+    record.timestamp = TimeManagement::the().uptime_ms();
+    size_t unpadded_size = sizeof(record) + payload.size() + backtrace.size() * sizeof(FlatPtr) + string.length();
+    size_t record_size = round_up_to_power_of_two(unpadded_size, performance_event_record_alignment);
+    record.size = record_size;
 
-    event.pid = pid.value();
-    event.tid = tid.value();
-    event.timestamp = TimeManagement::the().uptime_ms();
-    at(m_count++) = event;
+    auto write_record = [&](u8* destination) {
+        memcpy(destination, &record, sizeof(record));
+        memcpy(destination + sizeof(record), payload.data(), payload.size());
+        memcpy(destination + sizeof(record) + payload.size(), backtrace.data(), backtrace.size() * sizeof(FlatPtr));
+        if (!string.is_empty())
+            memcpy(destination + unpadded_size - string.length(), string.characters_without_null_termination(), string.length());
+        memset(destination + unpadded_size, 0, record_size - unpadded_size);
+    };
+
+    if (is_per_processor()) {
+        // Nothing else writes to this processor's ring while interrupts are disabled.
+        InterruptDisabler disabler;
+        auto& ring = m_rings[Processor::id()];
+        auto* destination = ring.try_reserve(record_size);
+        if (!destination)
+            return ENOBUFS;
+        write_record(destination);
+        ring.commit(record_size);
+        return KSuccess;
+    }
+
+    ScopedSpinLock lock(m_lock);
+    size_t offset = m_size.load(AK::memory_order_relaxed);
+    if (offset + record_size > m_buffer->size()) {
+        m_lost_events.fetch_add(1, AK::memory_order_relaxed);
+        return ENOBUFS;
+    }
+    write_record(m_buffer->data() + offset);
+    // Readers copy everything below m_size without taking the lock, so it may
+    // only move past a record once all of it has been written.
+    m_size.store(offset + record_size, AK::memory_order_release);
     return KSuccess;
 }
 
-PerformanceEvent& PerformanceEventBuffer::at(size_t index)
+void PerformanceEventBuffer::clear()
 {
-    VERIFY(index < capacity());
-    auto* events = reinterpret_cast<PerformanceEvent*>(m_buffer->data());
-    return events[index];
+    m_size = 0;
+    m_lost_events = 0;
+    for (auto& ring : m_rings)
+        ring.reset();
 }
 
-template<typename Serializer>
-bool PerformanceEventBuffer::to_json_impl(Serializer& object) const
+RefPtr<PerformanceEventRing> PerformanceEventBuffer::ring(u32 processor) const
 {
-    auto array = object.add_array("events");
-    bool seen_first_sample = false;
-    for (size_t i = 0; i < m_count; ++i) {
-        auto& event = at(i);
-        auto event_object = array.add_object();
-        switch (event.type) {
-        case PERF_EVENT_SAMPLE:
-            event_object.add("type", "sample");
-            break;
-        case PERF_EVENT_MALLOC:
-            event_object.add("type", "malloc");
-            event_object.add("ptr", static_cast<u64>(event.data.malloc.ptr));
-            event_object.add("size", static_cast<u64>(event.data.malloc.size));
-            break;
-        case PERF_EVENT_FREE:
-            event_object.add("type", "free");
-            event_object.add("ptr", static_cast<u64>(event.data.free.ptr));
-            break;
-        case PERF_EVENT_MMAP:
-            event_object.add("type", "mmap");
-            event_object.add("ptr", static_cast<u64>(event.data.mmap.ptr));
-            event_object.add("size", static_cast<u64>(event.data.mmap.size));
-            event_object.add("name", event.data.mmap.name);
-            break;
-        case PERF_EVENT_MUNMAP:
-            event_object.add("type", "munmap");
-            event_object.add("ptr", static_cast<u64>(event.data.munmap.ptr));
-            event_object.add("size", static_cast<u64>(event.data.munmap.size));
-            break;
-        case PERF_EVENT_PROCESS_CREATE:
-            event_object.add("type", "process_create");
-            event_object.add("parent_pid", static_cast<u64>(event.data.process_create.parent_pid));
-            event_object.add("executable", event.data.process_create.executable);
-            break;
-        case PERF_EVENT_PROCESS_EXEC:
-            event_object.add("type", "process_exec");
-            event_object.add("executable", event.data.process_exec.executable);
-            break;
-        case PERF_EVENT_PROCESS_EXIT:
-            event_object.add("type", "process_exit");
-            break;
-        case PERF_EVENT_THREAD_CREATE:
-            event_object.add("type", "thread_create");
-            event_object.add("parent_tid", static_cast<u64>(event.data.thread_create.parent_tid));
-            break;
-        case PERF_EVENT_THREAD_EXIT:
-            event_object.add("type", "thread_exit");
-            break;
-        case PERF_EVENT_CONTEXT_SWITCH:
-            event_object.add("type", "context_switch");
-            event_object.add("next_pid", static_cast<u64>(event.data.context_switch.next_pid));
-            event_object.add("next_tid", static_cast<u64>(event.data.context_switch.next_tid));
-            break;
-        case PERF_EVENT_KMALLOC:
-            event_object.add("type", "kmalloc");
-            event_object.add("ptr", static_cast<u64>(event.data.kmalloc.ptr));
-            event_object.add("size", static_cast<u64>(event.data.kmalloc.size));
-            break;
-        case PERF_EVENT_KFREE:
-            event_object.add("type", "kfree");
-            event_object.add("ptr", static_cast<u64>(event.data.kfree.ptr));
-            event_object.add("size", static_cast<u64>(event.data.kfree.size));
-            break;
-        case PERF_EVENT_PAGE_FAULT:
-            event_object.add("type", "page_fault");
-            break;
-        }
-        event_object.add("pid", event.pid);
-        event_object.add("tid", event.tid);
-        event_object.add("timestamp", event.timestamp);
-        event_object.add("lost_samples", seen_first_sample ? event.lost_samples : 0);
-        if (event.type == PERF_EVENT_SAMPLE)
-            seen_first_sample = true;
-        auto stack_array = event_object.add_array("stack");
-        for (size_t j = 0; j < event.stack_size; ++j) {
-            stack_array.add(event.stack[j]);
-        }
-        stack_array.finish();
-        event_object.finish();
-    }
-    array.finish();
-    object.finish();
-    return true;
+    if (processor >= m_rings.size())
+        return {};
+    return m_rings[processor];
+}
+
+u32 PerformanceEventBuffer::lost_events() const
+{
+    u32 lost_events = m_lost_events.load(AK::memory_order_relaxed);
+    for (auto& ring : m_rings)
+        lost_events += ring.lost_events();
+    return lost_events;
 }
 
-bool PerformanceEventBuffer::to_json(KBufferBuilder& builder) const
+bool PerformanceEventBuffer::serialize(KBufferBuilder& builder) const
 {
-    JsonObjectSerializer object(builder);
-    return to_json_impl(object);
+    PerformanceEventStreamHeader header {};
+    header.magic = performance_event_stream_magic;
+    header.version = performance_event_stream_version;
+    header.header_size = sizeof(header);
+    header.lost_events = lost_events();
+    builder.append_bytes({ reinterpret_cast<const u8*>(&header), sizeof(header) });
+
+    if (is_per_processor()) {
+        for (auto& ring : m_rings)
+            ring.snapshot(builder);
+    } else {
+        builder.append_bytes({ m_buffer->data(), m_size.load(AK::memory_order_acquire) });
+    }
+    return true;
 }
 
 OwnPtr<PerformanceEventBuffer> PerformanceEventBuffer::try_create_with_size(size_t buffer_size)
@@ -260,6 +277,18 @@ OwnPtr<PerformanceEventBuffer> PerformanceEventBuffer::try_create_with_size(size
     return adopt_own_if_nonnull(new PerformanceEventBuffer(buffer.release_nonnull()));
 }
 
+OwnPtr<PerformanceEventBuffer> PerformanceEventBuffer::try_create_per_processor(size_t ring_size)
+{
+    NonnullRefPtrVector<PerformanceEventRing> rings;
+    for (u32 processor = 0; processor < Processor::count(); processor++) {
+        auto ring = PerformanceEventRing::try_create(processor, ring_size);
+        if (!ring)
+            return {};
+        rings.append(ring.release_nonnull());
+    }
+    return adopt_own_if_nonnull(new PerformanceEventBuffer(move(rings)));
+}
+
 void PerformanceEventBuffer::add_process(const Process& process, ProcessEventType event_type)
 {
     ScopedSpinLock locker(process.space().get_lock());
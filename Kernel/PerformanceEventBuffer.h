@@ -6,124 +6,65 @@
 
 #pragma once
 
+#include <AK/Atomic.h>
+#include <AK/NonnullRefPtrVector.h>
+#include <Kernel/API/PerformanceEvents.h>
 #include <Kernel/KBuffer.h>
 #include <Kernel/KResult.h>
+#include <Kernel/SpinLock.h>
 
 namespace Kernel {
 
 class KBufferBuilder;
-
-struct [[gnu::packed]] MallocPerformanceEvent {
-    size_t size;
-    FlatPtr ptr;
-};
-
-struct [[gnu::packed]] FreePerformanceEvent {
-    size_t size;
-    FlatPtr ptr;
-};
-
-struct [[gnu::packed]] MmapPerformanceEvent {
-    size_t size;
-    FlatPtr ptr;
-    char name[64];
-};
-
-struct [[gnu::packed]] MunmapPerformanceEvent {
-    size_t size;
-    FlatPtr ptr;
-};
-
-struct [[gnu::packed]] ProcessCreatePerformanceEvent {
-    pid_t parent_pid;
-    char executable[64];
-};
-
-struct [[gnu::packed]] ProcessExecPerformanceEvent {
-    char executable[64];
-};
-
-struct [[gnu::packed]] ThreadCreatePerformanceEvent {
-    pid_t parent_tid;
-};
-
-struct [[gnu::packed]] ContextSwitchPerformanceEvent {
-    pid_t next_pid;
-    u32 next_tid;
-};
-
-struct [[gnu::packed]] KMallocPerformanceEvent {
-    size_t size;
-    FlatPtr ptr;
-};
-
-struct [[gnu::packed]] KFreePerformanceEvent {
-    size_t size;
-    FlatPtr ptr;
-};
-
-struct [[gnu::packed]] PerformanceEvent {
-    u16 type { 0 };
-    u8 stack_size { 0 };
-    u32 pid { 0 };
-    u32 tid { 0 };
-    u64 timestamp;
-    u32 lost_samples;
-    union {
-        MallocPerformanceEvent malloc;
-        FreePerformanceEvent free;
-        MmapPerformanceEvent mmap;
-        MunmapPerformanceEvent munmap;
-        ProcessCreatePerformanceEvent process_create;
-        ProcessExecPerformanceEvent process_exec;
-        ThreadCreatePerformanceEvent thread_create;
-        ContextSwitchPerformanceEvent context_switch;
-        KMallocPerformanceEvent kmalloc;
-        KFreePerformanceEvent kfree;
-    } data;
-    static constexpr size_t max_stack_frame_count = 64;
-    FlatPtr stack[max_stack_frame_count];
-};
+class PerformanceEventRing;
 
 enum class ProcessEventType {
     Create,
     Exec
 };
 
+// Events are encoded as PerformanceEventRecords (see Kernel/API/PerformanceEvents.h)
+// either into a single buffer, which stops recording once it is full, or into
+// a ring per processor that userspace drains while profiling is running.
 class PerformanceEventBuffer {
 public:
+    static constexpr size_t max_stack_frame_count = 64;
+    static constexpr size_t max_string_length = 255;
+
     static OwnPtr<PerformanceEventBuffer> try_create_with_size(size_t buffer_size);
+    static OwnPtr<PerformanceEventBuffer> try_create_per_processor(size_t ring_size);
+    ~PerformanceEventBuffer();
 
     KResult append(int type, FlatPtr arg1, FlatPtr arg2, const StringView& arg3, Thread* current_thread = Thread::current());
     KResult append_with_eip_and_ebp(ProcessID pid, ThreadID tid, u32 eip, u32 ebp,
         int type, u32 lost_samples, FlatPtr arg1, FlatPtr arg2, const StringView& arg3);
+    KResult append_tracepoint(Tracepoint, FlatPtr arg1, FlatPtr arg2, const StringView&, Thread& current_thread);
 
-    void clear()
-    {
-        m_count = 0;
-    }
+    void clear();
 
-    size_t capacity() const { return m_buffer->size() / sizeof(PerformanceEvent); }
-    size_t count() const { return m_count; }
-    const PerformanceEvent& at(size_t index) const
-    {
-        return const_cast<PerformanceEventBuffer&>(*this).at(index);
-    }
+    bool is_per_processor() const { return !m_rings.is_empty(); }
+    RefPtr<PerformanceEventRing> ring(u32 processor) const;
 
-    bool to_json(KBufferBuilder&) const;
+    // Writes a stream header followed by all the records. The records that are
+    // still in the per-processor rings are left there for userspace to consume.
+    bool serialize(KBufferBuilder&) const;
 
     void add_process(const Process&, ProcessEventType event_type);
 
 private:
     explicit PerformanceEventBuffer(NonnullOwnPtr<KBuffer>);
+    explicit PerformanceEventBuffer(NonnullRefPtrVector<PerformanceEventRing>);
 
-    template<typename Serializer>
-    bool to_json_impl(Serializer&) const;
+    KResult append_record(ProcessID, ThreadID, u32 eip, u32 ebp, int type, u32 lost_samples, ReadonlyBytes payload, StringView);
+    u32 lost_events() const;
 
-    PerformanceEvent& at(size_t index);
+    OwnPtr<KBuffer> m_buffer;
+    // Taken by writers to the single buffer, so that records are complete by the time m_size covers them.
+    SpinLock<u8> m_lock;
+    Atomic<size_t> m_size { 0 };
+    Atomic<u32> m_lost_events { 0 };
 
-    size_t m_count { 0 };
-    NonnullOwnPtr<KBuffer> m_buffer;
+    NonnullRefPtrVector<PerformanceEventRing> m_rings;
 };
 
 extern bool g_profiling_all_threads;
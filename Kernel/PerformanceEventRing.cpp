@@ -0,0 +1,141 @@
+/*
+ * Copyright (c) 2021, the SerenityOS developers.
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#include <AK/Atomic.h>
+#include <Kernel/KBufferBuilder.h>
+#include <Kernel/PerformanceEventRing.h>
+#include <Kernel/Process.h>
+#include <Kernel/VM/MemoryManager.h>
+
+namespace Kernel {
+
+RefPtr<PerformanceEventRing> PerformanceEventRing::try_create(u32 processor, size_t data_size)
+{
+    // The offsets wrap around at 2^32, so the data size has to divide that.
+    VERIFY((data_size & (data_size - 1)) == 0);
+    VERIFY(data_size >= PAGE_SIZE && data_size <= 1 * GiB);
+
+    auto vmobject = AnonymousVMObject::create_with_size(PAGE_SIZE + data_size, AllocationStrategy::AllocateNow);
+    if (!vmobject)
+        return {};
+    auto region = MM.allocate_kernel_region_with_vmobject(*vmobject, PAGE_SIZE + data_size, "Performance event ring", Region::Access::Read | Region::Access::Write);
+    if (!region)
+        return {};
+    return adopt_ref_if_nonnull(new PerformanceEventRing(processor, data_size, vmobject.release_nonnull(), region.release_nonnull()));
+}
+
+PerformanceEventRing::PerformanceEventRing(u32 processor, size_t data_size, NonnullRefPtr<AnonymousVMObject> vmobject, NonnullOwnPtr<Region> region)
+    : m_processor(processor)
+    , m_data_size(data_size)
+    , m_vmobject(move(vmobject))
+    , m_region(move(region))
+{
+    auto& header = this->header();
+    header.magic = performance_event_stream_magic;
+    header.version = performance_event_stream_version;
+    header.header_size = sizeof(PerformanceEventRingHeader);
+    header.processor = processor;
+    header.data_offset = PAGE_SIZE;
+    header.data_size = m_data_size;
+    reset();
+}
+
+PerformanceEventRing::~PerformanceEventRing()
+{
+}
+
+void PerformanceEventRing::reset()
+{
+    auto& header = this->header();
+    AK::atomic_store(&header.head, 0u, AK::memory_order_release);
+    AK::atomic_store(&header.tail, 0u, AK::memory_order_release);
+    AK::atomic_store(&header.lost_events, 0u, AK::memory_order_relaxed);
+    m_head = 0;
+    m_reserved_head = 0;
+}
+
+bool PerformanceEventRing::is_valid_tail(u32 head, u32 tail) const
+{
+    return tail % performance_event_record_alignment == 0 && head - tail <= m_data_size;
+}
+
+u8* PerformanceEventRing::try_reserve(size_t record_size)
+{
+    VERIFY(record_size % performance_event_record_alignment == 0);
+    VERIFY(record_size <= m_data_size);
+    auto& header = this->header();
+
+    u32 head = m_head;
+    u32 tail = AK::atomic_load(&header.tail, AK::memory_order_acquire);
+    u32 offset = head & (m_data_size - 1);
+    u32 padding = offset + record_size > m_data_size ? m_data_size - offset : 0;
+
+    // Userspace can write anything into the tail, but that only makes us drop events.
+    if (!is_valid_tail(head, tail) || head - tail + padding + record_size > m_data_size) {
+        AK::atomic_fetch_add(&header.lost_events, 1u, AK::memory_order_relaxed);
+        return nullptr;
+    }
+
+    if (padding) {
+        auto& padding_record = *reinterpret_cast<PerformanceEventRecord*>(data() + offset);
+        padding_record.type = performance_event_padding;
+        padding_record.size = padding;
+        offset = 0;
+    }
+
+    m_reserved_head = head + padding;
+    return data() + offset;
+}
+
+void PerformanceEventRing::commit(size_t record_size)
+{
+    u32 head = m_reserved_head + static_cast<u32>(record_size);
+    AK::atomic_store(&m_head, head, AK::memory_order_release);
+    AK::atomic_store(&header().head, head, AK::memory_order_release);
+}
+
+void PerformanceEventRing::snapshot(KBufferBuilder& builder) const
+{
+    u32 head = AK::atomic_load(&m_head, AK::memory_order_acquire);
+    u32 tail = AK::atomic_load(&header().tail, AK::memory_order_relaxed);
+    if (!is_valid_tail(head, tail))
+        return;
+
+    // The records are in memory that userspace can write to as well.
+    while (tail != head) {
+        u32 offset = tail & (m_data_size - 1);
+        auto& record = *reinterpret_cast<const PerformanceEventRecord*>(data() + offset);
+        u32 size = record.size;
+        if (size == 0 || size % performance_event_record_alignment != 0 || size > head - tail || offset + size > m_data_size)
+            return;
+        if (record.type != performance_event_padding)
+            builder.append_bytes({ data() + offset, size });
+        tail += size;
+    }
+}
+
+u32 PerformanceEventRing::lost_events() const
+{
+    return AK::atomic_load(&header().lost_events, AK::memory_order_relaxed);
+}
+
+KResultOr<Region*> PerformanceEventRing::mmap(Process& process, FileDescription&, const Range& range, u64 offset, int prot, bool shared)
+{
+    // Userspace may map just the header first, to find out how big the ring is.
+    if (offset != 0 || range.size() > m_vmobject->size())
+        return EINVAL;
+    // Userspace has to be able to write the tail, but we don't want any private copies.
+    if (!shared)
+        return EINVAL;
+    return process.space().allocate_region_with_vmobject(range, m_vmobject, offset, "Performance event ring", prot, shared);
+}
+
+String PerformanceEventRing::absolute_path(const FileDescription&) const
+{
+    return String::formatted("performance-event-ring:{}", m_processor);
+}
+
+}
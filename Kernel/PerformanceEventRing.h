@@ -0,0 +1,69 @@
+/*
+ * Copyright (c) 2021, the SerenityOS developers.
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#pragma once
+
+#include <Kernel/API/PerformanceEvents.h>
+#include <Kernel/FileSystem/File.h>
+#include <Kernel/VM/AnonymousVMObject.h>
+#include <Kernel/VM/Region.h>
+
+namespace Kernel {
+
+class KBufferBuilder;
+
+// The events of a single processor while all processes are being profiled.
+// Userspace maps the ring with mmap() and consumes records by advancing the
+// tail in its header, while the kernel keeps appending new ones at the head.
+//
+// Only the ring's own processor writes to it, and it does so with interrupts
+// disabled, so appending doesn't need any locking. If userspace doesn't keep
+// up, new events are dropped and counted in the header.
+class PerformanceEventRing final : public File {
+public:
+    static RefPtr<PerformanceEventRing> try_create(u32 processor, size_t data_size);
+    virtual ~PerformanceEventRing() override;
+
+    u32 processor() const { return m_processor; }
+
+    // Returns where a record of the given size can be written, or nullptr if the ring is full.
+    // The record becomes visible to userspace once it is committed.
+    u8* try_reserve(size_t record_size);
+    void commit(size_t record_size);
+
+    void reset();
+
+    // Appends the records userspace hasn't consumed yet, without consuming them.
+    void snapshot(KBufferBuilder&) const;
+    u32 lost_events() const;
+
+    virtual KResultOr<Region*> mmap(Process&, FileDescription&, const Range&, u64 offset, int prot, bool shared) override;
+
+private:
+    PerformanceEventRing(u32 processor, size_t data_size, NonnullRefPtr<AnonymousVMObject>, NonnullOwnPtr<Region>);
+
+    virtual const char* class_name() const override { return "PerformanceEventRing"; }
+    virtual String absolute_path(const FileDescription&) const override;
+    virtual bool can_read(const FileDescription&, size_t) const override { return false; }
+    virtual bool can_write(const FileDescription&, size_t) const override { return false; }
+    virtual KResultOr<size_t> read(FileDescription&, u64, UserOrKernelBuffer&, size_t) override { return ENOTSUP; }
+    virtual KResultOr<size_t> write(FileDescription&, u64, const UserOrKernelBuffer&, size_t) override { return ENOTSUP; }
+
+    PerformanceEventRingHeader& header() const { return *reinterpret_cast<PerformanceEventRingHeader*>(m_region->vaddr().as_ptr()); }
+    u8* data() const { return m_region->vaddr().offset(PAGE_SIZE).as_ptr(); }
+    bool is_valid_tail(u32 head, u32 tail) const;
+
+    u32 m_processor { 0 };
+    u32 m_data_size { 0 };
+    // The header is mapped writable into userspace, so it only gets a copy of the head.
+    u32 m_head { 0 };
+    // Where the record that was reserved last begins.
+    u32 m_reserved_head { 0 };
+    NonnullRefPtr<AnonymousVMObject> m_vmobject;
+    NonnullOwnPtr<Region> m_region;
+};
+
+}
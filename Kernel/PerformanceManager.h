@@ -119,6 +119,15 @@ public:
         }
     }
 
+    inline static void add_tracepoint_event(Thread& thread, Tracepoint tracepoint, FlatPtr arg1, FlatPtr arg2, const StringView& string)
+    {
+        if (thread.is_profiling_suppressed())
+            return;
+        if (auto* event_buffer = thread.process().current_perf_events_buffer()) {
+            [[maybe_unused]] auto rc = event_buffer->append_tracepoint(tracepoint, arg1, arg2, string, thread);
+        }
+    }
+
     inline static void timer_tick(RegisterState const& regs)
     {
         static Time last_wakeup;
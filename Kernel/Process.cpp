@@ -472,15 +472,15 @@ bool Process::dump_perfcore()
     if (description_or_error.is_error())
         return false;
     auto& description = description_or_error.value();
-    KBufferBuilder builder;
-    if (!m_perf_event_buffer->to_json(builder))
+    KBufferBuilder builder(true);
+    if (!m_perf_event_buffer->serialize(builder))
         return false;
 
-    auto json = builder.build();
-    if (!json)
+    auto events = builder.build();
+    if (!events)
         return false;
-    auto json_buffer = UserOrKernelBuffer::for_kernel_buffer(json->data());
-    if (description->write(json_buffer, json->size()).is_error())
+    auto events_buffer = UserOrKernelBuffer::for_kernel_buffer(events->data());
+    if (description->write(events_buffer, events->size()).is_error())
         return false;
     dbgln("Wrote perfcore to {}", description->absolute_path());
     return true;
@@ -78,8 +78,6 @@ enum class VeilState {
     Locked,
 };
 
-typedef HashMap<FlatPtr, RefPtr<FutexQueue>> FutexQueues;
-
 struct LoadResult;
 
 class ProtectedProcessBase {
@@ -298,6 +296,7 @@ public:
     KResultOr<int> sys$stat(Userspace<const Syscall::SC_stat_params*>);
     KResultOr<int> sys$lseek(int fd, Userspace<off_t*>, int whence);
     KResultOr<int> sys$ftruncate(int fd, Userspace<off_t*>);
+    KResultOr<int> sys$fallocate(Userspace<const Syscall::SC_fallocate_params*>);
     KResultOr<int> sys$kill(pid_t pid_or_pgid, int sig);
     [[noreturn]] void sys$exit(int status);
     KResultOr<int> sys$sigreturn(RegisterState& registers);
@@ -320,6 +319,7 @@ public:
     KResultOr<int> sys$gettimeofday(Userspace<timeval*>);
     KResultOr<int> sys$clock_gettime(clockid_t, Userspace<timespec*>);
     KResultOr<int> sys$clock_settime(clockid_t, Userspace<const timespec*>);
+    KResultOr<FlatPtr> sys$map_time_page();
     KResultOr<int> sys$clock_nanosleep(Userspace<const Syscall::SC_clock_nanosleep_params*>);
     KResultOr<int> sys$gethostname(Userspace<char*>, size_t);
     KResultOr<int> sys$sethostname(Userspace<const char*>, size_t);
@@ -376,6 +376,8 @@ public:
     KResultOr<int> sys$socketpair(Userspace<const Syscall::SC_socketpair_params*>);
     KResultOr<int> sys$sched_setparam(pid_t pid, Userspace<const struct sched_param*>);
     KResultOr<int> sys$sched_getparam(pid_t pid, Userspace<struct sched_param*>);
+    KResultOr<int> sys$sched_setaffinity(pid_t tid, size_t cpuset_size, Userspace<const cpu_set_t*>);
+    KResultOr<int> sys$sched_getaffinity(pid_t tid, size_t cpuset_size, Userspace<cpu_set_t*>);
     KResultOr<int> sys$create_thread(void* (*)(void*), Userspace<const Syscall::SC_create_thread_params*>);
     [[noreturn]] void sys$exit_thread(Userspace<void*>, Userspace<void*>, size_t);
     KResultOr<int> sys$join_thread(pid_t tid, Userspace<void**> exit_value);
@@ -395,6 +397,7 @@ public:
     KResultOr<int> sys$profiling_enable(pid_t, u64);
     KResultOr<int> sys$profiling_disable(pid_t);
     KResultOr<int> sys$profiling_free_buffer(pid_t);
+    KResultOr<int> sys$profiling_open_ring(u32 processor);
     KResultOr<int> sys$futex(Userspace<const Syscall::SC_futex_params*>);
     KResultOr<int> sys$chroot(Userspace<const char*> path, size_t path_length, int mount_flags);
     KResultOr<int> sys$pledge(Userspace<const Syscall::SC_pledge_params*>);
@@ -412,6 +415,14 @@ public:
     KResultOr<int> sys$anon_create(size_t, int options);
     KResultOr<int> sys$statvfs(Userspace<const Syscall::SC_statvfs_params*> user_params);
     KResultOr<int> sys$fstatvfs(int fd, statvfs* buf);
+    KResultOr<int> sys$create_event_queue(u32 flags);
+    KResultOr<int> sys$event_queue_ctl(Userspace<const Syscall::SC_event_queue_ctl_params*>);
+    KResultOr<int> sys$event_queue_wait(Userspace<const Syscall::SC_event_queue_wait_params*>);
+    KResultOr<int> sys$create_io_ring(Userspace<const Syscall::SC_create_io_ring_params*>);
+    KResultOr<int> sys$io_ring_enter(int fd, u32 to_submit, u32 min_complete);
+    KResultOr<size_t> sys$sendfile(Userspace<const Syscall::SC_sendfile_params*>);
+    KResultOr<size_t> sys$splice(Userspace<const Syscall::SC_splice_params*>);
+    KResultOr<size_t> sys$vmsplice(Userspace<const Syscall::SC_vmsplice_params*>);
 
     template<bool sockname, typename Params>
     int get_sock_or_peer_name(const Params&);
@@ -512,6 +523,7 @@ private:
     friend class Scheduler;
     friend class Region;
     friend class PerformanceManager;
+    friend class IORing;
 
     bool add_thread(Thread&);
     bool remove_thread(Thread&);
@@ -633,9 +645,6 @@ private:
 
     OwnPtr<PerformanceEventBuffer> m_perf_event_buffer;
 
-    FutexQueues m_futex_queues;
-    SpinLock<u8> m_futex_lock;
-
     // This member is used in the implementation of ptrace's PT_TRACEME flag.
     // If it is set to true, the process will stop at the next execve syscall
     // and wait for a tracer to attach.
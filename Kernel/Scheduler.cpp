@@ -15,9 +15,7 @@
 #include <Kernel/Scheduler.h>
 #include <Kernel/Time/TimeManagement.h>
 #include <Kernel/TimerQueue.h>
-
-// Remove this once SMP is stable and can be enabled by default
-#define SCHEDULE_ON_ALL_PROCESSORS 0
+#include <Kernel/Tracepoint.h>
 
 namespace Kernel {
 
@@ -51,10 +49,25 @@ READONLY_AFTER_INIT static Process* s_colonel_process;
 struct ThreadReadyQueue {
     IntrusiveList<Thread, RawPtr<Thread>, &Thread::m_ready_queue_node> thread_list;
 };
-static SpinLock<u8> g_ready_queues_lock;
-static u32 g_ready_queues_mask;
-static constexpr u32 g_ready_queue_buckets = sizeof(g_ready_queues_mask) * 8;
-READONLY_AFTER_INIT static ThreadReadyQueue* g_ready_queues; // g_ready_queue_buckets entries
+
+// Every processor owns one set of ready queues, so picking the next thread
+// only ever has to take the local lock. Processors that run out of work
+// steal from the queues of their peers.
+struct ThreadReadyQueues {
+    SpinLock<u8> lock;
+    u32 mask { 0 };
+    Atomic<u32, AK::MemoryOrder::memory_order_relaxed> runnable_count { 0 };
+    static constexpr size_t count = sizeof(mask) * 8;
+    ThreadReadyQueue queues[count];
+
+    Thread* pull_next_runnable_thread(u32 affinity_mask);
+};
+
+static constexpr u32 g_ready_queue_buckets = ThreadReadyQueues::count;
+// Thread affinity masks are 32 bits wide, so this is the most processors we can ever schedule on
+static constexpr u32 g_max_scheduling_processors = sizeof(u32) * 8;
+READONLY_AFTER_INIT static ThreadReadyQueues* g_ready_queues; // g_max_scheduling_processors entries
+static Atomic<u32> g_scheduling_processors_mask { 0 };
 static void dump_thread_list();
 
 static inline u32 thread_priority_to_priority_index(u32 thread_priority)
@@ -69,16 +82,14 @@ static inline u32 thread_priority_to_priority_index(u32 thread_priority)
     return priority_bucket;
 }
 
-Thread& Scheduler::pull_next_runnable_thread()
+Thread* ThreadReadyQueues::pull_next_runnable_thread(u32 affinity_mask)
 {
-    auto affinity_mask = 1u << Processor::current().id();
-
-    ScopedSpinLock lock(g_ready_queues_lock);
-    auto priority_mask = g_ready_queues_mask;
+    ScopedSpinLock lock(this->lock);
+    auto priority_mask = mask;
     while (priority_mask != 0) {
         auto priority = __builtin_ffsl(priority_mask);
         VERIFY(priority > 0);
-        auto& ready_queue = g_ready_queues[--priority];
+        auto& ready_queue = queues[--priority];
         for (auto& thread : ready_queue.thread_list) {
             VERIFY(thread.m_runnable_priority == (int)priority);
             if (thread.is_active())
@@ -88,7 +99,8 @@ Thread& Scheduler::pull_next_runnable_thread()
             thread.m_runnable_priority = -1;
             ready_queue.thread_list.remove(thread);
             if (ready_queue.thread_list.is_empty())
-                g_ready_queues_mask &= ~(1u << priority);
+                mask &= ~(1u << priority);
+            runnable_count--;
             // Mark it as active because we are using this thread. This is similar
             // to comparing it with Processor::current_thread, but when there are
             // multiple processors there's no easy way to check whether the thread
@@ -100,10 +112,38 @@ Thread& Scheduler::pull_next_runnable_thread()
             // switching to it.
             // FIXME: Figure out a better way maybe?
             thread.set_active(true);
-            return thread;
+            return &thread;
         }
         priority_mask &= ~(1u << priority);
     }
+    return nullptr;
+}
+
+Thread& Scheduler::pull_next_runnable_thread()
+{
+    auto cpu = Processor::current().id();
+    auto affinity_mask = 1u << cpu;
+
+    if (auto* thread = g_ready_queues[cpu].pull_next_runnable_thread(affinity_mask))
+        return *thread;
+
+    // Our own queues are empty, see if any other processor has more work
+    // than it can handle right now. Start with our neighbor so that idle
+    // processors don't all pile onto the same victim.
+    auto victims = g_scheduling_processors_mask.load(AK::MemoryOrder::memory_order_relaxed) & ~affinity_mask;
+    for (u32 i = 1; victims != 0 && i < g_max_scheduling_processors; i++) {
+        auto victim = (cpu + i) % g_max_scheduling_processors;
+        if (!(victims & (1u << victim)))
+            continue;
+        victims &= ~(1u << victim);
+        auto& victim_queues = g_ready_queues[victim];
+        if (victim_queues.runnable_count == 0)
+            continue;
+        if (auto* thread = victim_queues.pull_next_runnable_thread(affinity_mask)) {
+            dbgln_if(SCHEDULER_DEBUG, "Scheduler[{}]: Stole {} from processor {}", cpu, *thread, victim);
+            return *thread;
+        }
+    }
     return *Processor::idle_thread();
 }
 
@@ -111,7 +151,8 @@ bool Scheduler::dequeue_runnable_thread(Thread& thread, bool check_affinity)
 {
     if (thread.is_idle_thread())
         return true;
-    ScopedSpinLock lock(g_ready_queues_lock);
+    auto& ready_queues = g_ready_queues[thread.m_runnable_cpu];
+    ScopedSpinLock lock(ready_queues.lock);
     auto priority = thread.m_runnable_priority;
     if (priority < 0) {
         VERIFY(!thread.m_ready_queue_node.is_in_list());
@@ -121,31 +162,80 @@ bool Scheduler::dequeue_runnable_thread(Thread& thread, bool check_affinity)
     if (check_affinity && !(thread.affinity() & (1 << Processor::current().id())))
         return false;
 
-    VERIFY(g_ready_queues_mask & (1u << priority));
-    auto& ready_queue = g_ready_queues[priority];
+    VERIFY(ready_queues.mask & (1u << priority));
+    auto& ready_queue = ready_queues.queues[priority];
     thread.m_runnable_priority = -1;
     ready_queue.thread_list.remove(thread);
     if (ready_queue.thread_list.is_empty())
-        g_ready_queues_mask &= ~(1u << priority);
+        ready_queues.mask &= ~(1u << priority);
+    ready_queues.runnable_count--;
     return true;
 }
 
+static u32 select_processor_for(const Thread& thread)
+{
+    auto candidates = thread.affinity() & g_scheduling_processors_mask.load(AK::MemoryOrder::memory_order_relaxed);
+    if (candidates == 0) {
+        // None of the processors this thread may run on are scheduling yet
+        // (e.g. during early boot). Park it on the first one it's allowed on,
+        // it'll get picked up as soon as that processor starts scheduling.
+        if (thread.affinity() == 0)
+            return 0;
+        return __builtin_ffsl(thread.affinity()) - 1;
+    }
+
+    // Prefer the processor this thread last ran on, its caches are most likely
+    // still warm. Only move it elsewhere if there's a noticeably less busy candidate.
+    auto preferred_cpu = thread.cpu();
+    u32 best_cpu = preferred_cpu;
+    u32 best_load = NumericLimits<u32>::max();
+    if (candidates & (1u << preferred_cpu))
+        best_load = g_ready_queues[preferred_cpu].runnable_count;
+    if (best_load == 0)
+        return preferred_cpu;
+
+    auto current_cpu = Processor::id();
+    for (auto remaining = candidates; remaining != 0;) {
+        u32 cpu = __builtin_ffsl(remaining) - 1;
+        remaining &= ~(1u << cpu);
+        u32 load = g_ready_queues[cpu].runnable_count;
+        // Bias slightly towards the current processor, waking a thread
+        // here doesn't require poking another processor.
+        if (cpu == current_cpu && load > 0)
+            load--;
+        if (load + 1 < best_load) {
+            best_cpu = cpu;
+            best_load = load;
+        }
+    }
+    return best_cpu;
+}
+
 void Scheduler::queue_runnable_thread(Thread& thread)
 {
-    VERIFY(g_scheduler_lock.own_lock());
     if (thread.is_idle_thread())
         return;
     auto priority = thread_priority_to_priority_index(thread.priority());
+    auto cpu = select_processor_for(thread);
+    TRACEPOINT(sched_wakeup, thread.tid().value(), cpu);
 
-    ScopedSpinLock lock(g_ready_queues_lock);
+    auto& ready_queues = g_ready_queues[cpu];
+    ScopedSpinLock lock(ready_queues.lock);
     VERIFY(thread.m_runnable_priority < 0);
     thread.m_runnable_priority = (int)priority;
+    thread.m_runnable_cpu = cpu;
     VERIFY(!thread.m_ready_queue_node.is_in_list());
-    auto& ready_queue = g_ready_queues[priority];
+    auto& ready_queue = ready_queues.queues[priority];
     bool was_empty = ready_queue.thread_list.is_empty();
     ready_queue.thread_list.append(thread);
     if (was_empty)
-        g_ready_queues_mask |= (1u << priority);
+        ready_queues.mask |= (1u << priority);
+    ready_queues.runnable_count++;
+}
+
+u32 Scheduler::scheduling_processors_mask()
+{
+    return g_scheduling_processors_mask.load(AK::MemoryOrder::memory_order_relaxed);
 }
 
 UNMAP_AFTER_INIT void Scheduler::start()
@@ -159,6 +249,8 @@ UNMAP_AFTER_INIT void Scheduler::start()
     auto& processor = Processor::current();
     processor.set_scheduler_data(*new SchedulerPerProcessorData());
     VERIFY(processor.is_initialized());
+    VERIFY(processor.get_id() < g_max_scheduling_processors);
+    g_scheduling_processors_mask.fetch_or(1u << processor.get_id());
     auto& idle_thread = *Processor::idle_thread();
     VERIFY(processor.current_thread() == &idle_thread);
     idle_thread.set_ticks_left(time_slice_for(idle_thread));
@@ -190,6 +282,11 @@ bool Scheduler::pick_next()
             scheduler_data.m_in_scheduler = false;
         });
 
+    // Finding the next thread only needs the ready queue locks, so look for
+    // it before taking the scheduler lock. The thread is marked active, so
+    // no other processor will pick it in the meantime.
+    auto* thread_to_schedule = &pull_next_runnable_thread();
+
     ScopedSpinLock lock(g_scheduler_lock);
 
     auto current_thread = Thread::current();
@@ -205,6 +302,8 @@ bool Scheduler::pick_next()
 
     auto pending_beneficiary = scheduler_data.m_pending_beneficiary.strong_ref();
     if (pending_beneficiary && dequeue_runnable_thread(*pending_beneficiary, true)) {
+        give_back_pulled_thread(*thread_to_schedule);
+
         // The thread we're supposed to donate to still exists and we can
         const char* reason = scheduler_data.m_pending_donate_reason;
         scheduler_data.m_pending_beneficiary = nullptr;
@@ -223,20 +322,41 @@ bool Scheduler::pick_next()
     scheduler_data.m_pending_beneficiary = nullptr;
     scheduler_data.m_pending_donate_reason = nullptr;
 
-    auto& thread_to_schedule = pull_next_runnable_thread();
+    // The thread may have been stopped, queued again or moved to other processors
+    // before we got the scheduler lock. In that case, look again while holding it.
+    if (!thread_to_schedule->is_idle_thread()
+        && (thread_to_schedule->state() != Thread::Runnable || thread_to_schedule->m_runnable_priority >= 0 || !(thread_to_schedule->affinity() & (1u << Processor::id())))) {
+        give_back_pulled_thread(*thread_to_schedule);
+        thread_to_schedule = &pull_next_runnable_thread();
+    }
+
     if constexpr (SCHEDULER_DEBUG) {
         dbgln("Scheduler[{}]: Switch to {} @ {:04x}:{:08x}",
             Processor::id(),
-            thread_to_schedule,
-            thread_to_schedule.tss().cs, thread_to_schedule.tss().eip);
+            *thread_to_schedule,
+            thread_to_schedule->tss().cs, thread_to_schedule->tss().eip);
     }
 
     // We need to leave our first critical section before switching context,
     // but since we're still holding the scheduler lock we're still in a critical section
     critical.leave();
 
-    thread_to_schedule.set_ticks_left(time_slice_for(thread_to_schedule));
-    return context_switch(&thread_to_schedule);
+    thread_to_schedule->set_ticks_left(time_slice_for(*thread_to_schedule));
+    return context_switch(thread_to_schedule);
+}
+
+void Scheduler::give_back_pulled_thread(Thread& thread)
+{
+    VERIFY(g_scheduler_lock.own_lock());
+    if (thread.is_idle_thread())
+        return;
+    thread.set_active(false);
+    if (thread.state() == Thread::Dying) {
+        // Nobody else could finalize it while we were holding on to it.
+        notify_finalizer();
+    } else if (thread.state() == Thread::Runnable && thread.m_runnable_priority < 0) {
+        queue_runnable_thread(thread);
+    }
 }
 
 bool Scheduler::yield()
@@ -446,7 +566,7 @@ UNMAP_AFTER_INIT void Scheduler::initialize()
 
     RefPtr<Thread> idle_thread;
     g_finalizer_wait_queue = new WaitQueue;
-    g_ready_queues = new ThreadReadyQueue[g_ready_queue_buckets];
+    g_ready_queues = new ThreadReadyQueues[g_max_scheduling_processors];
 
     g_finalizer_has_work.store(false, AK::MemoryOrder::memory_order_release);
     s_colonel_process = Process::create_kernel_process(idle_thread, "colonel", idle_loop, nullptr, 1).leak_ref();
@@ -490,11 +610,6 @@ void Scheduler::timer_tick(const RegisterState& regs)
     VERIFY(current_thread->current_trap());
     VERIFY(current_thread->current_trap()->regs == &regs);
 
-#if !SCHEDULE_ON_ALL_PROCESSORS
-    if (!Processor::is_bootstrap_processor())
-        return; // TODO: This prevents scheduling on other CPUs!
-#endif
-
     if (current_thread->tick())
         return;
 
@@ -549,17 +664,17 @@ void Scheduler::idle_loop(void*)
 
         proc.idle_end();
         VERIFY_INTERRUPTS_ENABLED();
-#if SCHEDULE_ON_ALL_PROCESSORS
         yield();
-#else
-        if (Processor::current().id() == 0)
-            yield();
-#endif
     }
 }
 
 void Scheduler::dump_scheduler_state()
 {
+    auto scheduling_processors = g_scheduling_processors_mask.load();
+    for (u32 cpu = 0; cpu < g_max_scheduling_processors; cpu++) {
+        if (scheduling_processors & (1u << cpu))
+            dbgln("Scheduler: Processor {} has {} runnable threads queued", cpu, g_ready_queues[cpu].runnable_count.load());
+    }
     dump_thread_list();
 }
 
@@ -48,8 +48,10 @@ public:
     static void invoke_async();
     static void notify_finalizer();
     static Thread& pull_next_runnable_thread();
+    static void give_back_pulled_thread(Thread&);
     static bool dequeue_runnable_thread(Thread&, bool = false);
     static void queue_runnable_thread(Thread&);
+    static u32 scheduling_processors_mask();
     static void dump_scheduler_state();
 };
 
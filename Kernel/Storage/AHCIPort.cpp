@@ -45,12 +45,13 @@ AHCIPort::AHCIPort(const AHCIPortHandler& handler, volatile AHCI::PortRegisters&
     dbgln_if(AHCI_DEBUG, "AHCI Port {}: Command list page at {}", representative_port_index(), m_command_list_page->paddr());
     dbgln_if(AHCI_DEBUG, "AHCI Port {}: FIS receive page at {}", representative_port_index(), m_command_list_page->paddr());
 
-    for (size_t index = 0; index < 1; index++) {
+    size_t command_slots_count = m_parent_handler->hba_capabilities().max_command_list_entries_count;
+    for (size_t index = 0; index < command_slots_count; index++) {
         m_dma_buffers.append(MM.allocate_supervisor_physical_page().release_nonnull());
-    }
-    for (size_t index = 0; index < 1; index++) {
         m_command_table_pages.append(MM.allocate_supervisor_physical_page().release_nonnull());
+        m_command_table_regions.append(MM.allocate_kernel_region(m_command_table_pages[index].paddr(), PAGE_SIZE, "AHCI Command Table", Region::Access::Read | Region::Access::Write, Region::Cacheable::No).release_nonnull());
     }
+    m_command_slots.resize(command_slots_count);
     m_command_list_region = MM.allocate_kernel_region(m_command_list_page->paddr(), PAGE_SIZE, "AHCI Port Command List", Region::Access::Read | Region::Access::Write, Region::Cacheable::No);
     dbgln_if(AHCI_DEBUG, "AHCI Port {}: Command list region at {}", representative_port_index(), m_command_list_region->vaddr());
 }
@@ -85,38 +86,82 @@ void AHCIPort::handle_interrupt()
         });
         return;
     }
-    if (m_interrupt_status.is_set(AHCI::PortInterruptFlag::DHR) || m_interrupt_status.is_set(AHCI::PortInterruptFlag::PS)) {
+    if (m_interrupt_status.is_set(AHCI::PortInterruptFlag::DHR) || m_interrupt_status.is_set(AHCI::PortInterruptFlag::PS) || m_interrupt_status.is_set(AHCI::PortInterruptFlag::SDB)) {
         m_wait_for_completion = false;
 
-        // Now schedule reading/writing the buffer as soon as we leave the irq handler.
-        // This is important so that we can safely access the buffers, which could
-        // trigger page faults
-        if (!m_current_request) {
+        // Clear the status before looking at which commands are done, so a command
+        // that finishes while we're in here raises another interrupt.
+        m_interrupt_status.clear();
+
+        u32 finished_command_slots = 0;
+        {
+            ScopedSpinLock lock(m_hard_lock);
+            // Queued commands stay set in PxSACT until the device tells us they're done
+            // with a Set Device Bits FIS, and the others stay set in PxCI.
+            u32 running_command_slots = m_port_registers.sact | m_port_registers.ci;
+            finished_command_slots = m_active_command_slots & ~running_command_slots & ~m_completing_command_slots;
+            m_completing_command_slots |= finished_command_slots;
+        }
+
+        if (finished_command_slots == 0) {
             dbgln_if(AHCI_DEBUG, "AHCI Port {}: Request handled, probably identify request", representative_port_index());
-        } else {
-            g_io_work->queue([this]() {
-                dbgln_if(AHCI_DEBUG, "AHCI Port {}: Request handled", representative_port_index());
-                Locker locker(m_lock);
-                VERIFY(m_current_request);
-                VERIFY(m_current_scatter_list);
-                if (m_current_request->request_type() == AsyncBlockDeviceRequest::Read) {
-                    if (!m_current_request->write_to_buffer(m_current_request->buffer(), m_current_scatter_list->dma_region().as_ptr(), m_connected_device->block_size() * m_current_request->block_count())) {
-                        dbgln_if(AHCI_DEBUG, "AHCI Port {}: Request failure, memory fault occurred when reading in data.", representative_port_index());
-                        m_current_scatter_list = nullptr;
-                        complete_current_request(AsyncDeviceRequest::MemoryFault);
-                        return;
-                    }
-                }
-                m_current_scatter_list = nullptr;
-                dbgln_if(AHCI_DEBUG, "AHCI Port {}: Request success", representative_port_index());
-                complete_current_request(AsyncDeviceRequest::Success);
-            });
+            return;
         }
+
+        // Now schedule reading/writing the buffers as soon as we leave the irq handler.
+        // This is important so that we can safely access the buffers, which could
+        // trigger page faults
+        g_io_work->queue([this, finished_command_slots]() {
+            complete_finished_commands(finished_command_slots);
+        });
+        return;
     }
 
     m_interrupt_status.clear();
 }
 
+void AHCIPort::complete_finished_commands(u32 finished_command_slots)
+{
+    for (u8 index = 0; index < m_command_slots.size(); index++) {
+        if (!(finished_command_slots & (1u << index)))
+            continue;
+
+        Locker locker(m_lock);
+        CommandSlot slot;
+        {
+            ScopedSpinLock lock(m_hard_lock);
+            // The request was failed already if we had to recover from an error in the meantime.
+            if (!(m_completing_command_slots & (1u << index)))
+                continue;
+            slot = release_command_slot(index);
+        }
+        VERIFY(slot.request);
+        VERIFY(slot.scatter_list);
+
+        auto result = AsyncDeviceRequest::Success;
+        auto& request = *slot.request;
+        if (request.request_type() == AsyncBlockDeviceRequest::Read) {
+            if (!request.write_to_buffer(request.buffer(), slot.scatter_list->dma_region().as_ptr(), m_connected_device->block_size() * request.block_count())) {
+                dbgln_if(AHCI_DEBUG, "AHCI Port {}: Request failure, memory fault occurred when reading in data.", representative_port_index());
+                result = AsyncDeviceRequest::MemoryFault;
+            }
+        }
+        locker.unlock();
+
+        dbgln_if(AHCI_DEBUG, "AHCI Port {}: Request in command slot {} handled", representative_port_index(), index);
+        request.complete(result);
+    }
+}
+
+AHCIPort::CommandSlot AHCIPort::release_command_slot(u8 command_slot_index)
+{
+    VERIFY(m_lock.is_locked());
+    VERIFY(m_hard_lock.is_locked());
+    m_active_command_slots &= ~(1u << command_slot_index);
+    m_completing_command_slots &= ~(1u << command_slot_index);
+    return move(m_command_slots[command_slot_index]);
+}
+
 bool AHCIPort::is_interrupts_enabled() const
 {
     return !m_interrupt_enable.is_cleared();
@@ -124,13 +169,27 @@ bool AHCIPort::is_interrupts_enabled() const
 
 void AHCIPort::recover_from_fatal_error()
 {
-    Locker locker(m_lock);
-    ScopedSpinLock lock(m_hard_lock);
-    dmesgln("{}: AHCI Port {} fatal error, shutting down!", m_parent_handler->hba_controller()->pci_address(), representative_port_index());
-    dmesgln("{}: AHCI Port {} fatal error, SError {}", m_parent_handler->hba_controller()->pci_address(), representative_port_index(), (u32)m_port_registers.serr);
-    stop_command_list_processing();
-    stop_fis_receiving();
-    m_interrupt_enable.clear();
+    NonnullRefPtrVector<AsyncBlockDeviceRequest> failed_requests;
+    {
+        Locker locker(m_lock);
+        ScopedSpinLock lock(m_hard_lock);
+        dmesgln("{}: AHCI Port {} fatal error, shutting down!", m_parent_handler->hba_controller()->pci_address(), representative_port_index());
+        dmesgln("{}: AHCI Port {} fatal error, SError {}", m_parent_handler->hba_controller()->pci_address(), representative_port_index(), (u32)m_port_registers.serr);
+        stop_command_list_processing();
+        stop_fis_receiving();
+        m_interrupt_enable.clear();
+
+        // None of the commands that were in flight are going to finish now.
+        for (u8 index = 0; index < m_command_slots.size(); index++) {
+            auto slot = release_command_slot(index);
+            if (slot.request)
+                failed_requests.append(slot.request.release_nonnull());
+        }
+    }
+
+    // Completing a request can start the next one, which takes the locks again.
+    for (auto& request : failed_requests)
+        request.complete(AsyncDeviceRequest::Failure);
 }
 
 void AHCIPort::eject()
@@ -160,8 +219,7 @@ void AHCIPort::eject()
     // handshake error bit in PxSERR register if CFL is incorrect.
     command_list_entries[unused_command_header.value()].attributes = (size_t)FIS::DwordCount::RegisterHostToDevice | AHCI::CommandHeaderAttributes::P | AHCI::CommandHeaderAttributes::C | AHCI::CommandHeaderAttributes::A;
 
-    auto command_table_region = MM.allocate_kernel_region(m_command_table_pages[unused_command_header.value()].paddr().page_base(), page_round_up(sizeof(AHCI::CommandTable)), "AHCI Command Table", Region::Access::Read | Region::Access::Write, Region::Cacheable::No);
-    auto& command_table = *(volatile AHCI::CommandTable*)command_table_region->vaddr().as_ptr();
+    auto& command_table = this->command_table(unused_command_header.value());
     memset(const_cast<u8*>(command_table.command_fis), 0, 64);
     auto& fis = *(volatile FIS::HostToDevice::Register*)command_table.command_fis;
     fis.header.fis_type = (u8)FIS::Type::RegisterHostToDevice;
@@ -290,6 +348,14 @@ bool AHCIPort::initialize(ScopedSpinLock<SpinLock<u8>>& main_lock)
             m_port_registers.cmd = m_port_registers.cmd | (1 << 24);
         }
 
+        // Both the HBA and the device have to support NCQ for us to queue up more than one command (word 76, bit 8).
+        m_native_command_queuing_enabled = !is_atapi_attached() && m_parent_handler->hba_capabilities().native_command_queuing_supported && (identify_block->serial_ata_capabilities & (1 << 8));
+        if (m_native_command_queuing_enabled)
+            m_command_queue_depth = min(m_command_slots.size(), static_cast<size_t>((identify_block->queue_depth & 0x1f) + 1));
+        else
+            m_command_queue_depth = 1;
+        dbgln_if(AHCI_DEBUG, "AHCI Port {}: NCQ {}, command queue depth {}", representative_port_index(), m_native_command_queuing_enabled ? "enabled" : "disabled", m_command_queue_depth);
+
         dmesgln("AHCI Port {}: Device found, Capacity={}, Bytes per logical sector={}, Bytes per physical sector={}", representative_port_index(), max_addressable_sector * logical_sector_size, logical_sector_size, physical_sector_size);
 
         // FIXME: We don't support ATAPI devices yet, so for now we don't "create" them
@@ -424,25 +490,26 @@ size_t AHCIPort::calculate_descriptors_count(size_t block_count) const
 {
     VERIFY(m_connected_device);
     size_t needed_dma_regions_count = page_round_up((block_count * m_connected_device->block_size())) / PAGE_SIZE;
-    VERIFY(needed_dma_regions_count <= m_dma_buffers.size());
+    // Every command slot has a single page to transfer data in.
+    VERIFY(needed_dma_regions_count <= 1);
     return needed_dma_regions_count;
 }
 
-Optional<AsyncDeviceRequest::RequestResult> AHCIPort::prepare_and_set_scatter_list(AsyncBlockDeviceRequest& request)
+Optional<AsyncDeviceRequest::RequestResult> AHCIPort::prepare_and_set_scatter_list(u8 command_slot_index, AsyncBlockDeviceRequest& request)
 {
     VERIFY(m_lock.is_locked());
     VERIFY(request.block_count() > 0);
 
     NonnullRefPtrVector<PhysicalPage> allocated_dma_regions;
-    for (size_t index = 0; index < calculate_descriptors_count(request.block_count()); index++) {
-        allocated_dma_regions.append(m_dma_buffers.at(index));
-    }
+    if (calculate_descriptors_count(request.block_count()) > 0)
+        allocated_dma_regions.append(m_dma_buffers.at(command_slot_index));
 
-    m_current_scatter_list = ScatterGatherList::create(request, move(allocated_dma_regions), m_connected_device->block_size());
-    if (!m_current_scatter_list)
+    auto& scatter_list = m_command_slots[command_slot_index].scatter_list;
+    scatter_list = ScatterGatherList::create(request, move(allocated_dma_regions), m_connected_device->block_size());
+    if (!scatter_list)
         return AsyncDeviceRequest::Failure;
     if (request.request_type() == AsyncBlockDeviceRequest::Write) {
-        if (!request.read_from_buffer(request.buffer(), m_current_scatter_list->dma_region().as_ptr(), m_connected_device->block_size() * request.block_count())) {
+        if (!request.read_from_buffer(request.buffer(), scatter_list->dma_region().as_ptr(), m_connected_device->block_size() * request.block_count())) {
             return AsyncDeviceRequest::MemoryFault;
         }
     }
@@ -453,36 +520,35 @@ void AHCIPort::start_request(AsyncBlockDeviceRequest& request)
 {
     Locker locker(m_lock);
     dbgln_if(AHCI_DEBUG, "AHCI Port {}: Request start", representative_port_index());
-    VERIFY(!m_current_request);
-    VERIFY(!m_current_scatter_list);
 
-    m_current_request = request;
-
-    auto result = prepare_and_set_scatter_list(request);
-    if (result.has_value()) {
-        dbgln_if(AHCI_DEBUG, "AHCI Port {}: Request failure.", representative_port_index());
+    // We stop processing commands when recovering from a fatal error.
+    if (!is_operable()) {
+        dbgln_if(AHCI_DEBUG, "AHCI Port {}: Request failure, port is not operable.", representative_port_index());
         locker.unlock();
-        complete_current_request(result.value());
+        request.complete(AsyncDeviceRequest::Failure);
         return;
     }
 
-    auto success = access_device(request.request_type(), request.block_index(), request.block_count());
-    if (!success) {
+    // The device never starts more requests than our command queue depth, so there is always a free slot.
+    auto command_slot_index = try_to_find_unused_command_header();
+    VERIFY(command_slot_index.has_value());
+    m_command_slots[command_slot_index.value()].request = request;
+
+    Optional<AsyncDeviceRequest::RequestResult> result = prepare_and_set_scatter_list(command_slot_index.value(), request);
+    if (!result.has_value() && !access_device(command_slot_index.value(), request.request_type(), request.block_index(), request.block_count()))
+        result = AsyncDeviceRequest::Failure;
+
+    if (result.has_value()) {
         dbgln_if(AHCI_DEBUG, "AHCI Port {}: Request failure.", representative_port_index());
+        {
+            ScopedSpinLock lock(m_hard_lock);
+            release_command_slot(command_slot_index.value());
+        }
         locker.unlock();
-        complete_current_request(AsyncDeviceRequest::Failure);
-        return;
+        request.complete(result.value());
     }
 }
 
-void AHCIPort::complete_current_request(AsyncDeviceRequest::RequestResult result)
-{
-    VERIFY(m_current_request);
-    auto current_request = m_current_request;
-    m_current_request.clear();
-    current_request->complete(result);
-}
-
 bool AHCIPort::spin_until_ready() const
 {
     VERIFY(m_lock.is_locked());
@@ -499,44 +565,41 @@ bool AHCIPort::spin_until_ready() const
     return true;
 }
 
-bool AHCIPort::access_device(AsyncBlockDeviceRequest::RequestType direction, u64 lba, u8 block_count)
+bool AHCIPort::access_device(u8 command_slot_index, AsyncBlockDeviceRequest::RequestType direction, u64 lba, u8 block_count)
 {
     VERIFY(m_connected_device);
     VERIFY(is_operable());
     VERIFY(m_lock.is_locked());
-    VERIFY(m_current_scatter_list);
+    auto& scatter_list = m_command_slots[command_slot_index].scatter_list;
+    VERIFY(scatter_list);
     ScopedSpinLock lock(m_hard_lock);
 
     dbgln_if(AHCI_DEBUG, "AHCI Port {}: Do a {}, lba {}, block count {}", representative_port_index(), direction == AsyncBlockDeviceRequest::RequestType::Write ? "write" : "read", lba, block_count);
-    if (!spin_until_ready())
+    // Queued commands can be issued while others are still running.
+    if (!m_native_command_queuing_enabled && !spin_until_ready())
         return false;
 
-    auto unused_command_header = try_to_find_unused_command_header();
-    VERIFY(unused_command_header.has_value());
     auto* command_list_entries = (volatile AHCI::CommandHeader*)m_command_list_region->vaddr().as_ptr();
-    command_list_entries[unused_command_header.value()].ctba = m_command_table_pages[unused_command_header.value()].paddr().get();
-    command_list_entries[unused_command_header.value()].ctbau = 0;
-    command_list_entries[unused_command_header.value()].prdbc = 0;
-    command_list_entries[unused_command_header.value()].prdtl = m_current_scatter_list->scatters_count();
+    command_list_entries[command_slot_index].ctba = m_command_table_pages[command_slot_index].paddr().get();
+    command_list_entries[command_slot_index].ctbau = 0;
+    command_list_entries[command_slot_index].prdbc = 0;
+    command_list_entries[command_slot_index].prdtl = scatter_list->scatters_count();
 
     // Note: we must set the correct Dword count in this register. Real hardware
     // AHCI controllers do care about this field! QEMU doesn't care if we don't
     // set the correct CFL field in this register, real hardware will set an
     // handshake error bit in PxSERR register if CFL is incorrect.
-    command_list_entries[unused_command_header.value()].attributes = (size_t)FIS::DwordCount::RegisterHostToDevice | AHCI::CommandHeaderAttributes::P | (is_atapi_attached() ? AHCI::CommandHeaderAttributes::A : 0) | (direction == AsyncBlockDeviceRequest::RequestType::Write ? AHCI::CommandHeaderAttributes::W : 0);
-
-    dbgln_if(AHCI_DEBUG, "AHCI Port {}: CLE: ctba=0x{:08x}, ctbau=0x{:08x}, prdbc=0x{:08x}, prdtl=0x{:04x}, attributes=0x{:04x}", representative_port_index(), (u32)command_list_entries[unused_command_header.value()].ctba, (u32)command_list_entries[unused_command_header.value()].ctbau, (u32)command_list_entries[unused_command_header.value()].prdbc, (u16)command_list_entries[unused_command_header.value()].prdtl, (u16)command_list_entries[unused_command_header.value()].attributes);
+    command_list_entries[command_slot_index].attributes = (size_t)FIS::DwordCount::RegisterHostToDevice | AHCI::CommandHeaderAttributes::P | (is_atapi_attached() ? AHCI::CommandHeaderAttributes::A : 0) | (direction == AsyncBlockDeviceRequest::RequestType::Write ? AHCI::CommandHeaderAttributes::W : 0);
 
-    auto command_table_region = MM.allocate_kernel_region(m_command_table_pages[unused_command_header.value()].paddr().page_base(), page_round_up(sizeof(AHCI::CommandTable)), "AHCI Command Table", Region::Access::Read | Region::Access::Write, Region::Cacheable::No);
-    auto& command_table = *(volatile AHCI::CommandTable*)command_table_region->vaddr().as_ptr();
+    dbgln_if(AHCI_DEBUG, "AHCI Port {}: CLE: ctba=0x{:08x}, ctbau=0x{:08x}, prdbc=0x{:08x}, prdtl=0x{:04x}, attributes=0x{:04x}", representative_port_index(), (u32)command_list_entries[command_slot_index].ctba, (u32)command_list_entries[command_slot_index].ctbau, (u32)command_list_entries[command_slot_index].prdbc, (u16)command_list_entries[command_slot_index].prdtl, (u16)command_list_entries[command_slot_index].attributes);
 
-    dbgln_if(AHCI_DEBUG, "AHCI Port {}: Allocated command table at {}", representative_port_index(), command_table_region->vaddr());
+    auto& command_table = this->command_table(command_slot_index);
 
     memset(const_cast<u8*>(command_table.command_fis), 0, 64);
 
     size_t scatter_entry_index = 0;
     size_t data_transfer_count = (block_count * m_connected_device->block_size());
-    for (auto scatter_page : m_current_scatter_list->vmobject().physical_pages()) {
+    for (auto scatter_page : scatter_list->vmobject().physical_pages()) {
         VERIFY(data_transfer_count != 0);
         VERIFY(scatter_page);
         dbgln_if(AHCI_DEBUG, "AHCI Port {}: Add a transfer scatter entry @ {}", representative_port_index(), scatter_page->paddr());
@@ -560,6 +623,11 @@ bool AHCIPort::access_device(AsyncBlockDeviceRequest::RequestType direction, u64
     if (is_atapi_attached()) {
         fis.command = ATA_CMD_PACKET;
         TODO();
+    } else if (m_native_command_queuing_enabled) {
+        if (direction == AsyncBlockDeviceRequest::RequestType::Write)
+            fis.command = ATA_CMD_WRITE_FPDMA_QUEUED;
+        else
+            fis.command = ATA_CMD_READ_FPDMA_QUEUED;
     } else {
         if (direction == AsyncBlockDeviceRequest::RequestType::Write)
             fis.command = ATA_CMD_WRITE_DMA_EXT;
@@ -578,17 +646,28 @@ bool AHCIPort::access_device(AsyncBlockDeviceRequest::RequestType direction, u64
     fis.lba_low[0] = lba & 0xff;
     fis.lba_low[1] = (lba >> 8) & 0xff;
     fis.lba_low[2] = (lba >> 16) & 0xff;
-    fis.count = (block_count);
+    if (m_native_command_queuing_enabled) {
+        // Queued commands take the block count in the features field, and their tag in the count field.
+        fis.features_low = block_count;
+        fis.features_high = 0;
+        fis.count = command_slot_index << 3;
+    } else {
+        fis.count = (block_count);
+    }
 
     // The below loop waits until the port is no longer busy before issuing a new command
-    if (!spin_until_ready())
+    if (!m_native_command_queuing_enabled && !spin_until_ready())
         return false;
 
     full_memory_barrier();
-    mark_command_header_ready_to_process(unused_command_header.value());
+    m_active_command_slots |= 1u << command_slot_index;
+    // The slot must be marked as active in PxSACT before the command is issued.
+    if (m_native_command_queuing_enabled)
+        m_port_registers.sact = 1u << command_slot_index;
+    mark_command_header_ready_to_process(command_slot_index);
     full_memory_barrier();
 
-    dbgln_if(AHCI_DEBUG, "AHCI Port {}: Do a {}, lba {}, block count {} @ {}, ended", representative_port_index(), direction == AsyncBlockDeviceRequest::RequestType::Write ? "write" : "read", lba, block_count, m_dma_buffers[0].paddr());
+    dbgln_if(AHCI_DEBUG, "AHCI Port {}: Do a {}, lba {}, block count {} @ {}, ended", representative_port_index(), direction == AsyncBlockDeviceRequest::RequestType::Write ? "write" : "read", lba, block_count, m_dma_buffers[command_slot_index].paddr());
     return true;
 }
 
@@ -611,8 +690,7 @@ bool AHCIPort::identify_device(ScopedSpinLock<SpinLock<u8>>& main_lock)
     // QEMU doesn't care if we don't set the correct CFL field in this register, real hardware will set an handshake error bit in PxSERR register.
     command_list_entries[unused_command_header.value()].attributes = (size_t)FIS::DwordCount::RegisterHostToDevice | AHCI::CommandHeaderAttributes::P;
 
-    auto command_table_region = MM.allocate_kernel_region(m_command_table_pages[unused_command_header.value()].paddr().page_base(), page_round_up(sizeof(AHCI::CommandTable)), "AHCI Command Table", Region::Access::Read | Region::Access::Write);
-    auto& command_table = *(volatile AHCI::CommandTable*)command_table_region->vaddr().as_ptr();
+    auto& command_table = this->command_table(unused_command_header.value());
     memset(const_cast<u8*>(command_table.command_fis), 0, 64);
     command_table.descriptors[0].base_high = 0;
     command_table.descriptors[0].base_low = m_parent_handler->get_identify_metadata_physical_region(m_port_index).get();
@@ -664,9 +742,9 @@ bool AHCIPort::shutdown()
 Optional<u8> AHCIPort::try_to_find_unused_command_header()
 {
     VERIFY(m_lock.is_locked());
-    u32 commands_issued = m_port_registers.ci;
-    for (size_t index = 0; index < 32; index++) {
-        if (!(commands_issued & 1)) {
+    u32 commands_issued = m_port_registers.ci | m_active_command_slots;
+    for (size_t index = 0; index < m_command_slots.size(); index++) {
+        if (!(commands_issued & 1) && !m_command_slots[index].request) {
             dbgln_if(AHCI_DEBUG, "AHCI Port {}: unused command header at index {}", representative_port_index(), index);
             return index;
         }
@@ -689,8 +767,6 @@ void AHCIPort::mark_command_header_ready_to_process(u8 command_header_index) con
     VERIFY(m_lock.is_locked());
     VERIFY(m_hard_lock.is_locked());
     VERIFY(is_operable());
-    VERIFY(!m_wait_for_completion);
-    m_wait_for_completion = true;
     dbgln_if(AHCI_DEBUG, "AHCI Port {}: Marking command header at index {} as ready to process.", representative_port_index(), command_header_index);
     m_port_registers.ci = 1 << command_header_index;
 }
@@ -6,8 +6,10 @@
 
 #pragma once
 
+#include <AK/NonnullOwnPtrVector.h>
 #include <AK/OwnPtr.h>
 #include <AK/RefPtr.h>
+#include <AK/Vector.h>
 #include <Kernel/Devices/Device.h>
 #include <Kernel/IO.h>
 #include <Kernel/Interrupts/IRQHandler.h>
@@ -44,11 +46,19 @@ public:
 
     RefPtr<StorageDevice> connected_device() const { return m_connected_device; }
 
+    // How many requests the connected device can have in flight at once.
+    size_t command_queue_depth() const { return m_command_queue_depth; }
+
     bool reset();
     UNMAP_AFTER_INIT bool initialize_without_reset();
     void handle_interrupt();
 
 private:
+    struct CommandSlot {
+        RefPtr<AsyncBlockDeviceRequest> request;
+        RefPtr<ScatterGatherList> scatter_list;
+    };
+
     bool is_phy_enabled() const { return (m_port_registers.ssts & 0xf) == 3; }
     bool initialize(ScopedSpinLock<SpinLock<u8>>&);
 
@@ -69,10 +79,12 @@ private:
     ALWAYS_INLINE void power_on() const;
 
     void start_request(AsyncBlockDeviceRequest&);
-    void complete_current_request(AsyncDeviceRequest::RequestResult);
-    bool access_device(AsyncBlockDeviceRequest::RequestType, u64 lba, u8 block_count);
+    void complete_finished_commands(u32 finished_command_slots);
+    CommandSlot release_command_slot(u8 command_slot_index);
+    bool access_device(u8 command_slot_index, AsyncBlockDeviceRequest::RequestType, u64 lba, u8 block_count);
     size_t calculate_descriptors_count(size_t block_count) const;
-    [[nodiscard]] Optional<AsyncDeviceRequest::RequestResult> prepare_and_set_scatter_list(AsyncBlockDeviceRequest& request);
+    [[nodiscard]] Optional<AsyncDeviceRequest::RequestResult> prepare_and_set_scatter_list(u8 command_slot_index, AsyncBlockDeviceRequest& request);
+    volatile AHCI::CommandTable& command_table(u8 command_slot_index) const { return *(volatile AHCI::CommandTable*)m_command_table_regions[command_slot_index].vaddr().as_ptr(); }
 
     ALWAYS_INLINE bool is_interrupts_enabled() const;
 
@@ -99,15 +111,25 @@ private:
     // Data members
 
     EntropySource m_entropy_source;
-    RefPtr<AsyncBlockDeviceRequest> m_current_request;
     SpinLock<u8> m_hard_lock;
     Lock m_lock { "AHCIPort" };
 
     mutable bool m_wait_for_completion { false };
     bool m_wait_connect_for_completion { false };
 
+    // Each command slot has its own command table and DMA buffer, so requests
+    // can be in flight in all of them at the same time.
+    Vector<CommandSlot> m_command_slots;
     NonnullRefPtrVector<PhysicalPage> m_dma_buffers;
     NonnullRefPtrVector<PhysicalPage> m_command_table_pages;
+    NonnullOwnPtrVector<Region> m_command_table_regions;
+    // The slots that were issued to the HBA, and the ones of those that are
+    // waiting for their completion to be handled in the IO work queue.
+    // Both are protected by m_hard_lock.
+    u32 m_active_command_slots { 0 };
+    u32 m_completing_command_slots { 0 };
+    size_t m_command_queue_depth { 1 };
+    bool m_native_command_queuing_enabled { false };
     RefPtr<PhysicalPage> m_command_list_page;
     OwnPtr<Region> m_command_list_region;
     RefPtr<PhysicalPage> m_fis_receive_page;
@@ -119,7 +141,6 @@ private:
     AHCI::PortInterruptStatusBitField m_interrupt_status;
     AHCI::PortInterruptEnableBitField m_interrupt_enable;
 
-    RefPtr<ScatterGatherList> m_current_scatter_list;
     bool m_disabled_by_firmware { false };
 };
 }
@@ -19,6 +19,9 @@ public:
 
     virtual void start_request(AsyncBlockDeviceRequest&) override;
 
+    // Every request is passed on to the disk, so we can have as many in flight as it can.
+    virtual size_t max_concurrent_requests() const override { return m_device->max_concurrent_requests(); }
+
     // ^BlockDevice
     virtual KResultOr<size_t> read(FileDescription&, u64, UserOrKernelBuffer&, size_t) override;
     virtual bool can_read(const FileDescription&, size_t) const override;
@@ -38,6 +38,11 @@ void SATADiskDevice::start_request(AsyncBlockDeviceRequest& request)
     m_port->start_request(request);
 }
 
+size_t SATADiskDevice::max_concurrent_requests() const
+{
+    return m_port->command_queue_depth();
+}
+
 String SATADiskDevice::device_name() const
 {
     return String::formatted("hd{:c}", 'a' + minor());
@@ -10,12 +10,15 @@
 #include <Kernel/Panic.h>
 #include <Kernel/Process.h>
 #include <Kernel/ThreadTracer.h>
+#include <Kernel/Tracepoint.h>
 #include <Kernel/VM/MemoryManager.h>
 
 namespace Kernel {
 
 extern "C" void syscall_handler(TrapFrame*) __attribute__((used));
+extern "C" bool sysenter_handler(TrapFrame*) __attribute__((used));
 extern "C" void syscall_asm_entry();
+extern "C" void sysenter_asm_entry();
 
 static void syscall_asm_entry_dummy() __attribute__((used));
 NEVER_INLINE void syscall_asm_entry_dummy()
@@ -49,12 +52,75 @@ NEVER_INLINE void syscall_asm_entry_dummy()
         "    call syscall_handler \n"
         "    movl %ebx, 0(%esp) \n" // push pointer to TrapFrame
         "    jmp common_trap_exit \n");
+
+    // SYSENTER loads the stack pointer with the current thread's kernel stack
+    // (see enter_thread_context), but saves nothing else. Build the same frame
+    // that "int $0x82" would, userspace passes its return address in edx and
+    // its stack pointer in ecx.
+    asm(
+        ".globl sysenter_asm_entry\n"
+        "sysenter_asm_entry:\n"
+        "    pushl $(" __STRINGIFY(GDT_SELECTOR_DATA3) " | 3)\n"
+        "    pushl %ecx\n"
+        "    pushfl\n"
+        "    orl $0x200, (%esp)\n" // SYSENTER cleared IF, userspace always runs with it set
+        "    pushl $(" __STRINGIFY(GDT_SELECTOR_CODE3) " | 3)\n"
+        "    pushl %edx\n"
+        "    pushl $0x0\n"
+        "    pusha\n"
+        "    pushl %ds\n"
+        "    pushl %es\n"
+        "    pushl %fs\n"
+        "    pushl %gs\n"
+        "    pushl %ss\n"
+        "    pushl $0x2\n" // don't run with any flags userspace may have set (AC, NT, TF, DF)
+        "    popfl\n"
+        "    mov $" __STRINGIFY(GDT_SELECTOR_DATA0) ", %ax\n"
+        "    mov %ax, %ds\n"
+        "    mov %ax, %es\n"
+        "    mov $" __STRINGIFY(GDT_SELECTOR_PROC) ", %ax\n"
+        "    mov %ax, %fs\n"
+        "    xor %esi, %esi\n"
+        "    xor %edi, %edi\n"
+        "    pushl %esp \n" // set TrapFrame::regs
+        "    subl $" __STRINGIFY(TRAP_FRAME_SIZE - 4) ", %esp \n"
+        "    movl %esp, %ebx \n"
+        "    pushl %ebx \n" // push pointer to TrapFrame
+        "    call enter_trap_no_irq \n"
+        "    sti\n"
+        "    movl %ebx, 0(%esp) \n" // push pointer to TrapFrame
+        "    call sysenter_handler \n"
+        "    movl %ebx, 0(%esp) \n" // push pointer to TrapFrame
+        "    testb %al, %al\n"
+        "    jz common_trap_exit\n"
+        "    cli\n"
+        "    call exit_trap \n"
+        "    addl $" __STRINGIFY(TRAP_FRAME_SIZE + 4) ", %esp\n" // pop TrapFrame and pointer to it
+        "    addl $4, %esp\n" // pop %ss
+        "    popl %gs\n"
+        "    popl %fs\n"
+        "    popl %es\n"
+        "    popl %ds\n"
+        "    popa\n"
+        "    addl $0x4, %esp\n" // skip exception_code, isr_number
+        "    movl (%esp), %edx\n" // eip
+        "    movl 12(%esp), %ecx\n" // userspace_esp
+        "    addl $8, %esp\n" // skip eip, cs
+        "    btrl $9, (%esp)\n" // keep interrupts disabled until SYSEXIT, STI takes effect after it
+        "    popfl\n"
+        "    sti\n"
+        "    sysexit\n");
 #elif ARCH(X86_64)
     asm(
         ".globl syscall_asm_entry\n"
         "syscall_asm_entry:\n"
         "    cli\n"
         "    hlt\n");
+    asm(
+        ".globl sysenter_asm_entry\n"
+        "sysenter_asm_entry:\n"
+        "    cli\n"
+        "    hlt\n");
 #endif
     // clang-format on
 }
@@ -196,11 +262,13 @@ NEVER_INLINE void syscall_handler(TrapFrame* trap)
     auto arg2 = regs.ecx;
     auto arg3 = regs.ebx;
 
+    TRACEPOINT(syscall_enter, function, arg1);
     auto result = Syscall::handle(regs, function, arg1, arg2, arg3);
     if (result.is_error())
         regs.eax = result.error();
     else
         regs.eax = result.value();
+    TRACEPOINT(syscall_exit, function, regs.eax);
 
     process.big_lock().unlock();
 
@@ -222,4 +290,35 @@ NEVER_INLINE void syscall_handler(TrapFrame* trap)
     VERIFY(!g_scheduler_lock.own_lock());
 }
 
+NEVER_INLINE bool sysenter_handler(TrapFrame* trap)
+{
+    static constexpr FlatPtr trap_flag = 1u << 8;
+    auto& regs = *trap->regs;
+
+    // The debug handler had to clear TF before the entry code saved the flags.
+    // Put it back, so a tracer sees it and we return through IRET, which
+    // single-steps into the next instruction just like after "int $0x82".
+    auto* current_thread = Thread::current();
+    if (current_thread->is_single_stepping_through_sysenter()) {
+        current_thread->set_single_stepping_through_sysenter(false);
+        regs.eflags |= trap_flag;
+    }
+
+    // SYSENTER needs edx and ecx for the return address and stack pointer,
+    // so userspace passes the first two arguments on its stack instead.
+    FlatPtr arguments[2];
+    if (!copy_from_user(arguments, (const FlatPtr*)regs.userspace_esp, sizeof(arguments)))
+        handle_crash(regs, "Bad stack on syscall entry", SIGSTKFLT);
+    regs.edx = arguments[0];
+    regs.ecx = arguments[1];
+
+    auto return_eip = regs.eip;
+    auto return_esp = regs.userspace_esp;
+    syscall_handler(trap);
+
+    // SYSEXIT can only go back to where we came from. If anything changed that
+    // (signal delivery, sigreturn, ptrace) or we're single-stepping, use IRET.
+    return regs.eip == return_eip && regs.userspace_esp == return_esp && !(regs.eflags & trap_flag);
+}
+
 }
@@ -7,6 +7,7 @@
 #include <AK/Time.h>
 #include <Kernel/Process.h>
 #include <Kernel/Time/TimeManagement.h>
+#include <Kernel/VM/MemoryManager.h>
 
 namespace Kernel {
 
@@ -121,4 +122,18 @@ KResultOr<int> Process::sys$gettimeofday(Userspace<timeval*> user_tv)
     return 0;
 }
 
+KResultOr<FlatPtr> Process::sys$map_time_page()
+{
+    REQUIRE_PROMISE(stdio);
+
+    auto range = space().page_directory().range_allocator().allocate_randomized(PAGE_SIZE, PAGE_SIZE);
+    if (!range.has_value())
+        return ENOMEM;
+
+    auto region_or_error = space().allocate_region_with_vmobject(range.value(), TimeManagement::the().time_page_vmobject(), 0, "Time page", PROT_READ, true);
+    if (region_or_error.is_error())
+        return region_or_error.error().error();
+    return region_or_error.value()->vaddr().get();
+}
+
 }
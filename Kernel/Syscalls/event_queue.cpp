@@ -0,0 +1,146 @@
+/*
+ * Copyright (c) 2021, the SerenityOS developers.
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#include <Kernel/API/EventQueue.h>
+#include <Kernel/FileSystem/EventQueue.h>
+#include <Kernel/FileSystem/FileDescription.h>
+#include <Kernel/Process.h>
+
+namespace Kernel {
+
+using BlockFlags = Thread::FileBlocker::BlockFlags;
+
+// Upper bound for the number of events reported by a single wait.
+static constexpr size_t max_events_per_wait = 256;
+
+KResultOr<int> Process::sys$create_event_queue(u32 flags)
+{
+    REQUIRE_PROMISE(stdio);
+
+    int fd = alloc_fd();
+    if (fd < 0)
+        return fd;
+
+    auto queue_or_error = EventQueue::create();
+    if (queue_or_error.is_error())
+        return queue_or_error.error();
+
+    auto description_or_error = FileDescription::create(*queue_or_error.value());
+    if (description_or_error.is_error())
+        return description_or_error.error();
+
+    m_fds[fd].set(description_or_error.release_value());
+    m_fds[fd].description()->set_readable(true);
+
+    if (flags & static_cast<unsigned>(EventQueueFlags::CloseOnExec))
+        m_fds[fd].set_flags(m_fds[fd].flags() | FD_CLOEXEC);
+
+    return fd;
+}
+
+KResultOr<int> Process::sys$event_queue_ctl(Userspace<const Syscall::SC_event_queue_ctl_params*> user_params)
+{
+    REQUIRE_PROMISE(stdio);
+
+    Syscall::SC_event_queue_ctl_params params;
+    if (!copy_from_user(&params, user_params))
+        return EFAULT;
+
+    auto queue_description = file_description(params.queue_fd);
+    if (!queue_description)
+        return EBADF;
+    auto queue = queue_description->event_queue();
+    if (!queue)
+        return EBADF;
+
+    auto operation = static_cast<EventQueueOperation>(params.operation);
+    if (operation == EventQueueOperation::Remove) {
+        // NOTE: The fd may already have been closed, the interest is only
+        //       looked up by number.
+        auto result = queue->remove_interest(params.fd);
+        if (result.is_error())
+            return result;
+        return 0;
+    }
+
+    auto events = static_cast<EventQueueEvents>(params.events);
+    if ((events & ~(EventQueueEvents::Read | EventQueueEvents::Write | EventQueueEvents::EdgeTriggered)) != EventQueueEvents::None)
+        return EINVAL;
+
+    auto description = file_description(params.fd);
+    if (!description)
+        return EBADF;
+    // Event queues would have to notify each other from within their block
+    // conditions, so don't allow nesting them.
+    if (description->is_event_queue())
+        return EINVAL;
+
+    KResult result = KSuccess;
+    switch (operation) {
+    case EventQueueOperation::Add:
+        result = queue->add_interest(params.fd, *description, events, params.user_data);
+        break;
+    case EventQueueOperation::Modify:
+        result = queue->modify_interest(params.fd, *description, events, params.user_data);
+        break;
+    default:
+        return EINVAL;
+    }
+    if (result.is_error())
+        return result;
+    return 0;
+}
+
+KResultOr<int> Process::sys$event_queue_wait(Userspace<const Syscall::SC_event_queue_wait_params*> user_params)
+{
+    REQUIRE_PROMISE(stdio);
+
+    Syscall::SC_event_queue_wait_params params;
+    if (!copy_from_user(&params, user_params))
+        return EFAULT;
+
+    if (params.max_events == 0)
+        return EINVAL;
+
+    Thread::BlockTimeout timeout;
+    if (params.timeout) {
+        Optional<Time> timeout_time = copy_time_from_user(params.timeout);
+        if (!timeout_time.has_value())
+            return EFAULT;
+        timeout = Thread::BlockTimeout(false, &timeout_time.value());
+    }
+
+    auto queue_description = file_description(params.queue_fd);
+    if (!queue_description)
+        return EBADF;
+    auto queue = queue_description->event_queue();
+    if (!queue)
+        return EBADF;
+
+    Vector<EventQueueEvent> events;
+    if (!events.try_resize(min(params.max_events, max_events_per_wait)))
+        return ENOMEM;
+
+    for (;;) {
+        auto count = queue->collect_events(events.span());
+        if (count > 0) {
+            if (!copy_n_to_user(params.events, events.data(), count))
+                return EFAULT;
+            return count;
+        }
+
+        // The timeout is converted to an absolute deadline once above, so
+        // going around this loop again doesn't extend it.
+        auto unblock_flags = BlockFlags::None;
+        auto block_result = Thread::current()->block<Thread::ReadBlocker>(timeout, *queue_description, unblock_flags);
+        if (block_result.was_interrupted())
+            return EINTR;
+        if (block_result.timed_out())
+            return 0;
+    }
+}
+
+}
@@ -680,7 +680,16 @@ static Vector<ELF::AuxiliaryValue> generate_auxiliary_vector(FlatPtr load_base,
 
     auxv.append({ ELF::AuxiliaryValue::Platform, Processor::current().platform_string() });
     // FIXME: This is platform specific
-    auxv.append({ ELF::AuxiliaryValue::HwCap, (long)CPUID(1).edx() });
+    auto hwcap = CPUID(1).edx();
+    // Userspace only gets to use SYSENTER if we've set it up, see Processor::cpu_setup().
+    static constexpr u32 sep_bit = 1u << 11;
+#if ARCH(I386)
+    if (!Processor::current().has_feature(CPUFeature::SEP))
+        hwcap &= ~sep_bit;
+#else
+    hwcap &= ~sep_bit;
+#endif
+    auxv.append({ ELF::AuxiliaryValue::HwCap, (long)hwcap });
 
     auxv.append({ ELF::AuxiliaryValue::ClockTick, (long)TimeManagement::the().ticks_per_second() });
 
@@ -42,6 +42,20 @@ KResultOr<int> Process::sys$fcntl(int fd, int cmd, u32 arg)
         break;
     case F_ISTTY:
         return description->is_tty();
+    case F_GETPIPE_SZ:
+        if (!description->is_fifo())
+            return EINVAL;
+        return description->fifo()->capacity();
+    case F_SETPIPE_SZ: {
+        if (!description->is_fifo())
+            return EINVAL;
+        if (arg > PipeBuffer::max_capacity || (arg > PipeBuffer::max_unprivileged_capacity && !is_superuser()))
+            return EPERM;
+        auto result = description->fifo()->set_capacity(arg, is_superuser());
+        if (result.is_error())
+            return result;
+        return description->fifo()->capacity();
+    }
     default:
         return EINVAL;
     }
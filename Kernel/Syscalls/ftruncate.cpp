@@ -4,6 +4,7 @@
  * SPDX-License-Identifier: BSD-2-Clause
  */
 
+#include <AK/Checked.h>
 #include <Kernel/FileSystem/FileDescription.h>
 #include <Kernel/Process.h>
 
@@ -25,4 +26,27 @@ KResultOr<int> Process::sys$ftruncate(int fd, Userspace<off_t*> userspace_length
     return description->truncate(static_cast<u64>(length));
 }
 
+KResultOr<int> Process::sys$fallocate(Userspace<const Syscall::SC_fallocate_params*> user_params)
+{
+    REQUIRE_PROMISE(stdio);
+    Syscall::SC_fallocate_params params;
+    if (!copy_from_user(&params, user_params))
+        return EFAULT;
+    // Only the default mode is supported, which allocates the range and extends the file if needed.
+    if (params.mode != 0)
+        return EOPNOTSUPP;
+    if (params.offset < 0 || params.length <= 0)
+        return EINVAL;
+    if (Checked<i64>::addition_would_overflow(params.offset, params.length))
+        return EFBIG;
+    auto description = file_description(params.fd);
+    if (!description)
+        return EBADF;
+    if (!description->is_writable())
+        return EBADF;
+    if (auto result = description->preallocate(static_cast<u64>(params.offset), static_cast<u64>(params.length)); result.is_error())
+        return result;
+    return 0;
+}
+
 }
@@ -4,6 +4,7 @@
  * SPDX-License-Identifier: BSD-2-Clause
  */
 
+#include <AK/Array.h>
 #include <AK/Singleton.h>
 #include <Kernel/Debug.h>
 #include <Kernel/Process.h>
@@ -11,11 +12,47 @@
 
 namespace Kernel {
 
-static SpinLock<u8> g_global_futex_lock;
-static AK::Singleton<HashMap<VMObject*, FutexQueues>> g_global_futex_queues;
+// Futex queues of all processes live in one table, hashed by their FutexKey.
+// Every bucket has its own lock, so unrelated futexes don't contend with each other.
+static constexpr size_t futex_bucket_count = 512;
 
-FutexQueue::FutexQueue(FlatPtr user_address_or_offset, VMObject* vmobject)
-    : m_user_address_or_offset(user_address_or_offset)
+struct FutexBucket {
+    SpinLock<u8> lock;
+    FutexQueue::List queues;
+};
+
+static AK::Singleton<Array<FutexBucket, futex_bucket_count>> g_futex_buckets;
+
+static FutexBucket& futex_bucket_for(const FutexKey& key)
+{
+    return (*g_futex_buckets)[key.hash() % futex_bucket_count];
+}
+
+static RefPtr<FutexQueue> find_futex_queue(FutexBucket& bucket, const FutexKey& key, VMObject* vmobject, bool create_if_not_found)
+{
+    VERIFY(bucket.lock.is_locked());
+    for (auto& futex_queue : bucket.queues) {
+        if (futex_queue.key() == key)
+            return futex_queue;
+    }
+    if (!create_if_not_found)
+        return {};
+    auto futex_queue = adopt_ref_if_nonnull(new FutexQueue(key, vmobject));
+    if (futex_queue)
+        bucket.queues.append(*futex_queue);
+    return futex_queue;
+}
+
+static void remove_futex_queue_if_unused(FutexBucket& bucket, FutexQueue& futex_queue)
+{
+    VERIFY(bucket.lock.is_locked());
+    // If there are no more waiters, we want to get rid of the futex!
+    if (futex_queue.is_in_bucket() && futex_queue.is_empty_and_no_imminent_waits())
+        bucket.queues.remove(futex_queue);
+}
+
+FutexQueue::FutexQueue(const FutexKey& key, VMObject* vmobject)
+    : m_key(key)
     , m_is_global(vmobject != nullptr)
 {
     dbgln_if(FUTEX_DEBUG, "Futex @ {}{}",
@@ -55,31 +92,36 @@ void FutexQueue::vmobject_deleted(VMObject& vmobject)
     // strong_ref in this function is unsafe!
     m_vmobject = nullptr; // Just to be safe...
 
+    VERIFY(m_key.object == &vmobject);
     {
-        ScopedSpinLock lock(g_global_futex_lock);
-        g_global_futex_queues->remove(&vmobject);
+        auto& bucket = futex_bucket_for(m_key);
+        ScopedSpinLock lock(bucket.lock);
+        if (is_in_bucket())
+            bucket.queues.remove(*this);
     }
 
-    bool did_wake_all;
-    auto wake_count = wake_all(did_wake_all);
+    auto wake_count = wake_all();
 
     if constexpr (FUTEX_DEBUG) {
         if (wake_count > 0)
             dbgln("Futex @ {} unblocked {} waiters due to vmobject free", this, wake_count);
     }
-
-    VERIFY(did_wake_all); // No one should be left behind...
 }
 
 void Process::clear_futex_queues_on_exec()
 {
-    ScopedSpinLock lock(m_futex_lock);
-    for (auto& it : m_futex_queues) {
-        bool did_wake_all;
-        it.value->wake_all(did_wake_all);
-        VERIFY(did_wake_all); // No one should be left behind...
+    for (auto& bucket : *g_futex_buckets) {
+        ScopedSpinLock lock(bucket.lock);
+        for (auto it = bucket.queues.begin(); it != bucket.queues.end();) {
+            auto& futex_queue = *it;
+            ++it;
+            if (futex_queue.key().object != this)
+                continue;
+            NonnullRefPtr<FutexQueue> protector(futex_queue);
+            bucket.queues.remove(futex_queue);
+            futex_queue.wake_all();
+        }
     }
-    m_futex_queues.clear();
 }
 
 KResultOr<int> Process::sys$futex(Userspace<const Syscall::SC_futex_params*> user_params)
@@ -98,9 +140,7 @@ KResultOr<int> Process::sys$futex(Userspace<const Syscall::SC_futex_params*> use
 
     switch (cmd) {
     case FUTEX_WAIT:
-    case FUTEX_WAIT_BITSET:
-    case FUTEX_REQUEUE:
-    case FUTEX_CMP_REQUEUE: {
+    case FUTEX_WAIT_BITSET: {
         if (params.timeout) {
             auto timeout_time = copy_time_from_user(params.timeout);
             if (!timeout_time.has_value())
@@ -120,12 +160,12 @@ KResultOr<int> Process::sys$futex(Userspace<const Syscall::SC_futex_params*> use
     }
 
     bool is_private = (params.futex_op & FUTEX_PRIVATE_FLAG) != 0;
-    auto& queue_lock = is_private ? m_futex_lock : g_global_futex_lock;
+    bool has_second_futex = cmd == FUTEX_REQUEUE || cmd == FUTEX_CMP_REQUEUE || cmd == FUTEX_WAKE_OP;
     auto user_address_or_offset = FlatPtr(params.userspace_address);
     auto user_address_or_offset2 = FlatPtr(params.userspace_address2);
 
-    // If this is a global lock, look up the underlying VMObject *before*
-    // acquiring the queue lock
+    // If this is a shared futex, look up the underlying VMObject *before*
+    // acquiring any bucket lock
     RefPtr<VMObject> vmobject, vmobject2;
     if (!is_private) {
         auto region = space().find_region_containing(Range { VirtualAddress { user_address_or_offset }, sizeof(u32) });
@@ -134,103 +174,70 @@ KResultOr<int> Process::sys$futex(Userspace<const Syscall::SC_futex_params*> use
         vmobject = region->vmobject();
         user_address_or_offset = region->offset_in_vmobject_from_vaddr(VirtualAddress(user_address_or_offset));
 
-        switch (cmd) {
-        case FUTEX_REQUEUE:
-        case FUTEX_CMP_REQUEUE:
-        case FUTEX_WAKE_OP: {
+        if (has_second_futex) {
             auto region2 = space().find_region_containing(Range { VirtualAddress { user_address_or_offset2 }, sizeof(u32) });
             if (!region2)
                 return EFAULT;
             vmobject2 = region2->vmobject();
-            user_address_or_offset2 = region->offset_in_vmobject_from_vaddr(VirtualAddress(user_address_or_offset2));
-            break;
-        }
+            user_address_or_offset2 = region2->offset_in_vmobject_from_vaddr(VirtualAddress(user_address_or_offset2));
         }
     }
 
-    auto find_global_futex_queues = [&](VMObject& vmobject, bool create_if_not_found) -> FutexQueues* {
-        auto& global_queues = *g_global_futex_queues;
-        auto it = global_queues.find(&vmobject);
-        if (it != global_queues.end())
-            return &it->value;
-        if (create_if_not_found) {
-            // TODO: is there a better way than setting and finding it again?
-            auto result = global_queues.set(&vmobject, {});
-            VERIFY(result == AK::HashSetResult::InsertedNewEntry);
-            it = global_queues.find(&vmobject);
-            VERIFY(it != global_queues.end());
-            return &it->value;
-        }
-        return nullptr;
-    };
+    FutexKey key { is_private ? static_cast<const void*>(this) : vmobject.ptr(), user_address_or_offset };
+    FutexKey key2 { is_private ? static_cast<const void*>(this) : vmobject2.ptr(), user_address_or_offset2 };
+    auto& bucket = futex_bucket_for(key);
+    auto* bucket2 = has_second_futex ? &futex_bucket_for(key2) : nullptr;
 
-    auto find_futex_queue = [&](VMObject* vmobject, FlatPtr user_address_or_offset, bool create_if_not_found) -> RefPtr<FutexQueue> {
-        VERIFY(is_private || vmobject);
-        auto* queues = is_private ? &m_futex_queues : find_global_futex_queues(*vmobject, create_if_not_found);
-        if (!queues)
-            return {};
-        auto it = queues->find(user_address_or_offset);
-        if (it != queues->end())
-            return it->value;
-        if (create_if_not_found) {
-            auto futex_queue = adopt_ref(*new FutexQueue(user_address_or_offset, vmobject));
-            auto result = queues->set(user_address_or_offset, futex_queue);
-            VERIFY(result == AK::HashSetResult::InsertedNewEntry);
-            return futex_queue;
-        }
-        return {};
-    };
-
-    auto remove_futex_queue = [&](VMObject* vmobject, FlatPtr user_address_or_offset) {
-        auto* queues = is_private ? &m_futex_queues : find_global_futex_queues(*vmobject, false);
-        if (queues) {
-            queues->remove(user_address_or_offset);
-            if (!is_private && queues->is_empty())
-                g_global_futex_queues->remove(vmobject);
-        }
-    };
-
-    auto do_wake = [&](VMObject* vmobject, FlatPtr user_address_or_offset, u32 count, Optional<u32> bitmask) -> int {
+    auto do_wake = [&](FutexBucket& bucket, const FutexKey& key, u32 count, Optional<u32> bitmask) -> int {
         if (count == 0)
             return 0;
-        auto futex_queue = find_futex_queue(vmobject, user_address_or_offset, false);
+        auto futex_queue = find_futex_queue(bucket, key, nullptr, false);
         if (!futex_queue)
             return 0;
-        bool is_empty;
-        u32 woke_count = futex_queue->wake_n(count, bitmask, is_empty);
-        if (is_empty) {
-            // If there are no more waiters, we want to get rid of the futex!
-            remove_futex_queue(vmobject, user_address_or_offset);
-        }
+        u32 woke_count = futex_queue->wake_n(count, bitmask);
+        remove_futex_queue_if_unused(bucket, *futex_queue);
         return (int)woke_count;
     };
 
-    ScopedSpinLock lock(queue_lock);
+    // Always take two bucket locks in the same order, so that two requeues
+    // going in opposite directions can't deadlock.
+    auto* first_bucket = &bucket;
+    auto* second_bucket = bucket2 != &bucket ? bucket2 : nullptr;
+    if (second_bucket && second_bucket < first_bucket)
+        swap(first_bucket, second_bucket);
+    ScopedSpinLock lock(first_bucket->lock);
+    Optional<ScopedSpinLock<SpinLock<u8>>> second_lock;
+    if (second_bucket)
+        second_lock.emplace(second_bucket->lock);
 
     auto do_wait = [&](u32 bitset) -> int {
+        VERIFY(first_bucket == &bucket && !second_bucket);
         auto user_value = user_atomic_load_relaxed(params.userspace_address);
         if (!user_value.has_value())
             return EFAULT;
         if (user_value.value() != params.val) {
-            dbgln("futex wait: EAGAIN. user value: {:p} @ {:p} != val: {}", user_value.value(), params.userspace_address, params.val);
+            dbgln_if(FUTEX_DEBUG, "futex wait: EAGAIN. user value: {:p} @ {:p} != val: {}", user_value.value(), params.userspace_address, params.val);
             return EAGAIN;
         }
         atomic_thread_fence(AK::MemoryOrder::memory_order_acquire);
 
-        auto futex_queue = find_futex_queue(vmobject.ptr(), user_address_or_offset, true);
-        VERIFY(futex_queue);
+        auto futex_queue = find_futex_queue(bucket, key, vmobject.ptr(), true);
+        if (!futex_queue)
+            return ENOMEM;
 
         // We need to release the lock before blocking. But we have a reference
-        // to the FutexQueue so that we can keep it alive.
+        // to the FutexQueue so that we can keep it alive, and the imminent wait
+        // keeps it in the table until we're on it. Wakers hold the bucket lock,
+        // so any wake that could slip in before then bumps the wake sequence.
+        u32 wake_sequence = futex_queue->queue_imminent_wait();
         lock.unlock();
 
-        Thread::BlockResult block_result = futex_queue->wait_on(timeout, bitset);
+        Thread::BlockResult block_result = futex_queue->wait_on(timeout, bitset, wake_sequence);
 
         lock.lock();
-        if (futex_queue->is_empty()) {
-            // If there are no more waiters, we want to get rid of the futex!
-            remove_futex_queue(vmobject, user_address_or_offset);
-        }
+        remove_futex_queue_if_unused(bucket, *futex_queue);
+        if (block_result == Thread::BlockResult::NotBlocked)
+            return EAGAIN;
         if (block_result == Thread::BlockResult::InterruptedByTimeout) {
             return ETIMEDOUT;
         }
@@ -246,22 +253,20 @@ KResultOr<int> Process::sys$futex(Userspace<const Syscall::SC_futex_params*> use
         atomic_thread_fence(AK::MemoryOrder::memory_order_acquire);
 
         int woken_or_requeued = 0;
-        if (auto futex_queue = find_futex_queue(vmobject.ptr(), user_address_or_offset, false)) {
+        if (auto futex_queue = find_futex_queue(bucket, key, nullptr, false)) {
             RefPtr<FutexQueue> target_futex_queue;
-            bool is_empty, is_target_empty;
             woken_or_requeued = futex_queue->wake_n_requeue(
                 params.val, [&]() -> FutexQueue* {
                     // NOTE: futex_queue's lock is being held while this callback is called
                     // The reason we're doing this in a callback is that we don't want to always
                     // create a target queue, only if we actually have anything to move to it!
-                    target_futex_queue = find_futex_queue(vmobject2.ptr(), user_address_or_offset2, true);
+                    target_futex_queue = find_futex_queue(*bucket2, key2, vmobject2.ptr(), true);
                     return target_futex_queue.ptr();
                 },
-                params.val2, is_empty, is_target_empty);
-            if (is_empty)
-                remove_futex_queue(vmobject, user_address_or_offset);
-            if (is_target_empty && target_futex_queue)
-                remove_futex_queue(vmobject2, user_address_or_offset2);
+                params.val2);
+            remove_futex_queue_if_unused(bucket, *futex_queue);
+            if (target_futex_queue)
+                remove_futex_queue_if_unused(*bucket2, *target_futex_queue);
         }
         return woken_or_requeued;
     };
@@ -271,7 +276,7 @@ KResultOr<int> Process::sys$futex(Userspace<const Syscall::SC_futex_params*> use
         return do_wait(0);
 
     case FUTEX_WAKE:
-        return do_wake(vmobject.ptr(), user_address_or_offset, params.val, {});
+        return do_wake(bucket, key, params.val, {});
 
     case FUTEX_WAKE_OP: {
         Optional<u32> oldval;
@@ -279,7 +284,7 @@ KResultOr<int> Process::sys$futex(Userspace<const Syscall::SC_futex_params*> use
         auto op = _FUTEX_OP(params.val3);
         if (op & FUTEX_OP_ARG_SHIFT) {
             op_arg = 1 << op_arg;
-            op &= FUTEX_OP_ARG_SHIFT;
+            op &= ~FUTEX_OP_ARG_SHIFT;
         }
         atomic_thread_fence(AK::MemoryOrder::memory_order_release);
         switch (op) {
@@ -304,7 +309,7 @@ KResultOr<int> Process::sys$futex(Userspace<const Syscall::SC_futex_params*> use
         if (!oldval.has_value())
             return EFAULT;
         atomic_thread_fence(AK::MemoryOrder::memory_order_acquire);
-        int result = do_wake(vmobject.ptr(), user_address_or_offset, params.val, {});
+        int result = do_wake(bucket, key, params.val, {});
         if (params.val2 > 0) {
             bool compare_result;
             switch (_FUTEX_CMP(params.val3)) {
@@ -330,7 +335,7 @@ KResultOr<int> Process::sys$futex(Userspace<const Syscall::SC_futex_params*> use
                 return EINVAL;
             }
             if (compare_result)
-                result += do_wake(vmobject2.ptr(), user_address_or_offset2, params.val2, {});
+                result += do_wake(*bucket2, key2, params.val2, {});
         }
         return result;
     }
@@ -351,7 +356,7 @@ KResultOr<int> Process::sys$futex(Userspace<const Syscall::SC_futex_params*> use
         VERIFY(params.val3 != FUTEX_BITSET_MATCH_ANY); // we should have turned it into FUTEX_WAKE
         if (params.val3 == 0)
             return EINVAL;
-        return do_wake(vmobject.ptr(), user_address_or_offset, params.val, params.val3);
+        return do_wake(bucket, key, params.val, params.val3);
     }
     return ENOSYS;
 }
@@ -0,0 +1,78 @@
+/*
+ * Copyright (c) 2021, the SerenityOS developers.
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#include <Kernel/API/IORing.h>
+#include <Kernel/FileSystem/FileDescription.h>
+#include <Kernel/FileSystem/IORing.h>
+#include <Kernel/Process.h>
+
+namespace Kernel {
+
+static bool is_valid_entry_count(u32 entries)
+{
+    // The ring indices wrap around, so the entry count must be a power of two.
+    return entries > 0 && entries <= IORing::max_entries && (entries & (entries - 1)) == 0;
+}
+
+KResultOr<int> Process::sys$create_io_ring(Userspace<const Syscall::SC_create_io_ring_params*> user_params)
+{
+    REQUIRE_PROMISE(stdio);
+
+    Syscall::SC_create_io_ring_params params;
+    if (!copy_from_user(&params, user_params))
+        return EFAULT;
+
+    if (!is_valid_entry_count(params.submission_entries) || !is_valid_entry_count(params.completion_entries))
+        return EINVAL;
+
+    int fd = alloc_fd();
+    if (fd < 0)
+        return fd;
+
+    auto ring_or_error = IORing::create(*this, params.submission_entries, params.completion_entries);
+    if (ring_or_error.is_error())
+        return ring_or_error.error();
+
+    auto description_or_error = FileDescription::create(*ring_or_error.value());
+    if (description_or_error.is_error())
+        return description_or_error.error();
+
+    m_fds[fd].set(description_or_error.release_value());
+    if (params.flags & static_cast<unsigned>(IORingFlags::CloseOnExec))
+        m_fds[fd].set_flags(m_fds[fd].flags() | FD_CLOEXEC);
+
+    return fd;
+}
+
+KResultOr<int> Process::sys$io_ring_enter(int fd, u32 to_submit, u32 min_complete)
+{
+    REQUIRE_PROMISE(stdio);
+
+    auto description = file_description(fd);
+    if (!description)
+        return EBADF;
+    auto ring = description->io_ring();
+    if (!ring || !ring->is_owned_by(*this))
+        return EBADF;
+
+    u32 submitted = 0;
+    if (to_submit > 0) {
+        auto submitted_or_error = ring->submit(to_submit);
+        if (submitted_or_error.is_error())
+            return submitted_or_error.error();
+        submitted = submitted_or_error.value();
+    }
+
+    if (min_complete > 0) {
+        auto result = ring->wait_for_completions(min_complete);
+        if (result.is_error())
+            return result;
+    }
+
+    return submitted;
+}
+
+}
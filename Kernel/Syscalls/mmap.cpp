@@ -15,6 +15,7 @@
 #include <Kernel/VM/PrivateInodeVMObject.h>
 #include <Kernel/VM/Region.h>
 #include <Kernel/VM/SharedInodeVMObject.h>
+#include <Kernel/VM/TLBShootdownBatch.h>
 #include <LibC/limits.h>
 #include <LibELF/Validation.h>
 
@@ -197,6 +198,10 @@ KResultOr<FlatPtr> Process::sys$mmap(Userspace<const Syscall::SC_mmap_params*> u
     Region* region = nullptr;
     Optional<Range> range;
 
+    // Line big anonymous mappings up with 2 MiB boundaries, so they can be mapped with large pages.
+    if (map_anonymous && !map_stack && !addr && size >= MemoryManager::large_page_size)
+        alignment = max(alignment, MemoryManager::large_page_size);
+
     if (map_randomized) {
         range = space().page_directory().range_allocator().allocate_randomized(page_round_up(size), alignment);
     } else {
@@ -329,6 +334,9 @@ KResultOr<int> Process::sys$mprotect(Userspace<void*> addr, size_t size, int pro
             return EACCES;
         }
 
+        // Send out a single TLB shootdown for unmapping the old region and mapping the new ones.
+        TLBShootdownBatch tlb_shootdown_batch(space().page_directory());
+
         // Remove the old region from our regions tree, since were going to add another region
         // with the exact same start address, but dont deallocate it yet
         auto region = space().take_region(*old_region);
@@ -376,6 +384,7 @@ KResultOr<int> Process::sys$mprotect(Userspace<void*> addr, size_t size, int pro
             return ENOMEM;
 
         // then do all the other stuff
+        TLBShootdownBatch tlb_shootdown_batch(space().page_directory());
         for (auto* old_region : regions) {
             const auto intersection_to_mprotect = range_to_mprotect.intersect(old_region->range());
             // full sub region
@@ -466,6 +475,22 @@ KResultOr<int> Process::sys$madvise(Userspace<void*> address, size_t size, int a
             return EPERM;
         return region->is_volatile(VirtualAddress(address), size) ? 0 : 1;
     }
+    bool use_large_pages = advice & MADV_HUGEPAGE;
+    bool avoid_large_pages = advice & MADV_NOHUGEPAGE;
+    if (use_large_pages && avoid_large_pages)
+        return EINVAL;
+    if (use_large_pages) {
+        if (!region->vmobject().is_anonymous())
+            return EPERM;
+        region->set_large_pages(Region::LargePages::Requested);
+        return 0;
+    }
+    if (avoid_large_pages) {
+        region->set_large_pages(Region::LargePages::Forbidden);
+        // Split up whatever has been mapped with large pages so far.
+        region->remap();
+        return 0;
+    }
     return EINVAL;
 }
 
@@ -7,6 +7,7 @@
 #include <Kernel/CoreDump.h>
 #include <Kernel/FileSystem/FileDescription.h>
 #include <Kernel/FileSystem/VirtualFileSystem.h>
+#include <Kernel/PerformanceEventRing.h>
 #include <Kernel/PerformanceManager.h>
 #include <Kernel/Process.h>
 #include <Kernel/Time/TimeManagement.h>
@@ -29,7 +30,9 @@ KResultOr<int> Process::sys$profiling_enable(pid_t pid, u64 event_mask)
         if (g_global_perf_events)
             g_global_perf_events->clear();
         else
-            g_global_perf_events = PerformanceEventBuffer::try_create_with_size(32 * MiB).leak_ptr();
+            g_global_perf_events = PerformanceEventBuffer::try_create_per_processor(8 * MiB).leak_ptr();
+        if (!g_global_perf_events)
+            return ENOMEM;
 
         ScopedSpinLock lock(g_processes_lock);
         if (!TimeManagement::the().enable_profile_timer())
@@ -95,6 +98,39 @@ KResultOr<int> Process::sys$profiling_disable(pid_t pid)
     return 0;
 }
 
+KResultOr<int> Process::sys$profiling_open_ring(u32 processor)
+{
+    REQUIRE_NO_PROMISES;
+
+    if (!is_superuser())
+        return EPERM;
+
+    RefPtr<PerformanceEventRing> ring;
+    {
+        ScopedCritical critical;
+        if (!g_global_perf_events)
+            return ENOENT;
+        ring = g_global_perf_events->ring(processor);
+    }
+    if (!ring)
+        return EINVAL;
+
+    int fd = alloc_fd();
+    if (fd < 0)
+        return fd;
+
+    auto description_or_error = FileDescription::create(*ring);
+    if (description_or_error.is_error())
+        return description_or_error.error();
+
+    // Userspace consumes events by writing the tail in the ring's header, so it has to be mapped writable.
+    auto description = description_or_error.release_value();
+    description->set_readable(true);
+    description->set_writable(true);
+    m_fds[fd].set(move(description));
+    return fd;
+}
+
 KResultOr<int> Process::sys$profiling_free_buffer(pid_t pid)
 {
     REQUIRE_NO_PROMISES;
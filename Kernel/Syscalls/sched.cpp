@@ -84,4 +84,78 @@ KResultOr<int> Process::sys$sched_getparam(pid_t pid, Userspace<struct sched_par
     return 0;
 }
 
+KResultOr<int> Process::sys$sched_setaffinity(pid_t tid, size_t cpuset_size, Userspace<const cpu_set_t*> user_cpuset)
+{
+    REQUIRE_PROMISE(proc);
+    if (cpuset_size != sizeof(cpu_set_t))
+        return EINVAL;
+    cpu_set_t cpuset;
+    if (!copy_from_user(&cpuset, user_cpuset))
+        return EFAULT;
+
+    // Only accept masks that leave the thread at least one processor it can actually be scheduled on.
+    auto affinity = cpuset.__bits;
+    if (!(affinity & Scheduler::scheduling_processors_mask()))
+        return EINVAL;
+
+    bool should_yield = false;
+    {
+        ScopedSpinLock lock(g_scheduler_lock);
+        RefPtr<Thread> peer = Thread::current();
+        if (tid != 0)
+            peer = Thread::from_tid(tid);
+
+        if (!peer)
+            return ESRCH;
+
+        if (!is_superuser() && euid() != peer->process().uid() && uid() != peer->process().uid())
+            return EPERM;
+
+        peer->set_affinity(affinity);
+
+        // If the thread is already sitting in the ready queue of a processor
+        // it may no longer run on, move it over to one of the allowed ones.
+        if (Scheduler::dequeue_runnable_thread(*peer))
+            Scheduler::queue_runnable_thread(*peer);
+
+        should_yield = peer == Thread::current() && !(affinity & (1u << Processor::id()));
+
+        // A thread that is running on another processor it may no longer use
+        // has to be switched out there, it gets requeued on an allowed one.
+        if (!should_yield && peer->is_active() && peer->state() == Thread::Running && !(affinity & (1u << peer->cpu())))
+            Processor::smp_unicast(peer->cpu(), [] { Processor::current().invoke_scheduler_async(); }, true);
+    }
+
+    if (should_yield)
+        Thread::current()->yield_without_holding_big_lock();
+    return 0;
+}
+
+KResultOr<int> Process::sys$sched_getaffinity(pid_t tid, size_t cpuset_size, Userspace<cpu_set_t*> user_cpuset)
+{
+    REQUIRE_PROMISE(proc);
+    if (cpuset_size != sizeof(cpu_set_t))
+        return EINVAL;
+
+    cpu_set_t cpuset {};
+    {
+        ScopedSpinLock lock(g_scheduler_lock);
+        RefPtr<Thread> peer = Thread::current();
+        if (tid != 0)
+            peer = Thread::from_tid(tid);
+
+        if (!peer)
+            return ESRCH;
+
+        if (!is_superuser() && euid() != peer->process().uid() && uid() != peer->process().uid())
+            return EPERM;
+
+        cpuset.__bits = peer->affinity();
+    }
+
+    if (!copy_to_user(user_cpuset, &cpuset))
+        return EFAULT;
+    return 0;
+}
+
 }
@@ -0,0 +1,392 @@
+/*
+ * Copyright (c) 2021, the SerenityOS developers.
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#include <AK/NumericLimits.h>
+#include <Kernel/FileSystem/FIFO.h>
+#include <Kernel/FileSystem/FileDescription.h>
+#include <Kernel/KBuffer.h>
+#include <Kernel/Process.h>
+#include <Kernel/VM/AnonymousVMObject.h>
+
+namespace Kernel {
+
+using BlockFlags = Thread::FileBlocker::BlockFlags;
+
+// Size of the kernel buffer used for files that can't be filled directly.
+static constexpr size_t transfer_buffer_size = 64 * KiB;
+
+static KResult wait_until_readable(FileDescription& description, bool blocking)
+{
+    if (description.can_read())
+        return KSuccess;
+    if (!blocking)
+        return EAGAIN;
+    auto unblock_flags = BlockFlags::None;
+    if (Thread::current()->block<Thread::ReadBlocker>({}, description, unblock_flags).was_interrupted())
+        return EINTR;
+    if (!has_flag(unblock_flags, BlockFlags::Read))
+        return EAGAIN;
+    return KSuccess;
+}
+
+static KResult wait_until_writable(FileDescription& description, bool blocking)
+{
+    if (description.can_write())
+        return KSuccess;
+    if (!blocking)
+        return EAGAIN;
+    auto unblock_flags = BlockFlags::None;
+    if (Thread::current()->block<Thread::WriteBlocker>({}, description, unblock_flags).was_interrupted())
+        return EINTR;
+    return KSuccess;
+}
+
+// Moves up to count bytes from one file to another without taking them
+// through userspace. Files with an internal buffer (pipes and local sockets)
+// are filled straight from a seekable input, everything else goes through a
+// kernel buffer. Reading a pipe or socket takes its buffer lock, so doing that
+// while the output holds its own could deadlock against a transfer going the
+// other way. If an offset is given, that end is accessed at the offset
+// instead of at the current offset of its description, and the offset is
+// advanced by the amount that was moved.
+static KResultOr<size_t> transfer(FileDescription& in, Optional<u64>& in_offset, bool in_blocking, FileDescription& out, Optional<u64>& out_offset, bool out_blocking, size_t count)
+{
+    if (!out_offset.has_value() && out.should_append() && out.file().is_seekable()) {
+        auto seek_result = out.seek(0, SEEK_END);
+        if (seek_result.is_error())
+            return seek_result.error();
+    }
+
+    bool reached_end_of_input = false;
+    UserOrKernelBufferFiller read_input = [&](UserOrKernelBuffer& buffer, size_t size) -> KResultOr<size_t> {
+        auto nread_or_error = in_offset.has_value() ? in.read(buffer, in_offset.value(), size) : in.read(buffer, size);
+        if (nread_or_error.is_error())
+            return nread_or_error;
+        if (nread_or_error.value() == 0)
+            reached_end_of_input = true;
+        if (in_offset.has_value())
+            in_offset.value() += nread_or_error.value();
+        return nread_or_error;
+    };
+
+    bool can_fill_output_directly = !out_offset.has_value() && in.file().is_seekable();
+    OwnPtr<KBuffer> transfer_buffer;
+    size_t total_transferred = 0;
+    while (total_transferred < count && !reached_end_of_input) {
+        // Once something has been moved, return instead of waiting for more.
+        bool may_block = total_transferred == 0;
+        if (auto result = wait_until_readable(in, in_blocking && may_block); result.is_error()) {
+            if (total_transferred > 0)
+                break;
+            return result;
+        }
+        if (auto result = wait_until_writable(out, out_blocking && may_block); result.is_error()) {
+            if (total_transferred > 0)
+                break;
+            return result;
+        }
+
+        size_t chunk_size = min(count - total_transferred, transfer_buffer_size);
+        if (can_fill_output_directly) {
+            auto nwritten_or_error = out.write_from(read_input, chunk_size);
+            if (!nwritten_or_error.is_error()) {
+                total_transferred += nwritten_or_error.value();
+                continue;
+            }
+            if (nwritten_or_error.error().error() != -ENOTSUP) {
+                if (total_transferred > 0)
+                    break;
+                return nwritten_or_error.error();
+            }
+            can_fill_output_directly = false;
+        }
+
+        if (!transfer_buffer) {
+            transfer_buffer = KBuffer::try_create_with_size(transfer_buffer_size, Region::Access::Read | Region::Access::Write, "Transfer");
+            if (!transfer_buffer)
+                return ENOMEM;
+        }
+        auto buffer = UserOrKernelBuffer::for_kernel_buffer(transfer_buffer->data());
+        auto nread_or_error = read_input(buffer, chunk_size);
+        if (nread_or_error.is_error()) {
+            if (total_transferred > 0)
+                break;
+            return nread_or_error.error();
+        }
+        size_t nread = nread_or_error.value();
+
+        size_t nwritten = 0;
+        KResult write_result = KSuccess;
+        while (nwritten < nread) {
+            if (!out.can_write()) {
+                // What we read from a seekable file can be put back, but data
+                // taken out of a pipe can't, so keep waiting until it has all
+                // been written even if the output is non-blocking.
+                if (!out_blocking && in_offset.has_value())
+                    break;
+                auto unblock_flags = BlockFlags::None;
+                if (Thread::current()->block<Thread::WriteBlocker>({}, out, unblock_flags).was_interrupted()) {
+                    write_result = EINTR;
+                    break;
+                }
+                continue;
+            }
+            auto data = buffer.offset(nwritten);
+            auto result = out_offset.has_value()
+                ? out.write(out_offset.value() + nwritten, data, nread - nwritten)
+                : out.write(data, nread - nwritten);
+            if (result.is_error()) {
+                if (result.error().error() == -EAGAIN)
+                    continue;
+                write_result = result.error();
+                break;
+            }
+            nwritten += result.value();
+        }
+
+        if (in_offset.has_value())
+            in_offset.value() -= nread - nwritten;
+        if (out_offset.has_value())
+            out_offset.value() += nwritten;
+        total_transferred += nwritten;
+        if (nwritten < nread) {
+            if (total_transferred == 0 && write_result.is_error())
+                return write_result;
+            break;
+        }
+    }
+    return total_transferred;
+}
+
+static KResultOr<Optional<u64>> copy_offset_from_user(i64* user_offset)
+{
+    if (!user_offset)
+        return Optional<u64> {};
+    off_t offset;
+    if (!copy_from_user(&offset, user_offset))
+        return EFAULT;
+    if (offset < 0)
+        return EINVAL;
+    return Optional<u64> { offset };
+}
+
+KResultOr<size_t> Process::sys$sendfile(Userspace<const Syscall::SC_sendfile_params*> user_params)
+{
+    REQUIRE_PROMISE(stdio);
+    Syscall::SC_sendfile_params params;
+    if (!copy_from_user(&params, user_params))
+        return EFAULT;
+
+    if (params.count == 0)
+        return 0;
+    if (params.count > NumericLimits<ssize_t>::max())
+        return EINVAL;
+
+    auto in_description = file_description(params.in_fd);
+    auto out_description = file_description(params.out_fd);
+    if (!in_description || !out_description)
+        return EBADF;
+    if (!in_description->is_readable() || !out_description->is_writable())
+        return EBADF;
+    if (in_description->is_directory())
+        return EISDIR;
+    // The input has to be something we can read at an offset, use splice() for pipes.
+    if (!in_description->file().is_seekable())
+        return EINVAL;
+
+    auto in_offset_or_error = copy_offset_from_user(params.offset);
+    if (in_offset_or_error.is_error())
+        return in_offset_or_error.error();
+    auto in_offset = in_offset_or_error.value();
+    bool has_user_offset = in_offset.has_value();
+    if (!has_user_offset)
+        in_offset = in_description->offset();
+
+    Optional<u64> out_offset;
+    auto result = transfer(*in_description, in_offset, true, *out_description, out_offset, out_description->is_blocking(), params.count);
+
+    if (has_user_offset) {
+        off_t new_offset = in_offset.value();
+        if (!copy_to_user(params.offset, &new_offset))
+            return EFAULT;
+    } else {
+        auto seek_result = in_description->seek(in_offset.value(), SEEK_SET);
+        if (seek_result.is_error())
+            return seek_result.error();
+    }
+    return result;
+}
+
+KResultOr<size_t> Process::sys$splice(Userspace<const Syscall::SC_splice_params*> user_params)
+{
+    REQUIRE_PROMISE(stdio);
+    Syscall::SC_splice_params params;
+    if (!copy_from_user(&params, user_params))
+        return EFAULT;
+
+    if (params.flags & ~(SPLICE_F_MOVE | SPLICE_F_NONBLOCK | SPLICE_F_MORE))
+        return EINVAL;
+    if (params.count == 0)
+        return 0;
+    if (params.count > NumericLimits<ssize_t>::max())
+        return EINVAL;
+
+    auto in_description = file_description(params.in_fd);
+    auto out_description = file_description(params.out_fd);
+    if (!in_description || !out_description)
+        return EBADF;
+    if (!in_description->is_readable() || !out_description->is_writable())
+        return EBADF;
+    if (in_description->is_directory())
+        return EISDIR;
+    // One end has to be a pipe, and it can't be spliced into itself.
+    if (!in_description->is_fifo() && !out_description->is_fifo())
+        return EINVAL;
+    if (&in_description->file() == &out_description->file())
+        return EINVAL;
+
+    auto in_offset_or_error = copy_offset_from_user(params.in_offset);
+    if (in_offset_or_error.is_error())
+        return in_offset_or_error.error();
+    auto in_offset = in_offset_or_error.value();
+    auto out_offset_or_error = copy_offset_from_user(params.out_offset);
+    if (out_offset_or_error.is_error())
+        return out_offset_or_error.error();
+    auto out_offset = out_offset_or_error.value();
+
+    if ((in_offset.has_value() && !in_description->file().is_seekable()) || (out_offset.has_value() && !out_description->file().is_seekable()))
+        return ESPIPE;
+
+    bool has_user_in_offset = in_offset.has_value();
+    if (!has_user_in_offset && in_description->file().is_seekable())
+        in_offset = in_description->offset();
+
+    bool nonblocking = params.flags & SPLICE_F_NONBLOCK;
+    auto result = transfer(*in_description, in_offset, in_description->is_blocking() && !nonblocking, *out_description, out_offset, out_description->is_blocking() && !nonblocking, params.count);
+
+    if (has_user_in_offset) {
+        off_t new_offset = in_offset.value();
+        if (!copy_to_user(params.in_offset, &new_offset))
+            return EFAULT;
+    } else if (in_offset.has_value()) {
+        auto seek_result = in_description->seek(in_offset.value(), SEEK_SET);
+        if (seek_result.is_error())
+            return seek_result.error();
+    }
+    if (params.out_offset) {
+        off_t new_offset = out_offset.value();
+        if (!copy_to_user(params.out_offset, &new_offset))
+            return EFAULT;
+    }
+    return result;
+}
+
+// Takes a page of the process's private anonymous memory so it can be put
+// into a pipe. The page becomes copy-on-write for the process, so what's in
+// the pipe doesn't change if the process writes to the memory afterwards.
+static RefPtr<PhysicalPage> share_page_for_gifting(Process& process, VirtualAddress vaddr)
+{
+    auto* region = process.space().find_region_containing(Range { vaddr, PAGE_SIZE });
+    if (!region || !region->is_user() || region->is_shared() || !region->is_readable() || !region->vmobject().is_anonymous())
+        return {};
+    auto page_index = region->translate_to_vmobject_page(region->page_index_from_address(vaddr));
+    auto page = static_cast<AnonymousVMObject&>(region->vmobject()).share_page_copy_on_write(page_index);
+    if (!page || !region->remap_vmobject_page_range(page_index, 1))
+        return {};
+    return page;
+}
+
+KResultOr<size_t> Process::sys$vmsplice(Userspace<const Syscall::SC_vmsplice_params*> user_params)
+{
+    REQUIRE_PROMISE(stdio);
+    Syscall::SC_vmsplice_params params;
+    if (!copy_from_user(&params, user_params))
+        return EFAULT;
+
+    if (params.flags & ~(SPLICE_F_MOVE | SPLICE_F_NONBLOCK | SPLICE_F_MORE | SPLICE_F_GIFT))
+        return EINVAL;
+    // Arbitrary pain threshold.
+    if (params.iov_count > MiB)
+        return EFAULT;
+
+    auto description = file_description(params.fd);
+    if (!description)
+        return EBADF;
+    if (!description->is_writable() || !description->is_fifo())
+        return EBADF;
+
+    Vector<iovec, 32> vecs;
+    if (!vecs.try_resize(params.iov_count))
+        return ENOMEM;
+    if (!copy_n_from_user(vecs.data(), params.iov, params.iov_count))
+        return EFAULT;
+    u64 total_length = 0;
+    for (auto& vec : vecs) {
+        total_length += vec.iov_len;
+        if (total_length > NumericLimits<ssize_t>::max())
+            return EINVAL;
+    }
+
+    auto& fifo = *description->fifo();
+    bool blocking = description->is_blocking() && !(params.flags & SPLICE_F_NONBLOCK);
+    bool gift = params.flags & SPLICE_F_GIFT;
+    size_t total_written = 0;
+    for (auto& vec : vecs) {
+        auto base = VirtualAddress(vec.iov_base);
+        size_t offset = 0;
+        while (offset < vec.iov_len) {
+            if (auto result = wait_until_writable(*description, blocking); result.is_error()) {
+                if (total_written > 0)
+                    return total_written;
+                return result;
+            }
+
+            auto vaddr = base.offset(offset);
+            size_t remaining = vec.iov_len - offset;
+            if (gift && vaddr.is_page_aligned() && remaining >= PAGE_SIZE) {
+                if (auto page = share_page_for_gifting(*this, vaddr)) {
+                    // The pipe checks for a free slot under its own lock. If
+                    // there is none, there's still room at the end of the last
+                    // page, so copy into that instead.
+                    auto result = fifo.gift_page(*page);
+                    if (!result.is_error()) {
+                        offset += PAGE_SIZE;
+                        total_written += PAGE_SIZE;
+                        continue;
+                    }
+                    if (result.error() != -ENOSPC) {
+                        if (total_written > 0)
+                            return total_written;
+                        return result;
+                    }
+                }
+            }
+
+            // Whatever can't be gifted is copied. When gifting, that happens
+            // a page at a time so that the pages after it can still be gifted.
+            size_t chunk_size = gift ? min(remaining, PAGE_SIZE - (vaddr.get() % PAGE_SIZE)) : remaining;
+            auto buffer = UserOrKernelBuffer::for_user_buffer(vaddr.as_ptr(), chunk_size);
+            if (!buffer.has_value()) {
+                if (total_written > 0)
+                    return total_written;
+                return EFAULT;
+            }
+            auto nwritten_or_error = description->write(buffer.value(), chunk_size);
+            if (nwritten_or_error.is_error()) {
+                if (total_written > 0)
+                    return total_written;
+                if (nwritten_or_error.error().error() == -EAGAIN)
+                    continue;
+                return nwritten_or_error.error();
+            }
+            offset += nwritten_or_error.value();
+            total_written += nwritten_or_error.value();
+        }
+    }
+    return total_written;
+}
+
+}
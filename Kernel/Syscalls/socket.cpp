@@ -115,7 +115,7 @@ KResultOr<int> Process::sys$accept4(Userspace<const Syscall::SC_accept4_params*>
             return EAGAIN;
         }
     }
-    auto accepted_socket = socket.accept();
+    auto accepted_socket = socket.accept(*this);
     VERIFY(accepted_socket);
 
     if (user_address) {
@@ -0,0 +1,34 @@
+/*
+ * Copyright (c) 2021, the SerenityOS developers.
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#include <Kernel/Process.h>
+#include <Kernel/Scheduler.h>
+#include <Kernel/Tasks/PageZeroingTask.h>
+#include <Kernel/VM/MemoryManager.h>
+
+namespace Kernel {
+
+static constexpr size_t pages_per_batch = 16;
+
+UNMAP_AFTER_INIT void PageZeroingTask::spawn()
+{
+    RefPtr<Thread> page_zeroing_thread;
+    Process::create_kernel_process(page_zeroing_thread, "PageZeroingTask", [] {
+        // This is strictly background work, everybody else goes first.
+        Thread::current()->set_priority(THREAD_PRIORITY_MIN);
+        dbgln("PageZeroingTask is running");
+        for (;;) {
+            if (MM.refill_zeroed_page_pool(pages_per_batch) == pages_per_batch) {
+                Scheduler::yield();
+                continue;
+            }
+            // The pool is full (or memory is tight), check back in a little while.
+            [[maybe_unused]] auto result = Thread::current()->sleep(Time::from_milliseconds(100));
+        }
+    });
+}
+
+}
@@ -17,7 +17,8 @@ UNMAP_AFTER_INIT void SyncTask::spawn()
     Process::create_kernel_process(syncd_thread, "SyncTask", [] {
         dbgln("SyncTask is running");
         for (;;) {
-            VFS::the().sync();
+            // Errors are left for the next sync() call from userspace to report.
+            FS::sync();
             (void)Thread::current()->sleep(Time::from_seconds(1));
         }
     });
@@ -0,0 +1,37 @@
+/*
+ * Copyright (c) 2021, the SerenityOS developers.
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#include <AK/Singleton.h>
+#include <Kernel/FileSystem/BlockBasedFileSystem.h>
+#include <Kernel/Process.h>
+#include <Kernel/Tasks/WriteBackTask.h>
+#include <Kernel/Time/TimeManagement.h>
+#include <Kernel/WaitQueue.h>
+
+namespace Kernel {
+
+static AK::Singleton<WaitQueue> s_wait_queue;
+
+UNMAP_AFTER_INIT void WriteBackTask::spawn()
+{
+    RefPtr<Thread> write_back_thread;
+    Process::create_kernel_process(write_back_thread, "WriteBackTask", [] {
+        dbgln("WriteBackTask is running");
+        for (;;) {
+            BlockBasedFS::write_back_all();
+            // Wake up by ourselves every now and then, to see if memory is getting tight.
+            auto timeout = Time::from_milliseconds(500);
+            [[maybe_unused]] auto result = s_wait_queue->wait_on(Thread::BlockTimeout(false, &timeout), "WriteBackTask");
+        }
+    });
+}
+
+void WriteBackTask::wake()
+{
+    s_wait_queue->wake_one();
+}
+
+}
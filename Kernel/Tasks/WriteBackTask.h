@@ -0,0 +1,15 @@
+/*
+ * Copyright (c) 2021, the SerenityOS developers.
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#pragma once
+
+namespace Kernel {
+class WriteBackTask {
+public:
+    static void spawn();
+    static void wake();
+};
+}
@@ -72,6 +72,7 @@ class Thread
     friend class ProtectedProcessBase;
     friend class Scheduler;
     friend struct ThreadReadyQueue;
+    friend struct ThreadReadyQueues;
 
     static SpinLock<u8> g_tid_map_lock;
     static HashMap<ThreadID, Thread*>* g_tid_map;
@@ -482,7 +483,7 @@ public:
 
     class FutexBlocker : public Blocker {
     public:
-        explicit FutexBlocker(FutexQueue&, u32);
+        FutexBlocker(FutexQueue&, u32 bitset, u32 wake_sequence);
         virtual ~FutexBlocker();
 
         virtual Type blocker_type() const override { return Type::Futex; }
@@ -495,6 +496,7 @@ public:
         }
 
         u32 bitset() const { return m_bitset; }
+        u32 wake_sequence() const { return m_wake_sequence; }
 
         void begin_requeue()
         {
@@ -508,6 +510,7 @@ public:
 
     protected:
         u32 m_bitset;
+        u32 m_wake_sequence;
         u32 m_relock_flags { 0 };
         bool m_should_block { true };
         bool m_did_unblock { false };
@@ -982,6 +985,9 @@ public:
     unsigned cow_faults() const { return m_cow_faults; }
     void did_cow_fault() { ++m_cow_faults; }
 
+    TLBShootdownBatch* tlb_shootdown_batch() const { return m_tlb_shootdown_batch; }
+    void set_tlb_shootdown_batch(TLBShootdownBatch* batch) { m_tlb_shootdown_batch = batch; }
+
     unsigned file_read_bytes() const { return m_file_read_bytes; }
     unsigned file_write_bytes() const { return m_file_write_bytes; }
 
@@ -1118,6 +1124,11 @@ public:
         return m_handling_page_fault;
     }
     void set_handling_page_fault(bool b) { m_handling_page_fault = b; }
+
+    // Set when the trap flag had to be cleared on the way into the kernel
+    // through SYSENTER, so it can be put back into the saved registers.
+    bool is_single_stepping_through_sysenter() const { return m_single_stepping_through_sysenter; }
+    void set_single_stepping_through_sysenter(bool b) { m_single_stepping_through_sysenter = b; }
     void set_idle_thread() { m_is_idle_thread = true; }
     bool is_idle_thread() const { return m_is_idle_thread; }
 
@@ -1142,6 +1153,7 @@ private:
 
     IntrusiveListNode<Thread> m_process_thread_list_node;
     int m_runnable_priority { -1 };
+    u32 m_runnable_cpu { 0 };
 
     friend class WaitQueue;
 
@@ -1247,6 +1259,8 @@ private:
     Atomic<bool, AK::MemoryOrder::memory_order_relaxed> m_is_active { false };
     bool m_is_joinable { true };
     bool m_handling_page_fault { false };
+    bool m_single_stepping_through_sysenter { false };
+    TLBShootdownBatch* m_tlb_shootdown_batch { nullptr };
     PreviousMode m_previous_mode { PreviousMode::UserMode };
 
     unsigned m_syscall_count { 0 };
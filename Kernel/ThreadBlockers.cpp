@@ -142,8 +142,9 @@ bool Thread::QueueBlocker::unblock()
     return true;
 }
 
-Thread::FutexBlocker::FutexBlocker(FutexQueue& futex_queue, u32 bitset)
+Thread::FutexBlocker::FutexBlocker(FutexQueue& futex_queue, u32 bitset, u32 wake_sequence)
     : m_bitset(bitset)
+    , m_wake_sequence(wake_sequence)
 {
     if (!set_block_condition(futex_queue, Thread::current()))
         m_should_block = false;
@@ -75,6 +75,7 @@ void TimeManagement::set_epoch_time(Time ts)
     // FIXME: Should use AK::Time internally
     m_epoch_time = ts.to_timespec();
     m_remaining_epoch_time_adjustment = { 0, 0 };
+    update_time_page();
 }
 
 Time TimeManagement::monotonic_time(TimePrecision precision) const
@@ -144,11 +145,14 @@ UNMAP_AFTER_INIT void TimeManagement::initialize(u32 cpu)
             dmesgln("Time: Using APIC timer as system timer");
             s_the->set_system_timer(*apic_timer);
         }
+        TimerQueue::the().initialize_processor(Processor::current());
     } else {
         VERIFY(s_the.is_initialized());
         if (auto* apic_timer = APIC::the().get_timer()) {
             dmesgln("Time: Enable APIC timer on CPU #{}", cpu);
             apic_timer->enable_local_timer();
+            // With a timer tick of its own, this processor can expire its own timers.
+            TimerQueue::the().initialize_processor(Processor::current());
         }
     }
 }
@@ -174,6 +178,9 @@ time_t TimeManagement::boot_time() const
 
 UNMAP_AFTER_INIT TimeManagement::TimeManagement()
 {
+    m_time_page_region = MM.allocate_kernel_region(PAGE_SIZE, "Time page", Region::Access::Read | Region::Access::Write, AllocationStrategy::AllocateNow);
+    VERIFY(m_time_page_region);
+
     bool probe_non_legacy_hardware_timers = !(kernel_command_line().is_legacy_time_enabled());
     if (ACPI::is_enabled()) {
         if (!ACPI::Parser::the()->x86_specific_flags().cmos_rtc_not_present) {
@@ -194,6 +201,45 @@ UNMAP_AFTER_INIT TimeManagement::TimeManagement()
     } else if (!probe_and_set_legacy_hardware_timers()) {
         VERIFY_NOT_REACHED();
     }
+    update_time_page();
+}
+
+VMObject& TimeManagement::time_page_vmobject()
+{
+    return m_time_page_region->vmobject();
+}
+
+TimePage& TimeManagement::time_page()
+{
+    return *reinterpret_cast<TimePage*>(m_time_page_region->vaddr().as_ptr());
+}
+
+void TimeManagement::update_time_page()
+{
+    if (!m_time_page_region)
+        return;
+
+    // Userspace can't query the HPET, so the precise monotonic clocks
+    // are only on the time page if they advance with the tick anyway.
+    u32 supported_clocks = (1u << CLOCK_REALTIME) | (1u << CLOCK_REALTIME_COARSE) | (1u << CLOCK_MONOTONIC_COARSE);
+    if (!m_can_query_precise_time)
+        supported_clocks |= (1u << CLOCK_MONOTONIC) | (1u << CLOCK_MONOTONIC_RAW);
+
+    auto realtime = epoch_time().to_timespec();
+    auto monotonic = monotonic_time(TimePrecision::Coarse).to_timespec();
+
+    ScopedSpinLock lock(m_time_page_lock);
+    auto& page = time_page();
+    u32 update_iteration = AK::atomic_load(&page.update1, AK::MemoryOrder::memory_order_relaxed) + 1;
+    AK::atomic_store(&page.update1, update_iteration, AK::MemoryOrder::memory_order_relaxed);
+    AK::atomic_thread_fence(AK::MemoryOrder::memory_order_release);
+    page.supported_clocks = supported_clocks;
+    page.clocks[CLOCK_REALTIME] = realtime;
+    page.clocks[CLOCK_REALTIME_COARSE] = realtime;
+    page.clocks[CLOCK_MONOTONIC] = monotonic;
+    page.clocks[CLOCK_MONOTONIC_RAW] = monotonic;
+    page.clocks[CLOCK_MONOTONIC_COARSE] = monotonic;
+    AK::atomic_store(&page.update2, update_iteration, AK::MemoryOrder::memory_order_release);
 }
 
 Time TimeManagement::now()
@@ -359,6 +405,8 @@ void TimeManagement::increment_time_since_boot_hpet()
     // TODO: Apply m_remaining_epoch_time_adjustment
     timespec_add(m_epoch_time, { (time_t)(delta_ns / 1000000000), (long)(delta_ns % 1000000000) }, m_epoch_time);
     m_update2.store(update_iteration + 1, AK::MemoryOrder::memory_order_release);
+
+    update_time_page();
 }
 
 void TimeManagement::increment_time_since_boot()
@@ -389,6 +437,8 @@ void TimeManagement::increment_time_since_boot()
         m_ticks_this_second = 0;
     }
     m_update2.store(update_iteration + 1, AK::MemoryOrder::memory_order_release);
+
+    update_time_page();
 }
 
 void TimeManagement::system_timer_tick(const RegisterState& regs)
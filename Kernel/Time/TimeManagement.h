@@ -7,10 +7,14 @@
 #pragma once
 
 #include <AK/NonnullRefPtrVector.h>
+#include <AK/OwnPtr.h>
 #include <AK/RefPtr.h>
 #include <AK/Time.h>
 #include <AK/Types.h>
+#include <Kernel/API/TimePage.h>
+#include <Kernel/Forward.h>
 #include <Kernel/KResult.h>
+#include <Kernel/SpinLock.h>
 #include <Kernel/UnixTypes.h>
 
 namespace Kernel {
@@ -71,7 +75,12 @@ public:
 
     bool can_query_precise_time() const { return m_can_query_precise_time; }
 
+    VMObject& time_page_vmobject();
+
 private:
+    TimePage& time_page();
+    void update_time_page();
+
     bool probe_and_set_legacy_hardware_timers();
     bool probe_and_set_non_legacy_hardware_timers();
     Vector<HardwareTimerBase*> scan_and_initialize_periodic_timers();
@@ -92,6 +101,9 @@ private:
     u32 m_time_ticks_per_second { 0 }; // may be different from interrupts/second (e.g. hpet)
     bool m_can_query_precise_time { false };
 
+    OwnPtr<Region> m_time_page_region;
+    SpinLock<u8> m_time_page_lock;
+
     RefPtr<HardwareTimerBase> m_system_timer;
     RefPtr<HardwareTimerBase> m_time_keeper_timer;
 
@@ -14,7 +14,6 @@
 namespace Kernel {
 
 static AK::Singleton<TimerQueue> s_the;
-static SpinLock<u8> g_timerqueue_lock;
 
 Time Timer::remaining() const
 {
@@ -50,11 +49,142 @@ TimerQueue& TimerQueue::the()
     return *s_the;
 }
 
+// A timer goes onto the first level whose range reaches its deadline. The
+// last two slots of every level are left spare, so rounding a deadline up
+// to its slot never wraps it around onto the slot that's coming up next.
+static constexpr u64 level_start(size_t level)
+{
+    if (level == 0)
+        return 0;
+    return static_cast<u64>(TimerWheel::slots_per_level - 2) << ((level - 1) * TimerWheel::level_shift);
+}
+
+TimerWheel::TimerWheel(u64 nanoseconds_per_tick)
+    : m_nanoseconds_per_tick(nanoseconds_per_tick)
+{
+    m_monotonic.current_tick = tick_for(TimeManagement::the().current_time(CLOCK_MONOTONIC_COARSE), false);
+    m_realtime.current_tick = tick_for(TimeManagement::the().current_time(CLOCK_REALTIME_COARSE), false);
+}
+
+u64 TimerWheel::tick_for(const Time& time, bool round_up) const
+{
+    auto nanoseconds = time.to_nanoseconds();
+    if (nanoseconds <= 0)
+        return 0;
+    if (round_up)
+        return (static_cast<u64>(nanoseconds) + m_nanoseconds_per_tick - 1) / m_nanoseconds_per_tick;
+    return static_cast<u64>(nanoseconds) / m_nanoseconds_per_tick;
+}
+
+void TimerWheel::enqueue_locked(Timer& timer)
+{
+    VERIFY(m_lock.is_locked());
+    auto& base = base_for(timer);
+
+    // Rounding up makes sure the timer's slot doesn't come up before its deadline's tick has started.
+    u64 expires = max(tick_for(timer.m_expires, true), base.current_tick);
+    u64 delta = expires - base.current_tick;
+    size_t level = 0;
+    while (level + 1 < level_count && delta >= level_start(level + 1))
+        ++level;
+
+    auto shift = level * level_shift;
+    u64 level_tick = expires >> shift;
+    if (timer.is_coarse() && (expires & ((1ull << shift) - 1)) != 0)
+        ++level_tick;
+    // Deadlines that are too far out for the last level wait in its farthest slot.
+    level_tick = min(level_tick, (base.current_tick >> shift) + slots_per_level - 1);
+
+    size_t slot_in_level = level_tick & (slots_per_level - 1);
+    timer.m_slot = level * slots_per_level + slot_in_level;
+    base.slots[timer.m_slot].append(timer);
+    base.pending_slots[level] |= 1ull << slot_in_level;
+    base.next_expiry = min(base.next_expiry, level_tick << shift);
+}
+
+void TimerWheel::dequeue_locked(Timer& timer)
+{
+    VERIFY(m_lock.is_locked());
+    auto& base = base_for(timer);
+    auto& slot = base.slots[timer.m_slot];
+    slot.remove(timer);
+    if (slot.is_empty())
+        base.pending_slots[timer.m_slot / slots_per_level] &= ~(1ull << (timer.m_slot % slots_per_level));
+}
+
+u64 TimerWheel::next_pending_tick(const Base& base) const
+{
+    u64 next_tick = NumericLimits<u64>::max();
+    for (size_t level = 0; level < level_count; ++level) {
+        u64 pending = base.pending_slots[level];
+        if (pending == 0)
+            continue;
+        // A level's slots only come up on ticks that are a multiple of its granularity.
+        auto shift = level * level_shift;
+        u64 level_tick = (base.current_tick + (1ull << shift) - 1) >> shift;
+        size_t offset = level_tick & (slots_per_level - 1);
+        u64 rotated = offset ? (pending >> offset) | (pending << (slots_per_level - offset)) : pending;
+        next_tick = min(next_tick, (level_tick + __builtin_ctzll(rotated)) << shift);
+    }
+    return next_tick;
+}
+
+void TimerWheel::collect_expired_locked(Base& base, u64 tick, Timer::List& expired)
+{
+    VERIFY(m_lock.is_locked());
+    for (size_t level = 0; level < level_count; ++level) {
+        auto shift = level * level_shift;
+        if ((tick & ((1ull << shift) - 1)) != 0)
+            break;
+        size_t slot_in_level = (tick >> shift) & (slots_per_level - 1);
+        if ((base.pending_slots[level] & (1ull << slot_in_level)) == 0)
+            continue;
+        base.pending_slots[level] &= ~(1ull << slot_in_level);
+        auto& slot = base.slots[level * slots_per_level + slot_in_level];
+        while (auto* timer = slot.take_first())
+            expired.append(*timer);
+    }
+}
+
+void TimerWheel::rebase_locked(Base& base, u64 tick)
+{
+    VERIFY(m_lock.is_locked());
+    Timer::List timers;
+    for (auto& slot : base.slots) {
+        while (auto* timer = slot.take_first())
+            timers.append(*timer);
+    }
+    for (auto& pending : base.pending_slots)
+        pending = 0;
+    base.current_tick = tick;
+    base.next_expiry = NumericLimits<u64>::max();
+    while (auto* timer = timers.take_first())
+        enqueue_locked(*timer);
+}
+
 UNMAP_AFTER_INIT TimerQueue::TimerQueue()
 {
     m_ticks_per_second = TimeManagement::the().ticks_per_second();
 }
 
+UNMAP_AFTER_INIT void TimerQueue::initialize_processor(Processor& processor)
+{
+    VERIFY(!processor.timer_wheel());
+    auto* wheel = new TimerWheel(1'000'000'000 / m_ticks_per_second);
+    processor.set_timer_wheel(*wheel);
+    if (processor.get_id() == 0)
+        m_bootstrap_wheel = wheel;
+}
+
+TimerWheel& TimerQueue::wheel_for_current_processor()
+{
+    // Processors that don't get timer ticks of their own leave their timers to the bootstrap processor.
+    if (auto* wheel = Processor::current().timer_wheel())
+        return *wheel;
+    VERIFY(m_bootstrap_wheel);
+    return *m_bootstrap_wheel;
+}
+
 bool TimerQueue::add_timer_without_id(NonnullRefPtr<Timer> timer, clockid_t clock_id, const Time& deadline, Function<void()>&& callback)
 {
     if (deadline <= TimeManagement::the().current_time(clock_id))
@@ -67,49 +197,34 @@ bool TimerQueue::add_timer_without_id(NonnullRefPtr<Timer> timer, clockid_t cloc
     // returning from the timer handler and a call to cancel_timer().
     timer->setup(clock_id, deadline, move(callback));
 
-    ScopedSpinLock lock(g_timerqueue_lock);
     timer->m_id = 0; // Don't generate a timer id
-    add_timer_locked(move(timer));
+    add_timer_to_wheel(move(timer));
     return true;
 }
 
 TimerId TimerQueue::add_timer(NonnullRefPtr<Timer>&& timer)
 {
-    ScopedSpinLock lock(g_timerqueue_lock);
-
-    timer->m_id = ++m_timer_id_count;
-    VERIFY(timer->m_id != 0); // wrapped
-    add_timer_locked(move(timer));
-    return timer->m_id;
+    TimerId id = ++m_timer_id_count;
+    VERIFY(id != 0); // wrapped
+    timer->m_id = id;
+    {
+        ScopedSpinLock lock(m_timers_by_id_lock);
+        m_timers_by_id.set(id, timer.ptr());
+    }
+    add_timer_to_wheel(move(timer));
+    return id;
 }
 
-void TimerQueue::add_timer_locked(NonnullRefPtr<Timer> timer)
+void TimerQueue::add_timer_to_wheel(NonnullRefPtr<Timer> timer)
 {
-    Time timer_expiration = timer->m_expires;
-
     VERIFY(!timer->is_queued());
 
-    auto& queue = queue_for_timer(*timer);
-    if (queue.list.is_empty()) {
-        queue.list.append(timer.leak_ref());
-        queue.next_timer_due = timer_expiration;
-    } else {
-        Timer* following_timer = nullptr;
-        for (auto& t : queue.list) {
-            if (t.m_expires > timer_expiration) {
-                following_timer = &t;
-                break;
-            }
-        }
-        if (following_timer) {
-            bool next_timer_needs_update = queue.list.first() == following_timer;
-            queue.list.insert_before(*following_timer, timer.leak_ref());
-            if (next_timer_needs_update)
-                queue.next_timer_due = timer_expiration;
-        } else {
-            queue.list.append(timer.leak_ref());
-        }
-    }
+    auto& wheel = wheel_for_current_processor();
+    ScopedSpinLock lock(wheel.m_lock);
+    VERIFY(!timer->m_wheel);
+    timer->m_wheel = &wheel;
+    timer->set_queued(true);
+    wheel.enqueue_locked(timer.leak_ref());
 }
 
 TimerId TimerQueue::add_timer(clockid_t clock_id, const Time& deadline, Function<void()>&& callback)
@@ -124,103 +239,75 @@ TimerId TimerQueue::add_timer(clockid_t clock_id, const Time& deadline, Function
 
 bool TimerQueue::cancel_timer(TimerId id)
 {
-    Timer* found_timer = nullptr;
-    Queue* timer_queue = nullptr;
-
-    ScopedSpinLock lock(g_timerqueue_lock);
-    for (auto& timer : m_timer_queue_monotonic.list) {
-        if (timer.m_id == id) {
-            found_timer = &timer;
-            timer_queue = &m_timer_queue_monotonic;
-            break;
-        }
+    // A timer stays in the map until it has been cancelled or its callback
+    // has returned, so this also waits for a callback that is running.
+    RefPtr<Timer> found_timer;
+    {
+        ScopedSpinLock lock(m_timers_by_id_lock);
+        auto it = m_timers_by_id.find(id);
+        if (it == m_timers_by_id.end())
+            return false;
+        found_timer = it->value;
     }
+    return cancel_timer_impl(*found_timer, id);
+}
 
-    if (found_timer == nullptr) {
-        for (auto& timer : m_timer_queue_realtime.list) {
-            if (timer.m_id == id) {
-                found_timer = &timer;
-                timer_queue = &m_timer_queue_realtime;
-                break;
-            }
-        };
-    }
+bool TimerQueue::cancel_timer(Timer& timer)
+{
+    return cancel_timer_impl(timer, {});
+}
 
-    if (!found_timer) {
-        // The timer may be executing right now, if it is then it should
-        // be in m_timers_executing. If it is then release the lock
-        // briefly to allow it to finish by removing itself
-        // NOTE: This can only happen with multiple processors!
-        while (true) {
-            for (auto& timer : m_timers_executing) {
-                if (timer.m_id == id) {
-                    found_timer = &timer;
-                    break;
-                }
-            }
+bool TimerQueue::cancel_timer_impl(Timer& timer, Optional<TimerId> id)
+{
+    for (;;) {
+        auto* wheel = timer.m_wheel.load();
+        if (!wheel)
+            break;
 
-            if (found_timer) {
-                // NOTE: This isn't the most efficient way to wait, but
-                // it should only happen when multiple processors are used.
-                // Also, the timers should execute pretty quickly, so it
-                // should not loop here for very long. But we can't yield.
-                lock.unlock();
-                Processor::wait_check();
-                lock.lock();
-                found_timer = nullptr;
-            } else {
-                // We were not able to cancel the timer, but at this point
-                // the handler should have completed if it was running!
-                return false;
-            }
+        ScopedSpinLock lock(wheel->m_lock);
+        if (timer.m_wheel.load() != wheel)
+            continue;
+
+        // A timer that was looked up by its id may have been queued again under another one.
+        if (timer.is_queued() && (!id.has_value() || timer.m_id == id.value())) {
+            VERIFY(timer.ref_count() > 1);
+            remove_timer_locked(*wheel, timer);
+            return true;
         }
+        break;
     }
 
-    VERIFY(found_timer);
-    VERIFY(timer_queue);
-    remove_timer_locked(*timer_queue, *found_timer);
-    return true;
+    // The timer may be executing right now, so wait for its handler to
+    // finish before telling the caller that it couldn't be cancelled.
+    // NOTE: This can only happen with multiple processors!
+    while (timer.m_callbacks_running.load() != 0) {
+        // NOTE: This isn't the most efficient way to wait, but
+        // it should only happen when multiple processors are used.
+        // Also, the timers should execute pretty quickly, so it
+        // should not loop here for very long. But we can't yield.
+        Processor::wait_check();
+    }
+    return false;
 }
 
-bool TimerQueue::cancel_timer(Timer& timer)
+void TimerQueue::forget_timer_id(TimerId id)
 {
-    auto& timer_queue = queue_for_timer(timer);
-    ScopedSpinLock lock(g_timerqueue_lock);
-    if (!timer_queue.list.contains(timer)) {
-        // The timer may be executing right now, if it is then it should
-        // be in m_timers_executing. If it is then release the lock
-        // briefly to allow it to finish by removing itself
-        // NOTE: This can only happen with multiple processors!
-        while (m_timers_executing.contains(timer)) {
-            // NOTE: This isn't the most efficient way to wait, but
-            // it should only happen when multiple processors are used.
-            // Also, the timers should execute pretty quickly, so it
-            // should not loop here for very long. But we can't yield.
-            lock.unlock();
-            Processor::wait_check();
-            lock.lock();
-        }
-        // We were not able to cancel the timer, but at this point
-        // the handler should have completed if it was running!
-        return false;
-    }
-
-    VERIFY(timer.ref_count() > 1);
-    remove_timer_locked(timer_queue, timer);
-    return true;
+    if (id == 0)
+        return;
+    ScopedSpinLock lock(m_timers_by_id_lock);
+    m_timers_by_id.remove(id);
 }
 
-void TimerQueue::remove_timer_locked(Queue& queue, Timer& timer)
+void TimerQueue::remove_timer_locked(TimerWheel& wheel, Timer& timer)
 {
-    bool was_next_timer = (queue.list.first() == &timer);
-    queue.list.remove(timer);
+    wheel.dequeue_locked(timer);
     timer.set_queued(false);
+    timer.m_wheel = nullptr;
     auto now = timer.now(false);
     if (timer.m_expires > now)
         timer.m_remaining = timer.m_expires - now;
+    forget_timer_id(timer.m_id);
 
-    if (was_next_timer)
-        update_next_timer_due(queue);
     // Whenever we remove a timer that was still queued (but hasn't been
     // fired) we added a reference to it. So, when removing it from the
     // queue we need to drop that reference.
@@ -229,51 +316,76 @@ void TimerQueue::remove_timer_locked(Queue& queue, Timer& timer)
 
 void TimerQueue::fire()
 {
-    ScopedSpinLock lock(g_timerqueue_lock);
+    auto* wheel = Processor::current().timer_wheel();
+    if (!wheel)
+        return;
 
-    auto fire_timers = [&](Queue& queue) {
-        auto* timer = queue.list.first();
-        VERIFY(timer);
-        VERIFY(queue.next_timer_due == timer->m_expires);
+    ScopedSpinLock lock(wheel->m_lock);
+    fire_timers(*wheel, wheel->m_monotonic, TimeManagement::the().current_time(CLOCK_MONOTONIC_COARSE));
+    fire_timers(*wheel, wheel->m_realtime, TimeManagement::the().current_time(CLOCK_REALTIME_COARSE));
+}
 
-        while (timer && timer->now(true) > timer->m_expires) {
-            queue.list.remove(*timer);
-            timer->set_queued(false);
+void TimerQueue::fire_timers(TimerWheel& wheel, TimerWheel::Base& base, const Time& now)
+{
+    VERIFY(wheel.m_lock.is_locked());
+    auto now_tick = wheel.tick_for(now, false);
+
+    if (now_tick < base.current_tick && base.current_tick - now_tick > 1) {
+        // The clock was set back, so sort the timers into the wheel again
+        // relative to the new time.
+        wheel.rebase_locked(base, now_tick);
+    }
+
+    if (now_tick < base.next_expiry) {
+        // Nothing comes up until after now, so there's no need to look at any slots.
+        base.current_tick = max(base.current_tick, now_tick + 1);
+        return;
+    }
+
+    Timer::List expired;
+    for (;;) {
+        auto tick = wheel.next_pending_tick(base);
+        base.next_expiry = tick;
+        if (tick > now_tick)
+            break;
 
-            m_timers_executing.append(*timer);
+        wheel.collect_expired_locked(base, tick, expired);
+        base.current_tick = tick + 1;
 
-            update_next_timer_due(queue);
+        while (auto* timer = expired.take_first()) {
+            if (timer->now(true) < timer->m_expires) {
+                // The slot came up before the deadline, either because the timer is on
+                // a precise clock or because its deadline was too far out for the wheel.
+                wheel.enqueue_locked(*timer);
+                continue;
+            }
 
-            lock.unlock();
+            timer->set_queued(false);
+            ++timer->m_callbacks_running;
+            wheel.m_timers_executing.append(*timer);
 
             // Defer executing the timer outside of the irq handler
-            Processor::current().deferred_call_queue([this, timer]() {
-                timer->m_callback();
-                ScopedSpinLock lock(g_timerqueue_lock);
-                m_timers_executing.remove(*timer);
+            Processor::current().deferred_call_queue([this, wheel = &wheel, timer]() {
+                // Take the timer off the wheel before running its callback, the
+                // callback may wake up a thread that queues the same timer again.
+                Function<void()> callback;
+                TimerId id;
+                {
+                    ScopedSpinLock lock(wheel->m_lock);
+                    wheel->m_timers_executing.remove(*timer);
+                    timer->m_wheel = nullptr;
+                    callback = move(timer->m_callback);
+                    id = timer->m_id;
+                }
+                callback();
+                --timer->m_callbacks_running;
+                forget_timer_id(id);
                 // Drop the reference we added when queueing the timer
                 timer->unref();
             });
-
-            lock.lock();
-            timer = queue.list.first();
         }
-    };
-
-    if (!m_timer_queue_monotonic.list.is_empty())
-        fire_timers(m_timer_queue_monotonic);
-    if (!m_timer_queue_realtime.list.is_empty())
-        fire_timers(m_timer_queue_realtime);
-}
-
-void TimerQueue::update_next_timer_due(Queue& queue)
-{
-    VERIFY(g_timerqueue_lock.is_locked());
-
-    if (auto* next_timer = queue.list.first())
-        queue.next_timer_due = next_timer->m_expires;
-    else
-        queue.next_timer_due = {};
+    }
+    base.current_tick = max(base.current_tick, now_tick + 1);
 }
 
 }
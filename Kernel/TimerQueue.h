@@ -7,19 +7,26 @@
 #pragma once
 
 #include <AK/Function.h>
+#include <AK/HashMap.h>
 #include <AK/IntrusiveList.h>
 #include <AK/NonnullRefPtr.h>
+#include <AK/NumericLimits.h>
+#include <AK/Optional.h>
 #include <AK/OwnPtr.h>
 #include <AK/RefCounted.h>
 #include <AK/Time.h>
+#include <Kernel/SpinLock.h>
 #include <Kernel/Time/TimeManagement.h>
 
 namespace Kernel {
 
 TYPEDEF_DISTINCT_ORDERED_ID(u64, TimerId);
 
+class TimerWheel;
+
 class Timer : public RefCounted<Timer> {
     friend class TimerQueue;
+    friend class TimerWheel;
 
 public:
     void setup(clockid_t clock_id, Time expires, Function<void()>&& callback)
@@ -44,21 +51,20 @@ private:
     Time m_remaining {};
     Function<void()> m_callback;
     Atomic<bool, AK::MemoryOrder::memory_order_relaxed> m_queued { false };
+    // The wheel this timer is queued on or about to be executed from, and its slot in there.
+    Atomic<TimerWheel*> m_wheel { nullptr };
+    u16 m_slot { 0 };
+    // Callbacks that have been taken off the wheel and haven't returned yet.
+    Atomic<u32> m_callbacks_running { 0 };
 
-    bool operator<(const Timer& rhs) const
-    {
-        return m_expires < rhs.m_expires;
-    }
-    bool operator>(const Timer& rhs) const
-    {
-        return m_expires > rhs.m_expires;
-    }
     bool operator==(const Timer& rhs) const
     {
         return m_id == rhs.m_id;
     }
     bool is_queued() const { return m_queued; }
     void set_queued(bool queued) { m_queued = queued; }
+    bool is_realtime() const { return m_clock_id == CLOCK_REALTIME || m_clock_id == CLOCK_REALTIME_COARSE; }
+    bool is_coarse() const { return m_clock_id == CLOCK_MONOTONIC_COARSE || m_clock_id == CLOCK_REALTIME_COARSE; }
     Time now(bool) const;
 
 public:
@@ -66,6 +72,54 @@ public:
     using List = IntrusiveList<Timer, RawPtr<Timer>, &Timer::m_list_node>;
 };
 
+// A hierarchical timing wheel, one per processor that receives timer ticks.
+// Each level has 64 slots, and a slot on every level covers 8 times as many
+// ticks as one on the level below. Timers are put on the level that fits how
+// far away their deadline is and never cascade down to lower levels.
+//
+// Timers on precise clocks are put into the slot that comes up at or before
+// their deadline and are queued again if they turn out to be early. Timers on
+// coarse clocks are rounded up to the next slot instead, so that nearby
+// deadlines expire together and idle processors have less to do.
+class TimerWheel {
+    AK_MAKE_NONCOPYABLE(TimerWheel);
+    AK_MAKE_NONMOVABLE(TimerWheel);
+    friend class TimerQueue;
+
+public:
+    static constexpr size_t slot_bits = 6;
+    static constexpr size_t slots_per_level = 1 << slot_bits;
+    static constexpr size_t level_shift = 3;
+    static constexpr size_t level_count = 8;
+
+    explicit TimerWheel(u64 nanoseconds_per_tick);
+
+private:
+    struct Base {
+        Timer::List slots[level_count * slots_per_level];
+        u64 pending_slots[level_count] {};
+        // The next tick that hasn't been processed yet.
+        u64 current_tick { 0 };
+        // No slot comes up before this tick.
+        u64 next_expiry { NumericLimits<u64>::max() };
+    };
+
+    Base& base_for(const Timer& timer) { return timer.is_realtime() ? m_realtime : m_monotonic; }
+    u64 tick_for(const Time&, bool round_up) const;
+
+    void enqueue_locked(Timer&);
+    void dequeue_locked(Timer&);
+    u64 next_pending_tick(const Base&) const;
+    void collect_expired_locked(Base&, u64 tick, Timer::List& expired);
+    void rebase_locked(Base&, u64 tick);
+
+    SpinLock<u8> m_lock;
+    const u64 m_nanoseconds_per_tick;
+    Base m_monotonic;
+    Base m_realtime;
+    Timer::List m_timers_executing;
+};
+
 class TimerQueue {
     friend class Timer;
 
@@ -73,6 +127,9 @@ public:
     TimerQueue();
     static TimerQueue& the();
 
+    // Called on every processor that will call fire() on its timer ticks.
+    void initialize_processor(Processor&);
+
     TimerId add_timer(NonnullRefPtr<Timer>&&);
     bool add_timer_without_id(NonnullRefPtr<Timer>, clockid_t, const Time&, Function<void()>&&);
     TimerId add_timer(clockid_t, const Time& timeout, Function<void()>&& callback);
@@ -85,34 +142,18 @@ public:
     void fire();
 
 private:
-    struct Queue {
-        Timer::List list;
-        Time next_timer_due {};
-    };
-    void remove_timer_locked(Queue&, Timer&);
-    void update_next_timer_due(Queue&);
-    void add_timer_locked(NonnullRefPtr<Timer>);
-
-    Queue& queue_for_timer(Timer& timer)
-    {
-        switch (timer.m_clock_id) {
-        case CLOCK_MONOTONIC:
-        case CLOCK_MONOTONIC_COARSE:
-        case CLOCK_MONOTONIC_RAW:
-            return m_timer_queue_monotonic;
-        case CLOCK_REALTIME:
-        case CLOCK_REALTIME_COARSE:
-            return m_timer_queue_realtime;
-        default:
-            VERIFY_NOT_REACHED();
-        }
-    }
-
-    u64 m_timer_id_count { 0 };
+    TimerWheel& wheel_for_current_processor();
+    void add_timer_to_wheel(NonnullRefPtr<Timer>);
+    bool cancel_timer_impl(Timer&, Optional<TimerId>);
+    void remove_timer_locked(TimerWheel&, Timer&);
+    void fire_timers(TimerWheel&, TimerWheel::Base&, const Time& now);
+    void forget_timer_id(TimerId);
+
+    Atomic<u64> m_timer_id_count { 0 };
+    SpinLock<u8> m_timers_by_id_lock;
+    HashMap<TimerId, Timer*> m_timers_by_id;
     u64 m_ticks_per_second { 0 };
-    Queue m_timer_queue_monotonic;
-    Queue m_timer_queue_realtime;
-    Timer::List m_timers_executing;
+    TimerWheel* m_bootstrap_wheel { nullptr };
 };
 
 }
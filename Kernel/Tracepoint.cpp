@@ -0,0 +1,29 @@
+/*
+ * Copyright (c) 2021, the SerenityOS developers.
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#include <Kernel/PerformanceManager.h>
+#include <Kernel/Tracepoint.h>
+
+namespace Kernel {
+
+Atomic<u32> g_enabled_tracepoints;
+
+void set_tracepoint_enabled(Tracepoint tracepoint, bool enabled)
+{
+    u32 bit = 1u << to_underlying(tracepoint);
+    if (enabled)
+        g_enabled_tracepoints.fetch_or(bit, AK::memory_order_relaxed);
+    else
+        g_enabled_tracepoints.fetch_and(~bit, AK::memory_order_relaxed);
+}
+
+NEVER_INLINE void record_tracepoint(Tracepoint tracepoint, FlatPtr arg1, FlatPtr arg2, const StringView& string)
+{
+    if (auto* current_thread = Thread::current())
+        PerformanceManager::add_tracepoint_event(*current_thread, tracepoint, arg1, arg2, string);
+}
+
+}
@@ -0,0 +1,44 @@
+/*
+ * Copyright (c) 2021, the SerenityOS developers.
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#pragma once
+
+#include <AK/Atomic.h>
+#include <AK/StringView.h>
+#include <Kernel/API/PerformanceEvents.h>
+
+namespace Kernel {
+
+// One bit per Tracepoint, see /proc/sys/trace_<name>.
+extern Atomic<u32> g_enabled_tracepoints;
+
+static_assert(to_underlying(Tracepoint::__Count) <= sizeof(u32) * 8);
+
+void set_tracepoint_enabled(Tracepoint, bool);
+
+// Records a PERF_EVENT_TRACEPOINT event for the current thread, if its
+// process (or everything) is being profiled.
+void record_tracepoint(Tracepoint, FlatPtr arg1, FlatPtr arg2, const StringView& = {});
+
+// A tracepoint that is switched off only costs a load and a branch that isn't
+// taken, and its arguments aren't evaluated at all. These are the arguments
+// each tracepoint records:
+//
+// syscall_enter:           function, first argument
+// syscall_exit:            function, return value
+// device_request_start:    request, 0 (and the name of the request)
+// device_request_complete: request, result
+// lock_wait:               lock, 0 (and the name of the lock)
+// lock_wake:               lock, 0 (and the name of the lock)
+// net_receive:             frame size, ether type
+// sched_wakeup:            thread ID, processor it was queued on
+#define TRACEPOINT(name, ...)                                                                                                          \
+    do {                                                                                                                               \
+        if (::Kernel::g_enabled_tracepoints.load(AK::memory_order_relaxed) & (1u << to_underlying(::Tracepoint::name))) [[unlikely]] \
+            ::Kernel::record_tracepoint(::Tracepoint::name, __VA_ARGS__);                                                              \
+    } while (0)
+
+}
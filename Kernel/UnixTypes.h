@@ -62,6 +62,7 @@ enum {
     PERF_EVENT_KMALLOC = 2048,
     PERF_EVENT_KFREE = 4096,
     PERF_EVENT_PAGE_FAULT = 8192,
+    PERF_EVENT_TRACEPOINT = 16384,
 };
 
 #define WNOHANG 1
@@ -101,6 +102,8 @@ enum {
 #define MADV_SET_VOLATILE 0x100
 #define MADV_SET_NONVOLATILE 0x200
 #define MADV_GET_VOLATILE 0x400
+#define MADV_HUGEPAGE 0x800
+#define MADV_NOHUGEPAGE 0x1000
 
 #define F_DUPFD 0
 #define F_GETFD 1
@@ -108,9 +111,16 @@ enum {
 #define F_GETFL 3
 #define F_SETFL 4
 #define F_ISTTY 5
+#define F_SETPIPE_SZ 8
+#define F_GETPIPE_SZ 9
 
 #define FD_CLOEXEC 1
 
+#define SPLICE_F_MOVE 0x1
+#define SPLICE_F_NONBLOCK 0x2
+#define SPLICE_F_MORE 0x4
+#define SPLICE_F_GIFT 0x8
+
 #define _FUTEX_OP_SHIFT_OP 28
 #define _FUTEX_OP_MASK_OP 0xf
 #define _FUTEX_OP_SHIFT_CMP 24
@@ -535,6 +545,8 @@ enum {
 #define IP_ADD_MEMBERSHIP 4
 #define IP_DROP_MEMBERSHIP 5
 
+#define TCP_CONGESTION 11
+
 struct ucred {
     pid_t pid;
     uid_t uid;
@@ -639,6 +651,10 @@ struct sched_param {
     int sched_priority;
 };
 
+typedef struct {
+    u32 __bits;
+} cpu_set_t;
+
 struct ifreq {
 #define IFNAMSIZ 16
     char ifr_name[IFNAMSIZ];
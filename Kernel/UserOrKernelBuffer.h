@@ -6,9 +6,11 @@
 
 #pragma once
 
+#include <AK/Function.h>
 #include <AK/String.h>
 #include <AK/Types.h>
 #include <AK/Userspace.h>
+#include <Kernel/KResult.h>
 #include <Kernel/StdLib.h>
 #include <Kernel/UnixTypes.h>
 #include <Kernel/VM/MemoryManager.h>
@@ -160,4 +162,9 @@ private:
     u8* m_buffer;
 };
 
+// Puts up to the given number of bytes into a buffer and returns how many
+// it actually produced. This lets a file fill another file's own storage
+// directly, instead of going through an intermediate buffer.
+using UserOrKernelBufferFiller = Function<KResultOr<size_t>(UserOrKernelBuffer&, size_t)>;
+
 }
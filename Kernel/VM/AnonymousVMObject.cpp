@@ -425,6 +425,20 @@ void AnonymousVMObject::set_should_cow(size_t page_index, bool cow)
     ensure_cow_map().set(page_index, cow);
 }
 
+RefPtr<PhysicalPage> AnonymousVMObject::share_page_copy_on_write(size_t page_index)
+{
+    ScopedSpinLock lock(m_lock);
+    // Copies of our pages are paid for out of the committed pages we share
+    // with our clones, which don't account for pages shared with anyone else.
+    if (m_shared_committed_cow_pages)
+        return {};
+    auto& page = physical_pages()[page_index];
+    if (!page || page->is_shared_zero_page() || page->is_lazy_committed_page())
+        return {};
+    set_should_cow(page_index, true);
+    return page;
+}
+
 size_t AnonymousVMObject::cow_pages() const
 {
     if (m_cow_map.is_null())
@@ -439,6 +453,57 @@ bool AnonymousVMObject::is_nonvolatile(size_t page_index)
     return !m_volatile_ranges_cache.contains(page_index);
 }
 
+bool AnonymousVMObject::allocate_large_page(size_t first_page_index)
+{
+    constexpr size_t large_page_page_count = MemoryManager::pages_per_large_page;
+    VERIFY(first_page_index + large_page_page_count <= page_count());
+
+    // Only replace pages that haven't been touched yet. Returns how many of
+    // them were lazily committed.
+    auto count_committed_untouched_pages = [&]() -> Optional<size_t> {
+        VERIFY(m_lock.is_locked());
+        size_t committed_page_count = 0;
+        for (size_t i = first_page_index; i < first_page_index + large_page_page_count; ++i) {
+            auto& page = m_physical_pages[i];
+            if (!page || (!page->is_shared_zero_page() && !page->is_lazy_committed_page()))
+                return {};
+            for (auto* purgeable_ranges : m_purgeable_ranges) {
+                if (purgeable_ranges->is_volatile(i))
+                    return {};
+            }
+            if (page->is_lazy_committed_page())
+                ++committed_page_count;
+        }
+        return committed_page_count;
+    };
+
+    {
+        ScopedSpinLock lock(m_lock);
+        if (!count_committed_untouched_pages().has_value())
+            return false;
+    }
+
+    // The pages are zeroed without holding any locks, so someone may get to
+    // the range in the meantime. In that case we simply let go of them again.
+    auto physical_pages = MM.allocate_contiguous_user_physical_pages(large_page_page_count, MemoryManager::large_page_size);
+    if (physical_pages.is_empty())
+        return false;
+
+    ScopedSpinLock lock(m_lock);
+    auto committed_page_count = count_committed_untouched_pages();
+    if (!committed_page_count.has_value())
+        return false;
+    // We didn't use up our commitment for these, so give it back.
+    if (committed_page_count.value() > 0) {
+        VERIFY(m_unused_committed_pages >= committed_page_count.value());
+        m_unused_committed_pages -= committed_page_count.value();
+        MM.uncommit_user_physical_pages(committed_page_count.value());
+    }
+    for (size_t i = 0; i < large_page_page_count; ++i)
+        m_physical_pages[first_page_index + i] = physical_pages[i];
+    return true;
+}
+
 PageFaultResponse AnonymousVMObject::handle_cow_fault(size_t page_index, VirtualAddress vaddr)
 {
     VERIFY_INTERRUPTS_DISABLED();
@@ -27,10 +27,14 @@ public:
     virtual RefPtr<VMObject> clone() override;
 
     RefPtr<PhysicalPage> allocate_committed_page(size_t);
+    bool allocate_large_page(size_t first_page_index);
     PageFaultResponse handle_cow_fault(size_t, VirtualAddress);
     size_t cow_pages() const;
     bool should_cow(size_t page_index, bool) const;
     void set_should_cow(size_t page_index, bool);
+    // Returns a resident page and makes it copy-on-write for us, so whoever
+    // it's handed to sees it unchanged. The caller has to remap it.
+    RefPtr<PhysicalPage> share_page_copy_on_write(size_t page_index);
 
     void register_purgeable_page_ranges(PurgeablePageRanges&);
     void unregister_purgeable_page_ranges(PurgeablePageRanges&);
@@ -7,6 +7,7 @@
 #include <Kernel/FileSystem/Inode.h>
 #include <Kernel/VM/InodeVMObject.h>
 #include <Kernel/VM/MemoryManager.h>
+#include <Kernel/VM/SharedInodeVMObject.h>
 
 namespace Kernel {
 
@@ -57,6 +58,31 @@ int InodeVMObject::release_all_clean_pages()
     return release_all_clean_pages_impl();
 }
 
+RefPtr<PhysicalPage> InodeVMObject::take_clean_page_with_interrupts_disabled(Badge<PageCache>)
+{
+    VERIFY_INTERRUPTS_DISABLED();
+    // Whoever holds the paging lock may be about to use the pages, and that could be
+    // the very thread we're taking a page for.
+    if (!m_paging_lock.try_lock())
+        return {};
+
+    // Nothing can be paged in or read from here now, but it may have started before.
+    RefPtr<PhysicalPage> page;
+    if (!is_mapped()) {
+        // Pages at the end of the file are the most likely ones to have been read ahead.
+        for (size_t i = page_count(); i > 0 && !page; --i) {
+            auto& physical_page = m_physical_pages[i - 1];
+            if (physical_page && !m_dirty_pages.get(i - 1) && physical_page->ref_count() == 1)
+                page = move(physical_page);
+        }
+    }
+    if (page && is_shared_inode())
+        static_cast<SharedInodeVMObject&>(*this).did_release_pages({}, 1);
+
+    m_paging_lock.unlock();
+    return page;
+}
+
 int InodeVMObject::release_all_clean_pages_impl()
 {
     int count = 0;
@@ -70,6 +96,8 @@ int InodeVMObject::release_all_clean_pages_impl()
     for_each_region([](auto& region) {
         region.remap();
     });
+    if (is_shared_inode())
+        static_cast<SharedInodeVMObject&>(*this).did_release_pages({}, count);
     return count;
 }
 
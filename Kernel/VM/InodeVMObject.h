@@ -6,12 +6,15 @@
 
 #pragma once
 
+#include <AK/Badge.h>
 #include <AK/Bitmap.h>
 #include <Kernel/UnixTypes.h>
 #include <Kernel/VM/VMObject.h>
 
 namespace Kernel {
 
+class PageCache;
+
 class InodeVMObject : public VMObject {
 public:
     virtual ~InodeVMObject() override;
@@ -23,6 +26,7 @@ public:
     size_t amount_clean() const;
 
     int release_all_clean_pages();
+    RefPtr<PhysicalPage> take_clean_page_with_interrupts_disabled(Badge<PageCache>);
 
     u32 writable_mappings() const;
     u32 executable_mappings() const;
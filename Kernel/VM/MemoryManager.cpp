@@ -17,9 +17,11 @@
 #include <Kernel/VM/AnonymousVMObject.h>
 #include <Kernel/VM/ContiguousVMObject.h>
 #include <Kernel/VM/MemoryManager.h>
+#include <Kernel/VM/PageCache.h>
 #include <Kernel/VM/PageDirectory.h>
 #include <Kernel/VM/PhysicalRegion.h>
 #include <Kernel/VM/SharedInodeVMObject.h>
+#include <Kernel/VM/TLBShootdownBatch.h>
 
 extern u8* start_of_kernel_image;
 extern u8* end_of_kernel_image;
@@ -61,7 +63,7 @@ UNMAP_AFTER_INIT MemoryManager::MemoryManager()
     ScopedSpinLock lock(s_mm_lock);
     m_kernel_page_directory = PageDirectory::create_kernel_page_directory();
     parse_memory_map();
-    write_cr3(kernel_page_directory().cr3());
+    Processor::current().load_cr3(kernel_page_directory().cr3());
     protect_kernel_image();
 
     // We're temporarily "committing" to two pages that we need to allocate below
@@ -77,6 +79,10 @@ UNMAP_AFTER_INIT MemoryManager::MemoryManager()
     // By using a tag we don't have to query the VMObject for every page
     // whether it was committed or not
     m_lazy_committed_page = allocate_committed_user_physical_page();
+
+    // Keep up to 1/64th of memory zeroed ahead of time, but not more than 4 MiB.
+    m_zeroed_page_pool_capacity = min(m_user_physical_pages / 64, 1024u);
+    m_zeroed_pages.ensure_capacity(m_zeroed_page_pool_capacity);
 }
 
 UNMAP_AFTER_INIT MemoryManager::~MemoryManager()
@@ -307,7 +313,7 @@ PageTableEntry* MemoryManager::pte(PageDirectory& page_directory, VirtualAddress
 
     auto* pd = quickmap_pd(const_cast<PageDirectory&>(page_directory), page_directory_table_index);
     const PageDirectoryEntry& pde = pd[page_directory_index];
-    if (!pde.is_present())
+    if (!pde.is_present() || pde.is_huge())
         return nullptr;
 
     return &quickmap_pt(PhysicalAddress((FlatPtr)pde.page_table_base()))[page_table_index];
@@ -347,6 +353,48 @@ PageTableEntry* MemoryManager::ensure_pte(PageDirectory& page_directory, Virtual
         pde.set_global(&page_directory == m_kernel_page_directory.ptr());
         // Use page_directory_table_index and page_directory_index as key
         // This allows us to release the page table entry when no longer needed
+        auto result = page_directory.m_page_tables.set(vaddr.get() & ~0x1fffff, move(page_table));
+        VERIFY(result == AK::HashSetResult::InsertedNewEntry);
+    } else if (pde.is_huge()) {
+        // Something inside a 2 MiB mapping is about to change, so split it up into
+        // a page table that maps the very same pages with the same attributes.
+        bool did_purge = false;
+        auto page_table = allocate_user_physical_page(ShouldZeroFill::No, &did_purge);
+        if (!page_table) {
+            dbgln("MM: Unable to allocate page table to split large page at {}", vaddr);
+            return nullptr;
+        }
+        if (did_purge) {
+            pd = quickmap_pd(page_directory, page_directory_table_index);
+            VERIFY(&pde == &pd[page_directory_index]); // Sanity check
+            VERIFY(pde.is_huge()); // Should have not changed
+        }
+        auto* ptes = quickmap_pt(page_table->paddr());
+        for (size_t i = 0; i < pages_per_large_page; ++i) {
+            auto& pte = ptes[i];
+            pte.clear();
+            pte.set_physical_page_base(pde.large_page_base() + i * PAGE_SIZE);
+            pte.set_user_allowed(pde.is_user_allowed());
+            pte.set_writable(pde.is_writable());
+            pte.set_write_through(pde.is_write_through());
+            pte.set_cache_disabled(pde.is_cache_disabled());
+            pte.set_global(pde.is_global());
+            pte.set_execute_disabled(pde.is_execute_disabled());
+            pte.set_present(true);
+        }
+
+        // Build the new entry on the side, so the page directory never holds a half-converted one.
+        PageDirectoryEntry new_pde = pde;
+        new_pde.set_huge(false);
+        new_pde.set_page_table_base(page_table->paddr().get());
+        new_pde.set_user_allowed(true);
+        new_pde.set_writable(true);
+        new_pde.set_write_through(false);
+        new_pde.set_cache_disabled(false);
+        new_pde.set_execute_disabled(false);
+        pde = new_pde;
+        --m_large_page_mappings;
+
         auto result = page_directory.m_page_tables.set(vaddr.get() & ~0x1fffff, move(page_table));
         VERIFY(result == AK::HashSetResult::InsertedNewEntry);
     }
@@ -366,6 +414,8 @@ void MemoryManager::release_pte(PageDirectory& page_directory, VirtualAddress va
     auto* pd = quickmap_pd(page_directory, page_directory_table_index);
     PageDirectoryEntry& pde = pd[page_directory_index];
     if (pde.is_present()) {
+        // Large pages are released as a whole, see release_large_pde().
+        VERIFY(!pde.is_huge());
         auto* page_table = quickmap_pt(PhysicalAddress((FlatPtr)pde.page_table_base()));
         auto& pte = page_table[page_table_index];
         pte.clear();
@@ -383,13 +433,64 @@ void MemoryManager::release_pte(PageDirectory& page_directory, VirtualAddress va
             if (all_clear) {
                 pde.clear();
 
-                auto result = page_directory.m_page_tables.remove(vaddr.get() & ~0x1fffff);
-                VERIFY(result);
+                auto it = page_directory.m_page_tables.find(vaddr.get() & ~0x1fffff);
+                VERIFY(it != page_directory.m_page_tables.end());
+                // If the TLB flush for this range is being batched, the page table
+                // has to stay around until the flush has actually been sent out.
+                if (auto* current_thread = Thread::current(); current_thread && current_thread->tlb_shootdown_batch())
+                    current_thread->tlb_shootdown_batch()->hold_page_table(&page_directory, vaddr, it->value.release_nonnull());
+                page_directory.m_page_tables.remove(it);
             }
         }
     }
 }
 
+PageDirectoryEntry* MemoryManager::ensure_large_pde(PageDirectory& page_directory, VirtualAddress vaddr)
+{
+    VERIFY_INTERRUPTS_DISABLED();
+    VERIFY(s_mm_lock.own_lock());
+    VERIFY(page_directory.get_lock().own_lock());
+    VERIFY(!(vaddr.get() % large_page_size));
+    u32 page_directory_table_index = (vaddr.get() >> 30) & 0x3;
+    u32 page_directory_index = (vaddr.get() >> 21) & 0x1ff;
+
+    auto* pd = quickmap_pd(page_directory, page_directory_table_index);
+    PageDirectoryEntry& pde = pd[page_directory_index];
+    if (!pde.is_present() || pde.is_huge())
+        return &pde;
+
+    // There's a page table here already. We can only replace it if it's one of ours
+    // (and not something set up during boot), and if nothing is mapped through it.
+    auto it = page_directory.m_page_tables.find(vaddr.get());
+    if (it == page_directory.m_page_tables.end())
+        return nullptr;
+    auto* page_table = quickmap_pt(PhysicalAddress((FlatPtr)pde.page_table_base()));
+    for (size_t i = 0; i < pages_per_large_page; ++i) {
+        if (page_table[i].is_present())
+            return nullptr;
+    }
+    pde.clear();
+    page_directory.m_page_tables.remove(it);
+    return &pde;
+}
+
+bool MemoryManager::release_large_pde(PageDirectory& page_directory, VirtualAddress vaddr)
+{
+    VERIFY_INTERRUPTS_DISABLED();
+    VERIFY(s_mm_lock.own_lock());
+    VERIFY(page_directory.get_lock().own_lock());
+    u32 page_directory_table_index = (vaddr.get() >> 30) & 0x3;
+    u32 page_directory_index = (vaddr.get() >> 21) & 0x1ff;
+
+    auto* pd = quickmap_pd(page_directory, page_directory_table_index);
+    PageDirectoryEntry& pde = pd[page_directory_index];
+    if (!pde.is_present() || !pde.is_huge())
+        return false;
+    pde.clear();
+    --m_large_page_mappings;
+    return true;
+}
+
 UNMAP_AFTER_INIT void MemoryManager::initialize(u32 cpu)
 {
     auto mm_data = new MemoryManagerData;
@@ -460,7 +561,9 @@ OwnPtr<Region> MemoryManager::allocate_contiguous_kernel_region(size_t size, Str
 {
     VERIFY(!(size % PAGE_SIZE));
     ScopedSpinLock lock(s_mm_lock);
-    auto range = kernel_page_directory().range_allocator().allocate_anywhere(size);
+    // If the physical pages end up 2 MiB aligned as well, this lets us map them with large pages.
+    size_t alignment = size >= large_page_size ? large_page_size : PAGE_SIZE;
+    auto range = kernel_page_directory().range_allocator().allocate_anywhere(size, alignment);
     if (!range.has_value())
         return {};
     auto vmobject = ContiguousVMObject::create_with_size(size, physical_alignment);
@@ -551,6 +654,18 @@ void MemoryManager::uncommit_user_physical_pages(size_t page_count)
     m_user_physical_pages_committed -= page_count;
 }
 
+void MemoryManager::return_user_physical_page_to_region(PhysicalAddress paddr)
+{
+    VERIFY(s_mm_lock.own_lock());
+    for (auto& region : m_user_physical_regions) {
+        if (region.contains(paddr)) {
+            region.return_page(paddr);
+            return;
+        }
+    }
+    VERIFY_NOT_REACHED();
+}
+
 void MemoryManager::deallocate_user_physical_page(const PhysicalPage& page)
 {
     ScopedSpinLock lock(s_mm_lock);
@@ -558,7 +673,16 @@ void MemoryManager::deallocate_user_physical_page(const PhysicalPage& page)
         if (!region.contains(page))
             continue;
 
-        region.return_page(page);
+        auto& data = get_data();
+        if (data.m_user_page_cache_count == MemoryManagerData::user_page_cache_capacity) {
+            // Give the oldest half back, the most recently freed pages are the warmest.
+            constexpr size_t drain_count = MemoryManagerData::user_page_cache_capacity / 2;
+            for (size_t i = 0; i < drain_count; ++i)
+                return_user_physical_page_to_region(data.m_user_page_cache[i]);
+            data.m_user_page_cache_count -= drain_count;
+            memmove(data.m_user_page_cache, data.m_user_page_cache + drain_count, data.m_user_page_cache_count * sizeof(PhysicalAddress));
+        }
+        data.m_user_page_cache[data.m_user_page_cache_count++] = page.paddr();
         --m_user_physical_pages_used;
 
         // Always return pages to the uncommitted pool. Pages that were
@@ -572,10 +696,63 @@ void MemoryManager::deallocate_user_physical_page(const PhysicalPage& page)
     VERIFY_NOT_REACHED();
 }
 
-RefPtr<PhysicalPage> MemoryManager::find_free_user_physical_page(bool committed)
+void MemoryManager::drain_user_page_caches()
+{
+    VERIFY(s_mm_lock.is_locked());
+    Processor::for_each([&](Processor& processor) {
+        auto& data = processor.get_mm_data();
+        for (size_t i = 0; i < data.m_user_page_cache_count; ++i)
+            return_user_physical_page_to_region(data.m_user_page_cache[i]);
+        data.m_user_page_cache_count = 0;
+    });
+}
+
+RefPtr<PhysicalPage> MemoryManager::take_zeroed_user_physical_page()
+{
+    VERIFY(s_mm_lock.is_locked());
+    if (m_zeroed_pages.is_empty())
+        return {};
+    ++m_user_physical_pages_used;
+    return PhysicalPage::create(m_zeroed_pages.take_last(), false);
+}
+
+RefPtr<PhysicalPage> MemoryManager::take_unzeroed_user_physical_page()
+{
+    VERIFY(s_mm_lock.is_locked());
+    auto& data = get_data();
+    if (data.m_user_page_cache_count) {
+        ++m_user_physical_pages_used;
+        return PhysicalPage::create(data.m_user_page_cache[--data.m_user_page_cache_count], false);
+    }
+    auto take_page_from_regions = [&]() -> RefPtr<PhysicalPage> {
+        for (auto& region : m_user_physical_regions) {
+            if (auto page = region.take_free_page(false)) {
+                ++m_user_physical_pages_used;
+                return page;
+            }
+        }
+        return {};
+    };
+    if (auto page = take_page_from_regions())
+        return page;
+
+    // The pages we're missing may be sitting in the caches of other processors.
+    drain_user_page_caches();
+    return take_page_from_regions();
+}
+
+RefPtr<PhysicalPage> MemoryManager::take_free_user_physical_page()
+{
+    if (auto page = take_unzeroed_user_physical_page())
+        return page;
+
+    // Last but not least, there's the pages that have been zeroed ahead of time.
+    return take_zeroed_user_physical_page();
+}
+
+RefPtr<PhysicalPage> MemoryManager::find_free_user_physical_page(bool committed, ShouldZeroFill should_zero_fill)
 {
     VERIFY(s_mm_lock.is_locked());
-    RefPtr<PhysicalPage> page;
     if (committed) {
         // Draw from the committed pages pool. We should always have these pages available
         VERIFY(m_user_physical_pages_committed > 0);
@@ -586,33 +763,35 @@ RefPtr<PhysicalPage> MemoryManager::find_free_user_physical_page(bool committed)
             return {};
         m_user_physical_pages_uncommitted--;
     }
-    for (auto& region : m_user_physical_regions) {
-        page = region.take_free_page(false);
-        if (!page.is_null()) {
-            ++m_user_physical_pages_used;
-            break;
+
+    if (should_zero_fill == ShouldZeroFill::Yes) {
+        if (auto page = take_zeroed_user_physical_page()) {
+            ++m_zeroed_page_pool_hits;
+            return page;
         }
     }
+
+    auto page = take_free_user_physical_page();
     VERIFY(!committed || !page.is_null());
+    if (page && should_zero_fill == ShouldZeroFill::Yes) {
+        ++m_zeroed_page_pool_misses;
+        auto* ptr = quickmap_page(*page);
+        memset(ptr, 0, PAGE_SIZE);
+        unquickmap_page();
+    }
     return page;
 }
 
 NonnullRefPtr<PhysicalPage> MemoryManager::allocate_committed_user_physical_page(ShouldZeroFill should_zero_fill)
 {
     ScopedSpinLock lock(s_mm_lock);
-    auto page = find_free_user_physical_page(true);
-    if (should_zero_fill == ShouldZeroFill::Yes) {
-        auto* ptr = quickmap_page(*page);
-        memset(ptr, 0, PAGE_SIZE);
-        unquickmap_page();
-    }
-    return page.release_nonnull();
+    return find_free_user_physical_page(true, should_zero_fill).release_nonnull();
 }
 
 RefPtr<PhysicalPage> MemoryManager::allocate_user_physical_page(ShouldZeroFill should_zero_fill, bool* did_purge)
 {
     ScopedSpinLock lock(s_mm_lock);
-    auto page = find_free_user_physical_page(false);
+    auto page = find_free_user_physical_page(false, should_zero_fill);
     bool purged_pages = false;
 
     if (!page) {
@@ -624,30 +803,88 @@ RefPtr<PhysicalPage> MemoryManager::allocate_user_physical_page(ShouldZeroFill s
             int purged_page_count = static_cast<AnonymousVMObject&>(vmobject).purge_with_interrupts_disabled({});
             if (purged_page_count) {
                 dbgln("MM: Purge saved the day! Purged {} pages from AnonymousVMObject", purged_page_count);
-                page = find_free_user_physical_page(false);
+                page = find_free_user_physical_page(false, should_zero_fill);
                 purged_pages = true;
                 VERIFY(page);
                 return IterationDecision::Break;
             }
             return IterationDecision::Continue;
         });
+        if (!page) {
+            // Next, take over a page from a file in the page cache that nobody is using.
+            // It's already accounted for as used, so it doesn't go through the free lists.
+            page = PageCache::the().reclaim_page_with_interrupts_disabled({});
+            if (page && should_zero_fill == ShouldZeroFill::Yes) {
+                auto* ptr = quickmap_page(*page);
+                memset(ptr, 0, PAGE_SIZE);
+                unquickmap_page();
+            }
+            purged_pages = !page.is_null();
+        }
         if (!page) {
             dmesgln("MM: no user physical pages available");
             return {};
         }
     }
 
-    if (should_zero_fill == ShouldZeroFill::Yes) {
-        auto* ptr = quickmap_page(*page);
-        memset(ptr, 0, PAGE_SIZE);
-        unquickmap_page();
-    }
-
     if (did_purge)
         *did_purge = purged_pages;
     return page;
 }
 
+static void zero_page_non_temporal(u8* page)
+{
+    // The page won't be touched again until it gets faulted in somewhere,
+    // so write the zeroes around the cache instead of evicting useful data.
+    auto* words = reinterpret_cast<FlatPtr*>(page);
+    for (size_t i = 0; i < PAGE_SIZE / sizeof(FlatPtr); ++i)
+        asm volatile("movnti %1, %0"
+                     : "=m"(words[i])
+                     : "r"(FlatPtr(0)));
+    asm volatile("sfence" ::
+                     : "memory");
+}
+
+size_t MemoryManager::refill_zeroed_page_pool(size_t max_page_count)
+{
+    bool use_non_temporal_stores = Processor::current().has_feature(CPUFeature::SSE2);
+    size_t zeroed_count = 0;
+    while (zeroed_count < max_page_count) {
+        RefPtr<PhysicalPage> page;
+        {
+            ScopedSpinLock lock(s_mm_lock);
+            if (m_zeroed_pages.size() >= m_zeroed_page_pool_capacity || m_user_physical_pages_uncommitted == 0)
+                break;
+            // Taking a page from the pool itself would only zero it again, so stop once the rest of memory is in use.
+            page = take_unzeroed_user_physical_page();
+            if (!page)
+                break;
+            // Keep the page accounted for as uncommitted while we're zeroing it, so that
+            // nobody can come up short on a page that was committed to them in the meantime.
+            --m_user_physical_pages_uncommitted;
+        }
+
+        {
+            InterruptDisabler disabler;
+            auto* ptr = quickmap_page(*page);
+            if (use_non_temporal_stores)
+                zero_page_non_temporal(ptr);
+            else
+                memset(ptr, 0, PAGE_SIZE);
+            unquickmap_page();
+        }
+
+        ScopedSpinLock lock(s_mm_lock);
+        // The page lives on in the pool, it mustn't go back to the free list along with this PhysicalPage.
+        page->m_may_return_to_freelist = false;
+        m_zeroed_pages.append(page->paddr());
+        --m_user_physical_pages_used;
+        ++m_user_physical_pages_uncommitted;
+        ++zeroed_count;
+    }
+    return zeroed_count;
+}
+
 void MemoryManager::deallocate_supervisor_physical_page(const PhysicalPage& page)
 {
     ScopedSpinLock lock(s_mm_lock);
@@ -657,7 +894,7 @@ void MemoryManager::deallocate_supervisor_physical_page(const PhysicalPage& page
             continue;
         }
 
-        region.return_page(page);
+        region.return_page(page.paddr());
         --m_super_physical_pages_used;
         return;
     }
@@ -676,7 +913,7 @@ NonnullRefPtrVector<PhysicalPage> MemoryManager::allocate_contiguous_supervisor_
     for (auto& region : m_super_physical_regions) {
         physical_pages = region.take_contiguous_free_pages(count, true, physical_alignment);
         if (!physical_pages.is_empty())
-            continue;
+            break;
     }
 
     if (physical_pages.is_empty()) {
@@ -695,6 +932,44 @@ NonnullRefPtrVector<PhysicalPage> MemoryManager::allocate_contiguous_supervisor_
     return physical_pages;
 }
 
+NonnullRefPtrVector<PhysicalPage> MemoryManager::allocate_contiguous_user_physical_pages(size_t page_count, size_t physical_alignment)
+{
+    ScopedSpinLock lock(s_mm_lock);
+    if (m_user_physical_pages_uncommitted < page_count)
+        return {};
+
+    auto take_pages_from_regions = [&]() -> NonnullRefPtrVector<PhysicalPage> {
+        for (auto& region : m_user_physical_regions) {
+            auto physical_pages = region.take_contiguous_free_pages(page_count, false, physical_alignment);
+            if (!physical_pages.is_empty())
+                return physical_pages;
+        }
+        return {};
+    };
+    auto physical_pages = take_pages_from_regions();
+    if (physical_pages.is_empty()) {
+        // Pages sitting in the per-processor caches keep their buddies from merging.
+        drain_user_page_caches();
+        physical_pages = take_pages_from_regions();
+        if (physical_pages.is_empty())
+            return {};
+    }
+
+    m_user_physical_pages_uncommitted -= page_count;
+    m_user_physical_pages_used += page_count;
+    lock.unlock();
+
+    // Nobody else can get to the pages, so zero them without holding everyone else up.
+    // Only the quickmap slot needs interrupts disabled, and just for one page at a time.
+    for (auto& page : physical_pages) {
+        InterruptDisabler disabler;
+        auto* ptr = quickmap_page(page);
+        fast_u32_fill((u32*)ptr, 0, PAGE_SIZE / sizeof(u32));
+        unquickmap_page();
+    }
+    return physical_pages;
+}
+
 RefPtr<PhysicalPage> MemoryManager::allocate_supervisor_physical_page()
 {
     ScopedSpinLock lock(s_mm_lock);
@@ -733,7 +1008,7 @@ void MemoryManager::enter_space(Space& space)
     ScopedSpinLock lock(s_mm_lock);
 
     current_thread->tss().cr3 = space.page_directory().cr3();
-    write_cr3(space.page_directory().cr3());
+    Processor::current().load_cr3(space.page_directory().cr3());
 }
 
 void MemoryManager::flush_tlb_local(VirtualAddress vaddr, size_t page_count)
@@ -743,6 +1018,10 @@ void MemoryManager::flush_tlb_local(VirtualAddress vaddr, size_t page_count)
 
 void MemoryManager::flush_tlb(const PageDirectory* page_directory, VirtualAddress vaddr, size_t page_count)
 {
+    if (auto* current_thread = Thread::current(); current_thread && current_thread->tlb_shootdown_batch()) {
+        if (current_thread->tlb_shootdown_batch()->add(page_directory, vaddr, page_count))
+            return;
+    }
     Processor::flush_tlb(page_directory, vaddr, page_count);
 }
 
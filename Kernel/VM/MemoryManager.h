@@ -94,6 +94,12 @@ struct MemoryManagerData {
 
     PhysicalAddress m_last_quickmap_pd;
     PhysicalAddress m_last_quickmap_pt;
+
+    // Recently freed user pages are handed out again on the same processor first,
+    // they're cheaper to get than going to the buddy allocator and likely still cached.
+    static constexpr size_t user_page_cache_capacity = 32;
+    PhysicalAddress m_user_page_cache[user_page_cache_capacity];
+    size_t m_user_page_cache_count { 0 };
 };
 
 extern RecursiveSpinLock s_mm_lock;
@@ -106,6 +112,7 @@ class MemoryManager {
     friend class AnonymousVMObject;
     friend class Region;
     friend class VMObject;
+    friend class SharedInodeVMObject;
 
 public:
     static MemoryManager& the();
@@ -141,6 +148,7 @@ public:
     RefPtr<PhysicalPage> allocate_user_physical_page(ShouldZeroFill = ShouldZeroFill::Yes, bool* did_purge = nullptr);
     RefPtr<PhysicalPage> allocate_supervisor_physical_page();
     NonnullRefPtrVector<PhysicalPage> allocate_contiguous_supervisor_physical_pages(size_t size, size_t physical_alignment = PAGE_SIZE);
+    NonnullRefPtrVector<PhysicalPage> allocate_contiguous_user_physical_pages(size_t page_count, size_t physical_alignment = PAGE_SIZE);
     void deallocate_user_physical_page(const PhysicalPage&);
     void deallocate_supervisor_physical_page(const PhysicalPage&);
 
@@ -158,6 +166,17 @@ public:
     unsigned super_physical_pages() const { return m_super_physical_pages; }
     unsigned super_physical_pages_used() const { return m_super_physical_pages_used; }
 
+    // Zeroes up to the given number of free pages ahead of time, for the page fault path to use.
+    // Returns how many pages were added to the pool, which is fewer once it's full.
+    size_t refill_zeroed_page_pool(size_t max_page_count);
+    unsigned zeroed_page_pool_pages() const { return m_zeroed_pages.size(); }
+    unsigned zeroed_page_pool_hits() const { return m_zeroed_page_pool_hits; }
+    unsigned zeroed_page_pool_misses() const { return m_zeroed_page_pool_misses; }
+
+    static constexpr size_t large_page_size = 2 * MiB;
+    static constexpr size_t pages_per_large_page = large_page_size / PAGE_SIZE;
+    unsigned large_page_mappings() const { return m_large_page_mappings; }
+
     template<IteratorFunction<VMObject&> Callback>
     static void for_each_vmobject(Callback callback)
     {
@@ -207,7 +226,12 @@ private:
 
     static Region* find_region_from_vaddr(VirtualAddress);
 
-    RefPtr<PhysicalPage> find_free_user_physical_page(bool);
+    RefPtr<PhysicalPage> find_free_user_physical_page(bool committed, ShouldZeroFill);
+    RefPtr<PhysicalPage> take_free_user_physical_page();
+    RefPtr<PhysicalPage> take_unzeroed_user_physical_page();
+    RefPtr<PhysicalPage> take_zeroed_user_physical_page();
+    void drain_user_page_caches();
+    void return_user_physical_page_to_region(PhysicalAddress);
     u8* quickmap_page(PhysicalPage&);
     void unquickmap_page();
 
@@ -217,6 +241,8 @@ private:
     PageTableEntry* pte(PageDirectory&, VirtualAddress);
     PageTableEntry* ensure_pte(PageDirectory&, VirtualAddress);
     void release_pte(PageDirectory&, VirtualAddress, bool);
+    PageDirectoryEntry* ensure_large_pde(PageDirectory&, VirtualAddress);
+    bool release_large_pde(PageDirectory&, VirtualAddress);
 
     RefPtr<PageDirectory> m_kernel_page_directory;
 
@@ -230,6 +256,14 @@ private:
     Atomic<unsigned, AK::MemoryOrder::memory_order_relaxed> m_super_physical_pages { 0 };
     Atomic<unsigned, AK::MemoryOrder::memory_order_relaxed> m_super_physical_pages_used { 0 };
 
+    // Free pages that have already been zeroed. They're not accounted as used.
+    Vector<PhysicalAddress> m_zeroed_pages;
+    size_t m_zeroed_page_pool_capacity { 0 };
+    Atomic<unsigned, AK::MemoryOrder::memory_order_relaxed> m_zeroed_page_pool_hits { 0 };
+    Atomic<unsigned, AK::MemoryOrder::memory_order_relaxed> m_zeroed_page_pool_misses { 0 };
+
+    Atomic<unsigned, AK::MemoryOrder::memory_order_relaxed> m_large_page_mappings { 0 };
+
     NonnullRefPtrVector<PhysicalRegion> m_user_physical_regions;
     NonnullRefPtrVector<PhysicalRegion> m_super_physical_regions;
 
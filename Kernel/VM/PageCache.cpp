@@ -0,0 +1,141 @@
+/*
+ * Copyright (c) 2021, the SerenityOS developers.
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#include <AK/Singleton.h>
+#include <Kernel/FileSystem/Inode.h>
+#include <Kernel/VM/MemoryManager.h>
+#include <Kernel/VM/PageCache.h>
+
+namespace Kernel {
+
+static AK::Singleton<PageCache> s_the;
+
+PageCache& PageCache::the()
+{
+    return *s_the;
+}
+
+PageCache::PageCache()
+{
+}
+
+KResultOr<size_t> PageCache::read_bytes(Inode& inode, u64 offset, size_t count, UserOrKernelBuffer& buffer)
+{
+    auto vmobject = SharedInodeVMObject::create_with_inode(inode);
+    touch(*vmobject);
+
+    // The vmobject of a file that is mapped somewhere can't be replaced
+    // when the file grows, so whatever lies past its end is read directly.
+    size_t nread = 0;
+    if (offset < vmobject->size()) {
+        auto nread_or_error = vmobject->read_bytes(offset, min(count, static_cast<size_t>(vmobject->size() - offset)), buffer);
+        if (nread_or_error.is_error())
+            return nread_or_error;
+        nread = nread_or_error.value();
+    }
+    if (nread < count) {
+        auto remaining_buffer = buffer.offset(nread);
+        auto nread_or_error = inode.read_bytes_uncached(offset + nread, count - nread, remaining_buffer);
+        if (nread_or_error.is_error())
+            return nread_or_error;
+        nread += nread_or_error.value();
+    }
+
+    evict_if_needed();
+    return nread;
+}
+
+void PageCache::did_create(Badge<SharedInodeVMObject>, SharedInodeVMObject& vmobject)
+{
+    touch(vmobject);
+}
+
+void PageCache::did_add_pages(Badge<SharedInodeVMObject>, size_t page_count)
+{
+    m_resident_pages += page_count;
+}
+
+void PageCache::did_remove_pages(Badge<SharedInodeVMObject>, size_t page_count)
+{
+    VERIFY(m_resident_pages >= page_count);
+    m_resident_pages -= page_count;
+}
+
+void PageCache::touch(SharedInodeVMObject& vmobject)
+{
+    ScopedSpinLock lock(m_lock);
+    m_lru.append(vmobject);
+}
+
+void PageCache::forget(Inode& inode)
+{
+    auto vmobject = inode.shared_vmobject();
+    if (!vmobject)
+        return;
+    ScopedSpinLock lock(m_lock);
+    m_lru.remove(*vmobject);
+}
+
+void PageCache::forget_all(const FS& fs)
+{
+    // Take the references out of the list first, the vmobjects can't be
+    // destroyed while we're holding a spinlock.
+    Vector<RefPtr<SharedInodeVMObject>> vmobjects;
+    {
+        ScopedSpinLock lock(m_lock);
+        for (auto& vmobject : m_lru) {
+            if (&vmobject.inode().fs() == &fs)
+                vmobjects.append(vmobject);
+        }
+        for (auto& vmobject : vmobjects)
+            m_lru.remove(*vmobject);
+    }
+}
+
+RefPtr<PhysicalPage> PageCache::reclaim_page_with_interrupts_disabled(Badge<MemoryManager>)
+{
+    VERIFY_INTERRUPTS_DISABLED();
+    // We're inside the physical page allocator, so nothing may be destroyed,
+    // freed or blocked on here. Rather than releasing pages, one page changes
+    // hands, and the vmobjects stay on the list for evict_if_needed().
+    ScopedSpinLock lock(m_lock);
+    for (auto& vmobject : m_lru) {
+        // This is only a hint, the vmobject checks again once it has locked itself.
+        if (vmobject.ref_count() > 1 || vmobject.is_mapped() || !vmobject.m_resident_pages)
+            continue;
+        if (auto page = vmobject.take_clean_page_with_interrupts_disabled({}))
+            return page;
+    }
+    return {};
+}
+
+void PageCache::evict_if_needed()
+{
+    // Leave at least three quarters of memory for everything else.
+    size_t budget = MM.user_physical_pages() / 4;
+    if (m_resident_pages <= budget)
+        return;
+
+    Vector<RefPtr<SharedInodeVMObject>, 16> evicted_vmobjects;
+    {
+        ScopedSpinLock lock(m_lock);
+        size_t resident_pages = m_resident_pages;
+        for (auto& vmobject : m_lru) {
+            if (resident_pages <= budget || evicted_vmobjects.size() == evicted_vmobjects.capacity())
+                break;
+            // Files that are mapped or in the middle of being read are
+            // still in use, the list is the only other reference.
+            if (vmobject.ref_count() > 1 || vmobject.is_mapped())
+                continue;
+            resident_pages -= min(resident_pages, vmobject.m_resident_pages);
+            evicted_vmobjects.unchecked_append(vmobject);
+        }
+        for (auto& vmobject : evicted_vmobjects)
+            m_lru.remove(*vmobject);
+    }
+}
+
+}
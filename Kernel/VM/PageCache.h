@@ -0,0 +1,65 @@
+/*
+ * Copyright (c) 2021, the SerenityOS developers.
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#pragma once
+
+#include <AK/Atomic.h>
+#include <AK/IntrusiveList.h>
+#include <Kernel/KResult.h>
+#include <Kernel/SpinLock.h>
+#include <Kernel/UserOrKernelBuffer.h>
+#include <Kernel/VM/SharedInodeVMObject.h>
+
+namespace Kernel {
+
+// The page cache keeps the contents of recently used files in memory.
+// There is a single copy of each cached page: it lives in the inode's
+// SharedInodeVMObject, so read() and shared mmap() see the same data.
+// Files that aren't mapped anywhere are kept on an LRU list and are
+// dropped from the cache once it grows past its budget, or have their
+// pages taken back when the system runs out of physical memory.
+class PageCache {
+    AK_MAKE_NONCOPYABLE(PageCache);
+    AK_MAKE_NONMOVABLE(PageCache);
+
+public:
+    static PageCache& the();
+
+    PageCache();
+
+    // Reads from the cached pages of the inode, reading them in from the
+    // file system first if needed. The inode must be locked by the caller.
+    KResultOr<size_t> read_bytes(Inode&, u64 offset, size_t count, UserOrKernelBuffer&);
+
+    void did_create(Badge<SharedInodeVMObject>, SharedInodeVMObject&);
+    void did_add_pages(Badge<SharedInodeVMObject>, size_t);
+    void did_remove_pages(Badge<SharedInodeVMObject>, size_t);
+    void did_read_ahead(Badge<SharedInodeVMObject>, size_t page_count) { m_readahead_pages += page_count; }
+
+    // Drops the cache's reference to the pages of an inode, for example
+    // when it has been deleted.
+    void forget(Inode&);
+    void forget_all(const FS&);
+
+    // Takes a clean page away from the least recently used file that nobody
+    // is using, so it can be reused as is. Called by the memory manager when
+    // it can't find a free physical page.
+    RefPtr<PhysicalPage> reclaim_page_with_interrupts_disabled(Badge<MemoryManager>);
+
+    size_t resident_pages() const { return m_resident_pages; }
+    size_t readahead_pages() const { return m_readahead_pages; }
+
+private:
+    void touch(SharedInodeVMObject&);
+    void evict_if_needed();
+
+    SharedInodeVMObject::PageCacheList m_lru;
+    SpinLock<u8> m_lock;
+    Atomic<size_t, AK::MemoryOrder::memory_order_relaxed> m_resident_pages { 0 };
+    Atomic<size_t, AK::MemoryOrder::memory_order_relaxed> m_readahead_pages { 0 };
+};
+
+}
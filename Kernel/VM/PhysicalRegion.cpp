@@ -9,7 +9,6 @@
 #include <AK/RefPtr.h>
 #include <AK/Vector.h>
 #include <Kernel/Assertions.h>
-#include <Kernel/Random.h>
 #include <Kernel/VM/PhysicalPage.h>
 #include <Kernel/VM/PhysicalRegion.h>
 
@@ -39,133 +38,183 @@ unsigned PhysicalRegion::finalize_capacity()
     VERIFY(!m_pages);
 
     m_pages = (m_upper.get() - m_lower.get()) / PAGE_SIZE;
-    m_bitmap.grow(m_pages, false);
+    if (!m_pages)
+        return 0;
+    m_lower_pfn = m_lower.get() / PAGE_SIZE;
 
+    // Blocks are aligned to their size in physical memory rather than within
+    // the region, so the first and last block of each order may stick out.
+    FlatPtr last_pfn = m_lower_pfn + m_pages - 1;
+    for (unsigned order = 0; order <= max_order; ++order)
+        m_free_blocks[order].grow((last_pfn >> order) - (m_lower_pfn >> order) + 1, false);
+
+    free_range(m_lower_pfn, m_pages);
     return size();
 }
 
-NonnullRefPtrVector<PhysicalPage> PhysicalRegion::take_contiguous_free_pages(size_t count, bool supervisor, size_t physical_alignment)
+Optional<size_t> PhysicalRegion::block_index(FlatPtr pfn, unsigned order) const
 {
-    VERIFY(m_pages);
-    VERIFY(m_used != m_pages);
+    if ((pfn >> order) < (m_lower_pfn >> order))
+        return {};
+    size_t index = (pfn >> order) - (m_lower_pfn >> order);
+    if (index >= m_free_blocks[order].size())
+        return {};
+    return index;
+}
 
-    NonnullRefPtrVector<PhysicalPage> physical_pages;
-    physical_pages.ensure_capacity(count);
+Optional<FlatPtr> PhysicalRegion::allocate_block(unsigned order)
+{
+    VERIFY(order <= max_order);
 
-    auto first_contiguous_page = find_contiguous_free_pages(count, physical_alignment);
+    unsigned found_order = order;
+    while (found_order <= max_order && !m_free_block_count[found_order])
+        ++found_order;
+    if (found_order > max_order)
+        return {};
 
-    for (size_t index = 0; index < count; index++)
-        physical_pages.append(PhysicalPage::create(m_lower.offset(PAGE_SIZE * (index + first_contiguous_page)), supervisor));
-    return physical_pages;
+    auto& free_blocks = m_free_blocks[found_order];
+    auto index = free_blocks.find_one_anywhere_set(m_free_block_hint[found_order]);
+    VERIFY(index.has_value());
+    free_blocks.set(index.value(), false);
+    --m_free_block_count[found_order];
+    m_free_block_hint[found_order] = index.value();
+
+    FlatPtr pfn = ((m_lower_pfn >> found_order) + index.value()) << found_order;
+
+    // Split the block down to the requested size, the upper halves become free blocks of their own.
+    while (found_order > order) {
+        --found_order;
+        auto buddy_index = block_index(pfn + (1u << found_order), found_order);
+        VERIFY(buddy_index.has_value());
+        m_free_blocks[found_order].set(buddy_index.value(), true);
+        ++m_free_block_count[found_order];
+    }
+    return pfn;
 }
 
-unsigned PhysicalRegion::find_contiguous_free_pages(size_t count, size_t physical_alignment)
+// Requests that are bigger or need more alignment than the largest block are
+// served from a run of consecutive free blocks of the largest order instead.
+Optional<FlatPtr> PhysicalRegion::allocate_block_run(size_t count, size_t alignment_in_pages)
 {
-    VERIFY(count != 0);
-    VERIFY(physical_alignment % PAGE_SIZE == 0);
-    // search from the last page we allocated
-    auto range = find_and_allocate_contiguous_range(count, physical_alignment / PAGE_SIZE);
-    VERIFY(range.has_value());
-    return range.value();
+    constexpr size_t max_block_size = 1u << max_order;
+    size_t block_count = (count + max_block_size - 1) / max_block_size;
+    size_t alignment_in_blocks = max(alignment_in_pages / max_block_size, (size_t)1);
+    if (m_free_block_count[max_order] < block_count)
+        return {};
+
+    auto& free_blocks = m_free_blocks[max_order];
+    FlatPtr first_block = m_lower_pfn >> max_order;
+    size_t index = 0;
+    while (index + block_count <= free_blocks.size()) {
+        if (auto misalignment = (first_block + index) % alignment_in_blocks) {
+            index += alignment_in_blocks - misalignment;
+            continue;
+        }
+        size_t run = 0;
+        while (run < block_count && free_blocks.get(index + run))
+            ++run;
+        if (run < block_count) {
+            index += run + 1;
+            continue;
+        }
+        for (size_t i = 0; i < block_count; ++i)
+            free_blocks.set(index + i, false);
+        m_free_block_count[max_order] -= block_count;
+        return (first_block + index) << max_order;
+    }
+    return {};
 }
 
-Optional<unsigned> PhysicalRegion::find_one_free_page()
+void PhysicalRegion::free_block(FlatPtr pfn, unsigned order)
 {
-    if (m_used == m_pages) {
-        // We know we don't have any free pages, no need to check the bitmap
-        // Check if we can draw one from the return queue
-        if (m_recently_returned.size() > 0) {
-            u8 index = get_fast_random<u8>() % m_recently_returned.size();
-            Checked<FlatPtr> local_offset = m_recently_returned[index].get();
-            local_offset -= m_lower.get();
-            m_recently_returned.remove(index);
-            VERIFY(!local_offset.has_overflow());
-            VERIFY(local_offset.value() < (FlatPtr)(m_pages * PAGE_SIZE));
-            return local_offset.value() / PAGE_SIZE;
-        }
-        return {};
+    while (order < max_order) {
+        auto buddy_index = block_index(pfn ^ (1u << order), order);
+        if (!buddy_index.has_value() || !m_free_blocks[order].get(buddy_index.value()))
+            break;
+        m_free_blocks[order].set(buddy_index.value(), false);
+        --m_free_block_count[order];
+        pfn &= ~static_cast<FlatPtr>(1u << order);
+        ++order;
     }
-    auto free_index = m_bitmap.find_one_anywhere_unset(m_free_hint);
-    if (!free_index.has_value())
-        return {};
 
-    auto page_index = free_index.value();
-    m_bitmap.set(page_index, true);
-    m_used++;
-    m_free_hint = free_index.value() + 1; // Just a guess
-    if (m_free_hint >= m_bitmap.size())
-        m_free_hint = 0;
-    return page_index;
+    auto index = block_index(pfn, order);
+    VERIFY(index.has_value());
+    VERIFY(!m_free_blocks[order].get(index.value()));
+    m_free_blocks[order].set(index.value(), true);
+    ++m_free_block_count[order];
 }
 
-Optional<unsigned> PhysicalRegion::find_and_allocate_contiguous_range(size_t count, unsigned alignment)
+void PhysicalRegion::free_range(FlatPtr pfn, size_t count)
 {
+    // Free the range as the largest naturally aligned blocks that fit.
+    while (count) {
+        unsigned order = 0;
+        while (order < max_order && !(pfn & (1u << order)) && (2u << order) <= count)
+            ++order;
+        free_block(pfn, order);
+        pfn += 1u << order;
+        count -= 1u << order;
+    }
+}
+
+NonnullRefPtrVector<PhysicalPage> PhysicalRegion::take_contiguous_free_pages(size_t count, bool supervisor, size_t physical_alignment)
+{
+    VERIFY(m_pages);
     VERIFY(count != 0);
-    size_t found_pages_count = 0;
-    // TODO: Improve how we deal with alignment != 1
-    auto first_index = m_bitmap.find_longest_range_of_unset_bits(count + alignment - 1, found_pages_count);
-    if (!first_index.has_value())
-        return {};
+    VERIFY(physical_alignment % PAGE_SIZE == 0);
 
-    auto page = first_index.value();
-    if (alignment != 1) {
-        auto lower_page = m_lower.get() / PAGE_SIZE;
-        page = ((lower_page + page + alignment - 1) & ~(alignment - 1)) - lower_page;
-    }
-    if (found_pages_count >= count) {
-        m_bitmap.set_range<true>(page, count);
-        m_used += count;
-        m_free_hint = first_index.value() + count + 1; // Just a guess
-        if (m_free_hint >= m_bitmap.size())
-            m_free_hint = 0;
-        return page;
+    // Blocks are naturally aligned, so asking for a big enough one takes care of the alignment.
+    size_t alignment_in_pages = physical_alignment / PAGE_SIZE;
+    size_t block_size = max(count, alignment_in_pages);
+    Optional<FlatPtr> pfn;
+    size_t allocated_pages;
+    if (block_size <= (1u << max_order)) {
+        unsigned order = 0;
+        while ((1u << order) < block_size)
+            ++order;
+        pfn = allocate_block(order);
+        allocated_pages = 1u << order;
+    } else {
+        pfn = allocate_block_run(count, alignment_in_pages);
+        allocated_pages = round_up_to_power_of_two(count, 1u << max_order);
     }
-    return {};
+    if (!pfn.has_value())
+        return {};
+    // Give back what we don't need of the allocation.
+    free_range(pfn.value() + count, allocated_pages - count);
+    m_used += count;
+
+    NonnullRefPtrVector<PhysicalPage> physical_pages;
+    physical_pages.ensure_capacity(count);
+    for (size_t index = 0; index < count; index++)
+        physical_pages.append(PhysicalPage::create(PhysicalAddress((pfn.value() + index) * PAGE_SIZE), supervisor));
+    return physical_pages;
 }
 
 RefPtr<PhysicalPage> PhysicalRegion::take_free_page(bool supervisor)
 {
     VERIFY(m_pages);
 
-    auto free_index = find_one_free_page();
-    if (!free_index.has_value())
+    auto pfn = allocate_block(0);
+    if (!pfn.has_value())
         return nullptr;
+    ++m_used;
 
-    return PhysicalPage::create(m_lower.offset(free_index.value() * PAGE_SIZE), supervisor);
+    return PhysicalPage::create(PhysicalAddress(pfn.value() * PAGE_SIZE), supervisor);
 }
 
-void PhysicalRegion::free_page_at(PhysicalAddress addr)
+void PhysicalRegion::return_page(PhysicalAddress paddr)
 {
     VERIFY(m_pages);
+    VERIFY(m_used);
 
-    if (m_used == 0) {
-        VERIFY_NOT_REACHED();
-    }
-
-    Checked<FlatPtr> local_offset = addr.get();
+    Checked<FlatPtr> local_offset = paddr.get();
     local_offset -= m_lower.get();
     VERIFY(!local_offset.has_overflow());
     VERIFY(local_offset.value() < (FlatPtr)(m_pages * PAGE_SIZE));
 
-    auto page = local_offset.value() / PAGE_SIZE;
-    m_bitmap.set(page, false);
-    m_free_hint = page; // We know we can find one here for sure
-    m_used--;
-}
-
-void PhysicalRegion::return_page(const PhysicalPage& page)
-{
-    auto returned_count = m_recently_returned.size();
-    if (returned_count >= m_recently_returned.capacity()) {
-        // Return queue is full, pick a random entry and free that page
-        // and replace the entry with this page
-        auto& entry = m_recently_returned[get_fast_random<u8>()];
-        free_page_at(entry);
-        entry = page.paddr();
-    } else {
-        // Still filling the return queue, just append it
-        m_recently_returned.append(page.paddr());
-    }
+    free_block(paddr.get() / PAGE_SIZE, 0);
+    --m_used;
 }
 
 }
@@ -14,10 +14,16 @@
 
 namespace Kernel {
 
+// Hands out physical pages with a buddy allocator: free memory is kept as
+// naturally aligned blocks of 2^order pages, with one bitmap of free blocks
+// per order. Blocks are split on allocation and merged with their buddy
+// again when both halves are free.
 class PhysicalRegion : public RefCounted<PhysicalRegion> {
     AK_MAKE_ETERNAL
 
 public:
+    static constexpr unsigned max_order = 10;
+
     static NonnullRefPtr<PhysicalRegion> create(PhysicalAddress lower, PhysicalAddress upper);
     ~PhysicalRegion() = default;
 
@@ -27,29 +33,32 @@ public:
     PhysicalAddress lower() const { return m_lower; }
     PhysicalAddress upper() const { return m_upper; }
     unsigned size() const { return m_pages; }
-    unsigned used() const { return m_used - m_recently_returned.size(); }
-    unsigned free() const { return m_pages - m_used + m_recently_returned.size(); }
-    bool contains(const PhysicalPage& page) const { return page.paddr() >= m_lower && page.paddr() <= m_upper; }
+    unsigned used() const { return m_used; }
+    unsigned free() const { return m_pages - m_used; }
+    bool contains(PhysicalAddress paddr) const { return paddr >= m_lower && paddr <= m_upper; }
+    bool contains(const PhysicalPage& page) const { return contains(page.paddr()); }
 
     RefPtr<PhysicalPage> take_free_page(bool supervisor);
     NonnullRefPtrVector<PhysicalPage> take_contiguous_free_pages(size_t count, bool supervisor, size_t physical_alignment = PAGE_SIZE);
-    void return_page(const PhysicalPage& page);
+    void return_page(PhysicalAddress);
 
 private:
-    unsigned find_contiguous_free_pages(size_t count, size_t physical_alignment = PAGE_SIZE);
-    Optional<unsigned> find_and_allocate_contiguous_range(size_t count, unsigned alignment = 1);
-    Optional<unsigned> find_one_free_page();
-    void free_page_at(PhysicalAddress addr);
+    Optional<FlatPtr> allocate_block(unsigned order);
+    Optional<FlatPtr> allocate_block_run(size_t count, size_t alignment_in_pages);
+    void free_block(FlatPtr pfn, unsigned order);
+    void free_range(FlatPtr pfn, size_t count);
+    Optional<size_t> block_index(FlatPtr pfn, unsigned order) const;
 
     PhysicalRegion(PhysicalAddress lower, PhysicalAddress upper);
 
     PhysicalAddress m_lower;
     PhysicalAddress m_upper;
+    FlatPtr m_lower_pfn { 0 };
     unsigned m_pages { 0 };
     unsigned m_used { 0 };
-    Bitmap m_bitmap;
-    size_t m_free_hint { 0 };
-    Vector<PhysicalAddress, 256> m_recently_returned;
+    Bitmap m_free_blocks[max_order + 1];
+    size_t m_free_block_count[max_order + 1] {};
+    size_t m_free_block_hint[max_order + 1] {};
 };
 
 }
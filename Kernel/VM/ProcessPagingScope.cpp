@@ -20,7 +20,7 @@ ProcessPagingScope::~ProcessPagingScope()
 {
     InterruptDisabler disabler;
     Thread::current()->tss().cr3 = m_previous_cr3;
-    write_cr3(m_previous_cr3);
+    Processor::current().load_cr3(m_previous_cr3);
 }
 
 }
@@ -90,6 +90,7 @@ OwnPtr<Region> Region::clone(Process& new_owner)
         region->set_mmap(m_mmap);
         region->set_shared(m_shared);
         region->set_syscall_region(is_syscall_region());
+        region->set_large_pages(m_large_pages);
         return region;
     }
 
@@ -114,6 +115,7 @@ OwnPtr<Region> Region::clone(Process& new_owner)
     }
     clone_region->set_syscall_region(is_syscall_region());
     clone_region->set_mmap(m_mmap);
+    clone_region->set_large_pages(m_large_pages);
     return clone_region;
 }
 
@@ -267,6 +269,67 @@ bool Region::map_individual_page_impl(size_t page_index)
     return true;
 }
 
+bool Region::can_map_large_page(size_t page_index) const
+{
+    if (m_large_pages == LargePages::Forbidden)
+        return false;
+    if (vaddr_from_page_index(page_index).get() % MemoryManager::large_page_size)
+        return false;
+    if (page_index + MemoryManager::pages_per_large_page > page_count())
+        return false;
+    if (!is_readable() && !is_writable())
+        return false;
+
+    // The large page has to be backed by 2 MiB of aligned, physically contiguous
+    // memory, and every page in it has to be mapped with the same protection.
+    auto* first_page = physical_page(page_index);
+    if (!first_page || first_page->paddr().get() % MemoryManager::large_page_size)
+        return false;
+    bool cow = should_cow(page_index);
+    for (size_t i = 0; i < MemoryManager::pages_per_large_page; ++i) {
+        auto* page = physical_page(page_index + i);
+        if (!page || page->is_shared_zero_page() || page->is_lazy_committed_page())
+            return false;
+        if (page->paddr() != first_page->paddr().offset(i * PAGE_SIZE))
+            return false;
+        if (should_cow(page_index + i) != cow)
+            return false;
+    }
+    return true;
+}
+
+bool Region::map_large_page_impl(size_t page_index)
+{
+    VERIFY(m_page_directory->get_lock().own_lock());
+    auto page_vaddr = vaddr_from_page_index(page_index);
+
+    bool user_allowed = page_vaddr.get() >= 0x00800000 && is_user_address(page_vaddr);
+    if (is_mmap() && !user_allowed) {
+        PANIC("About to map mmap'ed page at a kernel address");
+    }
+
+    auto* pde = MM.ensure_large_pde(*m_page_directory, page_vaddr);
+    if (!pde)
+        return false;
+    bool was_mapped = pde->is_present();
+
+    PageDirectoryEntry new_pde;
+    new_pde.clear();
+    new_pde.set_huge(true);
+    new_pde.set_page_table_base(physical_page(page_index)->paddr().get());
+    new_pde.set_cache_disabled(!m_cacheable);
+    new_pde.set_writable(is_writable() && !should_cow(page_index));
+    if (Processor::current().has_feature(CPUFeature::NX))
+        new_pde.set_execute_disabled(!is_executable());
+    new_pde.set_user_allowed(user_allowed);
+    new_pde.set_present(true);
+    *pde = new_pde;
+
+    if (!was_mapped)
+        ++MM.m_large_page_mappings;
+    return true;
+}
+
 bool Region::do_remap_vmobject_page_range(size_t page_index, size_t page_count)
 {
     bool success = true;
@@ -278,6 +341,10 @@ bool Region::do_remap_vmobject_page_range(size_t page_index, size_t page_count)
     ScopedSpinLock page_lock(m_page_directory->get_lock());
     size_t index = page_index;
     while (index < page_index + page_count) {
+        if (index + MemoryManager::pages_per_large_page <= page_index + page_count && can_map_large_page(index) && map_large_page_impl(index)) {
+            index += MemoryManager::pages_per_large_page;
+            continue;
+        }
         if (!map_individual_page_impl(index)) {
             success = false;
             break;
@@ -347,6 +414,10 @@ void Region::unmap(ShouldDeallocateVirtualMemoryRange deallocate_range)
     size_t count = page_count();
     for (size_t i = 0; i < count; ++i) {
         auto vaddr = vaddr_from_page_index(i);
+        if (!(vaddr.get() % MemoryManager::large_page_size) && MM.release_large_pde(*m_page_directory, vaddr)) {
+            i += MemoryManager::pages_per_large_page - 1;
+            continue;
+        }
         MM.release_pte(*m_page_directory, vaddr, i == count - 1);
     }
     MM.flush_tlb(m_page_directory, vaddr(), page_count());
@@ -379,6 +450,10 @@ bool Region::map(PageDirectory& page_directory, ShouldFlushTLB should_flush_tlb)
     set_page_directory(page_directory);
     size_t page_index = 0;
     while (page_index < page_count()) {
+        if (can_map_large_page(page_index) && map_large_page_impl(page_index)) {
+            page_index += MemoryManager::pages_per_large_page;
+            continue;
+        }
         if (!map_individual_page_impl(page_index))
             break;
         ++page_index;
@@ -416,6 +491,8 @@ PageFaultResponse Region::handle_fault(const PageFault& fault, ScopedSpinLock<Re
 
         auto& page_slot = physical_page_slot(page_index_in_region);
         if (page_slot->is_lazy_committed_page()) {
+            if (is_mmap() && m_large_pages != LargePages::Forbidden)
+                return handle_zero_fault(page_index_in_region, mm_lock);
             auto page_index_in_vmobject = translate_to_vmobject_page(page_index_in_region);
             page_slot = static_cast<AnonymousVMObject&>(*m_vmobject).allocate_committed_page(page_index_in_vmobject);
             remap_vmobject_page(page_index_in_vmobject);
@@ -427,7 +504,7 @@ PageFaultResponse Region::handle_fault(const PageFault& fault, ScopedSpinLock<Re
             remap_vmobject_page(translate_to_vmobject_page(page_index_in_region));
             return PageFaultResponse::Continue;
         }
-        return handle_zero_fault(page_index_in_region);
+        return handle_zero_fault(page_index_in_region, mm_lock);
 #else
         dbgln("BUG! Unexpected NP fault at {}", fault.vaddr());
         return PageFaultResponse::ShouldCrash;
@@ -439,7 +516,7 @@ PageFaultResponse Region::handle_fault(const PageFault& fault, ScopedSpinLock<Re
         auto* phys_page = physical_page(page_index_in_region);
         if (phys_page->is_shared_zero_page() || phys_page->is_lazy_committed_page()) {
             dbgln_if(PAGE_FAULT_DEBUG, "NP(zero) fault in Region({})[{}] at {}", this, page_index_in_region, fault.vaddr());
-            return handle_zero_fault(page_index_in_region);
+            return handle_zero_fault(page_index_in_region, mm_lock);
         }
         return handle_cow_fault(page_index_in_region);
     }
@@ -447,7 +524,7 @@ PageFaultResponse Region::handle_fault(const PageFault& fault, ScopedSpinLock<Re
     return PageFaultResponse::ShouldCrash;
 }
 
-PageFaultResponse Region::handle_zero_fault(size_t page_index_in_region)
+PageFaultResponse Region::handle_zero_fault(size_t page_index_in_region, ScopedSpinLock<RecursiveSpinLock>& mm_lock)
 {
     VERIFY_INTERRUPTS_DISABLED();
     VERIFY(vmobject().is_anonymous());
@@ -468,6 +545,34 @@ PageFaultResponse Region::handle_zero_fault(size_t page_index_in_region)
     if (current_thread != nullptr)
         current_thread->did_zero_fault();
 
+    // Memory that has been committed up front is going to be ours either way, but uncommitted
+    // memory is only worth filling in ahead of time when asked to.
+    bool wants_large_page = m_large_pages == LargePages::Requested
+        || (m_large_pages == LargePages::Default && is_mmap() && page_slot->is_lazy_committed_page());
+    if (wants_large_page) {
+        // Fill in the whole surrounding 2 MiB at once if it's all ours and untouched.
+        size_t offset_in_large_page = (vaddr_from_page_index(page_index_in_region).get() % MemoryManager::large_page_size) / PAGE_SIZE;
+        if (offset_in_large_page <= page_index_in_region) {
+            size_t first_page_index_in_region = page_index_in_region - offset_in_large_page;
+            auto first_page_index_in_vmobject = translate_to_vmobject_page(first_page_index_in_region);
+            bool did_allocate_large_page = false;
+            if (first_page_index_in_region + MemoryManager::pages_per_large_page <= page_count()) {
+                // Zeroing 2 MiB takes a while, don't make everyone else wait for the MM lock meanwhile.
+                mm_lock.unlock();
+                did_allocate_large_page = static_cast<AnonymousVMObject&>(*m_vmobject).allocate_large_page(first_page_index_in_vmobject);
+                mm_lock.lock();
+            }
+            if (did_allocate_large_page) {
+                dbgln_if(PAGE_FAULT_DEBUG, "      >> ALLOCATED LARGE PAGE {}", page_slot->paddr());
+                if (!remap_vmobject_page_range(first_page_index_in_vmobject, MemoryManager::pages_per_large_page)) {
+                    dmesgln("MM: handle_zero_fault was unable to map large page at {}", vaddr_from_page_index(first_page_index_in_region));
+                    return PageFaultResponse::OutOfMemory;
+                }
+                return PageFaultResponse::Continue;
+            }
+        }
+    }
+
     if (page_slot->is_lazy_committed_page()) {
         page_slot = static_cast<AnonymousVMObject&>(*m_vmobject).allocate_committed_page(page_index_in_vmobject);
         dbgln_if(PAGE_FAULT_DEBUG, "      >> ALLOCATED COMMITTED {}", page_slot->paddr());
@@ -535,6 +640,28 @@ PageFaultResponse Region::handle_inode_fault(size_t page_index_in_region, Scoped
     if (current_thread)
         current_thread->did_inode_fault();
 
+    if (inode_vmobject.is_shared_inode()) {
+        // Shared mappings use the pages of the page cache directly, so we only need to make sure it's there.
+        mm_lock.unlock();
+
+        KResultOr<size_t> result(KSuccess);
+        {
+            ScopedLockRelease release_paging_lock(vmobject().m_paging_lock);
+            result = static_cast<SharedInodeVMObject&>(inode_vmobject).populate(page_index_in_vmobject, 1);
+        }
+
+        mm_lock.lock();
+
+        if (result.is_error()) {
+            dmesgln("MM: handle_inode_fault had error ({}) while populating the page cache!", result.error());
+            return PageFaultResponse::ShouldCrash;
+        }
+        // NOTE: If the page was purged again in the meantime, we'll simply fault on it once more.
+        if (!remap_vmobject_page(page_index_in_vmobject))
+            return PageFaultResponse::OutOfMemory;
+        return PageFaultResponse::Continue;
+    }
+
     u8 page_buffer[PAGE_SIZE];
     auto& inode = inode_vmobject.inode();
 
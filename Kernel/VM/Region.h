@@ -50,6 +50,12 @@ public:
         Yes,
     };
 
+    enum class LargePages {
+        Default,   // Map 2 MiB at a time where the pages allow it, and fill in committed mmap memory 2 MiB at a time.
+        Requested, // Also fill in uncommitted memory 2 MiB at a time (MADV_HUGEPAGE).
+        Forbidden, // Always map 4 KiB pages (MADV_NOHUGEPAGE).
+    };
+
     static NonnullOwnPtr<Region> create_user_accessible(Process*, const Range&, NonnullRefPtr<VMObject>, size_t offset_in_vmobject, OwnPtr<KString> name, Region::Access access, Cacheable, bool shared);
     static OwnPtr<Region> create_kernel_only(const Range&, NonnullRefPtr<VMObject>, size_t offset_in_vmobject, OwnPtr<KString> name, Region::Access access, Cacheable = Cacheable::Yes);
 
@@ -86,6 +92,9 @@ public:
     bool is_mmap() const { return m_mmap; }
     void set_mmap(bool mmap) { m_mmap = mmap; }
 
+    LargePages large_pages() const { return m_large_pages; }
+    void set_large_pages(LargePages large_pages) { m_large_pages = large_pages; }
+
     bool is_user() const { return !is_kernel(); }
     bool is_kernel() const { return vaddr().get() < 0x00800000 || vaddr().get() >= 0xc0000000; }
 
@@ -244,9 +253,11 @@ private:
 
     PageFaultResponse handle_cow_fault(size_t page_index);
     PageFaultResponse handle_inode_fault(size_t page_index, ScopedSpinLock<RecursiveSpinLock>&);
-    PageFaultResponse handle_zero_fault(size_t page_index);
+    PageFaultResponse handle_zero_fault(size_t page_index, ScopedSpinLock<RecursiveSpinLock>&);
 
     bool map_individual_page_impl(size_t page_index);
+    bool can_map_large_page(size_t page_index) const;
+    bool map_large_page_impl(size_t page_index);
 
     void register_purgeable_page_ranges();
     void unregister_purgeable_page_ranges();
@@ -257,6 +268,7 @@ private:
     NonnullRefPtr<VMObject> m_vmobject;
     OwnPtr<KString> m_name;
     u8 m_access { Region::None };
+    LargePages m_large_pages { LargePages::Default };
     bool m_shared : 1 { false };
     bool m_cacheable : 1 { false };
     bool m_stack : 1 { false };
@@ -5,6 +5,8 @@
  */
 
 #include <Kernel/FileSystem/Inode.h>
+#include <Kernel/VM/MemoryManager.h>
+#include <Kernel/VM/PageCache.h>
 #include <Kernel/VM/SharedInodeVMObject.h>
 
 namespace Kernel {
@@ -12,10 +14,25 @@ namespace Kernel {
 NonnullRefPtr<SharedInodeVMObject> SharedInodeVMObject::create_with_inode(Inode& inode)
 {
     size_t size = inode.size();
-    if (auto shared_vmobject = inode.shared_vmobject())
-        return shared_vmobject.release_nonnull();
+    auto existing_vmobject = inode.shared_vmobject();
+    if (existing_vmobject && (existing_vmobject->size() >= size || existing_vmobject->is_mapped()))
+        return existing_vmobject.release_nonnull();
+
     auto vmobject = adopt_ref(*new SharedInodeVMObject(inode, size));
+    if (existing_vmobject) {
+        // The file has grown since we last looked at it. Nobody has it mapped,
+        // so we can swap in a bigger vmobject that takes over the pages we have.
+        Locker locker(existing_vmobject->m_paging_lock);
+        for (size_t i = 0; i < existing_vmobject->page_count(); ++i) {
+            vmobject->m_physical_pages[i] = existing_vmobject->m_physical_pages[i];
+            if (vmobject->m_physical_pages[i])
+                ++vmobject->m_resident_pages;
+        }
+        PageCache::the().did_add_pages({}, vmobject->m_resident_pages);
+        PageCache::the().forget(inode);
+    }
     vmobject->inode().set_shared_vmobject(*vmobject);
+    PageCache::the().did_create({}, *vmobject);
     return vmobject;
 }
 
@@ -31,7 +48,208 @@ SharedInodeVMObject::SharedInodeVMObject(Inode& inode, size_t size)
 
 SharedInodeVMObject::SharedInodeVMObject(const SharedInodeVMObject& other)
     : InodeVMObject(other)
+    , m_resident_pages(other.m_resident_pages)
+{
+    PageCache::the().did_add_pages({}, m_resident_pages);
+}
+
+SharedInodeVMObject::~SharedInodeVMObject()
+{
+    PageCache::the().did_remove_pages({}, m_resident_pages);
+}
+
+bool SharedInodeVMObject::is_resident(size_t page_index)
+{
+    Locker locker(m_paging_lock);
+    return !m_physical_pages[page_index].is_null();
+}
+
+KResultOr<size_t> SharedInodeVMObject::populate(size_t first_page, size_t page_count)
+{
+    // Holding the inode lock keeps writes from racing with the pages we're
+    // reading in, as they only update pages that are already resident.
+    Locker inode_locker(m_inode->m_lock);
+
+    size_t end_page = min(first_page + page_count, this->page_count());
+    size_t page_index = first_page;
+    size_t pages_read = 0;
+    while (page_index < end_page) {
+        size_t run_start;
+        {
+            Locker locker(m_paging_lock);
+            while (page_index < end_page && m_physical_pages[page_index])
+                ++page_index;
+            run_start = page_index;
+            while (page_index < end_page && !m_physical_pages[page_index] && page_index - run_start < max_readahead_pages)
+                ++page_index;
+        }
+        if (run_start == page_index)
+            break;
+        if (auto result = read_pages(run_start, page_index - run_start); result.is_error())
+            return result;
+        pages_read += page_index - run_start;
+    }
+    return pages_read;
+}
+
+KResult SharedInodeVMObject::read_pages(size_t first_page, size_t page_count)
+{
+    // Read straight into freshly allocated pages and take them over afterwards,
+    // so the whole run is a single request and nothing has to be copied twice.
+    auto region = MM.allocate_kernel_region(page_count * PAGE_SIZE, "Page cache read", Region::Access::Read | Region::Access::Write, AllocationStrategy::AllocateNow);
+    if (!region)
+        return ENOMEM;
+    auto buffer = UserOrKernelBuffer::for_kernel_buffer(region->vaddr().as_ptr());
+    auto nread_or_error = m_inode->read_bytes_uncached(first_page * PAGE_SIZE, page_count * PAGE_SIZE, buffer);
+    if (nread_or_error.is_error())
+        return nread_or_error.error();
+    // NOTE: Anything past the end of the file is left zeroed, as the pages were zero-filled when allocated.
+
+    size_t pages_added = 0;
+    {
+        Locker locker(m_paging_lock);
+        auto& new_pages = region->vmobject().physical_pages();
+        for (size_t i = 0; i < page_count; ++i) {
+            auto& page = m_physical_pages[first_page + i];
+            if (page)
+                continue;
+            page = new_pages[i];
+            ++pages_added;
+        }
+        m_resident_pages += pages_added;
+    }
+    PageCache::the().did_add_pages({}, pages_added);
+    return KSuccess;
+}
+
+void SharedInodeVMObject::read_ahead(u64 offset, size_t count)
+{
+    if (offset == m_next_sequential_offset)
+        m_readahead_pages = clamp(m_readahead_pages * 2, min_readahead_pages, max_readahead_pages);
+    else
+        m_readahead_pages = 0;
+    m_next_sequential_offset = offset + count;
+
+    // Only start reading ahead once we've caught up with the previous window,
+    // so every batch is read in as one request.
+    size_t next_page = (offset + count - 1) / PAGE_SIZE + 1;
+    if (!m_readahead_pages || next_page >= page_count() || is_resident(next_page))
+        return;
+    auto pages_read_or_error = populate(next_page, m_readahead_pages);
+    if (pages_read_or_error.is_error()) {
+        dbgln("SharedInodeVMObject: Readahead of {} pages at page {} failed: {}", m_readahead_pages, next_page, pages_read_or_error.error());
+        return;
+    }
+    PageCache::the().did_read_ahead({}, pages_read_or_error.value());
+}
+
+KResultOr<size_t> SharedInodeVMObject::read_bytes(u64 offset, size_t count, UserOrKernelBuffer& buffer)
+{
+    VERIFY(m_inode->m_lock.is_locked());
+    VERIFY(offset + count <= size());
+    if (count == 0)
+        return 0;
+
+    size_t first_page = offset / PAGE_SIZE;
+    size_t last_page = (offset + count - 1) / PAGE_SIZE;
+    if (auto result = populate(first_page, last_page - first_page + 1); result.is_error())
+        return result.error();
+    read_ahead(offset, count);
+
+    u8 page_buffer[PAGE_SIZE];
+    size_t nread = 0;
+    while (nread < count) {
+        size_t page_index = (offset + nread) / PAGE_SIZE;
+        size_t offset_in_page = (offset + nread) % PAGE_SIZE;
+        size_t chunk_size = min(PAGE_SIZE - offset_in_page, count - nread);
+        bool is_present = false;
+        {
+            Locker locker(m_paging_lock);
+            if (auto& page = m_physical_pages[page_index]) {
+                InterruptDisabler disabler;
+                auto* page_data = MM.quickmap_page(*page);
+                memcpy(page_buffer, page_data + offset_in_page, chunk_size);
+                MM.unquickmap_page();
+                is_present = true;
+            }
+        }
+        if (!is_present) {
+            // The page was purged since we read it in.
+            if (auto result = populate(page_index, 1); result.is_error())
+                return result.error();
+            continue;
+        }
+        // NOTE: The paging lock has been released, as this may fault on a page of this very file.
+        if (!buffer.write(page_buffer, nread, chunk_size))
+            return EFAULT;
+        nread += chunk_size;
+    }
+    return nread;
+}
+
+void SharedInodeVMObject::did_write(u64 offset, size_t count, const UserOrKernelBuffer& data)
+{
+    VERIFY(m_inode->m_lock.is_locked());
+    u8 page_buffer[PAGE_SIZE];
+    size_t nwritten = 0;
+    while (nwritten < count) {
+        size_t page_index = (offset + nwritten) / PAGE_SIZE;
+        if (page_index >= page_count())
+            break;
+        size_t offset_in_page = (offset + nwritten) % PAGE_SIZE;
+        size_t chunk_size = min(PAGE_SIZE - offset_in_page, count - nwritten);
+        if (is_resident(page_index)) {
+            if (!data.read(page_buffer, nwritten, chunk_size))
+                return;
+            Locker locker(m_paging_lock);
+            if (auto& page = m_physical_pages[page_index]) {
+                InterruptDisabler disabler;
+                auto* page_data = MM.quickmap_page(*page);
+                memcpy(page_data + offset_in_page, page_buffer, chunk_size);
+                MM.unquickmap_page();
+            }
+        }
+        nwritten += chunk_size;
+    }
+}
+
+void SharedInodeVMObject::did_truncate(u64 new_size)
+{
+    VERIFY(m_inode->m_lock.is_locked());
+    size_t pages_removed = 0;
+    {
+        Locker locker(m_paging_lock);
+        InterruptDisabler disabler;
+        size_t first_page_to_remove = ceil_div(new_size, static_cast<u64>(PAGE_SIZE));
+        for (size_t i = first_page_to_remove; i < page_count(); ++i) {
+            if (m_physical_pages[i]) {
+                m_physical_pages[i] = nullptr;
+                ++pages_removed;
+            }
+        }
+        // Whatever was in the last page past the new end of the file has to read back as zeroes.
+        size_t offset_in_last_page = new_size % PAGE_SIZE;
+        if (offset_in_last_page && first_page_to_remove - 1 < page_count()) {
+            if (auto& page = m_physical_pages[first_page_to_remove - 1]) {
+                auto* page_data = MM.quickmap_page(*page);
+                memset(page_data + offset_in_last_page, 0, PAGE_SIZE - offset_in_last_page);
+                MM.unquickmap_page();
+            }
+        }
+        m_resident_pages -= pages_removed;
+        if (pages_removed) {
+            for_each_region([](auto& region) {
+                region.remap();
+            });
+        }
+    }
+    PageCache::the().did_remove_pages({}, pages_removed);
+}
+
+void SharedInodeVMObject::did_release_pages(Badge<InodeVMObject>, size_t count)
 {
+    m_resident_pages -= count;
+    PageCache::the().did_remove_pages({}, count);
 }
 
 }
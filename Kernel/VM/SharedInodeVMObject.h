@@ -7,18 +7,34 @@
 #pragma once
 
 #include <AK/Bitmap.h>
+#include <AK/IntrusiveList.h>
 #include <Kernel/UnixTypes.h>
+#include <Kernel/UserOrKernelBuffer.h>
 #include <Kernel/VM/InodeVMObject.h>
 
 namespace Kernel {
 
 class SharedInodeVMObject final : public InodeVMObject {
     AK_MAKE_NONMOVABLE(SharedInodeVMObject);
+    friend class PageCache;
 
 public:
     static NonnullRefPtr<SharedInodeVMObject> create_with_inode(Inode&);
+    virtual ~SharedInodeVMObject() override;
     virtual RefPtr<VMObject> clone() override;
 
+    // Makes sure the given pages are resident, reading the missing ones
+    // from the inode in as few requests as possible.
+    // Returns the number of pages that had to be read in.
+    KResultOr<size_t> populate(size_t first_page, size_t page_count);
+
+    // Keeps resident pages in sync with writes and truncation that went
+    // to the inode directly. The inode must be locked by the caller.
+    void did_write(u64 offset, size_t count, const UserOrKernelBuffer&);
+    void did_truncate(u64 new_size);
+
+    void did_release_pages(Badge<InodeVMObject>, size_t count);
+
 private:
     virtual bool is_shared_inode() const override { return true; }
 
@@ -28,6 +44,25 @@ private:
     virtual const char* class_name() const override { return "SharedInodeVMObject"; }
 
     SharedInodeVMObject& operator=(const SharedInodeVMObject&) = delete;
+
+    KResultOr<size_t> read_bytes(u64 offset, size_t count, UserOrKernelBuffer&);
+    void read_ahead(u64 offset, size_t count);
+    KResult read_pages(size_t first_page, size_t page_count);
+    bool is_resident(size_t page_index);
+
+    // Sequential reads grow the readahead window up to this many pages,
+    // anything else shrinks it back to nothing.
+    static constexpr size_t min_readahead_pages = 4;
+    static constexpr size_t max_readahead_pages = 32;
+
+    u64 m_next_sequential_offset { 0 };
+    size_t m_readahead_pages { 0 };
+    size_t m_resident_pages { 0 };
+
+    IntrusiveListNode<SharedInodeVMObject, RefPtr<SharedInodeVMObject>> m_page_cache_list_node;
+
+public:
+    using PageCacheList = IntrusiveList<SharedInodeVMObject, RefPtr<SharedInodeVMObject>, &SharedInodeVMObject::m_page_cache_list_node>;
 };
 
 }
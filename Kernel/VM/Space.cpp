@@ -12,6 +12,7 @@
 #include <Kernel/VM/InodeVMObject.h>
 #include <Kernel/VM/MemoryManager.h>
 #include <Kernel/VM/Space.h>
+#include <Kernel/VM/TLBShootdownBatch.h>
 
 namespace Kernel {
 
@@ -62,6 +63,11 @@ KResult Space::unmap_mmap_range(VirtualAddress addr, size_t size)
         return KSuccess;
     }
 
+    // Unmapping and remapping the pieces would otherwise send out a TLB shootdown each.
+    // Whole regions we unmap are kept around until the batch has been flushed, see below.
+    Vector<OwnPtr<Region>> unmapped_regions;
+    TLBShootdownBatch tlb_shootdown_batch(page_directory());
+
     if (auto* old_region = find_region_containing(range_to_unmap)) {
         if (!old_region->is_mmap())
             return EPERM;
@@ -105,8 +111,11 @@ KResult Space::unmap_mmap_range(VirtualAddress addr, size_t size)
     for (auto* old_region : regions) {
         // if it's a full match we can delete the complete old region
         if (old_region->range().intersect(range_to_unmap).size() == old_region->size()) {
-            bool res = deallocate_region(*old_region);
-            VERIFY(res);
+            // Its pages mustn't be freed while other processors may still reach them through their TLBs.
+            auto region = take_region(*old_region);
+            VERIFY(region);
+            region->unmap();
+            unmapped_regions.append(move(region));
             continue;
         }
 
@@ -150,6 +159,7 @@ Region& Space::allocate_split_region(const Region& source_region, const Range& r
     region.set_syscall_region(source_region.is_syscall_region());
     region.set_mmap(source_region.is_mmap());
     region.set_stack(source_region.is_stack());
+    region.set_large_pages(source_region.large_pages());
     size_t page_offset_in_source_region = (offset_in_vmobject - source_region.offset_in_vmobject()) / PAGE_SIZE;
     for (size_t i = 0; i < region.page_count(); ++i) {
         if (source_region.should_cow(page_offset_in_source_region + i))
@@ -0,0 +1,74 @@
+/*
+ * Copyright (c) 2021, the SerenityOS developers.
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#include <Kernel/Thread.h>
+#include <Kernel/VM/MemoryManager.h>
+#include <Kernel/VM/TLBShootdownBatch.h>
+
+namespace Kernel {
+
+TLBShootdownBatch::TLBShootdownBatch(const PageDirectory& page_directory)
+    : m_page_directory(page_directory)
+{
+    auto* current_thread = Thread::current();
+    VERIFY(current_thread);
+    m_previous_batch = current_thread->tlb_shootdown_batch();
+    current_thread->set_tlb_shootdown_batch(this);
+}
+
+TLBShootdownBatch::~TLBShootdownBatch()
+{
+    flush();
+    auto* current_thread = Thread::current();
+    VERIFY(current_thread->tlb_shootdown_batch() == this);
+    current_thread->set_tlb_shootdown_batch(m_previous_batch);
+}
+
+static bool is_held_back(const PageDirectory& batch_page_directory, const PageDirectory* page_directory, VirtualAddress vaddr)
+{
+    // Kernel mappings are shared by everyone, so there's nothing to gain from holding them back.
+    return page_directory == &batch_page_directory && is_user_address(vaddr);
+}
+
+bool TLBShootdownBatch::add(const PageDirectory* page_directory, VirtualAddress vaddr, size_t page_count)
+{
+    if (!is_held_back(m_page_directory, page_directory, vaddr))
+        return false;
+
+    // Merge everything into one range. If that gets too big, it ends up flushing the whole TLB.
+    FlatPtr end = vaddr.get() + page_count * PAGE_SIZE;
+    if (m_start == m_end) {
+        m_start = vaddr.get();
+        m_end = end;
+    } else {
+        m_start = min(m_start, vaddr.get());
+        m_end = max(m_end, end);
+    }
+    return true;
+}
+
+bool TLBShootdownBatch::hold_page_table(const PageDirectory* page_directory, VirtualAddress vaddr, NonnullRefPtr<PhysicalPage> page_table)
+{
+    if (!is_held_back(m_page_directory, page_directory, vaddr))
+        return false;
+    // Other processors may still walk the page table from their paging
+    // structure caches, so it mustn't be reused before they have been flushed.
+    m_held_page_tables.append(move(page_table));
+    return true;
+}
+
+void TLBShootdownBatch::flush()
+{
+    if (m_start != m_end) {
+        ScopedSpinLock lock(s_mm_lock);
+        Processor::flush_tlb(&m_page_directory, VirtualAddress(m_start), (m_end - m_start) / PAGE_SIZE);
+        m_start = 0;
+        m_end = 0;
+    }
+    m_held_page_tables.clear();
+}
+
+}
@@ -0,0 +1,44 @@
+/*
+ * Copyright (c) 2021, the SerenityOS developers.
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#pragma once
+
+#include <AK/NonnullRefPtrVector.h>
+#include <AK/Noncopyable.h>
+#include <Kernel/Forward.h>
+#include <Kernel/VM/PhysicalPage.h>
+#include <Kernel/VirtualAddress.h>
+
+namespace Kernel {
+
+// Holds back the TLB invalidations the current thread makes to a page directory's
+// user mappings, and sends them out as a single shootdown once it goes out of scope.
+// Anything that is unmapped while a batch is active has to stay alive until then,
+// as other processors may still be accessing it through their TLBs.
+class TLBShootdownBatch {
+    AK_MAKE_NONCOPYABLE(TLBShootdownBatch);
+    AK_MAKE_NONMOVABLE(TLBShootdownBatch);
+
+public:
+    explicit TLBShootdownBatch(const PageDirectory&);
+    ~TLBShootdownBatch();
+
+    // Returns false if the invalidation has to be done right away instead.
+    bool add(const PageDirectory*, VirtualAddress, size_t page_count);
+    // Keeps a page table that no longer maps vaddr until the batch has been
+    // flushed. Returns false if the invalidation isn't held back by us.
+    bool hold_page_table(const PageDirectory*, VirtualAddress, NonnullRefPtr<PhysicalPage>);
+    void flush();
+
+private:
+    const PageDirectory& m_page_directory;
+    TLBShootdownBatch* m_previous_batch { nullptr };
+    FlatPtr m_start { 0 };
+    FlatPtr m_end { 0 };
+    NonnullRefPtrVector<PhysicalPage> m_held_page_tables;
+};
+
+}
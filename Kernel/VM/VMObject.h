@@ -52,6 +52,7 @@ public:
     ALWAYS_INLINE void ref_region() { m_regions_count++; }
     ALWAYS_INLINE void unref_region() { m_regions_count--; }
     ALWAYS_INLINE bool is_shared_by_multiple_regions() const { return m_regions_count > 1; }
+    ALWAYS_INLINE bool is_mapped() const { return m_regions_count > 0; }
 
     void register_on_deleted_handler(VMObjectDeletedHandler& handler)
     {
@@ -12,10 +12,14 @@
 namespace Kernel {
 
 WorkQueue* g_io_work;
+WorkQueue* g_io_ring_work;
 
 UNMAP_AFTER_INIT void WorkQueue::initialize()
 {
     g_io_work = new WorkQueue("IO WorkQueue");
+    // I/O ring operations may end up waiting for disk I/O, which completes
+    // on g_io_work, so they need a queue of their own.
+    g_io_ring_work = new WorkQueue("IORing WorkQueue");
 }
 
 UNMAP_AFTER_INIT WorkQueue::WorkQueue(const char* name)
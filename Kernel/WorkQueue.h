@@ -12,6 +12,7 @@
 namespace Kernel {
 
 extern WorkQueue* g_io_work;
+extern WorkQueue* g_io_ring_work;
 
 class WorkQueue {
     AK_MAKE_NONCOPYABLE(WorkQueue);
@@ -47,7 +47,9 @@
 #include <Kernel/TTY/PTYMultiplexer.h>
 #include <Kernel/TTY/VirtualConsole.h>
 #include <Kernel/Tasks/FinalizerTask.h>
+#include <Kernel/Tasks/PageZeroingTask.h>
 #include <Kernel/Tasks/SyncTask.h>
+#include <Kernel/Tasks/WriteBackTask.h>
 #include <Kernel/Time/TimeManagement.h>
 #include <Kernel/VM/MemoryManager.h>
 #include <Kernel/VirtIO/VirtIO.h>
@@ -124,6 +126,7 @@ extern "C" UNMAP_AFTER_INIT [[noreturn]] void init()
         (*ctor)();
     kmalloc_init();
     slab_alloc_init();
+    slab_alloc_init_processor();
 
     ConsoleDevice::initialize();
     s_bsp_processor.initialize(0);
@@ -197,6 +200,7 @@ extern "C" UNMAP_AFTER_INIT [[noreturn]] void init_ap(u32 cpu, Processor* proces
     processor_info->early_initialize(cpu);
 
     processor_info->initialize(cpu);
+    slab_alloc_init_processor();
     MemoryManager::initialize(cpu);
 
     Scheduler::set_idle_thread(APIC::the().get_idle_thread(cpu));
@@ -230,6 +234,8 @@ void init_stage2(void*)
     }
 
     SyncTask::spawn();
+    WriteBackTask::spawn();
+    PageZeroingTask::spawn();
     FinalizerTask::spawn();
 
     auto boot_profiling = kernel_command_line().is_boot_profiling_enabled();
@@ -102,6 +102,7 @@ set(LOCK_DEBUG ON)
 set(LOCK_RESTORE_DEBUG ON)
 set(LOCK_TRACE_DEBUG ON)
 set(LOOKUPSERVER_DEBUG ON)
+set(LOOPBACK_DEBUG ON)
 set(MALLOC_DEBUG ON)
 set(MARKDOWN_DEBUG ON)
 set(MATROSKA_DEBUG ON)
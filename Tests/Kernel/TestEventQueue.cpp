@@ -0,0 +1,45 @@
+/*
+ * Copyright (c) 2021, the SerenityOS developers.
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#include <Kernel/API/EventQueue.h>
+#include <LibTest/TestCase.h>
+#include <serenity.h>
+#include <time.h>
+#include <unistd.h>
+
+static constexpr unsigned read_events = static_cast<unsigned>(EventQueueEvents::Read);
+
+TEST_CASE(closing_watched_fd_lets_peer_see_eof)
+{
+    int queue_fd = create_event_queue(0);
+    EXPECT(queue_fd >= 0);
+
+    int pipe_fds[2];
+    EXPECT_EQ(pipe(pipe_fds), 0);
+    int reader_queue_fd = create_event_queue(0);
+    EXPECT(reader_queue_fd >= 0);
+
+    // Watch both ends, then close the write end without removing its interest first.
+    EXPECT_EQ(event_queue_ctl(queue_fd, static_cast<unsigned>(EventQueueOperation::Add), pipe_fds[1], static_cast<unsigned>(EventQueueEvents::Write), 1), 0);
+    EXPECT_EQ(event_queue_ctl(reader_queue_fd, static_cast<unsigned>(EventQueueOperation::Add), pipe_fds[0], read_events, 2), 0);
+    EXPECT_EQ(close(pipe_fds[1]), 0);
+
+    // The pipe has no writers left, so the reader has to be woken up and see EOF.
+    EventQueueEvent event;
+    timespec timeout { 1, 0 };
+    EXPECT_EQ(event_queue_wait(reader_queue_fd, &event, 1, &timeout), 1);
+    EXPECT_EQ(event.user_data, 2u);
+    char buffer;
+    EXPECT_EQ(read(pipe_fds[0], &buffer, 1), 0);
+
+    // The closed fd is dropped from the queue instead of being reported.
+    timespec no_timeout { 0, 0 };
+    EXPECT_EQ(event_queue_wait(queue_fd, &event, 1, &no_timeout), 0);
+
+    close(pipe_fds[0]);
+    close(reader_queue_fd);
+    close(queue_fd);
+}
@@ -0,0 +1,147 @@
+/*
+ * Copyright (c) 2021, the SerenityOS developers.
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#include <AK/String.h>
+#include <LibTest/TestCase.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// NOTE: /tmp is a TmpFS, so use files on the root file system instead.
+static String test_path(const char* name)
+{
+    const char* home = getenv("HOME");
+    return String::formatted("{}/.ext2-allocation-test-{}", home ? home : "/home/anon", name);
+}
+
+// Returns how many runs of blocks that are next to each other on disk the file is made of,
+// or 0 if we aren't allowed to ask (FIBMAP is only for the superuser).
+static size_t count_extents(int fd, size_t block_count)
+{
+    size_t extents = 0;
+    int previous_block = 0;
+    for (size_t i = 0; i < block_count; ++i) {
+        int block = static_cast<int>(i);
+        if (ioctl(fd, FIBMAP, &block) < 0)
+            return 0;
+        EXPECT_NE(block, 0);
+        if (block != previous_block + 1)
+            ++extents;
+        previous_block = block;
+    }
+    return extents;
+}
+
+TEST_CASE(posix_fallocate_allocates_zeroed_blocks)
+{
+    auto path = test_path("fallocate");
+    int fd = open(path.characters(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    EXPECT(fd >= 0);
+
+    constexpr size_t file_size = 256 * 1024;
+    EXPECT_EQ(posix_fallocate(fd, 0, file_size), 0);
+    EXPECT_EQ(posix_fallocate(fd, 0, 0), EINVAL);
+    EXPECT_EQ(fallocate(fd, 1, 0, file_size), -1);
+    EXPECT_EQ(errno, EOPNOTSUPP);
+
+    struct stat st;
+    EXPECT_EQ(fstat(fd, &st), 0);
+    EXPECT_EQ(st.st_size, static_cast<off_t>(file_size));
+    EXPECT(static_cast<size_t>(st.st_blocks) * 512 >= file_size);
+
+    u8 buffer[4096];
+    for (size_t offset = 0; offset < file_size; offset += sizeof(buffer)) {
+        EXPECT_EQ(pread(fd, buffer, sizeof(buffer), offset), static_cast<ssize_t>(sizeof(buffer)));
+        for (auto byte : buffer)
+            EXPECT_EQ(byte, 0);
+    }
+
+    auto extents = count_extents(fd, file_size / st.st_blksize);
+    EXPECT(extents <= 2);
+
+    close(fd);
+    unlink(path.characters());
+}
+
+TEST_CASE(parallel_appends_stay_contiguous)
+{
+    auto first_path = test_path("first");
+    auto second_path = test_path("second");
+    int first_fd = open(first_path.characters(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    int second_fd = open(second_path.characters(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    EXPECT(first_fd >= 0);
+    EXPECT(second_fd >= 0);
+
+    // Take turns appending to both files, like two programs writing their logs would.
+    constexpr size_t file_size = 2 * 1024 * 1024;
+    u8 buffer[1000];
+    for (size_t offset = 0; offset < file_size; offset += sizeof(buffer)) {
+        auto chunk_size = min(sizeof(buffer), file_size - offset);
+        memset(buffer, 'a', chunk_size);
+        EXPECT_EQ(write(first_fd, buffer, chunk_size), static_cast<ssize_t>(chunk_size));
+        memset(buffer, 'b', chunk_size);
+        EXPECT_EQ(write(second_fd, buffer, chunk_size), static_cast<ssize_t>(chunk_size));
+    }
+
+    // The data has to be readable before and after it gets blocks on disk.
+    for (int pass = 0; pass < 2; ++pass) {
+        for (size_t offset = 0; offset < file_size; offset += sizeof(buffer)) {
+            auto chunk_size = min(sizeof(buffer), file_size - offset);
+            EXPECT_EQ(pread(first_fd, buffer, chunk_size, offset), static_cast<ssize_t>(chunk_size));
+            EXPECT_EQ(buffer[0], 'a');
+            EXPECT_EQ(buffer[chunk_size - 1], 'a');
+            EXPECT_EQ(pread(second_fd, buffer, chunk_size, offset), static_cast<ssize_t>(chunk_size));
+            EXPECT_EQ(buffer[0], 'b');
+            EXPECT_EQ(buffer[chunk_size - 1], 'b');
+        }
+        sync();
+    }
+
+    struct stat st;
+    EXPECT_EQ(fstat(first_fd, &st), 0);
+    auto block_count = file_size / st.st_blksize;
+    // Without delayed allocation and reservation windows, the files would alternate block by block.
+    EXPECT(count_extents(first_fd, block_count) < block_count / 32);
+    EXPECT(count_extents(second_fd, block_count) < block_count / 32);
+
+    close(first_fd);
+    close(second_fd);
+    unlink(first_path.characters());
+    unlink(second_path.characters());
+}
+
+TEST_CASE(growing_a_file_leaves_zeroes)
+{
+    auto path = test_path("grow");
+    int fd = open(path.characters(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    EXPECT(fd >= 0);
+
+    u8 buffer[3000];
+    memset(buffer, 'x', sizeof(buffer));
+    EXPECT_EQ(write(fd, buffer, sizeof(buffer)), static_cast<ssize_t>(sizeof(buffer)));
+    EXPECT_EQ(ftruncate(fd, 100), 0);
+    EXPECT_EQ(ftruncate(fd, 100 * 1024), 0);
+    EXPECT_EQ(pwrite(fd, "y", 1, 50 * 1024), 1);
+
+    for (off_t offset = 0; offset < 100 * 1024; offset += sizeof(buffer)) {
+        auto nread = pread(fd, buffer, sizeof(buffer), offset);
+        EXPECT(nread > 0);
+        for (ssize_t i = 0; i < nread; ++i) {
+            u8 expected = offset + i < 100 ? 'x' : (offset + i == 50 * 1024 ? 'y' : 0);
+            if (buffer[i] != expected) {
+                FAIL(String::formatted("Unexpected byte at offset {}", offset + i));
+                break;
+            }
+        }
+    }
+
+    close(fd);
+    unlink(path.characters());
+}
@@ -0,0 +1,109 @@
+/*
+ * Copyright (c) 2021, the SerenityOS developers.
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#include <AK/HashTable.h>
+#include <AK/String.h>
+#include <LibTest/TestCase.h>
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// NOTE: /tmp is a TmpFS, so use a directory on the root file system instead.
+static String test_path(const char* name)
+{
+    const char* home = getenv("HOME");
+    return String::formatted("{}/.ext2-directory-test-{}", home ? home : "/home/anon", name);
+}
+
+static String child_name(size_t name_length, size_t i)
+{
+    auto number = String::number(i);
+    return String::formatted("{}{}", String::repeated('x', name_length - number.length()), number);
+}
+
+static bool create_file(const String& path)
+{
+    int fd = open(path.characters(), O_WRONLY | O_CREAT | O_EXCL, 0644);
+    if (fd < 0)
+        return false;
+    close(fd);
+    return true;
+}
+
+static HashTable<String> read_directory(const String& path)
+{
+    HashTable<String> names;
+    DIR* dir = opendir(path.characters());
+    EXPECT(dir != nullptr);
+    if (!dir)
+        return names;
+    while (auto* entry = readdir(dir)) {
+        if (strcmp(entry->d_name, ".") != 0 && strcmp(entry->d_name, "..") != 0)
+            names.set(entry->d_name);
+    }
+    closedir(dir);
+    return names;
+}
+
+// Enough names to need many directory blocks, and with long names an index that is more than one level deep.
+static void exercise_directory(const char* name, size_t name_length, size_t count)
+{
+    auto directory = test_path(name);
+    EXPECT_EQ(mkdir(directory.characters(), 0755), 0);
+
+    for (size_t i = 0; i < count; ++i) {
+        if (!create_file(String::formatted("{}/{}", directory, child_name(name_length, i)))) {
+            FAIL(String::formatted("Couldn't create file {}: {}", i, strerror(errno)));
+            return;
+        }
+    }
+    EXPECT(!create_file(String::formatted("{}/{}", directory, child_name(name_length, count / 2))));
+    EXPECT_EQ(errno, EEXIST);
+
+    // Remove every other file, and put back every fourth one.
+    for (size_t i = 0; i < count; i += 2)
+        EXPECT_EQ(unlink(String::formatted("{}/{}", directory, child_name(name_length, i)).characters()), 0);
+    for (size_t i = 0; i < count; i += 4)
+        EXPECT(create_file(String::formatted("{}/{}", directory, child_name(name_length, i))));
+
+    auto names = read_directory(directory);
+    size_t expected_count = 0;
+    for (size_t i = 0; i < count; ++i) {
+        bool should_exist = i % 2 == 1 || i % 4 == 0;
+        auto path = String::formatted("{}/{}", directory, child_name(name_length, i));
+        struct stat st;
+        bool exists = stat(path.characters(), &st) == 0;
+        if (exists != should_exist) {
+            FAIL(String::formatted("File {} should {}exist", i, should_exist ? "" : "not "));
+            break;
+        }
+        if (should_exist) {
+            EXPECT(names.contains(child_name(name_length, i)));
+            ++expected_count;
+        }
+    }
+    EXPECT_EQ(names.size(), expected_count);
+
+    EXPECT_EQ(rmdir(directory.characters()), -1);
+    EXPECT_EQ(errno, ENOTEMPTY);
+    for (auto& child : names)
+        EXPECT_EQ(unlink(String::formatted("{}/{}", directory, child).characters()), 0);
+    EXPECT_EQ(rmdir(directory.characters()), 0);
+}
+
+TEST_CASE(many_short_names)
+{
+    exercise_directory("short", 12, 5000);
+}
+
+TEST_CASE(many_long_names)
+{
+    exercise_directory("long", 240, 5000);
+}
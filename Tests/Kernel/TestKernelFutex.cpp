@@ -0,0 +1,136 @@
+/*
+ * Copyright (c) 2021, the SerenityOS developers.
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#include <AK/Atomic.h>
+#include <LibTest/TestCase.h>
+#include <errno.h>
+#include <limits.h>
+#include <pthread.h>
+#include <serenity.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+static constexpr int waiter_count = 4;
+
+static u32 s_futex;
+static u32 s_target_futex;
+static Atomic<int> s_started_waiters;
+static Atomic<bool> s_done;
+
+static void* wait_until_done(void*)
+{
+    ++s_started_waiters;
+    while (!s_done.load())
+        futex(&s_futex, FUTEX_WAIT, 0, nullptr, nullptr, 0);
+    return nullptr;
+}
+
+TEST_CASE(shared_futex_across_processes)
+{
+    auto* word = reinterpret_cast<u32*>(mmap(nullptr, PAGE_SIZE, PROT_READ | PROT_WRITE, MAP_ANONYMOUS | MAP_SHARED, 0, 0));
+    EXPECT(word != MAP_FAILED);
+    *word = 0;
+
+    pid_t pid = fork();
+    EXPECT(pid >= 0);
+    if (pid == 0) {
+        while (AK::atomic_load(word) == 0)
+            futex(word, FUTEX_WAIT, 0, nullptr, nullptr, 0);
+        _exit(0);
+    }
+
+    usleep(10000);
+    AK::atomic_store(word, 1u);
+    EXPECT(futex(word, FUTEX_WAKE, INT_MAX, nullptr, nullptr, 0) >= 0);
+
+    int status = 0;
+    EXPECT_EQ(waitpid(pid, &status, 0), pid);
+    EXPECT(WIFEXITED(status));
+    EXPECT_EQ(WEXITSTATUS(status), 0);
+    munmap(word, PAGE_SIZE);
+}
+
+TEST_CASE(cmp_requeue_moves_waiters)
+{
+    s_futex = 0;
+    s_started_waiters = 0;
+    s_done = false;
+
+    pthread_t threads[waiter_count];
+    for (auto& thread : threads)
+        EXPECT_EQ(pthread_create(&thread, nullptr, wait_until_done, nullptr), 0);
+    while (s_started_waiters.load() < waiter_count)
+        usleep(1000);
+
+    // A mismatched value must not move anyone.
+    EXPECT_EQ(futex(&s_futex, FUTEX_CMP_REQUEUE, 0, reinterpret_cast<const timespec*>(INT_MAX), &s_target_futex, 1), -1);
+    EXPECT_EQ(errno, EAGAIN);
+
+    int requeued = 0;
+    while (requeued < waiter_count) {
+        int rc = futex(&s_futex, FUTEX_CMP_REQUEUE, 0, reinterpret_cast<const timespec*>(INT_MAX), &s_target_futex, 0);
+        EXPECT(rc >= 0);
+        requeued += rc;
+        usleep(1000);
+    }
+    EXPECT_EQ(requeued, waiter_count);
+    EXPECT_EQ(futex(&s_futex, FUTEX_WAKE, INT_MAX, nullptr, nullptr, 0), 0);
+
+    s_done = true;
+    EXPECT_EQ(futex(&s_target_futex, FUTEX_WAKE, INT_MAX, nullptr, nullptr, 0), waiter_count);
+    for (auto& thread : threads)
+        EXPECT_EQ(pthread_join(thread, nullptr), 0);
+}
+
+TEST_CASE(wake_op_modifies_second_word)
+{
+    u32 word = 0;
+    u32 second_word = 5;
+    EXPECT_EQ(futex(&word, FUTEX_WAKE_OP, 1, reinterpret_cast<const timespec*>(1), &second_word, FUTEX_OP(FUTEX_OP_ADD, 3, FUTEX_OP_CMP_EQ, 5)), 0);
+    EXPECT_EQ(second_word, 8u);
+
+    EXPECT_EQ(futex(&word, FUTEX_WAKE_OP, 1, reinterpret_cast<const timespec*>(1), &second_word, FUTEX_OP(FUTEX_OP_OR | FUTEX_OP_ARG_SHIFT, 4, FUTEX_OP_CMP_GT, 0)), 0);
+    EXPECT_EQ(second_word, 24u);
+}
+
+static pthread_mutex_t s_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t s_cond = PTHREAD_COND_INITIALIZER;
+static int s_waiting_for_broadcast;
+static bool s_broadcasted;
+
+static void* wait_for_broadcast(void*)
+{
+    pthread_mutex_lock(&s_mutex);
+    ++s_waiting_for_broadcast;
+    while (!s_broadcasted)
+        pthread_cond_wait(&s_cond, &s_mutex);
+    pthread_mutex_unlock(&s_mutex);
+    return nullptr;
+}
+
+TEST_CASE(cond_broadcast_wakes_every_waiter)
+{
+    pthread_t threads[waiter_count];
+    for (auto& thread : threads)
+        EXPECT_EQ(pthread_create(&thread, nullptr, wait_for_broadcast, nullptr), 0);
+
+    for (;;) {
+        pthread_mutex_lock(&s_mutex);
+        bool all_waiting = s_waiting_for_broadcast == waiter_count;
+        if (all_waiting) {
+            s_broadcasted = true;
+            pthread_cond_broadcast(&s_cond);
+        }
+        pthread_mutex_unlock(&s_mutex);
+        if (all_waiting)
+            break;
+        usleep(1000);
+    }
+
+    for (auto& thread : threads)
+        EXPECT_EQ(pthread_join(thread, nullptr), 0);
+}
@@ -0,0 +1,106 @@
+/*
+ * Copyright (c) 2021, the SerenityOS developers.
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#include <LibTest/TestCase.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+static constexpr size_t large_page_size = 2 * MiB;
+static constexpr size_t mapping_size = 3 * large_page_size;
+
+static u8* map_anonymous(int advice = 0)
+{
+    auto* mapping = reinterpret_cast<u8*>(mmap(nullptr, mapping_size, PROT_READ | PROT_WRITE, MAP_ANONYMOUS | MAP_PRIVATE, 0, 0));
+    EXPECT(mapping != MAP_FAILED);
+    if (advice)
+        EXPECT_EQ(madvise(mapping, mapping_size, advice), 0);
+    return mapping;
+}
+
+static void fill(u8* mapping, size_t size)
+{
+    for (size_t offset = 0; offset < size; offset += 512)
+        mapping[offset] = static_cast<u8>(offset / 512 * 7);
+}
+
+static bool matches(const u8* mapping, size_t first_offset, size_t size)
+{
+    for (size_t offset = first_offset; offset < first_offset + size; offset += 512) {
+        if (mapping[offset] != static_cast<u8>(offset / 512 * 7))
+            return false;
+    }
+    return true;
+}
+
+TEST_CASE(big_anonymous_mappings_are_aligned)
+{
+    auto* mapping = map_anonymous();
+    EXPECT_EQ(reinterpret_cast<FlatPtr>(mapping) % large_page_size, 0u);
+    munmap(mapping, mapping_size);
+}
+
+TEST_CASE(huge_page_advice)
+{
+    auto* mapping = map_anonymous(MADV_HUGEPAGE);
+    fill(mapping, mapping_size);
+    EXPECT(matches(mapping, 0, mapping_size));
+    EXPECT_EQ(madvise(mapping, mapping_size, MADV_NOHUGEPAGE), 0);
+    EXPECT(matches(mapping, 0, mapping_size));
+    EXPECT_EQ(madvise(mapping, mapping_size, MADV_HUGEPAGE | MADV_NOHUGEPAGE), -1);
+    munmap(mapping, mapping_size);
+}
+
+TEST_CASE(partial_mprotect_splits_large_page)
+{
+    auto* mapping = map_anonymous(MADV_HUGEPAGE);
+    fill(mapping, mapping_size);
+
+    EXPECT_EQ(mprotect(mapping + PAGE_SIZE, PAGE_SIZE, PROT_READ), 0);
+    EXPECT(matches(mapping, 0, mapping_size));
+
+    // The pages around the read-only one must still be writable.
+    mapping[0] = 1;
+    mapping[2 * PAGE_SIZE] = 2;
+    EXPECT_EQ(mapping[0], 1);
+    EXPECT_EQ(mapping[2 * PAGE_SIZE], 2);
+    munmap(mapping, mapping_size);
+}
+
+TEST_CASE(partial_munmap_keeps_the_rest)
+{
+    auto* mapping = map_anonymous(MADV_HUGEPAGE);
+    fill(mapping, mapping_size);
+
+    EXPECT_EQ(munmap(mapping + large_page_size + PAGE_SIZE, PAGE_SIZE), 0);
+    EXPECT(matches(mapping, 0, large_page_size + PAGE_SIZE));
+    EXPECT(matches(mapping, large_page_size + 2 * PAGE_SIZE, mapping_size - large_page_size - 2 * PAGE_SIZE));
+    munmap(mapping, mapping_size);
+}
+
+TEST_CASE(copy_on_write_after_fork)
+{
+    auto* mapping = map_anonymous(MADV_HUGEPAGE);
+    fill(mapping, mapping_size);
+
+    pid_t pid = fork();
+    EXPECT(pid >= 0);
+    if (pid == 0) {
+        mapping[PAGE_SIZE] = 0xaa;
+        _exit(matches(mapping, 2 * PAGE_SIZE, mapping_size - 2 * PAGE_SIZE) ? 0 : 1);
+    }
+
+    mapping[3 * PAGE_SIZE] = 0xbb;
+    int status = 0;
+    EXPECT_EQ(waitpid(pid, &status, 0), pid);
+    EXPECT(WIFEXITED(status));
+    EXPECT_EQ(WEXITSTATUS(status), 0);
+
+    // The child's write must not have leaked into our copy.
+    EXPECT(matches(mapping, 0, 3 * PAGE_SIZE));
+    EXPECT_EQ(mapping[3 * PAGE_SIZE], 0xbb);
+    munmap(mapping, mapping_size);
+}
@@ -0,0 +1,123 @@
+/*
+ * Copyright (c) 2021, the SerenityOS developers.
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#include <LibTest/TestCase.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+// NOTE: /tmp is a TmpFS, which doesn't go through the page cache, so use a file on the root file system instead.
+static char s_test_path[256];
+
+static int create_test_file(size_t size)
+{
+    const char* home = getenv("HOME");
+    snprintf(s_test_path, sizeof(s_test_path), "%s/.page-cache-test", home ? home : "/home/anon");
+    int fd = open(s_test_path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    EXPECT(fd >= 0);
+
+    u8 block[4096];
+    for (size_t offset = 0; offset < size; offset += sizeof(block)) {
+        for (size_t i = 0; i < sizeof(block); ++i)
+            block[i] = static_cast<u8>((offset + i) * 7);
+        auto chunk_size = min(sizeof(block), size - offset);
+        EXPECT_EQ(write(fd, block, chunk_size), static_cast<ssize_t>(chunk_size));
+    }
+    return fd;
+}
+
+static void remove_test_file(int fd)
+{
+    close(fd);
+    unlink(s_test_path);
+}
+
+TEST_CASE(sequential_read_matches_contents)
+{
+    constexpr size_t file_size = 1024 * 1024 + 123;
+    int fd = create_test_file(file_size);
+    EXPECT_EQ(lseek(fd, 0, SEEK_SET), 0);
+
+    // Read with an odd size, so reads straddle pages while the readahead window grows.
+    u8 buffer[3000];
+    size_t offset = 0;
+    for (;;) {
+        auto nread = read(fd, buffer, sizeof(buffer));
+        EXPECT(nread >= 0);
+        if (nread <= 0)
+            break;
+        for (ssize_t i = 0; i < nread; ++i) {
+            if (buffer[i] != static_cast<u8>((offset + i) * 7)) {
+                FAIL(String::formatted("Mismatch at offset {}", offset + i));
+                remove_test_file(fd);
+                return;
+            }
+        }
+        offset += nread;
+    }
+    EXPECT_EQ(offset, file_size);
+    remove_test_file(fd);
+}
+
+TEST_CASE(read_sees_shared_mapping_writes)
+{
+    constexpr size_t file_size = 3 * 4096;
+    int fd = create_test_file(file_size);
+
+    u8 byte = 0;
+    EXPECT_EQ(pread(fd, &byte, 1, 5000), 1);
+
+    auto* mapping = reinterpret_cast<u8*>(mmap(nullptr, file_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0));
+    EXPECT(mapping != MAP_FAILED);
+    mapping[5000] = 0xab;
+
+    EXPECT_EQ(pread(fd, &byte, 1, 5000), 1);
+    EXPECT_EQ(byte, 0xab);
+
+    munmap(mapping, file_size);
+    remove_test_file(fd);
+}
+
+TEST_CASE(shared_mapping_sees_writes)
+{
+    constexpr size_t file_size = 3 * 4096;
+    int fd = create_test_file(file_size);
+
+    auto* mapping = reinterpret_cast<u8*>(mmap(nullptr, file_size, PROT_READ, MAP_SHARED, fd, 0));
+    EXPECT(mapping != MAP_FAILED);
+    EXPECT_EQ(mapping[9000], static_cast<u8>(9000 * 7));
+
+    const char* data = "page cache";
+    EXPECT_EQ(pwrite(fd, data, strlen(data), 8190), static_cast<ssize_t>(strlen(data)));
+    EXPECT_EQ(memcmp(mapping + 8190, data, strlen(data)), 0);
+
+    munmap(mapping, file_size);
+    remove_test_file(fd);
+}
+
+TEST_CASE(truncate_and_extend_reads_zeroes)
+{
+    constexpr size_t file_size = 2 * 4096;
+    int fd = create_test_file(file_size);
+
+    u8 buffer[file_size];
+    EXPECT_EQ(pread(fd, buffer, sizeof(buffer), 0), static_cast<ssize_t>(file_size));
+
+    EXPECT_EQ(ftruncate(fd, 100), 0);
+    EXPECT_EQ(ftruncate(fd, file_size), 0);
+    EXPECT_EQ(pread(fd, buffer, sizeof(buffer), 0), static_cast<ssize_t>(file_size));
+    EXPECT_EQ(buffer[99], static_cast<u8>(99 * 7));
+    for (size_t i = 100; i < file_size; ++i) {
+        if (buffer[i] != 0) {
+            FAIL(String::formatted("Stale data at offset {}", i));
+            break;
+        }
+    }
+    remove_test_file(fd);
+}
@@ -0,0 +1,206 @@
+/*
+ * Copyright (c) 2021, the SerenityOS developers.
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#include <AK/String.h>
+#include <Kernel/API/PerformanceEvents.h>
+#include <Kernel/API/Syscall.h>
+#include <LibCore/File.h>
+#include <LibTest/TestCase.h>
+#include <serenity.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+TEST_CASE(perf_events_are_binary_records)
+{
+    EXPECT_EQ(profiling_enable(getpid(), PERF_EVENT_MASK_ALL), 0);
+    constexpr size_t event_count = 100;
+    for (size_t i = 0; i < event_count; ++i)
+        EXPECT_EQ(perf_event(PERF_EVENT_MALLOC, 16, 0x1000 + i), 0);
+    EXPECT_EQ(profiling_disable(getpid()), 0);
+
+    auto file = Core::File::construct(String::formatted("/proc/{}/perf_events", getpid()));
+    EXPECT(file->open(Core::OpenMode::ReadOnly));
+    auto data = file->read_all();
+    EXPECT(data.size() >= sizeof(PerformanceEventStreamHeader));
+
+    auto& header = *reinterpret_cast<const PerformanceEventStreamHeader*>(data.data());
+    EXPECT_EQ(header.magic, performance_event_stream_magic);
+    EXPECT_EQ(header.version, performance_event_stream_version);
+    EXPECT_EQ(header.lost_events, 0u);
+
+    size_t mallocs_seen = 0;
+    bool well_formed = true;
+    for (size_t offset = header.header_size; offset < data.size();) {
+        auto& record = *reinterpret_cast<const PerformanceEventRecord*>(data.data() + offset);
+        if (record.size < sizeof(record) || record.size % performance_event_record_alignment != 0 || record.size > data.size() - offset) {
+            well_formed = false;
+            break;
+        }
+        if (record.type == PERF_EVENT_MALLOC) {
+            EXPECT_EQ(record.pid, static_cast<u32>(getpid()));
+            auto& malloc = *reinterpret_cast<const MallocPerformanceEvent*>(&record + 1);
+            EXPECT_EQ(malloc.size, 16u);
+            EXPECT_EQ(malloc.ptr, 0x1000 + mallocs_seen);
+            ++mallocs_seen;
+        }
+        offset += record.size;
+    }
+    EXPECT(well_formed);
+    EXPECT_EQ(mallocs_seen, event_count);
+
+    EXPECT_EQ(profiling_free_buffer(getpid()), 0);
+}
+
+static void set_tracepoint_enabled(const char* name, bool enabled)
+{
+    auto file = Core::File::construct(String::formatted("/proc/sys/trace_{}", name));
+    EXPECT(file->open(Core::OpenMode::WriteOnly));
+    EXPECT(file->write(enabled ? "1" : "0"));
+}
+
+TEST_CASE(syscall_tracepoints)
+{
+    set_tracepoint_enabled("syscall_enter", true);
+    set_tracepoint_enabled("syscall_exit", true);
+    EXPECT_EQ(profiling_enable(getpid(), PERF_EVENT_TRACEPOINT), 0);
+    constexpr size_t syscall_count = 10;
+    for (size_t i = 0; i < syscall_count; ++i)
+        (void)getppid();
+    EXPECT_EQ(profiling_disable(getpid()), 0);
+    set_tracepoint_enabled("syscall_enter", false);
+    set_tracepoint_enabled("syscall_exit", false);
+
+    auto file = Core::File::construct(String::formatted("/proc/{}/perf_events", getpid()));
+    EXPECT(file->open(Core::OpenMode::ReadOnly));
+    auto data = file->read_all();
+    EXPECT(data.size() >= sizeof(PerformanceEventStreamHeader));
+    auto& header = *reinterpret_cast<const PerformanceEventStreamHeader*>(data.data());
+
+    size_t enters_seen = 0;
+    size_t exits_seen = 0;
+    u64 last_timestamp_ns = 0;
+    for (size_t offset = header.header_size; offset + sizeof(PerformanceEventRecord) <= data.size();) {
+        auto& record = *reinterpret_cast<const PerformanceEventRecord*>(data.data() + offset);
+        if (record.size == 0)
+            break;
+        offset += record.size;
+        if (record.type != PERF_EVENT_TRACEPOINT)
+            continue;
+        auto& tracepoint = *reinterpret_cast<const TracepointPerformanceEvent*>(&record + 1);
+        EXPECT(tracepoint.timestamp_ns >= last_timestamp_ns);
+        last_timestamp_ns = tracepoint.timestamp_ns;
+        if (tracepoint.arg1 != Syscall::SC_getppid)
+            continue;
+        if (tracepoint.tracepoint == static_cast<u16>(Tracepoint::syscall_enter)) {
+            ++enters_seen;
+        } else if (tracepoint.tracepoint == static_cast<u16>(Tracepoint::syscall_exit)) {
+            EXPECT_EQ(tracepoint.arg2, static_cast<FlatPtr>(getppid()));
+            ++exits_seen;
+        }
+    }
+    EXPECT(enters_seen >= syscall_count);
+    EXPECT(exits_seen >= syscall_count);
+
+    EXPECT_EQ(profiling_free_buffer(getpid()), 0);
+}
+
+static PerformanceEventRingHeader* map_ring(unsigned processor, size_t& size)
+{
+    int fd = profiling_open_ring(processor);
+    EXPECT(fd >= 0);
+    if (fd < 0)
+        return nullptr;
+    auto* header = reinterpret_cast<PerformanceEventRingHeader*>(mmap(nullptr, PAGE_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0));
+    EXPECT(header != MAP_FAILED);
+    size = header->data_offset + header->data_size;
+    munmap(header, PAGE_SIZE);
+    header = reinterpret_cast<PerformanceEventRingHeader*>(mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0));
+    close(fd);
+    EXPECT(header != MAP_FAILED);
+    return header == MAP_FAILED ? nullptr : header;
+}
+
+// Copies the ready records out of a ring as they are, like "profile -a" does.
+static void drain_ring(PerformanceEventRingHeader& header, Vector<u8>& stream)
+{
+    auto* data = reinterpret_cast<u8*>(&header) + header.data_offset;
+    u32 head = __atomic_load_n(&header.head, __ATOMIC_ACQUIRE);
+    u32 tail = header.tail;
+    while (tail != head) {
+        u32 offset = tail & (header.data_size - 1);
+        u32 size = min(head - tail, header.data_size - offset);
+        stream.append(data + offset, size);
+        tail += size;
+    }
+    __atomic_store_n(&header.tail, tail, __ATOMIC_RELEASE);
+}
+
+TEST_CASE(streamed_rings_wrap_around)
+{
+    // Only the superuser can profile all processes.
+    if (getuid() != 0)
+        return;
+
+    EXPECT_EQ(profiling_enable(-1, PERF_EVENT_MALLOC), 0);
+    long processor_count = sysconf(_SC_NPROCESSORS_ONLN);
+    Vector<PerformanceEventRingHeader*> rings;
+    Vector<size_t> ring_sizes;
+    for (long processor = 0; processor < processor_count; ++processor) {
+        size_t size = 0;
+        rings.append(map_ring(processor, size));
+        ring_sizes.append(size);
+    }
+
+    // Keep going until one of the rings has gone around twice, so that its records
+    // had to skip over the end of it at least once.
+    Vector<u8> stream;
+    bool wrapped = false;
+    size_t events_recorded = 0;
+    for (size_t round = 0; round < 10000 && !wrapped; ++round) {
+        for (size_t i = 0; i < 1000; ++i, ++events_recorded)
+            (void)perf_event(PERF_EVENT_MALLOC, 16, 0x1000 + events_recorded);
+        for (auto* ring : rings) {
+            if (!ring)
+                continue;
+            if (__atomic_load_n(&ring->head, __ATOMIC_ACQUIRE) >= 2 * ring->data_size)
+                wrapped = true;
+            drain_ring(*ring, stream);
+        }
+    }
+    EXPECT_EQ(profiling_disable(-1), 0);
+    for (size_t i = 0; i < rings.size(); ++i) {
+        if (!rings[i])
+            continue;
+        drain_ring(*rings[i], stream);
+        munmap(rings[i], ring_sizes[i]);
+    }
+    EXPECT_EQ(profiling_free_buffer(-1), 0);
+    EXPECT(wrapped);
+
+    size_t paddings_seen = 0;
+    size_t mallocs_seen = 0;
+    bool well_formed = true;
+    for (size_t offset = 0; offset < stream.size();) {
+        auto& record = *reinterpret_cast<const PerformanceEventRecord*>(stream.data() + offset);
+        if (record.size == 0 || record.size % performance_event_record_alignment != 0 || record.size > stream.size() - offset) {
+            well_formed = false;
+            break;
+        }
+        if (record.type == performance_event_padding) {
+            ++paddings_seen;
+        } else if (record.size < sizeof(PerformanceEventRecord)) {
+            well_formed = false;
+            break;
+        } else if (record.type == PERF_EVENT_MALLOC && record.pid == static_cast<u32>(getpid())) {
+            ++mallocs_seen;
+        }
+        offset += record.size;
+    }
+    EXPECT(well_formed);
+    EXPECT(paddings_seen > 0);
+    EXPECT(mallocs_seen > 0);
+    EXPECT(mallocs_seen <= events_recorded);
+}
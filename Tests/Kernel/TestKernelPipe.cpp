@@ -0,0 +1,108 @@
+/*
+ * Copyright (c) 2021, the SerenityOS developers.
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#include <LibTest/TestCase.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+static void make_pipe(int fds[2])
+{
+    EXPECT_EQ(pipe(fds), 0);
+    EXPECT_EQ(fcntl(fds[1], F_SETFL, O_NONBLOCK), 0);
+}
+
+static size_t fill_pipe(int fd)
+{
+    char buffer[1000];
+    memset(buffer, 'x', sizeof(buffer));
+    size_t total = 0;
+    for (;;) {
+        auto nwritten = write(fd, buffer, sizeof(buffer));
+        if (nwritten < 0) {
+            EXPECT_EQ(errno, EAGAIN);
+            return total;
+        }
+        total += nwritten;
+    }
+}
+
+TEST_CASE(pipe_capacity)
+{
+    int fds[2];
+    make_pipe(fds);
+    EXPECT_EQ(fcntl(fds[0], F_GETPIPE_SZ), static_cast<int>(64 * KiB));
+    EXPECT_EQ(fill_pipe(fds[1]), 64 * KiB);
+
+    // There's more buffered than would fit.
+    EXPECT_EQ(fcntl(fds[1], F_SETPIPE_SZ, 16 * KiB), -1);
+    EXPECT_EQ(errno, EBUSY);
+
+    // Growing it makes room, and the capacity is rounded up to a power of two pages.
+    EXPECT_EQ(fcntl(fds[1], F_SETPIPE_SZ, 100 * KiB), static_cast<int>(128 * KiB));
+    EXPECT_EQ(fill_pipe(fds[1]), 64 * KiB);
+
+    EXPECT_EQ(fcntl(fds[1], F_SETPIPE_SZ, 64 * MiB), -1);
+    EXPECT_EQ(errno, EPERM);
+
+    char buffer[PAGE_SIZE];
+    size_t total_read = 0;
+    while (total_read < 128 * KiB) {
+        auto nread = read(fds[0], buffer, sizeof(buffer));
+        EXPECT(nread > 0);
+        EXPECT_EQ(buffer[0], 'x');
+        total_read += nread;
+    }
+    EXPECT_EQ(total_read, 128 * KiB);
+    close(fds[0]);
+    close(fds[1]);
+}
+
+TEST_CASE(vmsplice_gift_is_copy_on_write)
+{
+    int fds[2];
+    make_pipe(fds);
+
+    constexpr size_t size = 4 * PAGE_SIZE;
+    auto* memory = reinterpret_cast<u8*>(mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_ANONYMOUS | MAP_PRIVATE, 0, 0));
+    EXPECT(memory != MAP_FAILED);
+    for (size_t i = 0; i < size; ++i)
+        memory[i] = i % 251;
+
+    // Start halfway into the first page, so it has to be partly copied.
+    iovec vec { memory + PAGE_SIZE / 2, size - PAGE_SIZE / 2 };
+    EXPECT_EQ(vmsplice(fds[1], &vec, 1, SPLICE_F_GIFT), static_cast<ssize_t>(vec.iov_len));
+
+    // Changing the memory afterwards mustn't change what's in the pipe.
+    memset(memory, 0, size);
+
+    u8 buffer[size];
+    EXPECT_EQ(read(fds[0], buffer, sizeof(buffer)), static_cast<ssize_t>(vec.iov_len));
+    bool matches = true;
+    for (size_t i = 0; i < vec.iov_len; ++i) {
+        if (buffer[i] != static_cast<u8>((i + PAGE_SIZE / 2) % 251))
+            matches = false;
+    }
+    EXPECT(matches);
+
+    munmap(memory, size);
+    close(fds[0]);
+    close(fds[1]);
+}
+
+TEST_CASE(vmsplice_needs_a_pipe)
+{
+    char data[] = "hello";
+    iovec vec { data, sizeof(data) };
+    int fd = open("/dev/null", O_WRONLY);
+    EXPECT(fd >= 0);
+    EXPECT_EQ(vmsplice(fd, &vec, 1, 0), -1);
+    EXPECT_EQ(errno, EBADF);
+    close(fd);
+}
@@ -0,0 +1,127 @@
+/*
+ * Copyright (c) 2021, the SerenityOS developers.
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#include <LibTest/TestCase.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/sendfile.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+static constexpr const char* test_path = "/tmp/sendfile-test";
+static constexpr const char* test_data = "Hello friends, this is a test of moving data around in the kernel!";
+
+static int create_test_file()
+{
+    int fd = open(test_path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    EXPECT(fd >= 0);
+    EXPECT_EQ(write(fd, test_data, strlen(test_data)), static_cast<ssize_t>(strlen(test_data)));
+    EXPECT_EQ(lseek(fd, 0, SEEK_SET), 0);
+    return fd;
+}
+
+TEST_CASE(sendfile_into_pipe)
+{
+    int file_fd = create_test_file();
+    int pipe_fds[2];
+    EXPECT_EQ(pipe(pipe_fds), 0);
+
+    auto nsent = sendfile(pipe_fds[1], file_fd, nullptr, 4096);
+    EXPECT_EQ(nsent, static_cast<ssize_t>(strlen(test_data)));
+    EXPECT_EQ(lseek(file_fd, 0, SEEK_CUR), static_cast<off_t>(strlen(test_data)));
+
+    char buffer[128] {};
+    EXPECT_EQ(read(pipe_fds[0], buffer, sizeof(buffer)), nsent);
+    EXPECT_EQ(memcmp(buffer, test_data, nsent), 0);
+
+    // We're at the end of the file now.
+    EXPECT_EQ(sendfile(pipe_fds[1], file_fd, nullptr, 4096), 0);
+
+    close(pipe_fds[0]);
+    close(pipe_fds[1]);
+    close(file_fd);
+    unlink(test_path);
+}
+
+TEST_CASE(sendfile_into_socket_at_offset)
+{
+    int file_fd = create_test_file();
+    int socket_fds[2];
+    EXPECT_EQ(socketpair(AF_LOCAL, SOCK_STREAM, 0, socket_fds), 0);
+
+    off_t offset = 6;
+    EXPECT_EQ(sendfile(socket_fds[0], file_fd, &offset, 7), 7);
+    EXPECT_EQ(offset, 13);
+    // The file offset isn't used or changed when an offset is given.
+    EXPECT_EQ(lseek(file_fd, 0, SEEK_CUR), 0);
+
+    char buffer[16] {};
+    EXPECT_EQ(read(socket_fds[1], buffer, sizeof(buffer)), 7);
+    EXPECT_EQ(memcmp(buffer, "friends", 7), 0);
+
+    close(socket_fds[0]);
+    close(socket_fds[1]);
+    close(file_fd);
+    unlink(test_path);
+}
+
+TEST_CASE(sendfile_from_pipe)
+{
+    int pipe_fds[2];
+    EXPECT_EQ(pipe(pipe_fds), 0);
+    int socket_fds[2];
+    EXPECT_EQ(socketpair(AF_LOCAL, SOCK_STREAM, 0, socket_fds), 0);
+
+    EXPECT_EQ(sendfile(socket_fds[0], pipe_fds[0], nullptr, 16), -1);
+    EXPECT_EQ(errno, EINVAL);
+
+    close(socket_fds[0]);
+    close(socket_fds[1]);
+    close(pipe_fds[0]);
+    close(pipe_fds[1]);
+}
+
+TEST_CASE(splice_pipe_into_file)
+{
+    int file_fd = open(test_path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    EXPECT(file_fd >= 0);
+    int pipe_fds[2];
+    EXPECT_EQ(pipe(pipe_fds), 0);
+
+    EXPECT_EQ(write(pipe_fds[1], test_data, strlen(test_data)), static_cast<ssize_t>(strlen(test_data)));
+    off_t offset = 0;
+    EXPECT_EQ(splice(pipe_fds[0], nullptr, file_fd, &offset, strlen(test_data), 0), static_cast<ssize_t>(strlen(test_data)));
+    EXPECT_EQ(offset, static_cast<off_t>(strlen(test_data)));
+
+    char buffer[128] {};
+    EXPECT_EQ(pread(file_fd, buffer, sizeof(buffer), 0), static_cast<ssize_t>(strlen(test_data)));
+    EXPECT_EQ(memcmp(buffer, test_data, strlen(test_data)), 0);
+
+    // The pipe is empty now, so a non-blocking splice has nothing to do.
+    EXPECT_EQ(splice(pipe_fds[0], nullptr, file_fd, nullptr, 16, SPLICE_F_NONBLOCK), -1);
+    EXPECT_EQ(errno, EAGAIN);
+
+    close(pipe_fds[0]);
+    close(pipe_fds[1]);
+    close(file_fd);
+    unlink(test_path);
+}
+
+TEST_CASE(splice_needs_a_pipe)
+{
+    int file_fd = create_test_file();
+    int socket_fds[2];
+    EXPECT_EQ(socketpair(AF_LOCAL, SOCK_STREAM, 0, socket_fds), 0);
+
+    EXPECT_EQ(splice(file_fd, nullptr, socket_fds[0], nullptr, 16, 0), -1);
+    EXPECT_EQ(errno, EINVAL);
+
+    close(socket_fds[0]);
+    close(socket_fds[1]);
+    close(file_fd);
+    unlink(test_path);
+}
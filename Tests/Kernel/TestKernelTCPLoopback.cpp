@@ -0,0 +1,223 @@
+/*
+ * Copyright (c) 2021, the SerenityOS developers.
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#include <LibTest/TestCase.h>
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+static constexpr size_t transfer_size = 32 * MiB;
+
+static u8 pattern_byte(size_t offset)
+{
+    return static_cast<u8>(offset % 251);
+}
+
+static int listen_on_loopback(u16& port)
+{
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    EXPECT(fd >= 0);
+    sockaddr_in address {};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    address.sin_port = 0;
+    EXPECT_EQ(bind(fd, reinterpret_cast<const sockaddr*>(&address), sizeof(address)), 0);
+    EXPECT_EQ(listen(fd, 1), 0);
+    socklen_t address_size = sizeof(address);
+    EXPECT_EQ(getsockname(fd, reinterpret_cast<sockaddr*>(&address), &address_size), 0);
+    port = ntohs(address.sin_port);
+    return fd;
+}
+
+// Runs in a child process, so it can't use EXPECT().
+static int send_pattern(u16 port, const char* congestion_control)
+{
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0)
+        return 1;
+    if (setsockopt(fd, IPPROTO_TCP, TCP_CONGESTION, congestion_control, strlen(congestion_control)) < 0)
+        return 2;
+    sockaddr_in address {};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    address.sin_port = htons(port);
+    if (connect(fd, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) < 0)
+        return 3;
+
+    u8 buffer[64 * KiB];
+    size_t total_sent = 0;
+    while (total_sent < transfer_size) {
+        size_t chunk_size = min(sizeof(buffer), transfer_size - total_sent);
+        for (size_t i = 0; i < chunk_size; ++i)
+            buffer[i] = pattern_byte(total_sent + i);
+        size_t chunk_sent = 0;
+        while (chunk_sent < chunk_size) {
+            auto nwritten = write(fd, buffer + chunk_sent, chunk_size - chunk_sent);
+            if (nwritten <= 0)
+                return 4;
+            chunk_sent += nwritten;
+        }
+        total_sent += chunk_size;
+    }
+    close(fd);
+    return 0;
+}
+
+static void transfer_over_loopback(const char* congestion_control)
+{
+    u16 port = 0;
+    int listen_fd = listen_on_loopback(port);
+
+    timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    pid_t pid = fork();
+    EXPECT(pid >= 0);
+    if (pid == 0)
+        _exit(send_pattern(port, congestion_control));
+
+    int fd = accept(listen_fd, nullptr, nullptr);
+    EXPECT(fd >= 0);
+
+    u8 buffer[64 * KiB];
+    size_t total_received = 0;
+    bool matches = true;
+    for (;;) {
+        auto nread = read(fd, buffer, sizeof(buffer));
+        EXPECT(nread >= 0);
+        if (nread <= 0)
+            break;
+        for (ssize_t i = 0; i < nread; ++i) {
+            if (buffer[i] != pattern_byte(total_received + i))
+                matches = false;
+        }
+        total_received += nread;
+    }
+
+    timespec end;
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    int status = 0;
+    EXPECT_EQ(waitpid(pid, &status, 0), pid);
+    EXPECT(WIFEXITED(status));
+    EXPECT_EQ(WEXITSTATUS(status), 0);
+    EXPECT_EQ(total_received, transfer_size);
+    EXPECT(matches);
+
+    size_t mebibytes = transfer_size / MiB;
+    double seconds = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1'000'000'000.0;
+    if (seconds > 0)
+        printf("%s: %zu MiB in %.2fs, %.1f MiB/s\n", congestion_control, mebibytes, seconds, mebibytes / seconds);
+
+    close(fd);
+    close(listen_fd);
+}
+
+TEST_CASE(congestion_control_option)
+{
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    EXPECT(fd >= 0);
+
+    char name[TCP_CA_NAME_MAX] {};
+    socklen_t name_size = sizeof(name);
+    EXPECT_EQ(getsockopt(fd, IPPROTO_TCP, TCP_CONGESTION, name, &name_size), 0);
+    EXPECT_EQ(StringView(name), "cubic");
+
+    EXPECT_EQ(setsockopt(fd, IPPROTO_TCP, TCP_CONGESTION, "reno", 4), 0);
+    name_size = sizeof(name);
+    EXPECT_EQ(getsockopt(fd, IPPROTO_TCP, TCP_CONGESTION, name, &name_size), 0);
+    EXPECT_EQ(StringView(name), "reno");
+
+    EXPECT_EQ(setsockopt(fd, IPPROTO_TCP, TCP_CONGESTION, "vegas", 5), -1);
+    EXPECT_EQ(errno, ENOENT);
+    close(fd);
+}
+
+TEST_CASE(loopback_throughput_reno)
+{
+    transfer_over_loopback("reno");
+}
+
+TEST_CASE(loopback_throughput_cubic)
+{
+    transfer_over_loopback("cubic");
+}
+
+// Writes as much as the socket takes until it hasn't become writable for timeout_ms.
+static size_t write_until_stalled(int fd, int timeout_ms)
+{
+    u8 buffer[16 * KiB] {};
+    size_t total_written = 0;
+    for (;;) {
+        auto nwritten = write(fd, buffer, sizeof(buffer));
+        if (nwritten > 0) {
+            total_written += nwritten;
+            continue;
+        }
+        EXPECT_EQ(errno, EAGAIN);
+        pollfd poll_fd { fd, POLLOUT, 0 };
+        if (poll(&poll_fd, 1, timeout_ms) <= 0)
+            return total_written;
+    }
+}
+
+TEST_CASE(zero_window_is_probed)
+{
+    u16 port = 0;
+    int listen_fd = listen_on_loopback(port);
+
+    int sender_fd = socket(AF_INET, SOCK_STREAM, 0);
+    EXPECT(sender_fd >= 0);
+    sockaddr_in address {};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    address.sin_port = htons(port);
+    EXPECT_EQ(connect(sender_fd, reinterpret_cast<const sockaddr*>(&address), sizeof(address)), 0);
+    int receiver_fd = accept(listen_fd, nullptr, nullptr);
+    EXPECT(receiver_fd >= 0);
+    EXPECT_EQ(fcntl(sender_fd, F_SETFL, O_NONBLOCK), 0);
+
+    // Fill the receive buffer until the receiver closes its window.
+    EXPECT(write_until_stalled(sender_fd, 1000) > 0);
+
+    // Reading this little doesn't make the receiver announce the space (RFC 1122
+    // section 4.2.3.3), which looks just like a window update that got lost.
+    u8 buffer[16 * KiB];
+    size_t total_read = 0;
+    while (total_read < sizeof(buffer)) {
+        auto nread = read(receiver_fd, buffer + total_read, sizeof(buffer) - total_read);
+        EXPECT(nread > 0);
+        if (nread <= 0)
+            break;
+        total_read += nread;
+    }
+
+    // Only probing the window tells the sender that it has opened up again.
+    size_t written_after_read = 0;
+    timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (;;) {
+        written_after_read += write_until_stalled(sender_fd, 1000);
+        timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        if (written_after_read >= sizeof(buffer) / 2 || now.tv_sec - start.tv_sec > 30)
+            break;
+    }
+    EXPECT(written_after_read >= sizeof(buffer) / 2);
+
+    close(receiver_fd);
+    close(sender_fd);
+    close(listen_fd);
+}
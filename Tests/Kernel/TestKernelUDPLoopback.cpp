@@ -0,0 +1,65 @@
+/*
+ * Copyright (c) 2021, the SerenityOS developers.
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#include <LibTest/TestCase.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <stdio.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+// Stays below the limits on how many packets the loopback adapter and a socket will queue up.
+static constexpr size_t datagrams_per_round = 500;
+static constexpr size_t rounds = 200;
+
+TEST_CASE(small_datagram_rate)
+{
+    int fd = socket(AF_INET, SOCK_DGRAM, 0);
+    EXPECT(fd >= 0);
+    sockaddr_in address {};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    address.sin_port = 0;
+    EXPECT_EQ(bind(fd, reinterpret_cast<const sockaddr*>(&address), sizeof(address)), 0);
+    socklen_t address_size = sizeof(address);
+    EXPECT_EQ(getsockname(fd, reinterpret_cast<sockaddr*>(&address), &address_size), 0);
+
+    timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    u32 next_to_send = 0;
+    u32 next_to_receive = 0;
+    bool in_order = true;
+    for (size_t round = 0; round < rounds; ++round) {
+        for (size_t i = 0; i < datagrams_per_round; ++i) {
+            auto nsent = sendto(fd, &next_to_send, sizeof(next_to_send), 0, reinterpret_cast<const sockaddr*>(&address), sizeof(address));
+            EXPECT_EQ(nsent, static_cast<ssize_t>(sizeof(next_to_send)));
+            ++next_to_send;
+        }
+        for (size_t i = 0; i < datagrams_per_round; ++i) {
+            u32 value = 0;
+            auto nreceived = recv(fd, &value, sizeof(value), 0);
+            EXPECT_EQ(nreceived, static_cast<ssize_t>(sizeof(value)));
+            if (value != next_to_receive)
+                in_order = false;
+            ++next_to_receive;
+        }
+    }
+
+    timespec end;
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    EXPECT(in_order);
+    EXPECT_EQ(next_to_receive, next_to_send);
+
+    size_t datagram_count = rounds * datagrams_per_round;
+    double seconds = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1'000'000'000.0;
+    if (seconds > 0)
+        printf("%zu datagrams in %.2fs, %.0f datagrams/s\n", datagram_count, seconds, datagram_count / seconds);
+
+    close(fd);
+}
@@ -0,0 +1,193 @@
+/*
+ * Copyright (c) 2021, the SerenityOS developers.
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#include <AK/Vector.h>
+#include <Kernel/API/EventQueue.h>
+#include <LibCore/ArgsParser.h>
+#include <serenity.h>
+#include <stdio.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+// Compares the cost of waiting for a fixed number of active local sockets
+// with select() and with an event queue while more and more idle sockets
+// are being watched as well. With the event queue the idle sockets should
+// not make any difference.
+
+struct SocketPair {
+    int read_fd { -1 };
+    int write_fd { -1 };
+};
+
+static int s_rounds = 1000;
+
+static bool create_pairs(Vector<SocketPair>& pairs, int count)
+{
+    for (int i = 0; i < count; i++) {
+        int fds[2];
+        if (socketpair(AF_LOCAL, SOCK_STREAM, 0, fds) < 0) {
+            perror("socketpair");
+            return false;
+        }
+        pairs.append({ fds[0], fds[1] });
+    }
+    return true;
+}
+
+static void close_pairs(Vector<SocketPair>& pairs)
+{
+    for (auto& pair : pairs) {
+        close(pair.read_fd);
+        close(pair.write_fd);
+    }
+    pairs.clear();
+}
+
+static bool make_active_pairs_readable(const Vector<SocketPair>& active)
+{
+    char byte = 0;
+    for (auto& pair : active) {
+        if (write(pair.write_fd, &byte, 1) != 1) {
+            perror("write");
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool drain(int fd)
+{
+    char byte;
+    if (read(fd, &byte, 1) != 1) {
+        perror("read");
+        return false;
+    }
+    return true;
+}
+
+static double run_select(const Vector<SocketPair>& idle, const Vector<SocketPair>& active)
+{
+    timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    for (int round = 0; round < s_rounds; round++) {
+        if (!make_active_pairs_readable(active))
+            return -1;
+        size_t remaining = active.size();
+        while (remaining > 0) {
+            fd_set rfds;
+            FD_ZERO(&rfds);
+            int max_fd = 0;
+            for (auto& list : { &idle, &active }) {
+                for (auto& pair : *list) {
+                    FD_SET(pair.read_fd, &rfds);
+                    max_fd = max(max_fd, pair.read_fd);
+                }
+            }
+            if (select(max_fd + 1, &rfds, nullptr, nullptr, nullptr) < 0) {
+                perror("select");
+                return -1;
+            }
+            for (auto& pair : active) {
+                if (!FD_ISSET(pair.read_fd, &rfds))
+                    continue;
+                if (!drain(pair.read_fd))
+                    return -1;
+                remaining--;
+            }
+        }
+    }
+
+    timespec end;
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    return (end.tv_sec - start.tv_sec) * 1'000'000.0 + (end.tv_nsec - start.tv_nsec) / 1'000.0;
+}
+
+static double run_event_queue(const Vector<SocketPair>& idle, const Vector<SocketPair>& active)
+{
+    int queue_fd = create_event_queue(0);
+    if (queue_fd < 0) {
+        perror("create_event_queue");
+        return -1;
+    }
+
+    for (auto& list : { &idle, &active }) {
+        for (auto& pair : *list) {
+            if (event_queue_ctl(queue_fd, static_cast<unsigned>(EventQueueOperation::Add), pair.read_fd, static_cast<unsigned>(EventQueueEvents::Read), pair.read_fd) < 0) {
+                perror("event_queue_ctl");
+                close(queue_fd);
+                return -1;
+            }
+        }
+    }
+
+    timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    EventQueueEvent events[64];
+    for (int round = 0; round < s_rounds; round++) {
+        if (!make_active_pairs_readable(active))
+            return -1;
+        size_t remaining = active.size();
+        while (remaining > 0) {
+            int count = event_queue_wait(queue_fd, events, array_size(events), nullptr);
+            if (count < 0) {
+                perror("event_queue_wait");
+                return -1;
+            }
+            for (int i = 0; i < count; i++) {
+                if (!drain(static_cast<int>(events[i].user_data)))
+                    return -1;
+                remaining--;
+            }
+        }
+    }
+
+    timespec end;
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    close(queue_fd);
+    return (end.tv_sec - start.tv_sec) * 1'000'000.0 + (end.tv_nsec - start.tv_nsec) / 1'000.0;
+}
+
+int main(int argc, char** argv)
+{
+    // NOTE: A process can't have more than FD_SETSIZE open file descriptors,
+    //       and every pair uses two of them.
+    int active_count = 100;
+    int max_idle_count = 350;
+
+    Core::ArgsParser args_parser;
+    args_parser.add_option(s_rounds, "Rounds to run for every configuration", "rounds", 'n', "number");
+    args_parser.add_option(active_count, "Number of active sockets", "active", 'a', "number");
+    args_parser.add_option(max_idle_count, "Highest number of idle sockets to test", "idle", 'i', "number");
+    args_parser.parse(argc, argv);
+
+    Vector<SocketPair> active;
+    if (!create_pairs(active, active_count))
+        return 1;
+
+    printf("%-8s %-8s %18s %18s\n", "Active", "Idle", "select (us/round)", "queue (us/round)");
+    Vector<SocketPair> idle;
+    for (int idle_count = 0;; idle_count = min(idle_count + 50, max_idle_count)) {
+        if (!create_pairs(idle, idle_count - idle.size()))
+            return 1;
+
+        auto select_time = run_select(idle, active);
+        auto queue_time = run_event_queue(idle, active);
+        if (select_time < 0 || queue_time < 0)
+            return 1;
+        printf("%-8d %-8d %18.1f %18.1f\n", active_count, idle_count, select_time / s_rounds, queue_time / s_rounds);
+
+        if (idle_count == max_idle_count)
+            break;
+    }
+
+    close_pairs(idle);
+    close_pairs(active);
+    return 0;
+}
@@ -0,0 +1,96 @@
+/*
+ * Copyright (c) 2021, the SerenityOS developers.
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#include <AK/String.h>
+#include <LibCore/ArgsParser.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+// Creates, looks up and removes many files in a single directory. With a
+// hashed directory index, the time per file should stay about the same no
+// matter how many files the directory already has.
+
+static int s_files = 100000;
+
+static double elapsed_us(const timespec& start)
+{
+    timespec end;
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    return (end.tv_sec - start.tv_sec) * 1'000'000.0 + (end.tv_nsec - start.tv_nsec) / 1'000.0;
+}
+
+static String file_path(const char* directory, int i)
+{
+    return String::formatted("{}/file-{:06}", directory, i);
+}
+
+static void print_result(const char* name, double time_us)
+{
+    printf("%-10s %14.1f %14.2f\n", name, time_us / 1000.0, time_us / s_files);
+}
+
+int main(int argc, char** argv)
+{
+    // NOTE: /tmp is a TmpFS, so the default is a directory on the root file system.
+    const char* directory = "/home/anon/bench-ext2-large-directory";
+
+    Core::ArgsParser args_parser;
+    args_parser.add_option(s_files, "Number of files to create", "files", 'n', "number");
+    args_parser.add_option(directory, "Directory to create the files in", "directory", 'd', "path");
+    args_parser.parse(argc, argv);
+
+    if (mkdir(directory, 0755) < 0) {
+        perror("mkdir");
+        return 1;
+    }
+
+    timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int i = 0; i < s_files; i++) {
+        int fd = open(file_path(directory, i).characters(), O_WRONLY | O_CREAT | O_EXCL, 0644);
+        if (fd < 0) {
+            perror("open");
+            return 1;
+        }
+        close(fd);
+    }
+    auto create_time = elapsed_us(start);
+
+    // Look the files up in a different order than they were created in.
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int i = 0; i < s_files; i++) {
+        struct stat st;
+        if (stat(file_path(directory, (i * 7919) % s_files).characters(), &st) < 0) {
+            perror("stat");
+            return 1;
+        }
+    }
+    auto lookup_time = elapsed_us(start);
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int i = 0; i < s_files; i++) {
+        if (unlink(file_path(directory, i).characters()) < 0) {
+            perror("unlink");
+            return 1;
+        }
+    }
+    auto unlink_time = elapsed_us(start);
+
+    if (rmdir(directory) < 0) {
+        perror("rmdir");
+        return 1;
+    }
+
+    printf("%-10s %14s %14s\n", "", "total (ms)", "per file (us)");
+    print_result("create", create_time);
+    print_result("lookup", lookup_time);
+    print_result("unlink", unlink_time);
+    return 0;
+}
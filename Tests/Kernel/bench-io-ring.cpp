@@ -0,0 +1,124 @@
+/*
+ * Copyright (c) 2021, the SerenityOS developers.
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#include <AK/Vector.h>
+#include <LibCore/ArgsParser.h>
+#include <LibCore/IORing.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+// Compares writing many small records to a file with one write() each and
+// with batches submitted through an I/O ring.
+
+static int s_records = 100000;
+static int s_batch_size = 64;
+static int s_record_size = 64;
+
+static double elapsed_us(const timespec& start)
+{
+    timespec end;
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    return (end.tv_sec - start.tv_sec) * 1'000'000.0 + (end.tv_nsec - start.tv_nsec) / 1'000.0;
+}
+
+static int open_output(const char* path)
+{
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0)
+        perror("open");
+    return fd;
+}
+
+static double run_write(const char* path, ReadonlyBytes record)
+{
+    int fd = open_output(path);
+    if (fd < 0)
+        return -1;
+
+    timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int i = 0; i < s_records; i++) {
+        if (write(fd, record.data(), record.size()) != static_cast<ssize_t>(record.size())) {
+            perror("write");
+            close(fd);
+            return -1;
+        }
+    }
+    auto time = elapsed_us(start);
+    close(fd);
+    return time;
+}
+
+static double run_io_ring(const char* path, ReadonlyBytes record)
+{
+    int fd = open_output(path);
+    if (fd < 0)
+        return -1;
+
+    auto ring_or_error = Core::IORing::create(s_batch_size);
+    if (ring_or_error.is_error()) {
+        warnln("{}", ring_or_error.error());
+        close(fd);
+        return -1;
+    }
+    auto ring = ring_or_error.release_value();
+
+    timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    int submitted = 0;
+    int completed = 0;
+    bool failed = false;
+    while (completed < s_records && !failed) {
+        int batch = min(s_batch_size, s_records - submitted);
+        for (int i = 0; i < batch; i++)
+            ring->submit_write(fd, record, submitted + i);
+        submitted += batch;
+        if (ring->enter(batch) < 0) {
+            perror("io_ring_enter");
+            failed = true;
+            break;
+        }
+        completed += ring->for_each_completion([&](auto& completion) {
+            if (completion.result != static_cast<i32>(record.size())) {
+                warnln("write {} failed: {}", completion.user_data, completion.result);
+                failed = true;
+            }
+        });
+    }
+    auto time = elapsed_us(start);
+    close(fd);
+    return failed ? -1 : time;
+}
+
+int main(int argc, char** argv)
+{
+    const char* path = "/tmp/bench-io-ring";
+
+    Core::ArgsParser args_parser;
+    args_parser.add_option(s_records, "Number of records to write", "records", 'n', "number");
+    args_parser.add_option(s_batch_size, "Records per ring submission", "batch", 'b', "number");
+    args_parser.add_option(s_record_size, "Size of each record", "size", 's', "bytes");
+    args_parser.add_option(path, "File to write to", "output", 'o', "path");
+    args_parser.parse(argc, argv);
+
+    Vector<u8> record;
+    record.resize(s_record_size);
+    memset(record.data(), 'x', record.size());
+
+    auto write_time = run_write(path, record);
+    auto ring_time = run_io_ring(path, record);
+    unlink(path);
+    if (write_time < 0 || ring_time < 0)
+        return 1;
+
+    printf("%-10s %14s %14s\n", "", "total (ms)", "per record (us)");
+    printf("%-10s %14.1f %14.2f\n", "write()", write_time / 1000, write_time / s_records);
+    printf("%-10s %14.1f %14.2f\n", "io ring", ring_time / 1000, ring_time / s_records);
+    return 0;
+}
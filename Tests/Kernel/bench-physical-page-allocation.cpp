@@ -0,0 +1,134 @@
+/*
+ * Copyright (c) 2021, the SerenityOS developers.
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#include <AK/JsonObject.h>
+#include <AK/JsonValue.h>
+#include <AK/Vector.h>
+#include <LibCore/ArgsParser.h>
+#include <LibCore/File.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <time.h>
+#include <unistd.h>
+
+// Measures how long it takes to fault in freshly allocated physical pages
+// while 10%, 50% and 95% of user physical memory is in use.
+
+static constexpr size_t fill_chunk_size = 1 * MiB;
+
+static int s_rounds = 32;
+static int s_pages_per_round = 256;
+
+struct MemoryUsage {
+    u64 used_pages { 0 };
+    u64 total_pages { 0 };
+};
+
+static bool get_memory_usage(MemoryUsage& usage)
+{
+    auto file = Core::File::construct("/proc/memstat");
+    if (!file->open(Core::OpenMode::ReadOnly)) {
+        warnln("Failed to open /proc/memstat: {}", file->error_string());
+        return false;
+    }
+    auto json = JsonValue::from_string(file->read_all());
+    if (!json.has_value() || !json.value().is_object())
+        return false;
+    auto& object = json.value().as_object();
+    u64 allocated = object.get("user_physical_allocated").to_u64();
+    u64 available = object.get("user_physical_available").to_u64();
+    u64 committed = object.get("user_physical_committed").to_u64();
+    // Committed pages can't be handed out to anyone else, so they count as used.
+    usage.used_pages = allocated + committed;
+    usage.total_pages = allocated + available;
+    return true;
+}
+
+static double elapsed_us(const timespec& start)
+{
+    timespec end;
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    return (end.tv_sec - start.tv_sec) * 1'000'000.0 + (end.tv_nsec - start.tv_nsec) / 1'000.0;
+}
+
+static void touch_pages(u8* memory, size_t size)
+{
+    for (size_t offset = 0; offset < size; offset += PAGE_SIZE)
+        memory[offset] = 1;
+}
+
+static double fill_memory_to(double fraction, Vector<u8*>& chunks)
+{
+    MemoryUsage usage;
+    for (;;) {
+        if (!get_memory_usage(usage))
+            return -1;
+        if (usage.used_pages >= usage.total_pages * fraction)
+            break;
+        auto* chunk = (u8*)mmap(nullptr, fill_chunk_size, PROT_READ | PROT_WRITE, MAP_ANONYMOUS | MAP_PRIVATE, 0, 0);
+        if (chunk == MAP_FAILED) {
+            perror("mmap");
+            break;
+        }
+        touch_pages(chunk, fill_chunk_size);
+        chunks.append(chunk);
+    }
+    return (double)usage.used_pages / usage.total_pages;
+}
+
+struct Latency {
+    double average_us { 0 };
+    double worst_us { 0 };
+};
+
+static bool measure_allocation_latency(Latency& latency)
+{
+    size_t size = s_pages_per_round * PAGE_SIZE;
+    double total_us = 0;
+    for (int round = 0; round < s_rounds; ++round) {
+        auto* memory = (u8*)mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_ANONYMOUS | MAP_PRIVATE, 0, 0);
+        if (memory == MAP_FAILED) {
+            perror("mmap");
+            return false;
+        }
+        timespec start;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        touch_pages(memory, size);
+        auto round_us = elapsed_us(start) / s_pages_per_round;
+        munmap(memory, size);
+
+        total_us += round_us;
+        latency.worst_us = max(latency.worst_us, round_us);
+    }
+    latency.average_us = total_us / s_rounds;
+    return true;
+}
+
+int main(int argc, char** argv)
+{
+    Core::ArgsParser args_parser;
+    args_parser.add_option(s_rounds, "Number of rounds per fill level", "rounds", 'r', "number");
+    args_parser.add_option(s_pages_per_round, "Pages faulted in per round", "pages", 'p', "number");
+    args_parser.parse(argc, argv);
+
+    printf("%-8s %10s %16s %16s\n", "target", "fill", "average (us)", "worst round (us)");
+
+    Vector<u8*> chunks;
+    for (double target : { 0.10, 0.50, 0.95 }) {
+        auto fill = fill_memory_to(target, chunks);
+        if (fill < 0)
+            return 1;
+        Latency latency;
+        if (!measure_allocation_latency(latency))
+            return 1;
+        printf("%7.0f%% %9.1f%% %16.2f %16.2f\n", target * 100, fill * 100, latency.average_us, latency.worst_us);
+    }
+
+    for (auto* chunk : chunks)
+        munmap(chunk, fill_chunk_size);
+    return 0;
+}
@@ -0,0 +1,163 @@
+/*
+ * Copyright (c) 2021, the SerenityOS developers.
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#include <AK/Vector.h>
+#include <LibCore/ArgsParser.h>
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+// Measures context switch throughput by bouncing a byte between pairs of
+// threads over pipes. Every round trip forces two context switches. The
+// benchmark is repeated with the threads restricted to 1, 2, ... N processors.
+
+struct PingPongPair {
+    int ping_fds[2] { -1, -1 };
+    int pong_fds[2] { -1, -1 };
+    pthread_t pinger {};
+    pthread_t ponger {};
+};
+
+static int s_round_trips = 10000;
+static cpu_set_t s_cpuset;
+
+static bool pin_current_thread()
+{
+    if (sched_setaffinity(0, sizeof(s_cpuset), &s_cpuset) < 0) {
+        perror("sched_setaffinity");
+        return false;
+    }
+    return true;
+}
+
+static void* pinger(void* arg)
+{
+    auto& pair = *static_cast<PingPongPair*>(arg);
+    if (!pin_current_thread())
+        return nullptr;
+    char byte = 0;
+    for (int i = 0; i < s_round_trips; i++) {
+        if (write(pair.ping_fds[1], &byte, 1) != 1 || read(pair.pong_fds[0], &byte, 1) != 1) {
+            perror("pinger");
+            break;
+        }
+    }
+    return nullptr;
+}
+
+static void* ponger(void* arg)
+{
+    auto& pair = *static_cast<PingPongPair*>(arg);
+    if (!pin_current_thread())
+        return nullptr;
+    char byte = 0;
+    for (int i = 0; i < s_round_trips; i++) {
+        if (read(pair.ping_fds[0], &byte, 1) != 1 || write(pair.pong_fds[1], &byte, 1) != 1) {
+            perror("ponger");
+            break;
+        }
+    }
+    return nullptr;
+}
+
+static double run_benchmark(int cpu_count, int pairs_per_cpu)
+{
+    CPU_ZERO(&s_cpuset);
+    for (int cpu = 0; cpu < cpu_count; cpu++)
+        CPU_SET(cpu, &s_cpuset);
+
+    Vector<PingPongPair> pairs;
+    pairs.resize(cpu_count * pairs_per_cpu);
+    for (auto& pair : pairs) {
+        if (pipe(pair.ping_fds) < 0 || pipe(pair.pong_fds) < 0) {
+            perror("pipe");
+            return -1;
+        }
+    }
+
+    timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    for (auto& pair : pairs) {
+        if (int rc = pthread_create(&pair.pinger, nullptr, pinger, &pair); rc != 0) {
+            fprintf(stderr, "pthread_create: %s\n", strerror(rc));
+            return -1;
+        }
+        if (int rc = pthread_create(&pair.ponger, nullptr, ponger, &pair); rc != 0) {
+            fprintf(stderr, "pthread_create: %s\n", strerror(rc));
+            return -1;
+        }
+    }
+
+    for (auto& pair : pairs) {
+        pthread_join(pair.pinger, nullptr);
+        pthread_join(pair.ponger, nullptr);
+    }
+
+    timespec end;
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    for (auto& pair : pairs) {
+        close(pair.ping_fds[0]);
+        close(pair.ping_fds[1]);
+        close(pair.pong_fds[0]);
+        close(pair.pong_fds[1]);
+    }
+
+    double elapsed = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1'000'000'000.0;
+    double switches = 2.0 * s_round_trips * pairs.size();
+    return switches / elapsed;
+}
+
+int main(int argc, char** argv)
+{
+    int pairs_per_cpu = 2;
+    int max_cpus = 0;
+
+    Core::ArgsParser args_parser;
+    args_parser.add_option(s_round_trips, "Round trips per thread pair", "round-trips", 'n', "number");
+    args_parser.add_option(pairs_per_cpu, "Thread pairs per processor", "pairs", 'p', "number");
+    args_parser.add_option(max_cpus, "Highest processor count to test (default: all)", "cpus", 'c', "number");
+    args_parser.parse(argc, argv);
+
+    int online_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    if (max_cpus <= 0 || max_cpus > online_cpus)
+        max_cpus = online_cpus;
+    if (max_cpus > CPU_SETSIZE)
+        max_cpus = CPU_SETSIZE;
+
+    printf("%-6s %-8s %16s\n", "CPUs", "Threads", "Switches/sec");
+    for (int cpu_count = 1; cpu_count <= max_cpus; cpu_count++) {
+        // Bail out early if the kernel isn't scheduling on this many processors.
+        cpu_set_t probe;
+        CPU_ZERO(&probe);
+        CPU_SET(cpu_count - 1, &probe);
+        cpu_set_t original;
+        if (sched_getaffinity(0, sizeof(original), &original) < 0) {
+            perror("sched_getaffinity");
+            return 1;
+        }
+        if (sched_setaffinity(0, sizeof(probe), &probe) < 0) {
+            if (errno == EINVAL) {
+                printf("Processor #%d is not scheduling threads, stopping.\n", cpu_count - 1);
+                break;
+            }
+            perror("sched_setaffinity");
+            return 1;
+        }
+        sched_setaffinity(0, sizeof(original), &original);
+
+        auto switches_per_second = run_benchmark(cpu_count, pairs_per_cpu);
+        if (switches_per_second < 0)
+            return 1;
+        printf("%-6d %-8d %16.0f\n", cpu_count, cpu_count * pairs_per_cpu * 2, switches_per_second);
+    }
+    return 0;
+}
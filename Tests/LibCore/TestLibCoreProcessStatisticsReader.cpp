@@ -0,0 +1,106 @@
+/*
+ * Copyright (c) 2021, the SerenityOS developers.
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#include <AK/JsonArray.h>
+#include <AK/JsonObject.h>
+#include <AK/JsonValue.h>
+#include <Kernel/API/ProcessSnapshot.h>
+#include <LibCore/File.h>
+#include <LibCore/ProcessStatisticsReader.h>
+#include <LibTest/TestCase.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+TEST_CASE(snapshot_matches_json)
+{
+    auto all_processes = Core::ProcessStatisticsReader::get_all();
+    EXPECT(all_processes.has_value());
+
+    auto file = Core::File::construct("/proc/all");
+    EXPECT(file->open(Core::OpenMode::ReadOnly));
+    auto json = JsonValue::from_string(file->read_all());
+    EXPECT(json.has_value());
+
+    const Core::ProcessStatistics* ourselves = nullptr;
+    for (auto& process : all_processes.value()) {
+        if (process.pid == getpid())
+            ourselves = &process;
+    }
+    EXPECT(ourselves);
+
+    bool found_in_json = false;
+    json.value().as_array().for_each([&](auto& value) {
+        auto& process_object = value.as_object();
+        if (process_object.get("pid").to_i32() != getpid())
+            return;
+        found_in_json = true;
+        EXPECT_EQ(ourselves->ppid, process_object.get("ppid").to_i32());
+        EXPECT_EQ(ourselves->uid, process_object.get("uid").to_u32());
+        EXPECT_EQ(ourselves->name, process_object.get("name").to_string());
+        EXPECT_EQ(ourselves->executable, process_object.get("executable").to_string());
+        EXPECT_EQ(ourselves->tty, process_object.get("tty").to_string());
+        EXPECT_EQ(ourselves->pledge, process_object.get("pledge").to_string());
+        EXPECT_EQ(ourselves->veil, process_object.get("veil").to_string());
+        auto& thread_array = process_object.get_ptr("threads")->as_array();
+        EXPECT_EQ(ourselves->threads.size(), static_cast<size_t>(thread_array.size()));
+        EXPECT_EQ(ourselves->threads.first().tid, thread_array.at(0).as_object().get("tid").to_i32());
+        EXPECT_EQ(ourselves->threads.first().name, thread_array.at(0).as_object().get("name").to_string());
+    });
+    EXPECT(found_in_json);
+}
+
+TEST_CASE(process_snapshot_has_file_descriptions)
+{
+    int fd = open("/proc/self/snapshot", O_RDONLY);
+    EXPECT(fd >= 0);
+    auto file = Core::File::construct();
+    EXPECT(file->open(fd, Core::OpenMode::ReadOnly, Core::File::ShouldCloseFileDescriptor::Yes));
+    // The snapshot is taken when the file is opened, before the file descriptor exists. Seeking back refreshes it.
+    EXPECT(file->seek(0));
+    auto data = file->read_all();
+    EXPECT(data.size() >= sizeof(ProcessSnapshotHeader));
+
+    auto& header = *reinterpret_cast<const ProcessSnapshotHeader*>(data.data());
+    EXPECT_EQ(header.magic, process_snapshot_magic);
+    EXPECT_EQ(header.version, process_snapshot_version);
+    EXPECT_EQ(header.process_count, 1u);
+
+    size_t process_count = 0;
+    size_t region_count = 0;
+    bool found_own_fd = false;
+    for (size_t offset = header.header_size; offset + sizeof(ProcessSnapshotRecord) <= data.size();) {
+        auto& record = *reinterpret_cast<const ProcessSnapshotRecord*>(data.offset_pointer(offset));
+        EXPECT(record.size >= sizeof(ProcessSnapshotRecord));
+        EXPECT_EQ(record.size % process_snapshot_record_alignment, 0u);
+        if (record.size < sizeof(ProcessSnapshotRecord))
+            break;
+        auto* fixed = data.offset_pointer(offset + sizeof(ProcessSnapshotRecord));
+        switch (static_cast<ProcessSnapshotRecordType>(record.type)) {
+        case ProcessSnapshotRecordType::Process:
+            EXPECT_EQ(reinterpret_cast<const ProcessSnapshotProcess*>(fixed)->pid, getpid());
+            ++process_count;
+            break;
+        case ProcessSnapshotRecordType::Region:
+            ++region_count;
+            break;
+        case ProcessSnapshotRecordType::FileDescription: {
+            auto& description = *reinterpret_cast<const ProcessSnapshotFileDescription*>(fixed);
+            if (description.fd == fd) {
+                auto path = StringView(reinterpret_cast<const char*>(&description + 1), description.absolute_path_length);
+                EXPECT_EQ(path, String::formatted("/proc/{}/snapshot", getpid()));
+                found_own_fd = true;
+            }
+            break;
+        }
+        default:
+            break;
+        }
+        offset += record.size;
+    }
+    EXPECT_EQ(process_count, 1u);
+    EXPECT(region_count > 0);
+    EXPECT(found_own_fd);
+}
@@ -247,7 +247,7 @@ int main(int argc, char** argv)
         return 1;
     }
 
-    if (unveil("/proc/all", "r") < 0) {
+    if (unveil("/proc/snapshot", "r") < 0) {
         perror("unveil");
         return 1;
     }
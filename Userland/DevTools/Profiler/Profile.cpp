@@ -15,7 +15,9 @@
 #include <AK/QuickSort.h>
 #include <AK/RefPtr.h>
 #include <LibCore/File.h>
+#include <Kernel/API/PerformanceEvents.h>
 #include <LibELF/Image.h>
+#include <serenity.h>
 #include <sys/stat.h>
 
 namespace Profiler {
@@ -189,68 +191,194 @@ void Profile::rebuild_tree()
     m_model->update();
 }
 
+static StringView event_type_name(u16 type)
+{
+    switch (type) {
+    case PERF_EVENT_SAMPLE:
+        return "sample";
+    case PERF_EVENT_MALLOC:
+        return "malloc";
+    case PERF_EVENT_FREE:
+        return "free";
+    case PERF_EVENT_MMAP:
+        return "mmap";
+    case PERF_EVENT_MUNMAP:
+        return "munmap";
+    case PERF_EVENT_PROCESS_CREATE:
+        return "process_create";
+    case PERF_EVENT_PROCESS_EXEC:
+        return "process_exec";
+    case PERF_EVENT_PROCESS_EXIT:
+        return "process_exit";
+    case PERF_EVENT_THREAD_CREATE:
+        return "thread_create";
+    case PERF_EVENT_THREAD_EXIT:
+        return "thread_exit";
+    case PERF_EVENT_CONTEXT_SWITCH:
+        return "context_switch";
+    case PERF_EVENT_KMALLOC:
+        return "kmalloc";
+    case PERF_EVENT_KFREE:
+        return "kfree";
+    case PERF_EVENT_PAGE_FAULT:
+        return "page_fault";
+    case PERF_EVENT_TRACEPOINT:
+        return "tracepoint";
+    }
+    return {};
+}
+
+static size_t event_payload_size(u16 type)
+{
+    switch (type) {
+    case PERF_EVENT_MALLOC:
+        return sizeof(MallocPerformanceEvent);
+    case PERF_EVENT_FREE:
+        return sizeof(FreePerformanceEvent);
+    case PERF_EVENT_MMAP:
+        return sizeof(MmapPerformanceEvent);
+    case PERF_EVENT_MUNMAP:
+        return sizeof(MunmapPerformanceEvent);
+    case PERF_EVENT_PROCESS_CREATE:
+        return sizeof(ProcessCreatePerformanceEvent);
+    case PERF_EVENT_THREAD_CREATE:
+        return sizeof(ThreadCreatePerformanceEvent);
+    case PERF_EVENT_CONTEXT_SWITCH:
+        return sizeof(ContextSwitchPerformanceEvent);
+    case PERF_EVENT_KMALLOC:
+        return sizeof(KMallocPerformanceEvent);
+    case PERF_EVENT_KFREE:
+        return sizeof(KFreePerformanceEvent);
+    case PERF_EVENT_TRACEPOINT:
+        return sizeof(TracepointPerformanceEvent);
+    }
+    return 0;
+}
+
+// Within the same millisecond, processes and threads have to show up before
+// their other events, and may only go away after them.
+static int event_order_rank(u16 type)
+{
+    switch (type) {
+    case PERF_EVENT_PROCESS_CREATE:
+    case PERF_EVENT_PROCESS_EXEC:
+    case PERF_EVENT_THREAD_CREATE:
+    case PERF_EVENT_MMAP:
+        return 0;
+    case PERF_EVENT_PROCESS_EXIT:
+    case PERF_EVENT_THREAD_EXIT:
+        return 2;
+    }
+    return 1;
+}
+
 Result<NonnullOwnPtr<Profile>, String> Profile::load_from_perfcore_file(const StringView& path)
 {
     auto file = Core::File::construct(path);
     if (!file->open(Core::OpenMode::ReadOnly))
         return String::formatted("Unable to open {}, error: {}", path, file->error_string());
 
-    auto json = JsonValue::from_string(file->read_all());
-    if (!json.has_value() || !json.value().is_object())
-        return String { "Invalid perfcore format (not a JSON object)" };
+    auto data = file->read_all();
+    if (data.size() < sizeof(PerformanceEventStreamHeader))
+        return String { "Invalid perfcore format (too short)" };
 
-    auto& object = json.value().as_object();
+    auto& header = *reinterpret_cast<const PerformanceEventStreamHeader*>(data.data());
+    if (header.magic != performance_event_stream_magic)
+        return String { "Invalid perfcore format (bad magic)" };
+    if (header.version != performance_event_stream_version)
+        return String::formatted("Unsupported perfcore version {}", header.version);
+    if (header.lost_events > 0)
+        dbgln("Profile is missing {} events that the kernel had no room for", header.lost_events);
 
     auto file_or_error = MappedFile::map("/boot/Kernel");
     OwnPtr<ELF::Image> kernel_elf;
     if (!file_or_error.is_error())
         kernel_elf = make<ELF::Image>(file_or_error.value()->bytes());
 
-    auto events_value = object.get_ptr("events");
-    if (!events_value || !events_value->is_array())
-        return String { "Malformed profile (events is not an array)" };
+    Vector<const PerformanceEventRecord*> records;
+    for (size_t offset = header.header_size; offset < data.size();) {
+        if (data.size() - offset < performance_event_record_alignment)
+            return String { "Malformed profile (truncated event)" };
+        auto& record = *reinterpret_cast<const PerformanceEventRecord*>(data.data() + offset);
+        // Profiles streamed from the per-processor rings contain the padding records from
+        // the end of each ring. Only their type and size are valid, and they can be
+        // smaller than a whole PerformanceEventRecord.
+        if (record.type == performance_event_padding) {
+            if (record.size == 0 || record.size % performance_event_record_alignment != 0 || record.size > data.size() - offset)
+                return String { "Malformed profile (bad padding size)" };
+            offset += record.size;
+            continue;
+        }
+        if (data.size() - offset < sizeof(PerformanceEventRecord))
+            return String { "Malformed profile (truncated event)" };
+        if (record.size < sizeof(PerformanceEventRecord) || record.size > data.size() - offset)
+            return String { "Malformed profile (bad event size)" };
+        size_t used_size = sizeof(PerformanceEventRecord) + event_payload_size(record.type) + record.stack_size * sizeof(FlatPtr) + record.string_length;
+        if (used_size > record.size)
+            return String { "Malformed profile (event is larger than its size)" };
+        records.append(&record);
+        offset += record.size;
+    }
 
-    auto& perf_events = events_value->as_array();
+    // Each processor records its events separately when profiling everything,
+    // so they have to be put in order. Within a processor, the order they were
+    // recorded in is kept.
+    quick_sort(records, [](auto* a, auto* b) {
+        if (a->timestamp != b->timestamp)
+            return a->timestamp < b->timestamp;
+        if (event_order_rank(a->type) != event_order_rank(b->type))
+            return event_order_rank(a->type) < event_order_rank(b->type);
+        return a < b;
+    });
 
     NonnullOwnPtrVector<Process> all_processes;
     HashMap<pid_t, Process*> current_processes;
     Vector<Event> events;
     EventSerialNumber next_serial;
+    bool seen_first_sample = false;
 
-    for (auto& perf_event_value : perf_events.values()) {
-        auto& perf_event = perf_event_value.as_object();
+    for (auto* record : records) {
+        auto* payload = reinterpret_cast<const u8*>(record + 1);
+        auto* stack = reinterpret_cast<const FlatPtr*>(payload + event_payload_size(record->type));
+        auto string = StringView(reinterpret_cast<const char*>(stack + record->stack_size), record->string_length);
 
         Event event;
 
         event.serial = next_serial;
         next_serial.increment();
-        event.timestamp = perf_event.get("timestamp").to_number<u64>();
-        event.lost_samples = perf_event.get("lost_samples").to_number<u32>();
-        event.type = perf_event.get("type").to_string();
-        event.pid = perf_event.get("pid").to_i32();
-        event.tid = perf_event.get("tid").to_i32();
+        event.timestamp = record->timestamp;
+        event.lost_samples = seen_first_sample ? record->lost_samples : 0;
+        event.type = event_type_name(record->type);
+        event.pid = record->pid;
+        event.tid = record->tid;
+
+        if (record->type == PERF_EVENT_SAMPLE)
+            seen_first_sample = true;
 
         if (event.type == "malloc"sv) {
-            event.ptr = perf_event.get("ptr").to_number<FlatPtr>();
-            event.size = perf_event.get("size").to_number<size_t>();
+            auto& malloc = *reinterpret_cast<const MallocPerformanceEvent*>(payload);
+            event.ptr = malloc.ptr;
+            event.size = malloc.size;
         } else if (event.type == "free"sv) {
-            event.ptr = perf_event.get("ptr").to_number<FlatPtr>();
+            event.ptr = reinterpret_cast<const FreePerformanceEvent*>(payload)->ptr;
         } else if (event.type == "mmap"sv) {
-            event.ptr = perf_event.get("ptr").to_number<FlatPtr>();
-            event.size = perf_event.get("size").to_number<size_t>();
-            event.name = perf_event.get("name").to_string();
+            auto& mmap = *reinterpret_cast<const MmapPerformanceEvent*>(payload);
+            event.ptr = mmap.ptr;
+            event.size = mmap.size;
+            event.name = string;
 
             auto it = current_processes.find(event.pid);
             if (it != current_processes.end())
                 it->value->library_metadata.handle_mmap(event.ptr, event.size, event.name);
             continue;
         } else if (event.type == "munmap"sv) {
-            event.ptr = perf_event.get("ptr").to_number<FlatPtr>();
-            event.size = perf_event.get("size").to_number<size_t>();
+            auto& munmap = *reinterpret_cast<const MunmapPerformanceEvent*>(payload);
+            event.ptr = munmap.ptr;
+            event.size = munmap.size;
             continue;
         } else if (event.type == "process_create"sv) {
-            event.parent_pid = perf_event.get("parent_pid").to_number<FlatPtr>();
-            event.executable = perf_event.get("executable").to_string();
+            event.parent_pid = reinterpret_cast<const ProcessCreatePerformanceEvent*>(payload)->parent_pid;
+            event.executable = string;
 
             auto sampled_process = adopt_own(*new Process {
                 .pid = event.pid,
@@ -264,12 +392,12 @@ Result<NonnullOwnPtr<Profile>, String> Profile::load_from_perfcore_file(const St
             all_processes.append(move(sampled_process));
             continue;
         } else if (event.type == "process_exec"sv) {
-            event.executable = perf_event.get("executable").to_string();
-
-            auto old_process = current_processes.get(event.pid).value();
-            old_process->end_valid = event.serial;
+            event.executable = string;
 
-            current_processes.remove(event.pid);
+            if (auto old_process = current_processes.get(event.pid); old_process.has_value()) {
+                old_process.value()->end_valid = event.serial;
+                current_processes.remove(event.pid);
+            }
 
             auto sampled_process = adopt_own(*new Process {
                 .pid = event.pid,
@@ -283,13 +411,13 @@ Result<NonnullOwnPtr<Profile>, String> Profile::load_from_perfcore_file(const St
             all_processes.append(move(sampled_process));
             continue;
         } else if (event.type == "process_exit"sv) {
-            auto old_process = current_processes.get(event.pid).value();
-            old_process->end_valid = event.serial;
-
-            current_processes.remove(event.pid);
+            if (auto old_process = current_processes.get(event.pid); old_process.has_value()) {
+                old_process.value()->end_valid = event.serial;
+                current_processes.remove(event.pid);
+            }
             continue;
         } else if (event.type == "thread_create"sv) {
-            event.parent_tid = perf_event.get("parent_tid").to_i32();
+            event.parent_tid = reinterpret_cast<const ThreadCreatePerformanceEvent*>(payload)->parent_tid;
             auto it = current_processes.find(event.pid);
             if (it != current_processes.end())
                 it->value->handle_thread_create(event.tid, event.serial);
@@ -299,14 +427,19 @@ Result<NonnullOwnPtr<Profile>, String> Profile::load_from_perfcore_file(const St
             if (it != current_processes.end())
                 it->value->handle_thread_exit(event.tid, event.serial);
             continue;
+        } else if (event.type == "tracepoint"sv) {
+            auto& tracepoint = *reinterpret_cast<const TracepointPerformanceEvent*>(payload);
+            event.name = to_string(static_cast<Tracepoint>(tracepoint.tracepoint));
+            event.ptr = tracepoint.arg1;
+            event.size = tracepoint.arg2;
         }
 
-        auto* stack = perf_event.get_ptr("stack");
-        VERIFY(stack);
-        auto& stack_array = stack->as_array();
-        for (ssize_t i = stack_array.values().size() - 1; i >= 0; --i) {
-            auto& frame = stack_array.at(i);
-            auto ptr = frame.to_number<u32>();
+        // A stream can start in the middle of a process' life, we can't attribute its events to anything.
+        if (!current_processes.contains(event.pid))
+            continue;
+
+        for (ssize_t i = record->stack_size - 1; i >= 0; --i) {
+            auto ptr = stack[i];
             u32 offset = 0;
             FlyString object_name;
             String symbol;
@@ -208,6 +208,9 @@ u32 Emulator::virt_syscall(u32 function, u32 arg1, u32 arg2, u32 arg3)
         return virt$clock_gettime(arg1, arg2);
     case SC_clock_settime:
         return virt$clock_settime(arg1, arg2);
+    case SC_map_time_page:
+        // The emulated process can't see the kernel's time page, so make LibC fall back to syscalls.
+        return -ENOSYS;
     case SC_getrandom:
         return virt$getrandom(arg1, arg2, arg3);
     case SC_fork:
@@ -86,4 +86,33 @@ int openat(int dirfd, const char* path, int options, ...)
     int rc = syscall(SC_open, &params);
     __RETURN_WITH_ERRNO(rc, rc, -1);
 }
+
+ssize_t splice(int fd_in, off_t* off_in, int fd_out, off_t* off_out, size_t length, unsigned flags)
+{
+    Syscall::SC_splice_params params { fd_in, off_in, fd_out, off_out, length, flags };
+    int rc = syscall(SC_splice, &params);
+    __RETURN_WITH_ERRNO(rc, rc, -1);
+}
+
+ssize_t vmsplice(int fd, const struct iovec* iov, size_t iov_count, unsigned flags)
+{
+    Syscall::SC_vmsplice_params params { fd, iov, iov_count, flags };
+    int rc = syscall(SC_vmsplice, &params);
+    __RETURN_WITH_ERRNO(rc, rc, -1);
+}
+
+int fallocate(int fd, int mode, off_t offset, off_t len)
+{
+    Syscall::SC_fallocate_params params { fd, mode, offset, len };
+    int rc = syscall(SC_fallocate, &params);
+    __RETURN_WITH_ERRNO(rc, rc, -1);
+}
+
+int posix_fallocate(int fd, off_t offset, off_t len)
+{
+    // Unlike most functions, this one returns the error instead of setting errno.
+    Syscall::SC_fallocate_params params { fd, 0, offset, len };
+    int rc = syscall(SC_fallocate, &params);
+    return rc < 0 ? -rc : 0;
+}
 }
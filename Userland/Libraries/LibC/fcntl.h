@@ -9,6 +9,7 @@
 
 #include <sys/cdefs.h>
 #include <sys/types.h>
+#include <sys/uio.h>
 
 __BEGIN_DECLS
 
@@ -18,6 +19,8 @@ __BEGIN_DECLS
 #define F_GETFL 3
 #define F_SETFL 4
 #define F_ISTTY 5
+#define F_SETPIPE_SZ 8
+#define F_GETPIPE_SZ 9
 
 #define FD_CLOEXEC 1
 
@@ -63,4 +66,17 @@ struct flock {
     pid_t l_pid;
 };
 
+#define SPLICE_F_MOVE 0x1
+#define SPLICE_F_NONBLOCK 0x2
+#define SPLICE_F_MORE 0x4
+#define SPLICE_F_GIFT 0x8
+
+ssize_t splice(int fd_in, off_t* off_in, int fd_out, off_t* off_out, size_t length, unsigned flags);
+ssize_t vmsplice(int fd, const struct iovec* iov, size_t iov_count, unsigned flags);
+
+// Allocates disk space for [offset, offset + len), growing the file if it ends before that.
+// Only mode 0 is supported by fallocate().
+int fallocate(int fd, int mode, off_t offset, off_t len);
+int posix_fallocate(int fd, off_t offset, off_t len);
+
 __END_DECLS
@@ -5,8 +5,11 @@
  */
 
 #include <AK/Types.h>
+#include <LibELF/AuxiliaryVector.h>
 #include <assert.h>
+#include <stdlib.h>
 #include <sys/internals.h>
+#include <syscall.h>
 #include <unistd.h>
 
 extern "C" {
@@ -22,6 +25,11 @@ bool __stdio_is_initialized;
 
 void __libc_init()
 {
+    // The kernel only advertises SEP if it has set up SYSENTER for us.
+    static constexpr long sep_bit = 1 << 11;
+    if (getauxval(AT_HWCAP) & sep_bit)
+        syscall_use_sysenter();
+
     __malloc_init();
     __stdio_init();
 }
@@ -7,3 +7,6 @@
 #pragma once
 
 #define TCP_NODELAY 10
+#define TCP_CONGESTION 11
+
+#define TCP_CA_NAME_MAX 16
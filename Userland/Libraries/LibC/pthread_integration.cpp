@@ -10,6 +10,7 @@
 #include <bits/pthread_integration.h>
 #include <errno.h>
 #include <sched.h>
+#include <serenity.h>
 #include <unistd.h>
 
 namespace {
@@ -91,27 +92,51 @@ int __pthread_self()
 
 int pthread_self() __attribute__((weak, alias("__pthread_self")));
 
+// The lock word is 0 when the mutex is unlocked, 1 when it's locked, and 2 when
+// it's locked and there may be threads sleeping on it in the kernel.
+static constexpr u32 mutex_unlocked = 0;
+static constexpr u32 mutex_locked = 1;
+static constexpr u32 mutex_locked_need_wake = 2;
+
+static void mutex_lock_contended(pthread_mutex_t* mutex)
+{
+    // Marking the mutex as contended makes whoever holds it wake us up once they unlock it.
+    while (AK::atomic_exchange(&mutex->lock, mutex_locked_need_wake, AK::memory_order_acquire) != mutex_unlocked)
+        futex(&mutex->lock, FUTEX_WAIT, mutex_locked_need_wake, nullptr, nullptr, 0);
+}
+
 int __pthread_mutex_lock(pthread_mutex_t* mutex)
 {
     pthread_t this_thread = __pthread_self();
-    for (;;) {
-        u32 expected = 0;
-        if (!AK::atomic_compare_exchange_strong(&mutex->lock, expected, 1u, AK::memory_order_acquire)) {
-            if (mutex->type == __PTHREAD_MUTEX_RECURSIVE && mutex->owner == this_thread) {
-                mutex->level++;
-                return 0;
-            }
-            sched_yield();
-            continue;
+    u32 expected = mutex_unlocked;
+    if (!AK::atomic_compare_exchange_strong(&mutex->lock, expected, mutex_locked, AK::memory_order_acquire)) {
+        if (mutex->type == __PTHREAD_MUTEX_RECURSIVE && mutex->owner == this_thread) {
+            mutex->level++;
+            return 0;
         }
-        mutex->owner = this_thread;
-        mutex->level = 0;
-        return 0;
+        mutex_lock_contended(mutex);
     }
+    mutex->owner = this_thread;
+    mutex->level = 0;
+    return 0;
 }
 
 int pthread_mutex_lock(pthread_mutex_t*) __attribute__((weak, alias("__pthread_mutex_lock")));
 
+int __pthread_mutex_lock_pessimistic_np(pthread_mutex_t* mutex)
+{
+    // Threads that may have been requeued onto the mutex by pthread_cond_broadcast()
+    // have to leave it marked as contended, or the others would never be woken.
+    if (mutex->type == __PTHREAD_MUTEX_RECURSIVE && mutex->owner == __pthread_self()) {
+        mutex->level++;
+        return 0;
+    }
+    mutex_lock_contended(mutex);
+    mutex->owner = __pthread_self();
+    mutex->level = 0;
+    return 0;
+}
+
 int __pthread_mutex_unlock(pthread_mutex_t* mutex)
 {
     if (mutex->type == __PTHREAD_MUTEX_RECURSIVE && mutex->level > 0) {
@@ -119,7 +144,8 @@ int __pthread_mutex_unlock(pthread_mutex_t* mutex)
         return 0;
     }
     mutex->owner = 0;
-    AK::atomic_store(&mutex->lock, 0u, AK::memory_order_release);
+    if (AK::atomic_exchange(&mutex->lock, mutex_unlocked, AK::memory_order_release) == mutex_locked_need_wake)
+        futex(&mutex->lock, FUTEX_WAKE, 1, nullptr, nullptr, 0);
     return 0;
 }
 
@@ -127,8 +153,8 @@ int pthread_mutex_unlock(pthread_mutex_t*) __attribute__((weak, alias("__pthread
 
 int __pthread_mutex_trylock(pthread_mutex_t* mutex)
 {
-    u32 expected = 0;
-    if (!AK::atomic_compare_exchange_strong(&mutex->lock, expected, 1u, AK::memory_order_acquire)) {
+    u32 expected = mutex_unlocked;
+    if (!AK::atomic_compare_exchange_strong(&mutex->lock, expected, mutex_locked, AK::memory_order_acquire)) {
         if (mutex->type == __PTHREAD_MUTEX_RECURSIVE && mutex->owner == pthread_self()) {
             mutex->level++;
             return 0;
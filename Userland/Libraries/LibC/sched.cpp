@@ -37,4 +37,16 @@ int sched_getparam(pid_t pid, struct sched_param* param)
     int rc = syscall(SC_sched_getparam, pid, param);
     __RETURN_WITH_ERRNO(rc, rc, -1);
 }
+
+int sched_setaffinity(pid_t tid, size_t cpuset_size, const cpu_set_t* mask)
+{
+    int rc = syscall(SC_sched_setaffinity, tid, cpuset_size, mask);
+    __RETURN_WITH_ERRNO(rc, rc, -1);
+}
+
+int sched_getaffinity(pid_t tid, size_t cpuset_size, cpu_set_t* mask)
+{
+    int rc = syscall(SC_sched_getaffinity, tid, cpuset_size, mask);
+    __RETURN_WITH_ERRNO(rc, rc, -1);
+}
 }
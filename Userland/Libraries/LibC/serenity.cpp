@@ -48,12 +48,18 @@ int profiling_free_buffer(pid_t pid)
     __RETURN_WITH_ERRNO(rc, rc, -1);
 }
 
+int profiling_open_ring(unsigned processor)
+{
+    int rc = syscall(SC_profiling_open_ring, processor);
+    __RETURN_WITH_ERRNO(rc, rc, -1);
+}
+
 int futex(uint32_t* userspace_address, int futex_op, uint32_t value, const struct timespec* timeout, uint32_t* userspace_address2, uint32_t value3)
 {
     int rc;
     switch (futex_op & FUTEX_CMD_MASK) {
-    //case FUTEX_CMP_REQUEUE:
-    // FUTEX_CMP_REQUEUE_PI:
+    case FUTEX_REQUEUE:
+    case FUTEX_CMP_REQUEUE:
     case FUTEX_WAKE_OP: {
         // These interpret timeout as a u32 value for val2
         Syscall::SC_futex_params params {
@@ -137,6 +143,39 @@ int getkeymap(char* name_buffer, size_t name_buffer_size, u32* map, u32* shift_m
     __RETURN_WITH_ERRNO(rc, rc, -1);
 }
 
+int create_event_queue(unsigned flags)
+{
+    int rc = syscall(SC_create_event_queue, flags);
+    __RETURN_WITH_ERRNO(rc, rc, -1);
+}
+
+int event_queue_ctl(int queue_fd, unsigned operation, int fd, unsigned events, uint64_t user_data)
+{
+    Syscall::SC_event_queue_ctl_params params { queue_fd, operation, fd, events, user_data };
+    int rc = syscall(SC_event_queue_ctl, &params);
+    __RETURN_WITH_ERRNO(rc, rc, -1);
+}
+
+int event_queue_wait(int queue_fd, struct EventQueueEvent* events, size_t max_events, const struct timespec* timeout)
+{
+    Syscall::SC_event_queue_wait_params params { queue_fd, events, max_events, timeout };
+    int rc = syscall(SC_event_queue_wait, &params);
+    __RETURN_WITH_ERRNO(rc, rc, -1);
+}
+
+int create_io_ring(unsigned submission_entries, unsigned completion_entries, unsigned flags)
+{
+    Syscall::SC_create_io_ring_params params { submission_entries, completion_entries, flags };
+    int rc = syscall(SC_create_io_ring, &params);
+    __RETURN_WITH_ERRNO(rc, rc, -1);
+}
+
+int io_ring_enter(int ring_fd, unsigned to_submit, unsigned min_complete)
+{
+    int rc = syscall(SC_io_ring_enter, ring_fd, to_submit, min_complete);
+    __RETURN_WITH_ERRNO(rc, rc, -1);
+}
+
 u16 internet_checksum(const void* ptr, size_t count)
 {
     u32 checksum = 0;
@@ -20,6 +20,7 @@ int module_unload(const char* name, size_t name_length);
 int profiling_enable(pid_t, uint64_t);
 int profiling_disable(pid_t);
 int profiling_free_buffer(pid_t);
+int profiling_open_ring(unsigned processor);
 
 #define THREAD_PRIORITY_MIN 1
 #define THREAD_PRIORITY_LOW 10
@@ -90,6 +91,7 @@ enum {
     PERF_EVENT_KMALLOC = 2048,
     PERF_EVENT_KFREE = 4096,
     PERF_EVENT_PAGE_FAULT = 8192,
+    PERF_EVENT_TRACEPOINT = 16384,
 };
 
 #define PERF_EVENT_MASK_ALL (~0ull)
@@ -107,4 +109,14 @@ int setkeymap(const char* name, const uint32_t* map, uint32_t* const shift_map,
 
 uint16_t internet_checksum(const void* ptr, size_t count);
 
+struct EventQueueEvent;
+struct timespec;
+
+int create_event_queue(unsigned flags);
+int event_queue_ctl(int queue_fd, unsigned operation, int fd, unsigned events, uint64_t user_data);
+int event_queue_wait(int queue_fd, struct EventQueueEvent* events, size_t max_events, const struct timespec* timeout);
+
+int create_io_ring(unsigned submission_entries, unsigned completion_entries, unsigned flags);
+int io_ring_enter(int ring_fd, unsigned to_submit, unsigned min_complete);
+
 __END_DECLS
@@ -0,0 +1,16 @@
+/*
+ * Copyright (c) 2021, the SerenityOS developers.
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#pragma once
+
+#include <sys/cdefs.h>
+#include <sys/types.h>
+
+__BEGIN_DECLS
+
+ssize_t sendfile(int out_fd, int in_fd, off_t* offset, size_t count);
+
+__END_DECLS
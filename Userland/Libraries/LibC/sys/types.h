@@ -78,6 +78,7 @@ typedef struct __pthread_cond_t {
     uint32_t value;
     uint32_t previous;
     int clockid; // clockid_t
+    pthread_mutex_t* mutex;
 } pthread_cond_t;
 
 typedef uint64_t pthread_rwlock_t;
@@ -4,9 +4,11 @@
  * SPDX-License-Identifier: BSD-2-Clause
  */
 
+#include <AK/Atomic.h>
 #include <AK/String.h>
 #include <AK/StringBuilder.h>
 #include <AK/Time.h>
+#include <Kernel/API/TimePage.h>
 #include <assert.h>
 #include <errno.h>
 #include <stdio.h>
@@ -17,6 +19,36 @@
 #include <time.h>
 #include <utime.h>
 
+static const TimePage* get_time_page()
+{
+    // 0 means we haven't asked the kernel yet, 1 that it can't give us the page.
+    static Atomic<FlatPtr> s_time_page;
+    auto time_page = s_time_page.load(AK::MemoryOrder::memory_order_acquire);
+    if (!time_page) {
+        ptrdiff_t rc = syscall(SC_map_time_page);
+        // If another thread beats us to it, we've only wasted a mapping.
+        time_page = (rc < 0 && -rc < EMAXERRNO) ? 1 : rc;
+        s_time_page.store(time_page, AK::MemoryOrder::memory_order_release);
+    }
+    if (time_page == 1)
+        return nullptr;
+    return reinterpret_cast<const TimePage*>(time_page);
+}
+
+static bool read_time_page(clockid_t clock_id, timespec& ts)
+{
+    auto* page = get_time_page();
+    if (!page || !time_page_supports(*page, clock_id))
+        return false;
+    for (;;) {
+        auto update_iteration = AK::atomic_load(&page->update2, AK::MemoryOrder::memory_order_acquire);
+        ts = page->clocks[clock_id];
+        AK::atomic_thread_fence(AK::MemoryOrder::memory_order_acquire);
+        if (AK::atomic_load(&page->update1, AK::MemoryOrder::memory_order_relaxed) == update_iteration)
+            return true;
+    }
+}
+
 extern "C" {
 
 time_t time(time_t* tloc)
@@ -38,6 +70,11 @@ int adjtime(const struct timeval* delta, struct timeval* old_delta)
 
 int gettimeofday(struct timeval* __restrict__ tv, void* __restrict__)
 {
+    timespec ts;
+    if (read_time_page(CLOCK_REALTIME, ts)) {
+        TIMESPEC_TO_TIMEVAL(tv, &ts);
+        return 0;
+    }
     int rc = syscall(SC_gettimeofday, tv);
     __RETURN_WITH_ERRNO(rc, rc, -1);
 }
@@ -355,6 +392,8 @@ clock_t clock()
 
 int clock_gettime(clockid_t clock_id, struct timespec* ts)
 {
+    if (read_time_page(clock_id, *ts))
+        return 0;
     int rc = syscall(SC_clock_gettime, clock_id, ts);
     __RETURN_WITH_ERRNO(rc, rc, -1);
 }
@@ -35,6 +35,11 @@
 #include <time.h>
 #include <unistd.h>
 
+#ifdef __serenity__
+#    include <Kernel/API/EventQueue.h>
+#    include <serenity.h>
+#endif
+
 namespace Core {
 
 class InspectorServerConnection;
@@ -63,6 +68,48 @@ static NeverDestroyed<IDAllocator> s_id_allocator;
 static HashMap<int, NonnullOwnPtr<EventLoopTimer>>* s_timers;
 static HashTable<Notifier*>* s_notifiers;
 int EventLoop::s_wake_pipe_fds[2];
+#ifdef __serenity__
+// All notifiers are registered with a kernel event queue, keyed by fd, so
+// that waiting for events doesn't have to look at every idle notifier.
+// Notifiers sharing an fd get a single interest with their combined mask.
+static int s_event_queue_fd { -1 };
+static HashMap<int, Vector<Notifier*, 1>>* s_notifiers_by_fd;
+
+static unsigned event_queue_events_for(const Vector<Notifier*, 1>& notifiers)
+{
+    auto events = EventQueueEvents::None;
+    for (auto* notifier : notifiers) {
+        if (notifier->event_mask() & Notifier::Read)
+            events |= EventQueueEvents::Read;
+        if (notifier->event_mask() & Notifier::Write)
+            events |= EventQueueEvents::Write;
+        if (notifier->event_mask() & Notifier::Exceptional)
+            VERIFY_NOT_REACHED();
+    }
+    return static_cast<unsigned>(events);
+}
+
+static void update_event_queue_interest(EventQueueOperation operation, int fd, unsigned events)
+{
+    if (s_event_queue_fd < 0)
+        return;
+    if (event_queue_ctl(s_event_queue_fd, static_cast<unsigned>(operation), fd, events, fd) < 0)
+        dbgln("Core::EventLoop: Failed to update event queue interest for fd {}: {}", fd, strerror(errno));
+}
+
+static void create_event_queue(int wake_fd)
+{
+    s_event_queue_fd = ::create_event_queue(static_cast<unsigned>(EventQueueFlags::CloseOnExec));
+    if (s_event_queue_fd < 0) {
+        perror("create_event_queue");
+        VERIFY_NOT_REACHED();
+    }
+    update_event_queue_interest(EventQueueOperation::Add, wake_fd, static_cast<unsigned>(EventQueueEvents::Read));
+    // Notifiers may have been registered while there was no main loop, e.g. right after a fork.
+    for (auto& it : *s_notifiers_by_fd)
+        update_event_queue_interest(EventQueueOperation::Add, it.key, event_queue_events_for(it.value));
+}
+#endif
 static RefPtr<InspectorServerConnection> s_inspector_server_connection;
 
 class SignalHandlers : public RefCounted<SignalHandlers> {
@@ -260,6 +307,9 @@ EventLoop::EventLoop([[maybe_unused]] MakeInspectable make_inspectable)
         s_event_loop_stack = new Vector<EventLoop&>;
         s_timers = new HashMap<int, NonnullOwnPtr<EventLoopTimer>>;
         s_notifiers = new HashTable<Notifier*>;
+#ifdef __serenity__
+        s_notifiers_by_fd = new HashMap<int, Vector<Notifier*, 1>>;
+#endif
     }
 
     if (!s_main_event_loop) {
@@ -274,6 +324,9 @@ EventLoop::EventLoop([[maybe_unused]] MakeInspectable make_inspectable)
 
 #endif
         VERIFY(rc == 0);
+#ifdef __serenity__
+        create_event_queue(s_wake_pipe_fds[0]);
+#endif
         s_event_loop_stack->append(*this);
 
 #ifdef __serenity__
@@ -555,6 +608,12 @@ void EventLoop::notify_forked(ForkEvent event)
         s_event_loop_stack->clear();
         s_timers->clear();
         s_notifiers->clear();
+#ifdef __serenity__
+        // The queue is shared with the parent, keeping it would steal its events.
+        s_notifiers_by_fd->clear();
+        close(s_event_queue_fd);
+        s_event_queue_fd = -1;
+#endif
         if (auto* info = signals_info<false>()) {
             info->signal_handlers.clear();
             info->next_signal_id = 0;
@@ -571,9 +630,14 @@ void EventLoop::notify_forked(ForkEvent event)
 
 void EventLoop::wait_for_event(WaitMode mode)
 {
+#ifdef __serenity__
+    EventQueueEvent events[64];
+#else
     fd_set rfds;
     fd_set wfds;
+#endif
 retry:
+#ifndef __serenity__
     FD_ZERO(&rfds);
     FD_ZERO(&wfds);
 
@@ -595,6 +659,7 @@ retry:
         if (notifier->event_mask() & Notifier::Exceptional)
             VERIFY_NOT_REACHED();
     }
+#endif
 
     bool queued_events_is_empty;
     {
@@ -622,8 +687,14 @@ retry:
         }
     }
 
+#ifdef __serenity__
+    timespec timeout_spec { timeout.tv_sec, timeout.tv_usec * 1000 };
+try_select_again:
+    int marked_fd_count = event_queue_wait(s_event_queue_fd, events, array_size(events), should_wait_forever ? nullptr : &timeout_spec);
+#else
 try_select_again:
     int marked_fd_count = select(max_fd + 1, &rfds, &wfds, nullptr, should_wait_forever ? nullptr : &timeout);
+#endif
     if (marked_fd_count < 0) {
         int saved_errno = errno;
         if (saved_errno == EINTR) {
@@ -634,7 +705,17 @@ try_select_again:
         dbgln_if(EVENTLOOP_DEBUG, "Core::EventLoop::wait_for_event: {} ({}: {})", marked_fd_count, saved_errno, strerror(saved_errno));
         VERIFY_NOT_REACHED();
     }
-    if (FD_ISSET(s_wake_pipe_fds[0], &rfds)) {
+
+#ifdef __serenity__
+    bool wake_pipe_is_readable = false;
+    for (int i = 0; i < marked_fd_count; i++) {
+        if (events[i].user_data == static_cast<u64>(s_wake_pipe_fds[0]))
+            wake_pipe_is_readable = true;
+    }
+#else
+    bool wake_pipe_is_readable = FD_ISSET(s_wake_pipe_fds[0], &rfds);
+#endif
+    if (wake_pipe_is_readable) {
         int wake_events[8];
         auto nread = read(s_wake_pipe_fds[0], wake_events, sizeof(wake_events));
         if (nread < 0) {
@@ -687,6 +768,20 @@ try_select_again:
     if (!marked_fd_count)
         return;
 
+#ifdef __serenity__
+    for (int i = 0; i < marked_fd_count; i++) {
+        auto& event = events[i];
+        auto it = s_notifiers_by_fd->find(static_cast<int>(event.user_data));
+        if (it == s_notifiers_by_fd->end())
+            continue;
+        for (auto* notifier : it->value) {
+            if ((event.events & static_cast<u32>(EventQueueEvents::Read)) && (notifier->event_mask() & Notifier::Event::Read))
+                post_event(*notifier, make<NotifierReadEvent>(notifier->fd()));
+            if ((event.events & static_cast<u32>(EventQueueEvents::Write)) && (notifier->event_mask() & Notifier::Event::Write))
+                post_event(*notifier, make<NotifierWriteEvent>(notifier->fd()));
+        }
+    }
+#else
     for (auto& notifier : *s_notifiers) {
         if (FD_ISSET(notifier->fd(), &rfds)) {
             if (notifier->event_mask() & Notifier::Event::Read)
@@ -697,6 +792,7 @@ try_select_again:
                 post_event(*notifier, make<NotifierWriteEvent>(notifier->fd()));
         }
     }
+#endif
 }
 
 bool EventLoopTimer::has_expired(const timeval& now) const
@@ -760,11 +856,42 @@ bool EventLoop::unregister_timer(int timer_id)
 void EventLoop::register_notifier(Badge<Notifier>, Notifier& notifier)
 {
     s_notifiers->set(&notifier);
+#ifdef __serenity__
+    auto& notifiers = s_notifiers_by_fd->ensure(notifier.fd());
+    if (notifiers.contains_slow(&notifier))
+        return;
+    auto operation = notifiers.is_empty() ? EventQueueOperation::Add : EventQueueOperation::Modify;
+    notifiers.append(&notifier);
+    update_event_queue_interest(operation, notifier.fd(), event_queue_events_for(notifiers));
+#endif
 }
 
 void EventLoop::unregister_notifier(Badge<Notifier>, Notifier& notifier)
 {
     s_notifiers->remove(&notifier);
+#ifdef __serenity__
+    auto it = s_notifiers_by_fd->find(notifier.fd());
+    if (it == s_notifiers_by_fd->end())
+        return;
+    if (!it->value.remove_first_matching([&](auto* entry) { return entry == &notifier; }))
+        return;
+    if (it->value.is_empty()) {
+        s_notifiers_by_fd->remove(it);
+        update_event_queue_interest(EventQueueOperation::Remove, notifier.fd(), 0);
+    } else {
+        update_event_queue_interest(EventQueueOperation::Modify, notifier.fd(), event_queue_events_for(it->value));
+    }
+#endif
+}
+
+void EventLoop::update_notifier(Badge<Notifier>, [[maybe_unused]] Notifier& notifier)
+{
+#ifdef __serenity__
+    auto it = s_notifiers_by_fd->find(notifier.fd());
+    if (it == s_notifiers_by_fd->end() || !it->value.contains_slow(&notifier))
+        return;
+    update_event_queue_interest(EventQueueOperation::Modify, notifier.fd(), event_queue_events_for(it->value));
+#endif
 }
 
 void EventLoop::wake()
@@ -0,0 +1,122 @@
+/*
+ * Copyright (c) 2021, the SerenityOS developers.
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#include <AK/Atomic.h>
+#include <LibCore/IORing.h>
+#include <errno.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#ifdef __serenity__
+#    include <serenity.h>
+#endif
+
+namespace Core {
+
+// Only supported in serenity mode because we use I/O ring syscalls
+#ifdef __serenity__
+
+Result<NonnullRefPtr<IORing>, String> IORing::create(u32 entries)
+{
+    // Leave room for completions of work that is still in flight while the
+    // submission ring is refilled.
+    u32 completion_entries = entries * 2;
+    size_t size = io_ring_size(entries, completion_entries);
+
+    int fd = create_io_ring(entries, completion_entries, static_cast<unsigned>(IORingFlags::CloseOnExec));
+    if (fd < 0)
+        return String::formatted("create_io_ring: {}", strerror(errno));
+    void* memory = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (memory == MAP_FAILED) {
+        auto error = String::formatted("mmap: {}", strerror(errno));
+        close(fd);
+        return error;
+    }
+    return adopt_ref(*new IORing(fd, static_cast<IORingHeader*>(memory), entries, completion_entries));
+}
+
+IORing::IORing(int fd, IORingHeader* header, u32 submission_entries, u32 completion_entries)
+    : m_fd(fd)
+    , m_header(header)
+    , m_submissions(reinterpret_cast<IORingSubmission*>(header + 1))
+    , m_completions(reinterpret_cast<IORingCompletion*>(m_submissions + submission_entries))
+    , m_submission_entries(submission_entries)
+    , m_completion_entries(completion_entries)
+{
+}
+
+IORing::~IORing()
+{
+    // Closing the ring cancels whatever is still waiting for its file. The
+    // kernel keeps its own mapping of the ring for work that is in flight.
+    close(m_fd);
+    munmap(m_header, io_ring_size(m_submission_entries, m_completion_entries));
+}
+
+bool IORing::enqueue(const IORingSubmission& submission)
+{
+    u32 tail = m_header->submission_tail;
+    if (tail - AK::atomic_load(&m_header->submission_head, AK::memory_order_acquire) >= m_submission_entries)
+        return false;
+    m_submissions[tail & (m_submission_entries - 1)] = submission;
+    // Publish the entry only once it has been fully written.
+    AK::atomic_store(&m_header->submission_tail, tail + 1, AK::memory_order_release);
+    return true;
+}
+
+bool IORing::submit_nop(u64 user_data)
+{
+    return enqueue({ static_cast<u32>(IORingOpcode::Nop), -1, user_data, 0, 0, 0 });
+}
+
+bool IORing::submit_read(int fd, Bytes buffer, u64 user_data)
+{
+    return enqueue({ static_cast<u32>(IORingOpcode::Read), fd, user_data, reinterpret_cast<FlatPtr>(buffer.data()), static_cast<u32>(buffer.size()), 0 });
+}
+
+bool IORing::submit_write(int fd, ReadonlyBytes buffer, u64 user_data)
+{
+    return enqueue({ static_cast<u32>(IORingOpcode::Write), fd, user_data, reinterpret_cast<FlatPtr>(buffer.data()), static_cast<u32>(buffer.size()), 0 });
+}
+
+bool IORing::submit_fsync(int fd, u64 user_data)
+{
+    return enqueue({ static_cast<u32>(IORingOpcode::Fsync), fd, user_data, 0, 0, 0 });
+}
+
+bool IORing::submit_accept(int fd, int flags, u64 user_data)
+{
+    return enqueue({ static_cast<u32>(IORingOpcode::Accept), fd, user_data, 0, 0, static_cast<u32>(flags) });
+}
+
+size_t IORing::queued_submissions() const
+{
+    return m_header->submission_tail - AK::atomic_load(&m_header->submission_head, AK::memory_order_acquire);
+}
+
+int IORing::enter(u32 min_complete)
+{
+    u32 to_submit = queued_submissions();
+    if (to_submit == 0 && min_complete == 0)
+        return 0;
+    return io_ring_enter(m_fd, to_submit, min_complete);
+}
+
+size_t IORing::for_each_completion(Function<void(const IORingCompletion&)> callback)
+{
+    u32 head = m_header->completion_head;
+    u32 tail = AK::atomic_load(&m_header->completion_tail, AK::memory_order_acquire);
+    for (u32 index = head; index != tail; index++)
+        callback(m_completions[index & (m_completion_entries - 1)]);
+    // Hand the slots back to the kernel only once we are done reading them.
+    AK::atomic_store(&m_header->completion_head, tail, AK::memory_order_release);
+    return tail - head;
+}
+
+#endif
+
+}
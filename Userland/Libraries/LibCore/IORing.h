@@ -0,0 +1,66 @@
+/*
+ * Copyright (c) 2021, the SerenityOS developers.
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#pragma once
+
+#include <AK/Function.h>
+#include <AK/Noncopyable.h>
+#include <AK/NonnullRefPtr.h>
+#include <AK/RefCounted.h>
+#include <AK/Result.h>
+#include <AK/Span.h>
+#include <AK/String.h>
+#include <Kernel/API/IORing.h>
+
+namespace Core {
+
+// Queues reads, writes, fsyncs and accepts in memory shared with the kernel.
+// Nothing happens until enter() is called, which hands everything queued so
+// far to the kernel with a single syscall. Completions can then be reaped
+// with for_each_completion() without entering the kernel.
+class IORing : public RefCounted<IORing> {
+    AK_MAKE_NONCOPYABLE(IORing);
+    AK_MAKE_NONMOVABLE(IORing);
+
+public:
+    static Result<NonnullRefPtr<IORing>, String> create(u32 entries = 128);
+    ~IORing();
+
+    int fd() const { return m_fd; }
+
+    // These return false if the submission ring is full. Buffers must stay
+    // alive until the matching completion has been reaped.
+    bool submit_nop(u64 user_data);
+    bool submit_read(int fd, Bytes, u64 user_data);
+    bool submit_write(int fd, ReadonlyBytes, u64 user_data);
+    bool submit_fsync(int fd, u64 user_data);
+    bool submit_accept(int fd, int flags, u64 user_data);
+
+    size_t queued_submissions() const;
+
+    // Submits everything that has been queued and waits until at least
+    // min_complete completions are available. Returns the number of
+    // submissions the kernel took, or -1 and sets errno.
+    int enter(u32 min_complete = 0);
+
+    // Calls the callback for every available completion and returns how
+    // many there were.
+    size_t for_each_completion(Function<void(const IORingCompletion&)>);
+
+private:
+    IORing(int fd, IORingHeader*, u32 submission_entries, u32 completion_entries);
+
+    bool enqueue(const IORingSubmission&);
+
+    int m_fd { -1 };
+    IORingHeader* m_header { nullptr };
+    IORingSubmission* m_submissions { nullptr };
+    IORingCompletion* m_completions { nullptr };
+    u32 m_submission_entries { 0 };
+    u32 m_completion_entries { 0 };
+};
+
+}
@@ -34,6 +34,15 @@ void Notifier::set_enabled(bool enabled)
         Core::EventLoop::unregister_notifier({}, *this);
 }
 
+void Notifier::set_event_mask(unsigned event_mask)
+{
+    if (m_event_mask == event_mask)
+        return;
+    m_event_mask = event_mask;
+    if (m_fd >= 0)
+        Core::EventLoop::update_notifier({}, *this);
+}
+
 void Notifier::close()
 {
     if (m_fd < 0)
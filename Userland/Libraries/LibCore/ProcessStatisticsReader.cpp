@@ -5,9 +5,7 @@
  */
 
 #include <AK/ByteBuffer.h>
-#include <AK/JsonArray.h>
-#include <AK/JsonObject.h>
-#include <AK/JsonValue.h>
+#include <Kernel/API/ProcessSnapshot.h>
 #include <LibCore/File.h>
 #include <LibCore/ProcessStatisticsReader.h>
 #include <pwd.h>
@@ -16,84 +14,177 @@ namespace Core {
 
 HashMap<uid_t, String> ProcessStatisticsReader::s_usernames;
 
-Optional<Vector<Core::ProcessStatistics>> ProcessStatisticsReader::get_all(RefPtr<Core::File>& proc_all_file)
+// Reads the struct at the start of a snapshot record, followed by its strings.
+class SnapshotRecordReader {
+public:
+    explicit SnapshotRecordReader(ReadonlyBytes bytes)
+        : m_bytes(bytes)
+    {
+    }
+
+    template<typename T>
+    const T* read_struct()
+    {
+        if (m_bytes.size() - m_offset < sizeof(T))
+            return nullptr;
+        auto* value = reinterpret_cast<const T*>(m_bytes.offset_pointer(m_offset));
+        m_offset += sizeof(T);
+        return value;
+    }
+
+    Optional<String> read_string(u16 length)
+    {
+        if (m_bytes.size() - m_offset < length)
+            return {};
+        String string { reinterpret_cast<const char*>(m_bytes.offset_pointer(m_offset)), length };
+        m_offset += length;
+        return string;
+    }
+
+private:
+    ReadonlyBytes m_bytes;
+    size_t m_offset { 0 };
+};
+
+static Optional<Core::ProcessStatistics> parse_process(SnapshotRecordReader& reader)
 {
-    if (proc_all_file) {
-        if (!proc_all_file->seek(0, Core::SeekMode::SetPosition)) {
-            warnln("ProcessStatisticsReader: Failed to refresh /proc/all: {}", proc_all_file->error_string());
+    auto* process_record = reader.read_struct<ProcessSnapshotProcess>();
+    if (!process_record)
+        return {};
+    auto name = reader.read_string(process_record->name_length);
+    auto executable = reader.read_string(process_record->executable_length);
+    auto tty = reader.read_string(process_record->tty_length);
+    auto pledge = reader.read_string(process_record->pledge_length);
+    if (!name.has_value() || !executable.has_value() || !tty.has_value() || !pledge.has_value())
+        return {};
+
+    Core::ProcessStatistics process;
+    process.pid = process_record->pid;
+    process.pgid = process_record->pgid;
+    process.pgp = process_record->pgp;
+    process.sid = process_record->sid;
+    process.uid = process_record->uid;
+    process.gid = process_record->gid;
+    process.ppid = process_record->ppid;
+    process.nfds = process_record->nfds;
+    process.kernel = process_record->kernel;
+    process.name = name.release_value();
+    process.executable = executable.release_value();
+    process.tty = tty.release_value();
+    process.pledge = pledge.release_value();
+    switch (static_cast<ProcessSnapshotVeilState>(process_record->veil_state)) {
+    case ProcessSnapshotVeilState::None:
+        process.veil = "None";
+        break;
+    case ProcessSnapshotVeilState::Dropped:
+        process.veil = "Dropped";
+        break;
+    case ProcessSnapshotVeilState::Locked:
+        process.veil = "Locked";
+        break;
+    }
+    // Kernel processes can't be veiled.
+    if (process.kernel)
+        process.veil = String::empty();
+    process.amount_virtual = process_record->amount_virtual;
+    process.amount_resident = process_record->amount_resident;
+    process.amount_shared = process_record->amount_shared;
+    process.amount_dirty_private = process_record->amount_dirty_private;
+    process.amount_clean_inode = process_record->amount_clean_inode;
+    process.amount_purgeable_volatile = process_record->amount_purgeable_volatile;
+    process.amount_purgeable_nonvolatile = process_record->amount_purgeable_nonvolatile;
+    process.threads.ensure_capacity(process_record->thread_count);
+    return process;
+}
+
+static Optional<Core::ThreadStatistics> parse_thread(SnapshotRecordReader& reader)
+{
+    auto* thread_record = reader.read_struct<ProcessSnapshotThread>();
+    if (!thread_record)
+        return {};
+    auto name = reader.read_string(thread_record->name_length);
+    auto state = reader.read_string(thread_record->state_length);
+    if (!name.has_value() || !state.has_value())
+        return {};
+
+    Core::ThreadStatistics thread;
+    thread.tid = thread_record->tid;
+    thread.times_scheduled = thread_record->times_scheduled;
+    thread.name = name.release_value();
+    thread.state = state.release_value();
+    thread.ticks_user = thread_record->ticks_user;
+    thread.ticks_kernel = thread_record->ticks_kernel;
+    thread.cpu = thread_record->cpu;
+    thread.priority = thread_record->priority;
+    thread.syscall_count = thread_record->syscall_count;
+    thread.inode_faults = thread_record->inode_faults;
+    thread.zero_faults = thread_record->zero_faults;
+    thread.cow_faults = thread_record->cow_faults;
+    thread.unix_socket_read_bytes = thread_record->unix_socket_read_bytes;
+    thread.unix_socket_write_bytes = thread_record->unix_socket_write_bytes;
+    thread.ipv4_socket_read_bytes = thread_record->ipv4_socket_read_bytes;
+    thread.ipv4_socket_write_bytes = thread_record->ipv4_socket_write_bytes;
+    thread.file_read_bytes = thread_record->file_read_bytes;
+    thread.file_write_bytes = thread_record->file_write_bytes;
+    return thread;
+}
+
+Optional<Vector<Core::ProcessStatistics>> ProcessStatisticsReader::get_all(RefPtr<Core::File>& proc_snapshot_file)
+{
+    if (proc_snapshot_file) {
+        if (!proc_snapshot_file->seek(0, Core::SeekMode::SetPosition)) {
+            warnln("ProcessStatisticsReader: Failed to refresh /proc/snapshot: {}", proc_snapshot_file->error_string());
             return {};
         }
     } else {
-        proc_all_file = Core::File::construct("/proc/all");
-        if (!proc_all_file->open(Core::OpenMode::ReadOnly)) {
-            warnln("ProcessStatisticsReader: Failed to open /proc/all: {}", proc_all_file->error_string());
+        proc_snapshot_file = Core::File::construct("/proc/snapshot");
+        if (!proc_snapshot_file->open(Core::OpenMode::ReadOnly)) {
+            warnln("ProcessStatisticsReader: Failed to open /proc/snapshot: {}", proc_snapshot_file->error_string());
             return {};
         }
     }
 
+    auto file_contents = proc_snapshot_file->read_all();
+    if (file_contents.size() < sizeof(ProcessSnapshotHeader))
+        return {};
+    auto& header = *reinterpret_cast<const ProcessSnapshotHeader*>(file_contents.data());
+    if (header.magic != process_snapshot_magic || header.version != process_snapshot_version) {
+        warnln("ProcessStatisticsReader: Unsupported /proc/snapshot format");
+        return {};
+    }
+
     Vector<Core::ProcessStatistics> processes;
+    processes.ensure_capacity(header.process_count);
 
-    auto file_contents = proc_all_file->read_all();
-    auto json = JsonValue::from_string(file_contents);
-    if (!json.has_value())
-        return {};
-    json.value().as_array().for_each([&](auto& value) {
-        const JsonObject& process_object = value.as_object();
-        Core::ProcessStatistics process;
-
-        // kernel data first
-        process.pid = process_object.get("pid").to_u32();
-        process.pgid = process_object.get("pgid").to_u32();
-        process.pgp = process_object.get("pgp").to_u32();
-        process.sid = process_object.get("sid").to_u32();
-        process.uid = process_object.get("uid").to_u32();
-        process.gid = process_object.get("gid").to_u32();
-        process.ppid = process_object.get("ppid").to_u32();
-        process.nfds = process_object.get("nfds").to_u32();
-        process.kernel = process_object.get("kernel").to_bool();
-        process.name = process_object.get("name").to_string();
-        process.executable = process_object.get("executable").to_string();
-        process.tty = process_object.get("tty").to_string();
-        process.pledge = process_object.get("pledge").to_string();
-        process.veil = process_object.get("veil").to_string();
-        process.amount_virtual = process_object.get("amount_virtual").to_u32();
-        process.amount_resident = process_object.get("amount_resident").to_u32();
-        process.amount_shared = process_object.get("amount_shared").to_u32();
-        process.amount_dirty_private = process_object.get("amount_dirty_private").to_u32();
-        process.amount_clean_inode = process_object.get("amount_clean_inode").to_u32();
-        process.amount_purgeable_volatile = process_object.get("amount_purgeable_volatile").to_u32();
-        process.amount_purgeable_nonvolatile = process_object.get("amount_purgeable_nonvolatile").to_u32();
-
-        auto& thread_array = process_object.get_ptr("threads")->as_array();
-        process.threads.ensure_capacity(thread_array.size());
-        thread_array.for_each([&](auto& value) {
-            auto& thread_object = value.as_object();
-            Core::ThreadStatistics thread;
-            thread.tid = thread_object.get("tid").to_u32();
-            thread.times_scheduled = thread_object.get("times_scheduled").to_u32();
-            thread.name = thread_object.get("name").to_string();
-            thread.state = thread_object.get("state").to_string();
-            thread.ticks_user = thread_object.get("ticks_user").to_u32();
-            thread.ticks_kernel = thread_object.get("ticks_kernel").to_u32();
-            thread.cpu = thread_object.get("cpu").to_u32();
-            thread.priority = thread_object.get("priority").to_u32();
-            thread.syscall_count = thread_object.get("syscall_count").to_u32();
-            thread.inode_faults = thread_object.get("inode_faults").to_u32();
-            thread.zero_faults = thread_object.get("zero_faults").to_u32();
-            thread.cow_faults = thread_object.get("cow_faults").to_u32();
-            thread.unix_socket_read_bytes = thread_object.get("unix_socket_read_bytes").to_u32();
-            thread.unix_socket_write_bytes = thread_object.get("unix_socket_write_bytes").to_u32();
-            thread.ipv4_socket_read_bytes = thread_object.get("ipv4_socket_read_bytes").to_u32();
-            thread.ipv4_socket_write_bytes = thread_object.get("ipv4_socket_write_bytes").to_u32();
-            thread.file_read_bytes = thread_object.get("file_read_bytes").to_u32();
-            thread.file_write_bytes = thread_object.get("file_write_bytes").to_u32();
-            process.threads.append(move(thread));
-        });
-
-        // and synthetic data last
-        process.username = username_from_uid(process.uid);
-        processes.append(move(process));
-    });
+    for (size_t offset = header.header_size; offset < file_contents.size();) {
+        if (file_contents.size() - offset < sizeof(ProcessSnapshotRecord))
+            return {};
+        auto& record = *reinterpret_cast<const ProcessSnapshotRecord*>(file_contents.offset_pointer(offset));
+        if (record.size < sizeof(ProcessSnapshotRecord) || record.size > file_contents.size() - offset)
+            return {};
+        SnapshotRecordReader reader(file_contents.bytes().slice(offset + sizeof(ProcessSnapshotRecord), record.size - sizeof(ProcessSnapshotRecord)));
+        offset += record.size;
+
+        switch (static_cast<ProcessSnapshotRecordType>(record.type)) {
+        case ProcessSnapshotRecordType::Process: {
+            auto process = parse_process(reader);
+            if (!process.has_value())
+                return {};
+            process->username = username_from_uid(process->uid);
+            processes.append(process.release_value());
+            break;
+        }
+        case ProcessSnapshotRecordType::Thread: {
+            auto thread = parse_thread(reader);
+            if (!thread.has_value() || processes.is_empty())
+                return {};
+            processes.last().threads.append(thread.release_value());
+            break;
+        }
+        default:
+            break;
+        }
+    }
 
     return processes;
 }
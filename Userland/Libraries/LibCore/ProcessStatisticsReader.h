@@ -34,8 +34,7 @@ struct ThreadStatistics {
 };
 
 struct ProcessStatistics {
-    // Keep this in sync with /proc/all.
-    // From the kernel side:
+    // From the kernel side (see Kernel/API/ProcessSnapshot.h):
     pid_t pid;
     pid_t pgid;
     pid_t pgp;
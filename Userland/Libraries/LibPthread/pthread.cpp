@@ -444,6 +444,7 @@ int pthread_cond_init(pthread_cond_t* cond, const pthread_condattr_t* attr)
     cond->value = 0;
     cond->previous = 0;
     cond->clockid = attr ? attr->clockid : CLOCK_MONOTONIC_COARSE;
+    cond->mutex = nullptr;
     return 0;
 }
 
@@ -469,9 +470,11 @@ static int cond_wait(pthread_cond_t* cond, pthread_mutex_t* mutex, const struct
 {
     u32 value = cond->value;
     cond->previous = value;
+    cond->mutex = mutex;
     pthread_mutex_unlock(mutex);
     int rc = futex_wait(cond->value, value, abstime);
-    pthread_mutex_lock(mutex);
+    // pthread_cond_broadcast() may have moved us over to the mutex's futex.
+    __pthread_mutex_lock_pessimistic_np(mutex);
     return rc;
 }
 
@@ -517,7 +520,21 @@ int pthread_cond_broadcast(pthread_cond_t* cond)
 {
     u32 value = cond->previous + 1;
     cond->value = value;
-    int rc = futex(&cond->value, FUTEX_WAKE, INT32_MAX, nullptr, nullptr, 0);
+    int rc;
+    if (auto* mutex = cond->mutex) {
+        // Wake up one waiter and move the rest over to the mutex, so they get
+        // woken one by one as it's unlocked instead of all fighting over it now.
+        int saved_errno = errno;
+        rc = futex(&cond->value, FUTEX_CMP_REQUEUE, 1, reinterpret_cast<const struct timespec*>(INT32_MAX), &mutex->lock, value);
+        if (rc < 0) {
+            // Someone changed the value under us, or the mutex we saw is stale
+            // and has gone away already. Either way, just wake everyone up.
+            errno = saved_errno;
+            rc = futex(&cond->value, FUTEX_WAKE, INT32_MAX, nullptr, nullptr, 0);
+        }
+    } else {
+        rc = futex(&cond->value, FUTEX_WAKE, INT32_MAX, nullptr, nullptr, 0);
+    }
     VERIFY(rc >= 0);
     return 0;
 }
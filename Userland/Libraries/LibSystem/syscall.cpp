@@ -4,28 +4,78 @@
  * SPDX-License-Identifier: BSD-2-Clause
  */
 
+#include <AK/Platform.h>
 #include <Kernel/API/Syscall.h>
 #include <LibSystem/syscall.h>
 
+static bool s_use_sysenter;
+
+// SYSENTER doesn't save the return address or the stack pointer, so we pass
+// them to the kernel in edx and ecx. The first two arguments go on the stack
+// instead, and we restore them afterwards, just like "int $0x82" leaves them.
+static inline uintptr_t sysenter(uintptr_t function, uintptr_t arg0, uintptr_t arg1, uintptr_t arg2)
+{
+#if ARCH(I386)
+    uintptr_t result;
+    asm volatile(
+        "pushl %%ecx\n"
+        "pushl %%edx\n"
+        "call 1f\n"
+        "1:\n"
+        "popl %%edx\n"
+        "addl $(2f - 1b), %%edx\n"
+        "movl %%esp, %%ecx\n"
+        "sysenter\n"
+        "2:\n"
+        "popl %%edx\n"
+        "popl %%ecx\n"
+        : "=a"(result)
+        : "a"(function), "d"(arg0), "c"(arg1), "b"(arg2)
+        : "memory", "cc");
+    return result;
+#else
+    (void)function;
+    (void)arg0;
+    (void)arg1;
+    (void)arg2;
+    __builtin_trap();
+#endif
+}
+
 extern "C" {
 
+void syscall_use_sysenter()
+{
+#if ARCH(I386)
+    s_use_sysenter = true;
+#endif
+}
+
 uintptr_t syscall0(uintptr_t function)
 {
+    if (s_use_sysenter)
+        return sysenter(function, 0, 0, 0);
     return Syscall::invoke((Syscall::Function)function);
 }
 
 uintptr_t syscall1(uintptr_t function, uintptr_t arg0)
 {
+    if (s_use_sysenter)
+        return sysenter(function, arg0, 0, 0);
     return Syscall::invoke((Syscall::Function)function, arg0);
 }
 
 uintptr_t syscall2(uintptr_t function, uintptr_t arg0, uintptr_t arg1)
 {
+    if (s_use_sysenter)
+        return sysenter(function, arg0, arg1, 0);
     return Syscall::invoke((Syscall::Function)function, arg0, arg1);
 }
 
 uintptr_t syscall3(uintptr_t function, uintptr_t arg0, uintptr_t arg1, uintptr_t arg2)
 {
+    if (s_use_sysenter)
+        return sysenter(function, arg0, arg1, arg2);
     return Syscall::invoke((Syscall::Function)function, arg0, arg1, arg2);
 }
 }
@@ -11,6 +11,9 @@
 
 extern "C" {
 
+// Only call this if the kernel advertised SYSENTER support through AT_HWCAP.
+void syscall_use_sysenter();
+
 uintptr_t syscall0(uintptr_t function);
 uintptr_t syscall1(uintptr_t function, uintptr_t arg0);
 uintptr_t syscall2(uintptr_t function, uintptr_t arg0, uintptr_t arg1);
@@ -15,6 +15,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <sys/stat.h>
+#include <sys/wait.h>
 #include <unistd.h>
 
 struct Result {
@@ -39,12 +40,91 @@ static Result average_result(const Vector<Result>& results)
 
 static void exit_with_usage(int rc)
 {
-    warnln("Usage: disk_benchmark [-h] [-d directory] [-t time_per_benchmark] [-f file_size1,file_size2,...] [-b block_size1,block_size2,...]");
+    warnln("Usage: disk_benchmark [-h] [-d directory] [-t time_per_benchmark] [-p parallel_count] [-f file_size1,file_size2,...] [-b block_size1,block_size2,...]");
     exit(rc);
 }
 
 static Optional<Result> benchmark(const String& filename, int file_size, int block_size, ByteBuffer& buffer, bool allow_cache);
 
+static Optional<Result> run_benchmarks(const String& filename, int time_per_benchmark, int file_size, int block_size, bool allow_cache, size_t& run_count)
+{
+    auto buffer = ByteBuffer::create_uninitialized(block_size);
+    Vector<Result> results;
+
+    Core::ElapsedTimer timer;
+    timer.start();
+    while (timer.elapsed() < time_per_benchmark * 1000) {
+        out(".");
+        fflush(stdout);
+        auto result = benchmark(filename, file_size, block_size, buffer, allow_cache);
+        if (!result.has_value())
+            return {};
+        results.append(result.release_value());
+        usleep(100);
+    }
+    run_count = results.size();
+    return average_result(results);
+}
+
+// Runs the benchmark in several processes at once, each on its own file, so
+// the disk gets to see that many requests at the same time.
+static Optional<Result> run_parallel_benchmarks(const String& filename, int time_per_benchmark, int file_size, int block_size, bool allow_cache, size_t parallel_count, size_t& run_count)
+{
+    int pipe_fds[2];
+    if (pipe(pipe_fds) < 0) {
+        perror("pipe");
+        return {};
+    }
+
+    Vector<pid_t> children;
+    for (size_t i = 0; i < parallel_count; ++i) {
+        pid_t pid = fork();
+        if (pid < 0) {
+            perror("fork");
+            return {};
+        }
+        if (pid == 0) {
+            close(pipe_fds[0]);
+            size_t child_run_count = 0;
+            auto result = run_benchmarks(String::formatted("{}.{}", filename, i), time_per_benchmark, file_size, block_size, allow_cache, child_run_count);
+            if (!result.has_value())
+                _exit(1);
+            if (write(pipe_fds[1], &result.value(), sizeof(Result)) != sizeof(Result) || write(pipe_fds[1], &child_run_count, sizeof(child_run_count)) != sizeof(child_run_count))
+                _exit(1);
+            _exit(0);
+        }
+        children.append(pid);
+    }
+    close(pipe_fds[1]);
+
+    bool success = true;
+    for (auto pid : children) {
+        int status = 0;
+        if (waitpid(pid, &status, 0) < 0 || !WIFEXITED(status) || WEXITSTATUS(status) != 0)
+            success = false;
+    }
+
+    // The throughput of all the processes adds up.
+    Result total;
+    run_count = 0;
+    for (size_t i = 0; success && i < parallel_count; ++i) {
+        Result result;
+        size_t child_run_count = 0;
+        if (read(pipe_fds[0], &result, sizeof(result)) != sizeof(result) || read(pipe_fds[0], &child_run_count, sizeof(child_run_count)) != sizeof(child_run_count)) {
+            success = false;
+            break;
+        }
+        total.write_bps += result.write_bps;
+        total.read_bps += result.read_bps;
+        run_count += child_run_count;
+    }
+    close(pipe_fds[0]);
+
+    if (!success)
+        return {};
+    return total;
+}
+
 int main(int argc, char** argv)
 {
     String directory = ".";
@@ -52,9 +132,10 @@ int main(int argc, char** argv)
     Vector<size_t> file_sizes;
     Vector<size_t> block_sizes;
     bool allow_cache = false;
+    size_t parallel_count = 1;
 
     int opt;
-    while ((opt = getopt(argc, argv, "chd:t:f:b:")) != -1) {
+    while ((opt = getopt(argc, argv, "chd:t:p:f:b:")) != -1) {
         switch (opt) {
         case 'h':
             exit_with_usage(0);
@@ -68,6 +149,9 @@ int main(int argc, char** argv)
         case 't':
             time_per_benchmark = atoi(optarg);
             break;
+        case 'p':
+            parallel_count = max(atoi(optarg), 1);
+            break;
         case 'f':
             for (const auto& size : String(optarg).split(','))
                 file_sizes.append(atoi(size.characters()));
@@ -95,23 +179,18 @@ int main(int argc, char** argv)
             if (block_size > file_size)
                 continue;
 
-            auto buffer = ByteBuffer::create_uninitialized(block_size);
-            Vector<Result> results;
-
-            outln("Running: file_size={} block_size={}", file_size, block_size);
+            outln("Running: file_size={} block_size={} parallel_count={}", file_size, block_size, parallel_count);
             Core::ElapsedTimer timer;
             timer.start();
-            while (timer.elapsed() < time_per_benchmark * 1000) {
-                out(".");
-                fflush(stdout);
-                auto result = benchmark(filename, file_size, block_size, buffer, allow_cache);
-                if (!result.has_value())
-                    return 1;
-                results.append(result.release_value());
-                usleep(100);
-            }
-            auto average = average_result(results);
-            outln("Finished: runs={} time={}ms write_bps={} read_bps={}", results.size(), timer.elapsed(), average.write_bps, average.read_bps);
+            size_t run_count = 0;
+            Optional<Result> result;
+            if (parallel_count == 1)
+                result = run_benchmarks(filename, time_per_benchmark, file_size, block_size, allow_cache, run_count);
+            else
+                result = run_parallel_benchmarks(filename, time_per_benchmark, file_size, block_size, allow_cache, parallel_count, run_count);
+            if (!result.has_value())
+                return 1;
+            outln("Finished: runs={} time={}ms write_bps={} read_bps={}", run_count, timer.elapsed(), result->write_bps, result->read_bps);
 
             sleep(1);
         }
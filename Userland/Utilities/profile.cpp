@@ -4,11 +4,149 @@
  * SPDX-License-Identifier: BSD-2-Clause
  */
 
+#include <AK/Vector.h>
+#include <Kernel/API/PerformanceEvents.h>
 #include <LibCore/ArgsParser.h>
+#include <fcntl.h>
+#include <poll.h>
 #include <serenity.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+struct MappedRing {
+    PerformanceEventRingHeader* header { nullptr };
+    size_t size { 0 };
+};
+
+static bool write_all(int fd, const void* data, size_t size)
+{
+    auto* bytes = reinterpret_cast<const u8*>(data);
+    while (size > 0) {
+        auto nwritten = write(fd, bytes, size);
+        if (nwritten <= 0) {
+            perror("write");
+            return false;
+        }
+        bytes += nwritten;
+        size -= nwritten;
+    }
+    return true;
+}
+
+static Optional<MappedRing> map_ring(unsigned processor)
+{
+    int fd = profiling_open_ring(processor);
+    if (fd < 0) {
+        perror("profiling_open_ring");
+        return {};
+    }
+
+    // Map just the header first to find out how big the ring is.
+    auto* header = reinterpret_cast<PerformanceEventRingHeader*>(mmap(nullptr, PAGE_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0));
+    if (header == MAP_FAILED) {
+        perror("mmap");
+        close(fd);
+        return {};
+    }
+    size_t size = header->data_offset + header->data_size;
+    munmap(header, PAGE_SIZE);
+
+    header = reinterpret_cast<PerformanceEventRingHeader*>(mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0));
+    close(fd);
+    if (header == MAP_FAILED) {
+        perror("mmap");
+        return {};
+    }
+    return MappedRing { header, size };
+}
+
+// Records never wrap around the end of the ring, and the space before the end is
+// taken up by a padding record, so everything can be written out as it is.
+static bool drain_ring(MappedRing& ring, int output_fd)
+{
+    auto& header = *ring.header;
+    auto* data = reinterpret_cast<u8*>(ring.header) + header.data_offset;
+    u32 head = __atomic_load_n(&header.head, __ATOMIC_ACQUIRE);
+    u32 tail = header.tail;
+    while (tail != head) {
+        u32 offset = tail & (header.data_size - 1);
+        u32 size = min(head - tail, header.data_size - offset);
+        if (!write_all(output_fd, data + offset, size))
+            return false;
+        tail += size;
+    }
+    __atomic_store_n(&header.tail, tail, __ATOMIC_RELEASE);
+    return true;
+}
+
+static bool wait_for_input(int timeout_ms)
+{
+    pollfd poll_fd { STDIN_FILENO, POLLIN, 0 };
+    return poll(&poll_fd, 1, timeout_ms) > 0;
+}
+
+static int stream_all_processes(const char* output_path, u64 event_mask)
+{
+    int output_fd = open(output_path, O_WRONLY | O_CREAT | O_TRUNC, 0600);
+    if (output_fd < 0) {
+        perror("open");
+        return 1;
+    }
+
+    PerformanceEventStreamHeader header {};
+    header.magic = performance_event_stream_magic;
+    header.version = performance_event_stream_version;
+    header.header_size = sizeof(header);
+    if (!write_all(output_fd, &header, sizeof(header)))
+        return 1;
+
+    if (profiling_enable(-1, event_mask) < 0) {
+        perror("profiling_enable");
+        return 1;
+    }
+
+    Vector<MappedRing> rings;
+    long processor_count = sysconf(_SC_NPROCESSORS_ONLN);
+    for (long processor = 0; processor < processor_count; ++processor) {
+        auto ring = map_ring(processor);
+        if (!ring.has_value()) {
+            profiling_disable(-1);
+            return 1;
+        }
+        rings.append(ring.release_value());
+    }
+
+    outln("Profiling enabled, writing events to {} until user input...", output_path);
+    bool success = true;
+    while (success && !wait_for_input(100)) {
+        for (auto& ring : rings)
+            success = success && drain_ring(ring, output_fd);
+    }
+
+    if (profiling_disable(-1) < 0) {
+        perror("profiling_disable");
+        success = false;
+    }
+    for (auto& ring : rings) {
+        success = success && drain_ring(ring, output_fd);
+        header.lost_events += ring.header->lost_events;
+        munmap(ring.header, ring.size);
+    }
+    if (profiling_free_buffer(-1) < 0)
+        perror("profiling_free_buffer");
+
+    if (lseek(output_fd, 0, SEEK_SET) < 0 || !write_all(output_fd, &header, sizeof(header)))
+        success = false;
+    close(output_fd);
+
+    if (header.lost_events > 0)
+        warnln("{} events were lost because they were not written out fast enough.", header.lost_events);
+    outln("Profiling disabled.");
+    return success ? 0 : 1;
+}
 
 int main(int argc, char** argv)
 {
@@ -16,6 +154,7 @@ int main(int argc, char** argv)
 
     const char* pid_argument = nullptr;
     const char* cmd_argument = nullptr;
+    const char* output_path = nullptr;
     bool wait = false;
     bool free = false;
     bool enable = false;
@@ -32,6 +171,7 @@ int main(int argc, char** argv)
     args_parser.add_option(free, "Free the profiling buffer for the associated process(es).", nullptr, 'f');
     args_parser.add_option(wait, "Enable profiling and wait for user input to disable.", nullptr, 'w');
     args_parser.add_option(cmd_argument, "Command", nullptr, 'c', "command");
+    args_parser.add_option(output_path, "Stream the events of all processes into a perfcore file until user input (with -a).", nullptr, 'o', "path");
     args_parser.add_option(Core::ArgsParser::Option {
         true, "Enable tracking specific event type", nullptr, 't', "event_type",
         [&](String event_type) {
@@ -46,6 +186,8 @@ int main(int argc, char** argv)
                 event_mask |= PERF_EVENT_KFREE;
             else if (event_type == "page_fault")
                 event_mask |= PERF_EVENT_PAGE_FAULT;
+            else if (event_type == "tracepoint")
+                event_mask |= PERF_EVENT_TRACEPOINT;
             else {
                 warnln("Unknown event type '{}' specified.", event_type);
                 exit(1);
@@ -55,7 +197,8 @@ int main(int argc, char** argv)
 
     auto print_types = [] {
         outln();
-        outln("Event type can be one of: sample, context_switch, page_fault, kmalloc and kfree.");
+        outln("Event type can be one of: sample, context_switch, page_fault, kmalloc, kfree and tracepoint.");
+        outln("Tracepoints are switched on individually with /proc/sys/trace_<name>.");
     };
 
     if (!args_parser.parse(argc, argv, Core::ArgsParser::FailureBehavior::PrintUsage)) {
@@ -72,6 +215,9 @@ int main(int argc, char** argv)
     if (!seen_event_type_arg)
         event_mask |= PERF_EVENT_SAMPLE;
 
+    if (all_processes && output_path)
+        return stream_all_processes(output_path, event_mask);
+
     if (pid_argument || all_processes) {
         if (!(enable ^ disable ^ wait ^ free)) {
             warnln("-p <PID> requires -e xor -d xor -w xor -f.");